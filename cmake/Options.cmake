@@ -1,7 +1,28 @@
 option(BLOCCO_ENABLE_MARCH_NATIVE "Enable -march=native" OFF)
 option(BLOCCO_ENABLE_VALIDATION "Enable Vulkan validation layers" ON)
 option(BLOCCO_HEADLESS "Build headless capture tool" ON)
+option(BLOCCO_BENCH "Build the blocco_bench scenario benchmark" ON)
+option(BLOCCO_FORCE_SCALAR_MATH "Use scalar math kernels instead of SSE/AVX2" OFF)
+option(BLOCCO_ENABLE_PROFILER "Build profiler zones and Chrome trace export" ON)
 
 if(BLOCCO_ENABLE_MARCH_NATIVE AND NOT MSVC)
   add_compile_options(-march=native)
 endif()
+if(NOT MSVC)
+  # Keep float results independent of the ISA: no implicit FMA contraction.
+  add_compile_options(-ffp-contract=off)
+endif()
+if(BLOCCO_FORCE_SCALAR_MATH)
+  add_compile_definitions(BLOCCO_FORCE_SCALAR_MATH)
+endif()
+if(BLOCCO_ENABLE_PROFILER)
+  add_compile_definitions(BLOCCO_PROFILER)
+endif()
+set(_blocco_log_levels trace debug info warn error)
+set(BLOCCO_LOG_LEVEL "info" CACHE STRING "Lowest log level compiled in: trace, debug, info, warn or error")
+set_property(CACHE BLOCCO_LOG_LEVEL PROPERTY STRINGS ${_blocco_log_levels})
+list(FIND _blocco_log_levels "${BLOCCO_LOG_LEVEL}" _blocco_log_level)
+if(_blocco_log_level LESS 0)
+  message(FATAL_ERROR "BLOCCO_LOG_LEVEL must be one of: ${_blocco_log_levels}")
+endif()
+add_compile_definitions(BLOCCO_LOG_LEVEL=${_blocco_log_level})
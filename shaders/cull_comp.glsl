@@ -0,0 +1,101 @@
+#version 450
+// GPU draw culling, one invocation per draw command. Boxes are tested against
+// the current frustum, then against the Hi-Z pyramid built from the previous
+// frame's depth, projected with that frame's viewProj. Mirrors frustumVisible()
+// and DepthPyramid::occluded() in src/culling.cpp.
+layout(local_size_x = 64) in;
+
+struct DrawCommand {
+  uint indexCount;
+  uint instanceCount;
+  uint firstIndex;
+  int vertexOffset;
+  uint firstInstance;
+};
+// min.w holds the batch index and max.w the batch's first command (uint bits).
+// The batch index's top bit marks batches that must keep their draw order.
+struct DrawBounds {
+  vec4 minB;
+  vec4 maxB;
+};
+
+layout(std140, set=0, binding=0) uniform CullUBO {
+  mat4 prevViewProj;
+  vec4 planes[6];
+  uvec4 depth; // width, height, pyramid levels, occlusion enabled
+  uvec4 draws; // count, first command word in the ring, first bounds element, compact
+} cull;
+// The CPU-built commands and bounds live in the frame ring; commands are read as
+// words because their offset need not be a multiple of the 20-byte stride.
+layout(std430, set=0, binding=1) readonly buffer RingWords { uint words[]; } ring;
+layout(std430, set=0, binding=2) readonly buffer RingBounds { DrawBounds bounds[]; } ringBounds;
+layout(std430, set=0, binding=3) writeonly buffer OutCommands { DrawCommand commands[]; } outCommands;
+layout(std430, set=0, binding=4) buffer Counts {
+  uint frustumCulled;
+  uint occlusionCulled;
+  uint visible;
+  uint pad;
+  uint batch[]; // surviving commands per batch: the vkCmdDrawIndexedIndirectCount counts
+} counts;
+layout(set=0, binding=5) uniform sampler2D pyramid;
+
+bool occluded(vec3 bmin, vec3 bmax){
+  vec2 lo = vec2(1.0), hi = vec2(0.0);
+  float nearest = 1.0;
+  for(int i = 0; i < 8; ++i){
+    vec4 c = cull.prevViewProj * vec4((i & 1) != 0 ? bmax.x : bmin.x, (i & 2) != 0 ? bmax.y : bmin.y, (i & 4) != 0 ? bmax.z : bmin.z, 1.0);
+    if(c.w <= 1e-4) return false; // crosses the near plane
+    vec2 uv = c.xy / c.w * 0.5 + 0.5;
+    lo = min(lo, uv); hi = max(hi, uv);
+    nearest = min(nearest, c.z / c.w);
+  }
+  uvec2 size = cull.depth.xy;
+  uvec2 t0 = min(uvec2(clamp(lo, 0.0, 1.0) * vec2(size)), size - 1u);
+  uvec2 t1 = min(uvec2(clamp(hi, 0.0, 1.0) * vec2(size)), size - 1u);
+  // Smallest level whose texels (2^(level+1) depth texels wide) the rect spans at most two of.
+  uint extent = max(t1.x - t0.x, t1.y - t0.y) + 1u;
+  uint wanted = uint(findMSB(extent - 1u) + 1);
+  uint level = min(wanted > 0u ? wanted - 1u : 0u, cull.depth.z - 1u);
+  uvec2 last = uvec2(textureSize(pyramid, int(level))) - 1u;
+  ivec2 p0 = ivec2(min(t0 >> (level + 1u), last));
+  ivec2 p1 = ivec2(min(t1 >> (level + 1u), last));
+  int l = int(level);
+  float farthest = max(max(texelFetch(pyramid, p0, l).r, texelFetch(pyramid, ivec2(p1.x, p0.y), l).r),
+                       max(texelFetch(pyramid, ivec2(p0.x, p1.y), l).r, texelFetch(pyramid, p1, l).r));
+  return nearest > farthest;
+}
+
+void main(){
+  uint i = gl_GlobalInvocationID.x;
+  if(i >= cull.draws.x) return;
+  DrawBounds b = ringBounds.bounds[cull.draws.z + i];
+  uint w = cull.draws.y + i * 5u;
+  DrawCommand cmd = DrawCommand(ring.words[w], ring.words[w + 1u], ring.words[w + 2u], int(ring.words[w + 3u]), ring.words[w + 4u]);
+  bool visible = true;
+  for(int p = 0; p < 6; ++p){
+    vec4 plane = cull.planes[p];
+    vec3 corner = mix(b.minB.xyz, b.maxB.xyz, greaterThan(plane.xyz, vec3(0.0)));
+    if(dot(plane.xyz, corner) + plane.w < 0.0){ visible = false; break; }
+  }
+  if(!visible) atomicAdd(counts.frustumCulled, 1u);
+  else if(cull.depth.w != 0u && occluded(b.minB.xyz, b.maxB.xyz)){ visible = false; atomicAdd(counts.occlusionCulled, 1u); }
+  if(visible) atomicAdd(counts.visible, 1u);
+  uint batch = floatBitsToUint(b.minB.w);
+  bool inOrder = (batch & 0x80000000u) != 0u;
+  batch &= 0x7FFFFFFFu;
+  if(cull.draws.w != 0u && !inOrder){
+    // Compact survivors to the front of their batch's range. Order inside a batch
+    // follows the atomics, so the CPU's front-to-back sort is only approximate:
+    // fine for opaque draws, where it only costs some overdraw.
+    if(!visible) return;
+    uint slot = floatBitsToUint(b.maxB.w) + atomicAdd(counts.batch[batch], 1u);
+    outCommands.commands[slot] = cmd;
+    return;
+  }
+  // Keep every command in place and drop culled ones with zero instances: without
+  // drawIndirectCount, and for blended batches, which must draw exactly in the
+  // CPU's back-to-front order (their count then covers the whole batch).
+  cmd.instanceCount = visible ? 1u : 0u;
+  outCommands.commands[i] = cmd;
+  if(cull.draws.w != 0u) atomicAdd(counts.batch[batch], 1u);
+}
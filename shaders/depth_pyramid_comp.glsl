@@ -0,0 +1,21 @@
+#version 450
+// One Hi-Z level: each texel keeps the farthest of the 2x2 source texels under
+// it, and the last texel in a row or column also takes the odd one left over.
+// Mirrors DepthPyramid::build() in src/culling.cpp.
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(set=0, binding=0) uniform sampler2D src; // depth buffer, or the previous level
+layout(set=0, binding=1, r32f) uniform writeonly image2D dst;
+
+void main(){
+  ivec2 size = imageSize(dst);
+  ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+  if(any(greaterThanEqual(p, size))) return;
+  ivec2 srcSize = textureSize(src, 0);
+  ivec2 lo = p * 2;
+  ivec2 hi = min(lo + 1 + ivec2(equal(p, size - 1)) * (srcSize & 1), srcSize - 1);
+  float d = 0.0;
+  for(int y = lo.y; y <= hi.y; ++y)
+    for(int x = lo.x; x <= hi.x; ++x) d = max(d, texelFetch(src, ivec2(x, y), 0).r);
+  imageStore(dst, p, vec4(d));
+}
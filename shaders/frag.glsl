@@ -1,6 +1,7 @@
 #version 450
 layout(location=0) in vec3 vNormal;
 layout(location=1) in vec2 vUV;
+layout(location=2) in float vAO; // 0 fully occluded corner .. 1 open
 layout(location=0) out vec4 outColor;
 
 layout(set=0, binding=2) uniform SceneUBO {
@@ -10,6 +11,6 @@ layout(set=0, binding=2) uniform SceneUBO {
 
 void main(){
   float NdotL = max(dot(normalize(vNormal), normalize(-sceneUBO.lightDir)), 0.0);
-  vec3 color = sceneUBO.baseColor * (0.2 + 0.8 * NdotL);
+  vec3 color = sceneUBO.baseColor * (0.2 + 0.8 * NdotL) * (0.5 + 0.5 * vAO);
   outColor = vec4(color,1.0);
 }
@@ -0,0 +1,30 @@
+#version 450
+// Packed voxel vertex (see PackedVertex in src/mesher.hpp): two words per vertex.
+layout(location=0) in uvec2 inPacked;
+
+layout(set=0, binding=0) uniform CameraUBO {
+  mat4 view;
+  mat4 proj;
+} cameraUBO;
+// Per-draw chunk transform; the packed position is chunk-local.
+layout(std430, set=0, binding=1) readonly buffer DrawData {
+  mat4 model[];
+} drawData;
+
+layout(location=0) out vec3 vNormal;
+layout(location=1) out vec2 vUV;
+layout(location=2) out float vAO;
+
+void main(){
+  uint lo = inPacked.x, hi = inPacked.y;
+  vec3 pos = vec3(lo & 63u, (lo >> 6) & 63u, (lo >> 12) & 63u);
+  uint face = (lo >> 18) & 7u, corner = (lo >> 21) & 3u;
+  vec3 normal = vec3(0.0);
+  normal[face >> 1] = (face & 1u) != 0u ? 1.0 : -1.0;
+  vec2 size = vec2(((hi >> 16) & 31u) + 1u, ((hi >> 21) & 31u) + 1u);
+  mat4 model = drawData.model[gl_InstanceIndex];
+  gl_Position = cameraUBO.proj * cameraUBO.view * model * vec4(pos,1.0);
+  vNormal = mat3(model) * normal;
+  vUV = vec2(corner == 1u || corner == 2u ? size.x : 0.0, corner >= 2u ? size.y : 0.0);
+  vAO = float((lo >> 23) & 3u) / 3.0;
+}
@@ -0,0 +1,15 @@
+#version 450
+// Signed distance field text: the atlas holds 0.5 on glyph outlines, so
+// coverage is a one-pixel ramp around that threshold at any scale.
+layout(location=0) in vec2 vUV;
+layout(location=1) in vec4 vColor;
+layout(location=0) out vec4 outColor;
+
+layout(set=0, binding=0) uniform sampler2D atlas;
+
+void main(){
+  float d = texture(atlas, vUV).r;
+  float w = max(fwidth(d) * 0.5, 1e-4);
+  float coverage = smoothstep(0.5 - w, 0.5 + w, d);
+  outColor = vec4(vColor.rgb, vColor.a * coverage);
+}
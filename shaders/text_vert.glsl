@@ -0,0 +1,21 @@
+#version 450
+// One instance per glyph (GlyphInstance in src/labels.hpp), expanded to a
+// four-vertex strip. Rectangles are in framebuffer pixels, top left origin.
+layout(location=0) in vec4 inRect;  // x0, y0, x1, y1
+layout(location=1) in vec4 inUV;    // u0, v0, u1, v1 (unorm16)
+layout(location=2) in vec4 inColor; // unorm8
+
+layout(push_constant) uniform Text {
+  vec2 pixelToClip; // 2 / framebuffer size
+} text;
+
+layout(location=0) out vec2 vUV;
+layout(location=1) out vec4 vColor;
+
+void main(){
+  vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+  vec2 pos = mix(inRect.xy, inRect.zw, corner);
+  gl_Position = vec4(pos * text.pixelToClip - 1.0, 0.0, 1.0);
+  vUV = mix(inUV.xy, inUV.zw, corner);
+  vColor = inColor;
+}
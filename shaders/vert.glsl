@@ -7,15 +7,20 @@ layout(set=0, binding=0) uniform CameraUBO {
   mat4 view;
   mat4 proj;
 } cameraUBO;
-layout(set=0, binding=1) uniform ModelUBO {
-  mat4 model;
-} modelUBO;
+// One transform per draw, written by the CPU draw list; each indirect command's
+// firstInstance selects its entry, so gl_InstanceIndex is the draw's slot.
+layout(std430, set=0, binding=1) readonly buffer DrawData {
+  mat4 model[];
+} drawData;
 
 layout(location=0) out vec3 vNormal;
 layout(location=1) out vec2 vUV;
+layout(location=2) out float vAO; // the float layout carries no occlusion
 
 void main(){
-  gl_Position = cameraUBO.proj * cameraUBO.view * modelUBO.model * vec4(inPos,1.0);
-  vNormal = mat3(modelUBO.model) * inNormal;
+  mat4 model = drawData.model[gl_InstanceIndex];
+  gl_Position = cameraUBO.proj * cameraUBO.view * model * vec4(inPos,1.0);
+  vNormal = mat3(model) * inNormal;
   vUV = inUV;
+  vAO = 1.0;
 }
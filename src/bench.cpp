@@ -0,0 +1,543 @@
+#include "engine.hpp"
+#include "camera.hpp"
+#include "config.hpp"
+#include "jobs.hpp"
+#include "logging.hpp"
+#include "memory.hpp"
+#include "mesher.hpp"
+#include "perf_report.hpp"
+#include "platform.hpp"
+#include "profiler.hpp"
+#include "renderer.hpp"
+#include "streamed_world.hpp"
+#include "worldgen.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+// Usage: blocco_bench [--list] [--scenario <name>]... [--frames N] [--threads N]
+//                     [--out <results.json>] [--baseline <baseline.json> [--threshold F]]
+//                     [--icd <driver.json>]
+//        blocco_bench --compare <baseline.json> <results.json> [--threshold F]
+// Runs the named scenarios (all of them by default), each in a fresh headless
+// engine whose camera follows a scripted path at a fixed 1/60 s step, so every
+// run renders the same frames whatever the machine. After a few warm-up frames
+// it records, per scenario: frame time (wall clock from one frame to the next),
+// CPU and GPU time as p50/p95/p99, heap allocations per frame, heap, GPU
+// memory, mesh pool and frame arena peaks, and the scenario's own throughput or
+// latency. The results are printed and, with --out, written as JSON.
+// record-scaling sweeps the job system from 1 thread up to --threads (one per
+// core by default) against serial recording of the same draws.
+// --baseline compares them against an earlier --out file and exits with 2 when
+// any metric is worse by more than the threshold (0.1 = 10%, the default) or
+// is missing from a scenario that ran;
+// --compare does the same for two files without running anything. --icd makes
+// the Vulkan loader use only that driver manifest, e.g. Mesa's
+// lvp_icd.x86_64.json, to run on the CPU (lavapipe) without a GPU or network.
+namespace {
+using Clock = std::chrono::steady_clock;
+constexpr float STEP = 1.f/60.f; // the engine's headless timestep
+
+// Heap use of the whole process, counted by the operator new/delete
+// replacements at the end of this file.
+std::atomic<uint64_t> g_allocations{0}, g_allocatedBytes{0};
+std::atomic<int64_t> g_liveBytes{0}, g_peakBytes{0};
+#if defined(__GLIBC__)
+constexpr bool HEAP_TRACKED = true;
+#else
+constexpr bool HEAP_TRACKED = false; // counts only: no portable block size on free
+#endif
+
+void* allocate(size_t bytes, size_t align){
+  if(bytes == 0) bytes = 1;
+#if defined(_WIN32)
+  void* p = _aligned_malloc(bytes, std::max(align, alignof(std::max_align_t)));
+#else
+  void* p = align > alignof(std::max_align_t) ? std::aligned_alloc(align, (bytes + align - 1) / align * align) : std::malloc(bytes);
+#endif
+  if(!p) throw std::bad_alloc();
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  g_allocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+#if defined(__GLIBC__)
+  const auto size = static_cast<int64_t>(malloc_usable_size(p));
+  const int64_t live = g_liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+  int64_t peak = g_peakBytes.load(std::memory_order_relaxed);
+  while(live > peak && !g_peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)){}
+#endif
+  return p;
+}
+
+void deallocate(void* p){
+  if(!p) return;
+#if defined(__GLIBC__)
+  g_liveBytes.fetch_sub(static_cast<int64_t>(malloc_usable_size(p)), std::memory_order_relaxed);
+#endif
+#if defined(_WIN32)
+  _aligned_free(p);
+#else
+  std::free(p);
+#endif
+}
+
+struct HeapCounters {
+  uint64_t allocations{0}, bytes{0};
+};
+HeapCounters heapCounters(){
+  return {g_allocations.load(std::memory_order_relaxed), g_allocatedBytes.load(std::memory_order_relaxed)};
+}
+
+double mb(uint64_t bytes){ return static_cast<double>(bytes)/1.0e6; }
+double msSince(Clock::time_point t0){ return std::chrono::duration<double, std::milli>(Clock::now() - t0).count(); }
+
+// Warnings and errors only: the engine logs every frame at info.
+class QuietSink final : public Log::Sink {
+public:
+  void write(const Log::Entry& entry) override { if(entry.level >= Log::Level::Warn) m_console.write(entry); }
+  void flush() override { m_console.flush(); }
+private:
+  Log::ConsoleSink m_console;
+};
+
+// Runs warmup + frames frames with the camera on the path, calling frame()
+// after each frame's camera has been set, and records the metrics every
+// scenario shares over the frames after the warm-up. The engine sends the view
+// to the renderer before the callback, so the path is applied one step ahead.
+PerfScenario measure(Engine& engine, const std::string& name, int warmup, int frames, const CameraPath& path,
+                     const std::function<void(int frame)>& frame = {}){
+  BLOCCO_ZONE("bench scenario");
+  Renderer& renderer = engine.renderer();
+  const size_t first = renderer.frameStats().size() + static_cast<size_t>(warmup);
+  std::vector<double> frameMs, allocations;
+  uint64_t allocatedBytes = 0;
+  Clock::time_point last;
+  HeapCounters lastHeap;
+  path.apply(0.f, engine.camera());
+  engine.headlessCapture(warmup + frames, [&](JobSystem&, int i){
+    const auto now = Clock::now();
+    const HeapCounters heap = heapCounters();
+    if(i == warmup) g_peakBytes.store(g_liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    if(i > warmup){
+      frameMs.push_back(std::chrono::duration<double, std::milli>(now - last).count());
+      allocations.push_back(static_cast<double>(heap.allocations - lastHeap.allocations));
+      allocatedBytes += heap.bytes - lastHeap.bytes;
+    }
+    last = now;
+    lastHeap = heap;
+    if(frame) frame(i);
+    path.apply(static_cast<float>(i + 1)*STEP, engine.camera());
+  });
+  PerfScenario s;
+  s.name = name;
+  s.frames = frames;
+  std::vector<double> cpu, gpu;
+  const auto& stats = renderer.frameStats();
+  for(size_t f=first; f<stats.size(); ++f){
+    cpu.push_back(stats[f].cpuMs);
+    if(stats[f].gpuMs >= 0.0) gpu.push_back(stats[f].gpuMs);
+  }
+  s.add("frame_ms", percentiles(frameMs));
+  s.add("cpu_ms", percentiles(cpu));
+  if(!gpu.empty()) s.add("gpu_ms", percentiles(gpu)); // no timestamps on this device otherwise
+  s.add("allocations_per_frame", percentiles(allocations));
+  s.add("allocated_kb_per_frame", frameMs.empty() ? 0.0 : static_cast<double>(allocatedBytes)/1024.0/static_cast<double>(frameMs.size()));
+  if(HEAP_TRACKED) s.add("heap_peak_mb", mb(static_cast<uint64_t>(g_peakBytes.load(std::memory_order_relaxed))));
+  const vkutils::GpuMemoryStats gpuMemory = renderer.memoryStats();
+  s.add("gpu_memory_peak_mb", mb(gpuMemory.total.peak));
+  s.add("gpu_allocations", static_cast<double>(gpuMemory.total.allocations));
+  s.add("mesh_pool_peak_mb", mb(renderer.meshMemory().peak));
+  s.add("frame_arena_peak_kb", static_cast<double>(engine.frameArena().stats().peak)/1024.0);
+  return s;
+}
+
+// Seeded terrain, streamed and drawn as blocco_headless --fly-through does.
+void generateChunk(const ChunkCoord& c, Chunk& out){ generateWorld(WorldParams{}, c, out); }
+
+// Streams at the camera's position, a frame at a time and waiting for every
+// job, until nothing is left to generate, mesh, land or swap: scenarios start
+// from a full view however fast the machine is.
+void settle(Engine& engine, StreamedWorld& world){
+  BLOCCO_ZONE("bench settle");
+  for(int i=0;i<2000;++i){
+    engine.headlessCapture(1, [&](JobSystem&, int){ world.streamer().finishJobs(); world.update(engine.camera()); });
+    if(i > 0 && world.settled()) return;
+  }
+  Log::warn("bench: streaming did not settle");
+}
+
+// Chunks streamed per second over the measured frames.
+class StreamRate {
+public:
+  explicit StreamRate(const ChunkStreamer& s) : m_streamer(s), m_generated(s.stats().generated), m_start(Clock::now()) {}
+  double perSecond() const {
+    return static_cast<double>(m_streamer.stats().generated - m_generated) / std::max(msSince(m_start)/1000.0, 1e-9);
+  }
+private:
+  const ChunkStreamer& m_streamer;
+  uint64_t m_generated;
+  Clock::time_point m_start;
+};
+
+// A world region generated and meshed up front, drawn whole every frame from a
+// fixed camera: the draw path with no streaming.
+PerfScenario staticScene(Engine& engine, int frames){
+  Renderer& renderer = engine.renderer();
+  Scene scene;
+  const WorldStats world = generateWorldRegion(engine.jobs(), scene, WorldParams{}, {-3, 0, -3}, {2, 5, 2});
+  std::vector<ChunkCoord> coords;
+  for(const auto& [c, chunk] : scene.chunks()) coords.push_back(c);
+  std::sort(coords.begin(), coords.end(), [](const ChunkCoord& a, const ChunkCoord& b){ return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z); });
+  std::vector<MeshBuffers> buffers(coords.size());
+  const auto t0 = Clock::now();
+  engine.jobs().parallelFor(0, coords.size(), 4, [&](size_t begin, size_t end){
+    thread_local ChunkMesher mesher;
+    for(size_t i=begin;i<end;++i){
+      buffers[i].format = renderer.vertexFormat();
+      mesher.mesh(scene, coords[i], buffers[i]);
+    }
+  });
+  const double meshMs = msSince(t0);
+  std::vector<std::pair<ChunkCoord, Renderer::Mesh>> meshes;
+  uint64_t uploadFailures = 0;
+  for(size_t i=0;i<coords.size();++i){
+    if(buffers[i].empty()) continue;
+    try { meshes.emplace_back(coords[i], renderer.uploadMesh(buffers[i])); }
+    catch(const std::exception&){ ++uploadFailures; }
+  }
+  buffers = {};
+  // Above the region's corner looking across it.
+  const CameraPath path{{0.f, {-112.f, 170.f, -112.f}, -2.356f, -0.45f}};
+  constexpr float N = Chunk::SIZE;
+  PerfScenario s = measure(engine, "static", 30, frames, path, [&](int){
+    for(const auto& [c, mesh] : meshes)
+      renderer.submitDraw(mesh, 0, translate({static_cast<float>(c.x)*N, static_cast<float>(c.y)*N, static_cast<float>(c.z)*N}));
+  });
+  s.add("world_chunks_per_s", world.ms > 0.0 ? world.chunks / (world.ms/1000.0) : 0.0, true);
+  s.add("mesh_chunks_per_s", meshMs > 0.0 ? static_cast<double>(coords.size()) / (meshMs/1000.0) : 0.0, true);
+  s.add("upload_failures", static_cast<double>(uploadFailures));
+  for(auto& [c, mesh] : meshes) renderer.releaseMesh(mesh);
+  return s;
+}
+
+// Streaming along a path that runs straight, climbs through a turn and heads
+// off at right angles, about 128 blocks a second.
+PerfScenario flyThrough(Engine& engine, int frames){
+  StreamingConfig config;
+  config.radius = 6;
+  StreamedWorld world(engine.renderer(), engine.jobs(), generateChunk, config);
+  const CameraPath path{{0.f, {0.f, 120.f, 0.f}, 1.571f, -0.3f}, {4.f, {512.f, 120.f, 0.f}, 1.571f, -0.3f},
+                        {6.f, {640.f, 150.f, 128.f}, 2.356f, -0.2f}, {10.f, {640.f, 110.f, 640.f}, 3.142f, -0.35f}};
+  path.apply(0.f, engine.camera());
+  settle(engine, world);
+  const StreamRate rate(world.streamer());
+  PerfScenario s = measure(engine, "fly-through", 10, frames, path, [&](int){ world.update(engine.camera()); });
+  s.add("streamed_chunks_per_s", rate.perSecond(), true);
+  s.add("upload_failures", static_cast<double>(world.meshes().uploadFailures()));
+  return s;
+}
+
+// A settled view under a slow pan while 16 blocks a frame toggle on the
+// surface within a chunk and a half of the camera: remeshing and mesh swaps.
+PerfScenario editStorm(Engine& engine, int frames){
+  StreamingConfig config;
+  config.radius = 4;
+  StreamedWorld world(engine.renderer(), engine.jobs(), generateChunk, config);
+  const CameraPath path{{0.f, {0.f, 150.f, 0.f}, 0.f, -0.6f}, {10.f, {0.f, 150.f, 0.f}, 0.8f, -0.6f}};
+  path.apply(0.f, engine.camera());
+  settle(engine, world);
+  // Fixed spots just above the surface, found once the view has settled.
+  std::vector<BlockPos> spots;
+  uint32_t seed = 12345;
+  auto next = [&](int range){ seed = seed*1664525u + 1013904223u; return static_cast<int>((seed >> 8) % static_cast<uint32_t>(2*range + 1)) - range; };
+  const Scene& scene = world.scene();
+  while(spots.size() < 512){
+    const int x = next(48), z = next(48);
+    int y = 220;
+    while(y > 0 && scene.getBlock(x, y - 1, z) == BLOCK_AIR) --y;
+    spots.push_back({x, y, z});
+  }
+  constexpr size_t EDITS_PER_FRAME = 16;
+  size_t cursor = 0;
+  const uint64_t dropped = world.streamer().stats().editsDropped;
+  const uint64_t remeshes = world.streamer().stats().remeshes;
+  PerfScenario s = measure(engine, "edit-storm", 10, frames, path, [&](int){
+    for(size_t e=0;e<EDITS_PER_FRAME;++e, ++cursor){
+      const BlockPos& p = spots[cursor % spots.size()];
+      world.streamer().setBlock(p, scene.getBlock(p.x, p.y, p.z) == BLOCK_AIR ? BLOCK_STONE : BLOCK_AIR);
+    }
+    world.update(engine.camera());
+  });
+  s.add("edit_to_draw_ms", percentiles(world.meshes().editToDrawMs()));
+  s.add("remeshes_per_frame", static_cast<double>(world.streamer().stats().remeshes - remeshes) / std::max(frames, 1), true);
+  s.add("edits_dropped", static_cast<double>(world.streamer().stats().editsDropped - dropped));
+  return s;
+}
+
+// Straight along +X at 720 blocks a second, far faster than the view can be
+// filled, with one LOD level past the radius: generation, meshing and upload
+// throughput when streaming can never catch up.
+PerfScenario streamingSprint(Engine& engine, int frames){
+  StreamingConfig config;
+  config.radius = 4;
+  config.lodLevels = 1;
+  StreamedWorld world(engine.renderer(), engine.jobs(), generateChunk, config);
+  const CameraPath path{{0.f, {0.f, 140.f, 0.f}, 1.571f, -0.25f}, {10.f, {7200.f, 140.f, 0.f}, 1.571f, -0.25f}};
+  path.apply(0.f, engine.camera());
+  settle(engine, world);
+  const StreamRate rate(world.streamer());
+  const uint64_t tiles = world.streamer().stats().tilesBuilt;
+  PerfScenario s = measure(engine, "streaming-sprint", 10, frames, path, [&](int){ world.update(engine.camera()); });
+  s.add("streamed_chunks_per_s", rate.perSecond(), true);
+  s.add("tiles_built_per_frame", static_cast<double>(world.streamer().stats().tilesBuilt - tiles) / std::max(frames, 1), true);
+  s.add("upload_failures", static_cast<double>(world.meshes().uploadFailures()));
+  return s;
+}
+
+// The blocco_headless --draws scene: four terrain chunk meshes instanced over
+// a flat grid, viewed from above its near edge. Enough draws that the renderer
+// writes and records them on the job system.
+class DrawGrid {
+public:
+  static constexpr uint32_t DRAWS = 16384;
+  explicit DrawGrid(Renderer& renderer) : m_renderer(renderer) {
+    Scene scene;
+    constexpr int VARIANTS = 4;
+    for(int v=0;v<VARIANTS;++v)
+      for(int x=0;x<Chunk::SIZE;++x) for(int z=0;z<Chunk::SIZE;++z){
+        const int h = 6 + (x*(v+3) + z*(7-v)) % 12;
+        scene.fill({v*Chunk::SIZE + x, 0, z}, {v*Chunk::SIZE + x + 1, h, z + 1}, static_cast<BlockId>(1 + (h > 12)));
+      }
+    ChunkMesher mesher;
+    MeshBuffers buf;
+    buf.format = renderer.vertexFormat();
+    for(int v=0;v<VARIANTS;++v){
+      mesher.mesh(scene, {v, 0, 0}, buf);
+      m_meshes.push_back(renderer.uploadMesh(buf));
+    }
+  }
+  ~DrawGrid(){ for(auto& m : m_meshes) m_renderer.releaseMesh(m); }
+  DrawGrid(const DrawGrid&) = delete;
+  DrawGrid& operator=(const DrawGrid&) = delete;
+  void submit(){
+    const auto side = static_cast<uint32_t>(std::sqrt(static_cast<double>(DRAWS))) + 1;
+    for(uint32_t i=0;i<DRAWS;++i){
+      const Vec3 origin{(static_cast<float>(i % side) - static_cast<float>(side)*0.5f) * Chunk::SIZE, 0.f, static_cast<float>(i / side) * Chunk::SIZE};
+      m_renderer.submitDraw(m_meshes[i % m_meshes.size()], i % 3, translate(origin));
+    }
+  }
+  static CameraPath path(){ return CameraPath{{0.f, {0.f, 120.f, -40.f}, 3.142f, std::atan2(-120.f, 440.f)}}; }
+private:
+  Renderer& m_renderer;
+  std::vector<Renderer::Mesh> m_meshes;
+};
+
+// FrameStats::recordMs of the frames from first on.
+Percentiles recordTimes(Renderer& renderer, size_t first){
+  std::vector<double> ms;
+  const auto& stats = renderer.frameStats();
+  for(size_t f=first; f<stats.size(); ++f) ms.push_back(stats[f].recordMs);
+  return percentiles(std::move(ms));
+}
+
+// Recording the draw grid serially, then on 1 to N job system threads (N from
+// --threads, one per core by default), each thread count in its own engine.
+// Reports record time p50/p99 for each and the speed-up of its p50 over the
+// serial one.
+PerfScenario recordScaling(Engine& engine, int frames){
+  constexpr int WARMUP = 30;
+  Renderer& renderer = engine.renderer();
+  const CameraPath path = DrawGrid::path();
+  PerfScenario s;
+  Percentiles serial;
+  {
+    DrawGrid grid(renderer);
+    renderer.setParallelRecording(false);
+    const size_t first = renderer.frameStats().size() + WARMUP;
+    s = measure(engine, "record-scaling", WARMUP, frames, path, [&](int){ grid.submit(); });
+    renderer.setParallelRecording(true);
+    serial = recordTimes(renderer, first);
+  }
+  s.add("serial_record_ms_p50", serial.p50);
+  s.add("serial_record_ms_p99", serial.p99);
+  const unsigned maxThreads = engine.jobs().threadCount();
+  for(unsigned threads=1; threads<=maxThreads; ++threads){
+    std::unique_ptr<Engine> own;
+    if(threads != maxThreads){
+      Config config = engine.config();
+      config.workerThreads = threads;
+      own = std::make_unique<Engine>(true /*headless*/, config);
+    }
+    Engine& e = own ? *own : engine;
+    Percentiles record;
+    {
+      DrawGrid grid(e.renderer());
+      const size_t first = e.renderer().frameStats().size() + WARMUP;
+      path.apply(0.f, e.camera());
+      e.headlessCapture(WARMUP + frames, [&](JobSystem&, int){ grid.submit(); });
+      record = recordTimes(e.renderer(), first);
+    }
+    e.renderer().waitIdle();
+    const std::string prefix = "record_ms_" + std::to_string(threads) + "t";
+    s.add(prefix + "_p50", record.p50);
+    s.add(prefix + "_p99", record.p99);
+    s.add("speedup_" + std::to_string(threads) + "t", record.p50 > 0.0 ? serial.p50 / record.p50 : 0.0, true);
+  }
+  return s;
+}
+
+struct Scenario {
+  const char* name;
+  const char* description;
+  int frames; // measured, after the warm-up
+  PerfScenario (*run)(Engine&, int frames);
+};
+constexpr Scenario SCENARIOS[] = {
+  {"static", "generated region drawn whole from a fixed camera", 300, staticScene},
+  {"fly-through", "streaming world along a turning path, 128 blocks/s", 600, flyThrough},
+  {"edit-storm", "16 block edits a frame around a settled view", 300, editStorm},
+  {"streaming-sprint", "straight line at 720 blocks/s with one LOD level", 300, streamingSprint},
+  {"record-scaling", "16k draws recorded serially and on 1..N threads", 120, recordScaling},
+};
+
+std::string buildDescription(){
+  std::string s;
+#if defined(__clang__)
+  s = "clang " __clang_version__;
+#elif defined(__GNUC__)
+  s = "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+  s = "msvc " + std::to_string(_MSC_VER);
+#endif
+#if defined(BLOCCO_MATH_AVX2)
+  s += ", avx2";
+#elif defined(BLOCCO_MATH_SSE)
+  s += ", sse2";
+#else
+  s += ", scalar";
+#endif
+#if defined(NDEBUG)
+  s += ", release";
+#else
+  s += ", debug";
+#endif
+  return s;
+}
+
+void printScenario(const PerfScenario& s){
+  std::printf("%s (%d frames)\n", s.name.c_str(), s.frames);
+  for(const PerfMetric& m : s.metrics) std::printf("  %-28s %14.3f\n", m.name.c_str(), m.value);
+}
+
+// Prints every change and returns how many regressed or went missing.
+size_t printComparison(const PerfReport& baseline, const PerfReport& current, const CompareOptions& options){
+  if(baseline.device != current.device) std::printf("note: baseline ran on %s\n", baseline.device.c_str());
+  size_t regressions = 0, missing = 0;
+  std::string scenario;
+  for(const PerfChange& c : compareReports(baseline, current, options)){
+    if(c.scenario != scenario){ scenario = c.scenario; std::printf("%s\n", scenario.c_str()); }
+    if(c.missing) std::printf("  %-28s %14.3f -> %14s  MISSING\n", c.metric.c_str(), c.baseline, "-");
+    else std::printf("  %-28s %14.3f -> %14.3f  %+7.1f%%%s\n", c.metric.c_str(), c.baseline, c.current, c.change*100.0, c.regression ? "  REGRESSED" : "");
+    regressions += c.regression;
+    missing += c.missing;
+  }
+  std::printf("%zu regression%s past %.0f%%, %zu metric%s missing\n", regressions, regressions == 1 ? "" : "s", options.threshold*100.0,
+              missing, missing == 1 ? "" : "s");
+  return regressions + missing;
+}
+} // namespace
+
+int main(int argc, char** argv){
+  try {
+    std::vector<std::string> names, compare;
+    std::string outPath, baselinePath, icd;
+    int frames = 0;
+    CompareOptions options;
+    Config config;
+    for(int i=1;i<argc;++i){
+      const std::string arg = argv[i];
+      if(arg == "--list"){
+        for(const Scenario& s : SCENARIOS) std::printf("%-18s %4d frames  %s\n", s.name, s.frames, s.description);
+        return 0;
+      }
+      else if(arg == "--scenario" && i+1 < argc){ names.push_back(argv[++i]); }
+      else if(arg == "--frames" && i+1 < argc){ frames = std::atoi(argv[++i]); }
+      else if(arg == "--threads" && i+1 < argc){ config.workerThreads = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)); }
+      else if(arg == "--out" && i+1 < argc){ outPath = argv[++i]; }
+      else if(arg == "--baseline" && i+1 < argc){ baselinePath = argv[++i]; }
+      else if(arg == "--threshold" && i+1 < argc){ options.threshold = std::atof(argv[++i]); }
+      else if(arg == "--compare" && i+2 < argc){ compare = {argv[i+1], argv[i+2]}; i += 2; }
+      else if(arg == "--icd" && i+1 < argc){ icd = argv[++i]; }
+      else { std::cerr << "Unknown argument: " << arg << "\n"; return 1; }
+    }
+    if(!compare.empty()){
+      PerfReport baseline, current;
+      std::string error;
+      if(!PerfReport::load(compare[0], baseline, error)) throw std::runtime_error("Failed to read " + compare[0] + ": " + error);
+      if(!PerfReport::load(compare[1], current, error)) throw std::runtime_error("Failed to read " + compare[1] + ": " + error);
+      return printComparison(baseline, current, options) ? 2 : 0;
+    }
+    PerfReport baseline;
+    if(!baselinePath.empty()){
+      std::string error;
+      if(!PerfReport::load(baselinePath, baseline, error)) throw std::runtime_error("Failed to read " + baselinePath + ": " + error);
+    }
+    std::vector<const Scenario*> selected;
+    for(const Scenario& s : SCENARIOS) if(names.empty() || std::find(names.begin(), names.end(), s.name) != names.end()) selected.push_back(&s);
+    for(const std::string& n : names){
+      if(std::none_of(std::begin(SCENARIOS), std::end(SCENARIOS), [&](const Scenario& s){ return n == s.name; })){ std::cerr << "Unknown scenario: " << n << " (see --list)\n"; return 1; }
+    }
+    if(!icd.empty()){
+      // Newer loaders read the first, older ones the second.
+      if(!Platform::setEnvironment("VK_DRIVER_FILES", icd) || !Platform::setEnvironment("VK_ICD_FILENAMES", icd)) throw std::runtime_error("Failed to set the Vulkan driver to " + icd);
+    }
+    Log::clearSinks();
+    Log::addSink(std::make_unique<QuietSink>());
+    PerfReport report;
+    report.build = buildDescription();
+    for(const Scenario* scenario : selected){
+      Engine engine(true /*headless*/, config);
+      if(report.device.empty()) report.device = engine.renderer().deviceName();
+      report.scenarios.push_back(scenario->run(engine, frames > 0 ? frames : scenario->frames));
+      engine.renderer().waitIdle();
+      printScenario(report.scenarios.back());
+    }
+    if(!outPath.empty()){
+      if(!report.save(outPath)) throw std::runtime_error("Failed to write " + outPath);
+      std::printf("results written to %s\n", outPath.c_str());
+    }
+    if(!baselinePath.empty() && printComparison(baseline, report, options)) return 2;
+  } catch(const std::exception& e){
+    Log::flush(); // engine messages before the error
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+// Counting replacements for the global allocation functions; the nothrow
+// forms forward to these.
+void* operator new(size_t bytes){ return allocate(bytes, alignof(std::max_align_t)); }
+void* operator new[](size_t bytes){ return allocate(bytes, alignof(std::max_align_t)); }
+void* operator new(size_t bytes, std::align_val_t align){ return allocate(bytes, static_cast<size_t>(align)); }
+void* operator new[](size_t bytes, std::align_val_t align){ return allocate(bytes, static_cast<size_t>(align)); }
+void operator delete(void* p) noexcept { deallocate(p); }
+void operator delete[](void* p) noexcept { deallocate(p); }
+void operator delete(void* p, size_t) noexcept { deallocate(p); }
+void operator delete[](void* p, size_t) noexcept { deallocate(p); }
+void operator delete(void* p, std::align_val_t) noexcept { deallocate(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { deallocate(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { deallocate(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { deallocate(p); }
@@ -0,0 +1,280 @@
+#include "broadphase.hpp"
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+namespace {
+// Balanced trees stay far below this depth even at millions of leaves.
+constexpr size_t STACK_DEPTH = 256;
+}
+
+AabbTree::AabbTree(float margin):m_margin(margin){}
+
+int32_t AabbTree::allocNode(){
+  if(m_free < 0){
+    m_nodes.emplace_back();
+    return static_cast<int32_t>(m_nodes.size()-1);
+  }
+  const int32_t n = m_free;
+  m_free = m_nodes[static_cast<size_t>(n)].parent;
+  m_nodes[static_cast<size_t>(n)] = Node{};
+  return n;
+}
+
+void AabbTree::freeNode(int32_t n){
+  Node& node = m_nodes[static_cast<size_t>(n)];
+  node.parent = m_free;
+  node.height = -1;
+  m_free = n;
+}
+
+void AabbTree::clear(){
+  m_nodes.clear(); m_root = -1; m_free = -1; m_leafCount = 0;
+}
+
+int32_t AabbTree::insert(const AABB& box, uint32_t id){
+  const int32_t leaf = allocNode();
+  Node& n = m_nodes[static_cast<size_t>(leaf)];
+  const Vec3 r{m_margin, m_margin, m_margin};
+  n.tight = box;
+  n.fat = {box.min - r, box.max + r};
+  n.id = id;
+  n.height = 0;
+  insertLeaf(leaf);
+  ++m_leafCount;
+  return leaf;
+}
+
+void AabbTree::remove(int32_t proxy){
+  removeLeaf(proxy);
+  freeNode(proxy);
+  --m_leafCount;
+}
+
+bool AabbTree::move(int32_t proxy, const AABB& box){
+  Node& n = m_nodes[static_cast<size_t>(proxy)];
+  n.tight = box;
+  if(contains(n.fat, box)) return false;
+  removeLeaf(proxy);
+  const Vec3 r{m_margin, m_margin, m_margin};
+  m_nodes[static_cast<size_t>(proxy)].fat = {box.min - r, box.max + r};
+  insertLeaf(proxy);
+  return true;
+}
+
+void AabbTree::insertLeaf(int32_t leaf){
+  if(m_root < 0){ m_root = leaf; m_nodes[static_cast<size_t>(leaf)].parent = -1; return; }
+  // Descend choosing the child with the lowest surface-area cost increase.
+  const AABB leafBox = m_nodes[static_cast<size_t>(leaf)].fat;
+  int32_t index = m_root;
+  while(!m_nodes[static_cast<size_t>(index)].leaf()){
+    const Node& n = m_nodes[static_cast<size_t>(index)];
+    const float area = surfaceArea(n.fat);
+    const float combined = surfaceArea(merge(n.fat, leafBox));
+    const float cost = 2.f*combined;
+    const float inherit = 2.f*(combined - area);
+    float childCost[2];
+    for(int c=0;c<2;++c){
+      const Node& ch = m_nodes[static_cast<size_t>(n.child[c])];
+      const float merged = surfaceArea(merge(ch.fat, leafBox));
+      childCost[c] = (ch.leaf() ? merged : merged - surfaceArea(ch.fat)) + inherit;
+    }
+    if(cost < childCost[0] && cost < childCost[1]) break;
+    index = childCost[0] < childCost[1] ? n.child[0] : n.child[1];
+  }
+  const int32_t sibling = index;
+  const int32_t oldParent = m_nodes[static_cast<size_t>(sibling)].parent;
+  const int32_t newParent = allocNode();
+  Node& p = m_nodes[static_cast<size_t>(newParent)];
+  p.parent = oldParent;
+  p.fat = merge(leafBox, m_nodes[static_cast<size_t>(sibling)].fat);
+  p.height = m_nodes[static_cast<size_t>(sibling)].height + 1;
+  p.child[0] = sibling; p.child[1] = leaf;
+  if(oldParent >= 0){
+    Node& op = m_nodes[static_cast<size_t>(oldParent)];
+    op.child[op.child[0]==sibling ? 0 : 1] = newParent;
+  } else {
+    m_root = newParent;
+  }
+  m_nodes[static_cast<size_t>(sibling)].parent = newParent;
+  m_nodes[static_cast<size_t>(leaf)].parent = newParent;
+  fixUpwards(newParent);
+}
+
+void AabbTree::removeLeaf(int32_t leaf){
+  if(leaf == m_root){ m_root = -1; return; }
+  const int32_t parent = m_nodes[static_cast<size_t>(leaf)].parent;
+  const Node& p = m_nodes[static_cast<size_t>(parent)];
+  const int32_t grand = p.parent;
+  const int32_t sibling = p.child[0]==leaf ? p.child[1] : p.child[0];
+  if(grand >= 0){
+    Node& g = m_nodes[static_cast<size_t>(grand)];
+    g.child[g.child[0]==parent ? 0 : 1] = sibling;
+    m_nodes[static_cast<size_t>(sibling)].parent = grand;
+    freeNode(parent);
+    fixUpwards(grand);
+  } else {
+    m_root = sibling;
+    m_nodes[static_cast<size_t>(sibling)].parent = -1;
+    freeNode(parent);
+  }
+}
+
+void AabbTree::fixUpwards(int32_t index){
+  while(index >= 0){
+    index = balance(index);
+    Node& n = m_nodes[static_cast<size_t>(index)];
+    const Node& c0 = m_nodes[static_cast<size_t>(n.child[0])];
+    const Node& c1 = m_nodes[static_cast<size_t>(n.child[1])];
+    n.height = 1 + std::max(c0.height, c1.height);
+    n.fat = merge(c0.fat, c1.fat);
+    index = n.parent;
+  }
+}
+
+// Single tree rotation when the children heights differ by more than one.
+int32_t AabbTree::balance(int32_t iA){
+  Node& A = m_nodes[static_cast<size_t>(iA)];
+  if(A.leaf() || A.height < 2) return iA;
+  const int32_t iB = A.child[0], iC = A.child[1];
+  const int32_t diff = m_nodes[static_cast<size_t>(iC)].height - m_nodes[static_cast<size_t>(iB)].height;
+  if(diff >= -1 && diff <= 1) return iA;
+  // Rotate the taller child (iUp) above A.
+  const int32_t iUp = diff > 0 ? iC : iB;
+  const int32_t iKeep = diff > 0 ? iB : iC;
+  Node& U = m_nodes[static_cast<size_t>(iUp)];
+  const int32_t iF = U.child[0], iG = U.child[1];
+  U.child[0] = iA;
+  U.parent = A.parent;
+  A.parent = iUp;
+  if(U.parent >= 0){
+    Node& up = m_nodes[static_cast<size_t>(U.parent)];
+    up.child[up.child[0]==iA ? 0 : 1] = iUp;
+  } else {
+    m_root = iUp;
+  }
+  Node& F = m_nodes[static_cast<size_t>(iF)];
+  Node& G = m_nodes[static_cast<size_t>(iG)];
+  const Node& K = m_nodes[static_cast<size_t>(iKeep)];
+  // The shorter grandchild moves under A next to the kept child.
+  const bool moveG = F.height > G.height;
+  const int32_t iStay = moveG ? iF : iG, iMove = moveG ? iG : iF;
+  Node& S = m_nodes[static_cast<size_t>(iStay)];
+  Node& M = m_nodes[static_cast<size_t>(iMove)];
+  U.child[1] = iStay;
+  A.child[0] = iKeep; A.child[1] = iMove;
+  M.parent = iA;
+  A.fat = merge(K.fat, M.fat);
+  A.height = 1 + std::max(K.height, M.height);
+  U.fat = merge(A.fat, S.fat);
+  U.height = 1 + std::max(A.height, S.height);
+  return iUp;
+}
+
+void AabbTree::rebuild(){
+  std::vector<int32_t> leaves;
+  leaves.reserve(m_leafCount);
+  for(size_t i=0;i<m_nodes.size();++i){
+    Node& n = m_nodes[i];
+    if(n.height < 0) continue;
+    if(n.leaf()){ n.parent = -1; leaves.push_back(static_cast<int32_t>(i)); }
+    else freeNode(static_cast<int32_t>(i));
+  }
+  m_root = leaves.empty() ? -1 : buildRange(leaves, 0, leaves.size());
+}
+
+int32_t AabbTree::buildRange(std::vector<int32_t>& leaves, size_t begin, size_t end){
+  if(end - begin == 1) return leaves[begin];
+  AABB bounds = m_nodes[static_cast<size_t>(leaves[begin])].fat;
+  for(size_t i=begin+1;i<end;++i) bounds = merge(bounds, m_nodes[static_cast<size_t>(leaves[i])].fat);
+  const Vec3 ext = bounds.max - bounds.min;
+  const int axis = (ext.x >= ext.y && ext.x >= ext.z) ? 0 : (ext.y >= ext.z ? 1 : 2);
+  auto centre = [&](int32_t l){
+    const AABB& b = m_nodes[static_cast<size_t>(l)].fat;
+    return axis==0 ? b.min.x+b.max.x : axis==1 ? b.min.y+b.max.y : b.min.z+b.max.z;
+  };
+  const size_t mid = begin + (end-begin)/2;
+  std::nth_element(leaves.begin()+static_cast<std::ptrdiff_t>(begin), leaves.begin()+static_cast<std::ptrdiff_t>(mid),
+                   leaves.begin()+static_cast<std::ptrdiff_t>(end), [&](int32_t a, int32_t b){ return centre(a) < centre(b); });
+  const int32_t l = buildRange(leaves, begin, mid);
+  const int32_t r = buildRange(leaves, mid, end);
+  const int32_t n = allocNode();
+  Node& node = m_nodes[static_cast<size_t>(n)];
+  node.child[0] = l; node.child[1] = r;
+  node.fat = merge(m_nodes[static_cast<size_t>(l)].fat, m_nodes[static_cast<size_t>(r)].fat);
+  node.height = 1 + std::max(m_nodes[static_cast<size_t>(l)].height, m_nodes[static_cast<size_t>(r)].height);
+  m_nodes[static_cast<size_t>(l)].parent = n;
+  m_nodes[static_cast<size_t>(r)].parent = n;
+  return n;
+}
+
+size_t AabbTree::query(const AABB& box, std::span<uint32_t> out) const {
+  if(m_root < 0) return 0;
+  std::array<int32_t, STACK_DEPTH> stack;
+  size_t sp = 0, count = 0;
+  stack[sp++] = m_root;
+  while(sp){
+    const Node& n = m_nodes[static_cast<size_t>(stack[--sp])];
+    if(!intersect(n.fat, box)) continue;
+    if(n.leaf()){
+      if(!intersect(n.tight, box)) continue;
+      if(count < out.size()) out[count] = n.id;
+      ++count;
+    } else {
+      assert(sp + 2 <= STACK_DEPTH);
+      stack[sp++] = n.child[0];
+      stack[sp++] = n.child[1];
+    }
+  }
+  return count;
+}
+
+size_t AabbTree::queryPairs(std::span<BroadphasePair> out) const {
+  if(m_root < 0) return 0;
+  std::array<int32_t, STACK_DEPTH> stack;
+  size_t count = 0;
+  for(size_t i=0;i<m_nodes.size();++i){
+    const Node& leaf = m_nodes[i];
+    if(leaf.height != 0) continue;
+    size_t sp = 0;
+    stack[sp++] = m_root;
+    while(sp){
+      const int32_t idx = stack[--sp];
+      const Node& n = m_nodes[static_cast<size_t>(idx)];
+      if(!intersect(n.fat, leaf.tight)) continue;
+      if(n.leaf()){
+        // Each pair is reported once, from its lower proxy index.
+        if(static_cast<size_t>(idx) <= i || !intersect(n.tight, leaf.tight)) continue;
+        if(count < out.size()) out[count] = {leaf.id, n.id};
+        ++count;
+      } else {
+        assert(sp + 2 <= STACK_DEPTH);
+        stack[sp++] = n.child[0];
+        stack[sp++] = n.child[1];
+      }
+    }
+  }
+  return count;
+}
+
+size_t AabbTree::raycast(const Ray& ray, float maxT, std::span<RayHit> out) const {
+  if(m_root < 0) return 0;
+  std::array<int32_t, STACK_DEPTH> stack;
+  size_t sp = 0, count = 0;
+  stack[sp++] = m_root;
+  while(sp){
+    const Node& n = m_nodes[static_cast<size_t>(stack[--sp])];
+    float t = 0.f;
+    if(!intersectRay(n.fat, ray, maxT, t)) continue;
+    if(n.leaf()){
+      if(!intersectRay(n.tight, ray, maxT, t)) continue;
+      if(count < out.size()) out[count] = {n.id, t};
+      ++count;
+    } else {
+      assert(sp + 2 <= STACK_DEPTH);
+      stack[sp++] = n.child[0];
+      stack[sp++] = n.child[1];
+    }
+  }
+  return count;
+}
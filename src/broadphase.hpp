@@ -0,0 +1,59 @@
+#pragma once
+#include "collision.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+struct BroadphasePair { uint32_t a, b; };
+struct RayHit { uint32_t id; float t; };
+
+// Dynamic AABB tree for broadphase queries. Leaves keep the tight box for
+// exact results plus a fattened box so small motions do not touch the tree.
+// Queries write into caller-provided spans and return the total hit count,
+// which may exceed the span size (only the first out.size() are written).
+class AabbTree {
+public:
+  explicit AabbTree(float margin = 0.1f);
+
+  int32_t insert(const AABB& box, uint32_t id);
+  void remove(int32_t proxy);
+  // Updates the tight box; reinserts only when it leaves the fat box. Returns true on reinsert.
+  bool move(int32_t proxy, const AABB& box);
+  // Rebuild the whole hierarchy top-down from current leaves (median split on the longest axis).
+  void rebuild();
+  void clear();
+
+  uint32_t id(int32_t proxy) const { return m_nodes[static_cast<size_t>(proxy)].id; }
+  const AABB& box(int32_t proxy) const { return m_nodes[static_cast<size_t>(proxy)].tight; }
+  size_t size() const { return m_leafCount; }
+  int height() const { return m_root < 0 ? 0 : m_nodes[static_cast<size_t>(m_root)].height; }
+
+  size_t query(const AABB& box, std::span<uint32_t> out) const;
+  size_t queryPairs(std::span<BroadphasePair> out) const;
+  size_t raycast(const Ray& ray, float maxT, std::span<RayHit> out) const;
+
+private:
+  struct Node {
+    AABB fat;
+    AABB tight;
+    int32_t parent{-1};
+    int32_t child[2]{-1, -1};
+    int32_t height{0}; // 0 = leaf, -1 = free
+    uint32_t id{0};
+    bool leaf() const { return child[0] < 0; }
+  };
+  int32_t allocNode();
+  void freeNode(int32_t n);
+  void insertLeaf(int32_t leaf);
+  void removeLeaf(int32_t leaf);
+  int32_t balance(int32_t a);
+  void fixUpwards(int32_t n);
+  int32_t buildRange(std::vector<int32_t>& leaves, size_t begin, size_t end);
+
+  std::vector<Node> m_nodes;
+  int32_t m_root{-1};
+  int32_t m_free{-1};
+  size_t m_leafCount{0};
+  float m_margin;
+};
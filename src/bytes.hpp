@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+// Little cursor helpers for the on-disk caches: copy trivially copyable values
+// in and out of a byte buffer at `at`, advancing it. Every copy is checked
+// against the buffer's size, so an encoder that sized its buffer wrong or a
+// decoder reading past what it validated throws std::runtime_error instead of
+// running off the end (and an empty buffer's null data() is never touched).
+namespace Bytes {
+inline uint8_t* reserve(std::span<uint8_t> out, size_t& at, size_t size){
+  if(at > out.size() || out.size() - at < size) throw std::runtime_error("Bytes: write past the end of the buffer");
+  uint8_t* p = out.data() + at;
+  at += size;
+  return p;
+}
+
+inline const uint8_t* consume(std::span<const uint8_t> in, size_t& at, size_t size){
+  if(at > in.size() || in.size() - at < size) throw std::runtime_error("Bytes: read past the end of the buffer");
+  const uint8_t* p = in.data() + at;
+  at += size;
+  return p;
+}
+
+template<class T> void put(std::span<uint8_t> out, size_t& at, const T& v){
+  static_assert(std::is_trivially_copyable_v<T>);
+  std::memcpy(reserve(out, at, sizeof(T)), &v, sizeof(T));
+}
+
+inline void putBytes(std::span<uint8_t> out, size_t& at, std::span<const uint8_t> bytes){
+  if(bytes.empty()) return;
+  std::memcpy(reserve(out, at, bytes.size()), bytes.data(), bytes.size());
+}
+
+template<class T> T get(std::span<const uint8_t> in, size_t& at){
+  static_assert(std::is_trivially_copyable_v<T>);
+  T v;
+  std::memcpy(&v, consume(in, at, sizeof(T)), sizeof(T));
+  return v;
+}
+}
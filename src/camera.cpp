@@ -1,2 +1,53 @@
 #include "camera.hpp"
-// TODO: implement view/projection helpers
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+Vec3 Camera::forward() const {
+  const float cp = std::cos(pitch);
+  return {std::sin(yaw)*cp, std::sin(pitch), -std::cos(yaw)*cp};
+}
+
+Vec3 Camera::right() const {
+  return {std::cos(yaw), 0.f, std::sin(yaw)};
+}
+
+Mat4 Camera::view() const {
+  const Vec3 f = forward();
+  const Vec3 s = right();
+  const Vec3 u = cross(s, f);
+  Mat4 r = identity();
+  r.m[0]=s.x; r.m[4]=s.y; r.m[8]=s.z;
+  r.m[1]=u.x; r.m[5]=u.y; r.m[9]=u.z;
+  r.m[2]=-f.x; r.m[6]=-f.y; r.m[10]=-f.z;
+  r.m[12]=-dot(s,position); r.m[13]=-dot(u,position); r.m[14]=dot(f,position);
+  return r;
+}
+
+Mat4 Camera::projection(float aspect) const {
+  return perspective(fovY, aspect, zNear, zFar);
+}
+
+Frustum Camera::frustum(float aspect) const {
+  return extractFrustum(projection(aspect) * view());
+}
+
+CameraPath::CameraPath(std::initializer_list<CameraKey> keys){
+  for(const CameraKey& k : keys) add(k);
+}
+
+void CameraPath::add(const CameraKey& key){
+  if(!m_keys.empty() && key.time <= m_keys.back().time) throw std::runtime_error("Failed to add camera key: times must increase");
+  m_keys.push_back(key);
+}
+
+void CameraPath::apply(float time, Camera& camera) const {
+  if(m_keys.empty()) return;
+  const auto next = std::upper_bound(m_keys.begin(), m_keys.end(), time, [](float t, const CameraKey& k){ return t < k.time; });
+  const CameraKey& b = next == m_keys.end() ? m_keys.back() : *next;
+  const CameraKey& a = next == m_keys.begin() ? b : *std::prev(next);
+  const float t = b.time > a.time ? std::clamp((time - a.time) / (b.time - a.time), 0.f, 1.f) : 0.f;
+  camera.position = a.position + (b.position - a.position)*t;
+  camera.yaw = a.yaw + (b.yaw - a.yaw)*t;
+  camera.pitch = a.pitch + (b.pitch - a.pitch)*t;
+}
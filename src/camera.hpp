@@ -1,7 +1,43 @@
 #pragma once
 #include "math.hpp"
+#include <initializer_list>
+#include <vector>
+// First-person camera. yaw 0 looks down -Z and positive yaw turns towards +X;
+// positive pitch looks up. Angles are in radians.
 struct Camera {
   Vec3 position{0,1.6f,0};
   float pitch{0};
   float yaw{0};
+  float fovY{1.2f};
+  float zNear{0.1f};
+  float zFar{4000.f};
+
+  Vec3 forward() const;
+  Vec3 right() const;
+  // Built from the angles directly, so looking straight up or down stays well defined.
+  Mat4 view() const;
+  Mat4 projection(float aspect) const;
+  Frustum frustum(float aspect) const;
+};
+
+// A scripted flight for benchmarks and captures: keys at increasing times (in
+// seconds), with position and angles interpolated linearly between them and
+// held before the first and after the last. Sampled at fixed steps, it
+// replays the same frames on every run.
+struct CameraKey {
+  float time{0};
+  Vec3 position{};
+  float yaw{0};
+  float pitch{0};
+};
+
+class CameraPath {
+public:
+  CameraPath() = default;
+  CameraPath(std::initializer_list<CameraKey> keys);
+  void add(const CameraKey& key); // after the last key
+  float duration() const { return m_keys.empty() ? 0.f : m_keys.back().time; }
+  void apply(float time, Camera& camera) const;
+private:
+  std::vector<CameraKey> m_keys;
 };
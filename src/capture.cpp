@@ -1,3 +1,417 @@
 #include "capture.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
-void Capture::savePNGDummy(const std::string& path){ std::ofstream f(path, std::ios::binary); if(f) f << "PNG"; }
+
+namespace {
+// ---- deflate (RFC 1951), fixed Huffman codes only -------------------------
+
+constexpr uint32_t WINDOW = 32768;
+constexpr uint32_t MIN_MATCH = 4; // hash probes compare 4 bytes
+constexpr uint32_t MAX_MATCH = 258;
+constexpr int HASH_BITS = 15;
+
+constexpr uint16_t LEN_BASE[29] = {3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258};
+constexpr uint8_t LEN_EXTRA[29] = {0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0};
+constexpr uint16_t DIST_BASE[30] = {1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577};
+constexpr uint8_t DIST_EXTRA[30] = {0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
+
+constexpr uint32_t reverseBits(uint32_t v, int n){
+  uint32_t r = 0;
+  for(int i=0;i<n;++i){ r = (r << 1) | (v & 1u); v >>= 1; }
+  return r;
+}
+
+// Huffman codes go out MSB-first inside an LSB-first bit stream, so codes are
+// stored pre-reversed; match lengths are fused with their extra bits.
+struct Code { uint32_t bits; uint32_t count; };
+struct DeflateTables {
+  std::array<Code, 288> lit{};
+  std::array<Code, MAX_MATCH+1> len{};
+  std::array<uint8_t, 512> distCode{}; // zlib's split lookup: d-1 < 256, else 256 + ((d-1) >> 7)
+};
+constexpr DeflateTables makeTables(){
+  DeflateTables t;
+  for(uint32_t s=0;s<288;++s){
+    if(s < 144) t.lit[s] = {reverseBits(0x30 + s, 8), 8};
+    else if(s < 256) t.lit[s] = {reverseBits(0x190 + s - 144, 9), 9};
+    else if(s < 280) t.lit[s] = {reverseBits(s - 256, 7), 7};
+    else t.lit[s] = {reverseBits(0xC0 + s - 280, 8), 8};
+  }
+  for(uint32_t l=3;l<=MAX_MATCH;++l){
+    uint32_t c = 28;
+    while(LEN_BASE[c] > l) --c;
+    const Code sym = t.lit[257 + c];
+    t.len[l] = {sym.bits | ((l - LEN_BASE[c]) << sym.count), sym.count + LEN_EXTRA[c]};
+  }
+  for(uint32_t c=0;c<30;++c){
+    for(uint32_t d=DIST_BASE[c]; d < (c+1 < 30 ? DIST_BASE[c+1] : WINDOW+1u); ++d){
+      const uint32_t k = d-1 < 256 ? d-1 : 256 + ((d-1) >> 7);
+      t.distCode[k] = static_cast<uint8_t>(c);
+    }
+  }
+  return t;
+}
+constexpr DeflateTables TABLES = makeTables();
+
+class BitWriter {
+public:
+  explicit BitWriter(uint8_t* out):m_out(out), m_begin(out){}
+  void put(uint32_t bits, uint32_t count){
+    m_acc |= uint64_t{bits} << m_count;
+    m_count += count;
+    if(m_count >= 32){
+      for(int i=0;i<4;++i){ *m_out++ = static_cast<uint8_t>(m_acc); m_acc >>= 8; }
+      m_count -= 32;
+    }
+  }
+  size_t finish(){
+    while(m_count > 0){ *m_out++ = static_cast<uint8_t>(m_acc); m_acc >>= 8; m_count = m_count > 8 ? m_count-8 : 0; }
+    return static_cast<size_t>(m_out - m_begin);
+  }
+private:
+  uint8_t* m_out;
+  uint8_t* m_begin;
+  uint64_t m_acc{0};
+  uint32_t m_count{0};
+};
+
+uint32_t load32(const uint8_t* p){ uint32_t v; std::memcpy(&v, p, 4); return v; }
+uint64_t load64(const uint8_t* p){ uint64_t v; std::memcpy(&v, p, 8); return v; }
+
+uint32_t matchLength(const uint8_t* a, const uint8_t* b, uint32_t len, uint32_t max){
+  if constexpr(std::endian::native == std::endian::little){
+    while(len + 8 <= max){
+      const uint64_t x = load64(a+len) ^ load64(b+len);
+      if(x) return len + static_cast<uint32_t>(std::countr_zero(x)) / 8;
+      len += 8;
+    }
+  }
+  while(len < max && a[len] == b[len]) ++len;
+  return len;
+}
+
+// Greedy LZ77 with one hash probe per position and no chains: one fixed-Huffman block.
+size_t deflateFast(const uint8_t* src, size_t n, uint8_t* out){
+  std::vector<uint32_t> head(size_t{1} << HASH_BITS, 0);
+  BitWriter bw(out);
+  bw.put(0b011, 3); // BFINAL=1, BTYPE=01 (fixed)
+  size_t i = 0;
+  while(i + MIN_MATCH <= n){
+    const uint32_t v = load32(src+i);
+    const uint32_t h = (v * 2654435761u) >> (32 - HASH_BITS);
+    const size_t cand = head[h];
+    head[h] = static_cast<uint32_t>(i);
+    if(cand < i && i - cand <= WINDOW && load32(src+cand) == v){
+      const auto max = static_cast<uint32_t>(std::min<size_t>(MAX_MATCH, n - i));
+      const uint32_t len = matchLength(src+i, src+cand, MIN_MATCH, max);
+      const auto dist = static_cast<uint32_t>(i - cand);
+      const Code& lc = TABLES.len[len];
+      bw.put(lc.bits, lc.count);
+      const uint32_t dc = TABLES.distCode[dist-1 < 256 ? dist-1 : 256 + ((dist-1) >> 7)];
+      bw.put(reverseBits(dc, 5) | ((dist - DIST_BASE[dc]) << 5), 5u + DIST_EXTRA[dc]);
+      i += len;
+    } else {
+      const Code& c = TABLES.lit[src[i]];
+      bw.put(c.bits, c.count);
+      ++i;
+    }
+  }
+  for(; i<n; ++i){ const Code& c = TABLES.lit[src[i]]; bw.put(c.bits, c.count); }
+  bw.put(TABLES.lit[256].bits, TABLES.lit[256].count);
+  return bw.finish();
+}
+
+uint32_t adler32(const uint8_t* p, size_t n){
+  uint32_t a = 1, b = 0;
+  while(n){
+    const size_t k = std::min<size_t>(n, 5552); // largest block before b can overflow
+    size_t i = 0;
+    // 16 bytes at a time: b gains 16*a plus the position-weighted byte sum, which breaks the serial chain.
+    for(; i+16<=k; i+=16){
+      uint32_t sum = 0, weighted = 0;
+      for(uint32_t j=0;j<16;++j){ sum += p[i+j]; weighted += (16-j) * p[i+j]; }
+      b += 16*a + weighted;
+      a += sum;
+    }
+    for(; i<k; ++i){ a += p[i]; b += a; }
+    a %= 65521; b %= 65521;
+    p += k; n -= k;
+  }
+  return (b << 16) | a;
+}
+
+// Slicing-by-8 tables: CRC of one byte followed by k zero bytes in table k.
+using CrcTables = std::array<std::array<uint32_t, 256>, 8>;
+constexpr CrcTables makeCrcTables(){
+  CrcTables t{};
+  for(uint32_t i=0;i<256;++i){
+    uint32_t c = i;
+    for(int k=0;k<8;++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+    t[0][i] = c;
+  }
+  for(size_t k=1;k<8;++k) for(size_t i=0;i<256;++i) t[k][i] = (t[k-1][i] >> 8) ^ t[0][t[k-1][i] & 0xFF];
+  return t;
+}
+constexpr CrcTables CRC_TABLES = makeCrcTables();
+
+uint32_t crc32(const uint8_t* p, size_t n, uint32_t crc = 0){
+  crc = ~crc;
+  if constexpr(std::endian::native == std::endian::little){
+    for(; n>=8; p+=8, n-=8){
+      const uint64_t v = load64(p) ^ crc;
+      crc = CRC_TABLES[7][v & 0xFF] ^ CRC_TABLES[6][(v >> 8) & 0xFF] ^ CRC_TABLES[5][(v >> 16) & 0xFF] ^ CRC_TABLES[4][(v >> 24) & 0xFF] ^
+            CRC_TABLES[3][(v >> 32) & 0xFF] ^ CRC_TABLES[2][(v >> 40) & 0xFF] ^ CRC_TABLES[1][(v >> 48) & 0xFF] ^ CRC_TABLES[0][v >> 56];
+    }
+  }
+  for(size_t i=0;i<n;++i) crc = CRC_TABLES[0][(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+void putBE32(std::vector<uint8_t>& out, uint32_t v){
+  for(int s=24;s>=0;s-=8) out.push_back(static_cast<uint8_t>(v >> s));
+}
+
+void putChunk(std::vector<uint8_t>& out, const char type[4], const uint8_t* data, size_t n){
+  putBE32(out, static_cast<uint32_t>(n));
+  const size_t start = out.size();
+  out.insert(out.end(), type, type+4);
+  out.insert(out.end(), data, data+n);
+  putBE32(out, crc32(out.data()+start, n+4));
+}
+
+// ---- QOI ------------------------------------------------------------------
+
+constexpr uint8_t QOI_OP_INDEX = 0x00, QOI_OP_DIFF = 0x40, QOI_OP_LUMA = 0x80, QOI_OP_RUN = 0xC0;
+constexpr uint8_t QOI_OP_RGB = 0xFE, QOI_OP_RGBA = 0xFF, QOI_MASK = 0xC0;
+constexpr uint8_t QOI_END[8] = {0,0,0,0,0,0,0,1};
+
+// ---- shared ----------------------------------------------------------------
+
+// Per-thread scratch reused across frames: a fresh 1080p buffer costs more in
+// page faults and zero-fill than the encode itself.
+thread_local std::vector<uint8_t> t_filtered;
+thread_local std::vector<uint8_t> t_encoded;
+uint8_t* scratch(std::vector<uint8_t>& v, size_t n){
+  if(v.size() < n) v.resize(n);
+  return v.data();
+}
+
+// Bytewise a - b on eight lanes at once (no borrow crosses a byte).
+uint64_t subBytes(uint64_t a, uint64_t b){
+  constexpr uint64_t H = 0x8080808080808080ull;
+  return ((a | H) - (b & ~H)) ^ ((a ^ ~b) & H);
+}
+
+struct Px { uint8_t r, g, b, a; bool operator==(const Px&) const = default; };
+uint32_t qoiHash(const Px& p){ return (p.r*3u + p.g*5u + p.b*7u + p.a*11u) % 64u; }
+}
+
+namespace Capture {
+
+std::vector<uint8_t> encodePNG(const ImageView& image){
+  const size_t rowBytes = size_t{image.width} * 4;
+  const size_t rawSize = (rowBytes + 1) * image.height;
+  // Up filter: cheap, and turns vertically coherent frames into zero runs.
+  uint8_t* raw = scratch(t_filtered, rawSize);
+  for(uint32_t y=0;y<image.height;++y){
+    uint8_t* dst = raw + y*(rowBytes+1);
+    const uint8_t* row = image.rgba + y*image.stride;
+    dst[0] = 2;
+    if(y == 0){ std::memcpy(dst+1, row, rowBytes); continue; }
+    const uint8_t* prev = row - image.stride;
+    size_t x = 0;
+    for(; x+8<=rowBytes; x+=8){
+      const uint64_t d = subBytes(load64(row+x), load64(prev+x));
+      std::memcpy(dst+1+x, &d, 8);
+    }
+    for(; x<rowBytes; ++x) dst[1+x] = static_cast<uint8_t>(row[x] - prev[x]);
+  }
+  // zlib stream: 2-byte header, deflate data (at most 9 bits per literal), adler32.
+  uint8_t* z = scratch(t_encoded, 2 + rawSize + rawSize/8 + 64);
+  z[0] = 0x78; z[1] = 0x01;
+  size_t zn = 2 + deflateFast(raw, rawSize, z+2);
+  const uint32_t adler = adler32(raw, rawSize);
+  for(int s=24;s>=0;s-=8) z[zn++] = static_cast<uint8_t>(adler >> s);
+
+  static constexpr uint8_t SIGNATURE[8] = {0x89,'P','N','G','\r','\n',0x1A,'\n'};
+  std::vector<uint8_t> out(SIGNATURE, SIGNATURE+8);
+  out.reserve(zn + 64);
+  std::vector<uint8_t> ihdr;
+  putBE32(ihdr, image.width); putBE32(ihdr, image.height);
+  ihdr.insert(ihdr.end(), {8, 6, 0, 0, 0}); // 8-bit RGBA, deflate, adaptive filters, no interlace
+  putChunk(out, "IHDR", ihdr.data(), ihdr.size());
+  putChunk(out, "IDAT", z, zn);
+  putChunk(out, "IEND", nullptr, 0);
+  return out;
+}
+
+std::vector<uint8_t> encodeQOI(const ImageView& image){
+  const size_t pixels = size_t{image.width} * image.height;
+  uint8_t* const begin = scratch(t_encoded, 14 + pixels*5 + sizeof(QOI_END));
+  uint8_t* p = begin;
+  std::memcpy(p, "qoif", 4); p += 4;
+  for(uint32_t v : {image.width, image.height}) for(int s=24;s>=0;s-=8) *p++ = static_cast<uint8_t>(v >> s);
+  *p++ = 4; *p++ = 0; // RGBA, sRGB with linear alpha
+  Px index[64]{};
+  Px prev{0, 0, 0, 255};
+  uint32_t run = 0;
+  for(uint32_t y=0;y<image.height;++y){
+    const uint8_t* row = image.rgba + y*image.stride;
+    for(uint32_t x=0;x<image.width;++x){
+      const Px px{row[x*4], row[x*4+1], row[x*4+2], row[x*4+3]};
+      if(px == prev){
+        if(++run == 62){ *p++ = static_cast<uint8_t>(QOI_OP_RUN | (run-1)); run = 0; }
+        continue;
+      }
+      if(run){ *p++ = static_cast<uint8_t>(QOI_OP_RUN | (run-1)); run = 0; }
+      const uint32_t h = qoiHash(px);
+      if(index[h] == px){
+        *p++ = static_cast<uint8_t>(QOI_OP_INDEX | h);
+      } else {
+        index[h] = px;
+        if(px.a == prev.a){
+          const auto vr = static_cast<int8_t>(px.r - prev.r);
+          const auto vg = static_cast<int8_t>(px.g - prev.g);
+          const auto vb = static_cast<int8_t>(px.b - prev.b);
+          const int vgr = vr - vg, vgb = vb - vg;
+          if(vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2){
+            *p++ = static_cast<uint8_t>(QOI_OP_DIFF | (vr+2) << 4 | (vg+2) << 2 | (vb+2));
+          } else if(vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8){
+            *p++ = static_cast<uint8_t>(QOI_OP_LUMA | (vg+32));
+            *p++ = static_cast<uint8_t>((vgr+8) << 4 | (vgb+8));
+          } else {
+            *p++ = QOI_OP_RGB; *p++ = px.r; *p++ = px.g; *p++ = px.b;
+          }
+        } else {
+          *p++ = QOI_OP_RGBA; *p++ = px.r; *p++ = px.g; *p++ = px.b; *p++ = px.a;
+        }
+      }
+      prev = px;
+    }
+  }
+  if(run) *p++ = static_cast<uint8_t>(QOI_OP_RUN | (run-1));
+  std::memcpy(p, QOI_END, sizeof(QOI_END)); p += sizeof(QOI_END);
+  return std::vector<uint8_t>(begin, p);
+}
+
+Image decodeQOI(std::span<const uint8_t> data){
+  auto be32 = [&](size_t o){ return uint32_t{data[o]} << 24 | uint32_t{data[o+1]} << 16 | uint32_t{data[o+2]} << 8 | data[o+3]; };
+  if(data.size() < 14 + sizeof(QOI_END) || std::memcmp(data.data(), "qoif", 4) != 0) return {};
+  const uint32_t w = be32(4), h = be32(8);
+  const uint8_t channels = data[12];
+  if(w == 0 || h == 0 || (channels != 3 && channels != 4) || uint64_t{w}*h > (uint64_t{1} << 30)) return {};
+  Image img{w, h, std::vector<uint8_t>(size_t{w}*h*4)};
+  Px index[64]{};
+  Px px{0, 0, 0, 255};
+  size_t p = 14;
+  const size_t end = data.size() - sizeof(QOI_END);
+  uint32_t run = 0;
+  for(size_t i=0;i<img.rgba.size();i+=4){
+    if(run){ --run; }
+    else if(p < end){
+      const uint8_t b1 = data[p++];
+      if(b1 == QOI_OP_RGB){ if(p+3 > end) return {}; px.r = data[p]; px.g = data[p+1]; px.b = data[p+2]; p += 3; }
+      else if(b1 == QOI_OP_RGBA){ if(p+4 > end) return {}; px = {data[p], data[p+1], data[p+2], data[p+3]}; p += 4; }
+      else if((b1 & QOI_MASK) == QOI_OP_INDEX){ px = index[b1]; }
+      else if((b1 & QOI_MASK) == QOI_OP_DIFF){
+        px.r = static_cast<uint8_t>(px.r + ((b1 >> 4) & 3) - 2);
+        px.g = static_cast<uint8_t>(px.g + ((b1 >> 2) & 3) - 2);
+        px.b = static_cast<uint8_t>(px.b + (b1 & 3) - 2);
+      } else if((b1 & QOI_MASK) == QOI_OP_LUMA){
+        if(p >= end) return {};
+        const uint8_t b2 = data[p++];
+        const int vg = (b1 & 0x3F) - 32;
+        px.r = static_cast<uint8_t>(px.r + vg - 8 + ((b2 >> 4) & 0xF));
+        px.g = static_cast<uint8_t>(px.g + vg);
+        px.b = static_cast<uint8_t>(px.b + vg - 8 + (b2 & 0xF));
+      } else {
+        run = b1 & 0x3F;
+      }
+      index[qoiHash(px)] = px;
+    } else {
+      return {};
+    }
+    std::memcpy(img.rgba.data()+i, &px, 4);
+  }
+  return img;
+}
+
+Image downsample(const ImageView& image, uint32_t factor){
+  factor = std::max(factor, 1u);
+  Image out;
+  out.width = (image.width + factor - 1) / factor;
+  out.height = (image.height + factor - 1) / factor;
+  out.rgba.resize(size_t{out.width} * out.height * 4);
+  std::vector<uint32_t> sums(size_t{out.width} * 4);
+  for(uint32_t oy=0;oy<out.height;++oy){
+    std::fill(sums.begin(), sums.end(), 0u);
+    const uint32_t y0 = oy*factor, y1 = std::min(y0 + factor, image.height);
+    // Accumulate whole rows first so the inner loop walks memory linearly.
+    for(uint32_t y=y0;y<y1;++y){
+      const uint8_t* row = image.rgba + y*image.stride;
+      for(uint32_t ox=0;ox<out.width;++ox){
+        const uint32_t x0 = ox*factor, x1 = std::min(x0 + factor, image.width);
+        uint32_t r = 0, g = 0, b = 0, a = 0;
+        for(uint32_t x=x0;x<x1;++x){ r += row[x*4]; g += row[x*4+1]; b += row[x*4+2]; a += row[x*4+3]; }
+        uint32_t* sum = &sums[ox*4];
+        sum[0] += r; sum[1] += g; sum[2] += b; sum[3] += a;
+      }
+    }
+    uint8_t* dst = out.rgba.data() + size_t{oy}*out.width*4;
+    for(uint32_t ox=0;ox<out.width;++ox){
+      const uint32_t w = std::min(factor, image.width - ox*factor);
+      const uint32_t count = w * (y1 - y0);
+      for(int c=0;c<4;++c) dst[ox*4+c] = static_cast<uint8_t>((sums[ox*4+c] + count/2) / count);
+    }
+  }
+  return out;
+}
+
+bool writeFile(const std::string& path, std::span<const uint8_t> data){
+  std::ofstream f(path, std::ios::binary);
+  if(!f) return false;
+  f.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+  return static_cast<bool>(f);
+}
+
+Recorder::Recorder(JobSystem& jobs, RecorderOptions options):m_jobs(jobs), m_options(std::move(options)){}
+
+Recorder::~Recorder(){ flush(); }
+
+void Recorder::submit(uint32_t frame, const ImageView& image, std::function<void()> release){
+  ++m_submitted;
+  m_jobs.run([this, frame, image, release = std::move(release)]{
+    BLOCCO_ZONE("encode frame");
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<uint8_t> encoded = m_options.format == Format::QOI ? encodeQOI(image) : encodePNG(image);
+    Image thumb;
+    if(m_options.thumbnailFactor > 1) thumb = downsample(image, m_options.thumbnailFactor);
+    // Pixels are no longer needed; hand the buffer back before touching the disk.
+    if(release) release();
+    std::vector<uint8_t> thumbPng;
+    if(!thumb.rgba.empty()) thumbPng = encodePNG(thumb.view());
+    m_encodeNs.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count()));
+    char name[32];
+    std::snprintf(name, sizeof(name), "frame_%06u", frame);
+    const std::string base = m_options.directory + "/" + name;
+    if(writeFile(base + (m_options.format == Format::QOI ? ".qoi" : ".png"), encoded)){
+      m_written.fetch_add(1);
+      m_bytes.fetch_add(encoded.size());
+    }
+    if(!thumbPng.empty() && writeFile(base + "_thumb.png", thumbPng)) m_bytes.fetch_add(thumbPng.size());
+  }, &m_pending);
+}
+
+void Recorder::flush(){ m_jobs.wait(m_pending); }
+
+RecorderStats Recorder::stats() const {
+  return {m_submitted, m_written.load(), m_bytes.load(), static_cast<double>(m_encodeNs.load()) / 1.0e6};
+}
+
+}
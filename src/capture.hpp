@@ -1,3 +1,62 @@
 #pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
 #include <string>
-namespace Capture { void savePNGDummy(const std::string& path); }
+#include <vector>
+#include "jobs.hpp"
+
+namespace Capture {
+// Tightly or loosely packed RGBA8 pixels; stride is the byte distance between rows.
+struct ImageView { const uint8_t* rgba{nullptr}; uint32_t width{0}; uint32_t height{0}; size_t stride{0}; };
+struct Image {
+  uint32_t width{0}, height{0};
+  std::vector<uint8_t> rgba;
+  ImageView view() const { return {rgba.data(), width, height, size_t{width}*4}; }
+};
+
+// PNG with the Up filter and a single-probe LZ77 + fixed-Huffman deflate stream:
+// several times faster than zlib level 1 at a modest cost in size.
+std::vector<uint8_t> encodePNG(const ImageView& image);
+// QOI (qoiformat.org): cheaper still, for high-rate capture.
+std::vector<uint8_t> encodeQOI(const ImageView& image);
+// Returns an empty image if data is not a valid QOI stream.
+Image decodeQOI(std::span<const uint8_t> data);
+// Box filter: each output pixel averages a factor x factor block (clipped at the edges).
+Image downsample(const ImageView& image, uint32_t factor);
+bool writeFile(const std::string& path, std::span<const uint8_t> data);
+
+enum class Format { PNG, QOI };
+struct RecorderOptions {
+  std::string directory{"."};
+  Format format{Format::PNG};
+  uint32_t thumbnailFactor{0}; // 0 = no thumbnails, else also write a 1/factor box-filtered PNG
+};
+struct RecorderStats { uint64_t submitted{0}; uint64_t written{0}; uint64_t bytes{0}; double encodeMs{0.0}; };
+
+// Encodes frames on the job system so the frame loop never waits for the
+// encoder. The caller keeps the pixels alive until release() is invoked
+// from the worker that finished with them.
+class Recorder {
+public:
+  Recorder(JobSystem& jobs, RecorderOptions options);
+  ~Recorder();
+  Recorder(const Recorder&) = delete;
+  Recorder& operator=(const Recorder&) = delete;
+
+  void submit(uint32_t frame, const ImageView& image, std::function<void()> release);
+  // Blocks (helping with jobs) until every submitted frame is written.
+  void flush();
+  RecorderStats stats() const;
+private:
+  JobSystem& m_jobs;
+  RecorderOptions m_options;
+  JobCounter m_pending;
+  uint64_t m_submitted{0};
+  std::atomic<uint64_t> m_written{0};
+  std::atomic<uint64_t> m_bytes{0};
+  std::atomic<uint64_t> m_encodeNs{0};
+};
+}
@@ -1,6 +1,114 @@
 #include "collision.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
 bool intersect(const AABB&a,const AABB&b){
   return (a.min.x<=b.max.x && a.max.x>=b.min.x) &&
          (a.min.y<=b.max.y && a.max.y>=b.min.y) &&
          (a.min.z<=b.max.z && a.max.z>=b.min.z);
 }
+AABB merge(const AABB&a,const AABB&b){
+  return {{std::min(a.min.x,b.min.x),std::min(a.min.y,b.min.y),std::min(a.min.z,b.min.z)},
+          {std::max(a.max.x,b.max.x),std::max(a.max.y,b.max.y),std::max(a.max.z,b.max.z)}};
+}
+float surfaceArea(const AABB&a){
+  const Vec3 d = a.max - a.min;
+  return 2.f*(d.x*d.y + d.y*d.z + d.z*d.x);
+}
+bool contains(const AABB&o,const AABB&i){
+  return o.min.x<=i.min.x && o.min.y<=i.min.y && o.min.z<=i.min.z &&
+         o.max.x>=i.max.x && o.max.y>=i.max.y && o.max.z>=i.max.z;
+}
+bool intersectRay(const AABB&box,const Ray&ray,float maxT,float&tEntry){
+  float t0 = 0.f, t1 = maxT;
+  const float o[3] = {ray.origin.x,ray.origin.y,ray.origin.z};
+  const float d[3] = {ray.dir.x,ray.dir.y,ray.dir.z};
+  const float lo[3] = {box.min.x,box.min.y,box.min.z};
+  const float hi[3] = {box.max.x,box.max.y,box.max.z};
+  for(int a=0;a<3;++a){
+    if(d[a]==0.f){
+      if(o[a]<lo[a] || o[a]>hi[a]) return false;
+      continue;
+    }
+    const float inv = 1.f/d[a];
+    float tn = (lo[a]-o[a])*inv, tf = (hi[a]-o[a])*inv;
+    if(tn>tf) std::swap(tn,tf);
+    t0 = std::max(t0,tn); t1 = std::min(t1,tf);
+    if(t0>t1) return false;
+  }
+  tEntry = t0;
+  return true;
+}
+
+bool raycastVoxels(const Scene&scene,const Ray&ray,float maxT,VoxelHit&hit){
+  const float o[3] = {ray.origin.x,ray.origin.y,ray.origin.z};
+  const float d[3] = {ray.dir.x,ray.dir.y,ray.dir.z};
+  int cell[3], step[3];
+  float tMax[3], tDelta[3];
+  constexpr float INF = std::numeric_limits<float>::infinity();
+  for(int a=0;a<3;++a){
+    cell[a] = static_cast<int>(std::floor(o[a]));
+    if(d[a]>0.f){ step[a]=1; tDelta[a]=1.f/d[a]; tMax[a]=(static_cast<float>(cell[a]+1)-o[a])/d[a]; }
+    else if(d[a]<0.f){ step[a]=-1; tDelta[a]=-1.f/d[a]; tMax[a]=(static_cast<float>(cell[a])-o[a])/d[a]; }
+    else { step[a]=0; tDelta[a]=INF; tMax[a]=INF; }
+  }
+  int lastAxis = -1;
+  float t = 0.f;
+  while(t<=maxT){
+    if(scene.getBlock(cell[0],cell[1],cell[2])!=BLOCK_AIR){
+      hit = {};
+      hit.x=cell[0]; hit.y=cell[1]; hit.z=cell[2]; hit.t=t;
+      if(lastAxis>=0) hit.normal[lastAxis] = -step[lastAxis];
+      return true;
+    }
+    // Advance across whichever cell boundary is nearest.
+    lastAxis = (tMax[0]<tMax[1]) ? (tMax[0]<tMax[2] ? 0 : 2) : (tMax[1]<tMax[2] ? 1 : 2);
+    t = tMax[lastAxis];
+    cell[lastAxis] += step[lastAxis];
+    tMax[lastAxis] += tDelta[lastAxis];
+  }
+  return false;
+}
+
+size_t overlapVoxels(const Scene&scene,const AABB&box,std::span<BlockPos> out){
+  const int x0 = static_cast<int>(std::floor(box.min.x)), x1 = static_cast<int>(std::ceil(box.max.x));
+  const int y0 = static_cast<int>(std::floor(box.min.y)), y1 = static_cast<int>(std::ceil(box.max.y));
+  const int z0 = static_cast<int>(std::floor(box.min.z)), z1 = static_cast<int>(std::ceil(box.max.z));
+  size_t n = 0;
+  for(int y=y0;y<y1;++y) for(int z=z0;z<z1;++z) for(int x=x0;x<x1;++x){
+    if(scene.getBlock(x,y,z)==BLOCK_AIR) continue;
+    if(n<out.size()) out[n] = {x,y,z};
+    ++n;
+  }
+  return n;
+}
+
+float sweepVoxels(const Scene&scene,const AABB&box,int axis,float distance){
+  if(distance==0.f) return 0.f;
+  // Tolerance for faces that touch: a box resting on y=4 covers cells y>=4 only.
+  constexpr float EPS = 1e-4f;
+  const float lo[3] = {box.min.x,box.min.y,box.min.z};
+  const float hi[3] = {box.max.x,box.max.y,box.max.z};
+  const int u = (axis+1)%3, v = (axis+2)%3;
+  const int u0 = static_cast<int>(std::floor(lo[u]+EPS)), u1 = static_cast<int>(std::ceil(hi[u]-EPS));
+  const int v0 = static_cast<int>(std::floor(lo[v]+EPS)), v1 = static_cast<int>(std::ceil(hi[v]-EPS));
+  auto layerSolid = [&](int i){
+    int cell[3];
+    cell[axis] = i;
+    for(cell[v]=v0;cell[v]<v1;++cell[v])
+      for(cell[u]=u0;cell[u]<u1;++cell[u])
+        if(scene.getBlock(cell[0],cell[1],cell[2])!=BLOCK_AIR) return true;
+    return false;
+  };
+  if(distance>0.f){
+    // Layers whose near face lies between the leading face and its destination.
+    const int last = static_cast<int>(std::ceil(hi[axis]+distance))-1;
+    for(int i=static_cast<int>(std::ceil(hi[axis]-EPS));i<=last;++i)
+      if(layerSolid(i)) return std::max(0.f, static_cast<float>(i)-hi[axis]);
+  } else {
+    const int last = static_cast<int>(std::floor(lo[axis]+distance));
+    for(int i=static_cast<int>(std::floor(lo[axis]+EPS))-1;i>=last;--i)
+      if(layerSolid(i)) return std::min(0.f, static_cast<float>(i+1)-lo[axis]);
+  }
+  return distance;
+}
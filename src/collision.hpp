@@ -1,4 +1,24 @@
 #pragma once
 #include "math.hpp"
+#include "scene.hpp"
+#include <cstddef>
+#include <span>
 struct AABB { Vec3 min; Vec3 max; };
+struct Ray { Vec3 origin; Vec3 dir; };
 bool intersect(const AABB&a,const AABB&b);
+AABB merge(const AABB&a,const AABB&b);
+float surfaceArea(const AABB&a);
+bool contains(const AABB&outer,const AABB&inner);
+// Slab test; on hit tEntry is the entry distance in units of ray.dir (clamped to 0).
+bool intersectRay(const AABB&box,const Ray&ray,float maxT,float&tEntry);
+
+// Entity-vs-voxel queries walk the block grid directly instead of building boxes.
+struct VoxelHit { int x{}, y{}, z{}; int normal[3]{}; float t{}; };
+// Amanatides-Woo DDA through non-air blocks; t is in units of ray.dir.
+bool raycastVoxels(const Scene&scene,const Ray&ray,float maxT,VoxelHit&hit);
+// Solid blocks whose unit cell overlaps the interior of box; returns total count.
+size_t overlapVoxels(const Scene&scene,const AABB&box,std::span<BlockPos> out);
+// Distance box can move along one axis (0=x, 1=y, 2=z; signed) before its leading
+// face touches a solid block. Faces the box already rests against only block
+// motion into them, so sliding along a floor or wall is free.
+float sweepVoxels(const Scene&scene,const AABB&box,int axis,float distance);
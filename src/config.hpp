@@ -1,4 +1,20 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <unordered_map>
-struct Config { float mouseSensitivity=0.1f; };
+enum class PresentMode { Fifo, Mailbox, Immediate };
+struct Config {
+  float mouseSensitivity=0.1f;
+  // Frames the CPU may run ahead of the GPU (1..4). Fewer lowers latency, more smooths spikes.
+  uint32_t framesInFlight=2;
+  PresentMode presentMode=PresentMode::Mailbox; // falls back to FIFO when unsupported
+  bool presentWait=true; // pace on VK_KHR_present_wait when the device supports it
+  uint32_t workerThreads=0; // job system threads including the main one; 0 = one per core
+  float fixedTimestep=1.f/60.f; // simulation step in seconds; rendering interpolates between steps
+  std::string pipelineCachePath; // empty = pipeline_cache.bin in the platform cache directory
+  std::string fontPath; // TrueType font for labels and the HUD; empty = no text
+  bool hud=true; // frame-time overlay, when a font is set
+  bool asyncUploads=true; // mesh uploads on a transfer queue when the device has timeline semaphores
+  bool packedVertices=true; // 8-byte voxel vertices instead of 32-byte floats
+  bool vertexPulling=false; // packed vertices read from a storage buffer rather than a vertex binding
+};
@@ -0,0 +1,88 @@
+#include "culling.hpp"
+#include <bit>
+#include <cassert>
+#include <cmath>
+
+bool frustumVisible(const Frustum& f, const Vec3& min, const Vec3& max){
+  for(const Vec4& p : f.planes){
+    // Corner farthest along the plane normal.
+    const float d = p.x*(p.x > 0.f ? max.x : min.x) + p.y*(p.y > 0.f ? max.y : min.y) + p.z*(p.z > 0.f ? max.z : min.z) + p.w;
+    if(d < 0.f) return false;
+  }
+  return true;
+}
+
+void transformBounds(const Mat4& m, const Vec3& min, const Vec3& max, Vec3& outMin, Vec3& outMax){
+  float lo[3] = {m.m[12], m.m[13], m.m[14]};
+  float hi[3] = {m.m[12], m.m[13], m.m[14]};
+  const float a[3] = {min.x, min.y, min.z};
+  const float b[3] = {max.x, max.y, max.z};
+  for(int col=0;col<3;++col)
+    for(int row=0;row<3;++row){
+      const float e = m.m[col*4+row]*a[col], f = m.m[col*4+row]*b[col];
+      lo[row] += std::min(e, f);
+      hi[row] += std::max(e, f);
+    }
+  outMin = {lo[0], lo[1], lo[2]};
+  outMax = {hi[0], hi[1], hi[2]};
+}
+
+uint32_t DepthPyramid::levelCount(uint32_t depthWidth, uint32_t depthHeight){
+  uint32_t levels = 1;
+  while(levelSize(depthWidth, levels-1) > 1 || levelSize(depthHeight, levels-1) > 1) ++levels;
+  return levels;
+}
+
+void DepthPyramid::build(std::span<const float> depth, uint32_t width, uint32_t height){
+  assert(depth.size() >= size_t{width}*height);
+  m_depthWidth = width; m_depthHeight = height;
+  const uint32_t count = levelCount(width, height);
+  m_sizes.resize(count);
+  m_levels.resize(count);
+  const float* src = depth.data();
+  uint32_t srcW = width, srcH = height;
+  for(uint32_t l=0;l<count;++l){
+    const uint32_t w = levelSize(width, l), h = levelSize(height, l);
+    m_sizes[l] = {w, h};
+    std::vector<float>& dst = m_levels[l];
+    dst.assign(size_t{w}*h, 0.f);
+    for(uint32_t y=0;y<h;++y){
+      // Same footprint as depth_pyramid_comp.glsl: 2x2, plus the odd row/column at the last texel.
+      const uint32_t y1 = std::min(2*y + 1 + (y == h-1 ? (srcH & 1) : 0u), srcH-1);
+      for(uint32_t x=0;x<w;++x){
+        const uint32_t x1 = std::min(2*x + 1 + (x == w-1 ? (srcW & 1) : 0u), srcW-1);
+        float d = 0.f;
+        for(uint32_t sy=2*y; sy<=y1; ++sy)
+          for(uint32_t sx=2*x; sx<=x1; ++sx) d = std::max(d, src[size_t{sy}*srcW + sx]);
+        dst[size_t{y}*w + x] = d;
+      }
+    }
+    src = dst.data(); srcW = w; srcH = h;
+  }
+}
+
+bool DepthPyramid::occluded(const Mat4& viewProj, const Vec3& min, const Vec3& max) const {
+  if(m_levels.empty()) return false;
+  float u0 = 1.f, v0 = 1.f, u1 = 0.f, v1 = 0.f, nearest = 1.f;
+  for(int i=0;i<8;++i){
+    const Vec4 c = viewProj * Vec4{i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z, 1.f};
+    if(c.w <= 1e-4f) return false; // crosses the near plane
+    const float u = c.x/c.w*0.5f + 0.5f, v = c.y/c.w*0.5f + 0.5f;
+    u0 = std::min(u0, u); u1 = std::max(u1, u);
+    v0 = std::min(v0, v); v1 = std::max(v1, v);
+    nearest = std::min(nearest, c.z/c.w);
+  }
+  u0 = std::clamp(u0, 0.f, 1.f); u1 = std::clamp(u1, 0.f, 1.f);
+  v0 = std::clamp(v0, 0.f, 1.f); v1 = std::clamp(v1, 0.f, 1.f);
+  const auto texel = [](float t, uint32_t size){ return std::min(static_cast<uint32_t>(t*static_cast<float>(size)), size-1); };
+  const uint32_t tx0 = texel(u0, m_depthWidth), tx1 = texel(u1, m_depthWidth);
+  const uint32_t ty0 = texel(v0, m_depthHeight), ty1 = texel(v1, m_depthHeight);
+  // Smallest level whose texels (2^(level+1) depth texels wide) the rect spans at most two of.
+  const uint32_t extent = std::max(tx1 - tx0, ty1 - ty0) + 1;
+  const uint32_t wanted = static_cast<uint32_t>(std::bit_width(extent - 1));
+  const uint32_t level = std::min(wanted > 0 ? wanted - 1 : 0u, levels() - 1);
+  const uint32_t x0 = std::min(tx0 >> (level+1), width(level)-1), x1 = std::min(tx1 >> (level+1), width(level)-1);
+  const uint32_t y0 = std::min(ty0 >> (level+1), height(level)-1), y1 = std::min(ty1 >> (level+1), height(level)-1);
+  const float farthest = std::max(std::max(at(level, x0, y0), at(level, x1, y0)), std::max(at(level, x0, y1), at(level, x1, y1)));
+  return nearest > farthest;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "math.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+// World-space box of one draw as read by shaders/cull_comp.glsl (std430: two
+// vec4s). batch is the draw's DrawBatch index and batchFirst that batch's first
+// command, so survivors can be compacted within their own batch. Batches whose
+// order matters (back to front, for blending) carry IN_ORDER in batch: their
+// culled draws stay in place with no instances instead.
+struct DrawBounds {
+  static constexpr uint32_t IN_ORDER = 1u << 31;
+  float min[3]{};
+  uint32_t batch{0};
+  float max[3]{};
+  uint32_t batchFirst{0};
+};
+
+// Conservative frustum test: false only when the box is entirely outside one plane.
+bool frustumVisible(const Frustum& f, const Vec3& min, const Vec3& max);
+
+// Axis-aligned bounds of a box after an affine transform (Arvo's method).
+void transformBounds(const Mat4& m, const Vec3& min, const Vec3& max, Vec3& outMin, Vec3& outMax);
+
+// Hierarchical depth buffer for occlusion culling; CPU reference for
+// shaders/depth_pyramid_comp.glsl and the occlusion half of cull_comp.glsl.
+// Level 0 is the depth buffer reduced 2x2 and each level halves the previous one
+// (rounding down) until both sides are 1. Texels keep the farthest depth (depth
+// compares LESS); on odd sizes the last texel also folds in the extra row or
+// column, so texel i of level L bounds depth texels [i, i+1) << (L+1) and the
+// last texel everything past them.
+class DepthPyramid {
+public:
+  static uint32_t levelCount(uint32_t depthWidth, uint32_t depthHeight);
+  static uint32_t levelSize(uint32_t depthSize, uint32_t level){ return std::max(1u, depthSize >> (level + 1)); }
+
+  void build(std::span<const float> depth, uint32_t width, uint32_t height);
+  uint32_t levels() const { return static_cast<uint32_t>(m_levels.size()); }
+  uint32_t width(uint32_t level) const { return m_sizes[level].first; }
+  uint32_t height(uint32_t level) const { return m_sizes[level].second; }
+  float at(uint32_t level, uint32_t x, uint32_t y) const { return m_levels[level][size_t{y}*width(level) + x]; }
+
+  // True when the box, projected with the viewProj the depth was rendered with,
+  // lies behind the stored depth everywhere it covers. Boxes crossing the near
+  // plane are never occluded.
+  bool occluded(const Mat4& viewProj, const Vec3& min, const Vec3& max) const;
+
+private:
+  uint32_t m_depthWidth{0}, m_depthHeight{0};
+  std::vector<std::pair<uint32_t, uint32_t>> m_sizes;
+  std::vector<std::vector<float>> m_levels;
+};
@@ -0,0 +1,127 @@
+#include "draw_list.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstring>
+
+void DrawList::clear(){
+  m_meshes.clear();
+  m_models.clear();
+  m_bounds.clear();
+  m_keys.clear();
+  m_batches.clear();
+}
+
+void DrawList::reserve(size_t draws){
+  m_meshes.reserve(draws);
+  m_models.reserve(draws);
+  m_bounds.reserve(draws);
+  m_keys.reserve(draws);
+}
+
+void DrawList::setBackToFront(uint32_t pipeline, bool enabled){
+  assert(pipeline < MAX_PIPELINES);
+  m_backToFront.set(pipeline, enabled);
+}
+
+void DrawList::add(uint32_t pipeline, uint32_t material, const MeshRange& mesh, const Mat4& model, float depth,
+                   const Vec3& boundsMin, const Vec3& boundsMax){
+  assert(pipeline < MAX_PIPELINES && material < MAX_MATERIALS);
+  // Non-negative IEEE floats order like their bit patterns; NaN and negatives clamp to zero.
+  const uint32_t depthBits = depth > 0.f ? std::bit_cast<uint32_t>(depth) : 0u;
+  // Pipeline in the top byte either way, so batches stay contiguous. Back to
+  // front puts the inverted depth above the material instead of below it.
+  if(m_backToFront[pipeline]) m_keys.push_back(uint64_t{pipeline} << 56 | uint64_t{~depthBits} << 16 | material);
+  else m_keys.push_back(uint64_t{pipeline} << 56 | uint64_t{material} << 40 | depthBits);
+  m_meshes.push_back(mesh);
+  m_models.push_back(model);
+  m_bounds.emplace_back(boundsMin, boundsMax);
+}
+
+// LSD radix sort on key bytes, carrying the draw index. One counting pass builds
+// all eight histograms; bytes that are equal for every key (unused pipeline or
+// material bits, the zero gap) are skipped, so a typical frame needs 4-5 passes.
+void DrawList::sortKeys(){
+  const size_t n = m_keys.size();
+  m_order.resize(n);
+  for(size_t i=0;i<n;++i) m_order[i] = static_cast<uint32_t>(i);
+  m_keyScratch.resize(n);
+  m_orderScratch.resize(n);
+  std::array<std::array<uint32_t, 256>, 8> hist{};
+  for(const uint64_t k : m_keys)
+    for(size_t b=0;b<8;++b) ++hist[b][(k >> (b*8)) & 0xFF];
+  uint64_t* keys = m_keys.data();
+  uint32_t* order = m_order.data();
+  uint64_t* keysOut = m_keyScratch.data();
+  uint32_t* orderOut = m_orderScratch.data();
+  for(size_t b=0;b<8;++b){
+    auto& h = hist[b];
+    if(h[(keys[0] >> (b*8)) & 0xFF] == n) continue;
+    uint32_t sum = 0;
+    for(auto& c : h){ const uint32_t t = c; c = sum; sum += t; }
+    for(size_t i=0;i<n;++i){
+      const uint32_t dst = h[(keys[i] >> (b*8)) & 0xFF]++;
+      keysOut[dst] = keys[i];
+      orderOut[dst] = order[i];
+    }
+    std::swap(keys, keysOut);
+    std::swap(order, orderOut);
+  }
+  if(keys != m_keys.data()){
+    std::memcpy(m_keys.data(), keys, n*sizeof(uint64_t));
+    std::memcpy(m_order.data(), order, n*sizeof(uint32_t));
+  }
+}
+
+std::span<const DrawBatch> DrawList::sort(){
+  const size_t n = size();
+  m_batches.clear();
+  if(n == 0) return {};
+  sortKeys();
+  for(size_t i=0;i<n;++i){
+    const auto pipeline = static_cast<uint32_t>(m_keys[i] >> 56);
+    if(m_batches.empty() || m_batches.back().pipeline != pipeline) m_batches.push_back({pipeline, static_cast<uint32_t>(i), 0});
+    ++m_batches.back().count;
+  }
+  return m_batches;
+}
+
+void DrawList::write(uint32_t first, uint32_t count, std::span<DrawIndexedIndirect> commands, std::span<Mat4> transforms,
+                     std::span<DrawBounds> bounds, uint32_t transformBase) const {
+  assert(size_t{first} + count <= m_order.size() && commands.size() >= m_order.size() && transforms.size() >= m_order.size());
+  assert(bounds.empty() || bounds.size() >= m_order.size());
+  if(count == 0) return;
+  // Batch holding the first draw of the range.
+  auto batch = static_cast<uint32_t>(std::upper_bound(m_batches.begin(), m_batches.end(), first,
+    [](uint32_t i, const DrawBatch& b){ return i < b.first; }) - m_batches.begin()) - 1;
+  for(uint32_t i=first;i<first+count;++i){
+    const uint32_t src = m_order[i];
+    const MeshRange& mesh = m_meshes[src];
+    commands[i] = {mesh.indexCount, 1, mesh.firstIndex, mesh.vertexOffset, transformBase + i};
+    transforms[i] = m_models[src];
+    if(bounds.empty()) continue;
+    if(i == m_batches[batch].first + m_batches[batch].count) ++batch;
+    const auto& [mn, mx] = m_bounds[src];
+    const uint32_t inOrder = m_backToFront[m_batches[batch].pipeline] ? DrawBounds::IN_ORDER : 0u;
+    bounds[i] = {{mn.x, mn.y, mn.z}, batch | inOrder, {mx.x, mx.y, mx.z}, m_batches[batch].first};
+  }
+}
+
+void DrawList::split(uint32_t maxDraws, std::vector<DrawChunk>& chunks) const {
+  assert(maxDraws > 0);
+  chunks.clear();
+  for(uint32_t b=0;b<m_batches.size();++b){
+    const DrawBatch& batch = m_batches[b];
+    for(uint32_t first = batch.first; first < batch.first + batch.count; first += maxDraws)
+      chunks.push_back({b, first, std::min(maxDraws, batch.first + batch.count - first)});
+  }
+}
+
+std::span<const DrawBatch> DrawList::build(std::span<DrawIndexedIndirect> commands, std::span<Mat4> transforms,
+                                           std::span<DrawBounds> bounds, uint32_t transformBase){
+  assert(commands.size() >= size() && transforms.size() >= size() && (bounds.empty() || bounds.size() >= size()));
+  const auto batches = sort();
+  write(0, static_cast<uint32_t>(size()), commands, transforms, bounds, transformBase);
+  return batches;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "culling.hpp"
+#include "math.hpp"
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Layout-compatible with VkDrawIndexedIndirectCommand so build() can write
+// straight into a mapped indirect buffer.
+struct DrawIndexedIndirect {
+  uint32_t indexCount{0};
+  uint32_t instanceCount{0};
+  uint32_t firstIndex{0};
+  int32_t vertexOffset{0};
+  uint32_t firstInstance{0};
+};
+
+// Where a mesh lives inside the shared vertex/index buffers.
+struct MeshRange {
+  uint32_t indexCount{0};
+  uint32_t firstIndex{0};
+  int32_t vertexOffset{0};
+};
+
+// Consecutive commands that share a pipeline: one vkCmdDrawIndexedIndirect each.
+struct DrawBatch {
+  uint32_t pipeline{0};
+  uint32_t first{0};
+  uint32_t count{0};
+};
+
+// Part of one batch, written and recorded as a unit (one secondary command
+// buffer when recording is spread over worker threads).
+struct DrawChunk {
+  uint32_t batch{0};
+  uint32_t first{0};
+  uint32_t count{0};
+};
+
+// Per-frame draw submission. Draws are sorted by pipeline, then material, then
+// view depth front to back (opaque overdraw); pipelines marked back to front
+// (blending) sort by depth far to near first and material second. They are
+// emitted as indirect commands with one transform per draw. Command i reads transform firstInstance, so the
+// vertex shader indexes the transform SSBO with gl_InstanceIndex and no
+// per-object descriptor or push constant is needed.
+class DrawList {
+public:
+  static constexpr uint32_t MAX_PIPELINES = 256;
+  static constexpr uint32_t MAX_MATERIALS = 65536;
+
+  void clear();
+  void reserve(size_t draws);
+  // Blended pipelines must draw far to near to composite correctly. Kept across clear().
+  void setBackToFront(uint32_t pipeline, bool enabled);
+  // depth is the view-space distance; negative values sort as zero. The world
+  // bounds are only needed when build() is asked for culling data.
+  void add(uint32_t pipeline, uint32_t material, const MeshRange& mesh, const Mat4& model, float depth,
+           const Vec3& boundsMin = {}, const Vec3& boundsMax = {});
+  size_t size() const { return m_meshes.size(); }
+  bool empty() const { return m_meshes.empty(); }
+
+  // Sorts the draws and returns the pipeline batches, valid until the next clear().
+  std::span<const DrawBatch> sort();
+  // Writes sorted draws [first, first+count) into the same positions of commands
+  // and transforms, and of bounds when it is not empty. transformBase is added to
+  // every firstInstance (the transforms' element offset inside the bound SSBO).
+  // Disjoint ranges may be written from several threads at once.
+  void write(uint32_t first, uint32_t count, std::span<DrawIndexedIndirect> commands, std::span<Mat4> transforms,
+             std::span<DrawBounds> bounds = {}, uint32_t transformBase = 0) const;
+  // Splits the sorted batches into chunks of at most maxDraws, in draw order.
+  void split(uint32_t maxDraws, std::vector<DrawChunk>& chunks) const;
+  // sort() then write() of every draw.
+  std::span<const DrawBatch> build(std::span<DrawIndexedIndirect> commands, std::span<Mat4> transforms,
+                                   std::span<DrawBounds> bounds = {}, uint32_t transformBase = 0);
+
+private:
+  void sortKeys();
+  std::bitset<MAX_PIPELINES> m_backToFront;
+  std::vector<MeshRange> m_meshes;
+  std::vector<Mat4> m_models;
+  std::vector<std::pair<Vec3, Vec3>> m_bounds;
+  std::vector<uint64_t> m_keys;
+  std::vector<uint32_t> m_order;
+  std::vector<uint64_t> m_keyScratch; // radix sort ping-pong buffers
+  std::vector<uint32_t> m_orderScratch;
+  std::vector<DrawBatch> m_batches;
+};
@@ -1,20 +1,48 @@
 #include "engine.hpp"
 #include "renderer.hpp"
+#include "capture.hpp"
 #include "input.hpp"
 #include "camera.hpp"
 #include "config.hpp"
+#include "font.hpp"
+#include "hud.hpp"
+#include "jobs.hpp"
+#include "labels.hpp"
+#include "logging.hpp"
+#include "memory.hpp"
+#include "physics.hpp"
+#include "platform.hpp"
+#include "profiler.hpp"
+#include <algorithm>
 #include <chrono>
 #include <thread>
 #include <stdexcept>
 
-Engine::Engine(bool headless):m_headless(headless){init();}
+Engine::Engine(bool headless):Engine(headless, Config{}){}
+Engine::Engine(bool headless, const Config& config):m_headless(headless){init(config);}
 Engine::~Engine(){shutdown();}
 
-void Engine::init(){
-  m_config = std::make_unique<Config>();
+void Engine::init(const Config& config){
+  m_jobs = std::make_unique<JobSystem>(config.workerThreads);
+  m_frameArena = std::make_unique<FrameArena>();
+  m_config = std::make_unique<Config>(config);
   m_input = std::make_unique<InputSystem>();
   m_camera = std::make_unique<Camera>();
-  m_renderer = std::make_unique<Renderer>(m_headless);
+  m_world = std::make_unique<Scene>();
+  PhysicsConfig physics;
+  physics.step = config.fixedTimestep;
+  m_physics = std::make_unique<PhysicsWorld>(*m_world, m_jobs.get(), physics);
+  m_timestep = std::make_unique<FixedTimestep>(config.fixedTimestep);
+  m_renderer = std::make_unique<Renderer>(m_headless, *m_config, m_jobs.get());
+  if(!config.fontPath.empty()){
+    // Rendering the distance fields takes a while; later runs load the cached atlas.
+    bool cached = false;
+    const FontAtlas atlas = loadOrBuildFontAtlas(config.fontPath, Platform::cacheDirectory(), {}, m_jobs.get(), &cached);
+    Log::info("Font atlas for {} {}", config.fontPath, cached ? "loaded from cache" : "built");
+    m_renderer->setFontAtlas(atlas);
+    m_labels = std::make_unique<Labels>(atlas);
+    if(config.hud) m_hud = std::make_unique<Hud>();
+  }
   m_running = true;
 }
 
@@ -22,31 +50,150 @@ void Engine::run(){
   using clock = std::chrono::steady_clock;
   auto last = clock::now();
   while(m_running){
+    BLOCCO_ZONE("frame");
+    if(!m_headless && m_input->window().minimized){
+      // A 0x0 window has no swapchain to draw to: wait for it to come back, and
+      // do not let the pause count as simulated time.
+      pollWindow();
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      last = clock::now();
+      continue;
+    }
+    // Wait for the frame slot before sampling input, not after, to keep input-to-present latency low.
+    m_renderer->beginFrame();
+    m_frameArena->reset();
+    if(!m_headless && pollWindow().minimized) continue; // the begun frame is picked up once restored
     auto now = clock::now();
     float dt = std::chrono::duration<float>(now-last).count();
     last = now;
+    // Step first so the renderer culls and sorts with this frame's camera, not the last one's.
     update(dt);
+    syncCamera();
     render();
+    Profiler::collect();
   }
 }
 
-void Engine::headlessCapture(int frames){
+const WindowEvents& Engine::pollWindow(){
+  const WindowEvents& events = m_input->poll();
+  if(events.quit) m_running = false;
+  if(events.resized) m_renderer->notifyResized();
+  return events;
+}
+
+void Engine::enableCapture(const Capture::RecorderOptions& options){
+  if(!m_headless) throw std::runtime_error("Frame capture requires headless mode");
+  m_capture = std::make_unique<Capture::Recorder>(*m_jobs, options);
+  Renderer* renderer = m_renderer.get();
+  m_renderer->setReadbackHandler([this, renderer](uint32_t frame, const Capture::ImageView& image, size_t slot){
+    m_capture->submit(frame, image, [renderer, slot]{ renderer->releaseReadback(slot); });
+  });
+}
+
+void Engine::headlessCapture(int frames, const std::function<void(JobSystem&, int)>& workload){
   for(int i=0;i<frames;++i){
+    BLOCCO_ZONE("frame");
+    m_renderer->beginFrame();
+    m_frameArena->reset();
     update(1.f/60.f);
+    syncCamera();
+    if(workload) workload(*m_jobs, i);
     render();
+    Profiler::collect();
+  }
+  m_renderer->waitIdle();
+  const auto& stats = m_renderer->frameStats();
+  double cpuSum = 0.0, cpuMax = 0.0, gpuSum = 0.0, gpuMax = 0.0, recordSum = 0.0, recordMax = 0.0;
+  double visibleSum = 0.0, frustumSum = 0.0, occlusionSum = 0.0;
+  size_t gpuCount = 0;
+  for(const FrameStats& s : stats){
+    Log::info("frame {} cpu {:.3f} ms gpu {:.3f} ms, {} draws recorded in {:.3f} ms", s.frame, s.cpuMs, s.gpuMs, s.draws, s.recordMs);
+    cpuSum += s.cpuMs; cpuMax = std::max(cpuMax, s.cpuMs);
+    recordSum += s.recordMs; recordMax = std::max(recordMax, s.recordMs);
+    visibleSum += s.visible; frustumSum += s.frustumCulled; occlusionSum += s.occlusionCulled;
+    if(s.gpuMs >= 0.0){ gpuSum += s.gpuMs; gpuMax = std::max(gpuMax, s.gpuMs); ++gpuCount; }
   }
+  if(stats.empty()) return;
+  Log::info("{} frames: cpu avg {:.3f} max {:.3f} ms, gpu avg {:.3f} max {:.3f} ms ({} timed)",
+            stats.size(), cpuSum/static_cast<double>(stats.size()), cpuMax,
+            gpuCount ? gpuSum/static_cast<double>(gpuCount) : -1.0, gpuMax, gpuCount);
+  Log::info("draw record: avg {:.3f} max {:.3f} ms for {} draws",
+            recordSum/static_cast<double>(stats.size()), recordMax, stats.back().draws);
+  const auto frameCount = static_cast<double>(stats.size());
+  Log::info("culling: avg {:.0f} visible, {:.0f} frustum culled, {:.0f} occlusion culled per frame ({})",
+            visibleSum/frameCount, frustumSum/frameCount, occlusionSum/frameCount, m_renderer->gpuCulling() ? "gpu" : "cpu frustum only");
+  const StartupStats startup = m_renderer->startupStats();
+  Log::info("startup ({} pipeline cache, {} KB): init {:.1f} ms, first frame {:.1f} ms, all pipelines {:.1f} ms",
+            startup.warmCache ? "warm" : "cold", startup.cacheBytes/1024, startup.initMs, startup.firstFrameMs, startup.pipelinesMs);
+  logMemoryStats();
+  if(m_capture){
+    m_capture->flush();
+    const Capture::RecorderStats cs = m_capture->stats();
+    Log::info("capture: {} frames written ({} dropped), {:.1f} MB, {:.3f} ms encode/frame on workers",
+              cs.written, m_renderer->readbackDropped(), static_cast<double>(cs.bytes)/1.0e6,
+              cs.submitted ? cs.encodeMs/static_cast<double>(cs.submitted) : 0.0);
+  }
+  // The caller's own report follows on stdout.
+  Log::flush();
+}
+
+void Engine::logMemoryStats(){
+  auto mb = [](uint64_t bytes){ return static_cast<double>(bytes)/1.0e6; };
+  const MemoryStats arena = m_frameArena->stats();
+  const MemoryStats ring = m_renderer->frameRing().stats();
+  const vkutils::GpuMemoryStats gpu = m_renderer->memoryStats();
+  Log::info("frame arena: {:.2f} MB capacity, {:.2f} MB peak/frame; uniform ring: {:.3f} MB peak of {:.3f} MB/frame",
+            mb(arena.capacity), mb(arena.peak), mb(ring.peak), mb(ring.capacity));
+  Log::info("gpu memory: {:.2f} MB in use (peak {:.2f}) of {:.2f} MB in {} blocks + {} dedicated, {} allocations, fragmentation {:.2f}",
+            mb(gpu.total.inUse), mb(gpu.total.peak), mb(gpu.total.capacity), gpu.blocks, gpu.dedicated,
+            gpu.total.allocations, gpu.total.fragmentation);
+}
+
+void Engine::setInputSource(std::function<PlayerInput(uint64_t)> source){
+  m_inputSource = std::move(source);
+}
+
+float Engine::stepAlpha() const {
+  return m_timestep->alpha();
 }
 
 void Engine::update(float dt){
+  BLOCCO_ZONE("update");
   m_time += dt;
-  // TODO input, camera, physics
+  simulateFrame(*m_physics, *m_timestep, dt, [this](uint64_t step){
+    return m_inputSource ? m_inputSource(step) : m_input->player();
+  }, *m_camera);
   if(m_time>2.0f && m_headless){ m_running=false; }
 }
 
+void Engine::syncCamera(){
+  m_renderer->setCamera(m_camera->view(), m_camera->projection(m_renderer->aspectRatio()));
+}
+
 void Engine::render(){
+  if(m_labels){
+    const auto now = std::chrono::steady_clock::now();
+    if(m_hud){
+      // The frame before this one: its CPU time is known, its GPU time may follow later.
+      if(m_lastRender != std::chrono::steady_clock::time_point{}){
+        const FrameStats& s = m_renderer->lastFrameStats();
+        m_hud->addFrame(std::chrono::duration<double, std::milli>(now - m_lastRender).count(), s.cpuMs, s.gpuMs, s.draws, s.glyphs);
+      }
+      m_hud->draw(*m_labels, 8.f, 8.f, 16.f);
+    }
+    m_lastRender = now;
+    m_renderer->drawText(*m_labels);
+  }
   m_renderer->drawFrame();
 }
 
 void Engine::shutdown(){
+  if(m_renderer) m_renderer->waitIdle();
+  m_capture.reset();
+  m_hud.reset();
+  m_labels.reset();
   m_renderer.reset();
+  m_physics.reset();
+  m_jobs.reset();
+  m_frameArena.reset();
 }
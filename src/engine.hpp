@@ -1,27 +1,80 @@
 #pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
 class Renderer;
+class JobSystem;
 class InputSystem;
-class Camera;
+struct Camera;
+class FrameArena;
+class Scene;
+class PhysicsWorld;
+class FixedTimestep;
+struct PlayerInput;
+struct WindowEvents;
 struct Config;
+class Labels;
+class Hud;
+namespace Capture { class Recorder; struct RecorderOptions; }
 class Engine {
 public:
   Engine(bool headless=false);
+  Engine(bool headless, const Config& config);
   ~Engine();
   void run();
-  void headlessCapture(int frames);
+  // Optional per-frame CPU workload runs after each update and camera sync,
+  // so deterministic work can be benchmarked without a window. Camera moves it
+  // makes reach the renderer on the next frame.
+  void headlessCapture(int frames, const std::function<void(JobSystem&, int)>& workload = {});
+  const Config& config() const { return *m_config; }
+  JobSystem& jobs(){ return *m_jobs; }
+  Renderer& renderer(){ return *m_renderer; }
+  // Handed to the renderer each frame after the update places it, before any draws are submitted.
+  Camera& camera(){ return *m_camera; }
+  // Scratch memory for the current frame (any thread); reclaimed at the next frame.
+  FrameArena& frameArena(){ return *m_frameArena; }
+  // Headless only: encode every rendered frame on the job system into options.directory.
+  void enableCapture(const Capture::RecorderOptions& options);
+  // The voxel world the simulation collides against.
+  Scene& world(){ return *m_world; }
+  // Stepped at Config::fixedTimestep from update(); once a character is spawned
+  // the camera follows its eye, interpolated between the last two steps.
+  PhysicsWorld& physics(){ return *m_physics; }
+  // Replaces live input with source(step) for every fixed step, so scripted and
+  // recorded input streams replay identically whatever the frame times.
+  void setInputSource(std::function<PlayerInput(uint64_t step)> source);
+  // Blend factor from the previous physics step to the current one, for drawing bodies.
+  float stepAlpha() const;
+  // World labels and screen text, drawn every frame; null unless Config::fontPath
+  // is set. The HUD, when enabled, adds its lines to these each frame.
+  Labels* labels(){ return m_labels.get(); }
 private:
-  void init();
+  void init(const Config& config);
   void update(float dt);
+  void syncCamera();
+  // Windowed mode: pumps events, stops on quit and passes resizes to the renderer.
+  const WindowEvents& pollWindow();
   void render();
   void shutdown();
+  void logMemoryStats();
   bool m_headless{false};
   bool m_running{false};
   float m_time{0.f};
+  std::unique_ptr<JobSystem> m_jobs;
+  std::unique_ptr<FrameArena> m_frameArena;
   std::unique_ptr<Renderer> m_renderer;
+  std::unique_ptr<Capture::Recorder> m_capture; // destroyed before the renderer whose buffers it reads
   std::unique_ptr<InputSystem> m_input;
   std::unique_ptr<Camera> m_camera;
   std::unique_ptr<Config> m_config;
+  std::unique_ptr<Scene> m_world;
+  std::unique_ptr<PhysicsWorld> m_physics; // after the world and job system it uses
+  std::unique_ptr<FixedTimestep> m_timestep;
+  std::unique_ptr<Labels> m_labels;
+  std::unique_ptr<Hud> m_hud;
+  std::chrono::steady_clock::time_point m_lastRender{};
+  std::function<PlayerInput(uint64_t)> m_inputSource;
 };
@@ -0,0 +1,458 @@
+#include "font.hpp"
+#include "bytes.hpp"
+#include "jobs.hpp"
+#include "logging.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+#include <stdexcept>
+#include <system_error>
+
+namespace {
+using Bytes::get;
+using Bytes::put;
+using Bytes::putBytes;
+
+constexpr char MAGIC[4] = {'B', 'F', 'A', '1'};
+constexpr uint32_t FORMAT_VERSION = 1; // part of the key: bump when the rendering changes
+constexpr size_t GLYPH_COUNT = FontAtlas::LAST - FontAtlas::FIRST + 1;
+// magic, version, key, width, height, 3 metrics, glyphs, pixel hash
+constexpr size_t GLYPH_BYTES = 4*2 + 3*4;
+constexpr size_t HEADER_BYTES = 4 + 4 + 8 + 2*4 + 3*4 + GLYPH_COUNT*GLYPH_BYTES + 8;
+constexpr int MAX_COMPOSITE_DEPTH = 8;
+
+[[noreturn]] void fail(const std::string& what){ throw std::runtime_error("Font: " + what); }
+
+uint64_t fnv1a(std::span<const uint8_t> data, uint64_t h = 0xcbf29ce484222325ull){
+  for(const uint8_t b : data){ h ^= b; h *= 0x100000001b3ull; }
+  return h;
+}
+
+// Big-endian reads, bounds-checked against the whole file.
+struct Reader {
+  std::span<const uint8_t> data;
+  void check(size_t at, size_t n) const { if(at > data.size() || data.size() - at < n) fail("table out of bounds"); }
+  uint8_t u8(size_t at) const { check(at, 1); return data[at]; }
+  uint16_t u16(size_t at) const { check(at, 2); return static_cast<uint16_t>(data[at] << 8 | data[at + 1]); }
+  int16_t i16(size_t at) const { return static_cast<int16_t>(u16(at)); }
+  uint32_t u32(size_t at) const { return uint32_t{u16(at)} << 16 | u16(at + 2); }
+};
+
+struct Edge { float x0, y0, x1, y1; };
+
+// Affine map of composite glyph components: x' = a*x + c*y + e, y' = b*x + d*y + f.
+struct Transform {
+  float a{1.f}, b{0.f}, c{0.f}, d{1.f}, e{0.f}, f{0.f};
+  float x(float px, float py) const { return a*px + c*py + e; }
+  float y(float px, float py) const { return b*px + d*py + f; }
+  Transform then(const Transform& t) const { // this applied first, then t
+    return {t.a*a + t.c*b, t.b*a + t.d*b, t.a*c + t.c*d, t.b*c + t.d*d, t.x(e, f), t.y(e, f)};
+  }
+};
+
+class TrueType {
+public:
+  explicit TrueType(std::span<const uint8_t> file) : m_r{file} {
+    const uint32_t version = m_r.u32(0);
+    if(version == 0x4f54544f) fail("CFF outlines are not supported");
+    if(version != 0x00010000 && version != 0x74727565) fail("not a TrueType font");
+    const uint16_t tables = m_r.u16(4);
+    size_t head = 0, maxp = 0, hhea = 0;
+    for(uint16_t i=0;i<tables;++i){
+      const size_t rec = 12 + size_t{i}*16;
+      const uint32_t offset = m_r.u32(rec + 8), length = m_r.u32(rec + 12);
+      m_r.check(offset, length);
+      switch(m_r.u32(rec)){
+        case 0x68656164: head = offset; break; // 'head'
+        case 0x6d617870: maxp = offset; break; // 'maxp'
+        case 0x68686561: hhea = offset; break; // 'hhea'
+        case 0x686d7478: m_hmtx = offset; break;
+        case 0x6c6f6361: m_loca = offset; break;
+        case 0x676c7966: m_glyf = offset; m_glyfLength = length; break;
+        case 0x636d6170: m_cmap = offset; break;
+        default: break;
+      }
+    }
+    if(!head || !maxp || !hhea || !m_hmtx || !m_loca || !m_glyf || !m_cmap) fail("missing a required table");
+    unitsPerEm = m_r.u16(head + 18);
+    if(unitsPerEm == 0) fail("zero units per em");
+    m_longLoca = m_r.i16(head + 50) != 0;
+    m_glyphs = m_r.u16(maxp + 4);
+    ascender = m_r.i16(hhea + 4);
+    descender = m_r.i16(hhea + 6);
+    lineGap = m_r.i16(hhea + 8);
+    m_hMetrics = m_r.u16(hhea + 34);
+    if(m_hMetrics == 0) fail("no horizontal metrics");
+    selectCmap();
+  }
+
+  uint16_t unitsPerEm{0};
+  int16_t ascender{0}, descender{0}, lineGap{0};
+
+  uint32_t glyphIndex(uint32_t c) const {
+    const size_t t = m_cmapTable;
+    if(m_cmapFormat == 12){
+      const uint32_t groups = m_r.u32(t + 12);
+      for(uint32_t i=0;i<groups;++i){
+        const size_t g = t + 16 + size_t{i}*12;
+        if(c >= m_r.u32(g) && c <= m_r.u32(g + 4)) return m_r.u32(g + 8) + (c - m_r.u32(g));
+      }
+      return 0;
+    }
+    const size_t segX2 = m_r.u16(t + 6);
+    const size_t ends = t + 14, starts = ends + segX2 + 2, deltas = starts + segX2, ranges = deltas + segX2;
+    for(size_t i=0;i<segX2;i+=2){
+      if(c > m_r.u16(ends + i)) continue;
+      const uint16_t start = m_r.u16(starts + i);
+      if(c < start) return 0;
+      const uint16_t delta = m_r.u16(deltas + i), range = m_r.u16(ranges + i);
+      if(range == 0) return (c + delta) & 0xffff;
+      const uint16_t g = m_r.u16(ranges + i + range + 2*(c - start));
+      return g ? (g + delta) & 0xffffu : 0;
+    }
+    return 0;
+  }
+
+  float advance(uint32_t glyph) const {
+    const uint32_t i = std::min<uint32_t>(glyph, m_hMetrics - 1u);
+    return m_r.u16(m_hmtx + size_t{i}*4);
+  }
+
+  // Appends the glyph's outline as line segments in font units, curves
+  // flattened to roughly `tolerance` units.
+  void outline(uint32_t glyph, float tolerance, std::vector<Edge>& out, const Transform& t = {}, int depth = 0) const {
+    if(glyph >= m_glyphs || depth > MAX_COMPOSITE_DEPTH) return;
+    const size_t begin = glyphOffset(glyph), end = glyphOffset(glyph + 1);
+    if(end <= begin) return; // no outline (space)
+    if(end > m_glyfLength) fail("glyph out of bounds");
+    const size_t g = m_glyf + begin;
+    const int16_t contours = m_r.i16(g);
+    if(contours >= 0) simpleOutline(g, static_cast<size_t>(contours), tolerance, out, t);
+    else compositeOutline(g, tolerance, out, t, depth);
+  }
+
+private:
+  void selectCmap(){
+    const uint16_t count = m_r.u16(m_cmap + 2);
+    int best = -1;
+    for(uint16_t i=0;i<count;++i){
+      const size_t rec = m_cmap + 4 + size_t{i}*8;
+      const uint16_t platform = m_r.u16(rec), encoding = m_r.u16(rec + 2);
+      const size_t table = m_cmap + m_r.u32(rec + 4);
+      const uint16_t format = m_r.u16(table);
+      const bool unicode = platform == 0 || (platform == 3 && (encoding == 1 || encoding == 10));
+      if(!unicode || (format != 4 && format != 12)) continue;
+      const int score = format == 12 ? 2 : 1;
+      if(score > best){ best = score; m_cmapTable = table; m_cmapFormat = format; }
+    }
+    if(best < 0) fail("no Unicode character map (format 4 or 12)");
+  }
+
+  size_t glyphOffset(uint32_t glyph) const {
+    return m_longLoca ? m_r.u32(m_loca + size_t{glyph}*4) : size_t{m_r.u16(m_loca + size_t{glyph}*2)} * 2;
+  }
+
+  struct Point { float x, y; bool on; };
+
+  void simpleOutline(size_t g, size_t contours, float tolerance, std::vector<Edge>& out, const Transform& t) const {
+    if(contours == 0) return;
+    std::vector<uint16_t> ends(contours);
+    for(size_t i=0;i<contours;++i) ends[i] = m_r.u16(g + 10 + 2*i);
+    const size_t points = size_t{ends.back()} + 1;
+    size_t p = g + 10 + 2*contours;
+    p += size_t{2} + m_r.u16(p); // instructions
+    std::vector<uint8_t> flags(points);
+    for(size_t i=0;i<points;){
+      const uint8_t f = m_r.u8(p++);
+      flags[i++] = f;
+      if(f & 8) for(uint8_t n = m_r.u8(p++); n > 0 && i < points; --n) flags[i++] = f;
+    }
+    std::vector<Point> pts(points);
+    auto coords = [&](uint8_t shortBit, uint8_t sameBit, float Point::*field){
+      int v = 0;
+      for(size_t i=0;i<points;++i){
+        const uint8_t f = flags[i];
+        if(f & shortBit){ const int d = m_r.u8(p++); v += (f & sameBit) ? d : -d; }
+        else if(!(f & sameBit)){ v += m_r.i16(p); p += 2; }
+        pts[i].*field = static_cast<float>(v);
+      }
+    };
+    coords(2, 16, &Point::x);
+    coords(4, 32, &Point::y);
+    for(size_t i=0;i<points;++i){
+      const float x = pts[i].x, y = pts[i].y;
+      pts[i] = {t.x(x, y), t.y(x, y), (flags[i] & 1) != 0};
+    }
+    size_t first = 0;
+    for(size_t c=0;c<contours;++c){
+      const size_t last = ends[c];
+      if(last < first || last >= points) fail("bad contour");
+      contour(std::span<const Point>(pts).subspan(first, last - first + 1), tolerance, out);
+      first = last + 1;
+    }
+  }
+
+  // Quadratic B-spline contour: consecutive off-curve points imply an on-curve
+  // point halfway between them.
+  static void contour(std::span<const Point> pts, float tolerance, std::vector<Edge>& out){
+    const size_t n = pts.size();
+    if(n < 2) return;
+    auto mid = [](const Point& a, const Point& b){ return Point{(a.x + b.x)*0.5f, (a.y + b.y)*0.5f, true}; };
+    Point start;
+    size_t from = 0, count = n;
+    if(pts[0].on){ start = pts[0]; from = 1; count = n - 1; }
+    else if(pts[n - 1].on){ start = pts[n - 1]; count = n - 1; }
+    else start = mid(pts[n - 1], pts[0]);
+    Point cur = start, ctrl{};
+    bool curved = false;
+    auto line = [&](const Point& to){ out.push_back({cur.x, cur.y, to.x, to.y}); cur = to; };
+    auto quad = [&](const Point& c, const Point& to){
+      const float dx = cur.x - 2.f*c.x + to.x, dy = cur.y - 2.f*c.y + to.y;
+      // A chord over 1/n of the curve strays |p0 - 2c + p2| / (4n^2) from it.
+      const auto steps = static_cast<int>(std::clamp(std::ceil(std::sqrt(std::sqrt(dx*dx + dy*dy) / (4.f*tolerance))), 1.f, 16.f));
+      const Point p0 = cur;
+      for(int s=1;s<=steps;++s){
+        const float u = static_cast<float>(s) / static_cast<float>(steps), v = 1.f - u;
+        line({v*v*p0.x + 2.f*u*v*c.x + u*u*to.x, v*v*p0.y + 2.f*u*v*c.y + u*u*to.y, true});
+      }
+    };
+    for(size_t k=0;k<count;++k){
+      const Point& q = pts[(from + k) % n];
+      if(q.on){
+        if(curved) quad(ctrl, q); else line(q);
+        curved = false;
+      } else {
+        if(curved) quad(ctrl, mid(ctrl, q));
+        ctrl = q;
+        curved = true;
+      }
+    }
+    if(curved) quad(ctrl, start); else line(start);
+  }
+
+  void compositeOutline(size_t g, float tolerance, std::vector<Edge>& out, const Transform& parent, int depth) const {
+    constexpr uint16_t WORDS = 1, XY = 2, SCALE = 8, MORE = 0x20, XY_SCALE = 0x40, TWO_BY_TWO = 0x80;
+    auto f2dot14 = [&](size_t at){ return static_cast<float>(m_r.i16(at)) / 16384.f; };
+    size_t p = g + 10;
+    uint16_t flags = 0;
+    do {
+      flags = m_r.u16(p);
+      const uint16_t component = m_r.u16(p + 2);
+      p += 4;
+      float dx = 0.f, dy = 0.f;
+      if(flags & WORDS){ dx = m_r.i16(p); dy = m_r.i16(p + 2); p += 4; }
+      else { dx = static_cast<int8_t>(m_r.u8(p)); dy = static_cast<int8_t>(m_r.u8(p + 1)); p += 2; }
+      if(!(flags & XY)) dx = dy = 0.f; // point-matched placement is not supported
+      Transform t;
+      if(flags & SCALE){ t.a = t.d = f2dot14(p); p += 2; }
+      else if(flags & XY_SCALE){ t.a = f2dot14(p); t.d = f2dot14(p + 2); p += 4; }
+      else if(flags & TWO_BY_TWO){ t.a = f2dot14(p); t.b = f2dot14(p + 2); t.c = f2dot14(p + 4); t.d = f2dot14(p + 6); p += 8; }
+      t.e = dx;
+      t.f = dy;
+      outline(component, tolerance, out, t.then(parent), depth + 1);
+    } while(flags & MORE);
+  }
+
+  Reader m_r;
+  size_t m_hmtx{0}, m_loca{0}, m_glyf{0}, m_glyfLength{0}, m_cmap{0}, m_cmapTable{0};
+  uint16_t m_cmapFormat{0}, m_glyphs{0}, m_hMetrics{0};
+  bool m_longLoca{false};
+};
+
+// Distance field of one glyph into its atlas rectangle. Edges are in pixels
+// relative to the rectangle, y down; inside is decided by the nonzero rule.
+void renderField(std::span<const Edge> edges, const FontAtlas::Glyph& g, float spread, uint32_t stride, uint8_t* pixels){
+  const float scale = 127.f / spread;
+  for(uint32_t row=0; row<g.h; ++row){
+    const float py = static_cast<float>(row) + 0.5f;
+    uint8_t* dst = pixels + size_t{g.y + row}*stride + g.x;
+    for(uint32_t col=0; col<g.w; ++col){
+      const float px = static_cast<float>(col) + 0.5f;
+      float best = 1e30f;
+      int winding = 0;
+      for(const Edge& e : edges){
+        const float ex = e.x1 - e.x0, ey = e.y1 - e.y0;
+        const float wx = px - e.x0, wy = py - e.y0;
+        const float len2 = ex*ex + ey*ey;
+        const float u = len2 > 0.f ? std::clamp((wx*ex + wy*ey) / len2, 0.f, 1.f) : 0.f;
+        const float dx = wx - u*ex, dy = wy - u*ey;
+        best = std::min(best, dx*dx + dy*dy);
+        const float side = ex*wy - ey*wx;
+        if(e.y0 <= py){ if(e.y1 > py && side > 0.f) ++winding; }
+        else if(e.y1 <= py && side < 0.f) --winding;
+      }
+      const float d = std::sqrt(best) * (winding != 0 ? 1.f : -1.f);
+      dst[col] = static_cast<uint8_t>(std::clamp(128.f + d*scale, 0.f, 255.f) + 0.5f);
+    }
+  }
+}
+}
+
+FontAtlas buildFontAtlas(std::span<const uint8_t> ttf, const FontAtlasParams& params, JobSystem* jobs){
+  BLOCCO_ZONE("build font atlas");
+  if(!(params.pixelSize > 0.f) || !(params.spread > 0.f)) fail("atlas size and spread must be positive");
+  const TrueType font(ttf);
+  const float em = font.unitsPerEm;
+  const float scale = params.pixelSize / em; // font units to pixels
+  const int pad = static_cast<int>(std::ceil(params.spread)) + 1;
+  FontAtlas atlas;
+  atlas.params = params;
+  atlas.ascender = font.ascender / em;
+  atlas.descender = font.descender / em;
+  atlas.lineGap = font.lineGap / em;
+
+  // Outlines in pixels relative to each glyph's rectangle.
+  std::vector<std::vector<Edge>> outlines(GLYPH_COUNT);
+  for(size_t i=0;i<GLYPH_COUNT;++i){
+    const uint32_t index = font.glyphIndex(FontAtlas::FIRST + static_cast<uint32_t>(i));
+    FontAtlas::Glyph& g = atlas.glyphs[i];
+    g.advance = font.advance(index) / em;
+    std::vector<Edge>& edges = outlines[i];
+    font.outline(index, 0.25f / scale, edges);
+    if(edges.empty()) continue;
+    float x0 = edges[0].x0, x1 = x0, y0 = edges[0].y0, y1 = y0;
+    for(const Edge& e : edges){
+      x0 = std::min(x0, e.x0); x1 = std::max(x1, e.x0);
+      y0 = std::min(y0, e.y0); y1 = std::max(y1, e.y0);
+    }
+    const int left = static_cast<int>(std::floor(x0*scale)) - pad, right = static_cast<int>(std::ceil(x1*scale)) + pad;
+    const int top = static_cast<int>(std::ceil(y1*scale)) + pad, bottom = static_cast<int>(std::floor(y0*scale)) - pad;
+    if(right - left > 0xffff || top - bottom > 0xffff) fail("glyph too large");
+    g.w = static_cast<uint16_t>(right - left);
+    g.h = static_cast<uint16_t>(top - bottom);
+    g.left = static_cast<float>(left) / params.pixelSize;
+    g.top = static_cast<float>(top) / params.pixelSize;
+    for(Edge& e : edges){
+      e = {e.x0*scale - static_cast<float>(left), static_cast<float>(top) - e.y0*scale,
+           e.x1*scale - static_cast<float>(left), static_cast<float>(top) - e.y1*scale};
+    }
+  }
+
+  // Shelf packing, tallest first, with a pixel of clearance around each glyph.
+  std::vector<size_t> order(GLYPH_COUNT);
+  std::iota(order.begin(), order.end(), size_t{0});
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b){ return atlas.glyphs[a].h > atlas.glyphs[b].h; });
+  uint32_t x = 1, y = 1, shelf = 0;
+  for(const size_t i : order){
+    FontAtlas::Glyph& g = atlas.glyphs[i];
+    if(g.w == 0) continue;
+    if(g.w + 2u > params.width) fail("atlas narrower than a glyph");
+    if(x + g.w + 1u > params.width){ x = 1; y += shelf + 1; shelf = 0; }
+    g.x = static_cast<uint16_t>(x);
+    g.y = static_cast<uint16_t>(y);
+    x += g.w + 1u;
+    shelf = std::max<uint32_t>(shelf, g.h);
+  }
+  atlas.width = params.width;
+  atlas.height = (y + shelf + 1 + 3) & ~3u;
+  if(atlas.height > 0xffff) fail("atlas too tall");
+  atlas.pixels.assign(size_t{atlas.width} * atlas.height, 0);
+
+  auto render = [&](size_t begin, size_t end){
+    for(size_t i=begin;i<end;++i) renderField(outlines[i], atlas.glyphs[i], params.spread, atlas.width, atlas.pixels.data());
+  };
+  if(jobs) jobs->parallelFor(0, GLYPH_COUNT, 4, render);
+  else render(0, GLYPH_COUNT);
+  return atlas;
+}
+
+namespace FontAtlasFile {
+uint64_t key(std::span<const uint8_t> ttf, const FontAtlasParams& params){
+  uint8_t tail[16];
+  std::memcpy(tail, &FORMAT_VERSION, 4);
+  std::memcpy(tail + 4, &params.pixelSize, 4);
+  std::memcpy(tail + 8, &params.spread, 4);
+  std::memcpy(tail + 12, &params.width, 4);
+  return fnv1a(tail, fnv1a(ttf));
+}
+
+std::vector<uint8_t> encode(uint64_t key, const FontAtlas& atlas){
+  std::vector<uint8_t> out(HEADER_BYTES + atlas.pixels.size());
+  size_t at = 0;
+  put(out, at, MAGIC);
+  put(out, at, FORMAT_VERSION);
+  put(out, at, key);
+  put(out, at, atlas.width); put(out, at, atlas.height);
+  put(out, at, atlas.ascender); put(out, at, atlas.descender); put(out, at, atlas.lineGap);
+  for(const FontAtlas::Glyph& g : atlas.glyphs){
+    put(out, at, g.x); put(out, at, g.y); put(out, at, g.w); put(out, at, g.h);
+    put(out, at, g.left); put(out, at, g.top); put(out, at, g.advance);
+  }
+  put(out, at, fnv1a(atlas.pixels));
+  putBytes(out, at, atlas.pixels);
+  return out;
+}
+
+bool decode(std::span<const uint8_t> file, uint64_t key, FontAtlas& atlas){
+  if(file.size() < HEADER_BYTES || std::memcmp(file.data(), MAGIC, 4) != 0) return false;
+  size_t at = 4;
+  if(get<uint32_t>(file, at) != FORMAT_VERSION || get<uint64_t>(file, at) != key) return false;
+  FontAtlas a;
+  a.width = get<uint32_t>(file, at);
+  a.height = get<uint32_t>(file, at);
+  if(file.size() - HEADER_BYTES != uint64_t{a.width} * a.height) return false;
+  a.ascender = get<float>(file, at); a.descender = get<float>(file, at); a.lineGap = get<float>(file, at);
+  for(FontAtlas::Glyph& g : a.glyphs){
+    g.x = get<uint16_t>(file, at); g.y = get<uint16_t>(file, at); g.w = get<uint16_t>(file, at); g.h = get<uint16_t>(file, at);
+    g.left = get<float>(file, at); g.top = get<float>(file, at); g.advance = get<float>(file, at);
+    if(uint32_t{g.x} + g.w > a.width || uint32_t{g.y} + g.h > a.height) return false;
+  }
+  const auto hash = get<uint64_t>(file, at);
+  const std::span<const uint8_t> pixels = file.subspan(HEADER_BYTES);
+  if(fnv1a(pixels) != hash) return false;
+  a.pixels.assign(pixels.begin(), pixels.end());
+  const FontAtlasParams params = atlas.params;
+  atlas = std::move(a);
+  atlas.params = params;
+  return true;
+}
+
+bool load(const std::string& path, uint64_t key, FontAtlas& atlas){
+  std::ifstream f(path, std::ios::binary);
+  if(!f) return false;
+  const std::vector<uint8_t> file((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+  return decode(file, key, atlas);
+}
+
+bool save(const std::string& path, uint64_t key, const FontAtlas& atlas){
+  std::error_code ec;
+  const std::filesystem::path target(path);
+  if(target.has_parent_path()) std::filesystem::create_directories(target.parent_path(), ec);
+  const std::string tmp = path + ".tmp";
+  const std::vector<uint8_t> file = encode(key, atlas);
+  {
+    std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+    if(!f) return false;
+    f.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+    if(!f) return false;
+  }
+  std::filesystem::rename(tmp, target, ec);
+  if(ec){ std::filesystem::remove(tmp, ec); return false; }
+  return true;
+}
+}
+
+FontAtlas loadOrBuildFontAtlas(const std::string& ttfPath, const std::string& cacheDirectory,
+                               const FontAtlasParams& params, JobSystem* jobs, bool* cached){
+  std::ifstream f(ttfPath, std::ios::binary);
+  if(!f) fail("cannot read " + ttfPath);
+  const std::vector<uint8_t> ttf((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+  const uint64_t key = FontAtlasFile::key(ttf, params);
+  char name[32];
+  std::snprintf(name, sizeof(name), "font_%016llx.sdf", static_cast<unsigned long long>(key));
+  const std::string path = (std::filesystem::path(cacheDirectory) / name).string();
+  FontAtlas atlas;
+  atlas.params = params;
+  const bool hit = FontAtlasFile::load(path, key, atlas);
+  if(cached) *cached = hit;
+  if(hit) return atlas;
+  atlas = buildFontAtlas(ttf, params, jobs);
+  if(!FontAtlasFile::save(path, key, atlas)) Log::warn("font atlas cache not written to {}", path);
+  return atlas;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+// Signed distance field atlas of the printable ASCII glyphs of a TrueType
+// font. Each texel holds the distance to the nearest outline edge, 128 on the
+// edge, rising inside and falling outside, reaching 255/0 at `spread` pixels;
+// the text shader thresholds it, so one atlas renders crisply at any size.
+struct FontAtlasParams {
+  float pixelSize{48.f}; // size of one em in atlas pixels
+  float spread{6.f};     // distance range in atlas pixels
+  uint32_t width{512};   // atlas width; the height grows to fit
+  bool operator==(const FontAtlasParams&) const = default;
+};
+
+struct FontAtlas {
+  static constexpr uint32_t FIRST = 32, LAST = 126;
+  struct Glyph {
+    uint16_t x{0}, y{0}, w{0}, h{0}; // atlas rectangle in pixels, zero for blank glyphs
+    float left{0.f}, top{0.f};        // rectangle corner relative to the pen on the baseline, in em (y up)
+    float advance{0.f};               // em
+  };
+  uint32_t width{0}, height{0};
+  std::vector<uint8_t> pixels; // R8, row-major
+  FontAtlasParams params;
+  float ascender{0.f}, descender{0.f}, lineGap{0.f}; // em; descender is negative
+  std::array<Glyph, LAST - FIRST + 1> glyphs{};
+  // Characters outside FIRST..LAST map to '?'.
+  const Glyph& glyph(uint32_t c) const { return glyphs[(c >= FIRST && c <= LAST ? c : uint32_t{'?'}) - FIRST]; }
+  float lineHeight() const { return ascender - descender + lineGap; }
+};
+
+// Parses the font (TrueType outlines: simple and composite glyf glyphs, cmap
+// formats 4 and 12) and renders the distance fields, one glyph per job when a
+// job system is given. Throws std::runtime_error on malformed or unsupported
+// fonts (CFF-based OpenType has no glyf table).
+FontAtlas buildFontAtlas(std::span<const uint8_t> ttf, const FontAtlasParams& params = {}, JobSystem* jobs = nullptr);
+
+// Atlases are cached on disk keyed by the font's contents and the parameters.
+namespace FontAtlasFile {
+uint64_t key(std::span<const uint8_t> ttf, const FontAtlasParams& params);
+std::vector<uint8_t> encode(uint64_t key, const FontAtlas& atlas);
+// False when the data is not a valid atlas for this key.
+bool decode(std::span<const uint8_t> file, uint64_t key, FontAtlas& atlas);
+bool load(const std::string& path, uint64_t key, FontAtlas& atlas);
+bool save(const std::string& path, uint64_t key, const FontAtlas& atlas); // atomic: written aside, then renamed
+}
+
+// Reads the TTF and returns its atlas from cacheDirectory when a matching one
+// was saved there, else builds and saves it. Throws std::runtime_error when the
+// font cannot be read or parsed.
+FontAtlas loadOrBuildFontAtlas(const std::string& ttfPath, const std::string& cacheDirectory,
+                               const FontAtlasParams& params = {}, JobSystem* jobs = nullptr, bool* cached = nullptr);
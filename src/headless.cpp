@@ -1,10 +1,358 @@
 #include "engine.hpp"
+#include "camera.hpp"
+#include "capture.hpp"
+#include "config.hpp"
+#include "input.hpp"
+#include "labels.hpp"
+#include "logging.hpp"
+#include "mesher.hpp"
+#include "physics.hpp"
+#include "profiler.hpp"
+#include "renderer.hpp"
+#include "streamed_world.hpp"
+#include "terrain.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
-int main(){
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+// Usage: blocco_headless [--capture <dir>] [--qoi] [--thumbnail <factor>] [--draws <count>]
+//                        [--no-cull | --cull-compare] [--threads N] [--serial-record]
+//                        [--pipeline-cache <file>] [--cold-start]
+//                        [--fly-through [--radius N] [--lod N] [--sync-uploads] [--edits N]] [--frames N]
+//                        [--vertex-format float|packed|pull]
+//                        [--physics N [--record <file> | --replay <file>]]
+//                        [--trace <file.json>] [--font <file.ttf> [--labels N]]
+// --cull-compare renders the first half of the frames without culling and the
+// second half with it, then reports the GPU time saved. --cold-start deletes the
+// pipeline cache first; run again without it to compare with a warm start.
+// --fly-through streams terrain around a camera flying along +X and reports
+// frame time percentiles and chunks streamed per second, plus upload throughput
+// and frame times of frames that submitted uploads against those that did not;
+// --sync-uploads writes meshes directly instead, for comparison. The fly-through
+// also reports mesh memory per chunk; --vertex-format picks 32-byte float
+// vertices, 8-byte packed ones (the default) or packed ones pulled from a
+// storage buffer, to compare memory and frame times. --edits toggles N blocks
+// a second around the camera while flying and reports how long an edit takes
+// to reach the screen. --lod adds N coarser levels of terrain tiles past the
+// radius, each doubling the view distance, and reports the triangles drawn per
+// frame (compare --radius 8 against --radius 4 --lod 3). --physics drops N boxes
+// on a patch of terrain and walks a character through it on scripted input (or
+// a recorded stream), then prints step times and a hash of the final state:
+// a replay of the same stream through the same build prints the same hash.
+// --trace records profiler zones (CPU threads plus GPU passes) for the whole
+// run and writes them as a Chrome trace for chrome://tracing or Perfetto.
+// --font draws the HUD with that font (the atlas is cached after the first
+// run); --labels adds N world labels on a grid in front of the camera and
+// reports the CPU time spent laying out text each frame.
+int main(int argc, char** argv){
   try {
-    Engine engine(true /*headless*/);
-    engine.headlessCapture(120); // frames
+    Capture::RecorderOptions capture;
+    bool captureEnabled = false;
+    uint32_t draws = 0;
+    bool cull = true, cullCompare = false, serialRecord = false, coldStart = false, flyThrough = false;
+    int frames = 0, radius = StreamingConfig{}.radius, lodLevels = 0, bodies = -1, labelCount = 0;
+    double editsPerSecond = 0.0;
+    std::string recordPath, replayPath, tracePath;
+    Config config;
+    for(int i=1;i<argc;++i){
+      const std::string arg = argv[i];
+      if(arg == "--capture" && i+1 < argc){ capture.directory = argv[++i]; captureEnabled = true; }
+      else if(arg == "--qoi"){ capture.format = Capture::Format::QOI; }
+      else if(arg == "--thumbnail" && i+1 < argc){ capture.thumbnailFactor = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)); }
+      else if(arg == "--draws" && i+1 < argc){ draws = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)); }
+      else if(arg == "--no-cull"){ cull = false; }
+      else if(arg == "--cull-compare"){ cullCompare = true; }
+      else if(arg == "--threads" && i+1 < argc){ config.workerThreads = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)); }
+      else if(arg == "--serial-record"){ serialRecord = true; }
+      else if(arg == "--pipeline-cache" && i+1 < argc){ config.pipelineCachePath = argv[++i]; }
+      else if(arg == "--cold-start"){ coldStart = true; }
+      else if(arg == "--fly-through"){ flyThrough = true; }
+      else if(arg == "--radius" && i+1 < argc){ radius = std::atoi(argv[++i]); }
+      else if(arg == "--lod" && i+1 < argc){ lodLevels = std::atoi(argv[++i]); }
+      else if(arg == "--sync-uploads"){ config.asyncUploads = false; }
+      else if(arg == "--edits" && i+1 < argc){ editsPerSecond = std::atof(argv[++i]); }
+      else if(arg == "--vertex-format" && i+1 < argc){
+        const std::string f = argv[++i];
+        if(f != "float" && f != "packed" && f != "pull"){ std::cerr << "Unknown vertex format: " << f << "\n"; return 1; }
+        config.packedVertices = f != "float";
+        config.vertexPulling = f == "pull";
+      }
+      else if(arg == "--frames" && i+1 < argc){ frames = std::atoi(argv[++i]); }
+      else if(arg == "--physics" && i+1 < argc){ bodies = std::atoi(argv[++i]); }
+      else if(arg == "--record" && i+1 < argc){ recordPath = argv[++i]; }
+      else if(arg == "--replay" && i+1 < argc){ replayPath = argv[++i]; }
+      else if(arg == "--trace" && i+1 < argc){ tracePath = argv[++i]; }
+      else if(arg == "--font" && i+1 < argc){ config.fontPath = argv[++i]; }
+      else if(arg == "--labels" && i+1 < argc){ labelCount = std::atoi(argv[++i]); }
+      else { std::cerr << "Unknown argument: " << arg << "\n"; return 1; }
+    }
+    if(!tracePath.empty()){
+      if(!Profiler::ENABLED){ std::cerr << "--trace needs a build with BLOCCO_ENABLE_PROFILER=ON\n"; return 1; }
+      Profiler::setThreadName("main");
+      Profiler::start(); // before the engine, so startup is in the trace
+    }
+    if(coldStart){
+      std::error_code ec;
+      std::filesystem::remove(Renderer::pipelineCachePath(config), ec);
+    }
+    Engine engine(true /*headless*/, config);
+    if(captureEnabled){
+      std::filesystem::create_directories(capture.directory);
+      engine.enableCapture(capture);
+    }
+    // Draw benchmark scene: a few distinct terrain chunk meshes instanced over a
+    // flat grid of chunk positions, resubmitted every frame.
+    Renderer& renderer = engine.renderer();
+    std::vector<Renderer::Mesh> meshes;
+    if(draws > 0){
+      Scene scene;
+      constexpr int VARIANTS = 4;
+      for(int v=0;v<VARIANTS;++v)
+        for(int x=0;x<Chunk::SIZE;++x) for(int z=0;z<Chunk::SIZE;++z){
+          const int h = 6 + (x*(v+3) + z*(7-v)) % 12;
+          scene.fill({v*Chunk::SIZE + x, 0, z}, {v*Chunk::SIZE + x + 1, h, z + 1}, static_cast<BlockId>(1 + (h > 12)));
+        }
+      ChunkMesher mesher;
+      MeshBuffers buf;
+      buf.format = renderer.vertexFormat();
+      for(int v=0;v<VARIANTS;++v){
+        mesher.mesh(scene, {v, 0, 0}, buf);
+        meshes.push_back(renderer.uploadMesh(buf));
+      }
+      // Above the near edge of the grid looking across it (towards +Z).
+      Camera& camera = engine.camera();
+      camera.position = {0.f, 120.f, -40.f};
+      camera.yaw = 3.14159265f;
+      camera.pitch = std::atan2(-120.f, 440.f);
+    }
+    // Fly-through: terrain streamed around a camera crossing a chunk every eight
+    // frames, drawn from the meshes the streamer hands over. Remeshes after
+    // edits keep the old mesh drawing until the new one has landed on the GPU.
+    std::unique_ptr<StreamedWorld> world;
+    std::vector<double> trianglesDrawn;
+    constexpr float FLY_SPEED = Chunk::SIZE / 8.f; // blocks per frame
+    if(flyThrough){
+      StreamingConfig streaming;
+      streaming.radius = radius;
+      streaming.lodLevels = lodLevels;
+      world = std::make_unique<StreamedWorld>(renderer, engine.jobs(), [](const ChunkCoord& c, Chunk& out){ generateTerrain(TerrainParams{}, c, out); }, streaming);
+      world->streamer().setLodGenerator([](const LodTile& t, Chunk& out){ generateTerrainLod(TerrainParams{}, t, out); });
+      Camera& camera = engine.camera();
+      camera.position = {0.f, 90.f, 0.f};
+      camera.yaw = 1.5707963f; // towards +X
+      camera.pitch = -0.3f;
+    }
+    // Physics: a 4x4-chunk patch of terrain, boxes dropped over its middle in
+    // layers, and a character walking a widening circle and jumping now and then.
+    std::vector<std::pair<ChunkCoord, Renderer::Mesh>> patch;
+    std::optional<Renderer::Mesh> cube;
+    std::vector<PlayerInput> inputs;
+    std::vector<double> stepMs;
+    if(bodies >= 0){
+      const TerrainParams terrain{};
+      Scene& ground = engine.world();
+      for(int y=-1;y<3;++y) for(int z=-2;z<2;++z) for(int x=-2;x<2;++x) generateTerrain(terrain, {x, y, z}, ground.chunkAt({x, y, z}));
+      ChunkMesher mesher;
+      MeshBuffers buf;
+      buf.format = renderer.vertexFormat();
+      for(const auto& [c, chunk] : ground.chunks()){
+        if(chunk.empty()) continue;
+        mesher.mesh(ground, c, buf);
+        if(!buf.empty()) patch.emplace_back(c, renderer.uploadMesh(buf));
+      }
+      Scene unit;
+      unit.setBlock(0, 0, 0, BLOCK_STONE);
+      mesher.mesh(unit, {0, 0, 0}, buf);
+      cube = renderer.uploadMesh(buf);
+      PhysicsWorld& physics = engine.physics();
+      constexpr int SIDE = 16;
+      for(int i=0;i<bodies;++i){
+        const int x = i % SIDE - SIDE/2, z = (i / SIDE) % SIDE - SIDE/2, layer = i / (SIDE*SIDE);
+        const float y = static_cast<float>(terrainHeight(terrain, 2*x, 2*z)) + 3.f + 1.5f*static_cast<float>(layer);
+        physics.addBody({2.f*static_cast<float>(x) + 0.5f, y, 2.f*static_cast<float>(z) + 0.5f}, {0.5f, 0.5f, 0.5f}, 1.f);
+      }
+      physics.spawnCharacter({0.5f, static_cast<float>(terrainHeight(terrain, 0, 0)) + 4.f, 0.5f});
+      if(!replayPath.empty() && !InputLog::load(replayPath, inputs)) throw std::runtime_error("Failed to load input log " + replayPath);
+      const bool replaying = !replayPath.empty();
+      engine.setInputSource([&inputs, replaying](uint64_t step){
+        if(replaying) return step < inputs.size() ? inputs[step] : PlayerInput{};
+        PlayerInput in;
+        in.forward = 1.f;
+        in.yaw = static_cast<float>(step) * 0.01f;
+        in.jump = step % 120 == 60;
+        inputs.push_back(in);
+        return in;
+      });
+    }
+    // Labels: a square grid four blocks apart, starting twenty blocks ahead of the camera.
+    if(labelCount > 0){
+      if(!engine.labels()) throw std::runtime_error("--labels needs --font");
+      const Camera& camera = engine.camera();
+      const Vec3 ahead = camera.forward(), across = camera.right();
+      const int side = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(labelCount))));
+      for(int i=0;i<labelCount;++i){
+        const auto row = static_cast<float>(i / side), column = static_cast<float>(i % side - side/2);
+        engine.labels()->add(camera.position + ahead*(20.f + 4.f*row) + across*(4.f*column), "label " + std::to_string(i), 14.f);
+      }
+    }
+    const int FRAMES = frames > 0 ? frames : flyThrough ? 600 : 120;
+    const auto side = static_cast<uint32_t>(std::sqrt(static_cast<double>(draws))) + 1;
+    renderer.setCulling(cull && !cullCompare);
+    renderer.setParallelRecording(!serialRecord);
+    const auto start = std::chrono::steady_clock::now();
+    auto lastFrame = start;
+    double editBudget = 0.0;
+    uint32_t editSeed = 12345;
+    engine.headlessCapture(FRAMES, [&](JobSystem&, int frame){
+      if(cullCompare && frame == FRAMES/2) renderer.setCulling(true);
+      if(world){
+        Camera& camera = engine.camera();
+        camera.position.x += FLY_SPEED;
+        // Edits: toggle blocks near the surface within a chunk or so of the camera.
+        const auto now = std::chrono::steady_clock::now();
+        editBudget += editsPerSecond * std::chrono::duration<double>(now - lastFrame).count();
+        lastFrame = now;
+        for(; editBudget >= 1.0; editBudget -= 1.0){
+          auto next = [&](int range){ editSeed = editSeed*1664525u + 1013904223u; return static_cast<int>((editSeed >> 8) % static_cast<uint32_t>(2*range + 1)) - range; };
+          const int x = static_cast<int>(std::floor(camera.position.x)) + next(Chunk::SIZE);
+          const int z = static_cast<int>(std::floor(camera.position.z)) + next(Chunk::SIZE);
+          const int y = terrainHeight(TerrainParams{}, x, z) + next(3);
+          world->streamer().setBlock({x, y, z}, world->scene().getBlock(x, y, z) == BLOCK_AIR ? BLOCK_STONE : BLOCK_AIR);
+        }
+        trianglesDrawn.push_back(static_cast<double>(world->update(camera)));
+      }
+      if(cube){
+        const PhysicsWorld& physics = engine.physics();
+        if(physics.stats().steps > stepMs.size()) stepMs.push_back(physics.stats().stepMs);
+        constexpr float N = Chunk::SIZE;
+        for(const auto& [c, mesh] : patch)
+          renderer.submitDraw(mesh, 0, translate({static_cast<float>(c.x)*N, static_cast<float>(c.y)*N, static_cast<float>(c.z)*N}));
+        for(uint32_t b=0;b<physics.bodyCount();++b)
+          renderer.submitDraw(*cube, 1, translate(physics.interpolated(b, engine.stepAlpha()) - Vec3{0.5f, 0.5f, 0.5f}));
+      }
+      for(uint32_t i=0;i<draws;++i){
+        const Vec3 origin{(static_cast<float>(i % side) - static_cast<float>(side)*0.5f) * Chunk::SIZE, 0.f, static_cast<float>(i / side) * Chunk::SIZE};
+        renderer.submitDraw(meshes[i % meshes.size()], i % 3, translate(origin));
+      }
+    });
+    if(cullCompare){
+      // Skip the first frames of each half: pipelines warm up and the depth pyramid fills.
+      constexpr int WARMUP = 10;
+      auto avgGpu = [&](int first, int last){
+        double sum = 0.0; int count = 0;
+        for(int f=first; f<last; ++f){
+          const FrameStats& s = renderer.frameStats()[static_cast<size_t>(f)];
+          if(s.gpuMs >= 0.0){ sum += s.gpuMs; ++count; }
+        }
+        return count ? sum/count : -1.0;
+      };
+      const double off = avgGpu(WARMUP, FRAMES/2), on = avgGpu(FRAMES/2 + WARMUP, FRAMES);
+      std::cout << "culling off: " << off << " ms gpu, on: " << on << " ms gpu";
+      if(off > 0.0 && on >= 0.0) std::cout << " (" << (off - on) << " ms saved)";
+      std::cout << "\n";
+    }
+    if(labelCount > 0){
+      std::vector<double> textMs;
+      uint32_t glyphs = 0;
+      for(const FrameStats& s : renderer.frameStats()){ textMs.push_back(s.textMs); glyphs = std::max(glyphs, s.glyphs); }
+      std::sort(textMs.begin(), textMs.end());
+      char line[160];
+      std::snprintf(line, sizeof(line), "labels: %d labels, up to %u glyphs per frame in one draw, text layout p50 %.3f ms p99 %.3f ms",
+                    labelCount, glyphs, textMs[textMs.size()/2], textMs[std::min(textMs.size() - 1, textMs.size()*99/100)]);
+      std::cout << line << "\n";
+    }
+    if(world){
+      const StreamedMeshes<Renderer::Mesh>& streamed = world->meshes();
+      const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      auto percentiles = [&](double FrameStats::*field){
+        std::vector<double> v;
+        for(const FrameStats& s : renderer.frameStats()) if(s.*field >= 0.0) v.push_back(s.*field);
+        std::sort(v.begin(), v.end());
+        if(v.empty()) return std::string("n/a");
+        return std::to_string(v[v.size()/2]) + " / " + std::to_string(v[std::min(v.size() - 1, v.size()*99/100)]) + " ms";
+      };
+      const StreamingStats& st = world->streamer().stats();
+      std::cout << "fly-through: cpu p50/p99 " << percentiles(&FrameStats::cpuMs) << ", gpu p50/p99 " << percentiles(&FrameStats::gpuMs)
+                << "; " << st.generated << " chunks streamed (" << static_cast<double>(st.generated)/seconds << "/s), "
+                << st.uploaded << " meshes uploaded, " << st.resident << " resident, " << static_cast<double>(st.memoryBytes)/1.0e6 << " MB";
+      if(streamed.uploadFailures()) std::cout << ", " << streamed.uploadFailures() << " uploads failed (mesh pool full)";
+      std::cout << "\n";
+      renderer.waitIdle();
+      // Frame cost of streaming bursts: frames that uploaded meshes against quiet ones.
+      auto burstP99 = [&](bool burst){
+        std::vector<double> v;
+        for(const FrameStats& s : renderer.frameStats()) if((s.uploadBytes > 0) == burst) v.push_back(s.cpuMs);
+        std::sort(v.begin(), v.end());
+        return v.empty() ? 0.0 : v[std::min(v.size() - 1, v.size()*99/100)];
+      };
+      char line[256];
+      if(renderer.asyncUploads()){
+        const vkutils::UploadStats us = renderer.uploadStats();
+        std::snprintf(line, sizeof(line), "uploads: %s queue, %.1f MB in %llu batches (%llu copies), %.0f MB/s (%s), staging peak %.1f MB, %llu stalls",
+                      us.dedicatedQueue ? "transfer" : "graphics", static_cast<double>(us.bytes)/1.0e6, static_cast<unsigned long long>(us.batches),
+                      static_cast<unsigned long long>(us.copies), us.mbPerSecond(), us.gpuTimed ? "gpu timed" : "host timed",
+                      static_cast<double>(us.staging.peak)/1.0e6, static_cast<unsigned long long>(us.stalls));
+      } else {
+        std::snprintf(line, sizeof(line), "uploads: direct writes");
+      }
+      std::cout << line;
+      std::snprintf(line, sizeof(line), "; cpu p99 %.3f ms on upload frames, %.3f ms on others", burstP99(true), burstP99(false));
+      std::cout << line << "\n";
+      const MemoryStats mm = renderer.meshMemory();
+      const char* format = renderer.vertexFormat() == VertexFormat::Float ? "float" : renderer.vertexPulling() ? "packed, pulled" : "packed";
+      std::snprintf(line, sizeof(line), "mesh memory: %s vertices, %.1f KB per chunk over %zu chunks, pool peak %.1f MB",
+                    format, streamed.chunks() == 0 ? 0.0 : static_cast<double>(mm.inUse)/1024.0/static_cast<double>(streamed.chunks()), streamed.chunks(),
+                    static_cast<double>(mm.peak)/1.0e6);
+      std::cout << line << "\n";
+      std::sort(trianglesDrawn.begin(), trianglesDrawn.end());
+      auto drawn = [&](size_t percent){ return trianglesDrawn.empty() ? 0.0 : trianglesDrawn[std::min(trianglesDrawn.size() - 1, trianglesDrawn.size()*percent/100)]; };
+      std::snprintf(line, sizeof(line), "view: radius %.0f chunks (%d LOD levels), triangles drawn p50 %.0f p99 %.0f, %u meshes drawn, %u tiles (%llu built)",
+                    static_cast<double>(world->streamer().selection().viewRadius()), lodLevels, drawn(50), drawn(99), st.visible, st.tiles,
+                    static_cast<unsigned long long>(st.tilesBuilt));
+      std::cout << line << "\n";
+      if(editsPerSecond > 0.0){
+        std::vector<double> editVisibleMs = streamed.editToDrawMs();
+        std::sort(editVisibleMs.begin(), editVisibleMs.end());
+        auto at = [&](size_t percent){ return editVisibleMs.empty() ? 0.0 : editVisibleMs[std::min(editVisibleMs.size() - 1, editVisibleMs.size()*percent/100)]; };
+        std::snprintf(line, sizeof(line), "edits: %llu applied (%llu dropped), %llu remeshes, %zu swaps, edit-to-draw p50 %.2f ms p99 %.2f ms",
+                      static_cast<unsigned long long>(st.edits), static_cast<unsigned long long>(st.editsDropped),
+                      static_cast<unsigned long long>(st.remeshes), editVisibleMs.size(), at(50), at(99));
+        std::cout << line << "\n";
+      }
+      world.reset();
+    }
+    if(cube){
+      const PhysicsWorld& physics = engine.physics();
+      std::sort(stepMs.begin(), stepMs.end());
+      const double p50 = stepMs.empty() ? 0.0 : stepMs[stepMs.size()/2];
+      const double p99 = stepMs.empty() ? 0.0 : stepMs[std::min(stepMs.size() - 1, stepMs.size()*99/100)];
+      char line[200];
+      std::snprintf(line, sizeof(line), "physics: %llu steps, %zu bodies in %u islands, step p50 %.3f ms p99 %.3f ms, state hash %016llx",
+                    static_cast<unsigned long long>(physics.stats().steps), physics.bodyCount(), physics.stats().islands, p50, p99,
+                    static_cast<unsigned long long>(physics.stateHash()));
+      std::cout << line << "\n";
+      if(!recordPath.empty() && !InputLog::save(recordPath, inputs)) throw std::runtime_error("Failed to write input log " + recordPath);
+      for(auto& [c, m] : patch) renderer.releaseMesh(m);
+      renderer.releaseMesh(*cube);
+    }
+    for(auto& m : meshes) renderer.releaseMesh(m);
+    if(!tracePath.empty()){
+      Profiler::stop();
+      const Profiler::Stats ps = Profiler::stats();
+      if(!Profiler::writeChromeTrace(tracePath)) throw std::runtime_error("Failed to write trace " + tracePath);
+      std::cout << "trace: " << ps.zones << " zones from " << ps.threads << " threads (" << ps.dropped << " dropped) written to " << tracePath << "\n";
+    }
   } catch(const std::exception& e){
+    Log::flush(); // engine messages before the error
     std::cerr << e.what() << "\n";
     return 1;
   }
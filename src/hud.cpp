@@ -0,0 +1,59 @@
+#include "hud.hpp"
+#include "labels.hpp"
+#include <algorithm>
+#include <cstdio>
+
+void Hud::addFrame(double frameMs, double cpuMs, double gpuMs, uint32_t draws, size_t glyphs){
+  m_frames[m_next] = {frameMs, cpuMs, gpuMs};
+  m_next = (m_next + 1) % FRAMES;
+  m_count = std::min(m_count + 1, FRAMES);
+  m_draws = draws;
+  m_glyphs = glyphs;
+}
+
+Hud::Summary Hud::summary() const {
+  Summary s;
+  s.frames = m_count;
+  s.draws = m_draws;
+  s.glyphs = m_glyphs;
+  if(m_count == 0) return s;
+  std::array<double, FRAMES> cpu{}, gpu{};
+  size_t gpuCount = 0;
+  double frameSum = 0.0, cpuSum = 0.0, gpuSum = 0.0;
+  for(size_t i=0;i<m_count;++i){
+    const Frame& f = m_frames[i];
+    frameSum += f.frameMs;
+    cpuSum += f.cpuMs;
+    cpu[i] = f.cpuMs;
+    if(f.gpuMs >= 0.0){ gpuSum += f.gpuMs; gpu[gpuCount++] = f.gpuMs; }
+  }
+  auto p99 = [](std::array<double, FRAMES>& v, size_t n){
+    const size_t k = std::min(n - 1, n*99/100);
+    std::nth_element(v.begin(), v.begin() + static_cast<std::ptrdiff_t>(k), v.begin() + static_cast<std::ptrdiff_t>(n));
+    return v[k];
+  };
+  const auto frames = static_cast<double>(m_count);
+  s.fps = frameSum > 0.0 ? 1000.0*frames/frameSum : 0.0;
+  s.cpuAvg = cpuSum/frames;
+  s.cpuP99 = p99(cpu, m_count);
+  if(gpuCount){
+    s.gpuAvg = gpuSum/static_cast<double>(gpuCount);
+    s.gpuP99 = p99(gpu, gpuCount);
+  }
+  return s;
+}
+
+void Hud::draw(Labels& labels, float x, float y, float pixelSize) const {
+  const Summary s = summary();
+  const float line = labels.lineHeight(pixelSize);
+  char text[96];
+  std::snprintf(text, sizeof(text), "%.1f fps", s.fps);
+  labels.text(x, y, text, pixelSize);
+  std::snprintf(text, sizeof(text), "cpu %.2f ms (p99 %.2f)", s.cpuAvg, s.cpuP99);
+  labels.text(x, y + line, text, pixelSize);
+  if(s.gpuAvg >= 0.0) std::snprintf(text, sizeof(text), "gpu %.2f ms (p99 %.2f)", s.gpuAvg, s.gpuP99);
+  else std::snprintf(text, sizeof(text), "gpu n/a");
+  labels.text(x, y + 2.f*line, text, pixelSize);
+  std::snprintf(text, sizeof(text), "%u draws, %zu glyphs", s.draws, s.glyphs);
+  labels.text(x, y + 3.f*line, text, pixelSize);
+}
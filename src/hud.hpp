@@ -0,0 +1,33 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+class Labels;
+
+// Frame-time overlay: keeps the last FRAMES frames and draws their averages,
+// 99th percentiles and counters as screen text.
+class Hud {
+public:
+  static constexpr size_t FRAMES = 120;
+  // frameMs is the wall time since the previous frame; gpuMs is negative while
+  // the GPU time of the frame is not known yet.
+  void addFrame(double frameMs, double cpuMs, double gpuMs, uint32_t draws, size_t glyphs);
+  struct Summary {
+    size_t frames{0};
+    double fps{0.0};
+    double cpuAvg{0.0}, cpuP99{0.0};
+    double gpuAvg{-1.0}, gpuP99{-1.0}; // negative without GPU timings
+    uint32_t draws{0};
+    size_t glyphs{0};
+  };
+  Summary summary() const;
+  // Adds one line per statistic at (x, y), the top left in pixels.
+  void draw(Labels& labels, float x, float y, float pixelSize) const;
+private:
+  struct Frame { double frameMs, cpuMs, gpuMs; };
+  std::array<Frame, FRAMES> m_frames{};
+  size_t m_count{0}, m_next{0};
+  uint32_t m_draws{0};
+  size_t m_glyphs{0};
+};
@@ -1 +1,71 @@
 #include "input.hpp"
+#include <SDL3/SDL.h>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+namespace {
+constexpr char MAGIC[4] = {'B', 'I', 'N', '1'};
+constexpr size_t RECORD_BYTES = 4 * sizeof(float) + 1;
+}
+
+const WindowEvents& InputSystem::poll(){
+  m_window.quit = false;
+  m_window.resized = false;
+  SDL_Event e;
+  while(SDL_PollEvent(&e)){
+    switch(e.type){
+      case SDL_EVENT_QUIT:
+      case SDL_EVENT_WINDOW_CLOSE_REQUESTED: m_window.quit = true; break;
+      case SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED:
+        m_window.resized = true;
+        m_window.minimized = e.window.data1 == 0 || e.window.data2 == 0;
+        break;
+      case SDL_EVENT_WINDOW_MINIMIZED: m_window.minimized = true; break;
+      case SDL_EVENT_WINDOW_RESTORED:
+      case SDL_EVENT_WINDOW_MAXIMIZED:
+        // Restoring may not change the size, but the old swapchain may be out of date.
+        m_window.minimized = false;
+        m_window.resized = true;
+        break;
+      default: break;
+    }
+  }
+  return m_window;
+}
+
+namespace InputLog {
+bool save(const std::string& path, std::span<const PlayerInput> steps){
+  std::vector<char> bytes(sizeof(MAGIC) + sizeof(uint64_t) + steps.size()*RECORD_BYTES);
+  char* p = bytes.data();
+  const uint64_t count = steps.size();
+  std::memcpy(p, MAGIC, sizeof(MAGIC)); p += sizeof(MAGIC);
+  std::memcpy(p, &count, sizeof(count)); p += sizeof(count);
+  for(const PlayerInput& in : steps){
+    const float v[4] = {in.forward, in.strafe, in.yaw, in.pitch};
+    std::memcpy(p, v, sizeof(v)); p += sizeof(v);
+    *p++ = in.jump ? 1 : 0;
+  }
+  std::ofstream f(path, std::ios::binary | std::ios::trunc);
+  f.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+  return static_cast<bool>(f);
+}
+
+bool load(const std::string& path, std::vector<PlayerInput>& steps){
+  std::ifstream f(path, std::ios::binary);
+  char magic[sizeof(MAGIC)];
+  uint64_t count = 0;
+  if(!f.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) return false;
+  if(!f.read(reinterpret_cast<char*>(&count), sizeof(count)) || count > (uint64_t{1} << 32)) return false;
+  std::vector<char> bytes(static_cast<size_t>(count)*RECORD_BYTES);
+  if(!f.read(bytes.data(), static_cast<std::streamsize>(bytes.size()))) return false;
+  steps.resize(static_cast<size_t>(count));
+  const char* p = bytes.data();
+  for(PlayerInput& in : steps){
+    float v[4];
+    std::memcpy(v, p, sizeof(v)); p += sizeof(v);
+    in = {v[0], v[1], v[2], v[3], *p++ != 0};
+  }
+  return true;
+}
+}
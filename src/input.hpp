@@ -1,2 +1,40 @@
 #pragma once
-class InputSystem {public: void poll(){} };
+#include <span>
+#include <string>
+#include <vector>
+
+// What the player asks for during one fixed simulation step. Angles are
+// absolute (radians, as in Camera); movement is -1..1 relative to yaw.
+struct PlayerInput {
+  float forward{0.f};
+  float strafe{0.f};
+  float yaw{0.f};
+  float pitch{0.f};
+  bool jump{false};
+};
+
+// Window state changes seen by the last InputSystem::poll().
+struct WindowEvents {
+  bool quit{false};      // closed, or the application was asked to quit
+  bool resized{false};   // the drawable size changed: the swapchain must follow
+  bool minimized{false}; // current state: the drawable is 0x0 and cannot be drawn to
+};
+
+class InputSystem {
+public:
+  // Drains the SDL event queue (windowed mode only; SDL must be initialised).
+  const WindowEvents& poll();
+  const WindowEvents& window() const { return m_window; }
+  const PlayerInput& player() const { return m_player; }
+private:
+  WindowEvents m_window;
+  PlayerInput m_player;
+};
+
+// Per-step input streams saved to disk: replaying one through the same build
+// reproduces the simulation bit for bit.
+namespace InputLog {
+bool save(const std::string& path, std::span<const PlayerInput> steps);
+// False when the file is missing, truncated or not an input log.
+bool load(const std::string& path, std::vector<PlayerInput>& steps);
+}
@@ -0,0 +1,197 @@
+#include "jobs.hpp"
+#include "profiler.hpp"
+#include <string>
+
+namespace {
+thread_local const JobSystem* t_system = nullptr;
+thread_local int t_index = -1;
+}
+
+bool WorkStealingDeque::push(JobNode* j){
+  const int64_t b = m_bottom.load(std::memory_order_relaxed);
+  const int64_t t = m_top.load(std::memory_order_acquire);
+  if(b - t >= CAPACITY) return false;
+  m_items[static_cast<size_t>(b & (CAPACITY-1))].store(j, std::memory_order_relaxed);
+  // Publishes the item (and the job it points to) to steal()'s acquire of m_bottom.
+  m_bottom.store(b+1, std::memory_order_release);
+  return true;
+}
+
+JobNode* WorkStealingDeque::pop(){
+  const int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+  m_bottom.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t t = m_top.load(std::memory_order_relaxed);
+  if(t > b){ m_bottom.store(b+1, std::memory_order_relaxed); return nullptr; }
+  JobNode* j = m_items[static_cast<size_t>(b & (CAPACITY-1))].load(std::memory_order_relaxed);
+  if(t == b){
+    // Last item: race against thieves for it.
+    if(!m_top.compare_exchange_strong(t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed)) j = nullptr;
+    m_bottom.store(b+1, std::memory_order_relaxed);
+  }
+  return j;
+}
+
+JobNode* WorkStealingDeque::steal(){
+  int64_t t = m_top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  const int64_t b = m_bottom.load(std::memory_order_acquire);
+  if(t >= b) return nullptr;
+  JobNode* j = m_items[static_cast<size_t>(t & (CAPACITY-1))].load(std::memory_order_relaxed);
+  if(!m_top.compare_exchange_strong(t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+  return j;
+}
+
+JobSystem::JobSystem(unsigned threads){
+  if(threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+  for(unsigned i=0;i<threads;++i) m_queues.push_back(std::make_unique<WorkStealingDeque>());
+  t_system = this; t_index = 0;
+  for(unsigned i=1;i<threads;++i) m_threads.emplace_back([this, i]{ workerLoop(i); });
+}
+
+JobSystem::~JobSystem(){
+  {
+    std::lock_guard lk(m_sleepLock);
+    m_stop.store(true);
+  }
+  m_sleepCv.notify_all();
+  for(auto& t : m_threads) t.join();
+  // Jobs nobody waited for are dropped without running.
+  for(auto& q : m_queues) while(JobNode* j = q->pop()) delete j;
+  for(JobNode* j : m_inject) delete j;
+  for(JobNode* j : m_background) delete j;
+  if(t_system == this){ t_system = nullptr; t_index = -1; }
+}
+
+int JobSystem::currentWorker() const { return t_system == this ? t_index : -1; }
+
+void JobSystem::run(std::function<void()> fn, JobCounter* signal, JobCounter* after){
+  auto* j = new JobNode{std::move(fn), signal};
+  track(signal);
+  if(after){
+    std::lock_guard lk(after->m_lock);
+    if(after->m_pending.load(std::memory_order_acquire) > 0){ after->m_continuations.push_back(j); return; }
+  }
+  schedule(j);
+}
+
+void JobSystem::schedule(JobNode* j){
+  const int self = currentWorker();
+  if(self < 0 || !m_queues[static_cast<size_t>(self)]->push(j)){
+    std::lock_guard lk(m_injectLock);
+    m_inject.push_back(j);
+  }
+  m_queued.fetch_add(1);
+  if(m_sleepers.load() > 0){
+    { std::lock_guard lk(m_sleepLock); }
+    m_sleepCv.notify_one();
+  }
+}
+
+void JobSystem::runBackground(std::function<void()> fn, JobCounter* signal){
+  auto* j = new JobNode{std::move(fn), signal};
+  track(signal);
+  {
+    std::lock_guard lk(m_backgroundLock);
+    m_background.push_back(j);
+  }
+  m_queued.fetch_add(1);
+  if(m_sleepers.load() > 0){
+    { std::lock_guard lk(m_sleepLock); }
+    m_sleepCv.notify_one();
+  }
+}
+
+size_t JobSystem::helpBackground(std::chrono::steady_clock::time_point deadline){
+  size_t ran = 0;
+  while(std::chrono::steady_clock::now() < deadline){
+    JobNode* j = findBackgroundJob();
+    if(!j) break;
+    execute(j);
+    ++ran;
+  }
+  return ran;
+}
+
+void JobSystem::track(JobCounter* c){
+  // A round starts before its first job can be scheduled, so it is counted
+  // before the job that ends it can drain it.
+  if(c && c->m_pending.fetch_add(1, std::memory_order_acq_rel) == 0) c->m_rounds.fetch_add(1, std::memory_order_release);
+}
+
+void JobSystem::finish(JobCounter* c){
+  // Every job but the last touches the counter once, in the decrement. The
+  // last takes the continuations under the lock run() adds them under, then
+  // marks the round drained: after that the counter (often on the waiter's
+  // stack) may be gone.
+  if(!c || c->m_pending.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+  std::vector<JobNode*> ready;
+  {
+    std::lock_guard lk(c->m_lock);
+    ready.swap(c->m_continuations);
+  }
+  c->m_drained.fetch_add(1, std::memory_order_release);
+  for(JobNode* j : ready) schedule(j);
+}
+
+void JobSystem::execute(JobNode* j){
+  j->fn();
+  JobCounter* c = j->signal;
+  delete j;
+  finish(c);
+}
+
+JobNode* JobSystem::findJob(int self){
+  JobNode* j = nullptr;
+  if(self >= 0) j = m_queues[static_cast<size_t>(self)]->pop();
+  if(!j){
+    std::unique_lock lk(m_injectLock, std::try_to_lock);
+    if(lk.owns_lock() && !m_inject.empty()){ j = m_inject.front(); m_inject.pop_front(); }
+  }
+  const size_t n = m_queues.size();
+  const size_t start = self >= 0 ? static_cast<size_t>(self) + 1 : 0;
+  for(size_t k=0; !j && k<n; ++k){
+    const size_t victim = (start + k) % n;
+    if(static_cast<int>(victim) != self) j = m_queues[victim]->steal();
+  }
+  if(j) m_queued.fetch_sub(1);
+  return j;
+}
+
+JobNode* JobSystem::findBackgroundJob(){
+  std::lock_guard lk(m_backgroundLock);
+  if(m_background.empty()) return nullptr;
+  JobNode* j = m_background.front();
+  m_background.pop_front();
+  m_queued.fetch_sub(1);
+  return j;
+}
+
+void JobSystem::wait(JobCounter& c){
+  const int self = currentWorker();
+  // Drained first: the round it saw drained has been counted by the time it looks.
+  auto settled = [&]{
+    const uint32_t drained = c.m_drained.load(std::memory_order_acquire);
+    return c.done() && drained == c.m_rounds.load(std::memory_order_acquire);
+  };
+  while(!settled()){
+    if(JobNode* j = findJob(self)) execute(j);
+    else std::this_thread::yield();
+  }
+}
+
+void JobSystem::workerLoop(unsigned index){
+  t_system = this; t_index = static_cast<int>(index);
+  Profiler::setThreadName(("worker " + std::to_string(index)).c_str());
+  int idle = 0;
+  while(!m_stop.load(std::memory_order_relaxed)){
+    if(JobNode* j = findJob(t_index)){ execute(j); idle = 0; continue; }
+    if(JobNode* j = findBackgroundJob()){ execute(j); idle = 0; continue; }
+    if(++idle < 64){ std::this_thread::yield(); continue; }
+    std::unique_lock lk(m_sleepLock);
+    m_sleepers.fetch_add(1);
+    m_sleepCv.wait(lk, [this]{ return m_stop.load() || m_queued.load() > 0; });
+    m_sleepers.fetch_sub(1);
+    idle = 0;
+  }
+}
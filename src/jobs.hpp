@@ -0,0 +1,116 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+class JobCounter;
+
+struct JobNode {
+  std::function<void()> fn;
+  JobCounter* signal{nullptr};
+};
+
+// Completion counter: incremented per submitted job, decremented when each
+// finishes. Jobs submitted with a dependency run once that counter hits zero.
+// Only the job taking it to zero locks it, to release its continuations; the
+// rounds it has drained tell wait() when that job has let go of it.
+class JobCounter {
+public:
+  bool done() const { return m_pending.load(std::memory_order_acquire) == 0; }
+  uint32_t pending() const { return m_pending.load(std::memory_order_acquire); }
+private:
+  friend class JobSystem;
+  std::atomic<uint32_t> m_pending{0};
+  std::atomic<uint32_t> m_rounds{0};  // times m_pending left zero
+  std::atomic<uint32_t> m_drained{0}; // times the job taking it back to zero was done with it
+  std::mutex m_lock;
+  std::vector<JobNode*> m_continuations;
+};
+
+// Fixed-capacity Chase-Lev deque: the owner pushes/pops at the bottom,
+// other workers steal from the top without locks.
+class WorkStealingDeque {
+public:
+  static constexpr int64_t CAPACITY = 4096;
+  bool push(JobNode* j);
+  JobNode* pop();
+  JobNode* steal();
+private:
+  alignas(64) std::atomic<int64_t> m_top{0};
+  alignas(64) std::atomic<int64_t> m_bottom{0};
+  std::array<std::atomic<JobNode*>, CAPACITY> m_items{};
+};
+
+// Engine-wide job system. The constructing thread is worker 0 and executes
+// jobs while it wait()s; threads-1 background workers are spawned. Threads
+// that are not workers submit through a shared injection queue.
+class JobSystem {
+public:
+  explicit JobSystem(unsigned threads = 0); // 0 = std::thread::hardware_concurrency()
+  ~JobSystem();
+  JobSystem(const JobSystem&) = delete;
+  JobSystem& operator=(const JobSystem&) = delete;
+
+  unsigned threadCount() const { return static_cast<unsigned>(m_queues.size()); }
+  // Index of the calling thread within this system, or -1 for outside threads.
+  int currentWorker() const;
+
+  void run(std::function<void()> fn, JobCounter* signal = nullptr, JobCounter* after = nullptr);
+  // Blocks until the counter drains, executing queued jobs meanwhile. No job
+  // touches c once it returns, so a counter on the caller's stack may go.
+  void wait(JobCounter& c);
+
+  // Low-priority work (chunk generation, meshing): picked up by background
+  // workers only when they have nothing else to do and never run inside wait(),
+  // so a frame waiting on its own jobs cannot stall behind one.
+  void runBackground(std::function<void()> fn, JobCounter* signal = nullptr);
+  // Runs queued background jobs on the calling thread until none are left or the
+  // deadline passes; the only way they progress without background workers.
+  // Returns the number of jobs run.
+  size_t helpBackground(std::chrono::steady_clock::time_point deadline);
+
+  // Splits [begin, end) into ranges of at most `grain` and calls fn(b, e) on each.
+  template<class F>
+  void parallelFor(size_t begin, size_t end, size_t grain, F&& fn){
+    if(begin >= end) return;
+    grain = std::max<size_t>(grain, 1);
+    JobCounter c;
+    for(size_t b=begin; b<end; b+=grain){
+      const size_t e = std::min(end, b+grain);
+      run([&fn, b, e]{ fn(b, e); }, &c);
+    }
+    wait(c);
+  }
+
+private:
+  void workerLoop(unsigned index);
+  void schedule(JobNode* j);
+  void track(JobCounter* c);
+  void execute(JobNode* j);
+  JobNode* findJob(int self);
+  JobNode* findBackgroundJob();
+  void finish(JobCounter* c);
+
+  std::vector<std::unique_ptr<WorkStealingDeque>> m_queues;
+  std::vector<std::thread> m_threads;
+  std::mutex m_injectLock;
+  std::deque<JobNode*> m_inject;
+  std::mutex m_backgroundLock;
+  std::deque<JobNode*> m_background; // FIFO: submitters queue in priority order
+  std::mutex m_sleepLock;
+  std::condition_variable m_sleepCv;
+  std::atomic<int64_t> m_queued{0};
+  std::atomic<int> m_sleepers{0};
+  std::atomic<bool> m_stop{false};
+};
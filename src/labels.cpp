@@ -1 +1,150 @@
 #include "labels.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+Labels::Labels(const FontAtlas& atlas)
+  : m_glyphs(atlas.glyphs),
+    m_texelEm(1.f / atlas.params.pixelSize),
+    m_uScale(65535.f / static_cast<float>(std::max(atlas.width, 1u))),
+    m_vScale(65535.f / static_cast<float>(std::max(atlas.height, 1u))),
+    m_ascender(atlas.ascender),
+    m_lineHeight(atlas.lineHeight()) {}
+
+float Labels::layout(std::string_view text, std::vector<Quad>& out) const {
+  auto unorm = [](float v){ return static_cast<uint16_t>(v + 0.5f); };
+  float penX = 0.f, penY = 0.f, widest = 0.f;
+  for(const char ch : text){
+    if(ch == '\n'){
+      widest = std::max(widest, penX);
+      penX = 0.f;
+      penY += m_lineHeight;
+      continue;
+    }
+    const FontAtlas::Glyph& g = *glyph(static_cast<unsigned char>(ch));
+    if(g.w > 0){
+      const float x0 = penX + g.left, y0 = penY - g.top;
+      out.push_back({x0, y0, x0 + static_cast<float>(g.w)*m_texelEm, y0 + static_cast<float>(g.h)*m_texelEm,
+                     unorm(static_cast<float>(g.x)*m_uScale), unorm(static_cast<float>(g.y)*m_vScale),
+                     unorm(static_cast<float>(g.x + g.w)*m_uScale), unorm(static_cast<float>(g.y + g.h)*m_vScale)});
+    }
+    penX += g.advance;
+  }
+  return std::max(widest, penX);
+}
+
+Labels::Id Labels::add(const Vec3& position, std::string_view text, float pixelSize, uint32_t color){
+  const auto first = static_cast<uint32_t>(m_quads.size());
+  const float width = layout(text, m_quads);
+  Label l{position, first, static_cast<uint32_t>(m_quads.size()) - first, pixelSize, color, 0.f, 0.f, 0.f, 0.f, 0};
+  for(uint32_t i=first;i<first + l.quadCount;++i){
+    Quad& q = m_quads[i];
+    q.x0 -= width*0.5f;
+    q.x1 -= width*0.5f;
+    if(i == first){ l.minX = q.x0; l.minY = q.y0; l.maxX = q.x1; l.maxY = q.y1; }
+    l.minX = std::min(l.minX, q.x0); l.minY = std::min(l.minY, q.y0);
+    l.maxX = std::max(l.maxX, q.x1); l.maxY = std::max(l.maxY, q.y1);
+  }
+  if(m_freeIds.empty()){
+    l.id = static_cast<Id>(m_slots.size());
+    m_slots.push_back(FREE);
+  } else {
+    l.id = m_freeIds.back();
+    m_freeIds.pop_back();
+  }
+  m_slots[l.id] = static_cast<uint32_t>(m_labels.size());
+  m_labels.push_back(l);
+  m_liveGlyphs += l.quadCount;
+  return l.id;
+}
+
+void Labels::remove(Id id){
+  if(id >= m_slots.size() || m_slots[id] == FREE) return;
+  const uint32_t index = m_slots[id];
+  m_liveGlyphs -= m_labels[index].quadCount;
+  m_labels[index] = m_labels.back();
+  m_slots[m_labels[index].id] = index;
+  m_labels.pop_back();
+  m_slots[id] = FREE;
+  m_freeIds.push_back(id);
+  // Runs of removed labels are dropped once they outweigh the live ones.
+  if(m_quads.size() > 4096 && m_quads.size() > 2*m_liveGlyphs) compact();
+}
+
+void Labels::compact(){
+  m_scratch.clear();
+  m_scratch.reserve(m_liveGlyphs);
+  for(Label& l : m_labels){
+    const auto first = static_cast<uint32_t>(m_scratch.size());
+    m_scratch.insert(m_scratch.end(), m_quads.begin() + l.firstQuad, m_quads.begin() + l.firstQuad + l.quadCount);
+    l.firstQuad = first;
+  }
+  m_quads.swap(m_scratch);
+}
+
+void Labels::setPosition(Id id, const Vec3& position){
+  if(id < m_slots.size() && m_slots[id] != FREE) m_labels[m_slots[id]].position = position;
+}
+
+void Labels::clear(){
+  m_labels.clear();
+  m_slots.clear();
+  m_freeIds.clear();
+  m_quads.clear();
+  m_liveGlyphs = 0;
+}
+
+void Labels::text(float x, float y, std::string_view text, float pixelSize, uint32_t color){
+  m_scratch.clear();
+  layout(text, m_scratch);
+  y += m_ascender*pixelSize;
+  for(const Quad& q : m_scratch){
+    m_screen.push_back({x + q.x0*pixelSize, y + q.y0*pixelSize, x + q.x1*pixelSize, y + q.y1*pixelSize,
+                        q.u0, q.v0, q.u1, q.v1, color});
+  }
+}
+
+float Labels::measure(std::string_view text, float pixelSize) const {
+  float penX = 0.f, widest = 0.f;
+  for(const char ch : text){
+    if(ch == '\n'){ widest = std::max(widest, penX); penX = 0.f; }
+    else penX += glyph(static_cast<unsigned char>(ch))->advance;
+  }
+  return std::max(widest, penX) * pixelSize;
+}
+
+size_t Labels::build(const Mat4& viewProj, float width, float height, std::span<GlyphInstance> out){
+  BLOCCO_ZONE("build labels");
+  size_t n = std::min(m_screen.size(), out.size());
+  std::copy_n(m_screen.begin(), n, out.begin());
+  m_screen.clear();
+  if(n == out.size()) return n;
+  const float halfW = width*0.5f, halfH = height*0.5f;
+  const Quad* quads = m_quads.data();
+  for(const Label& l : m_labels){
+    const Vec4 clip = viewProj * Vec4{l.position.x, l.position.y, l.position.z, 1.f};
+    if(clip.z < 0.f || clip.z > clip.w) continue; // behind the near plane or past the far one
+    const float inv = 1.f / clip.w;
+    // Whole pixels keep the glyphs sharp.
+    const float x = std::floor((clip.x*inv + 1.f)*halfW + 0.5f), y = std::floor((clip.y*inv + 1.f)*halfH + 0.5f);
+    const float s = l.size;
+    if(x + l.maxX*s < 0.f || x + l.minX*s > width || y + l.maxY*s < 0.f || y + l.minY*s > height) continue;
+    if(out.size() - n < l.quadCount) continue;
+    GlyphInstance* dst = out.data() + n;
+#if defined(BLOCCO_MATH_SSE)
+    const __m128 origin = _mm_setr_ps(x, y, x, y), scale = _mm_set1_ps(s);
+    for(const Quad* q = quads + l.firstQuad, *end = q + l.quadCount; q != end; ++q, ++dst){
+      _mm_storeu_ps(&dst->x0, _mm_add_ps(origin, _mm_mul_ps(_mm_loadu_ps(&q->x0), scale)));
+      std::memcpy(&dst->u0, &q->u0, 4*sizeof(uint16_t));
+      dst->color = l.color;
+    }
+#else
+    for(const Quad* q = quads + l.firstQuad, *end = q + l.quadCount; q != end; ++q, ++dst){
+      *dst = {x + q->x0*s, y + q->y0*s, x + q->x1*s, y + q->y1*s, q->u0, q->v0, q->u1, q->v1, l.color};
+    }
+#endif
+    n += l.quadCount;
+  }
+  return n;
+}
@@ -1,2 +1,79 @@
 #pragma once
-struct Labels { int placeholder; };
+#include "font.hpp"
+#include "math.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// One glyph as the text pipeline reads it: an instance of a four-vertex
+// strip. Positions are framebuffer pixels with the origin at the top left,
+// texture coordinates unorm16 atlas units, colour RGBA8 (red in the low byte).
+struct GlyphInstance {
+  float x0, y0, x1, y1;
+  uint16_t u0, v0, u1, v1;
+  uint32_t color;
+};
+static_assert(sizeof(GlyphInstance) == 28);
+
+// World-space labels plus per-frame screen text, laid out against one font
+// atlas. A label's glyph run is laid out once when it is added; build() then
+// projects each anchor and writes the glyphs of the visible labels straight
+// into the frame's instance buffer, so a frame costs one projection per label
+// and a few multiply-adds per glyph. Labels keep a constant pixel size and
+// draw over the scene.
+class Labels {
+public:
+  using Id = uint32_t;
+  explicit Labels(const FontAtlas& atlas);
+  // The first line's baseline sits on the anchor, centred on it.
+  Id add(const Vec3& position, std::string_view text, float pixelSize = 16.f, uint32_t color = 0xffffffffu);
+  void remove(Id id);
+  void setPosition(Id id, const Vec3& position);
+  void clear();
+  size_t size() const { return m_labels.size(); }
+  // Text drawn by the next build() only, (x, y) being the top left of the
+  // first line in pixels; '\n' starts a new line.
+  void text(float x, float y, std::string_view text, float pixelSize, uint32_t color = 0xffffffffu);
+  // Width of the longest line in pixels.
+  float measure(std::string_view text, float pixelSize) const;
+  float lineHeight(float pixelSize) const { return m_lineHeight * pixelSize; }
+  // Upper bound on the instances the next build() writes.
+  size_t glyphCapacity() const { return m_liveGlyphs + m_screen.size(); }
+  // Writes the screen text, then the glyphs of labels in front of the camera
+  // and overlapping the viewport, and returns the instance count. Labels that
+  // do not fit in out are left out. Clears the screen text.
+  size_t build(const Mat4& viewProj, float width, float height, std::span<GlyphInstance> out);
+private:
+  // Em units, y down, relative to the anchor (labels) or the first baseline.
+  struct Quad {
+    float x0, y0, x1, y1;
+    uint16_t u0, v0, u1, v1;
+  };
+  struct Label {
+    Vec3 position;
+    uint32_t firstQuad, quadCount;
+    float size;
+    uint32_t color;
+    float minX, minY, maxX, maxY; // em bounds of the quads
+    Id id;
+  };
+  static constexpr uint32_t FREE = UINT32_MAX;
+  // Appends the run's quads with the pen starting at the origin; returns the widest line in em.
+  float layout(std::string_view text, std::vector<Quad>& out) const;
+  void compact();
+  std::array<FontAtlas::Glyph, FontAtlas::LAST - FontAtlas::FIRST + 1> m_glyphs;
+  const FontAtlas::Glyph* glyph(uint32_t c) const { return &m_glyphs[(c >= FontAtlas::FIRST && c <= FontAtlas::LAST ? c : uint32_t{'?'}) - FontAtlas::FIRST]; }
+  float m_texelEm;          // size of an atlas texel in em
+  float m_uScale, m_vScale; // atlas pixels to unorm16
+  float m_ascender, m_lineHeight;
+  std::vector<Label> m_labels;   // dense, in insertion order until removals swap
+  std::vector<uint32_t> m_slots; // id -> index in m_labels, or FREE
+  std::vector<Id> m_freeIds;
+  std::vector<Quad> m_quads;     // glyph runs of all labels; removed runs linger until compact()
+  size_t m_liveGlyphs{0};
+  std::vector<GlyphInstance> m_screen;
+  std::vector<Quad> m_scratch;
+};
@@ -0,0 +1,119 @@
+#include "lod.hpp"
+#include <algorithm>
+#include <cmath>
+
+LodSelection::LodSelection(const Vec3& eye, int radius, int verticalRadius, int levels)
+  : m_eye(eye),
+    m_eyeChunk(Scene::chunkOf(static_cast<int>(std::floor(eye.x)), static_cast<int>(std::floor(eye.y)), static_cast<int>(std::floor(eye.z)))),
+    m_radius(radius), m_verticalRadius(verticalRadius), m_levels(levels) {}
+
+float LodSelection::distance(const LodTile& t) const {
+  constexpr float N = Chunk::SIZE;
+  const ChunkCoord c = t.firstChunk();
+  const auto s = static_cast<float>(t.chunks());
+  const float ex = m_eye.x / N, ez = m_eye.z / N;
+  const float x0 = static_cast<float>(c.x), z0 = static_cast<float>(c.z);
+  const float dx = std::max({x0 - ex, 0.f, ex - (x0 + s)});
+  const float dz = std::max({z0 - ez, 0.f, ez - (z0 + s)});
+  return std::sqrt(dx*dx + dz*dz);
+}
+
+bool LodSelection::inView(const LodTile& t, float slack) const {
+  const int band = static_cast<int>(std::ceil(static_cast<float>(m_verticalRadius) * slack));
+  const int y0 = t.firstChunk().y, y1 = y0 + t.chunks() - 1;
+  return y1 >= m_eyeChunk.y - band && y0 <= m_eyeChunk.y + band && distance(t) < viewRadius() * slack;
+}
+
+bool LodSelection::selected(const LodTile& t, float slack) const {
+  if(t.level > m_levels || !inView(t, slack)) return false;
+  if(t.level > 0 && distance(t) * slack < threshold(t.level)) return false;
+  return t.level == m_levels || distance(t.parent()) < threshold(t.level + 1) * slack;
+}
+
+int LodSelection::level(const ChunkCoord& c) const {
+  for(int l=m_levels;l>=0;--l){
+    const LodTile t = LodTile::of(c, l);
+    if(!inView(t)) return -1;
+    if(!split(t)) return l;
+  }
+  return 0;
+}
+
+void LodSelection::select(std::vector<LodTile>& out) const {
+  forEachRoot([&](const LodTile& t){ if(inView(t)) selectBelow(t, out); });
+}
+
+void LodSelection::selectBelow(const LodTile& t, std::vector<LodTile>& out) const {
+  if(!split(t)){ out.push_back(t); return; }
+  for(int i=0;i<8;++i){
+    const LodTile c = t.child(i);
+    if(inView(c)) selectBelow(c, out);
+  }
+}
+
+void downsample(const std::array<const Chunk*, 8>& children, Chunk& out){
+  constexpr int N = Chunk::SIZE, G = 2*N;
+  // The eight chunks as one 64^3 grid (x fastest, then z, then y), so cells on
+  // a child's top face see the blocks above them.
+  thread_local std::vector<BlockId> grid(static_cast<size_t>(G*G*G)), src(Chunk::VOLUME), dst(Chunk::VOLUME);
+  auto at = [](int x, int y, int z){ return static_cast<size_t>((y*G + z)*G + x); };
+  for(int i=0;i<8;++i){
+    const int ox = (i & 1)*N, oy = (i >> 1 & 1)*N, oz = (i >> 2 & 1)*N;
+    const Chunk* c = children[static_cast<size_t>(i)];
+    if(c) c->decode(src.data());
+    else std::fill(src.begin(), src.end(), BLOCK_AIR);
+    for(int y=0;y<N;++y) for(int z=0;z<N;++z)
+      std::copy_n(&src[static_cast<size_t>(Chunk::index(0, y, z))], N, &grid[at(ox, oy + y, oz + z)]);
+  }
+  for(int y=0;y<N;++y) for(int z=0;z<N;++z) for(int x=0;x<N;++x){
+    // Candidates for the cell's block, most preferred last: its lower layer,
+    // its upper layer, its blocks with air above (or on the grid's top face),
+    // and the blocks of the cell above when that one rounds to air, which
+    // would otherwise vanish from the surface.
+    BlockId blocks[4][8];
+    int counts[4] = {0, 0, 0, 0}, solid = 0;
+    for(int dy=0;dy<4 && 2*y + dy < G;++dy) for(int dz=0;dz<2;++dz) for(int dx=0;dx<2;++dx){
+      const int bx = 2*x + dx, by = 2*y + dy, bz = 2*z + dz;
+      const BlockId b = grid[at(bx, by, bz)];
+      if(b == BLOCK_AIR) continue;
+      if(dy >= 2){ blocks[3][counts[3]++] = b; continue; }
+      ++solid;
+      blocks[dy][counts[dy]++] = b;
+      if(by + 1 == G || grid[at(bx, by + 1, bz)] == BLOCK_AIR) blocks[2][counts[2]++] = b;
+    }
+    BlockId cell = BLOCK_AIR;
+    if(solid >= 4){
+      const int l = counts[3] > 0 && counts[3] < 4 ? 3 : counts[2] > 0 ? 2 : counts[1] > 0 ? 1 : 0;
+      int best = 0;
+      for(int a=0;a<counts[l];++a){
+        int count = 0;
+        for(int b=0;b<counts[l];++b) count += blocks[l][b] == blocks[l][a];
+        if(count > best || (count == best && blocks[l][a] < cell)){ best = count; cell = blocks[l][a]; }
+      }
+    }
+    dst[static_cast<size_t>(Chunk::index(x, y, z))] = cell;
+  }
+  if(std::all_of(dst.begin(), dst.end(), [&](BlockId b){ return b == dst[0]; })){ out.fill(dst[0]); return; }
+  out.fill(BLOCK_AIR);
+  for(int row=0;row<N*N;++row){
+    const int start = row*N;
+    for(int x=0;x<N;){
+      const BlockId b = dst[static_cast<size_t>(start + x)];
+      int run = 1;
+      while(x + run < N && dst[static_cast<size_t>(start + x + run)] == b) ++run;
+      if(b != BLOCK_AIR) out.setRun(start + x, run, b);
+      x += run;
+    }
+  }
+}
+
+void buildLodTile(const std::function<void(const ChunkCoord&, Chunk&)>& generator, const LodTile& t, Chunk& out){
+  if(t.level == 0){ generator(t.coord, out); return; }
+  std::array<Chunk, 8> children;
+  std::array<const Chunk*, 8> halves{};
+  for(int i=0;i<8;++i){
+    buildLodTile(generator, t.child(i), children[static_cast<size_t>(i)]);
+    halves[static_cast<size_t>(i)] = &children[static_cast<size_t>(i)];
+  }
+  downsample(halves, out);
+}
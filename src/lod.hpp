@@ -0,0 +1,103 @@
+#pragma once
+#include "math.hpp"
+#include "scene.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// A cube of 2^level chunks per side; coord is in units of that cube (the chunk
+// coordinate shifted right by level). Its voxels are held as one 32^3 chunk
+// with a cell per 2^level blocks, so the chunk mesher meshes every level.
+// Level 0 is the chunk itself.
+struct LodTile {
+  ChunkCoord coord;
+  uint8_t level{0};
+  bool operator==(const LodTile&) const = default;
+
+  static LodTile of(const ChunkCoord& c, int level){ return {{c.x >> level, c.y >> level, c.z >> level}, static_cast<uint8_t>(level)}; }
+  int chunks() const { return 1 << level; } // per side
+  ChunkCoord firstChunk() const { return {coord.x << level, coord.y << level, coord.z << level}; }
+  LodTile parent() const { return of(firstChunk(), level + 1); }
+  // i = x | y << 1 | z << 2, the layout downsample() takes.
+  LodTile child(int i) const {
+    return {{coord.x*2 + (i & 1), coord.y*2 + (i >> 1 & 1), coord.z*2 + (i >> 2 & 1)}, static_cast<uint8_t>(level - 1)};
+  }
+  bool contains(const ChunkCoord& c) const { return of(c, level).coord == coord; }
+  // Places the tile's chunk-local mesh (0..32 cells per axis) in the world.
+  Mat4 transform() const {
+    const auto s = static_cast<float>(chunks());
+    const ChunkCoord c = firstChunk();
+    constexpr float N = Chunk::SIZE;
+    Mat4 m = translate({static_cast<float>(c.x)*N, static_cast<float>(c.y)*N, static_cast<float>(c.z)*N});
+    m.m[0] = m.m[5] = m.m[10] = s;
+    return m;
+  }
+};
+
+struct LodTileHash {
+  size_t operator()(const LodTile& t) const noexcept { return ChunkCoordHash{}(t.coord) ^ (size_t{t.level} * 0x9E3779B97F4A7C15ull); }
+};
+
+// The octree cut that picks a level for every chunk around the camera. A tile
+// of level L > 0 splits into its eight children while its horizontal distance
+// from the eye is under radius * 2^(L-1) chunks, so level 0 reaches about
+// radius chunks out and each coarser level doubles that, up to radius * 2^levels.
+// Vertically every level keeps the chunks within verticalRadius of the eye's.
+// Distances are to the tile's footprint, so a tile never splits while one of
+// its ancestors does not.
+//
+// slack > 1 widens a test towards keeping what is already there: selected()
+// with slack accepts tiles that are nearly part of the cut on either side.
+class LodSelection {
+public:
+  LodSelection() = default;
+  LodSelection(const Vec3& eye, int radius, int verticalRadius, int levels);
+
+  int levels() const { return m_levels; }
+  float viewRadius() const { return static_cast<float>(m_radius << m_levels); } // chunks
+  // Horizontal distance in chunks from the eye to the tile's footprint.
+  float distance(const LodTile& t) const;
+  bool inView(const LodTile& t, float slack = 1.f) const;
+  bool split(const LodTile& t, float slack = 1.f) const {
+    return t.level > 0 && distance(t) < threshold(t.level) * slack;
+  }
+  // Part of the cut: in view, not split, and its parent split (or a root).
+  bool selected(const LodTile& t, float slack = 1.f) const;
+  // The level drawn at chunk c, or -1 outside the view.
+  int level(const ChunkCoord& c) const;
+  // The whole cut, each tile once.
+  void select(std::vector<LodTile>& out) const;
+  // Top-level tiles covering the view, in or out of it.
+  template<class F> void forEachRoot(F&& fn) const {
+    const int reach = static_cast<int>(std::ceil(viewRadius())) + 1;
+    const LodTile lo = LodTile::of({m_eyeChunk.x - reach, m_eyeChunk.y - m_verticalRadius - 1, m_eyeChunk.z - reach}, m_levels);
+    const LodTile hi = LodTile::of({m_eyeChunk.x + reach, m_eyeChunk.y + m_verticalRadius + 1, m_eyeChunk.z + reach}, m_levels);
+    for(int y=lo.coord.y;y<=hi.coord.y;++y) for(int z=lo.coord.z;z<=hi.coord.z;++z) for(int x=lo.coord.x;x<=hi.coord.x;++x)
+      fn(LodTile{{x, y, z}, static_cast<uint8_t>(m_levels)});
+  }
+
+private:
+  float threshold(int level) const { return static_cast<float>(m_radius) * static_cast<float>(1 << level) * 0.5f; }
+  void selectBelow(const LodTile& t, std::vector<LodTile>& out) const;
+
+  Vec3 m_eye{};
+  ChunkCoord m_eyeChunk{};
+  int m_radius{0};
+  int m_verticalRadius{0};
+  int m_levels{0};
+};
+
+// Halves eight chunks (i = x | y << 1 | z << 2, null reads as air) into one.
+// A cell is solid when at least four of its eight blocks are, so one-block
+// floors and walls survive. It takes the most common of the blocks that would
+// show on its top: those of the cell above if that one rounds to air, else its
+// own with air above them, else its upper then lower layer's. That keeps grass
+// on top of terrain instead of the stone underneath.
+void downsample(const std::array<const Chunk*, 8>& children, Chunk& out);
+
+// Tile t of what generator produces: its 8^level chunks generated and halved
+// level times. Works for any generator, at that cost; height-field generators
+// can sample their columns directly instead (generateTerrainLod()).
+void buildLodTile(const std::function<void(const ChunkCoord&, Chunk&)>& generator, const LodTile& t, Chunk& out);
@@ -1,3 +1,448 @@
 #include "logging.hpp"
-#include <iostream>
-void Log::info(const std::string& m){ std::cout << m << "\n"; }
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Log {
+namespace {
+using detail::ArgType;
+
+// A queue slot: arguments that do not fit inline go to a heap block.
+struct alignas(64) Slot {
+  static constexpr size_t INLINE_BYTES = 208;
+  std::atomic<uint64_t> sequence{0};
+  const char* format{nullptr};
+  uint64_t timeNs{0};
+  uint32_t thread{0};
+  uint32_t bytes{0};
+  Level level{Level::Info};
+  std::unique_ptr<std::byte[]> heap;
+  std::byte inlineArgs[INLINE_BYTES];
+  std::span<const std::byte> args() const { return {heap ? heap.get() : inlineArgs, bytes}; }
+};
+static_assert(sizeof(Slot) == 256);
+
+constexpr uint64_t QUEUE_SLOTS = 8192; // 2 MB
+const char* const STOP = "";          // format of the record that ends the writer thread
+const char* const DROPPED = "log queue full, {} messages dropped";
+
+std::atomic<uint32_t> g_threads{0};
+thread_local uint32_t t_thread = 0;
+
+// Reads the arguments encoded by detail::encode(), tolerating damaged input
+// from binary logs.
+class ArgReader {
+public:
+  explicit ArgReader(std::span<const std::byte> args) : m_args(args) {}
+  bool next(ArgType& type, uint64_t& bits, std::string_view& text){
+    if(m_at >= m_args.size()) return false;
+    type = static_cast<ArgType>(m_args[m_at++]);
+    switch(type){
+      case ArgType::Int: case ArgType::Uint: case ArgType::Float:
+        return take(&bits, sizeof(bits));
+      case ArgType::Bool: case ArgType::Char:
+        bits = 0;
+        return take(&bits, 1);
+      case ArgType::String: {
+        uint32_t n = 0;
+        if(!take(&n, sizeof(n)) || n > m_args.size() - m_at) return false;
+        text = {reinterpret_cast<const char*>(m_args.data() + m_at), n};
+        m_at += n;
+        return true;
+      }
+    }
+    return false;
+  }
+private:
+  bool take(void* out, size_t n){
+    if(n > m_args.size() - m_at) return false;
+    std::memcpy(out, m_args.data() + m_at, n);
+    m_at += n;
+    return true;
+  }
+  std::span<const std::byte> m_args;
+  size_t m_at{0};
+};
+
+struct Spec {
+  bool zero{false};
+  int width{0};
+  int precision{-1};
+  char type{0};
+};
+
+void pad(std::string& out, std::string_view text, const Spec& spec, bool number){
+  const size_t width = static_cast<size_t>(spec.width);
+  if(text.size() >= width){ out += text; return; }
+  const size_t fill = width - text.size();
+  if(!number) { out += text; out.append(fill, ' '); return; }
+  if(!spec.zero){ out.append(fill, ' '); out += text; return; }
+  const bool sign = !text.empty() && (text[0] == '-' || text[0] == '+');
+  if(sign) out += text[0];
+  out.append(fill, '0');
+  out += text.substr(sign ? 1 : 0);
+}
+
+void formatArg(std::string& out, ArgType type, uint64_t bits, std::string_view text, const Spec& spec){
+  char buf[64];
+  std::to_chars_result r{buf, std::errc{}};
+  switch(type){
+    case ArgType::String: pad(out, text, spec, false); return;
+    case ArgType::Bool: pad(out, bits ? "true" : "false", spec, false); return;
+    case ArgType::Char: { const char c = static_cast<char>(bits); pad(out, {&c, 1}, spec, false); return; }
+    case ArgType::Int: case ArgType::Uint: {
+      const bool hex = spec.type == 'x' || spec.type == 'X';
+      if(type == ArgType::Int && !hex) r = std::to_chars(buf, buf + sizeof(buf), static_cast<int64_t>(bits));
+      else r = std::to_chars(buf, buf + sizeof(buf), bits, hex ? 16 : 10);
+      if(spec.type == 'X') std::transform(buf, r.ptr, buf, [](char c){ return c >= 'a' && c <= 'f' ? static_cast<char>(c - 'a' + 'A') : c; });
+      break;
+    }
+    case ArgType::Float: {
+      double d;
+      std::memcpy(&d, &bits, sizeof(d));
+      const auto fmt = spec.type == 'f' ? std::chars_format::fixed : spec.type == 'e' ? std::chars_format::scientific : std::chars_format::general;
+      if(spec.precision >= 0) r = std::to_chars(buf, buf + sizeof(buf), d, fmt, spec.precision);
+      else if(spec.type == 'f' || spec.type == 'e') r = std::to_chars(buf, buf + sizeof(buf), d, fmt, 6);
+      else r = std::to_chars(buf, buf + sizeof(buf), d);
+      break;
+    }
+  }
+  pad(out, r.ec == std::errc{} ? std::string_view(buf, static_cast<size_t>(r.ptr - buf)) : std::string_view("?"), spec, true);
+}
+
+// Formats on the writer thread (and in readBinary); the format string was
+// checked at compile time, but binary logs may not match their arguments.
+void formatTo(std::string& out, std::string_view format, std::span<const std::byte> args){
+  out.clear();
+  ArgReader reader(args);
+  for(size_t i = 0; i < format.size(); ++i){
+    const char c = format[i];
+    if((c == '{' || c == '}') && i + 1 < format.size() && format[i+1] == c){ out += c; ++i; continue; }
+    if(c != '{'){ out += c; continue; }
+    Spec spec;
+    size_t j = i + 1;
+    if(j < format.size() && format[j] == ':'){
+      ++j;
+      if(j < format.size() && format[j] == '0'){ spec.zero = true; ++j; }
+      for(; j < format.size() && format[j] >= '0' && format[j] <= '9'; ++j) spec.width = spec.width*10 + (format[j] - '0');
+      if(j < format.size() && format[j] == '.'){
+        spec.precision = 0;
+        for(++j; j < format.size() && format[j] >= '0' && format[j] <= '9'; ++j) spec.precision = spec.precision*10 + (format[j] - '0');
+      }
+      if(j < format.size() && format[j] != '}') spec.type = format[j++];
+    }
+    const size_t close = format.find('}', j);
+    if(close == std::string_view::npos){ out += format.substr(i); break; }
+    ArgType type{};
+    uint64_t bits = 0;
+    std::string_view text;
+    if(reader.next(type, bits, text)) formatArg(out, type, bits, text, spec);
+    else out += "{?}";
+    i = close;
+  }
+}
+
+class Logger {
+public:
+  Logger() : m_slots(new Slot[QUEUE_SLOTS]), m_start(std::chrono::steady_clock::now()) {
+    for(uint64_t i = 0; i < QUEUE_SLOTS; ++i) m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    m_sinks.push_back(std::make_unique<ConsoleSink>());
+    m_thread = std::thread([this]{ run(); });
+  }
+
+  detail::Reservation reserve(Level level, const char* format, size_t bytes){
+    uint64_t pos = m_enqueue.load(std::memory_order_relaxed);
+    Slot* slot;
+    for(;;){
+      slot = &m_slots[pos & (QUEUE_SLOTS - 1)];
+      const uint64_t seq = slot->sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<int64_t>(seq - pos);
+      if(diff == 0){
+        if(m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      } else if(diff < 0){
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return {};
+      } else {
+        pos = m_enqueue.load(std::memory_order_relaxed);
+      }
+    }
+    if(t_thread == 0) t_thread = g_threads.fetch_add(1, std::memory_order_relaxed) + 1;
+    slot->format = format;
+    slot->level = level;
+    slot->thread = t_thread;
+    slot->timeNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count());
+    slot->bytes = static_cast<uint32_t>(bytes);
+    if(bytes > Slot::INLINE_BYTES) slot->heap.reset(new std::byte[bytes]);
+    return {pos, slot->heap ? slot->heap.get() : slot->inlineArgs};
+  }
+
+  void publish(const detail::Reservation& r){
+    m_slots[r.position & (QUEUE_SLOTS - 1)].sequence.store(r.position + 1, std::memory_order_release);
+    m_enqueue.notify_one();
+    // Once the writer has stopped (at exit) callers write their own messages.
+    if(!m_running.load(std::memory_order_acquire)){
+      std::lock_guard lk(m_drainLock);
+      drain();
+    }
+  }
+
+  void flush(){
+    const uint64_t target = m_enqueue.load(std::memory_order_acquire);
+    if(!m_running.load(std::memory_order_acquire)){
+      std::lock_guard lk(m_drainLock);
+      drain();
+      return;
+    }
+    for(uint64_t w = m_written.load(std::memory_order_acquire); w < target && !m_stopped.load(); w = m_written.load(std::memory_order_acquire)){
+      m_written.wait(w, std::memory_order_acquire);
+    }
+  }
+
+  void addSink(std::unique_ptr<Sink> sink){
+    std::lock_guard lk(m_drainLock);
+    m_sinks.push_back(std::move(sink));
+  }
+
+  void clearSinks(){
+    flush();
+    std::lock_guard lk(m_drainLock);
+    m_sinks.clear();
+  }
+
+  Stats stats() const {
+    return {m_delivered.load(std::memory_order_relaxed), m_dropped.load(std::memory_order_relaxed)};
+  }
+
+  // At exit: lets the writer finish the queue, then leaves later messages to
+  // their callers.
+  void shutdown(){
+    if(!m_running.exchange(false)) return;
+    detail::Reservation r;
+    while(!(r = reserve(Level::Info, STOP, 0)).payload) std::this_thread::yield();
+    publish(r);
+    m_thread.join();
+    std::lock_guard lk(m_drainLock);
+    drain();
+  }
+
+private:
+  void run(){
+    for(;;){
+      size_t n;
+      uint64_t seen;
+      bool empty;
+      {
+        std::lock_guard lk(m_drainLock);
+        n = drain();
+        if(m_stopped.load(std::memory_order_relaxed)) break;
+        seen = m_enqueue.load(std::memory_order_acquire);
+        empty = seen == m_dequeue;
+      }
+      if(n) continue;
+      // Otherwise a producer has claimed a slot but not filled it yet: it is nearly done.
+      if(empty) m_enqueue.wait(seen, std::memory_order_acquire);
+      else std::this_thread::yield();
+    }
+    m_written.notify_all();
+  }
+
+  // Hands every published slot to the sinks. Caller holds m_drainLock.
+  size_t drain(){
+    size_t n = 0;
+    for(;;){
+      Slot& s = m_slots[m_dequeue & (QUEUE_SLOTS - 1)];
+      if(s.sequence.load(std::memory_order_acquire) != m_dequeue + 1) break;
+      if(s.format == STOP) m_stopped.store(true, std::memory_order_release);
+      else deliver(s.level, s.thread, s.timeNs, s.format, s.args());
+      s.heap.reset();
+      s.sequence.store(m_dequeue + QUEUE_SLOTS, std::memory_order_release);
+      ++m_dequeue;
+      ++n;
+    }
+    const uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+    if(dropped != m_reportedDropped){
+      std::byte args[1 + sizeof(uint64_t)];
+      detail::encode(args, dropped - m_reportedDropped);
+      m_reportedDropped = dropped;
+      deliver(Level::Warn, 0, 0, DROPPED, args);
+      ++n;
+    }
+    if(n) for(auto& sink : m_sinks) sink->flush();
+    m_written.store(m_dequeue, std::memory_order_release);
+    m_written.notify_all();
+    return n;
+  }
+
+  void deliver(Level level, uint32_t thread, uint64_t timeNs, const char* format, std::span<const std::byte> args){
+    formatTo(m_text, format, args);
+    const Entry e{level, thread, timeNs, format, args, m_text};
+    for(auto& sink : m_sinks) sink->write(e);
+    m_delivered.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  std::unique_ptr<Slot[]> m_slots;
+  alignas(64) std::atomic<uint64_t> m_enqueue{0};
+  alignas(64) uint64_t m_dequeue{0}; // under m_drainLock
+  std::atomic<uint64_t> m_written{0};
+  std::atomic<uint64_t> m_dropped{0};
+  std::atomic<uint64_t> m_delivered{0};
+  uint64_t m_reportedDropped{0};
+  std::mutex m_drainLock; // whoever drains: the writer thread, or callers once it has stopped
+  std::vector<std::unique_ptr<Sink>> m_sinks;
+  std::string m_text;
+  std::atomic<bool> m_running{true};
+  std::atomic<bool> m_stopped{false};
+  std::chrono::steady_clock::time_point m_start;
+  std::thread m_thread;
+};
+
+// Never destroyed, so static destructors may still log; the writer is stopped
+// and the queue written out at exit.
+Logger& logger(){
+  static Logger* l = []{
+    auto* created = new Logger;
+    std::atexit([]{ logger().shutdown(); });
+    return created;
+  }();
+  return *l;
+}
+
+template<class T>
+void putValue(std::FILE* f, const T& v){ std::fwrite(&v, sizeof(v), 1, f); }
+
+template<class T>
+bool getValue(std::FILE* f, T& v){ return std::fread(&v, sizeof(v), 1, f) == 1; }
+
+constexpr char BINARY_MAGIC[4] = {'B', 'L', 'G', '1'};
+constexpr uint8_t RECORD_FORMAT = 'F';
+constexpr uint8_t RECORD_MESSAGE = 'M';
+}
+
+const char* levelName(Level level){
+  switch(level){
+    case Level::Trace: return "trace";
+    case Level::Debug: return "debug";
+    case Level::Info: return "info";
+    case Level::Warn: return "warn";
+    case Level::Error: return "error";
+  }
+  return "?";
+}
+
+void ConsoleSink::write(const Entry& entry){
+  std::FILE* out = entry.level >= Level::Warn ? stderr : stdout;
+  std::fwrite(entry.text.data(), 1, entry.text.size(), out);
+  std::fputc('\n', out);
+}
+
+void ConsoleSink::flush(){
+  std::fflush(stdout);
+  std::fflush(stderr);
+}
+
+struct BinaryFileSink::State {
+  std::FILE* file{nullptr};
+  std::unordered_map<const char*, uint32_t> formats;
+};
+
+BinaryFileSink::BinaryFileSink(const std::string& path) : m_state(std::make_unique<State>()) {
+  m_state->file = std::fopen(path.c_str(), "wb");
+  if(!m_state->file) throw std::runtime_error("Failed to create log file " + path);
+  std::fwrite(BINARY_MAGIC, 1, sizeof(BINARY_MAGIC), m_state->file);
+}
+
+BinaryFileSink::~BinaryFileSink(){
+  if(m_state->file) std::fclose(m_state->file);
+}
+
+void BinaryFileSink::write(const Entry& entry){
+  std::FILE* f = m_state->file;
+  auto [it, added] = m_state->formats.try_emplace(entry.format, static_cast<uint32_t>(m_state->formats.size()));
+  if(added){
+    const auto n = static_cast<uint32_t>(std::strlen(entry.format));
+    putValue(f, RECORD_FORMAT);
+    putValue(f, it->second);
+    putValue(f, n);
+    std::fwrite(entry.format, 1, n, f);
+  }
+  putValue(f, RECORD_MESSAGE);
+  putValue(f, it->second);
+  putValue(f, static_cast<uint8_t>(entry.level));
+  putValue(f, entry.thread);
+  putValue(f, entry.timeNs);
+  putValue(f, static_cast<uint32_t>(entry.args.size()));
+  std::fwrite(entry.args.data(), 1, entry.args.size(), f);
+}
+
+void BinaryFileSink::flush(){
+  std::fflush(m_state->file);
+}
+
+bool readBinary(const std::string& path, const std::function<void(const Message&)>& fn){
+  std::unique_ptr<std::FILE, int(*)(std::FILE*)> file(std::fopen(path.c_str(), "rb"), &std::fclose);
+  if(!file) return false;
+  std::FILE* f = file.get();
+  char magic[4];
+  if(std::fread(magic, 1, sizeof(magic), f) != sizeof(magic) || std::memcmp(magic, BINARY_MAGIC, sizeof(magic)) != 0) return false;
+  std::vector<std::string> formats;
+  std::vector<std::byte> args;
+  Message m;
+  for(uint8_t kind; getValue(f, kind);){
+    uint32_t id = 0, n = 0;
+    if(kind == RECORD_FORMAT){
+      if(!getValue(f, id) || !getValue(f, n) || id != formats.size()) return false;
+      std::string text(n, '\0');
+      if(std::fread(text.data(), 1, n, f) != n) return false;
+      formats.push_back(std::move(text));
+    } else if(kind == RECORD_MESSAGE){
+      uint8_t level = 0;
+      if(!getValue(f, id) || !getValue(f, level) || !getValue(f, m.thread) || !getValue(f, m.timeNs) || !getValue(f, n)) return false;
+      if(id >= formats.size() || level > static_cast<uint8_t>(Level::Error)) return false;
+      args.resize(n);
+      if(std::fread(args.data(), 1, n, f) != n) return false;
+      m.level = static_cast<Level>(level);
+      formatTo(m.text, formats[id], args);
+      fn(m);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+void addSink(std::unique_ptr<Sink> sink){ logger().addSink(std::move(sink)); }
+void clearSinks(){ logger().clearSinks(); }
+void flush(){ logger().flush(); }
+Stats stats(){ return logger().stats(); }
+
+RateLimiter::RateLimiter(uint32_t burst, std::chrono::milliseconds window) : m_burst(burst), m_window(window) {}
+
+std::optional<uint64_t> RateLimiter::admit(uint64_t key, std::chrono::steady_clock::time_point now){
+  const int64_t window = now.time_since_epoch() / m_window;
+  Slot& s = m_slots[(key * 0x9E3779B97F4A7C15ull) >> 56];
+  if(s.key.load(std::memory_order_relaxed) != key){
+    // Another key had the slot; it starts over for this one.
+    s.key.store(key, std::memory_order_relaxed);
+    s.window.store(window, std::memory_order_relaxed);
+    s.count.store(0, std::memory_order_relaxed);
+    s.dropped.store(0, std::memory_order_relaxed);
+  } else if(s.window.load(std::memory_order_relaxed) != window){
+    s.window.store(window, std::memory_order_relaxed);
+    s.count.store(0, std::memory_order_relaxed);
+  }
+  if(s.count.fetch_add(1, std::memory_order_relaxed) < m_burst) return s.dropped.exchange(0, std::memory_order_relaxed);
+  s.dropped.fetch_add(1, std::memory_order_relaxed);
+  m_suppressed.fetch_add(1, std::memory_order_relaxed);
+  return std::nullopt;
+}
+
+namespace detail {
+Reservation reserve(Level level, const char* format, size_t bytes){ return logger().reserve(level, format, bytes); }
+void publish(const Reservation& r){ logger().publish(r); }
+}
+}
@@ -1,3 +1,263 @@
 #pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
 #include <string>
-namespace Log { void info(const std::string&); }
+#include <string_view>
+#include <type_traits>
+
+// Asynchronous logging: Log::info("frame {} took {:.3f} ms", frame, ms) checks
+// the format string against its arguments at compile time, copies the
+// arguments into a slot of a lock-free multi-producer queue and returns; a
+// background writer thread formats the message and hands it to the sinks.
+// Placeholders are {} or {:spec} with spec = [0][width][.precision][type] and
+// type one of d x X f e g s; {{ and }} are literal braces. Arguments may be
+// integers, floating point, bool, char and strings (copied, so temporaries are
+// fine). Format strings must be string literals: only the pointer is queued.
+//
+// Levels below BLOCCO_LOG_LEVEL (set from cmake/Options.cmake) compile to
+// nothing. A full queue drops messages rather than blocking the caller; the
+// writer reports how many were lost.
+#ifndef BLOCCO_LOG_LEVEL
+#define BLOCCO_LOG_LEVEL 2
+#endif
+
+namespace Log {
+enum class Level : uint8_t { Trace, Debug, Info, Warn, Error };
+inline constexpr Level MIN_LEVEL = static_cast<Level>(BLOCCO_LOG_LEVEL);
+const char* levelName(Level level);
+
+// One message as the sinks see it, valid for the duration of Sink::write().
+struct Entry {
+  Level level;
+  uint32_t thread;  // small sequential id, in order of each thread's first message
+  uint64_t timeNs;  // since the logger started
+  const char* format;
+  std::span<const std::byte> args; // arguments in the queue's encoding
+  std::string_view text;           // the formatted message
+};
+
+// Sinks run on the writer thread only, one entry at a time.
+class Sink {
+public:
+  virtual ~Sink() = default;
+  virtual void write(const Entry& entry) = 0;
+  // Called after each batch of entries.
+  virtual void flush(){}
+};
+
+// stdout for trace to info, stderr for warnings and errors.
+class ConsoleSink final : public Sink {
+public:
+  void write(const Entry& entry) override;
+  void flush() override;
+};
+
+// Structured binary log: each distinct format string is written once, then
+// messages as (format id, level, thread, time, encoded arguments). Nothing is
+// formatted on the way in; readBinary() formats on the way out.
+class BinaryFileSink final : public Sink {
+public:
+  // Throws std::runtime_error when the file cannot be created.
+  explicit BinaryFileSink(const std::string& path);
+  ~BinaryFileSink() override;
+  BinaryFileSink(const BinaryFileSink&) = delete;
+  BinaryFileSink& operator=(const BinaryFileSink&) = delete;
+  void write(const Entry& entry) override;
+  void flush() override;
+private:
+  struct State;
+  std::unique_ptr<State> m_state;
+};
+
+struct Message {
+  Level level{Level::Info};
+  uint32_t thread{0};
+  uint64_t timeNs{0};
+  std::string text;
+};
+// Replays a BinaryFileSink file. Returns false if it is not one or is cut short
+// (messages before the damage are still delivered).
+bool readBinary(const std::string& path, const std::function<void(const Message&)>& fn);
+
+// The console sink is installed by default; sinks added later receive only
+// messages written after them.
+void addSink(std::unique_ptr<Sink> sink);
+void clearSinks();
+// Blocks until every message logged before the call has reached the sinks.
+void flush();
+
+struct Stats {
+  uint64_t written{0}; // messages handed to the sinks
+  uint64_t dropped{0}; // lost to a full queue
+};
+Stats stats();
+
+// Lets the first `burst` messages with the same key through per window and
+// counts the rest, for sources such as validation layers that repeat one
+// message every frame. Lock-free and approximate: keys share 256 slots by hash.
+class RateLimiter {
+public:
+  explicit RateLimiter(uint32_t burst = 3, std::chrono::milliseconds window = std::chrono::seconds(1));
+  // nullopt when the message should be dropped; otherwise how many messages
+  // with this key were dropped since the last one let through.
+  std::optional<uint64_t> admit(uint64_t key, std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+  uint64_t suppressed() const { return m_suppressed.load(std::memory_order_relaxed); }
+private:
+  struct Slot {
+    std::atomic<uint64_t> key{0};
+    std::atomic<int64_t> window{-1};
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint64_t> dropped{0};
+  };
+  uint32_t m_burst;
+  std::chrono::steady_clock::duration m_window;
+  std::array<Slot, 256> m_slots;
+  std::atomic<uint64_t> m_suppressed{0};
+};
+
+namespace detail {
+enum class ArgType : uint8_t { Int, Uint, Float, Bool, Char, String };
+
+// Placeholders in a format string, or -1 if it is malformed.
+consteval int placeholders(const char* s){
+  int n = 0;
+  for(; *s; ++s){
+    if(*s == '}'){
+      if(s[1] != '}') return -1;
+      ++s;
+      continue;
+    }
+    if(*s != '{') continue;
+    if(s[1] == '{'){ ++s; continue; }
+    ++s;
+    if(*s == ':'){
+      ++s;
+      while(*s >= '0' && *s <= '9') ++s;
+      if(*s == '.'){
+        ++s;
+        if(!(*s >= '0' && *s <= '9')) return -1;
+        while(*s >= '0' && *s <= '9') ++s;
+      }
+      if(*s && std::string_view("dxXfegs").find(*s) != std::string_view::npos) ++s;
+    }
+    if(*s != '}') return -1;
+    ++n;
+  }
+  return n;
+}
+
+template<class T>
+inline constexpr bool IS_STRING = std::is_convertible_v<const T&, std::string_view>;
+
+template<class T>
+std::string_view view(const T& v){
+  if constexpr(std::is_pointer_v<T>){ return v ? std::string_view(v) : std::string_view("(null)"); }
+  else return std::string_view(v);
+}
+
+template<class T>
+size_t argSize(const T& v){
+  using U = std::remove_cvref_t<T>;
+  if constexpr(IS_STRING<U>) return 1 + sizeof(uint32_t) + view(v).size();
+  else if constexpr(std::is_same_v<U, bool> || std::is_same_v<U, char>) return 2;
+  else {
+    static_assert(std::is_arithmetic_v<U>, "Log arguments must be numbers, bool, char or strings");
+    return 1 + sizeof(uint64_t);
+  }
+}
+
+inline std::byte* put(std::byte* out, const void* data, size_t n){
+  std::memcpy(out, data, n);
+  return out + n;
+}
+
+template<class T>
+std::byte* encode(std::byte* out, const T& v){
+  using U = std::remove_cvref_t<T>;
+  auto tag = [&](ArgType t){ *out = static_cast<std::byte>(t); return out + 1; };
+  if constexpr(IS_STRING<U>){
+    const std::string_view s = view(v);
+    const auto n = static_cast<uint32_t>(s.size());
+    out = put(tag(ArgType::String), &n, sizeof(n));
+    return put(out, s.data(), s.size());
+  } else if constexpr(std::is_same_v<U, bool>){
+    out = tag(ArgType::Bool);
+    *out = static_cast<std::byte>(v ? 1 : 0);
+    return out + 1;
+  } else if constexpr(std::is_same_v<U, char>){
+    out = tag(ArgType::Char);
+    *out = static_cast<std::byte>(v);
+    return out + 1;
+  } else if constexpr(std::is_floating_point_v<U>){
+    const auto d = static_cast<double>(v);
+    return put(tag(ArgType::Float), &d, sizeof(d));
+  } else if constexpr(std::is_signed_v<U>){
+    const auto i = static_cast<int64_t>(v);
+    return put(tag(ArgType::Int), &i, sizeof(i));
+  } else {
+    const auto u = static_cast<uint64_t>(v);
+    return put(tag(ArgType::Uint), &u, sizeof(u));
+  }
+}
+
+// A claimed queue slot; payload is null when the queue was full.
+struct Reservation {
+  uint64_t position{0};
+  std::byte* payload{nullptr};
+};
+Reservation reserve(Level level, const char* format, size_t bytes);
+void publish(const Reservation& r);
+
+template<class... Args>
+void write(Level level, const char* format, const Args&... args){
+  const size_t bytes = (size_t{0} + ... + argSize(args));
+  const Reservation r = reserve(level, format, bytes);
+  if(!r.payload) return;
+  [[maybe_unused]] std::byte* out = r.payload;
+  ((out = encode(out, args)), ...);
+  publish(r);
+}
+}
+
+// Format string checked against the argument count at compile time.
+template<class... Args>
+struct Format {
+  consteval Format(const char* s) : text(s) {
+    if(detail::placeholders(s) != static_cast<int>(sizeof...(Args))) throw "log format string does not match its arguments";
+  }
+  const char* text;
+};
+
+template<class... Args>
+void log(Level level, Format<std::type_identity_t<Args>...> format, const Args&... args){
+  if(level >= MIN_LEVEL) detail::write(level, format.text, args...);
+}
+template<class... Args>
+void trace(Format<std::type_identity_t<Args>...> format, const Args&... args){
+  if constexpr(Level::Trace >= MIN_LEVEL) detail::write(Level::Trace, format.text, args...);
+}
+template<class... Args>
+void debug(Format<std::type_identity_t<Args>...> format, const Args&... args){
+  if constexpr(Level::Debug >= MIN_LEVEL) detail::write(Level::Debug, format.text, args...);
+}
+template<class... Args>
+void info(Format<std::type_identity_t<Args>...> format, const Args&... args){
+  if constexpr(Level::Info >= MIN_LEVEL) detail::write(Level::Info, format.text, args...);
+}
+template<class... Args>
+void warn(Format<std::type_identity_t<Args>...> format, const Args&... args){
+  if constexpr(Level::Warn >= MIN_LEVEL) detail::write(Level::Warn, format.text, args...);
+}
+template<class... Args>
+void error(Format<std::type_identity_t<Args>...> format, const Args&... args){
+  if constexpr(Level::Error >= MIN_LEVEL) detail::write(Level::Error, format.text, args...);
+}
+}
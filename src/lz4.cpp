@@ -0,0 +1,113 @@
+#include "lz4.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t LAST_LITERALS = 5; // the block ends with at least this many literals
+constexpr size_t MF_LIMIT = 12;     // no match starts closer than this to the end
+constexpr size_t MAX_OFFSET = 65535;
+constexpr unsigned HASH_BITS = 12;
+
+uint32_t read32(const uint8_t* p){ uint32_t v; std::memcpy(&v, p, 4); return v; }
+uint32_t hash(uint32_t v){ return (v * 2654435761u) >> (32 - HASH_BITS); }
+
+// Writes a length beyond the token's 15 as 255-byte steps.
+uint8_t* putLength(uint8_t* op, size_t len){
+  for(; len >= 255; len -= 255) *op++ = 255;
+  *op++ = static_cast<uint8_t>(len);
+  return op;
+}
+}
+
+namespace Lz4 {
+size_t compress(std::span<const uint8_t> src, std::span<uint8_t> dst){
+  const uint8_t* const base = src.data();
+  const size_t n = src.size();
+  uint8_t* op = dst.data();
+  uint8_t* const oend = op + dst.size();
+  size_t anchor = 0;
+  auto emit = [&](size_t literals, size_t matchLen, size_t offset) -> bool {
+    const size_t worst = 1 + literals/255 + 1 + literals + (matchLen ? 2 + (matchLen - MIN_MATCH)/255 + 1 : 0);
+    if(static_cast<size_t>(oend - op) < worst) return false;
+    uint8_t* token = op++;
+    *token = static_cast<uint8_t>((literals < 15 ? literals : 15) << 4);
+    if(literals >= 15) op = putLength(op, literals - 15);
+    if(literals) std::memcpy(op, base + anchor, literals);
+    op += literals;
+    if(!matchLen) return true;
+    *op++ = static_cast<uint8_t>(offset);
+    *op++ = static_cast<uint8_t>(offset >> 8);
+    const size_t m = matchLen - MIN_MATCH;
+    *token = static_cast<uint8_t>(*token | (m < 15 ? m : 15));
+    if(m >= 15) op = putLength(op, m - 15);
+    return true;
+  };
+  if(n > MF_LIMIT){
+    uint32_t table[1u << HASH_BITS] = {};
+    const size_t matchEnd = n - LAST_LITERALS;
+    const size_t lastStart = n - MF_LIMIT;
+    size_t ip = 1;
+    while(ip <= lastStart){
+      const uint32_t seq = read32(base + ip);
+      const uint32_t h = hash(seq);
+      size_t ref = table[h];
+      table[h] = static_cast<uint32_t>(ip);
+      if(ref >= ip || ip - ref > MAX_OFFSET || read32(base + ref) != seq){
+        ip += 1 + ((ip - anchor) >> 6); // skip faster through incompressible stretches
+        continue;
+      }
+      while(ip > anchor && ref > 0 && base[ip-1] == base[ref-1]){ --ip; --ref; }
+      size_t len = MIN_MATCH;
+      while(ip + len < matchEnd && base[ref + len] == base[ip + len]) ++len;
+      if(!emit(ip - anchor, len, ip - ref)) return 0;
+      ip += len;
+      anchor = ip;
+      if(ip <= lastStart) table[hash(read32(base + ip - 2))] = static_cast<uint32_t>(ip - 2);
+    }
+  }
+  if(!emit(n - anchor, 0, 0)) return 0;
+  return static_cast<size_t>(op - dst.data());
+}
+
+bool decompress(std::span<const uint8_t> src, std::span<uint8_t> dst){
+  const uint8_t* ip = src.data();
+  const uint8_t* const iend = ip + src.size();
+  uint8_t* op = dst.data();
+  uint8_t* const oend = op + dst.size();
+  auto readLength = [&](size_t& len) -> bool {
+    uint8_t b;
+    do {
+      if(ip == iend) return false;
+      b = *ip++;
+      len += b;
+    } while(b == 255);
+    return true;
+  };
+  while(ip < iend){
+    const uint8_t token = *ip++;
+    size_t literals = token >> 4;
+    if(literals == 15 && !readLength(literals)) return false;
+    if(static_cast<size_t>(iend - ip) < literals || static_cast<size_t>(oend - op) < literals) return false;
+    if(literals) std::memcpy(op, ip, literals);
+    ip += literals; op += literals;
+    if(ip == iend) break; // the last sequence has no match
+    if(iend - ip < 2) return false;
+    const size_t offset = static_cast<size_t>(ip[0]) | (static_cast<size_t>(ip[1]) << 8);
+    ip += 2;
+    if(offset == 0 || offset > static_cast<size_t>(op - dst.data())) return false;
+    size_t len = token & 15u;
+    if(len == 15 && !readLength(len)) return false;
+    len += MIN_MATCH;
+    if(static_cast<size_t>(oend - op) < len) return false;
+    // Overlapping matches repeat the last `offset` bytes; the copied span doubles
+    // each step (still a multiple of the period), so long runs take few memcpys.
+    for(size_t dist = offset; len > 0; dist *= 2){
+      const size_t n = std::min(dist, len);
+      std::memcpy(op, op - dist, n);
+      op += n; len -= n;
+    }
+  }
+  return op == oend;
+}
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// LZ4 block format (no frame): greedy single-probe matcher, compatible with
+// the reference decoder. Fast on palette-packed chunk data, whose repeated
+// index words compress well.
+namespace Lz4 {
+constexpr size_t compressBound(size_t n){ return n + n/255 + 16; }
+// Returns the compressed size, or 0 when dst is too small.
+size_t compress(std::span<const uint8_t> src, std::span<uint8_t> dst);
+// dst must be exactly the uncompressed size; false on malformed input.
+bool decompress(std::span<const uint8_t> src, std::span<uint8_t> dst);
+}
@@ -1,11 +1,34 @@
 #include "engine.hpp"
+#include "config.hpp"
+#include "logging.hpp"
+#include <cstdlib>
 #include <iostream>
+#include <string>
+// Usage: blocco [--frames-in-flight N] [--present-mode fifo|mailbox|immediate] [--no-present-wait] [--threads N]
+//               [--font <file.ttf> [--no-hud]]
 int main(int argc, char** argv){
   try {
-    Engine engine;
+    Config config;
+    for(int i=1;i<argc;++i){
+      const std::string arg = argv[i];
+      if(arg == "--frames-in-flight" && i+1 < argc){ config.framesInFlight = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)); }
+      else if(arg == "--present-mode" && i+1 < argc){
+        const std::string mode = argv[++i];
+        if(mode == "fifo") config.presentMode = PresentMode::Fifo;
+        else if(mode == "mailbox") config.presentMode = PresentMode::Mailbox;
+        else if(mode == "immediate") config.presentMode = PresentMode::Immediate;
+        else { std::cerr << "Unknown present mode: " << mode << "\n"; return 1; }
+      }
+      else if(arg == "--no-present-wait"){ config.presentWait = false; }
+      else if(arg == "--threads" && i+1 < argc){ config.workerThreads = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)); }
+      else if(arg == "--font" && i+1 < argc){ config.fontPath = argv[++i]; }
+      else if(arg == "--no-hud"){ config.hud = false; }
+      else { std::cerr << "Unknown argument: " << arg << "\n"; return 1; }
+    }
+    Engine engine(false, config);
     engine.run();
   } catch(const std::exception& e){
-    std::cerr << "Fatal: " << e.what() << "\n";
+    Log::error("Fatal: {}", e.what());
     return 1;
   }
   return 0;
@@ -1,8 +1,126 @@
 #include "math.hpp"
-Vec3 operator+(const Vec3&a,const Vec3&b){return {a.x+b.x,a.y+b.y,a.z+b.z};}
-Vec3 operator-(const Vec3&a,const Vec3&b){return {a.x-b.x,a.y-b.y,a.z-b.z};}
-Vec3 operator*(const Vec3&a,float s){return {a.x*s,a.y*s,a.z*s};}
-float dot(const Vec3&a,const Vec3&b){return a.x*b.x+a.y*b.y+a.z*b.z;}
-Vec3 cross(const Vec3&a,const Vec3&b){return {a.y*b.z-a.z*b.y,a.z*b.x-a.x*b.z,a.x*b.y-a.y*b.x};}
-float length(const Vec3&a){return std::sqrt(dot(a,a));}
-Vec3 normalize(const Vec3&a){float l=length(a);return l>0? a*(1.f/l):a;}
+
+Frustum extractFrustum(const Mat4&vp){
+  // Gribb-Hartmann on the rows of viewProj; near is row 2 alone for [0,1] depth.
+  const auto row = [&](int r){ return Vec4{vp.m[r], vp.m[4+r], vp.m[8+r], vp.m[12+r]}; };
+  const Vec4 r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+  const auto add = [](const Vec4&a,const Vec4&b){ return Vec4{a.x+b.x,a.y+b.y,a.z+b.z,a.w+b.w}; };
+  const auto sub = [](const Vec4&a,const Vec4&b){ return Vec4{a.x-b.x,a.y-b.y,a.z-b.z,a.w-b.w}; };
+  Frustum f{{add(r3,r0), sub(r3,r0), add(r3,r1), sub(r3,r1), r2, sub(r3,r2)}};
+  for(Vec4& p : f.planes){
+    const float len = length(Vec3{p.x,p.y,p.z});
+    if(len > 0.f){ const float inv = 1.f/len; p = {p.x*inv, p.y*inv, p.z*inv, p.w*inv}; }
+  }
+  return f;
+}
+
+namespace math_scalar {
+void transformPoints(const Mat4&m,const float*x,const float*y,const float*z,float*ox,float*oy,float*oz,size_t n){
+  for(size_t i=0;i<n;++i){
+    const float px = x[i], py = y[i], pz = z[i];
+    ox[i] = m.m[0]*px + m.m[4]*py + m.m[8]*pz + m.m[12];
+    oy[i] = m.m[1]*px + m.m[5]*py + m.m[9]*pz + m.m[13];
+    oz[i] = m.m[2]*px + m.m[6]*py + m.m[10]*pz + m.m[14];
+  }
+}
+
+size_t cullAabbs(const Frustum&f,const float*minX,const float*minY,const float*minZ,
+                 const float*maxX,const float*maxY,const float*maxZ,uint8_t*visible,size_t n){
+  size_t count = 0;
+  for(size_t i=0;i<n;++i){
+    bool inside = true;
+    for(const Vec4& p : f.planes){
+      // Test the corner furthest along the plane normal.
+      const float vx = p.x >= 0.f ? maxX[i] : minX[i];
+      const float vy = p.y >= 0.f ? maxY[i] : minY[i];
+      const float vz = p.z >= 0.f ? maxZ[i] : minZ[i];
+      if(p.x*vx + p.y*vy + p.z*vz + p.w < 0.f){ inside = false; break; }
+    }
+    visible[i] = inside ? 1 : 0;
+    count += inside;
+  }
+  return count;
+}
+} // namespace math_scalar
+
+#if defined(BLOCCO_MATH_SSE)
+// Each kernel runs the widest available vector loop, then hands the tail to
+// the scalar version. Operation order matches the scalar code exactly (no
+// FMA contraction in intrinsics), so results are bit-identical.
+void transformPoints(const Mat4&m,const float*x,const float*y,const float*z,float*ox,float*oy,float*oz,size_t n){
+  size_t i = 0;
+#if defined(BLOCCO_MATH_AVX2)
+  for(; i+8<=n; i+=8){
+    const __m256 px = _mm256_loadu_ps(x+i), py = _mm256_loadu_ps(y+i), pz = _mm256_loadu_ps(z+i);
+    for(int r=0;r<3;++r){
+      __m256 s = _mm256_mul_ps(_mm256_set1_ps(m.m[r]), px);
+      s = _mm256_add_ps(s, _mm256_mul_ps(_mm256_set1_ps(m.m[4+r]), py));
+      s = _mm256_add_ps(s, _mm256_mul_ps(_mm256_set1_ps(m.m[8+r]), pz));
+      s = _mm256_add_ps(s, _mm256_set1_ps(m.m[12+r]));
+      _mm256_storeu_ps((r==0 ? ox : r==1 ? oy : oz)+i, s);
+    }
+  }
+#endif
+  for(; i+4<=n; i+=4){
+    const __m128 px = _mm_loadu_ps(x+i), py = _mm_loadu_ps(y+i), pz = _mm_loadu_ps(z+i);
+    for(int r=0;r<3;++r){
+      __m128 s = _mm_mul_ps(_mm_set1_ps(m.m[r]), px);
+      s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(m.m[4+r]), py));
+      s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(m.m[8+r]), pz));
+      s = _mm_add_ps(s, _mm_set1_ps(m.m[12+r]));
+      _mm_storeu_ps((r==0 ? ox : r==1 ? oy : oz)+i, s);
+    }
+  }
+  math_scalar::transformPoints(m, x+i, y+i, z+i, ox+i, oy+i, oz+i, n-i);
+}
+
+size_t cullAabbs(const Frustum&f,const float*minX,const float*minY,const float*minZ,
+                 const float*maxX,const float*maxY,const float*maxZ,uint8_t*visible,size_t n){
+  // Per plane the p-vertex choice is uniform across boxes, so pick arrays up front.
+  const float* px[6]; const float* py[6]; const float* pz[6];
+  for(int k=0;k<6;++k){
+    const Vec4& p = f.planes[k];
+    px[k] = p.x >= 0.f ? maxX : minX;
+    py[k] = p.y >= 0.f ? maxY : minY;
+    pz[k] = p.z >= 0.f ? maxZ : minZ;
+  }
+  size_t i = 0, count = 0;
+#if defined(BLOCCO_MATH_AVX2)
+  for(; i+8<=n; i+=8){
+    __m256 outside = _mm256_setzero_ps();
+    for(int k=0;k<6;++k){
+      const Vec4& p = f.planes[k];
+      __m256 d = _mm256_mul_ps(_mm256_set1_ps(p.x), _mm256_loadu_ps(px[k]+i));
+      d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(p.y), _mm256_loadu_ps(py[k]+i)));
+      d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(p.z), _mm256_loadu_ps(pz[k]+i)));
+      d = _mm256_add_ps(d, _mm256_set1_ps(p.w));
+      outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_LT_OQ));
+    }
+    const unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(outside));
+    for(int k=0;k<8;++k){ const uint8_t v = ((mask >> k) & 1u) ? 0 : 1; visible[i+static_cast<size_t>(k)] = v; count += v; }
+  }
+#endif
+  for(; i+4<=n; i+=4){
+    __m128 outside = _mm_setzero_ps();
+    for(int k=0;k<6;++k){
+      const Vec4& p = f.planes[k];
+      __m128 d = _mm_mul_ps(_mm_set1_ps(p.x), _mm_loadu_ps(px[k]+i));
+      d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(p.y), _mm_loadu_ps(py[k]+i)));
+      d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(p.z), _mm_loadu_ps(pz[k]+i)));
+      d = _mm_add_ps(d, _mm_set1_ps(p.w));
+      outside = _mm_or_ps(outside, _mm_cmplt_ps(d, _mm_setzero_ps()));
+    }
+    const unsigned mask = static_cast<unsigned>(_mm_movemask_ps(outside));
+    for(int k=0;k<4;++k){ const uint8_t v = ((mask >> k) & 1u) ? 0 : 1; visible[i+static_cast<size_t>(k)] = v; count += v; }
+  }
+  return count + math_scalar::cullAabbs(f, minX+i, minY+i, minZ+i, maxX+i, maxY+i, maxZ+i, visible+i, n-i);
+}
+#else
+void transformPoints(const Mat4&m,const float*x,const float*y,const float*z,float*ox,float*oy,float*oz,size_t n){
+  math_scalar::transformPoints(m, x, y, z, ox, oy, oz, n);
+}
+size_t cullAabbs(const Frustum&f,const float*minX,const float*minY,const float*minZ,
+                 const float*maxX,const float*maxY,const float*maxZ,uint8_t*visible,size_t n){
+  return math_scalar::cullAabbs(f, minX, minY, minZ, maxX, maxY, maxZ, visible, n);
+}
+#endif
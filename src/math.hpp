@@ -1,11 +1,212 @@
 #pragma once
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// SIMD path selection happens at compile time: SSE2 on any x86-64 build,
+// AVX2 batch kernels when the compiler targets it (BLOCCO_ENABLE_MARCH_NATIVE
+// on a capable host). BLOCCO_FORCE_SCALAR_MATH pins the portable scalar code.
+#if !defined(BLOCCO_FORCE_SCALAR_MATH) && (defined(__SSE2__) || defined(_M_X64))
+#define BLOCCO_MATH_SSE 1
+#include <immintrin.h>
+#if defined(__AVX2__)
+#define BLOCCO_MATH_AVX2 1
+#endif
+#endif
+
 struct Vec3 {float x{},y{},z{};};
-struct Mat4 {float m[16];};
-Vec3 operator+(const Vec3&a,const Vec3&b);
-Vec3 operator-(const Vec3&a,const Vec3&b);
-Vec3 operator*(const Vec3&a,float s);
-float dot(const Vec3&a,const Vec3&b);
-Vec3 cross(const Vec3&a,const Vec3&b);
-float length(const Vec3&a);
-Vec3 normalize(const Vec3&a);
+struct Vec4 {float x{},y{},z{},w{};};
+// Column-major like GLSL: m[col*4 + row].
+struct alignas(16) Mat4 {float m[16]{};};
+
+constexpr Vec3 operator+(const Vec3&a,const Vec3&b){return {a.x+b.x,a.y+b.y,a.z+b.z};}
+constexpr Vec3 operator-(const Vec3&a,const Vec3&b){return {a.x-b.x,a.y-b.y,a.z-b.z};}
+constexpr Vec3 operator*(const Vec3&a,float s){return {a.x*s,a.y*s,a.z*s};}
+constexpr float dot(const Vec3&a,const Vec3&b){return a.x*b.x+a.y*b.y+a.z*b.z;}
+constexpr Vec3 cross(const Vec3&a,const Vec3&b){return {a.y*b.z-a.z*b.y,a.z*b.x-a.x*b.z,a.x*b.y-a.y*b.x};}
+inline float length(const Vec3&a){return std::sqrt(dot(a,a));}
+inline Vec3 normalize(const Vec3&a){float l=length(a);return l>0? a*(1.f/l):a;}
+
+constexpr Mat4 identity(){ Mat4 r; r.m[0]=r.m[5]=r.m[10]=r.m[15]=1.f; return r; }
+constexpr Mat4 translate(const Vec3&t){ Mat4 r=identity(); r.m[12]=t.x; r.m[13]=t.y; r.m[14]=t.z; return r; }
+
+// Portable reference implementations; the SIMD paths must agree with these.
+namespace math_scalar {
+constexpr Mat4 mul(const Mat4&a,const Mat4&b){
+  Mat4 r;
+  for(int c=0;c<4;++c) for(int row=0;row<4;++row){
+    float s = a.m[row]*b.m[c*4];
+    for(int k=1;k<4;++k) s += a.m[k*4+row]*b.m[c*4+k];
+    r.m[c*4+row] = s;
+  }
+  return r;
+}
+constexpr Vec4 mul(const Mat4&a,const Vec4&v){
+  return {a.m[0]*v.x + a.m[4]*v.y + a.m[8]*v.z + a.m[12]*v.w,
+          a.m[1]*v.x + a.m[5]*v.y + a.m[9]*v.z + a.m[13]*v.w,
+          a.m[2]*v.x + a.m[6]*v.y + a.m[10]*v.z + a.m[14]*v.w,
+          a.m[3]*v.x + a.m[7]*v.y + a.m[11]*v.z + a.m[15]*v.w};
+}
+// Cofactor expansion; returns the zero matrix when singular.
+constexpr Mat4 inverse(const Mat4&a){
+  const float* m = a.m;
+  Mat4 r;
+  float* o = r.m;
+  o[0] = m[5]*m[10]*m[15] - m[5]*m[11]*m[14] - m[9]*m[6]*m[15] + m[9]*m[7]*m[14] + m[13]*m[6]*m[11] - m[13]*m[7]*m[10];
+  o[4] = -m[4]*m[10]*m[15] + m[4]*m[11]*m[14] + m[8]*m[6]*m[15] - m[8]*m[7]*m[14] - m[12]*m[6]*m[11] + m[12]*m[7]*m[10];
+  o[8] = m[4]*m[9]*m[15] - m[4]*m[11]*m[13] - m[8]*m[5]*m[15] + m[8]*m[7]*m[13] + m[12]*m[5]*m[11] - m[12]*m[7]*m[9];
+  o[12] = -m[4]*m[9]*m[14] + m[4]*m[10]*m[13] + m[8]*m[5]*m[14] - m[8]*m[6]*m[13] - m[12]*m[5]*m[10] + m[12]*m[6]*m[9];
+  o[1] = -m[1]*m[10]*m[15] + m[1]*m[11]*m[14] + m[9]*m[2]*m[15] - m[9]*m[3]*m[14] - m[13]*m[2]*m[11] + m[13]*m[3]*m[10];
+  o[5] = m[0]*m[10]*m[15] - m[0]*m[11]*m[14] - m[8]*m[2]*m[15] + m[8]*m[3]*m[14] + m[12]*m[2]*m[11] - m[12]*m[3]*m[10];
+  o[9] = -m[0]*m[9]*m[15] + m[0]*m[11]*m[13] + m[8]*m[1]*m[15] - m[8]*m[3]*m[13] - m[12]*m[1]*m[11] + m[12]*m[3]*m[9];
+  o[13] = m[0]*m[9]*m[14] - m[0]*m[10]*m[13] - m[8]*m[1]*m[14] + m[8]*m[2]*m[13] + m[12]*m[1]*m[10] - m[12]*m[2]*m[9];
+  o[2] = m[1]*m[6]*m[15] - m[1]*m[7]*m[14] - m[5]*m[2]*m[15] + m[5]*m[3]*m[14] + m[13]*m[2]*m[7] - m[13]*m[3]*m[6];
+  o[6] = -m[0]*m[6]*m[15] + m[0]*m[7]*m[14] + m[4]*m[2]*m[15] - m[4]*m[3]*m[14] - m[12]*m[2]*m[7] + m[12]*m[3]*m[6];
+  o[10] = m[0]*m[5]*m[15] - m[0]*m[7]*m[13] - m[4]*m[1]*m[15] + m[4]*m[3]*m[13] + m[12]*m[1]*m[7] - m[12]*m[3]*m[5];
+  o[14] = -m[0]*m[5]*m[14] + m[0]*m[6]*m[13] + m[4]*m[1]*m[14] - m[4]*m[2]*m[13] - m[12]*m[1]*m[6] + m[12]*m[2]*m[5];
+  o[3] = -m[1]*m[6]*m[11] + m[1]*m[7]*m[10] + m[5]*m[2]*m[11] - m[5]*m[3]*m[10] - m[9]*m[2]*m[7] + m[9]*m[3]*m[6];
+  o[7] = m[0]*m[6]*m[11] - m[0]*m[7]*m[10] - m[4]*m[2]*m[11] + m[4]*m[3]*m[10] + m[8]*m[2]*m[7] - m[8]*m[3]*m[6];
+  o[11] = -m[0]*m[5]*m[11] + m[0]*m[7]*m[9] + m[4]*m[1]*m[11] - m[4]*m[3]*m[9] - m[8]*m[1]*m[7] + m[8]*m[3]*m[5];
+  o[15] = m[0]*m[5]*m[10] - m[0]*m[6]*m[9] - m[4]*m[1]*m[10] + m[4]*m[2]*m[9] + m[8]*m[1]*m[6] - m[8]*m[2]*m[5];
+  const float det = m[0]*o[0] + m[1]*o[4] + m[2]*o[8] + m[3]*o[12];
+  if(det == 0.f) return Mat4{};
+  const float inv = 1.f/det;
+  for(float& x : r.m) x *= inv;
+  return r;
+}
+} // namespace math_scalar
+
+#if defined(BLOCCO_MATH_SSE)
+namespace math_sse {
+inline Mat4 mul(const Mat4&a,const Mat4&b){
+  const __m128 c0 = _mm_load_ps(a.m), c1 = _mm_load_ps(a.m+4), c2 = _mm_load_ps(a.m+8), c3 = _mm_load_ps(a.m+12);
+  Mat4 r;
+  for(int c=0;c<4;++c){
+    const float* bc = b.m + c*4;
+    __m128 s = _mm_mul_ps(c0, _mm_set1_ps(bc[0]));
+    s = _mm_add_ps(s, _mm_mul_ps(c1, _mm_set1_ps(bc[1])));
+    s = _mm_add_ps(s, _mm_mul_ps(c2, _mm_set1_ps(bc[2])));
+    s = _mm_add_ps(s, _mm_mul_ps(c3, _mm_set1_ps(bc[3])));
+    _mm_store_ps(r.m + c*4, s);
+  }
+  return r;
+}
+inline Vec4 mul(const Mat4&a,const Vec4&v){
+  __m128 s = _mm_mul_ps(_mm_load_ps(a.m), _mm_set1_ps(v.x));
+  s = _mm_add_ps(s, _mm_mul_ps(_mm_load_ps(a.m+4), _mm_set1_ps(v.y)));
+  s = _mm_add_ps(s, _mm_mul_ps(_mm_load_ps(a.m+8), _mm_set1_ps(v.z)));
+  s = _mm_add_ps(s, _mm_mul_ps(_mm_load_ps(a.m+12), _mm_set1_ps(v.w)));
+  alignas(16) float o[4];
+  _mm_store_ps(o, s);
+  return {o[0],o[1],o[2],o[3]};
+}
+template<int X,int Y,int Z,int W>
+inline __m128 swizzle(__m128 v){ return _mm_shuffle_ps(v, v, _MM_SHUFFLE(W,Z,Y,X)); }
+// A*B, adj(A)*B and A*adj(B) on 2x2 matrices packed as (m00,m01,m10,m11).
+inline __m128 mat2Mul(__m128 x, __m128 y){
+  return _mm_add_ps(_mm_mul_ps(x, swizzle<0,3,0,3>(y)), _mm_mul_ps(swizzle<1,0,3,2>(x), swizzle<2,1,2,1>(y)));
+}
+inline __m128 mat2AdjMul(__m128 x, __m128 y){
+  return _mm_sub_ps(_mm_mul_ps(swizzle<3,3,0,0>(x), y), _mm_mul_ps(swizzle<1,1,2,2>(x), swizzle<2,3,0,1>(y)));
+}
+inline __m128 mat2MulAdj(__m128 x, __m128 y){
+  return _mm_sub_ps(_mm_mul_ps(x, swizzle<3,0,3,0>(y)), _mm_mul_ps(swizzle<1,0,3,2>(x), swizzle<2,1,2,1>(y)));
+}
+// 2x2 block inverse (general matrices). Columns are treated as rows, which
+// is fine because inverse commutes with transpose.
+inline Mat4 inverse(const Mat4&a){
+  const __m128 r0 = _mm_load_ps(a.m), r1 = _mm_load_ps(a.m+4), r2 = _mm_load_ps(a.m+8), r3 = _mm_load_ps(a.m+12);
+  const __m128 A = _mm_movelh_ps(r0, r1), B = _mm_movehl_ps(r1, r0);
+  const __m128 C = _mm_movelh_ps(r2, r3), D = _mm_movehl_ps(r3, r2);
+  const __m128 detSub = _mm_sub_ps(
+    _mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(2,0,2,0)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(3,1,3,1))),
+    _mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(3,1,3,1)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(2,0,2,0))));
+  const __m128 detA = swizzle<0,0,0,0>(detSub), detB = swizzle<1,1,1,1>(detSub);
+  const __m128 detC = swizzle<2,2,2,2>(detSub), detD = swizzle<3,3,3,3>(detSub);
+  const __m128 DC = mat2AdjMul(D, C);
+  const __m128 AB = mat2AdjMul(A, B);
+  __m128 X = _mm_sub_ps(_mm_mul_ps(detD, A), mat2Mul(B, DC));
+  __m128 W = _mm_sub_ps(_mm_mul_ps(detA, D), mat2Mul(C, AB));
+  __m128 Y = _mm_sub_ps(_mm_mul_ps(detB, C), mat2MulAdj(D, AB));
+  __m128 Z = _mm_sub_ps(_mm_mul_ps(detC, B), mat2MulAdj(A, DC));
+  __m128 tr = _mm_mul_ps(AB, swizzle<0,2,1,3>(DC));
+  tr = _mm_add_ps(tr, swizzle<2,3,0,1>(tr));
+  tr = _mm_add_ps(tr, swizzle<1,0,3,2>(tr));
+  const __m128 detM = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), tr);
+  alignas(16) float det[4];
+  _mm_store_ps(det, detM);
+  if(det[0] == 0.f) return Mat4{};
+  const __m128 rDet = _mm_div_ps(_mm_setr_ps(1.f, -1.f, -1.f, 1.f), detM);
+  X = _mm_mul_ps(X, rDet); Y = _mm_mul_ps(Y, rDet); Z = _mm_mul_ps(Z, rDet); W = _mm_mul_ps(W, rDet);
+  Mat4 r;
+  _mm_store_ps(r.m,    _mm_shuffle_ps(X, Y, _MM_SHUFFLE(1,3,1,3)));
+  _mm_store_ps(r.m+4,  _mm_shuffle_ps(X, Y, _MM_SHUFFLE(0,2,0,2)));
+  _mm_store_ps(r.m+8,  _mm_shuffle_ps(Z, W, _MM_SHUFFLE(1,3,1,3)));
+  _mm_store_ps(r.m+12, _mm_shuffle_ps(Z, W, _MM_SHUFFLE(0,2,0,2)));
+  return r;
+}
+} // namespace math_sse
+#endif
+
+constexpr Mat4 operator*(const Mat4&a,const Mat4&b){
+#if defined(BLOCCO_MATH_SSE)
+  if !consteval { return math_sse::mul(a,b); }
+#endif
+  return math_scalar::mul(a,b);
+}
+constexpr Vec4 operator*(const Mat4&a,const Vec4&v){
+#if defined(BLOCCO_MATH_SSE)
+  if !consteval { return math_sse::mul(a,v); }
+#endif
+  return math_scalar::mul(a,v);
+}
+constexpr Mat4 inverse(const Mat4&a){
+#if defined(BLOCCO_MATH_SSE)
+  if !consteval { return math_sse::inverse(a); }
+#endif
+  return math_scalar::inverse(a);
+}
+constexpr Vec3 transformPoint(const Mat4&a,const Vec3&p){
+  const Vec4 r = a * Vec4{p.x,p.y,p.z,1.f};
+  return {r.x,r.y,r.z};
+}
+
+// Right-handed view looking down -Z.
+inline Mat4 lookAt(const Vec3&eye,const Vec3&center,const Vec3&up){
+  const Vec3 f = normalize(center-eye);
+  const Vec3 s = normalize(cross(f,up));
+  const Vec3 u = cross(s,f);
+  Mat4 r = identity();
+  r.m[0]=s.x; r.m[4]=s.y; r.m[8]=s.z;
+  r.m[1]=u.x; r.m[5]=u.y; r.m[9]=u.z;
+  r.m[2]=-f.x; r.m[6]=-f.y; r.m[10]=-f.z;
+  r.m[12]=-dot(s,eye); r.m[13]=-dot(u,eye); r.m[14]=dot(f,eye);
+  return r;
+}
+// Vulkan clip space: Y points down, depth maps to [0,1].
+inline Mat4 perspective(float fovY,float aspect,float zNear,float zFar){
+  const float f = 1.f/std::tan(fovY*0.5f);
+  Mat4 r;
+  r.m[0] = f/aspect;
+  r.m[5] = -f;
+  r.m[10] = zFar/(zNear-zFar);
+  r.m[11] = -1.f;
+  r.m[14] = zNear*zFar/(zNear-zFar);
+  return r;
+}
+
+// Frustum planes (a,b,c,d) with a*x+b*y+c*z+d >= 0 inside; order L,R,B,T,N,F.
+struct Frustum { Vec4 planes[6]; };
+Frustum extractFrustum(const Mat4&viewProj);
+
+// SoA batch kernels. Arrays need no particular alignment; n may be any size.
+// Transforms points (w = 1, no perspective divide).
+void transformPoints(const Mat4&m,const float*x,const float*y,const float*z,float*ox,float*oy,float*oz,size_t n);
+// Writes visible[i] = 1 when box i is not fully outside any plane; returns the visible count.
+size_t cullAabbs(const Frustum&f,const float*minX,const float*minY,const float*minZ,
+                 const float*maxX,const float*maxY,const float*maxZ,uint8_t*visible,size_t n);
+namespace math_scalar {
+void transformPoints(const Mat4&m,const float*x,const float*y,const float*z,float*ox,float*oy,float*oz,size_t n);
+size_t cullAabbs(const Frustum&f,const float*minX,const float*minY,const float*minZ,
+                 const float*maxX,const float*maxY,const float*maxZ,uint8_t*visible,size_t n);
+}
@@ -0,0 +1,259 @@
+#include "memory.hpp"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <new>
+
+namespace {
+constexpr uint64_t alignUp(uint64_t v, uint64_t a){ return (v + a - 1) & ~(a - 1); }
+constexpr size_t ARENA_ALIGN = 64;
+}
+
+TlsfAllocator::TlsfAllocator(uint64_t capacity):m_capacity(capacity & ~(GRANULARITY - 1)){
+  for(auto& fl : m_heads) fl.fill(NONE);
+  if(m_capacity == 0) return;
+  const uint32_t n = newNode();
+  m_nodes[n].size = m_capacity;
+  m_nodes[n].free = true;
+  insertFree(n);
+}
+
+void TlsfAllocator::mapping(uint64_t size, uint32_t& fl, uint32_t& sl){
+  if(size < SL_COUNT){ fl = 0; sl = static_cast<uint32_t>(size); return; }
+  const auto msb = static_cast<uint32_t>(std::bit_width(size) - 1);
+  fl = msb - SL_BITS + 1;
+  sl = static_cast<uint32_t>(size >> (msb - SL_BITS)) - SL_COUNT;
+}
+
+uint32_t TlsfAllocator::newNode(){
+  if(!m_unusedNodes.empty()){
+    const uint32_t n = m_unusedNodes.back();
+    m_unusedNodes.pop_back();
+    m_nodes[n] = Node{};
+    return n;
+  }
+  m_nodes.emplace_back();
+  return static_cast<uint32_t>(m_nodes.size() - 1);
+}
+
+void TlsfAllocator::insertFree(uint32_t n){
+  uint32_t fl, sl;
+  mapping(m_nodes[n].size, fl, sl);
+  const uint32_t head = m_heads[fl][sl];
+  m_nodes[n].prevFree = NONE;
+  m_nodes[n].nextFree = head;
+  if(head != NONE) m_nodes[head].prevFree = n;
+  m_heads[fl][sl] = n;
+  m_flBitmap |= uint64_t{1} << fl;
+  m_slBitmap[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::removeFree(uint32_t n){
+  Node& node = m_nodes[n];
+  if(node.prevFree != NONE) m_nodes[node.prevFree].nextFree = node.nextFree;
+  if(node.nextFree != NONE) m_nodes[node.nextFree].prevFree = node.prevFree;
+  uint32_t fl, sl;
+  mapping(node.size, fl, sl);
+  if(m_heads[fl][sl] == n){
+    m_heads[fl][sl] = node.nextFree;
+    if(node.nextFree == NONE){
+      m_slBitmap[fl] &= ~(1u << sl);
+      if(!m_slBitmap[fl]) m_flBitmap &= ~(uint64_t{1} << fl);
+    }
+  }
+  node.prevFree = node.nextFree = NONE;
+}
+
+// Rounds the request up to the next list boundary so any block found is big enough.
+uint32_t TlsfAllocator::findFree(uint64_t size){
+  if(size >= SL_COUNT){
+    const auto msb = static_cast<uint32_t>(std::bit_width(size) - 1);
+    size += (uint64_t{1} << (msb - SL_BITS)) - 1;
+  }
+  uint32_t fl, sl;
+  mapping(size, fl, sl);
+  if(fl >= FL_COUNT) return NONE;
+  uint32_t slMap = m_slBitmap[fl] & (~0u << sl);
+  if(!slMap){
+    const uint64_t flMap = fl + 1 < 64 ? m_flBitmap & (~uint64_t{0} << (fl + 1)) : 0;
+    if(!flMap) return NONE;
+    fl = static_cast<uint32_t>(std::countr_zero(flMap));
+    slMap = m_slBitmap[fl];
+  }
+  return m_heads[fl][static_cast<uint32_t>(std::countr_zero(slMap))];
+}
+
+uint32_t TlsfAllocator::split(uint32_t n, uint64_t size){
+  const uint32_t r = newNode();
+  Node& node = m_nodes[n];
+  Node& rest = m_nodes[r];
+  rest.offset = node.offset + size;
+  rest.size = node.size - size;
+  rest.free = true;
+  rest.prevPhys = n;
+  rest.nextPhys = node.nextPhys;
+  if(node.nextPhys != NONE) m_nodes[node.nextPhys].prevPhys = r;
+  node.nextPhys = r;
+  node.size = size;
+  return r;
+}
+
+TlsfAllocation TlsfAllocator::allocate(uint64_t size, uint64_t align){
+  assert(std::has_single_bit(align));
+  size = alignUp(std::max<uint64_t>(size, 1), GRANULARITY);
+  align = std::max(align, GRANULARITY);
+  uint32_t n = findFree(size + (align - GRANULARITY));
+  if(n == NONE) return {};
+  removeFree(n);
+  const uint64_t pad = alignUp(m_nodes[n].offset, align) - m_nodes[n].offset;
+  if(pad){
+    // Leading padding stays free; its physical predecessor cannot be free, so no merge is needed.
+    const uint32_t r = split(n, pad);
+    insertFree(n);
+    n = r;
+  }
+  if(m_nodes[n].size - size >= GRANULARITY) insertFree(split(n, size));
+  Node& node = m_nodes[n];
+  node.free = false;
+  m_inUse += node.size;
+  m_peak = std::max(m_peak, m_inUse);
+  ++m_allocations;
+  return {node.offset, node.size, n};
+}
+
+void TlsfAllocator::free(const TlsfAllocation& a){
+  if(!a.valid()) return;
+  uint32_t n = a.node;
+  assert(!m_nodes[n].free);
+  m_inUse -= m_nodes[n].size;
+  --m_allocations;
+  m_nodes[n].free = true;
+  const uint32_t next = m_nodes[n].nextPhys;
+  if(next != NONE && m_nodes[next].free){
+    removeFree(next);
+    m_nodes[n].size += m_nodes[next].size;
+    m_nodes[n].nextPhys = m_nodes[next].nextPhys;
+    if(m_nodes[n].nextPhys != NONE) m_nodes[m_nodes[n].nextPhys].prevPhys = n;
+    m_unusedNodes.push_back(next);
+  }
+  const uint32_t prev = m_nodes[n].prevPhys;
+  if(prev != NONE && m_nodes[prev].free){
+    removeFree(prev);
+    m_nodes[prev].size += m_nodes[n].size;
+    m_nodes[prev].nextPhys = m_nodes[n].nextPhys;
+    if(m_nodes[prev].nextPhys != NONE) m_nodes[m_nodes[prev].nextPhys].prevPhys = prev;
+    m_unusedNodes.push_back(n);
+    n = prev;
+  }
+  insertFree(n);
+}
+
+MemoryStats TlsfAllocator::stats() const {
+  MemoryStats s{m_capacity, m_inUse, m_peak, m_allocations, 0, 0.f};
+  if(m_flBitmap){
+    // Largest free block lives in the highest non-empty list; scan only that list.
+    const auto fl = static_cast<uint32_t>(63 - std::countl_zero(m_flBitmap));
+    const auto sl = static_cast<uint32_t>(31 - std::countl_zero(m_slBitmap[fl]));
+    for(uint32_t n = m_heads[fl][sl]; n != NONE; n = m_nodes[n].nextFree) s.largestFree = std::max(s.largestFree, m_nodes[n].size);
+  }
+  const uint64_t freeBytes = m_capacity - m_inUse;
+  if(freeBytes) s.fragmentation = 1.f - static_cast<float>(static_cast<double>(s.largestFree) / static_cast<double>(freeBytes));
+  return s;
+}
+
+void FrameArena::Free::operator()(std::byte* p) const { ::operator delete[](p, std::align_val_t{ARENA_ALIGN}); }
+
+FrameArena::Block FrameArena::allocBlock(size_t bytes){
+  return Block(static_cast<std::byte*>(::operator new[](bytes, std::align_val_t{ARENA_ALIGN})));
+}
+
+FrameArena::FrameArena(size_t capacity):m_buffer(allocBlock(std::max<size_t>(capacity, ARENA_ALIGN))), m_capacity(std::max<size_t>(capacity, ARENA_ALIGN)){}
+
+void* FrameArena::allocate(size_t bytes, size_t align){
+  assert(std::has_single_bit(align));
+  const auto base = reinterpret_cast<uintptr_t>(m_buffer.get());
+  size_t head = m_head.load(std::memory_order_relaxed);
+  for(;;){
+    const size_t begin = alignUp(base + head, align) - base;
+    const size_t end = begin + bytes;
+    if(end > m_capacity) return allocateOverflow(bytes, align);
+    if(m_head.compare_exchange_weak(head, end, std::memory_order_relaxed)){
+      m_allocations.fetch_add(1, std::memory_order_relaxed);
+      return m_buffer.get() + begin;
+    }
+  }
+}
+
+void* FrameArena::allocateOverflow(size_t bytes, size_t align){
+  std::lock_guard lk(m_overflowLock);
+  const size_t size = bytes + (align > ARENA_ALIGN ? align : 0);
+  m_overflow.push_back(allocBlock(std::max<size_t>(size, 1)));
+  m_overflowBytes += bytes;
+  m_allocations.fetch_add(1, std::memory_order_relaxed);
+  const auto p = reinterpret_cast<uintptr_t>(m_overflow.back().get());
+  return reinterpret_cast<void*>(alignUp(p, align));
+}
+
+void FrameArena::reset(){
+  const size_t used = std::min(m_head.load(std::memory_order_relaxed), m_capacity) + m_overflowBytes;
+  m_peak = std::max<uint64_t>(m_peak, used);
+  if(!m_overflow.empty()){
+    // Grow once to this frame's footprint (plus headroom) instead of spilling every frame.
+    m_capacity = alignUp(used + used/2, ARENA_ALIGN);
+    m_buffer = allocBlock(m_capacity);
+    m_overflow.clear();
+    m_overflowBytes = 0;
+  }
+  m_head.store(0, std::memory_order_relaxed);
+  m_allocations.store(0, std::memory_order_relaxed);
+}
+
+MemoryStats FrameArena::stats() const {
+  const size_t head = std::min(m_head.load(std::memory_order_relaxed), m_capacity);
+  const uint64_t inUse = head + m_overflowBytes;
+  return {m_capacity + m_overflowBytes, inUse, std::max<uint64_t>(m_peak, inUse), m_allocations.load(std::memory_order_relaxed), m_capacity - head, 0.f};
+}
+
+StagingRing::StagingRing(uint64_t capacity):m_capacity(capacity){}
+
+uint64_t StagingRing::allocate(uint64_t size, uint64_t align, uint64_t batch){
+  assert(std::has_single_bit(align));
+  assert(m_spans.empty() || batch >= m_spans.back().batch);
+  if(size == 0 || size > m_capacity) return NONE;
+  uint64_t begin = alignUp(m_head, align);
+  uint64_t skipped = 0;
+  if(m_spans.empty() || m_head > m_tail){
+    // Live data is [tail, head): room up to the end, else from 0 up to the tail.
+    if(begin + size > m_capacity){
+      if(size > m_tail) return NONE;
+      skipped = m_capacity - m_head;
+      begin = 0;
+    }
+  } else if(begin + size > m_tail){
+    return NONE; // wrapped (or full): only [head, tail) is free
+  }
+  const uint64_t bytes = skipped + (begin + size - (skipped ? 0 : m_head));
+  m_spans.push_back({begin + size, bytes, batch});
+  m_head = begin + size;
+  m_inUse += bytes;
+  m_peak = std::max(m_peak, m_inUse);
+  ++m_allocations;
+  return begin;
+}
+
+void StagingRing::reclaim(uint64_t completed){
+  while(!m_spans.empty() && m_spans.front().batch <= completed){
+    m_tail = m_spans.front().end;
+    m_inUse -= m_spans.front().bytes;
+    m_spans.pop_front();
+  }
+  if(m_spans.empty()){ m_head = m_tail = 0; m_inUse = 0; }
+}
+
+MemoryStats StagingRing::stats() const {
+  uint64_t largest = 0;
+  if(m_spans.empty()) largest = m_capacity;
+  else if(m_head > m_tail) largest = std::max(m_capacity - m_head, m_tail);
+  else largest = m_tail - m_head;
+  return {m_capacity, m_inUse, m_peak, m_allocations, largest, 0.f};
+}
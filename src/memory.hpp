@@ -0,0 +1,129 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+// Dashboard counters shared by the CPU and GPU allocators. fragmentation is
+// 1 - largestFree/totalFree: 0 when all free space is one range.
+struct MemoryStats {
+  uint64_t capacity{0};
+  uint64_t inUse{0};
+  uint64_t peak{0};
+  uint64_t allocations{0};
+  uint64_t largestFree{0};
+  float fragmentation{0.f};
+};
+
+struct TlsfAllocation {
+  uint64_t offset{0};
+  uint64_t size{0};
+  uint32_t node{UINT32_MAX};
+  bool valid() const { return node != UINT32_MAX; }
+};
+
+// Two-level segregated fit over an abstract [0, capacity) range: O(1) allocate
+// and free with immediate coalescing. It only hands out offsets, so the same
+// code manages VkDeviceMemory blocks and anything else addressed by offset.
+class TlsfAllocator {
+public:
+  explicit TlsfAllocator(uint64_t capacity);
+  // align must be a power of two; returns an invalid allocation when full.
+  TlsfAllocation allocate(uint64_t size, uint64_t align = GRANULARITY);
+  void free(const TlsfAllocation& a);
+  MemoryStats stats() const;
+  bool empty() const { return m_allocations == 0; }
+
+  static constexpr uint64_t GRANULARITY = 16;
+private:
+  static constexpr uint32_t SL_BITS = 4;
+  static constexpr uint32_t SL_COUNT = 1u << SL_BITS;
+  static constexpr uint32_t FL_COUNT = 64 - SL_BITS + 1;
+  static constexpr uint32_t NONE = UINT32_MAX;
+  struct Node {
+    uint64_t offset{0};
+    uint64_t size{0};
+    uint32_t prevPhys{NONE}, nextPhys{NONE};
+    uint32_t prevFree{NONE}, nextFree{NONE};
+    bool free{false};
+  };
+  static void mapping(uint64_t size, uint32_t& fl, uint32_t& sl);
+  uint32_t newNode();
+  void insertFree(uint32_t n);
+  void removeFree(uint32_t n);
+  uint32_t findFree(uint64_t size);
+  uint32_t split(uint32_t n, uint64_t size); // returns the remainder node (free, not listed)
+
+  std::vector<Node> m_nodes;
+  std::vector<uint32_t> m_unusedNodes;
+  uint64_t m_flBitmap{0};
+  std::array<uint32_t, FL_COUNT> m_slBitmap{};
+  std::array<std::array<uint32_t, SL_COUNT>, FL_COUNT> m_heads;
+  uint64_t m_capacity;
+  uint64_t m_inUse{0};
+  uint64_t m_peak{0};
+  uint64_t m_allocations{0};
+};
+
+// Bump allocator for data that lives for one frame. allocate() is lock-free
+// and callable from job workers; reset() (main thread, between frames) drops
+// everything. Overflow spills into heap blocks and the arena grows to the
+// high-water mark at the next reset, so steady-state frames never touch malloc.
+class FrameArena {
+public:
+  explicit FrameArena(size_t capacity = size_t{4} << 20);
+  void* allocate(size_t bytes, size_t align = alignof(std::max_align_t));
+  template<class T> std::span<T> allocate(size_t count){
+    static_assert(std::is_trivially_destructible_v<T>, "arena memory is dropped without running destructors");
+    return {static_cast<T*>(allocate(sizeof(T)*count, alignof(T))), count};
+  }
+  void reset();
+  // inUse is the current frame; peak is the largest frame seen.
+  MemoryStats stats() const;
+private:
+  struct Free { void operator()(std::byte* p) const; };
+  using Block = std::unique_ptr<std::byte[], Free>;
+  static Block allocBlock(size_t bytes);
+  void* allocateOverflow(size_t bytes, size_t align);
+  Block m_buffer;
+  size_t m_capacity;
+  std::atomic<size_t> m_head{0};
+  std::atomic<uint64_t> m_allocations{0};
+  std::mutex m_overflowLock;
+  std::vector<Block> m_overflow;
+  size_t m_overflowBytes{0};
+  uint64_t m_peak{0};
+};
+
+// FIFO ring over an abstract [0, capacity) range for staging uploads. Every
+// allocation is tagged with the (non-decreasing) value of the GPU batch that
+// reads it; reclaim(completed) releases the oldest allocations up to that
+// value. An allocation never straddles the end: when it does not fit before
+// the end the remainder is skipped and it starts again at 0.
+class StagingRing {
+public:
+  static constexpr uint64_t NONE = UINT64_MAX;
+  explicit StagingRing(uint64_t capacity);
+  // align must be a power of two; returns NONE until older batches are reclaimed.
+  uint64_t allocate(uint64_t size, uint64_t align, uint64_t batch);
+  void reclaim(uint64_t completed);
+  bool empty() const { return m_spans.empty(); }
+  uint64_t oldestBatch() const { return m_spans.empty() ? 0 : m_spans.front().batch; }
+  uint64_t capacity() const { return m_capacity; }
+  MemoryStats stats() const;
+private:
+  struct Span { uint64_t end; uint64_t bytes; uint64_t batch; }; // bytes include padding and skipped tail
+  std::deque<Span> m_spans;
+  uint64_t m_capacity;
+  uint64_t m_head{0}; // next free byte
+  uint64_t m_tail{0}; // start of the oldest live span
+  uint64_t m_inUse{0};
+  uint64_t m_peak{0};
+  uint64_t m_allocations{0};
+};
@@ -0,0 +1,203 @@
+#include "mesher.hpp"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+constexpr int N = Chunk::SIZE;
+
+constexpr uint32_t OPEN_AO = 0xFFu << 16; // all four corners unoccluded
+
+// key is a mask entry: block id, then 2 bits of AO per corner (origin, +u, +u+v, +v).
+void emitQuad(MeshBuffers& out, int d, int sign, int slice, int u0, int v0, int w, int h, uint32_t key){
+  const int u = (d+1)%3, v = (d+2)%3;
+  const int plane = slice + (sign>0 ? 1 : 0);
+  // Corners counter-clockwise seen from the normal, starting at the quad origin.
+  int corner[4] = {0, 1, 2, 3};
+  if(sign < 0) std::swap(corner[1], corner[3]);
+  auto ao = [&](int c){ return key >> (16 + 2*c) & 3u; };
+  // Split along the brighter diagonal so occlusion interpolates without creases.
+  if(ao(0) + ao(2) < ao(1) + ao(3)) std::rotate(corner, corner + 1, corner + 4);
+  const int cu[4] = {u0, u0+w, u0+w, u0};
+  const int cv[4] = {v0, v0, v0+h, v0+h};
+  if(out.format == VertexFormat::Packed){
+    const uint32_t face = static_cast<uint32_t>(d*2 + (sign>0 ? 1 : 0));
+    for(int c : corner){
+      int p[3]; p[d] = plane; p[u] = cu[c]; p[v] = cv[c];
+      out.packed.push_back(PackedVertex::pack(p, face, static_cast<uint32_t>(c), ao(c), key & 0xFFFFu, w, h));
+    }
+    return;
+  }
+  const auto base = static_cast<uint32_t>(out.vertices.size());
+  for(int c : corner){
+    Vertex vx{};
+    vx.pos[d] = static_cast<float>(plane);
+    vx.pos[u] = static_cast<float>(cu[c]);
+    vx.pos[v] = static_cast<float>(cv[c]);
+    vx.normal[d] = static_cast<float>(sign);
+    vx.uv[0] = static_cast<float>(cu[c]-u0);
+    vx.uv[1] = static_cast<float>(cv[c]-v0);
+    out.vertices.push_back(vx);
+  }
+  for(uint32_t i : {0u,1u,2u,0u,2u,3u}) out.indices.push_back(base+i);
+}
+
+double msSince(std::chrono::steady_clock::time_point t0){
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-t0).count();
+}
+}
+
+ChunkMesher::ChunkMesher()
+  : m_blocks(static_cast<size_t>(PAD)*PAD*PAD, BLOCK_AIR), m_mask(static_cast<size_t>(N)*N, 0) {}
+
+ChunkNeighbourhood ChunkNeighbourhood::of(const Scene& scene, const ChunkCoord& c){
+  ChunkNeighbourhood n;
+  n.center = scene.findChunk(c);
+  const ChunkCoord nb[6] = {{c.x-1,c.y,c.z},{c.x+1,c.y,c.z},{c.x,c.y-1,c.z},{c.x,c.y+1,c.z},{c.x,c.y,c.z-1},{c.x,c.y,c.z+1}};
+  for(int f=0;f<6;++f) n.faces[static_cast<size_t>(f)] = scene.findChunk(nb[f]);
+  return n;
+}
+
+void DirtySlices::touch(int x, int y, int z){
+  const int p[3] = {x, y, z};
+  for(size_t d=0;d<3;++d){
+    // Faces in slice s read layers s-1..s+1 (the block, what is in front, occlusion).
+    for(int s = std::max(p[d]-1, 0); s <= std::min(p[d]+1, N-1); ++s) axis[d] |= 1u << s;
+  }
+}
+
+void SlicedMesh::flatten(MeshBuffers& out) const {
+  out.clear();
+  out.format = format;
+  size_t quads = 0;
+  for(const MeshBuffers& m : slices) quads += m.quadCount();
+  out.reserve(quads);
+  for(const MeshBuffers& m : slices){
+    if(format == VertexFormat::Packed){ out.packed.insert(out.packed.end(), m.packed.begin(), m.packed.end()); continue; }
+    const auto base = static_cast<uint32_t>(out.vertices.size());
+    out.vertices.insert(out.vertices.end(), m.vertices.begin(), m.vertices.end());
+    for(uint32_t i : m.indices) out.indices.push_back(base + i);
+  }
+}
+
+size_t SlicedMesh::bytes() const {
+  size_t b = 0;
+  for(const MeshBuffers& m : slices) b += m.bytes();
+  return b;
+}
+
+void ChunkMesher::gather(const ChunkNeighbourhood& chunks){
+  std::fill(m_blocks.begin(), m_blocks.end(), BLOCK_AIR);
+  if(const Chunk* self = chunks.center){
+    for(int y=0;y<N;++y) for(int z=0;z<N;++z)
+      self->getRun(Chunk::index(0,y,z), N, &m_blocks[static_cast<size_t>(((y+1)*PAD + z+1)*PAD + 1)]);
+  }
+  // Only the facing plane of each neighbour can hide a face.
+  for(int f=0;f<6;++f){
+    const Chunk* n = chunks.faces[static_cast<size_t>(f)];
+    if(!n || n->empty()) continue;
+    const int axis = f/2;
+    const int src = (f&1) ? 0 : N-1;   // neighbour plane touching us
+    const int dst = (f&1) ? N+1 : 0;   // padded slot outside our chunk
+    for(int a=0;a<N;++a) for(int b=0;b<N;++b){
+      int q[3];
+      q[axis] = src; q[(axis+1)%3] = a; q[(axis+2)%3] = b;
+      int r[3] = {q[0]+1, q[1]+1, q[2]+1};
+      r[axis] = dst;
+      m_blocks[static_cast<size_t>((r[1]*PAD + r[2])*PAD + r[0])] = n->get(q[0], q[1], q[2]);
+    }
+  }
+}
+
+MesherStats ChunkMesher::mesh(const Scene& scene, const ChunkCoord& c, MeshBuffers& out){
+  return mesh(ChunkNeighbourhood::of(scene, c), out);
+}
+
+MesherStats ChunkMesher::mesh(const ChunkNeighbourhood& chunks, MeshBuffers& out){
+  const auto t0 = std::chrono::steady_clock::now();
+  out.clear();
+  gather(chunks);
+  for(int d=0;d<3;++d) for(int sign : {-1, 1}) for(int slice=0;slice<N;++slice) meshSlice(d, sign, slice, out);
+  return {out.quadCount(), msSince(t0)};
+}
+
+MesherStats ChunkMesher::remesh(const ChunkNeighbourhood& chunks, const DirtySlices& dirty, SlicedMesh& mesh){
+  const auto t0 = std::chrono::steady_clock::now();
+  DirtySlices todo = dirty;
+  if(mesh.slices.size() != SlicedMesh::COUNT){ mesh.slices.assign(SlicedMesh::COUNT, MeshBuffers{}); todo = DirtySlices::all(); }
+  for(MeshBuffers& m : mesh.slices){
+    if(m.format != mesh.format){ todo = DirtySlices::all(); break; }
+  }
+  gather(chunks);
+  size_t quads = 0;
+  for(int d=0;d<3;++d) for(int sign : {-1, 1}) for(int slice=0;slice<N;++slice){
+    MeshBuffers& out = mesh.slices[SlicedMesh::index(d, sign, slice)];
+    if(!(todo.axis[static_cast<size_t>(d)] >> slice & 1u)) continue;
+    out.format = mesh.format;
+    out.clear();
+    meshSlice(d, sign, slice, out);
+    quads += out.quadCount();
+  }
+  return {quads, msSince(t0)};
+}
+
+void ChunkMesher::meshSlice(int d, int sign, int slice, MeshBuffers& out){
+  const int stride[3] = {1, PAD*PAD, PAD};
+  const int u = (d+1)%3, v = (d+2)%3;
+  // Build the face mask for this slice: block id and corner AO where a face is exposed.
+  bool any = false;
+  for(int j=0;j<N;++j) for(int i=0;i<N;++i){
+    int p[3]; p[d] = slice+1; p[u] = i+1; p[v] = j+1;
+    const int idx = (p[1]*PAD + p[2])*PAD + p[0];
+    const BlockId b = m_blocks[static_cast<size_t>(idx)];
+    const int front = idx + sign*stride[d];
+    uint32_t face = 0;
+    if(b != BLOCK_AIR && m_blocks[static_cast<size_t>(front)] == BLOCK_AIR){
+      auto solid = [&](int du, int dv){ return m_blocks[static_cast<size_t>(front + du*stride[u] + dv*stride[v])] != BLOCK_AIR ? 1u : 0u; };
+      face = m_occlusion ? b : b | OPEN_AO;
+      constexpr int OFFSETS[4][2] = {{-1,-1}, {1,-1}, {1,1}, {-1,1}};
+      for(uint32_t c=0;m_occlusion && c<4;++c){
+        const int du = OFFSETS[c][0], dv = OFFSETS[c][1];
+        const uint32_t s1 = solid(du, 0), s2 = solid(0, dv);
+        const uint32_t ao = (s1 && s2) ? 0u : 3u - (s1 + s2 + solid(du, dv));
+        face |= ao << (16 + 2*c);
+      }
+    }
+    m_mask[static_cast<size_t>(j*N + i)] = face;
+    any |= face != 0;
+  }
+  if(!any) return;
+  // Greedy merge: grow along u, then along v while the whole row matches.
+  for(int j=0;j<N;++j){
+    for(int i=0;i<N;){
+      const uint32_t id = m_mask[static_cast<size_t>(j*N + i)];
+      if(id == 0){ ++i; continue; }
+      int w = 1;
+      while(i+w < N && m_mask[static_cast<size_t>(j*N + i+w)] == id) ++w;
+      int h = 1;
+      for(; j+h < N; ++h){
+        const uint32_t* row = &m_mask[static_cast<size_t>((j+h)*N + i)];
+        if(!std::all_of(row, row+w, [id](uint32_t x){ return x == id; })) break;
+      }
+      for(int k=0;k<h;++k) std::fill_n(&m_mask[static_cast<size_t>((j+k)*N + i)], w, 0u);
+      emitQuad(out, d, sign, slice, i, j, w, h, id);
+      i += w;
+    }
+  }
+}
+
+MesherStats ChunkMesher::meshNaive(const Scene& scene, const ChunkCoord& c, MeshBuffers& out){
+  const auto t0 = std::chrono::steady_clock::now();
+  out.clear();
+  gather(ChunkNeighbourhood::of(scene, c));
+  for(int y=0;y<N;++y) for(int z=0;z<N;++z) for(int x=0;x<N;++x){
+    const BlockId b = padded(x+1,y+1,z+1);
+    if(b == BLOCK_AIR) continue;
+    const int p[3] = {x,y,z};
+    for(int d=0;d<3;++d){
+      const int u = (d+1)%3, v = (d+2)%3;
+      emitQuad(out, d, -1, p[d], p[u], p[v], 1, 1, b | OPEN_AO);
+      emitQuad(out, d, 1, p[d], p[u], p[v], 1, 1, b | OPEN_AO);
+    }
+  }
+  return {out.quadCount(), msSince(t0)};
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include "scene.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Matches the vertex input of shaders/vert.glsl (inPos, inNormal, inUV).
+struct Vertex {
+  float pos[3];
+  float normal[3];
+  float uv[2];
+};
+
+// 8-byte voxel vertex decoded by shaders/packed_vert.glsl and pull_vert.glsl.
+// lo: chunk-local x, y, z (6 bits each, 0..32), face (3: -x +x -y +y -z +z),
+// corner of the quad (2: 0 at its origin, then +u, +u+v, +v) and ambient
+// occlusion (2: 0 darkest .. 3 open). hi: texture layer (16, the block id)
+// and the quad's extent minus one along u and v (5 each), which with the
+// corner gives the same block-unit UVs as the float layout.
+struct PackedVertex {
+  uint32_t lo{0};
+  uint32_t hi{0};
+  static PackedVertex pack(const int pos[3], uint32_t face, uint32_t corner, uint32_t ao, uint32_t layer, int w, int h){
+    return {static_cast<uint32_t>(pos[0]) | static_cast<uint32_t>(pos[1]) << 6 | static_cast<uint32_t>(pos[2]) << 12 | face << 18 | corner << 21 | ao << 23,
+            layer | static_cast<uint32_t>(w - 1) << 16 | static_cast<uint32_t>(h - 1) << 21};
+  }
+  uint32_t x() const { return lo & 63u; }
+  uint32_t y() const { return lo >> 6 & 63u; }
+  uint32_t z() const { return lo >> 12 & 63u; }
+  uint32_t face() const { return lo >> 18 & 7u; }
+  uint32_t corner() const { return lo >> 21 & 3u; }
+  uint32_t ao() const { return lo >> 23 & 3u; }
+  uint32_t layer() const { return hi & 0xFFFFu; }
+  uint32_t width() const { return (hi >> 16 & 31u) + 1; }
+  uint32_t height() const { return (hi >> 21 & 31u) + 1; }
+};
+static_assert(sizeof(PackedVertex) == 8);
+
+enum class VertexFormat : uint8_t { Float, Packed };
+
+// Reusable output: clear() keeps capacity so steady-state meshing does not allocate.
+// format picks the vertex array the mesher fills. Packed meshes carry no
+// indices: every quad is drawn through the shared 0,1,2 0,2,3 pattern.
+struct MeshBuffers {
+  VertexFormat format{VertexFormat::Float};
+  std::vector<Vertex> vertices;
+  std::vector<PackedVertex> packed;
+  std::vector<uint32_t> indices;
+  void clear(){ vertices.clear(); packed.clear(); indices.clear(); }
+  void reserve(size_t quads){
+    if(format == VertexFormat::Packed){ packed.reserve(quads*4); return; }
+    vertices.reserve(quads*4); indices.reserve(quads*6);
+  }
+  size_t quadCount() const { return (format == VertexFormat::Packed ? packed.size() : vertices.size())/4; }
+  bool empty() const { return quadCount() == 0; }
+  // Vertex and index bytes as uploaded.
+  size_t bytes() const { return vertices.size()*sizeof(Vertex) + packed.size()*sizeof(PackedVertex) + indices.size()*sizeof(uint32_t); }
+};
+
+struct MesherStats {
+  size_t quads{0};
+  double ms{0.0};
+  double quadsPerMs() const { return ms > 0.0 ? static_cast<double>(quads)/ms : 0.0; }
+};
+
+// Mesh slices needing a rebuild: bit s of axis[d] covers the faces of layer s
+// along axis d, both directions. An edited block dirties the slices within one
+// layer of it, since faces read the layer in front of them for culling and
+// occlusion.
+struct DirtySlices {
+  std::array<uint32_t, 3> axis{};
+  static DirtySlices all(){ return {{~0u, ~0u, ~0u}}; }
+  bool any() const { return (axis[0] | axis[1] | axis[2]) != 0; }
+  // p in the chunk's padded frame: -1 and SIZE are the neighbours' facing planes.
+  void touch(int x, int y, int z);
+  DirtySlices& operator|=(const DirtySlices& o){ for(size_t d=0;d<3;++d) axis[d] |= o.axis[d]; return *this; }
+};
+
+// Calls fn(chunk, local x, y, z) for every chunk whose mesh reads the block at
+// p: its own, plus the face neighbours whose facing plane it lies on (local
+// coordinates there are -1 or SIZE). Edge and corner neighbours never read it.
+template<class F> void forMeshesReading(const BlockPos& p, F&& fn){
+  const ChunkCoord c = Scene::chunkOf(p.x, p.y, p.z);
+  const int local[3] = {p.x & Chunk::MASK, p.y & Chunk::MASK, p.z & Chunk::MASK};
+  fn(c, local[0], local[1], local[2]);
+  for(int d=0;d<3;++d){
+    for(int side : {-1, 1}){
+      if(local[d] != (side < 0 ? 0 : Chunk::SIZE - 1)) continue;
+      ChunkCoord n = c;
+      int q[3] = {local[0], local[1], local[2]};
+      (d == 0 ? n.x : d == 1 ? n.y : n.z) += side;
+      q[d] = side < 0 ? Chunk::SIZE : -1;
+      fn(n, q[0], q[1], q[2]);
+    }
+  }
+}
+
+// A chunk mesh kept per slice (axis, direction, layer) so remesh() rebuilds
+// only what edits touched. flatten() concatenates the slices in mesh() order,
+// so it yields exactly what mesh() would.
+struct SlicedMesh {
+  static constexpr size_t COUNT = 6 * Chunk::SIZE;
+  static size_t index(int d, int sign, int slice){ return static_cast<size_t>((d*2 + (sign > 0 ? 1 : 0))*Chunk::SIZE + slice); }
+  VertexFormat format{VertexFormat::Float};
+  std::vector<MeshBuffers> slices; // empty until the first remesh()
+  void flatten(MeshBuffers& out) const;
+  size_t bytes() const;
+};
+
+// A chunk and its face neighbours (-x, +x, -y, +y, -z, +z); null reads as air.
+// Lets a job mesh chunks whose owner keeps them alive, without touching the Scene.
+struct ChunkNeighbourhood {
+  const Chunk* center{nullptr};
+  std::array<const Chunk*, 6> faces{};
+  static ChunkNeighbourhood of(const Scene& scene, const ChunkCoord& c);
+};
+
+// CPU chunk mesher. Emits chunk-local quads (0..32 per axis) with hidden faces
+// culled against the chunk and its six face neighbours, and coplanar faces of
+// the same block and corner occlusion merged greedily into rectangles. UVs are
+// in block units so a repeating texture tiles across merged quads. Occlusion
+// comes from the three blocks in front of each face corner; neighbour chunks
+// only contribute their facing plane, so edges shared by three chunks read as
+// open. Without occlusion (setOcclusion(false)) every corner reads as open and
+// faces merge on block id alone, about half the quads on terrain.
+class ChunkMesher {
+public:
+  ChunkMesher();
+  MesherStats mesh(const Scene& scene, const ChunkCoord& c, MeshBuffers& out);
+  MesherStats mesh(const ChunkNeighbourhood& chunks, MeshBuffers& out);
+  // Rebuilds the dirty slices of mesh, or all of them when it is empty or in
+  // another format. Stats count the quads of the rebuilt slices only.
+  MesherStats remesh(const ChunkNeighbourhood& chunks, const DirtySlices& dirty, SlicedMesh& mesh);
+  // Per-cube reference: six faces per solid block, no culling or merging.
+  MesherStats meshNaive(const Scene& scene, const ChunkCoord& c, MeshBuffers& out);
+  void setOcclusion(bool on){ m_occlusion = on; }
+
+private:
+  static constexpr int PAD = Chunk::SIZE + 2;
+  void gather(const ChunkNeighbourhood& chunks);
+  void meshSlice(int d, int sign, int slice, MeshBuffers& out);
+  BlockId padded(int x, int y, int z) const { return m_blocks[static_cast<size_t>((y*PAD + z)*PAD + x)]; }
+  std::vector<BlockId> m_blocks; // PAD^3, chunk at offset 1, neighbour face planes around it
+  std::vector<uint32_t> m_mask;  // SIZE^2 face mask for the current slice: block id, corner AO << 16
+  bool m_occlusion{true};
+};
@@ -0,0 +1,233 @@
+#include "noise.hpp"
+#include <algorithm>
+#include <vector>
+
+namespace {
+constexpr uint32_t KX = 0x27d4eb2du, KY = 0x1b873593u, KZ = 0x165667b1u;
+
+float lattice(uint32_t h){
+  h ^= h >> 15; h *= 0x85ebca6bu; h ^= h >> 13; h *= 0xc2b2ae35u; h ^= h >> 16;
+  return static_cast<float>(h >> 8) * (1.f / 16777216.f);
+}
+
+// floor() the way the vector paths compute it: truncate, then step down where
+// that rounded up. Returns the cell and its coordinate as a float.
+int32_t cell(float p, float& f){
+  auto i = static_cast<int32_t>(p);
+  f = static_cast<float>(i);
+  if(f > p){ --i; f -= 1.f; }
+  return i;
+}
+
+float fade(float t){ return t*t*(3.f - 2.f*t); }
+float lerp(float a, float b, float t){ return a + (b - a)*t; }
+} // namespace
+
+namespace noise_scalar {
+void valueNoise2(uint32_t seed, float frequency, const float* x, const float* z, float* out, size_t n){
+  for(size_t i=0;i<n;++i){
+    const float px = x[i]*frequency, pz = z[i]*frequency;
+    float fx, fz;
+    const uint32_t x0 = static_cast<uint32_t>(cell(px, fx))*KX, x1 = x0 + KX;
+    const uint32_t z0 = static_cast<uint32_t>(cell(pz, fz))*KZ, z1 = z0 + KZ;
+    const float ux = fade(px - fx), uz = fade(pz - fz);
+    const float top = lerp(lattice(seed ^ x0 ^ z0), lattice(seed ^ x1 ^ z0), ux);
+    const float bottom = lerp(lattice(seed ^ x0 ^ z1), lattice(seed ^ x1 ^ z1), ux);
+    out[i] = lerp(top, bottom, uz);
+  }
+}
+
+void valueNoise3(uint32_t seed, float frequency, const float* x, const float* y, const float* z, float* out, size_t n){
+  for(size_t i=0;i<n;++i){
+    const float px = x[i]*frequency, py = y[i]*frequency, pz = z[i]*frequency;
+    float fx, fy, fz;
+    const uint32_t x0 = static_cast<uint32_t>(cell(px, fx))*KX, x1 = x0 + KX;
+    const uint32_t cy = static_cast<uint32_t>(cell(py, fy))*KY, y0 = seed ^ cy, y1 = seed ^ (cy + KY);
+    const uint32_t z0 = static_cast<uint32_t>(cell(pz, fz))*KZ, z1 = z0 + KZ;
+    const float ux = fade(px - fx), uy = fade(py - fy), uz = fade(pz - fz);
+    const float c00 = lerp(lattice(x0 ^ y0 ^ z0), lattice(x1 ^ y0 ^ z0), ux);
+    const float c10 = lerp(lattice(x0 ^ y1 ^ z0), lattice(x1 ^ y1 ^ z0), ux);
+    const float c01 = lerp(lattice(x0 ^ y0 ^ z1), lattice(x1 ^ y0 ^ z1), ux);
+    const float c11 = lerp(lattice(x0 ^ y1 ^ z1), lattice(x1 ^ y1 ^ z1), ux);
+    out[i] = lerp(lerp(c00, c10, uy), lerp(c01, c11, uy), uz);
+  }
+}
+} // namespace noise_scalar
+
+#if defined(BLOCCO_MATH_SSE)
+namespace {
+// One vector width's operations, so both widths share the kernels below.
+struct Sse {
+  using F = __m128;
+  using I = __m128i;
+  static constexpr size_t W = 4;
+  static F load(const float* p){ return _mm_loadu_ps(p); }
+  static void store(float* p, F v){ _mm_storeu_ps(p, v); }
+  static F set(float v){ return _mm_set1_ps(v); }
+  static I set(uint32_t v){ return _mm_set1_epi32(static_cast<int>(v)); }
+  static F add(F a, F b){ return _mm_add_ps(a, b); }
+  static F sub(F a, F b){ return _mm_sub_ps(a, b); }
+  static F mul(F a, F b){ return _mm_mul_ps(a, b); }
+  static I add(I a, I b){ return _mm_add_epi32(a, b); }
+  static I bitXor(I a, I b){ return _mm_xor_si128(a, b); }
+  static I shr(I a, int s){ return _mm_srl_epi32(a, _mm_cvtsi32_si128(s)); }
+  // SSE2 has no 32-bit multiply: the even and odd lanes as 64-bit products.
+  static I mul(I a, I b){
+    const I even = _mm_mul_epu32(a, b);
+    const I odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+  }
+  static F toFloat(I a){ return _mm_cvtepi32_ps(a); }
+  static I truncate(F a){ return _mm_cvttps_epi32(a); }
+  static F greater(F a, F b){ return _mm_cmpgt_ps(a, b); }
+  static F bitAnd(F a, F b){ return _mm_and_ps(a, b); }
+  static I asInt(F a){ return _mm_castps_si128(a); }
+};
+
+#if defined(BLOCCO_MATH_AVX2)
+struct Avx2 {
+  using F = __m256;
+  using I = __m256i;
+  static constexpr size_t W = 8;
+  static F load(const float* p){ return _mm256_loadu_ps(p); }
+  static void store(float* p, F v){ _mm256_storeu_ps(p, v); }
+  static F set(float v){ return _mm256_set1_ps(v); }
+  static I set(uint32_t v){ return _mm256_set1_epi32(static_cast<int>(v)); }
+  static F add(F a, F b){ return _mm256_add_ps(a, b); }
+  static F sub(F a, F b){ return _mm256_sub_ps(a, b); }
+  static F mul(F a, F b){ return _mm256_mul_ps(a, b); }
+  static I add(I a, I b){ return _mm256_add_epi32(a, b); }
+  static I bitXor(I a, I b){ return _mm256_xor_si256(a, b); }
+  static I shr(I a, int s){ return _mm256_srl_epi32(a, _mm_cvtsi32_si128(s)); }
+  static I mul(I a, I b){ return _mm256_mullo_epi32(a, b); }
+  static F toFloat(I a){ return _mm256_cvtepi32_ps(a); }
+  static I truncate(F a){ return _mm256_cvttps_epi32(a); }
+  static F greater(F a, F b){ return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+  static F bitAnd(F a, F b){ return _mm256_and_ps(a, b); }
+  static I asInt(F a){ return _mm256_castps_si256(a); }
+};
+#endif
+
+template<class V>
+typename V::F lattice(typename V::I h){
+  h = V::bitXor(h, V::shr(h, 15)); h = V::mul(h, V::set(0x85ebca6bu));
+  h = V::bitXor(h, V::shr(h, 13)); h = V::mul(h, V::set(0xc2b2ae35u));
+  h = V::bitXor(h, V::shr(h, 16));
+  return V::mul(V::toFloat(V::shr(h, 8)), V::set(1.f / 16777216.f));
+}
+
+// cell() per lane: the all-ones compare mask is -1 as an integer.
+template<class V>
+typename V::I cell(typename V::F p, typename V::F& f){
+  const typename V::I t = V::truncate(p);
+  const typename V::F tf = V::toFloat(t);
+  const typename V::F up = V::greater(tf, p);
+  f = V::sub(tf, V::bitAnd(up, V::set(1.f)));
+  return V::add(t, V::asInt(up));
+}
+
+template<class V>
+typename V::F fade(typename V::F t){ return V::mul(V::mul(t, t), V::sub(V::set(3.f), V::mul(V::set(2.f), t))); }
+
+template<class V>
+typename V::F lerp(typename V::F a, typename V::F b, typename V::F t){ return V::add(a, V::mul(V::sub(b, a), t)); }
+
+// Each kernel runs whole vectors from i and returns where it stopped.
+template<class V>
+size_t valueNoise2(size_t i, uint32_t seed, float frequency, const float* x, const float* z, float* out, size_t n){
+  using F = typename V::F;
+  using I = typename V::I;
+  const F freq = V::set(frequency);
+  const I s = V::set(seed);
+  for(; i+V::W<=n; i+=V::W){
+    const F px = V::mul(V::load(x+i), freq), pz = V::mul(V::load(z+i), freq);
+    F fx, fz;
+    const I x0 = V::mul(cell<V>(px, fx), V::set(KX)), x1 = V::add(x0, V::set(KX));
+    const I cz = V::mul(cell<V>(pz, fz), V::set(KZ));
+    const I z0 = V::bitXor(s, cz), z1 = V::bitXor(s, V::add(cz, V::set(KZ)));
+    const F ux = fade<V>(V::sub(px, fx)), uz = fade<V>(V::sub(pz, fz));
+    const F top = lerp<V>(lattice<V>(V::bitXor(x0, z0)), lattice<V>(V::bitXor(x1, z0)), ux);
+    const F bottom = lerp<V>(lattice<V>(V::bitXor(x0, z1)), lattice<V>(V::bitXor(x1, z1)), ux);
+    V::store(out+i, lerp<V>(top, bottom, uz));
+  }
+  return i;
+}
+
+template<class V>
+size_t valueNoise3(size_t i, uint32_t seed, float frequency, const float* x, const float* y, const float* z, float* out, size_t n){
+  using F = typename V::F;
+  using I = typename V::I;
+  const F freq = V::set(frequency);
+  const I s = V::set(seed);
+  for(; i+V::W<=n; i+=V::W){
+    const F px = V::mul(V::load(x+i), freq), py = V::mul(V::load(y+i), freq), pz = V::mul(V::load(z+i), freq);
+    F fx, fy, fz;
+    const I x0 = V::mul(cell<V>(px, fx), V::set(KX)), x1 = V::add(x0, V::set(KX));
+    const I cy = V::mul(cell<V>(py, fy), V::set(KY));
+    const I y0 = V::bitXor(s, cy), y1 = V::bitXor(s, V::add(cy, V::set(KY)));
+    const I z0 = V::mul(cell<V>(pz, fz), V::set(KZ)), z1 = V::add(z0, V::set(KZ));
+    const F ux = fade<V>(V::sub(px, fx)), uy = fade<V>(V::sub(py, fy)), uz = fade<V>(V::sub(pz, fz));
+    auto corner = [](I a, I b, I c){ return lattice<V>(V::bitXor(V::bitXor(a, b), c)); };
+    const F c00 = lerp<V>(corner(x0, y0, z0), corner(x1, y0, z0), ux);
+    const F c10 = lerp<V>(corner(x0, y1, z0), corner(x1, y1, z0), ux);
+    const F c01 = lerp<V>(corner(x0, y0, z1), corner(x1, y0, z1), ux);
+    const F c11 = lerp<V>(corner(x0, y1, z1), corner(x1, y1, z1), ux);
+    V::store(out+i, lerp<V>(lerp<V>(c00, c10, uy), lerp<V>(c01, c11, uy), uz));
+  }
+  return i;
+}
+} // namespace
+
+void valueNoise2(uint32_t seed, float frequency, const float* x, const float* z, float* out, size_t n){
+  size_t i = 0;
+#if defined(BLOCCO_MATH_AVX2)
+  i = valueNoise2<Avx2>(i, seed, frequency, x, z, out, n);
+#endif
+  i = valueNoise2<Sse>(i, seed, frequency, x, z, out, n);
+  noise_scalar::valueNoise2(seed, frequency, x+i, z+i, out+i, n-i);
+}
+
+void valueNoise3(uint32_t seed, float frequency, const float* x, const float* y, const float* z, float* out, size_t n){
+  size_t i = 0;
+#if defined(BLOCCO_MATH_AVX2)
+  i = valueNoise3<Avx2>(i, seed, frequency, x, y, z, out, n);
+#endif
+  i = valueNoise3<Sse>(i, seed, frequency, x, y, z, out, n);
+  noise_scalar::valueNoise3(seed, frequency, x+i, y+i, z+i, out+i, n-i);
+}
+#else
+void valueNoise2(uint32_t seed, float frequency, const float* x, const float* z, float* out, size_t n){
+  noise_scalar::valueNoise2(seed, frequency, x, z, out, n);
+}
+void valueNoise3(uint32_t seed, float frequency, const float* x, const float* y, const float* z, float* out, size_t n){
+  noise_scalar::valueNoise3(seed, frequency, x, y, z, out, n);
+}
+#endif
+
+namespace {
+// Sums the octaves into out; noise(seed, frequency, scratch) fills one octave.
+template<class Noise>
+void fractal(const Fractal& f, float* out, size_t n, Noise&& noise){
+  thread_local std::vector<float> octave;
+  if(octave.size() < n) octave.resize(n);
+  std::fill_n(out, n, 0.f);
+  float frequency = f.frequency, amplitude = 1.f, total = 0.f;
+  for(int o=0;o<std::max(f.octaves, 1);++o){
+    noise(f.seed + static_cast<uint32_t>(o)*0x9e3779b9u, frequency, octave.data());
+    for(size_t i=0;i<n;++i) out[i] += octave[i]*amplitude;
+    total += amplitude;
+    frequency *= 2.f;
+    amplitude *= 0.5f;
+  }
+  const float norm = 1.f / total;
+  for(size_t i=0;i<n;++i) out[i] *= norm;
+}
+} // namespace
+
+void fractalNoise2(const Fractal& f, const float* x, const float* z, float* out, size_t n){
+  fractal(f, out, n, [&](uint32_t seed, float frequency, float* octave){ valueNoise2(seed, frequency, x, z, octave, n); });
+}
+
+void fractalNoise3(const Fractal& f, const float* x, const float* y, const float* z, float* out, size_t n){
+  fractal(f, out, n, [&](uint32_t seed, float frequency, float* octave){ valueNoise3(seed, frequency, x, y, z, octave, n); });
+}
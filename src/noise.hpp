@@ -0,0 +1,30 @@
+#pragma once
+#include "math.hpp"
+#include <cstddef>
+#include <cstdint>
+
+// Value noise on a hashed integer lattice, evaluated in batches: n points per
+// call with their coordinates in separate arrays, scaled by frequency before
+// the lattice lookup. Lattice values are smoothstep-interpolated, in [0, 1).
+// Scaled coordinates must stay within +-2^24 (lattice cells are exact there).
+//
+// The SSE2 and AVX2 paths (picked as in math.hpp) run the scalar reference's
+// float operations in the same order, so every path returns the same bits and
+// terrain built on them hashes the same on every machine.
+namespace noise_scalar {
+void valueNoise2(uint32_t seed, float frequency, const float* x, const float* z, float* out, size_t n);
+void valueNoise3(uint32_t seed, float frequency, const float* x, const float* y, const float* z, float* out, size_t n);
+} // namespace noise_scalar
+
+void valueNoise2(uint32_t seed, float frequency, const float* x, const float* z, float* out, size_t n);
+void valueNoise3(uint32_t seed, float frequency, const float* x, const float* y, const float* z, float* out, size_t n);
+
+// Octaves of value noise, each at twice the frequency and half the amplitude
+// of the last with its own seed, normalised back to [0, 1).
+struct Fractal {
+  uint32_t seed{1};
+  float frequency{1.f / 64.f}; // of the first octave, per block
+  int octaves{4};
+};
+void fractalNoise2(const Fractal& f, const float* x, const float* z, float* out, size_t n);
+void fractalNoise3(const Fractal& f, const float* x, const float* y, const float* z, float* out, size_t n);
@@ -0,0 +1,304 @@
+#include "perf_report.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <string_view>
+
+Percentiles percentiles(std::vector<double> samples){
+  Percentiles p;
+  if(samples.empty()) return p;
+  std::sort(samples.begin(), samples.end());
+  const size_t n = samples.size();
+  // Nearest rank: the smallest sample with at least percent% of them at or below it.
+  auto rank = [&](size_t percent){ return samples[std::max<size_t>((n*percent + 99)/100, 1) - 1]; };
+  p.p50 = rank(50); p.p95 = rank(95); p.p99 = rank(99);
+  p.max = samples.back();
+  double sum = 0.0;
+  for(double v : samples) sum += v;
+  p.mean = sum / static_cast<double>(n);
+  p.count = n;
+  return p;
+}
+
+void PerfScenario::add(const std::string& metric, double value, bool higherIsBetter){
+  metrics.push_back({metric, value, higherIsBetter});
+}
+
+void PerfScenario::add(const std::string& metric, const Percentiles& p){
+  add(metric + "_p50", p.p50);
+  add(metric + "_p95", p.p95);
+  add(metric + "_p99", p.p99);
+}
+
+const PerfMetric* PerfScenario::find(const std::string& metric) const {
+  const auto it = std::find_if(metrics.begin(), metrics.end(), [&](const PerfMetric& m){ return m.name == metric; });
+  return it == metrics.end() ? nullptr : &*it;
+}
+
+const PerfScenario* PerfReport::find(const std::string& scenario) const {
+  const auto it = std::find_if(scenarios.begin(), scenarios.end(), [&](const PerfScenario& s){ return s.name == scenario; });
+  return it == scenarios.end() ? nullptr : &*it;
+}
+
+namespace {
+void writeString(std::string& out, const std::string& s){
+  out += '"';
+  for(const char c : s){
+    switch(c){
+      case '"': out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\n': out += "\\n"; break;
+      case '\t': out += "\\t"; break;
+      default:
+        if(static_cast<unsigned char>(c) < 0x20){
+          static constexpr char HEX[] = "0123456789abcdef";
+          out += "\\u00";
+          out += HEX[(c >> 4) & 0xF];
+          out += HEX[c & 0xF];
+        } else {
+          out += c;
+        }
+    }
+  }
+  out += '"';
+}
+
+// Shortest text that reads back as the same double; JSON has no inf or nan.
+void writeNumber(std::string& out, double v){
+  if(!std::isfinite(v)) v = 0.0;
+  char buf[32];
+  const auto r = std::to_chars(buf, buf + sizeof(buf), v);
+  out.append(buf, r.ptr);
+}
+
+// Recursive descent over the subset of JSON toJson() writes, plus skipping any
+// value under keys it does not know.
+class Reader {
+public:
+  Reader(const std::string& text, std::string& error) : m_p(text.data()), m_end(text.data() + text.size()), m_begin(text.data()), m_error(error) {}
+
+  bool fail(const std::string& what){
+    if(m_error.empty()) m_error = what + " at offset " + std::to_string(m_p - m_begin);
+    return false;
+  }
+  void space(){ while(m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r')) ++m_p; }
+  bool peek(char c){ space(); return m_p < m_end && *m_p == c; }
+  bool expect(char c){
+    if(!peek(c)) return fail(std::string("expected '") + c + "'");
+    ++m_p;
+    return true;
+  }
+  bool atEnd(){ space(); return m_p == m_end; }
+
+  bool string(std::string& out){
+    if(!expect('"')) return false;
+    out.clear();
+    while(m_p < m_end && *m_p != '"'){
+      char c = *m_p++;
+      if(c == '\\'){
+        if(m_p == m_end) break;
+        switch(*m_p++){
+          case '"': c = '"'; break;
+          case '\\': c = '\\'; break;
+          case '/': c = '/'; break;
+          case 'b': c = '\b'; break;
+          case 'f': c = '\f'; break;
+          case 'n': c = '\n'; break;
+          case 'r': c = '\r'; break;
+          case 't': c = '\t'; break;
+          case 'u': {
+            unsigned code = 0;
+            if(m_end - m_p < 4) return fail("short \\u escape");
+            if(std::from_chars(m_p, m_p + 4, code, 16).ptr != m_p + 4) return fail("bad \\u escape");
+            m_p += 4;
+            // UTF-8; surrogate pairs are kept as two three-byte sequences.
+            if(code < 0x80){ out += static_cast<char>(code); }
+            else if(code < 0x800){ out += static_cast<char>(0xC0 | (code >> 6)); out += static_cast<char>(0x80 | (code & 0x3F)); }
+            else { out += static_cast<char>(0xE0 | (code >> 12)); out += static_cast<char>(0x80 | ((code >> 6) & 0x3F)); out += static_cast<char>(0x80 | (code & 0x3F)); }
+            continue;
+          }
+          default: return fail("bad escape");
+        }
+      }
+      out += c;
+    }
+    if(m_p == m_end) return fail("unterminated string");
+    ++m_p;
+    return true;
+  }
+
+  bool number(double& out){
+    space();
+    const auto r = std::from_chars(m_p, m_end, out);
+    if(r.ec != std::errc{}) return fail("expected a number");
+    m_p = r.ptr;
+    return true;
+  }
+
+  bool boolean(bool& out){
+    space();
+    if(m_end - m_p >= 4 && std::string_view(m_p, 4) == "true"){ m_p += 4; out = true; return true; }
+    if(m_end - m_p >= 5 && std::string_view(m_p, 5) == "false"){ m_p += 5; out = false; return true; }
+    return fail("expected true or false");
+  }
+
+  // Calls member(key) for each key of an object; member reads the value.
+  template<class F>
+  bool object(F&& member){
+    if(!expect('{')) return false;
+    if(peek('}')){ ++m_p; return true; }
+    for(;;){
+      std::string key;
+      if(!string(key) || !expect(':') || !member(key)) return false;
+      if(peek(',')){ ++m_p; continue; }
+      return expect('}');
+    }
+  }
+
+  template<class F>
+  bool array(F&& element){
+    if(!expect('[')) return false;
+    if(peek(']')){ ++m_p; return true; }
+    for(;;){
+      if(!element()) return false;
+      if(peek(',')){ ++m_p; continue; }
+      return expect(']');
+    }
+  }
+
+  bool skip(int depth = 0){
+    if(depth > 64) return fail("nested too deeply");
+    space();
+    if(m_p == m_end) return fail("unexpected end");
+    std::string s;
+    double d;
+    bool b;
+    switch(*m_p){
+      case '{': return object([&](const std::string&){ return skip(depth + 1); });
+      case '[': return array([&]{ return skip(depth + 1); });
+      case '"': return string(s);
+      case 't': case 'f': return boolean(b);
+      case 'n':
+        if(m_end - m_p >= 4 && std::string_view(m_p, 4) == "null"){ m_p += 4; return true; }
+        return fail("bad literal");
+      default: return number(d);
+    }
+  }
+
+private:
+  const char* m_p;
+  const char* m_end;
+  const char* m_begin;
+  std::string& m_error;
+};
+} // namespace
+
+std::string PerfReport::toJson() const {
+  std::string out = "{\n  \"device\": ";
+  writeString(out, device);
+  out += ",\n  \"build\": ";
+  writeString(out, build);
+  out += ",\n  \"scenarios\": [";
+  for(size_t i=0;i<scenarios.size();++i){
+    const PerfScenario& s = scenarios[i];
+    out += i ? ",\n    {\"name\": " : "\n    {\"name\": ";
+    writeString(out, s.name);
+    out += ", \"frames\": " + std::to_string(s.frames) + ", \"metrics\": {";
+    for(size_t j=0;j<s.metrics.size();++j){
+      const PerfMetric& m = s.metrics[j];
+      out += j ? ",\n      " : "\n      ";
+      writeString(out, m.name);
+      out += ": {\"value\": ";
+      writeNumber(out, m.value);
+      out += m.higherIsBetter ? ", \"better\": \"higher\"}" : ", \"better\": \"lower\"}";
+    }
+    out += s.metrics.empty() ? "}}" : "\n    }}";
+  }
+  out += scenarios.empty() ? "]\n}\n" : "\n  ]\n}\n";
+  return out;
+}
+
+bool PerfReport::fromJson(const std::string& json, PerfReport& out, std::string& error){
+  error.clear();
+  out = {};
+  Reader r(json, error);
+  auto metric = [&](PerfMetric& m){
+    return r.object([&](const std::string& key){
+      if(key == "value") return r.number(m.value);
+      if(key != "better") return r.skip();
+      std::string better;
+      if(!r.string(better)) return false;
+      if(better != "higher" && better != "lower") return r.fail("\"better\" must be \"higher\" or \"lower\"");
+      m.higherIsBetter = better == "higher";
+      return true;
+    });
+  };
+  auto scenario = [&]{
+    PerfScenario& s = out.scenarios.emplace_back();
+    return r.object([&](const std::string& key){
+      if(key == "name") return r.string(s.name);
+      if(key == "frames"){
+        double frames = 0.0;
+        if(!r.number(frames)) return false;
+        s.frames = static_cast<int>(frames);
+        return true;
+      }
+      if(key == "metrics") return r.object([&](const std::string& name){
+        PerfMetric& m = s.metrics.emplace_back();
+        m.name = name;
+        return metric(m);
+      });
+      return r.skip();
+    });
+  };
+  const bool ok = r.object([&](const std::string& key){
+    if(key == "device") return r.string(out.device);
+    if(key == "build") return r.string(out.build);
+    if(key == "scenarios") return r.array(scenario);
+    return r.skip();
+  }) && (r.atEnd() || r.fail("trailing characters"));
+  if(!ok) out = {};
+  return ok;
+}
+
+bool PerfReport::save(const std::string& path) const {
+  const std::string json = toJson();
+  std::ofstream f(path, std::ios::binary | std::ios::trunc);
+  f.write(json.data(), static_cast<std::streamsize>(json.size()));
+  return static_cast<bool>(f);
+}
+
+bool PerfReport::load(const std::string& path, PerfReport& out, std::string& error){
+  std::ifstream f(path, std::ios::binary | std::ios::ate);
+  if(!f){ error = "cannot open " + path; return false; }
+  std::string json(static_cast<size_t>(f.tellg()), '\0');
+  f.seekg(0);
+  if(!f.read(json.data(), static_cast<std::streamsize>(json.size()))){ error = "cannot read " + path; return false; }
+  return fromJson(json, out, error);
+}
+
+std::vector<PerfChange> compareReports(const PerfReport& baseline, const PerfReport& current, const CompareOptions& options){
+  std::vector<PerfChange> changes;
+  for(const PerfScenario& s : current.scenarios){
+    const PerfScenario* base = baseline.find(s.name);
+    if(!base) continue;
+    for(const PerfMetric& m : s.metrics){
+      const PerfMetric* b = base->find(m.name);
+      if(!b) continue;
+      PerfChange c{s.name, m.name, b->value, m.value};
+      const double delta = m.value - b->value;
+      c.change = b->value != 0.0 ? delta / std::fabs(b->value) : 0.0;
+      const double worse = m.higherIsBetter ? -delta : delta;
+      c.regression = worse > options.noise && worse > options.threshold * std::fabs(b->value);
+      changes.push_back(std::move(c));
+    }
+    for(const PerfMetric& b : base->metrics){
+      if(s.find(b.name)) continue;
+      PerfChange c{s.name, b.name, b.value, 0.0};
+      c.missing = true;
+      changes.push_back(std::move(c));
+    }
+  }
+  return changes;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Benchmark results: named scenarios of named metrics, written and read as JSON
+// so that one run can be kept as a baseline and later runs checked against it.
+// Metric directions travel with the report: times, bytes and counts are better
+// lower, throughputs higher.
+
+// Nearest-rank percentiles of a set of samples; all zero when it is empty.
+struct Percentiles {
+  double p50{0.0}, p95{0.0}, p99{0.0}, max{0.0}, mean{0.0};
+  size_t count{0};
+};
+Percentiles percentiles(std::vector<double> samples);
+
+struct PerfMetric {
+  std::string name;
+  double value{0.0};
+  bool higherIsBetter{false};
+};
+
+struct PerfScenario {
+  std::string name;
+  int frames{0};
+  std::vector<PerfMetric> metrics; // in the order added
+  void add(const std::string& metric, double value, bool higherIsBetter = false);
+  // metric_p50, _p95 and _p99: the max is one frame, too noisy to compare.
+  void add(const std::string& metric, const Percentiles& p);
+  const PerfMetric* find(const std::string& metric) const;
+};
+
+struct PerfReport {
+  std::string device; // what ran it: GPU and driver
+  std::string build;  // how it was built: compiler, math path, build type
+  std::vector<PerfScenario> scenarios;
+  const PerfScenario* find(const std::string& scenario) const;
+  std::string toJson() const;
+  // Unknown keys are skipped. False with a message on malformed input.
+  static bool fromJson(const std::string& json, PerfReport& out, std::string& error);
+  bool save(const std::string& path) const;
+  static bool load(const std::string& path, PerfReport& out, std::string& error);
+};
+
+// A metric regresses when it is worse than the baseline by more than threshold
+// (relative) and by more than noise (absolute, in the metric's own unit, so
+// sub-0.05 ms timer jitter on a 0.1 ms frame is not a 50% regression).
+struct CompareOptions {
+  double threshold{0.10};
+  double noise{0.05};
+};
+struct PerfChange {
+  std::string scenario, metric;
+  double baseline{0.0}, current{0.0};
+  double change{0.0}; // (current - baseline) / |baseline|, 0 when the baseline is 0
+  bool regression{false};
+  bool missing{false}; // in the baseline but not in the current run of its scenario
+};
+// Every metric present in both reports, matched by scenario and metric name;
+// the current report decides the direction. A baseline metric absent from a
+// scenario the current report has is returned as missing, so a scenario that
+// stopped early or a renamed metric does not pass unnoticed. Baseline
+// scenarios the current report did not run are skipped.
+std::vector<PerfChange> compareReports(const PerfReport& baseline, const PerfReport& current, const CompareOptions& options = {});
@@ -0,0 +1,285 @@
+#include "physics.hpp"
+#include "camera.hpp"
+#include "jobs.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+
+namespace {
+float axisOf(const Vec3& v, int a){ return a == 0 ? v.x : a == 1 ? v.y : v.z; }
+float& axisOf(Vec3& v, int a){ return a == 0 ? v.x : a == 1 ? v.y : v.z; }
+
+// Moves a box through the voxel grid one axis at a time, vertical first so
+// landing resolves before sliding. Velocity along a blocked axis is zeroed;
+// returns true when the downward move was blocked (standing on something).
+bool moveThroughVoxels(const Scene& scene, Vec3& position, Vec3& velocity, const Vec3& boxMin, const Vec3& boxMax, float dt){
+  bool landed = false;
+  for(int axis : {1, 0, 2}){
+    const float want = axisOf(velocity, axis) * dt;
+    if(want == 0.f) continue;
+    const float moved = sweepVoxels(scene, {position + boxMin, position + boxMax}, axis, want);
+    axisOf(position, axis) += moved;
+    if(moved != want){
+      if(axis == 1 && want < 0.f) landed = true;
+      axisOf(velocity, axis) = 0.f;
+    }
+  }
+  return landed;
+}
+
+void hashBytes(uint64_t& h, const Vec3& v){
+  for(float f : {v.x, v.y, v.z}){
+    const auto bits = std::bit_cast<uint32_t>(f);
+    for(int i=0;i<4;++i) h = (h ^ ((bits >> (8*i)) & 0xffu)) * 0x100000001b3ull;
+  }
+}
+}
+
+int FixedTimestep::advance(double dt){
+  m_accumulator += std::max(dt, 0.0);
+  int steps = static_cast<int>(m_accumulator / m_step);
+  if(steps > m_maxSteps){
+    steps = m_maxSteps;
+    m_accumulator = 0.0;
+    return steps;
+  }
+  m_accumulator -= steps * m_step;
+  return steps;
+}
+
+AABB Character::bounds() const {
+  const Vec3& h = params.halfExtents;
+  return {{position.x - h.x, position.y, position.z - h.z}, {position.x + h.x, position.y + 2.f*h.y, position.z + h.z}};
+}
+
+Vec3 Character::eye(float alpha) const {
+  return previous + (position - previous)*alpha + Vec3{0.f, params.eyeHeight, 0.f};
+}
+
+PhysicsWorld::PhysicsWorld(const Scene& scene, JobSystem* jobs, const PhysicsConfig& config)
+  : m_scene(scene), m_jobs(jobs), m_config(config) {}
+
+uint32_t PhysicsWorld::addBody(const Vec3& center, const Vec3& halfExtents, float mass){
+  const auto id = static_cast<uint32_t>(m_bodies.size());
+  RigidBody b;
+  b.position = b.previous = center;
+  b.halfExtents = halfExtents;
+  b.invMass = mass > 0.f ? 1.f/mass : 0.f;
+  m_bodies.push_back(b);
+  m_proxies.push_back(m_tree.insert(b.bounds(), id));
+  return id;
+}
+
+Vec3 PhysicsWorld::interpolated(uint32_t id, float alpha) const {
+  const RigidBody& b = m_bodies[id];
+  return b.previous + (b.position - b.previous)*alpha;
+}
+
+Character& PhysicsWorld::spawnCharacter(const Vec3& feet, const CharacterParams& params){
+  Character c;
+  c.position = c.previous = feet;
+  c.params = params;
+  return m_character.emplace(c);
+}
+
+void PhysicsWorld::step(const PlayerInput& input){
+  BLOCCO_ZONE("physics step");
+  const auto start = std::chrono::steady_clock::now();
+  if(m_character) stepCharacter(input);
+  const float dt = m_config.step;
+  for(RigidBody& b : m_bodies){
+    b.previous = b.position;
+    if(b.invMass > 0.f) b.velocity = b.velocity + m_config.gravity*dt;
+  }
+  buildIslands();
+  auto solve = [this](size_t begin, size_t end){ for(size_t i=begin;i<end;++i) solveIsland(m_islands[i]); };
+  if(m_jobs && m_islands.size() > m_config.islandsPerJob) m_jobs->parallelFor(0, m_islands.size(), m_config.islandsPerJob, solve);
+  else solve(0, m_islands.size());
+  ++m_stats.steps;
+  m_stats.stepMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void PhysicsWorld::stepCharacter(const PlayerInput& input){
+  Character& c = *m_character;
+  const float dt = m_config.step;
+  c.previous = c.position;
+  c.yaw = input.yaw;
+  c.pitch = input.pitch;
+  // yaw 0 walks towards -Z, like the camera.
+  const Vec3 forward{std::sin(c.yaw), 0.f, -std::cos(c.yaw)};
+  const Vec3 right{std::cos(c.yaw), 0.f, std::sin(c.yaw)};
+  Vec3 wish = forward*input.forward + right*input.strafe;
+  if(dot(wish, wish) > 1.f) wish = normalize(wish);
+  c.velocity.x = wish.x * c.params.walkSpeed;
+  c.velocity.z = wish.z * c.params.walkSpeed;
+  if(input.jump && c.grounded) c.velocity.y = c.params.jumpSpeed;
+  c.velocity = c.velocity + m_config.gravity*dt;
+  const AABB box = c.bounds();
+  c.grounded = moveThroughVoxels(m_scene, c.position, c.velocity, box.min - c.position, box.max - c.position, dt);
+}
+
+uint32_t PhysicsWorld::findRoot(uint32_t i){
+  while(m_parent[i] != i){
+    m_parent[i] = m_parent[m_parent[i]];
+    i = m_parent[i];
+  }
+  return i;
+}
+
+void PhysicsWorld::buildIslands(){
+  const float dt = m_config.step;
+  // Broadphase on swept boxes, so bodies about to meet this step share an island.
+  for(size_t i=0;i<m_bodies.size();++i){
+    const RigidBody& b = m_bodies[i];
+    const AABB now = b.bounds();
+    m_tree.move(m_proxies[i], merge(now, {now.min + b.velocity*dt, now.max + b.velocity*dt}));
+  }
+  size_t count = m_tree.queryPairs(m_pairs);
+  if(count > m_pairs.size()){
+    m_pairs.resize(count);
+    count = m_tree.queryPairs(m_pairs);
+  }
+  m_pairs.resize(count);
+  for(BroadphasePair& p : m_pairs) if(p.a > p.b) std::swap(p.a, p.b);
+  // Tree order depends on its shape; the solver must not.
+  std::sort(m_pairs.begin(), m_pairs.end(), [](const BroadphasePair& x, const BroadphasePair& y){ return x.a != y.a ? x.a < y.a : x.b < y.b; });
+  std::erase_if(m_pairs, [&](const BroadphasePair& p){ return m_bodies[p.a].invMass == 0.f && m_bodies[p.b].invMass == 0.f; });
+
+  // Union-find over dynamic bodies; static bodies never join islands, so two
+  // stacks on the same static box still solve independently.
+  const auto n = static_cast<uint32_t>(m_bodies.size());
+  m_parent.resize(n);
+  for(uint32_t i=0;i<n;++i) m_parent[i] = i;
+  for(const BroadphasePair& p : m_pairs){
+    if(m_bodies[p.a].invMass == 0.f || m_bodies[p.b].invMass == 0.f) continue;
+    const uint32_t ra = findRoot(p.a), rb = findRoot(p.b);
+    if(ra != rb) m_parent[std::max(ra, rb)] = std::min(ra, rb);
+  }
+  // Islands numbered by their lowest body id; counting sorts keep bodies and
+  // pairs in id order inside each island.
+  std::vector<uint32_t> islandOf(n, UINT32_MAX);
+  std::vector<uint32_t> bodyCounts;
+  for(uint32_t i=0;i<n;++i){
+    if(m_bodies[i].invMass == 0.f) continue;
+    const uint32_t r = findRoot(i);
+    if(islandOf[r] == UINT32_MAX){ islandOf[r] = static_cast<uint32_t>(bodyCounts.size()); bodyCounts.push_back(0); }
+    islandOf[i] = islandOf[r];
+    ++bodyCounts[islandOf[i]];
+  }
+  const size_t islands = bodyCounts.size();
+  std::vector<uint32_t> pairCounts(islands, 0);
+  auto pairIsland = [&](const BroadphasePair& p){ return islandOf[m_bodies[p.a].invMass > 0.f ? p.a : p.b]; };
+  for(const BroadphasePair& p : m_pairs) ++pairCounts[pairIsland(p)];
+  m_islands.resize(islands);
+  uint32_t bodyAt = 0, pairAt = 0;
+  for(size_t k=0;k<islands;++k){
+    m_islands[k] = {bodyAt, bodyAt, pairAt, pairAt};
+    bodyAt += bodyCounts[k];
+    pairAt += pairCounts[k];
+  }
+  m_islandBodies.resize(bodyAt);
+  m_islandPairs.resize(pairAt);
+  for(uint32_t i=0;i<n;++i) if(islandOf[i] != UINT32_MAX) m_islandBodies[m_islands[islandOf[i]].bodyEnd++] = i;
+  for(const BroadphasePair& p : m_pairs) m_islandPairs[m_islands[pairIsland(p)].pairEnd++] = p;
+  m_stats.islands = static_cast<uint32_t>(islands);
+  m_stats.contacts = static_cast<uint32_t>(m_pairs.size());
+}
+
+void PhysicsWorld::solveIsland(const Island& island){
+  const float dt = m_config.step;
+  constexpr float SLOP = 0.01f;  // gap below which boxes count as touching (friction applies)
+  constexpr float PUSH = 0.2f;   // share of an overlap pushed out per step
+  struct Contact { uint32_t a, b; int axis; float sign, gap; };
+  // Speculative contacts: the separating axis is the one with the largest gap
+  // (or smallest overlap), and the solver only forbids closing more than the
+  // gap within this step, so fast boxes stop at the surface instead of tunnelling.
+  thread_local std::vector<Contact> contacts;
+  contacts.clear();
+  for(uint32_t k=island.pairBegin;k<island.pairEnd;++k){
+    const BroadphasePair& p = m_islandPairs[k];
+    const RigidBody& a = m_bodies[p.a];
+    const RigidBody& b = m_bodies[p.b];
+    Contact c{p.a, p.b, 0, 1.f, -INFINITY};
+    for(int axis=0;axis<3;++axis){
+      const float d = axisOf(b.position, axis) - axisOf(a.position, axis);
+      const float gap = std::fabs(d) - axisOf(a.halfExtents, axis) - axisOf(b.halfExtents, axis);
+      if(gap > c.gap){ c.gap = gap; c.axis = axis; c.sign = d < 0.f ? -1.f : 1.f; }
+    }
+    contacts.push_back(c);
+  }
+  // Room each body has before the voxels along every axis, so pushes between
+  // bodies cannot drive one into the ground: the voxel side acts as infinite mass.
+  struct Room { float lo[3], hi[3]; };
+  thread_local std::vector<Room> room;
+  room.clear();
+  if(!contacts.empty()){
+    for(uint32_t k=island.bodyBegin;k<island.bodyEnd;++k){
+      const RigidBody& b = m_bodies[m_islandBodies[k]];
+      Room r;
+      for(int axis=0;axis<3;++axis){
+        const float reach = 1.f + std::fabs(axisOf(b.velocity, axis))*dt;
+        r.lo[axis] = sweepVoxels(m_scene, b.bounds(), axis, -reach);
+        r.hi[axis] = sweepVoxels(m_scene, b.bounds(), axis, reach);
+      }
+      room.push_back(r);
+    }
+  }
+  for(int it=0;it<m_config.solverIterations && !contacts.empty();++it){
+    for(const Contact& c : contacts){
+      RigidBody& a = m_bodies[c.a];
+      RigidBody& b = m_bodies[c.b];
+      const float invMass = a.invMass + b.invMass;
+      const float vn = (axisOf(b.velocity, c.axis) - axisOf(a.velocity, c.axis)) * c.sign;
+      const float target = c.gap >= 0.f ? -c.gap/dt : -c.gap*PUSH/dt;
+      if(vn >= target) continue;
+      const float j = (target - vn) / invMass;
+      // A static body can sit in the pairs of several islands solved at once:
+      // only dynamic bodies (which belong to this island alone) are written.
+      if(a.invMass > 0.f) axisOf(a.velocity, c.axis) -= j * a.invMass * c.sign;
+      if(b.invMass > 0.f) axisOf(b.velocity, c.axis) += j * b.invMass * c.sign;
+      if(c.gap > SLOP) continue;
+      // Coulomb friction on the two tangent axes, bounded by this normal impulse.
+      for(int t : {(c.axis+1)%3, (c.axis+2)%3}){
+        const float vt = axisOf(b.velocity, t) - axisOf(a.velocity, t);
+        const float jt = std::clamp(-vt/invMass, -m_config.friction*j, m_config.friction*j);
+        if(a.invMass > 0.f) axisOf(a.velocity, t) -= jt * a.invMass;
+        if(b.invMass > 0.f) axisOf(b.velocity, t) += jt * b.invMass;
+      }
+    }
+    for(uint32_t k=island.bodyBegin;k<island.bodyEnd;++k){
+      RigidBody& b = m_bodies[m_islandBodies[k]];
+      const Room& r = room[k - island.bodyBegin];
+      for(int axis=0;axis<3;++axis) axisOf(b.velocity, axis) = std::clamp(axisOf(b.velocity, axis), r.lo[axis]/dt, r.hi[axis]/dt);
+    }
+  }
+  const float groundFriction = m_config.friction * std::fabs(m_config.gravity.y) * dt;
+  for(uint32_t k=island.bodyBegin;k<island.bodyEnd;++k){
+    RigidBody& b = m_bodies[m_islandBodies[k]];
+    if(!moveThroughVoxels(m_scene, b.position, b.velocity, Vec3{} - b.halfExtents, b.halfExtents, dt)) continue;
+    // Resting on voxels: slide to a stop.
+    const float speed = std::sqrt(b.velocity.x*b.velocity.x + b.velocity.z*b.velocity.z);
+    const float keep = speed > groundFriction ? (speed - groundFriction)/speed : 0.f;
+    b.velocity.x *= keep;
+    b.velocity.z *= keep;
+  }
+}
+
+uint64_t PhysicsWorld::stateHash() const {
+  uint64_t h = 0xcbf29ce484222325ull;
+  for(const RigidBody& b : m_bodies){ hashBytes(h, b.position); hashBytes(h, b.velocity); }
+  if(m_character){ hashBytes(h, m_character->position); hashBytes(h, m_character->velocity); }
+  return h;
+}
+
+void simulateFrame(PhysicsWorld& world, FixedTimestep& timestep, double dt,
+                   const std::function<PlayerInput(uint64_t)>& input, Camera& camera){
+  const int steps = timestep.advance(dt);
+  for(int i=0;i<steps;++i) world.step(input(world.stats().steps));
+  if(const Character* player = world.character()){
+    camera.position = player->eye(timestep.alpha());
+    camera.yaw = player->yaw;
+    camera.pitch = player->pitch;
+  }
+}
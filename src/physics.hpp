@@ -0,0 +1,135 @@
+#pragma once
+#include "broadphase.hpp"
+#include "collision.hpp"
+#include "input.hpp"
+#include "math.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+class JobSystem;
+struct Camera;
+
+// Turns variable frame times into whole fixed steps. Time left over stays in
+// the accumulator and becomes the blend factor for rendering; after a long
+// stall at most maxSteps run and the rest is dropped, so a slow frame cannot
+// snowball into slower ones.
+class FixedTimestep {
+public:
+  explicit FixedTimestep(double step = 1.0/60.0, int maxSteps = 5) : m_step(step), m_maxSteps(maxSteps) {}
+  // Adds dt seconds; returns the number of steps to run now.
+  int advance(double dt);
+  // Share of a step in the accumulator (0..1): how far to blend from the
+  // previous step's state towards the current one.
+  float alpha() const { return static_cast<float>(m_accumulator / m_step); }
+  double step() const { return m_step; }
+private:
+  double m_step;
+  double m_accumulator{0.0};
+  int m_maxSteps;
+};
+
+struct PhysicsConfig {
+  float step{1.f/60.f};
+  Vec3 gravity{0.f, -24.f, 0.f};
+  int solverIterations{6};
+  float friction{0.6f};
+  // Islands handed to one job; islands never share a job with another step.
+  size_t islandsPerJob{16};
+};
+
+struct CharacterParams {
+  Vec3 halfExtents{0.3f, 0.9f, 0.3f};
+  float eyeHeight{1.6f}; // above the feet
+  float walkSpeed{5.f};
+  float jumpSpeed{8.f};
+};
+
+// Kinematic player box: moved by input and gravity, stopped by solid voxels.
+struct Character {
+  Vec3 position;  // centre of the bottom face
+  Vec3 previous;  // position at the previous step, for interpolation
+  Vec3 velocity;
+  float yaw{0.f}, pitch{0.f};
+  bool grounded{false};
+  CharacterParams params;
+
+  AABB bounds() const;
+  Vec3 eye(float alpha) const;
+};
+
+// Axis-aligned box body; invMass 0 makes it static.
+struct RigidBody {
+  Vec3 position; // centre
+  Vec3 previous;
+  Vec3 velocity;
+  Vec3 halfExtents{0.5f, 0.5f, 0.5f};
+  float invMass{1.f};
+
+  AABB bounds() const { return {position - halfExtents, position + halfExtents}; }
+};
+
+struct PhysicsStats {
+  uint64_t steps{0};
+  uint32_t islands{0};  // with at least one dynamic body
+  uint32_t contacts{0}; // body pairs whose swept boxes overlap
+  double stepMs{0.0};   // wall time of the last step
+};
+
+// Fixed-step simulation of a character and rigid boxes against a voxel scene.
+// Each step finds body pairs whose swept boxes overlap, joins them into
+// contact islands and solves the islands independently on the job system.
+// The result depends only on the initial state and the input stream, never
+// on thread count or scheduling: islands are formed and ordered by body id and
+// each is solved by exactly one job.
+class PhysicsWorld {
+public:
+  PhysicsWorld(const Scene& scene, JobSystem* jobs = nullptr, const PhysicsConfig& config = {});
+
+  uint32_t addBody(const Vec3& center, const Vec3& halfExtents, float mass);
+  const RigidBody& body(uint32_t id) const { return m_bodies[id]; }
+  size_t bodyCount() const { return m_bodies.size(); }
+  Vec3 interpolated(uint32_t id, float alpha) const;
+
+  Character& spawnCharacter(const Vec3& feet, const CharacterParams& params = {});
+  Character* character(){ return m_character ? &*m_character : nullptr; }
+  const Character* character() const { return m_character ? &*m_character : nullptr; }
+
+  void step(const PlayerInput& input = {});
+  const PhysicsStats& stats() const { return m_stats; }
+  const PhysicsConfig& config() const { return m_config; }
+  // FNV-1a over the bit patterns of every position and velocity: equal hashes
+  // after the same inputs mean a bit-exact replay.
+  uint64_t stateHash() const;
+
+private:
+  struct Island { uint32_t bodyBegin, bodyEnd, pairBegin, pairEnd; };
+  void stepCharacter(const PlayerInput& input);
+  void buildIslands();
+  void solveIsland(const Island& island);
+  uint32_t findRoot(uint32_t i);
+
+  const Scene& m_scene;
+  JobSystem* m_jobs;
+  PhysicsConfig m_config;
+  std::vector<RigidBody> m_bodies;
+  std::vector<int32_t> m_proxies;
+  AabbTree m_tree;
+  std::optional<Character> m_character;
+  // Rebuilt every step.
+  std::vector<BroadphasePair> m_pairs;
+  std::vector<uint32_t> m_parent;
+  std::vector<uint32_t> m_islandBodies;
+  std::vector<BroadphasePair> m_islandPairs;
+  std::vector<Island> m_islands;
+  PhysicsStats m_stats;
+};
+
+// One frame of simulation: runs the fixed steps dt covers, each with input(step
+// index), then puts the camera at the character's eye blended by the timestep's
+// alpha. Call it before the view goes to the renderer, so the frame draws from
+// where its own steps left the player.
+void simulateFrame(PhysicsWorld& world, FixedTimestep& timestep, double dt,
+                   const std::function<PlayerInput(uint64_t step)>& input, Camera& camera);
@@ -0,0 +1,112 @@
+#include "pipeline_cache.hpp"
+#include "bytes.hpp"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+namespace {
+using Bytes::get;
+using Bytes::put;
+using Bytes::putBytes;
+
+constexpr char MAGIC[4] = {'B', 'P', 'C', '1'};
+constexpr uint32_t FORMAT_VERSION = 1;
+// magic, format version, vendor, device, driver, 2 UUIDs, payload size, payload hash
+constexpr size_t HEADER_BYTES = 4 + 4 + 3*4 + 2*16 + 8 + 8;
+// VkPipelineCacheHeaderVersionOne: header size, version, vendor, device, cache UUID.
+constexpr size_t VK_HEADER_BYTES = 32;
+constexpr uint32_t VK_HEADER_VERSION_ONE = 1;
+
+uint64_t fnv1a(std::span<const uint8_t> data){
+  uint64_t h = 0xcbf29ce484222325ull;
+  for(const uint8_t b : data){ h ^= b; h *= 0x100000001b3ull; }
+  return h;
+}
+}
+
+namespace PipelineCacheFile {
+const char* describe(Status s){
+  switch(s){
+    case Status::Ok: return "ok";
+    case Status::Missing: return "missing";
+    case Status::Truncated: return "truncated";
+    case Status::BadMagic: return "not a pipeline cache";
+    case Status::KeyMismatch: return "different device or driver";
+    case Status::Corrupt: return "corrupt";
+  }
+  return "unknown";
+}
+
+std::vector<uint8_t> encode(const PipelineCacheKey& key, std::span<const uint8_t> data){
+  std::vector<uint8_t> out(HEADER_BYTES + data.size());
+  size_t at = 0;
+  put(out, at, MAGIC);
+  put(out, at, FORMAT_VERSION);
+  put(out, at, key.vendorID); put(out, at, key.deviceID); put(out, at, key.driverVersion);
+  put(out, at, key.deviceUUID); put(out, at, key.pipelineCacheUUID);
+  put(out, at, uint64_t{data.size()});
+  put(out, at, fnv1a(data));
+  putBytes(out, at, data);
+  return out;
+}
+
+Status decode(std::span<const uint8_t> file, const PipelineCacheKey& key, std::span<const uint8_t>& data){
+  if(file.size() < HEADER_BYTES) return Status::Truncated;
+  if(std::memcmp(file.data(), MAGIC, 4) != 0) return Status::BadMagic;
+  size_t at = 4;
+  if(get<uint32_t>(file, at) != FORMAT_VERSION) return Status::BadMagic;
+  PipelineCacheKey stored;
+  stored.vendorID = get<uint32_t>(file, at);
+  stored.deviceID = get<uint32_t>(file, at);
+  stored.driverVersion = get<uint32_t>(file, at);
+  stored.deviceUUID = get<std::array<uint8_t, 16>>(file, at);
+  stored.pipelineCacheUUID = get<std::array<uint8_t, 16>>(file, at);
+  if(stored != key) return Status::KeyMismatch;
+  const auto size = get<uint64_t>(file, at);
+  const auto hash = get<uint64_t>(file, at);
+  if(file.size() - HEADER_BYTES < size) return Status::Truncated;
+  const std::span<const uint8_t> payload = file.subspan(HEADER_BYTES, size);
+  if(fnv1a(payload) != hash) return Status::Corrupt;
+  // The driver's own header must agree too; an empty payload is a valid empty cache.
+  if(!payload.empty()){
+    if(payload.size() < VK_HEADER_BYTES) return Status::Corrupt;
+    size_t vk = 0;
+    const auto headerSize = get<uint32_t>(payload, vk);
+    const auto version = get<uint32_t>(payload, vk);
+    if(headerSize < VK_HEADER_BYTES || headerSize > payload.size() || version != VK_HEADER_VERSION_ONE) return Status::Corrupt;
+    if(get<uint32_t>(payload, vk) != key.vendorID || get<uint32_t>(payload, vk) != key.deviceID) return Status::KeyMismatch;
+    if(std::memcmp(payload.data() + vk, key.pipelineCacheUUID.data(), 16) != 0) return Status::KeyMismatch;
+  }
+  data = payload;
+  return Status::Ok;
+}
+
+Status load(const std::string& path, const PipelineCacheKey& key, std::vector<uint8_t>& data){
+  std::ifstream f(path, std::ios::binary);
+  if(!f) return Status::Missing;
+  std::vector<uint8_t> file((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+  std::span<const uint8_t> payload;
+  const Status s = decode(file, key, payload);
+  if(s == Status::Ok) data.assign(payload.begin(), payload.end());
+  return s;
+}
+
+bool save(const std::string& path, const PipelineCacheKey& key, std::span<const uint8_t> data){
+  std::error_code ec;
+  const std::filesystem::path target(path);
+  if(target.has_parent_path()) std::filesystem::create_directories(target.parent_path(), ec);
+  const std::string tmp = path + ".tmp";
+  const std::vector<uint8_t> file = encode(key, data);
+  {
+    std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+    if(!f) return false;
+    f.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+    if(!f) return false;
+  }
+  std::filesystem::rename(tmp, target, ec);
+  if(ec){ std::filesystem::remove(tmp, ec); return false; }
+  return true;
+}
+}
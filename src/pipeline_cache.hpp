@@ -0,0 +1,35 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+// Identifies the device and driver build a serialized VkPipelineCache came
+// from. Data from anything else is dropped before it reaches the driver, since
+// some drivers misbehave on foreign or damaged caches instead of ignoring them.
+struct PipelineCacheKey {
+  uint32_t vendorID{0};
+  uint32_t deviceID{0};
+  uint32_t driverVersion{0};
+  std::array<uint8_t, 16> deviceUUID{};        // VkPhysicalDeviceIDProperties; zero before Vulkan 1.1
+  std::array<uint8_t, 16> pipelineCacheUUID{}; // VkPhysicalDeviceProperties
+  bool operator==(const PipelineCacheKey&) const = default;
+};
+
+// On-disk pipeline cache: a small header (magic, format version, key, payload
+// size, FNV-1a hash of the payload) followed by the vkGetPipelineCacheData()
+// payload, whose own VkPipelineCacheHeaderVersionOne is checked against the key too.
+namespace PipelineCacheFile {
+enum class Status { Ok, Missing, Truncated, BadMagic, KeyMismatch, Corrupt };
+const char* describe(Status s);
+
+std::vector<uint8_t> encode(const PipelineCacheKey& key, std::span<const uint8_t> data);
+// On Ok, data points into file.
+Status decode(std::span<const uint8_t> file, const PipelineCacheKey& key, std::span<const uint8_t>& data);
+
+Status load(const std::string& path, const PipelineCacheKey& key, std::vector<uint8_t>& data);
+// Writes a temporary file next to path and renames it over path, so a crash
+// mid-write never leaves a truncated cache behind. Creates missing directories.
+bool save(const std::string& path, const PipelineCacheKey& key, std::span<const uint8_t> data);
+}
@@ -1,3 +1,199 @@
 #include "platform.hpp"
+#include <algorithm>
 #include <cstdlib>
-namespace Platform { std::string compositor(){ const char* w = std::getenv("XDG_SESSION_TYPE"); return w? w: "unknown"; }}
+#include <filesystem>
+#include <stdexcept>
+#include <utility>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <system_error>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+namespace Platform {
+std::string compositor(){ const char* w = std::getenv("XDG_SESSION_TYPE"); return w? w: "unknown"; }
+
+std::string cacheDirectory(){
+  namespace fs = std::filesystem;
+  if(const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) return (fs::path(xdg) / "blocco").string();
+  if(const char* local = std::getenv("LOCALAPPDATA"); local && *local) return (fs::path(local) / "blocco").string();
+  if(const char* home = std::getenv("HOME"); home && *home) return (fs::path(home) / ".cache" / "blocco").string();
+  return ".";
+}
+
+bool setEnvironment(const std::string& name, const std::string& value){
+#ifdef _WIN32
+  return _putenv_s(name.c_str(), value.c_str()) == 0;
+#else
+  return setenv(name.c_str(), value.c_str(), 1) == 0;
+#endif
+}
+
+namespace {
+[[noreturn]] void fail(const char* what, const std::string& path){
+#ifdef _WIN32
+  const std::string reason = std::system_category().message(static_cast<int>(GetLastError()));
+#else
+  const std::string reason = std::strerror(errno);
+#endif
+  throw std::runtime_error(std::string(what) + " " + path + ": " + reason);
+}
+}
+
+#ifdef _WIN32
+File::File(const std::string& path, bool truncate) : m_path(path) {
+  const std::wstring wide = std::filesystem::path(path).wstring();
+  HANDLE h = CreateFileW(wide.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                         nullptr, truncate ? CREATE_ALWAYS : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if(h == INVALID_HANDLE_VALUE) fail("Failed to open", m_path);
+  m_handle = h;
+}
+
+bool File::isOpen() const { return m_handle != nullptr; }
+
+uint64_t File::size() const {
+  LARGE_INTEGER size{};
+  if(!GetFileSizeEx(m_handle, &size)) fail("Failed to stat", m_path);
+  return static_cast<uint64_t>(size.QuadPart);
+}
+
+void File::readAt(uint64_t offset, void* data, size_t size) const {
+  auto* p = static_cast<uint8_t*>(data);
+  while(size > 0){
+    OVERLAPPED at{};
+    at.Offset = static_cast<DWORD>(offset);
+    at.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD n = 0;
+    const DWORD want = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+    if(!ReadFile(m_handle, p, want, &n, &at) || n == 0) fail("Failed to read", m_path);
+    p += n; size -= n; offset += n;
+  }
+}
+
+void File::writeAt(uint64_t offset, const void* data, size_t size){
+  const auto* p = static_cast<const uint8_t*>(data);
+  while(size > 0){
+    OVERLAPPED at{};
+    at.Offset = static_cast<DWORD>(offset);
+    at.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD n = 0;
+    const DWORD want = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+    if(!WriteFile(m_handle, p, want, &n, &at)) fail("Failed to write", m_path);
+    p += n; size -= n; offset += n;
+  }
+}
+
+void File::sync(){
+  if(!FlushFileBuffers(m_handle)) fail("Failed to flush", m_path);
+}
+
+void File::close(){
+  if(m_handle) CloseHandle(m_handle);
+  m_handle = nullptr;
+}
+
+File::File(File&& other) noexcept : m_path(std::move(other.m_path)), m_handle(std::exchange(other.m_handle, nullptr)) {}
+
+File& File::operator=(File&& other) noexcept {
+  if(this != &other){ close(); m_path = std::move(other.m_path); m_handle = std::exchange(other.m_handle, nullptr); }
+  return *this;
+}
+
+FileMapping::FileMapping(const File& file, size_t bytes){
+  if(bytes == 0) return;
+  // The view keeps the mapping object alive after its handle is closed.
+  HANDLE mapping = CreateFileMappingW(file.m_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if(!mapping) fail("Failed to map", file.path());
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, bytes);
+  CloseHandle(mapping);
+  if(!view) fail("Failed to map", file.path());
+  m_data = static_cast<const uint8_t*>(view);
+  m_size = bytes;
+}
+
+void FileMapping::reset(){
+  if(m_data) UnmapViewOfFile(m_data);
+  m_data = nullptr; m_size = 0;
+}
+#else
+File::File(const std::string& path, bool truncate) : m_path(path) {
+  m_fd = ::open(m_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : 0), 0644);
+  if(m_fd < 0) fail("Failed to open", m_path);
+}
+
+bool File::isOpen() const { return m_fd >= 0; }
+
+uint64_t File::size() const {
+  struct stat st{};
+  if(::fstat(m_fd, &st) != 0) fail("Failed to stat", m_path);
+  return static_cast<uint64_t>(st.st_size);
+}
+
+void File::readAt(uint64_t offset, void* data, size_t size) const {
+  auto* p = static_cast<uint8_t*>(data);
+  while(size > 0){
+    const ssize_t n = ::pread(m_fd, p, size, static_cast<off_t>(offset));
+    if(n <= 0){ if(n < 0 && errno == EINTR) continue; fail("Failed to read", m_path); }
+    p += n; size -= static_cast<size_t>(n); offset += static_cast<uint64_t>(n);
+  }
+}
+
+void File::writeAt(uint64_t offset, const void* data, size_t size){
+  const auto* p = static_cast<const uint8_t*>(data);
+  while(size > 0){
+    const ssize_t n = ::pwrite(m_fd, p, size, static_cast<off_t>(offset));
+    if(n < 0){ if(errno == EINTR) continue; fail("Failed to write", m_path); }
+    p += n; size -= static_cast<size_t>(n); offset += static_cast<uint64_t>(n);
+  }
+}
+
+void File::sync(){
+  if(::fsync(m_fd) != 0) fail("Failed to flush", m_path);
+}
+
+void File::close(){
+  if(m_fd >= 0) ::close(m_fd);
+  m_fd = -1;
+}
+
+File::File(File&& other) noexcept : m_path(std::move(other.m_path)), m_fd(std::exchange(other.m_fd, -1)) {}
+
+File& File::operator=(File&& other) noexcept {
+  if(this != &other){ close(); m_path = std::move(other.m_path); m_fd = std::exchange(other.m_fd, -1); }
+  return *this;
+}
+
+FileMapping::FileMapping(const File& file, size_t bytes){
+  if(bytes == 0) return;
+  void* p = ::mmap(nullptr, bytes, PROT_READ, MAP_SHARED, file.m_fd, 0);
+  if(p == MAP_FAILED) fail("Failed to map", file.path());
+  m_data = static_cast<const uint8_t*>(p);
+  m_size = bytes;
+}
+
+void FileMapping::reset(){
+  if(m_data) ::munmap(const_cast<uint8_t*>(m_data), m_size);
+  m_data = nullptr; m_size = 0;
+}
+#endif
+
+File::~File(){ close(); }
+
+FileMapping::~FileMapping(){ reset(); }
+
+FileMapping::FileMapping(FileMapping&& other) noexcept
+  : m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)) {}
+
+FileMapping& FileMapping::operator=(FileMapping&& other) noexcept {
+  if(this != &other){ reset(); m_data = std::exchange(other.m_data, nullptr); m_size = std::exchange(other.m_size, 0); }
+  return *this;
+}
+}
@@ -1,3 +1,66 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <string>
-namespace Platform { std::string compositor(); }
+namespace Platform {
+std::string compositor();
+// Per-user directory for regenerable caches (may not exist yet): $XDG_CACHE_HOME/blocco,
+// %LOCALAPPDATA%\blocco, ~/.cache/blocco, or the working directory when none is set.
+std::string cacheDirectory();
+// Sets (overwrites) an environment variable of this process; false on failure.
+bool setEnvironment(const std::string& name, const std::string& value);
+
+// A file opened for reading and writing at explicit offsets, created when
+// missing (and emptied with truncate). POSIX descriptors with pread/pwrite, or
+// Win32 handles with OVERLAPPED offsets. Failures throw std::runtime_error
+// naming the path and the system's reason.
+class File {
+public:
+  File() = default;
+  explicit File(const std::string& path, bool truncate = false);
+  ~File();
+  File(File&& other) noexcept;
+  File& operator=(File&& other) noexcept;
+  File(const File&) = delete;
+  File& operator=(const File&) = delete;
+
+  bool isOpen() const;
+  uint64_t size() const;
+  void readAt(uint64_t offset, void* data, size_t size) const;
+  void writeAt(uint64_t offset, const void* data, size_t size);
+  // Blocks until written data is on stable storage.
+  void sync();
+  void close();
+  const std::string& path() const { return m_path; }
+
+private:
+  friend class FileMapping;
+  std::string m_path;
+#ifdef _WIN32
+  void* m_handle{nullptr};
+#else
+  int m_fd{-1};
+#endif
+};
+
+// A read-only view of the first bytes of a file, shared with writers of the
+// file (later writes past its end need a new mapping). Unmapped on destruction.
+class FileMapping {
+public:
+  FileMapping() = default;
+  FileMapping(const File& file, size_t bytes);
+  ~FileMapping();
+  FileMapping(FileMapping&& other) noexcept;
+  FileMapping& operator=(FileMapping&& other) noexcept;
+  FileMapping(const FileMapping&) = delete;
+  FileMapping& operator=(const FileMapping&) = delete;
+
+  const uint8_t* data() const { return m_data; }
+  size_t size() const { return m_size; }
+  void reset();
+
+private:
+  const uint8_t* m_data{nullptr};
+  size_t m_size{0};
+};
+}
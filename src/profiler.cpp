@@ -0,0 +1,182 @@
+#include "profiler.hpp"
+#if defined(BLOCCO_PROFILER)
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Profiler {
+namespace {
+using detail::ThreadRing;
+using detail::Zone;
+
+struct Collected {
+  uint32_t tid;
+  Zone zone;
+};
+
+struct GpuZone {
+  const char* name;
+  uint64_t anchor;
+  double beginNs, endNs;
+};
+
+// Keeps a long capture from growing without bound (~64 MB of zones).
+constexpr size_t MAX_COLLECTED = size_t{1} << 21;
+
+struct State {
+  std::mutex lock; // thread registration, collection, export
+  std::vector<std::unique_ptr<ThreadRing>> rings; // never freed: threads may outlive a capture
+  std::vector<Collected> collected;
+  std::vector<GpuZone> gpu;
+  uint64_t dropped{0};
+  uint64_t ringDroppedAtReset{0}; // ring counters are written only by their owners
+  // Tick calibration: a steady_clock reading paired with now() at start().
+  uint64_t startTicks{0};
+  std::chrono::steady_clock::time_point startTime;
+};
+
+State& state(){
+  static State s;
+  return s;
+}
+
+// Caller holds the state lock.
+void drain(State& s){
+  for(auto& ring : s.rings){
+    const uint64_t head = ring->head.load(std::memory_order_acquire);
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    for(; tail < head; ++tail){
+      if(s.collected.size() < MAX_COLLECTED) s.collected.push_back({ring->tid, ring->zones[tail & (ThreadRing::CAPACITY - 1)]});
+      else ++s.dropped;
+    }
+    ring->tail.store(tail, std::memory_order_release);
+  }
+}
+
+uint64_t ringDropped(const State& s){
+  uint64_t n = 0;
+  for(const auto& ring : s.rings) n += ring->dropped.load(std::memory_order_relaxed);
+  return n;
+}
+
+void writeEscaped(std::FILE* f, const char* text){
+  for(const char* c = text; *c; ++c){
+    if(*c == '"' || *c == '\\') std::fputc('\\', f);
+    if(static_cast<unsigned char>(*c) >= 0x20) std::fputc(*c, f);
+  }
+}
+}
+
+detail::ThreadRing& detail::registerThread(){
+  State& s = state();
+  std::lock_guard lk(s.lock);
+  // Default-initialised: the zone array stays untouched until zones are recorded.
+  std::unique_ptr<ThreadRing> r{new ThreadRing};
+  r->tid = static_cast<uint32_t>(s.rings.size() + 1); // 0 is the GPU track
+  r->name = "thread " + std::to_string(r->tid);
+  ring = r.get();
+  s.rings.push_back(std::move(r));
+  return *ring;
+}
+
+void start(){
+  State& s = state();
+  {
+    std::lock_guard lk(s.lock);
+    s.startTicks = now();
+    s.startTime = std::chrono::steady_clock::now();
+  }
+  detail::recording.store(true, std::memory_order_relaxed);
+}
+
+void stop(){
+  detail::recording.store(false, std::memory_order_relaxed);
+}
+
+void setThreadName(const char* name){
+  ThreadRing& r = detail::ring ? *detail::ring : detail::registerThread();
+  std::lock_guard lk(state().lock);
+  r.name = name;
+}
+
+void gpuZone(const char* name, uint64_t anchor, double beginNs, double endNs){
+  if(!active()) return;
+  State& s = state();
+  std::lock_guard lk(s.lock);
+  if(s.gpu.size() < MAX_COLLECTED) s.gpu.push_back({name, anchor, beginNs, endNs});
+  else ++s.dropped;
+}
+
+void collect(){
+  State& s = state();
+  std::lock_guard lk(s.lock);
+  drain(s);
+}
+
+Stats stats(){
+  State& s = state();
+  std::lock_guard lk(s.lock);
+  drain(s);
+  Stats out;
+  out.zones = s.collected.size() + s.gpu.size();
+  out.dropped = s.dropped + ringDropped(s) - s.ringDroppedAtReset;
+  for(const auto& ring : s.rings) if(ring->head.load(std::memory_order_relaxed) > 0) ++out.threads;
+  return out;
+}
+
+void reset(){
+  State& s = state();
+  std::lock_guard lk(s.lock);
+  drain(s);
+  s.collected.clear();
+  s.gpu.clear();
+  s.dropped = 0;
+  s.ringDroppedAtReset = ringDropped(s);
+}
+
+bool writeChromeTrace(const std::string& path){
+  State& s = state();
+  std::lock_guard lk(s.lock);
+  drain(s);
+  // Ticks to microseconds from the start() reading pair; rdtsc needs a span of
+  // wall time to measure its rate against.
+  auto elapsed = std::chrono::steady_clock::now() - s.startTime;
+  if(elapsed < std::chrono::milliseconds(10)){
+    std::this_thread::sleep_for(std::chrono::milliseconds(10) - elapsed);
+    elapsed = std::chrono::steady_clock::now() - s.startTime;
+  }
+  const double ticks = static_cast<double>(now() - s.startTicks);
+  const double usPerTick = ticks > 0.0 ? std::chrono::duration<double, std::micro>(elapsed).count() / ticks : 0.0;
+  const uint64_t origin = s.startTicks;
+  auto us = [&](uint64_t t){ return static_cast<double>(static_cast<int64_t>(t - origin)) * usPerTick; };
+
+  std::FILE* f = std::fopen(path.c_str(), "wb");
+  if(!f) return false;
+  std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", f);
+  std::fputs("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}}", f);
+  for(const auto& ring : s.rings){
+    std::fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"", ring->tid);
+    writeEscaped(f, ring->name.c_str());
+    std::fputs("\"}}", f);
+  }
+  // Sorted by start: trace viewers nest complete events by order of appearance.
+  std::stable_sort(s.collected.begin(), s.collected.end(), [](const Collected& a, const Collected& b){ return a.zone.begin < b.zone.begin; });
+  for(const Collected& c : s.collected){
+    std::fputs(",\n{\"name\":\"", f);
+    writeEscaped(f, c.zone.name);
+    std::fprintf(f, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", c.tid, us(c.zone.begin), us(c.zone.end) - us(c.zone.begin));
+  }
+  for(const GpuZone& g : s.gpu){
+    std::fputs(",\n{\"name\":\"", f);
+    writeEscaped(f, g.name);
+    std::fprintf(f, "\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}", us(g.anchor) + g.beginNs/1000.0, (g.endNs - g.beginNs)/1000.0);
+  }
+  std::fputs("\n]}\n", f);
+  return std::fclose(f) == 0;
+}
+}
+#endif
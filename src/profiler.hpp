@@ -0,0 +1,128 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#if defined(BLOCCO_PROFILER) && (defined(__x86_64__) || defined(_M_X64))
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define BLOCCO_PROFILER_RDTSC 1
+#else
+#include <chrono>
+#endif
+
+// Hot-path profiler: BLOCCO_ZONE("name") records the enclosing scope as a zone
+// into a lock-free ring owned by the calling thread (one producer, drained by
+// collect()), timestamped with rdtsc on x86-64 and steady_clock elsewhere.
+// Zones are kept only between start() and stop(); recording one costs two
+// timestamp reads and a few stores, and a full ring drops zones rather than
+// blocking. The renderer adds GPU zones from timestamp queries.
+// Names must be string literals (or otherwise outlive the export).
+//
+// Building with BLOCCO_ENABLE_PROFILER=OFF leaves BLOCCO_PROFILER undefined:
+// zones expand to nothing and every function below is an empty inline.
+namespace Profiler {
+struct Stats {
+  uint64_t zones{0};   // collected CPU and GPU zones
+  uint64_t dropped{0}; // lost to full rings or the collection cap
+  uint32_t threads{0}; // threads that recorded at least one zone
+};
+
+#if defined(BLOCCO_PROFILER)
+inline constexpr bool ENABLED = true;
+
+namespace detail {
+inline std::atomic<bool> recording{false};
+
+struct Zone {
+  const char* name;
+  uint64_t begin, end;
+};
+
+// Single-producer ring: the owning thread advances head, collect() advances tail.
+struct ThreadRing {
+  static constexpr uint64_t CAPACITY = uint64_t{1} << 15;
+  Zone zones[CAPACITY];
+  alignas(64) std::atomic<uint64_t> head{0};
+  alignas(64) std::atomic<uint64_t> tail{0};
+  std::atomic<uint64_t> dropped{0};
+  uint32_t tid{0};
+  std::string name;
+};
+
+inline thread_local ThreadRing* ring = nullptr;
+// Creates and registers the calling thread's ring.
+ThreadRing& registerThread();
+}
+
+inline uint64_t now(){
+#if defined(BLOCCO_PROFILER_RDTSC)
+  return __rdtsc();
+#else
+  return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+void start();
+void stop();
+inline bool active(){ return detail::recording.load(std::memory_order_relaxed); }
+// Appends a zone for the calling thread; begin and end come from now().
+inline void record(const char* name, uint64_t begin, uint64_t end){
+  detail::ThreadRing& r = detail::ring ? *detail::ring : detail::registerThread();
+  const uint64_t head = r.head.load(std::memory_order_relaxed);
+  if(head - r.tail.load(std::memory_order_acquire) >= detail::ThreadRing::CAPACITY){
+    r.dropped.store(r.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); // owner-only counter: no RMW
+    return;
+  }
+  r.zones[head & (detail::ThreadRing::CAPACITY - 1)] = {name, begin, end};
+  r.head.store(head + 1, std::memory_order_release);
+}
+// Label for the calling thread's track in the trace.
+void setThreadName(const char* name);
+// A GPU zone placed on its own track: offsets in nanoseconds from the CPU
+// moment anchor (a now() value) at which the work was submitted.
+void gpuZone(const char* name, uint64_t anchor, double beginNs, double endNs);
+// Moves zones out of the per-thread rings; call about once a frame so they
+// never fill. Cheap when nothing is recorded.
+void collect();
+Stats stats();
+// Everything collected since start() as Chrome trace event JSON (chrome://tracing,
+// Perfetto). Returns false when the file cannot be written.
+bool writeChromeTrace(const std::string& path);
+// Drops collected zones.
+void reset();
+
+class ScopedZone {
+public:
+  explicit ScopedZone(const char* name) : m_name(name), m_begin(active() ? now() : 0) {}
+  ~ScopedZone(){ if(m_begin) record(m_name, m_begin, now()); }
+  ScopedZone(const ScopedZone&) = delete;
+  ScopedZone& operator=(const ScopedZone&) = delete;
+private:
+  const char* m_name;
+  uint64_t m_begin;
+};
+
+#define BLOCCO_ZONE_CAT2(a, b) a##b
+#define BLOCCO_ZONE_CAT(a, b) BLOCCO_ZONE_CAT2(a, b)
+#define BLOCCO_ZONE(name) const ::Profiler::ScopedZone BLOCCO_ZONE_CAT(bloccoZone, __LINE__){name}
+#else
+inline constexpr bool ENABLED = false;
+
+inline uint64_t now(){ return 0; }
+inline void start(){}
+inline void stop(){}
+inline bool active(){ return false; }
+inline void record(const char*, uint64_t, uint64_t){}
+inline void setThreadName(const char*){}
+inline void gpuZone(const char*, uint64_t, double, double){}
+inline void collect(){}
+inline Stats stats(){ return {}; }
+inline bool writeChromeTrace(const std::string&){ return false; }
+inline void reset(){}
+#define BLOCCO_ZONE(name) static_cast<void>(0)
+#endif
+}
@@ -0,0 +1,240 @@
+#include "region.hpp"
+#include "lz4.hpp"
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+
+namespace {
+constexpr char MAGIC[4] = {'B', 'R', 'G', '1'};
+constexpr uint32_t FORMAT_VERSION = 1;
+constexpr size_t PREFIX_BYTES = 16; // magic, version, slot count, reserved
+constexpr size_t ENTRY_BYTES = 24;
+constexpr size_t HEADER_BYTES = PREFIX_BYTES + Region::CHUNKS * ENTRY_BYTES;
+constexpr size_t MAX_RAW = 4 + Chunk::VOLUME * sizeof(BlockId); // direct ids, no palette: the largest layout
+
+uint64_t recordHash(std::span<const uint8_t> data){
+  uint64_t h = 0xcbf29ce484222325ull ^ data.size();
+  size_t i = 0;
+  for(; i + 8 <= data.size(); i += 8){
+    uint64_t w;
+    std::memcpy(&w, data.data() + i, 8);
+    h = (h ^ w) * 0x9e3779b97f4a7c15ull;
+    h ^= h >> 32;
+  }
+  for(; i < data.size(); ++i) h = (h ^ data[i]) * 0x100000001b3ull;
+  return h;
+}
+}
+
+RegionFile::RegionFile(std::string path) : m_path(std::move(path)) { open(); }
+
+RegionFile::~RegionFile(){ close(); }
+
+void RegionFile::open(){
+  m_file = Platform::File(m_path);
+  m_fileSize = static_cast<size_t>(m_file.size());
+  m_table = {};
+  m_live = 0;
+  if(m_fileSize == 0){
+    // New file: prefix and an empty table.
+    std::vector<uint8_t> header(HEADER_BYTES, 0);
+    const uint32_t prefix[3] = {FORMAT_VERSION, Region::CHUNKS, 0};
+    std::memcpy(header.data(), MAGIC, 4);
+    std::memcpy(header.data() + 4, prefix, sizeof(prefix));
+    m_file.writeAt(0, header.data(), header.size());
+    m_fileSize = HEADER_BYTES;
+    return;
+  }
+  std::vector<uint8_t> header(HEADER_BYTES);
+  if(m_fileSize < HEADER_BYTES){ close(); throw std::runtime_error("Truncated region file " + m_path); }
+  m_file.readAt(0, header.data(), header.size());
+  uint32_t prefix[3];
+  std::memcpy(prefix, header.data() + 4, sizeof(prefix));
+  if(std::memcmp(header.data(), MAGIC, 4) != 0 || prefix[0] != FORMAT_VERSION || prefix[1] != Region::CHUNKS){
+    close();
+    throw std::runtime_error("Not a region file: " + m_path);
+  }
+  for(int i=0;i<Region::CHUNKS;++i){
+    Entry e;
+    const uint8_t* p = header.data() + PREFIX_BYTES + static_cast<size_t>(i)*ENTRY_BYTES;
+    std::memcpy(&e.offset, p, 8); std::memcpy(&e.size, p + 8, 4); std::memcpy(&e.rawSize, p + 12, 4); std::memcpy(&e.hash, p + 16, 8);
+    // A record cut short by a crash, or an entry that is plain garbage: treat the slot as empty.
+    if(e.offset < HEADER_BYTES || e.offset > m_fileSize || e.size > m_fileSize - e.offset || e.rawSize > MAX_RAW || e.size > e.rawSize || e.size == 0) continue;
+    m_table[static_cast<size_t>(i)] = e;
+    m_live += e.size;
+  }
+}
+
+void RegionFile::close(){
+  m_map.reset();
+  m_file.close();
+}
+
+// Caller holds the lock exclusively.
+void RegionFile::remap() const {
+  m_map.reset();
+  m_map = Platform::FileMapping(m_file, m_fileSize);
+}
+
+void RegionFile::writeEntry(int slot){
+  const Entry& e = m_table[static_cast<size_t>(slot)];
+  uint8_t bytes[ENTRY_BYTES];
+  std::memcpy(bytes, &e.offset, 8); std::memcpy(bytes + 8, &e.size, 4); std::memcpy(bytes + 12, &e.rawSize, 4); std::memcpy(bytes + 16, &e.hash, 8);
+  m_file.writeAt(PREFIX_BYTES + static_cast<size_t>(slot)*ENTRY_BYTES, bytes, ENTRY_BYTES);
+}
+
+bool RegionFile::contains(int slot) const {
+  std::shared_lock lk(m_lock);
+  return m_table[static_cast<size_t>(slot)].offset != 0;
+}
+
+size_t RegionFile::fileBytes() const {
+  std::shared_lock lk(m_lock);
+  return m_fileSize;
+}
+
+size_t RegionFile::deadBytes() const {
+  std::shared_lock lk(m_lock);
+  return m_fileSize - HEADER_BYTES - m_live;
+}
+
+bool RegionFile::read(int slot, Chunk& out) const {
+  std::shared_lock lk(m_lock);
+  Entry e = m_table[static_cast<size_t>(slot)];
+  if(!e.offset) return false;
+  if(e.offset + e.size > m_map.size()){
+    // Appended since the last mapping: remap once, under the exclusive lock.
+    lk.unlock();
+    {
+      std::unique_lock ex(m_lock);
+      if(m_fileSize > m_map.size()) remap();
+    }
+    lk.lock();
+    e = m_table[static_cast<size_t>(slot)];
+    if(!e.offset || e.offset + e.size > m_map.size()) return false;
+  }
+  const std::span<const uint8_t> stored(m_map.data() + e.offset, e.size);
+  if(recordHash(stored) != e.hash) return false;
+  if(e.size == e.rawSize) return out.deserialize(stored);
+  thread_local std::vector<uint8_t> raw;
+  raw.resize(e.rawSize);
+  return Lz4::decompress(stored, raw) && out.deserialize(raw);
+}
+
+void RegionFile::write(int slot, const Chunk& chunk, bool compress){
+  std::unique_lock lk(m_lock);
+  m_raw.clear();
+  chunk.serialize(m_raw);
+  std::span<const uint8_t> stored = m_raw;
+  if(compress){
+    m_packed.resize(Lz4::compressBound(m_raw.size()));
+    const size_t packed = Lz4::compress(m_raw, m_packed);
+    if(packed > 0 && packed < m_raw.size()) stored = std::span<const uint8_t>(m_packed.data(), packed);
+  }
+  // Record first, then the entry: a crash in between leaves the old record in place.
+  Entry& e = m_table[static_cast<size_t>(slot)];
+  const uint64_t offset = m_fileSize;
+  m_file.writeAt(offset, stored.data(), stored.size());
+  m_fileSize += stored.size();
+  m_live += stored.size() - e.size;
+  e = {offset, static_cast<uint32_t>(stored.size()), static_cast<uint32_t>(m_raw.size()), recordHash(stored)};
+  writeEntry(slot);
+}
+
+void RegionFile::erase(int slot){
+  std::unique_lock lk(m_lock);
+  Entry& e = m_table[static_cast<size_t>(slot)];
+  if(!e.offset) return;
+  m_live -= e.size;
+  e = {};
+  writeEntry(slot);
+}
+
+void RegionFile::compact(){
+  std::unique_lock lk(m_lock);
+  if(m_fileSize > m_map.size()) remap();
+  const std::string tmp = m_path + ".tmp";
+  std::array<uint8_t, HEADER_BYTES> header{};
+  const uint32_t prefix[3] = {FORMAT_VERSION, Region::CHUNKS, 0};
+  std::memcpy(header.data(), MAGIC, 4);
+  std::memcpy(header.data() + 4, prefix, sizeof(prefix));
+  // Live records in slot order, so neighbouring chunks end up next to each other.
+  std::vector<uint8_t> records;
+  records.reserve(m_live);
+  for(int i=0;i<Region::CHUNKS;++i){
+    Entry e = m_table[static_cast<size_t>(i)];
+    if(!e.offset) continue;
+    const uint8_t* record = m_map.data() + e.offset;
+    e.offset = HEADER_BYTES + records.size();
+    records.insert(records.end(), record, record + e.size);
+    uint8_t* p = header.data() + PREFIX_BYTES + static_cast<size_t>(i)*ENTRY_BYTES;
+    std::memcpy(p, &e.offset, 8); std::memcpy(p + 8, &e.size, 4); std::memcpy(p + 12, &e.rawSize, 4); std::memcpy(p + 16, &e.hash, 8);
+  }
+  {
+    Platform::File out(tmp, true);
+    out.writeAt(0, header.data(), header.size());
+    if(!records.empty()) out.writeAt(HEADER_BYTES, records.data(), records.size());
+    out.sync();
+  }
+  // Closed first: Windows cannot rename over a file that is open or mapped.
+  close();
+  std::error_code renamed;
+  std::filesystem::rename(tmp, m_path, renamed);
+  if(renamed){
+    std::error_code removed;
+    std::filesystem::remove(tmp, removed);
+    // Keep serving the uncompacted file if it is still there, but report the
+    // failed rename either way.
+    try { open(); } catch(const std::runtime_error&){}
+    throw std::runtime_error("Failed to replace " + m_path + " while compacting: " + renamed.message());
+  }
+  open();
+}
+
+RegionStore::RegionStore(std::string directory, const RegionOptions& options)
+  : m_directory(std::move(directory)), m_options(options) {}
+
+RegionStore::~RegionStore() = default;
+
+RegionFile* RegionStore::region(const ChunkCoord& r, bool create){
+  std::lock_guard lk(m_lock);
+  auto it = m_regions.find(r);
+  if(it != m_regions.end() && (it->second || !create)) return it->second.get();
+  const std::string path = m_directory + "/r." + std::to_string(r.x) + "." + std::to_string(r.y) + "." + std::to_string(r.z) + ".bcr";
+  std::unique_ptr<RegionFile> file;
+  if(create){
+    std::error_code ec;
+    std::filesystem::create_directories(m_directory, ec);
+    file = std::make_unique<RegionFile>(path);
+  } else if(std::filesystem::exists(path)){
+    file = std::make_unique<RegionFile>(path);
+  }
+  RegionFile* p = file.get();
+  m_regions[r] = std::move(file);
+  return p;
+}
+
+bool RegionStore::load(const ChunkCoord& c, Chunk& out){
+  const RegionFile* file = region(Region::of(c), false);
+  return file && file->read(Region::slot(c), out);
+}
+
+void RegionStore::save(const ChunkCoord& c, const Chunk& chunk){
+  RegionFile* file = region(Region::of(c), true);
+  file->write(Region::slot(c), chunk, m_options.compress);
+  const size_t bytes = file->fileBytes();
+  if(bytes >= m_options.compactMinBytes && static_cast<double>(file->deadBytes()) > m_options.compactRatio * static_cast<double>(bytes)) file->compact();
+}
+
+size_t RegionStore::save(const Scene& scene){
+  for(const auto& [c, chunk] : scene.chunks()) save(c, chunk);
+  return scene.chunkCount();
+}
+
+size_t RegionStore::fileBytes(){
+  std::lock_guard lk(m_lock);
+  size_t total = 0;
+  for(const auto& [r, file] : m_regions) if(file) total += file->fileBytes();
+  return total;
+}
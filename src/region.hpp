@@ -0,0 +1,104 @@
+#pragma once
+#include "platform.hpp"
+#include "scene.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Worlds are saved as region files of 8x8x8 chunks each.
+namespace Region {
+constexpr int SHIFT = 3;
+constexpr int SIZE = 1 << SHIFT;
+constexpr int CHUNKS = SIZE * SIZE * SIZE;
+inline ChunkCoord of(const ChunkCoord& c){ return {c.x >> SHIFT, c.y >> SHIFT, c.z >> SHIFT}; }
+inline int slot(const ChunkCoord& c){ return ((c.y & (SIZE-1)) << (2*SHIFT)) | ((c.z & (SIZE-1)) << SHIFT) | (c.x & (SIZE-1)); }
+}
+
+struct RegionOptions {
+  bool compress{true};      // LZ4 per chunk, kept only when it is smaller
+  double compactRatio{0.5}; // rewrite a region once this share of its file is dead records
+  size_t compactMinBytes{size_t{1} << 20}; // smaller files are never compacted
+};
+
+// One region file: a header with an offset table of Region::CHUNKS entries
+// (offset, stored size, raw size, hash), then chunk records (Chunk::serialize()
+// output, possibly LZ4-compressed) appended in write order. Rewriting a chunk
+// appends a new record and repoints its entry; the old record stays as dead
+// space until compact() rewrites the file with live records only.
+//
+// Reads go through a read-only mapping of the file: stored records deserialize
+// straight from it and compressed ones decompress from it, with no read()
+// buffer in between. Any number of threads may read while one writes.
+class RegionFile {
+public:
+  // Throws std::runtime_error when the file cannot be opened or created, or is
+  // not a region file. Table entries pointing outside the file are dropped.
+  explicit RegionFile(std::string path);
+  ~RegionFile();
+  RegionFile(const RegionFile&) = delete;
+  RegionFile& operator=(const RegionFile&) = delete;
+
+  bool contains(int slot) const;
+  // False when the slot is empty or its record fails the hash or layout checks.
+  bool read(int slot, Chunk& out) const;
+  void write(int slot, const Chunk& chunk, bool compress = true);
+  void erase(int slot);
+  // Rewrites the file with live records only (temporary file, then rename).
+  // Throws std::runtime_error when the file cannot be replaced.
+  void compact();
+
+  size_t fileBytes() const;
+  size_t deadBytes() const;
+  const std::string& path() const { return m_path; }
+
+private:
+  struct Entry {
+    uint64_t offset{0}; // 0: empty slot
+    uint32_t size{0};   // stored bytes
+    uint32_t rawSize{0}; // serialized bytes; equal to size when stored uncompressed
+    uint64_t hash{0};   // of the stored bytes
+  };
+  void open();
+  void close();
+  void remap() const;
+  void writeEntry(int slot);
+
+  std::string m_path;
+  Platform::File m_file;
+  mutable Platform::FileMapping m_map;
+  size_t m_fileSize{0};
+  size_t m_live{0}; // stored bytes of live records
+  std::array<Entry, Region::CHUNKS> m_table{};
+  std::vector<uint8_t> m_raw, m_packed; // write scratch
+  mutable std::shared_mutex m_lock;
+};
+
+// A directory of region files, opened on first use and kept open. load() may
+// run on any thread; save() compacts a region once its dead space crosses the
+// configured share.
+class RegionStore {
+public:
+  explicit RegionStore(std::string directory, const RegionOptions& options = {});
+  ~RegionStore();
+
+  bool load(const ChunkCoord& c, Chunk& out);
+  void save(const ChunkCoord& c, const Chunk& chunk);
+  // Saves every chunk of the scene; returns the number saved.
+  size_t save(const Scene& scene);
+  size_t fileBytes();
+
+private:
+  RegionFile* region(const ChunkCoord& r, bool create);
+
+  std::string m_directory;
+  RegionOptions m_options;
+  std::mutex m_lock;
+  // Null for regions known to have no file yet.
+  std::unordered_map<ChunkCoord, std::unique_ptr<RegionFile>, ChunkCoordHash> m_regions;
+};
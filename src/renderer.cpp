@@ -1,25 +1,54 @@
 #include "renderer.hpp"
 #include "vk_utils.hpp"
+#include "font.hpp"
+#include "jobs.hpp"
+#include "labels.hpp"
+#include "logging.hpp"
+#include "mesher.hpp"
+#include "platform.hpp"
+#include "profiler.hpp"
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wold-style-cast"
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_vulkan.h>
 #pragma GCC diagnostic pop
-#include <iostream>
 #include <stdexcept>
 #include <vector>
 #include <set>
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <thread>
+#include <utility>
 
-Renderer::Renderer(bool headless):m_headless(headless){
+Renderer::Renderer(bool headless, const Config& config, JobSystem* jobs)
+  :m_headless(headless),
+   m_framesInFlight(std::clamp(config.framesInFlight, 1u, MAX_FRAMES_IN_FLIGHT)),
+   m_presentModePreference(config.presentMode),
+   m_presentWaitRequested(config.presentWait){
+  m_initStart = std::chrono::steady_clock::now();
+  m_pipelineCachePath = pipelineCachePath(config);
+  m_asyncUploadsRequested = config.asyncUploads;
+  m_vertexFormat = config.packedVertices ? VertexFormat::Packed : VertexFormat::Float;
+  m_vertexPulling = config.packedVertices && config.vertexPulling;
   m_validationEnabled = !m_headless; // skip validation in pure headless for now
-  if(!m_headless){ initWindow(); initVulkan(); }
-  std::cout << "Renderer init (headless=" << m_headless << ")" << std::endl;
+  m_jobs = jobs; // for createPipelines(); setJobSystem() below adds the recording pools
+  m_drawList.setBackToFront(static_cast<uint32_t>(Pipeline::Translucent), true);
+  if(!m_headless){ initWindow(); }
+  try { initVulkan(); }
+  catch(...){ finishPipelines(); throw; } // background compiles must not outlive the constructor
+  if(jobs) setJobSystem(jobs);
+  m_startup.initMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-m_initStart).count();
+  Log::info("Renderer init (headless={})", m_headless);
 }
 Renderer::~Renderer(){
   cleanup();
-  std::cout << "Renderer shutdown" << std::endl;
+  Log::info("Renderer shutdown");
 }
 
 void Renderer::initWindow(){
@@ -34,12 +63,15 @@ void Renderer::initWindow(){
 }
 
 void Renderer::initVulkan(){
-  uint32_t extCount = 0;
-  const char* const* extNames = SDL_Vulkan_GetInstanceExtensions(&extCount);
-  if(!extNames || extCount==0){
-    throw std::runtime_error("SDL_Vulkan_GetInstanceExtensions failed");
+  std::vector<const char*> extensions;
+  if(!m_headless){
+    uint32_t extCount = 0;
+    const char* const* extNames = SDL_Vulkan_GetInstanceExtensions(&extCount);
+    if(!extNames || extCount==0){
+      throw std::runtime_error("SDL_Vulkan_GetInstanceExtensions failed");
+    }
+    extensions.assign(extNames, extNames + extCount);
   }
-  std::vector<const char*> extensions(extNames, extNames + extCount);
   // Add debug utils if validation
   if(m_validationEnabled){
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -52,13 +84,22 @@ void Renderer::initVulkan(){
   createSurface();
   pickPhysicalDevice();
   createLogicalDevice();
+  createPipelineCache();
+  createAllocators();
   createSwapchain();
   createImageViews();
+  createOffscreenTarget();
+  createCulling();
+  createDepthTarget();
   createRenderPass();
   createFramebuffers();
+  createDescriptors();
+  createPipelines();
+  createText();
   createCommandPool();
   createCommandBuffers();
   createSyncObjects();
+  createTimestampQueries();
 }
 
 void Renderer::createSurface(){
@@ -69,9 +110,44 @@ void Renderer::createSurface(){
 }
 
 void Renderer::cleanup(){
-  if(!m_headless){
+  finishPipelines();
+  if(m_device){
     vkDeviceWaitIdle(m_device);
   }
+  destroyRetired(true);
+  if(m_timestampPool){ vkDestroyQueryPool(m_device, m_timestampPool, nullptr); m_timestampPool = VK_NULL_HANDLE; }
+  for(auto& b : m_readback) m_allocator->destroyBuffer(b);
+  m_readback.clear();
+  if(m_offscreenView){ vkDestroyImageView(m_device, m_offscreenView, nullptr); m_offscreenView = VK_NULL_HANDLE; }
+  if(m_offscreenImage){ vkDestroyImage(m_device, m_offscreenImage, nullptr); m_offscreenImage = VK_NULL_HANDLE; }
+  if(m_allocator) m_allocator->free(m_offscreenMemory);
+  if(m_depthView){ vkDestroyImageView(m_device, m_depthView, nullptr); m_depthView = VK_NULL_HANDLE; }
+  if(m_depthImage){ vkDestroyImage(m_device, m_depthImage, nullptr); m_depthImage = VK_NULL_HANDLE; }
+  if(m_allocator) m_allocator->free(m_depthMemory);
+  if(m_allocator) destroyDepthPyramid(m_pyramid);
+  for(auto& slot : m_cullSlots){ m_allocator->destroyBuffer(slot.commands); m_allocator->destroyBuffer(slot.counts); }
+  m_cullSlots.clear();
+  if(m_cullPipeline){ vkDestroyPipeline(m_device, m_cullPipeline, nullptr); m_cullPipeline = VK_NULL_HANDLE; }
+  if(m_pyramidPipeline){ vkDestroyPipeline(m_device, m_pyramidPipeline, nullptr); m_pyramidPipeline = VK_NULL_HANDLE; }
+  if(m_cullPipelineLayout){ vkDestroyPipelineLayout(m_device, m_cullPipelineLayout, nullptr); m_cullPipelineLayout = VK_NULL_HANDLE; }
+  if(m_pyramidPipelineLayout){ vkDestroyPipelineLayout(m_device, m_pyramidPipelineLayout, nullptr); m_pyramidPipelineLayout = VK_NULL_HANDLE; }
+  if(m_cullDescriptorPool){ vkDestroyDescriptorPool(m_device, m_cullDescriptorPool, nullptr); m_cullDescriptorPool = VK_NULL_HANDLE; }
+  if(m_cullSetLayout){ vkDestroyDescriptorSetLayout(m_device, m_cullSetLayout, nullptr); m_cullSetLayout = VK_NULL_HANDLE; }
+  if(m_pyramidSetLayout){ vkDestroyDescriptorSetLayout(m_device, m_pyramidSetLayout, nullptr); m_pyramidSetLayout = VK_NULL_HANDLE; }
+  if(m_pyramidSampler){ vkDestroySampler(m_device, m_pyramidSampler, nullptr); m_pyramidSampler = VK_NULL_HANDLE; }
+  for(auto& p : m_pipelines){ if(VkPipeline v = p.exchange(VK_NULL_HANDLE)) vkDestroyPipeline(m_device, v, nullptr); }
+  if(m_textPipeline){ vkDestroyPipeline(m_device, m_textPipeline, nullptr); m_textPipeline = VK_NULL_HANDLE; }
+  savePipelineCache();
+  if(m_textPipelineLayout){ vkDestroyPipelineLayout(m_device, m_textPipelineLayout, nullptr); m_textPipelineLayout = VK_NULL_HANDLE; }
+  if(m_textDescriptorPool){ vkDestroyDescriptorPool(m_device, m_textDescriptorPool, nullptr); m_textDescriptorPool = VK_NULL_HANDLE; }
+  if(m_textSetLayout){ vkDestroyDescriptorSetLayout(m_device, m_textSetLayout, nullptr); m_textSetLayout = VK_NULL_HANDLE; }
+  if(m_atlasSampler){ vkDestroySampler(m_device, m_atlasSampler, nullptr); m_atlasSampler = VK_NULL_HANDLE; }
+  if(m_atlasView){ vkDestroyImageView(m_device, m_atlasView, nullptr); m_atlasView = VK_NULL_HANDLE; }
+  if(m_atlasImage){ vkDestroyImage(m_device, m_atlasImage, nullptr); m_atlasImage = VK_NULL_HANDLE; }
+  if(m_allocator) m_allocator->free(m_atlasMemory);
+  if(m_pipelineLayout){ vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr); m_pipelineLayout = VK_NULL_HANDLE; }
+  if(m_descriptorPool){ vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr); m_descriptorPool = VK_NULL_HANDLE; }
+  if(m_descriptorSetLayout){ vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr); m_descriptorSetLayout = VK_NULL_HANDLE; }
   for(auto fb: m_framebuffers){ if(fb) vkDestroyFramebuffer(m_device, fb, nullptr); }
   m_framebuffers.clear();
   if(m_renderPass){ vkDestroyRenderPass(m_device, m_renderPass, nullptr); m_renderPass = VK_NULL_HANDLE; }
@@ -79,8 +155,15 @@ void Renderer::cleanup(){
   for(auto s: m_renderFinished){ if(s) vkDestroySemaphore(m_device, s, nullptr); }
   for(auto f: m_inFlightFences){ if(f) vkDestroyFence(m_device, f, nullptr); }
   m_imageAvailable.clear(); m_renderFinished.clear(); m_inFlightFences.clear();
+  destroyRecordPools();
   if(m_commandPool){ vkDestroyCommandPool(m_device, m_commandPool, nullptr); m_commandPool = VK_NULL_HANDLE; }
   cleanupSwapchain();
+  m_retiredMeshes.clear();
+  m_uploads.reset();
+  if(m_allocator) m_allocator->destroyBuffer(m_quadIndices);
+  m_meshPool.reset();
+  m_frameRing.reset();
+  m_allocator.reset();
   if(m_device){ vkDestroyDevice(m_device, nullptr); m_device = VK_NULL_HANDLE; }
   if(m_surface){ vkDestroySurfaceKHR(m_instance, m_surface, nullptr); m_surface = VK_NULL_HANDLE; }
   if(m_debugMessenger){ vkutils::destroyDebugMessenger(m_instance, m_debugMessenger); m_debugMessenger = VK_NULL_HANDLE; }
@@ -89,45 +172,293 @@ void Renderer::cleanup(){
   if(!m_headless){ SDL_Quit(); }
 }
 
-void Renderer::drawFrame(){
-  if(m_headless){ ++m_frameIndex; return; }
+void Renderer::beginFrame(){
+  if(m_frameBegun) return;
+  BLOCCO_ZONE("begin frame");
   vkWaitForFences(m_device, 1, &m_inFlightFences[m_currentFrame], VK_TRUE, UINT64_MAX);
+#ifdef VK_KHR_present_wait
+  // Keep at most framesInFlight-1 presents queued: with one frame in flight input is
+  // sampled only once the previous frame is on screen.
+  if(m_presentWaitEnabled && m_presentId >= m_framesInFlight){
+    const uint64_t target = m_presentId - (m_framesInFlight - 1);
+    if(target > m_presentWaited && target >= m_swapchainFirstPresentId){
+      const VkResult r = m_waitForPresent(m_device, m_swapchain, target, 100'000'000); // 100 ms guard against stalls
+      if(r == VK_SUCCESS){
+        recordLatency(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_inputTimes[target % m_inputTimes.size()]).count());
+      }
+      m_presentWaited = target;
+    }
+  }
+#endif
+  m_cpuStart = std::chrono::steady_clock::now();
+  if(m_uploads){
+    // Batches that have landed are acquired by this frame's command buffer, so
+    // their meshes draw from now on and retired ones count from this frame.
+    const uint64_t acquired = m_uploads->completed();
+    for(RetiredMesh& r : m_retiredMeshes) if(r.upload > m_uploadsAcquired && r.upload <= acquired) r.lastFrame = m_frameIndex;
+    m_uploadsAcquired = acquired;
+  }
+  m_frameRing->beginFrame(m_currentFrame);
+  deliverReadback(m_currentFrame);
+  collectCullStats(m_currentFrame);
+  collectTimings(m_currentFrame);
+  destroyRetired(false);
+  m_textGlyphs = 0;
+  m_textMs = 0.0;
+  m_frameBegun = true;
+}
+
+void Renderer::drawFrame(){
+  beginFrame();
+  BLOCCO_ZONE("draw frame");
+  m_frameBegun = false;
+  // Copies queued since the last frame go out now and overlap its rendering.
+  m_uploadBytes = std::exchange(m_pendingUploadBytes, 0);
+  if(m_uploads) m_uploads->flush();
+  if(m_headless){ drawOffscreen(); return; }
+  // Frames skipped below drop their draws; the caller resubmits every frame.
+  if(m_resizePending && !recreateSwapchain()){ m_drawList.clear(); m_textRuns.clear(); m_cpuCulled = 0; return; }
   uint32_t imageIndex;
   VkResult acq = vkAcquireNextImageKHR(m_device, m_swapchain, UINT64_MAX, m_imageAvailable[m_currentFrame], VK_NULL_HANDLE, &imageIndex);
-  if(acq == VK_ERROR_OUT_OF_DATE_KHR){ /* TODO: recreate swapchain */ return; }
+  if(acq == VK_ERROR_OUT_OF_DATE_KHR){
+    // Nothing was signalled or submitted; the slot's fence stays signalled for the retry.
+    if(!recreateSwapchain()){ m_drawList.clear(); m_textRuns.clear(); m_cpuCulled = 0; return; }
+    acq = vkAcquireNextImageKHR(m_device, m_swapchain, UINT64_MAX, m_imageAvailable[m_currentFrame], VK_NULL_HANDLE, &imageIndex);
+    if(acq == VK_ERROR_OUT_OF_DATE_KHR){ m_resizePending = true; m_drawList.clear(); m_textRuns.clear(); m_cpuCulled = 0; return; }
+  }
   if(acq != VK_SUCCESS && acq != VK_SUBOPTIMAL_KHR){ throw std::runtime_error("Failed to acquire swapchain image"); }
   if(m_imagesInFlight[imageIndex]){
     vkWaitForFences(m_device, 1, &m_imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
   }
   m_imagesInFlight[imageIndex] = m_inFlightFences[m_currentFrame];
-  // Record command buffer for this image
+  VkCommandBuffer cmd = m_commandBuffers[m_currentFrame];
   vkResetFences(m_device, 1, &m_inFlightFences[m_currentFrame]);
-  vkResetCommandBuffer(m_commandBuffers[imageIndex], 0);
-  recordCommandBuffer(m_commandBuffers[imageIndex], imageIndex);
-  VkSemaphore waitSemaphores[] = { m_imageAvailable[m_currentFrame] };
-  VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+  vkResetCommandBuffer(cmd, 0);
+  recordCommandBuffer(cmd, imageIndex);
+  // The upload wait is on batches that have already landed; it orders their release before the acquire.
+  VkSemaphore waitSemaphores[] = { m_imageAvailable[m_currentFrame], m_uploads ? m_uploads->semaphore() : VK_NULL_HANDLE };
+  VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, MESH_READ_STAGES };
+  const uint64_t waitValues[] = { 0, m_uploadsAcquired };
   VkSemaphore signalSemaphores[] = { m_renderFinished[m_currentFrame] };
+  VkTimelineSemaphoreSubmitInfo timeline{}; timeline.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timeline.waitSemaphoreValueCount = 2; timeline.pWaitSemaphoreValues = waitValues;
   VkSubmitInfo submit{}; submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submit.waitSemaphoreCount = 1; submit.pWaitSemaphores = waitSemaphores; submit.pWaitDstStageMask = waitStages;
-  submit.commandBufferCount = 1; submit.pCommandBuffers = &m_commandBuffers[imageIndex];
+  if(m_uploads) submit.pNext = &timeline;
+  submit.waitSemaphoreCount = m_uploads ? 2u : 1u; submit.pWaitSemaphores = waitSemaphores; submit.pWaitDstStageMask = waitStages;
+  submit.commandBufferCount = 1; submit.pCommandBuffers = &cmd;
   submit.signalSemaphoreCount = 1; submit.pSignalSemaphores = signalSemaphores;
-  if(vkQueueSubmit(m_graphicsQueue, 1, &submit, m_inFlightFences[m_currentFrame]) != VK_SUCCESS){ throw std::runtime_error("Failed to submit draw"); }
+  {
+    BLOCCO_ZONE("submit");
+    m_slotSubmitTicks[m_currentFrame] = Profiler::now();
+    if(vkQueueSubmit(m_graphicsQueue, 1, &submit, m_inFlightFences[m_currentFrame]) != VK_SUCCESS){ throw std::runtime_error("Failed to submit draw"); }
+  }
+  frameSubmitted(m_lastStats.gpuMs);
+  m_slotFrame[m_currentFrame] = m_frameIndex;
   VkPresentInfoKHR present{}; present.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
   present.waitSemaphoreCount = 1; present.pWaitSemaphores = signalSemaphores;
   present.swapchainCount = 1; present.pSwapchains = &m_swapchain; present.pImageIndices = &imageIndex; present.pResults = nullptr;
-  VkResult presRes = vkQueuePresentKHR(m_presentQueue, &present);
-  if(presRes == VK_ERROR_OUT_OF_DATE_KHR || presRes == VK_SUBOPTIMAL_KHR){ /* TODO recreate swapchain */ }
+  const uint64_t presentId = ++m_presentId;
+  m_inputTimes[presentId % m_inputTimes.size()] = m_cpuStart;
+#ifdef VK_KHR_present_wait
+  VkPresentIdKHR idInfo{}; idInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+  idInfo.swapchainCount = 1; idInfo.pPresentIds = &presentId;
+  if(m_presentWaitEnabled) present.pNext = &idInfo;
+#endif
+  VkResult presRes;
+  {
+    BLOCCO_ZONE("present");
+    presRes = vkQueuePresentKHR(m_presentQueue, &present);
+  }
+  // Without present wait the best available signal is the present call returning.
+  if(!m_presentWaitEnabled) recordLatency(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-m_cpuStart).count());
+  if(presRes == VK_ERROR_OUT_OF_DATE_KHR || presRes == VK_SUBOPTIMAL_KHR){ m_resizePending = true; }
   else if(presRes != VK_SUCCESS){ throw std::runtime_error("Failed to present"); }
-  m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+  m_currentFrame = (m_currentFrame + 1) % m_framesInFlight;
+  ++m_frameIndex;
+}
+
+void Renderer::drawOffscreen(){
+  acquireReadback();
+  vkResetFences(m_device, 1, &m_inFlightFences[m_currentFrame]);
+  VkCommandBuffer cmd = m_commandBuffers[m_currentFrame];
+  vkResetCommandBuffer(cmd, 0);
+  recordCommandBuffer(cmd, 0);
+  VkSemaphore uploadSemaphore = m_uploads ? m_uploads->semaphore() : VK_NULL_HANDLE;
+  const VkPipelineStageFlags uploadStages = MESH_READ_STAGES;
+  VkTimelineSemaphoreSubmitInfo timeline{}; timeline.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timeline.waitSemaphoreValueCount = 1; timeline.pWaitSemaphoreValues = &m_uploadsAcquired;
+  VkSubmitInfo submit{}; submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  if(m_uploads){
+    submit.pNext = &timeline;
+    submit.waitSemaphoreCount = 1; submit.pWaitSemaphores = &uploadSemaphore; submit.pWaitDstStageMask = &uploadStages;
+  }
+  submit.commandBufferCount = 1; submit.pCommandBuffers = &cmd;
+  m_slotSubmitTicks[m_currentFrame] = Profiler::now();
+  if(vkQueueSubmit(m_graphicsQueue, 1, &submit, m_inFlightFences[m_currentFrame]) != VK_SUCCESS){ throw std::runtime_error("Failed to submit offscreen frame"); }
+  frameSubmitted(-1.0);
+  m_slotFrame[m_currentFrame] = m_frameIndex;
+  m_currentFrame = (m_currentFrame + 1) % m_framesInFlight;
   ++m_frameIndex;
 }
 
+// gpuMs until the frame's own timing arrives: the last one measured in a
+// window, for the HUD; -1 (untimed) in headless history.
+void Renderer::frameSubmitted(double gpuMs){
+  const auto now = std::chrono::steady_clock::now();
+  m_lastStats = {m_frameIndex, std::chrono::duration<double, std::milli>(now-m_cpuStart).count(), gpuMs, m_lastDraws, m_lastRecordMs,
+                 m_lastVisible, m_lastCpuCulled, 0, m_textGlyphs, m_textMs, m_uploadBytes};
+  if(m_startup.firstFrameMs < 0.0) m_startup.firstFrameMs = std::chrono::duration<double, std::milli>(now-m_initStart).count();
+  // History only for headless runs, which end after a set number of frames; a
+  // window keeps just the last frame's, or a long session would grow it forever.
+  if(m_headless) m_frameStats.push_back(m_lastStats);
+}
+
+void Renderer::recordLatency(double ms){
+  m_latencySum += ms; m_latencyMax = std::max(m_latencyMax, ms);
+  if(++m_latencyCount < 240) return;
+  Log::info("input-to-present latency ({}, {} frames in flight): avg {:.3f} ms, max {:.3f} ms",
+            m_presentWaitEnabled ? "present wait" : "present call", m_framesInFlight, m_latencySum / m_latencyCount, m_latencyMax);
+  m_latencySum = 0.0; m_latencyMax = 0.0; m_latencyCount = 0;
+}
+
+// Builds the replacement swapchain from the old one while frames using the old
+// images may still be in flight; their objects are retired instead of waited on.
+bool Renderer::recreateSwapchain(){
+  VkSurfaceCapabilitiesKHR caps{};
+  vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_physicalDevice, m_surface, &caps);
+  if(caps.currentExtent.width == 0 || caps.currentExtent.height == 0){ m_resizePending = true; return false; } // minimised
+  Retired old;
+  old.swapchain = m_swapchain;
+  old.views = std::move(m_swapchainImageViews);
+  old.framebuffers = std::move(m_framebuffers);
+  old.depthImage = std::exchange(m_depthImage, VK_NULL_HANDLE);
+  old.depthView = std::exchange(m_depthView, VK_NULL_HANDLE);
+  old.depthMemory = std::exchange(m_depthMemory, {});
+  old.pyramid = std::exchange(m_pyramid, {});
+  old.lastFrame = m_frameIndex;
+  m_swapchainImageViews.clear(); m_framebuffers.clear(); m_swapchainImages.clear();
+  const VkFormat oldFormat = m_swapchainFormat;
+  createSwapchain(); // passes m_swapchain as oldSwapchain, then replaces it
+  createImageViews();
+  createDepthTarget();
+  if(m_swapchainFormat != oldFormat){
+    finishPipelines(); // variants still compiling reference the old render pass
+    old.renderPass = m_renderPass;
+    for(auto& p : m_pipelines){ if(VkPipeline v = p.exchange(VK_NULL_HANDLE)) old.pipelines.push_back(v); }
+    old.pipelines.push_back(std::exchange(m_textPipeline, VK_NULL_HANDLE));
+    createRenderPass();
+    createPipelines();
+    m_textPipeline = createTextPipeline();
+  }
+  createFramebuffers();
+  m_imagesInFlight.assign(m_swapchainImages.size(), VK_NULL_HANDLE);
+  m_retired.push_back(std::move(old));
+  m_swapchainFirstPresentId = m_presentId + 1;
+  m_resizePending = false;
+  return true;
+}
+
+void Renderer::destroyRetired(bool all){
+  // beginFrame has waited on every frame numbered below m_frameIndex + 1 - framesInFlight.
+  std::erase_if(m_retired, [&](Retired& r){
+    if(!all && r.lastFrame + m_framesInFlight > m_frameIndex + 1) return false;
+    for(auto fb : r.framebuffers) vkDestroyFramebuffer(m_device, fb, nullptr);
+    for(auto v : r.views) vkDestroyImageView(m_device, v, nullptr);
+    if(r.depthView) vkDestroyImageView(m_device, r.depthView, nullptr);
+    if(r.depthImage) vkDestroyImage(m_device, r.depthImage, nullptr);
+    m_allocator->free(r.depthMemory);
+    destroyDepthPyramid(r.pyramid);
+    for(auto p : r.pipelines) vkDestroyPipeline(m_device, p, nullptr);
+    if(r.renderPass) vkDestroyRenderPass(m_device, r.renderPass, nullptr);
+    if(r.swapchain) vkDestroySwapchainKHR(m_device, r.swapchain, nullptr);
+    return true;
+  });
+  std::erase_if(m_retiredMeshes, [&](RetiredMesh& r){
+    if(!all && (r.upload > m_uploadsAcquired || r.lastFrame + m_framesInFlight > m_frameIndex + 1)) return false;
+    m_meshPool->free(r.mesh);
+    return true;
+  });
+}
+
+void Renderer::waitIdle(){
+  if(!m_device) return;
+  vkDeviceWaitIdle(m_device);
+  for(size_t i=0;i<m_slotFrame.size();++i){ deliverReadback(i); collectCullStats(i); collectTimings(i); }
+  if(m_uploads) m_uploads->completed();
+}
+
+// Picks a free ring slot for the frame about to be recorded; copies are only
+// recorded while someone consumes them.
+void Renderer::acquireReadback(){
+  m_slotReadback[m_currentFrame] = -1;
+  if(!m_readbackHandler) return;
+  for(size_t k=0;k<m_readback.size();++k){
+    const size_t i = (m_nextReadback + k) % m_readback.size();
+    if(m_readbackBusy[i].load(std::memory_order_acquire)) continue;
+    m_readbackBusy[i].store(true, std::memory_order_relaxed);
+    m_slotReadback[m_currentFrame] = static_cast<int>(i);
+    m_nextReadback = (i + 1) % m_readback.size();
+    return;
+  }
+  ++m_readbackDropped;
+}
+
+// Called after the frame slot's fence has signalled (must run before collectTimings clears the frame number).
+void Renderer::deliverReadback(size_t slot){
+  if(m_slotReadback.empty() || m_slotReadback[slot] < 0) return;
+  const auto ring = static_cast<size_t>(m_slotReadback[slot]);
+  m_slotReadback[slot] = -1;
+  if(!m_readbackHandler || m_slotFrame[slot] < 0){ releaseReadback(ring); return; }
+  const Capture::ImageView image{static_cast<const uint8_t*>(m_readback[ring].mapped), m_swapchainExtent.width, m_swapchainExtent.height, size_t{m_swapchainExtent.width}*4};
+  m_readbackHandler(static_cast<uint32_t>(m_slotFrame[slot]), image, ring);
+}
+
+// Called once the slot's fence has signalled, so results are available without waiting.
+// While the profiler records, the frame's passes also become GPU zones placed
+// relative to the moment the slot was submitted.
+void Renderer::collectTimings(size_t slot){
+  if(!m_timestampPool || m_slotFrame.empty() || m_slotFrame[slot] < 0) return;
+  uint64_t ts[TIMESTAMPS_PER_FRAME]{};
+  const VkResult r = vkGetQueryPoolResults(m_device, m_timestampPool, static_cast<uint32_t>(slot*TIMESTAMPS_PER_FRAME), TIMESTAMPS_PER_FRAME,
+                                           sizeof(ts), ts, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+  if(r == VK_SUCCESS){
+    auto ns = [&](uint32_t i){
+      const uint64_t ticks = ((ts[i] & m_timestampMask) - (ts[0] & m_timestampMask)) & m_timestampMask;
+      return static_cast<double>(ticks) * static_cast<double>(m_timestampPeriod);
+    };
+    const double gpuMs = ns(TIMESTAMPS_PER_FRAME - 1) / 1.0e6;
+    const auto frame = static_cast<uint32_t>(m_slotFrame[slot]);
+    if(m_lastStats.frame == frame) m_lastStats.gpuMs = gpuMs;
+    if(frame < m_frameStats.size()) m_frameStats[frame].gpuMs = gpuMs;
+    if(Profiler::active()){
+      const uint64_t anchor = m_slotSubmitTicks[slot];
+      Profiler::gpuZone("gpu frame", anchor, 0.0, ns(TIMESTAMPS_PER_FRAME - 1));
+      Profiler::gpuZone("cull", anchor, 0.0, ns(1));
+      Profiler::gpuZone("render pass", anchor, ns(1), ns(2));
+      Profiler::gpuZone("depth pyramid", anchor, ns(2), ns(3));
+    }
+  }
+  m_slotFrame[slot] = -1;
+}
+
 void Renderer::pickPhysicalDevice(){
   uint32_t count=0;
   vkEnumeratePhysicalDevices(m_instance, &count, nullptr);
   if(count==0) throw std::runtime_error("No Vulkan physical devices found");
   std::vector<VkPhysicalDevice> devices(count);
   vkEnumeratePhysicalDevices(m_instance, &count, devices.data());
+  // Prefer real GPUs, but accept CPU implementations (e.g. lavapipe) so headless runs work without one.
+  auto rank = [](VkPhysicalDevice d){
+    VkPhysicalDeviceProperties p{}; vkGetPhysicalDeviceProperties(d, &p);
+    switch(p.deviceType){
+      case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 0;
+      case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 1;
+      case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return 2;
+      case VK_PHYSICAL_DEVICE_TYPE_CPU: return 3;
+      default: return 4;
+    }
+  };
+  std::stable_sort(devices.begin(), devices.end(), [&](VkPhysicalDevice a, VkPhysicalDevice b){ return rank(a) < rank(b); });
   for(auto d: devices){
     // Check queue families
     uint32_t qCount=0; vkGetPhysicalDeviceQueueFamilyProperties(d, &qCount, nullptr);
@@ -137,23 +468,33 @@ void Renderer::pickPhysicalDevice(){
     uint32_t presentIdx = UINT32_MAX;
     for(uint32_t i=0;i<qCount;++i){
       if(qprops[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) graphicsIdx = i;
+      if(m_headless) continue;
       VkBool32 presentSupport = VK_FALSE;
       vkGetPhysicalDeviceSurfaceSupportKHR(d, i, m_surface, &presentSupport);
       if(presentSupport) presentIdx = i;
     }
+    if(m_headless) presentIdx = graphicsIdx; // no surface: nothing is presented
     if(graphicsIdx==UINT32_MAX || presentIdx==UINT32_MAX) continue;
+    // Uploads prefer a transfer-only family (usually a DMA engine), then any other non-graphics one.
+    uint32_t transferIdx = graphicsIdx;
+    for(uint32_t i=0;i<qCount;++i){
+      const VkQueueFlags f = qprops[i].queueFlags;
+      if(!(f & VK_QUEUE_TRANSFER_BIT) || (f & VK_QUEUE_GRAPHICS_BIT) || qprops[i].queueCount == 0) continue;
+      if(transferIdx == graphicsIdx || !(f & VK_QUEUE_COMPUTE_BIT)) transferIdx = i;
+    }
     // Check device extension support
     uint32_t extCount=0; vkEnumerateDeviceExtensionProperties(d, nullptr, &extCount, nullptr);
     std::vector<VkExtensionProperties> exts(extCount);
     vkEnumerateDeviceExtensionProperties(d, nullptr, &extCount, exts.data());
     std::set<std::string> required;
-    for(auto e: vkutils::deviceExtensions()) required.insert(e);
+    if(!m_headless) for(auto e: vkutils::deviceExtensions()) required.insert(e);
     for(const auto &e : exts){ required.erase(e.extensionName); }
     if(!required.empty()) continue;
     // Suitable
     m_physicalDevice = d;
     m_graphicsQueueFamily = graphicsIdx;
     m_presentQueueFamily = presentIdx;
+    m_transferQueueFamily = transferIdx;
     break;
   }
   if(m_physicalDevice==VK_NULL_HANDLE) throw std::runtime_error("No suitable GPU found");
@@ -163,18 +504,70 @@ void Renderer::createLogicalDevice(){
   if(m_physicalDevice==VK_NULL_HANDLE) return;
   float priority = 1.0f;
   std::vector<VkDeviceQueueCreateInfo> queueInfos;
-  std::set<uint32_t> uniqueFamilies = {m_graphicsQueueFamily, m_presentQueueFamily};
+  std::set<uint32_t> uniqueFamilies = {m_graphicsQueueFamily, m_presentQueueFamily, m_transferQueueFamily};
   for(uint32_t fam : uniqueFamilies){
     VkDeviceQueueCreateInfo q{}; q.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO; q.queueFamilyIndex=fam; q.queueCount=1; q.pQueuePriorities=&priority; queueInfos.push_back(q);
   }
-  VkPhysicalDeviceFeatures features{}; // default
+  VkPhysicalDeviceFeatures supported{}; vkGetPhysicalDeviceFeatures(m_physicalDevice, &supported);
+  VkPhysicalDeviceFeatures features{};
+  // Indirect batches need both; without them each command is replayed as a direct draw.
+  features.multiDrawIndirect = supported.multiDrawIndirect;
+  features.drawIndirectFirstInstance = supported.drawIndirectFirstInstance;
+  m_indirectDraws = supported.multiDrawIndirect && supported.drawIndirectFirstInstance;
+  // GPU culling runs on the graphics queue and only pays off with indirect draws;
+  // drawIndirectCount (Vulkan 1.2) lets it compact survivors instead of zeroing them.
+  uint32_t qCount=0; vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &qCount, nullptr);
+  std::vector<VkQueueFamilyProperties> qprops(qCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &qCount, qprops.data());
+  m_gpuCulling = m_indirectDraws && (qprops[m_graphicsQueueFamily].queueFlags & VK_QUEUE_COMPUTE_BIT);
+  VkPhysicalDeviceProperties props{}; vkGetPhysicalDeviceProperties(m_physicalDevice, &props);
+  // Asynchronous uploads need timeline semaphores; their GPU timing needs host query resets.
+  VkPhysicalDeviceVulkan12Features vk12{}; vk12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  if(props.apiVersion >= VK_API_VERSION_1_2){
+    VkPhysicalDeviceFeatures2 f2{}; f2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2; f2.pNext = &vk12;
+    vkGetPhysicalDeviceFeatures2(m_physicalDevice, &f2);
+    m_drawIndirectCount = m_gpuCulling && vk12.drawIndirectCount;
+    m_asyncUploads = m_asyncUploadsRequested && vk12.timelineSemaphore;
+    m_uploadTimestamps = m_asyncUploads && vk12.hostQueryReset && qprops[m_transferQueueFamily].timestampValidBits > 0;
+  }
+  vk12 = {}; vk12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
   VkDeviceCreateInfo ci{}; ci.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
   ci.queueCreateInfoCount = static_cast<uint32_t>(queueInfos.size());
   ci.pQueueCreateInfos = queueInfos.data();
   ci.pEnabledFeatures = &features;
-  auto devExts = vkutils::deviceExtensions();
+  std::vector<const char*> devExts;
+  if(!m_headless) devExts = vkutils::deviceExtensions();
+#ifdef VK_KHR_present_wait
+  VkPhysicalDevicePresentWaitFeaturesKHR waitFeatures{}; waitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+  VkPhysicalDevicePresentIdFeaturesKHR idFeatures{}; idFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+  if(!m_headless && m_presentWaitRequested){
+    uint32_t extCount=0; vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extCount, nullptr);
+    std::vector<VkExtensionProperties> exts(extCount);
+    vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extCount, exts.data());
+    auto has = [&](const char* name){ return std::any_of(exts.begin(), exts.end(), [&](const VkExtensionProperties& e){ return std::string(e.extensionName) == name; }); };
+    if(has(VK_KHR_PRESENT_ID_EXTENSION_NAME) && has(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)){
+      idFeatures.pNext = &waitFeatures;
+      VkPhysicalDeviceFeatures2 f2{}; f2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2; f2.pNext = &idFeatures;
+      vkGetPhysicalDeviceFeatures2(m_physicalDevice, &f2);
+      m_presentWaitEnabled = idFeatures.presentId && waitFeatures.presentWait;
+    }
+    if(m_presentWaitEnabled){
+      devExts.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+      devExts.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+      idFeatures.presentId = VK_TRUE; waitFeatures.presentWait = VK_TRUE;
+      ci.pNext = &idFeatures;
+    }
+  }
+#endif
   ci.enabledExtensionCount = static_cast<uint32_t>(devExts.size());
-  ci.ppEnabledExtensionNames = devExts.data();
+  ci.ppEnabledExtensionNames = devExts.empty() ? nullptr : devExts.data();
+  if(m_drawIndirectCount || m_asyncUploads){
+    vk12.drawIndirectCount = m_drawIndirectCount ? VK_TRUE : VK_FALSE;
+    vk12.timelineSemaphore = m_asyncUploads ? VK_TRUE : VK_FALSE;
+    vk12.hostQueryReset = m_uploadTimestamps ? VK_TRUE : VK_FALSE;
+    vk12.pNext = const_cast<void*>(ci.pNext); // ahead of the present wait features, if any
+    ci.pNext = &vk12;
+  }
   std::vector<const char*> layers;
   if(m_validationEnabled && vkutils::checkValidationLayerSupport()){
     layers = vkutils::validationLayers();
@@ -186,6 +579,15 @@ void Renderer::createLogicalDevice(){
   }
   vkGetDeviceQueue(m_device, m_graphicsQueueFamily, 0, &m_graphicsQueue);
   vkGetDeviceQueue(m_device, m_presentQueueFamily, 0, &m_presentQueue);
+#ifdef VK_KHR_present_wait
+  if(m_presentWaitEnabled){
+    m_waitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(m_device, "vkWaitForPresentKHR"));
+    m_presentWaitEnabled = m_waitForPresent != nullptr;
+  }
+#endif
+  if(!m_headless) Log::info("Frame pacing: {} frames in flight, present wait {}", m_framesInFlight, m_presentWaitEnabled ? "on" : "off");
+  if(m_asyncUploads) Log::info("Mesh uploads: {} queue (family {})", m_transferQueueFamily != m_graphicsQueueFamily ? "transfer" : "graphics", m_transferQueueFamily);
+  else Log::info("Mesh uploads: direct writes ({})", m_asyncUploadsRequested ? "no timeline semaphores" : "disabled");
 }
 
 void Renderer::createSwapchain(){
@@ -207,12 +609,13 @@ void Renderer::createSwapchain(){
       chosenFormat = f; break;
     }
   }
-  // Choose present mode (MAILBOX -> IMMEDIATE -> FIFO)
-  VkPresentModeKHR chosenPresent = VK_PRESENT_MODE_FIFO_KHR; // guaranteed
-  for(auto pm: presentModes){ if(pm == VK_PRESENT_MODE_MAILBOX_KHR){ chosenPresent = pm; break; } }
-  if(chosenPresent != VK_PRESENT_MODE_MAILBOX_KHR){
-    for(auto pm: presentModes){ if(pm == VK_PRESENT_MODE_IMMEDIATE_KHR){ chosenPresent = pm; break; } }
-  }
+  // Configured present mode if supported, else FIFO (always available)
+  const VkPresentModeKHR wanted = m_presentModePreference == PresentMode::Mailbox ? VK_PRESENT_MODE_MAILBOX_KHR
+                                : m_presentModePreference == PresentMode::Immediate ? VK_PRESENT_MODE_IMMEDIATE_KHR
+                                : VK_PRESENT_MODE_FIFO_KHR;
+  VkPresentModeKHR chosenPresent = VK_PRESENT_MODE_FIFO_KHR;
+  if(std::find(presentModes.begin(), presentModes.end(), wanted) != presentModes.end()) chosenPresent = wanted;
+  else if(!m_swapchain) Log::warn("Requested present mode unsupported; using FIFO");
   // Extent
   VkExtent2D extent;
   if(caps.currentExtent.width != UINT32_MAX){
@@ -245,7 +648,7 @@ void Renderer::createSwapchain(){
   ci.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
   ci.presentMode = chosenPresent;
   ci.clipped = VK_TRUE;
-  ci.oldSwapchain = VK_NULL_HANDLE;
+  ci.oldSwapchain = m_swapchain; // lets the driver hand over resources during a resize
   if(vkCreateSwapchainKHR(m_device, &ci, nullptr, &m_swapchain) != VK_SUCCESS){
     throw std::runtime_error("Failed to create swapchain");
   }
@@ -284,7 +687,6 @@ void Renderer::cleanupSwapchain(){
 }
 
 void Renderer::createRenderPass(){
-  if(m_headless) return;
   VkAttachmentDescription color{};
   color.format = m_swapchainFormat;
   color.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -293,73 +695,1104 @@ void Renderer::createRenderPass(){
   color.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   color.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   color.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  color.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  color.finalLayout = m_headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  VkAttachmentDescription depth{};
+  depth.format = m_depthFormat;
+  depth.samples = VK_SAMPLE_COUNT_1_BIT;
+  depth.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depth.storeOp = m_hiz ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE; // kept for the depth pyramid
+  depth.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  depth.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depth.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  depth.finalLayout = m_hiz ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
   VkAttachmentReference colorRef{}; colorRef.attachment = 0; colorRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  VkAttachmentReference depthRef{}; depthRef.attachment = 1; depthRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
   VkSubpassDescription sub{}; sub.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS; sub.colorAttachmentCount = 1; sub.pColorAttachments = &colorRef;
+  sub.pDepthStencilAttachment = &depthRef;
+  // The single depth image is shared by all frames in flight: order this frame's
+  // clear after the previous frame's depth writes and depth pyramid reads.
   VkSubpassDependency dep{}; dep.srcSubpass = VK_SUBPASS_EXTERNAL; dep.dstSubpass = 0;
-  dep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dep.srcAccessMask = 0;
-  dep.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  if(m_hiz) dep.srcStageMask |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  dep.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dep.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  // Headless: the copy into the readback buffer must see the finished attachment.
+  VkSubpassDependency toTransfer{}; toTransfer.srcSubpass = 0; toTransfer.dstSubpass = VK_SUBPASS_EXTERNAL;
+  toTransfer.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  toTransfer.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  toTransfer.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  // Depth pyramid: the reduction samples the finished depth.
+  VkSubpassDependency toPyramid{}; toPyramid.srcSubpass = 0; toPyramid.dstSubpass = VK_SUBPASS_EXTERNAL;
+  toPyramid.srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  toPyramid.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  toPyramid.dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  toPyramid.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  std::vector<VkSubpassDependency> deps{dep};
+  if(m_headless) deps.push_back(toTransfer);
+  if(m_hiz) deps.push_back(toPyramid);
   VkRenderPassCreateInfo ci{}; ci.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-  ci.attachmentCount = 1; ci.pAttachments = &color;
+  const VkAttachmentDescription attachments[] = {color, depth};
+  ci.attachmentCount = 2; ci.pAttachments = attachments;
   ci.subpassCount = 1; ci.pSubpasses = &sub;
-  ci.dependencyCount = 1; ci.pDependencies = &dep;
+  ci.dependencyCount = static_cast<uint32_t>(deps.size()); ci.pDependencies = deps.data();
   if(vkCreateRenderPass(m_device, &ci, nullptr, &m_renderPass) != VK_SUCCESS){ throw std::runtime_error("Failed to create render pass"); }
 }
 
 void Renderer::createFramebuffers(){
-  if(m_headless) return;
-  m_framebuffers.resize(m_swapchainImageViews.size());
-  for(size_t i=0;i<m_swapchainImageViews.size();++i){
-    VkImageView attachments[] = { m_swapchainImageViews[i] };
+  const std::vector<VkImageView> views = m_headless ? std::vector<VkImageView>{m_offscreenView} : m_swapchainImageViews;
+  m_framebuffers.resize(views.size());
+  for(size_t i=0;i<views.size();++i){
+    VkImageView attachments[] = { views[i], m_depthView };
     VkFramebufferCreateInfo ci{}; ci.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
     ci.renderPass = m_renderPass;
-    ci.attachmentCount = 1; ci.pAttachments = attachments;
+    ci.attachmentCount = 2; ci.pAttachments = attachments;
     ci.width = m_swapchainExtent.width; ci.height = m_swapchainExtent.height; ci.layers = 1;
     if(vkCreateFramebuffer(m_device, &ci, nullptr, &m_framebuffers[i]) != VK_SUCCESS){ throw std::runtime_error("Failed to create framebuffer"); }
   }
 }
 
 void Renderer::createCommandPool(){
-  if(m_headless) return;
   VkCommandPoolCreateInfo ci{}; ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO; ci.queueFamilyIndex = m_graphicsQueueFamily; ci.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
   if(vkCreateCommandPool(m_device, &ci, nullptr, &m_commandPool) != VK_SUCCESS){ throw std::runtime_error("Failed to create command pool"); }
 }
 
 void Renderer::createCommandBuffers(){
-  if(m_headless) return;
-  m_commandBuffers.resize(m_swapchainImages.size());
+  m_commandBuffers.resize(m_framesInFlight);
   VkCommandBufferAllocateInfo ai{}; ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO; ai.commandPool = m_commandPool; ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY; ai.commandBufferCount = static_cast<uint32_t>(m_commandBuffers.size());
   if(vkAllocateCommandBuffers(m_device, &ai, m_commandBuffers.data()) != VK_SUCCESS){ throw std::runtime_error("Failed to allocate command buffers"); }
 }
 
 void Renderer::createSyncObjects(){
-  if(m_headless) return;
-  m_imageAvailable.resize(MAX_FRAMES_IN_FLIGHT);
-  m_renderFinished.resize(MAX_FRAMES_IN_FLIGHT);
-  m_inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+  m_inFlightFences.resize(m_framesInFlight);
+  m_slotFrame.assign(m_framesInFlight, -1);
+  m_slotSubmitTicks.assign(m_framesInFlight, 0);
+  VkFenceCreateInfo fi{}; fi.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO; fi.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+  for(uint32_t i=0;i<m_framesInFlight;++i){
+    if(vkCreateFence(m_device, &fi, nullptr, &m_inFlightFences[i]) != VK_SUCCESS){ throw std::runtime_error("Failed to create fence"); }
+  }
+  if(m_headless) return; // no swapchain to synchronise with
+  m_imageAvailable.resize(m_framesInFlight);
+  m_renderFinished.resize(m_framesInFlight);
   m_imagesInFlight.resize(m_swapchainImages.size(), VK_NULL_HANDLE);
   VkSemaphoreCreateInfo si{}; si.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-  VkFenceCreateInfo fi{}; fi.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO; fi.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-  for(int i=0;i<MAX_FRAMES_IN_FLIGHT;++i){
+  for(uint32_t i=0;i<m_framesInFlight;++i){
     if(vkCreateSemaphore(m_device, &si, nullptr, &m_imageAvailable[i]) != VK_SUCCESS ||
-       vkCreateSemaphore(m_device, &si, nullptr, &m_renderFinished[i]) != VK_SUCCESS ||
-       vkCreateFence(m_device, &fi, nullptr, &m_inFlightFences[i]) != VK_SUCCESS){
+       vkCreateSemaphore(m_device, &si, nullptr, &m_renderFinished[i]) != VK_SUCCESS){
       throw std::runtime_error("Failed to create sync objects"); }
   }
 }
 
+void Renderer::createAllocators(){
+  m_allocator = std::make_unique<vkutils::GpuAllocator>(m_physicalDevice, m_device);
+  m_frameRing = std::make_unique<vkutils::FrameRing>(*m_allocator, m_physicalDevice, FRAME_RING_BYTES, m_framesInFlight);
+  if(m_vertexFormat == VertexFormat::Packed){
+    m_meshPool = std::make_unique<vkutils::MeshPool>(*m_allocator, MESH_VERTEX_BYTES, 0, static_cast<uint32_t>(sizeof(PackedVertex)), m_asyncUploads);
+    // Written once, so it needs no staging even when the pool is device local.
+    m_quadIndices = m_allocator->createBuffer(VkDeviceSize{MAX_MESH_QUADS} * 6 * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    auto* indices = static_cast<uint32_t*>(m_quadIndices.mapped);
+    for(uint32_t q=0;q<MAX_MESH_QUADS;++q)
+      for(uint32_t i : {0u,1u,2u,0u,2u,3u}) *indices++ = q*4 + i;
+  } else {
+    m_meshPool = std::make_unique<vkutils::MeshPool>(*m_allocator, MESH_VERTEX_BYTES, MESH_INDEX_BYTES, static_cast<uint32_t>(sizeof(Vertex)), m_asyncUploads);
+  }
+  Log::info("Mesh vertices: {}", m_vertexFormat == VertexFormat::Float ? "float" : m_vertexPulling ? "packed, pulled" : "packed");
+  if(m_asyncUploads){
+    m_uploads = std::make_unique<vkutils::UploadQueue>(*m_allocator, m_physicalDevice, m_device, m_transferQueueFamily, m_graphicsQueueFamily,
+                                                       STAGING_BYTES, m_uploadTimestamps);
+  }
+  VkPhysicalDeviceProperties props{}; vkGetPhysicalDeviceProperties(m_physicalDevice, &props);
+  m_maxDrawIndirectCount = std::max(props.limits.maxDrawIndirectCount, 1u);
+}
+
+void Renderer::createOffscreenTarget(){
+  if(!m_headless) return;
+  m_swapchainFormat = VK_FORMAT_R8G8B8A8_UNORM;
+  m_swapchainExtent = {1280, 720};
+  VkImageCreateInfo ii{}; ii.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  ii.imageType = VK_IMAGE_TYPE_2D; ii.format = m_swapchainFormat;
+  ii.extent = {m_swapchainExtent.width, m_swapchainExtent.height, 1};
+  ii.mipLevels = 1; ii.arrayLayers = 1; ii.samples = VK_SAMPLE_COUNT_1_BIT;
+  ii.tiling = VK_IMAGE_TILING_OPTIMAL;
+  ii.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  ii.sharingMode = VK_SHARING_MODE_EXCLUSIVE; ii.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  if(vkCreateImage(m_device, &ii, nullptr, &m_offscreenImage) != VK_SUCCESS){ throw std::runtime_error("Failed to create offscreen image"); }
+  m_offscreenMemory = m_allocator->allocateImage(m_offscreenImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  VkImageViewCreateInfo vi{}; vi.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  vi.image = m_offscreenImage; vi.viewType = VK_IMAGE_VIEW_TYPE_2D; vi.format = m_swapchainFormat;
+  vi.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  if(vkCreateImageView(m_device, &vi, nullptr, &m_offscreenView) != VK_SUCCESS){ throw std::runtime_error("Failed to create offscreen view"); }
+  const VkDeviceSize bytes = VkDeviceSize{m_swapchainExtent.width} * m_swapchainExtent.height * 4;
+  // Cached memory keeps CPU reads of the mapped pixels fast for the encoders.
+  for(uint32_t i=0;i<m_framesInFlight+2;++i){
+    m_readback.push_back(m_allocator->createBuffer(bytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT));
+  }
+  m_readbackBusy = std::vector<std::atomic<bool>>(m_readback.size());
+  m_slotReadback.assign(m_framesInFlight, -1);
+}
+
+void Renderer::createDepthTarget(){
+  if(m_depthFormat == VK_FORMAT_UNDEFINED){
+    for(VkFormat f : {VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM}){
+      VkFormatProperties fp{}; vkGetPhysicalDeviceFormatProperties(m_physicalDevice, f, &fp);
+      if(fp.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT){
+        m_depthFormat = f;
+        m_hiz = m_gpuCulling && (fp.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+        break;
+      }
+    }
+    if(m_depthFormat == VK_FORMAT_UNDEFINED) throw std::runtime_error("No supported depth format");
+    if(m_gpuCulling && !m_hiz) Log::warn("Depth format cannot be sampled; occlusion culling disabled");
+  }
+  VkImageCreateInfo ii{}; ii.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  ii.imageType = VK_IMAGE_TYPE_2D; ii.format = m_depthFormat;
+  ii.extent = {m_swapchainExtent.width, m_swapchainExtent.height, 1};
+  ii.mipLevels = 1; ii.arrayLayers = 1; ii.samples = VK_SAMPLE_COUNT_1_BIT;
+  ii.tiling = VK_IMAGE_TILING_OPTIMAL;
+  ii.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (m_hiz ? VkImageUsageFlags{VK_IMAGE_USAGE_SAMPLED_BIT} : 0u);
+  ii.sharingMode = VK_SHARING_MODE_EXCLUSIVE; ii.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  if(vkCreateImage(m_device, &ii, nullptr, &m_depthImage) != VK_SUCCESS){ throw std::runtime_error("Failed to create depth image"); }
+  m_depthMemory = m_allocator->allocateImage(m_depthImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  VkImageViewCreateInfo vi{}; vi.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  vi.image = m_depthImage; vi.viewType = VK_IMAGE_VIEW_TYPE_2D; vi.format = m_depthFormat;
+  vi.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1};
+  if(vkCreateImageView(m_device, &vi, nullptr, &m_depthView) != VK_SUCCESS){ throw std::runtime_error("Failed to create depth view"); }
+  m_pyramidValid = false;
+  if(m_gpuCulling) createDepthPyramid();
+}
+
+// Matches shaders/vert.glsl and frag.glsl (std140).
+struct CameraUBO { Mat4 view; Mat4 proj; };
+struct SceneUBO { float lightDir[3]; float pad0; float baseColor[3]; float pad1; };
+
+// One set for the whole renderer: the first three bindings point into the frame
+// ring, the UBOs through dynamic offsets and the transform SSBO through
+// firstInstance; the fourth is the mesh pool's vertex buffer, for vertex pulling.
+void Renderer::createDescriptors(){
+  VkDescriptorSetLayoutBinding bindings[4]{};
+  bindings[0] = {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr};
+  bindings[1] = {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr};
+  bindings[2] = {2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr};
+  bindings[3] = {3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr};
+  VkDescriptorSetLayoutCreateInfo li{}; li.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  li.bindingCount = 4; li.pBindings = bindings;
+  if(vkCreateDescriptorSetLayout(m_device, &li, nullptr, &m_descriptorSetLayout) != VK_SUCCESS){ throw std::runtime_error("Failed to create descriptor set layout"); }
+  const VkDescriptorPoolSize sizes[] = {{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2}, {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2}};
+  VkDescriptorPoolCreateInfo pi{}; pi.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pi.maxSets = 1; pi.poolSizeCount = 2; pi.pPoolSizes = sizes;
+  if(vkCreateDescriptorPool(m_device, &pi, nullptr, &m_descriptorPool) != VK_SUCCESS){ throw std::runtime_error("Failed to create descriptor pool"); }
+  VkDescriptorSetAllocateInfo ai{}; ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  ai.descriptorPool = m_descriptorPool; ai.descriptorSetCount = 1; ai.pSetLayouts = &m_descriptorSetLayout;
+  if(vkAllocateDescriptorSets(m_device, &ai, &m_descriptorSet) != VK_SUCCESS){ throw std::runtime_error("Failed to allocate descriptor set"); }
+  const VkDescriptorBufferInfo camera{m_frameRing->buffer(), 0, sizeof(CameraUBO)};
+  const VkDescriptorBufferInfo transforms{m_frameRing->buffer(), 0, VK_WHOLE_SIZE};
+  const VkDescriptorBufferInfo scene{m_frameRing->buffer(), 0, sizeof(SceneUBO)};
+  const VkDescriptorBufferInfo vertices{m_meshPool->vertexBuffer(), 0, VK_WHOLE_SIZE};
+  VkWriteDescriptorSet writes[4]{};
+  const VkDescriptorBufferInfo* infos[4] = {&camera, &transforms, &scene, &vertices};
+  for(uint32_t i=0;i<4;++i){
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet = m_descriptorSet; writes[i].dstBinding = i;
+    writes[i].descriptorCount = 1; writes[i].descriptorType = bindings[i].descriptorType;
+    writes[i].pBufferInfo = infos[i];
+  }
+  vkUpdateDescriptorSets(m_device, 4, writes, 0, nullptr);
+  VkPipelineLayoutCreateInfo pl{}; pl.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pl.setLayoutCount = 1; pl.pSetLayouts = &m_descriptorSetLayout;
+  if(vkCreatePipelineLayout(m_device, &pl, nullptr, &m_pipelineLayout) != VK_SUCCESS){ throw std::runtime_error("Failed to create pipeline layout"); }
+}
+
+VkPipeline Renderer::createGraphicsPipeline(Pipeline variant) const {
+  const std::string dir = BLOCCO_SHADER_DIR;
+  const bool packed = m_vertexFormat == VertexFormat::Packed;
+  const char* vertName = !packed ? "/vert.spv" : m_vertexPulling ? "/pull_vert.spv" : "/packed_vert.spv";
+  VkShaderModule vert = vkutils::createShaderModule(m_device, dir + vertName);
+  VkShaderModule frag = VK_NULL_HANDLE;
+  try { frag = vkutils::createShaderModule(m_device, dir + "/frag.spv"); }
+  catch(...){ vkDestroyShaderModule(m_device, vert, nullptr); throw; }
+  VkPipelineShaderStageCreateInfo stages[2]{};
+  stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO; stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT; stages[0].module = vert; stages[0].pName = "main";
+  stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO; stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT; stages[1].module = frag; stages[1].pName = "main";
+  const VkVertexInputBindingDescription binding{0, static_cast<uint32_t>(packed ? sizeof(PackedVertex) : sizeof(Vertex)), VK_VERTEX_INPUT_RATE_VERTEX};
+  const VkVertexInputAttributeDescription attrs[] = {
+    {0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, pos)},
+    {1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)},
+    {2, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv)}};
+  const VkVertexInputAttributeDescription packedAttr{0, 0, VK_FORMAT_R32G32_UINT, 0};
+  VkPipelineVertexInputStateCreateInfo vin{}; vin.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  if(!m_vertexPulling){ // pulled vertices have no input state at all
+    vin.vertexBindingDescriptionCount = 1; vin.pVertexBindingDescriptions = &binding;
+    vin.vertexAttributeDescriptionCount = packed ? 1 : 3; vin.pVertexAttributeDescriptions = packed ? &packedAttr : attrs;
+  }
+  VkPipelineInputAssemblyStateCreateInfo ia{}; ia.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  VkPipelineViewportStateCreateInfo vp{}; vp.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  vp.viewportCount = 1; vp.scissorCount = 1; // dynamic: survives swapchain resizes
+  VkPipelineRasterizationStateCreateInfo rs{}; rs.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rs.polygonMode = VK_POLYGON_MODE_FILL; rs.lineWidth = 1.f;
+  // Mesher quads wind counter-clockwise seen from their normal; perspective() flips Y for Vulkan.
+  rs.cullMode = variant == Pipeline::Opaque ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE; rs.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  VkPipelineMultisampleStateCreateInfo ms{}; ms.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  ms.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+  VkPipelineDepthStencilStateCreateInfo ds{}; ds.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  ds.depthTestEnable = VK_TRUE; ds.depthWriteEnable = variant != Pipeline::Translucent; ds.depthCompareOp = VK_COMPARE_OP_LESS;
+  VkPipelineColorBlendAttachmentState blend{};
+  blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  VkPipelineColorBlendStateCreateInfo cb{}; cb.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  cb.attachmentCount = 1; cb.pAttachments = &blend;
+  if(variant == Pipeline::Translucent){
+    // Constant coverage: the fragment shader writes opaque alpha.
+    blend.blendEnable = VK_TRUE;
+    blend.srcColorBlendFactor = VK_BLEND_FACTOR_CONSTANT_ALPHA; blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_CONSTANT_ALPHA; blend.colorBlendOp = VK_BLEND_OP_ADD;
+    blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; blend.alphaBlendOp = VK_BLEND_OP_ADD;
+    cb.blendConstants[3] = 0.6f;
+  }
+  const VkDynamicState dynamics[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+  VkPipelineDynamicStateCreateInfo dyn{}; dyn.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dyn.dynamicStateCount = 2; dyn.pDynamicStates = dynamics;
+  VkGraphicsPipelineCreateInfo ci{}; ci.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  ci.stageCount = 2; ci.pStages = stages;
+  ci.pVertexInputState = &vin; ci.pInputAssemblyState = &ia; ci.pViewportState = &vp;
+  ci.pRasterizationState = &rs; ci.pMultisampleState = &ms; ci.pDepthStencilState = &ds;
+  ci.pColorBlendState = &cb; ci.pDynamicState = &dyn;
+  ci.layout = m_pipelineLayout; ci.renderPass = m_renderPass; ci.subpass = 0;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  const VkResult r = vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &ci, nullptr, &pipeline);
+  vkDestroyShaderModule(m_device, vert, nullptr);
+  vkDestroyShaderModule(m_device, frag, nullptr);
+  if(r != VK_SUCCESS){ throw std::runtime_error("Failed to create graphics pipeline"); }
+  return pipeline;
+}
+
+// Opaque is built here, before the first frame, and stands in for every other
+// variant until its background job has stored it. The pipeline cache is
+// internally synchronized (no VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BIT)
+// and each job creates its own pipeline, so the jobs need no locking of their own.
+// Without background workers nothing would pick the jobs up, so the variants
+// are built inline instead.
+void Renderer::createPipelines(){
+  m_pipelines[0].store(createGraphicsPipeline(Pipeline::Opaque), std::memory_order_release);
+  m_pipelinesPending.store(PIPELINE_COUNT - 1);
+  auto build = [this](uint32_t i){
+    try { m_pipelines[i].store(createGraphicsPipeline(static_cast<Pipeline>(i)), std::memory_order_release); }
+    catch(const std::exception& e){ Log::error("Pipeline variant {} unavailable, drawing it opaque: {}", i, e.what()); }
+    if(m_pipelinesPending.fetch_sub(1) == 1 && m_pipelinesReadyMs.load() < 0.0)
+      m_pipelinesReadyMs.store(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-m_initStart).count());
+  };
+  if(!m_jobs || m_jobs->threadCount() < 2){
+    for(uint32_t i=1;i<PIPELINE_COUNT;++i) build(i);
+    return;
+  }
+  if(!m_pipelineJobs) m_pipelineJobs = std::make_unique<JobCounter>();
+  for(uint32_t i=1;i<PIPELINE_COUNT;++i) m_jobs->runBackground([build, i]{ build(i); }, m_pipelineJobs.get());
+}
+
+void Renderer::finishPipelines(){
+  if(!m_pipelineJobs) return;
+  // Not wait(): background jobs only run on background workers or when helped.
+  while(!m_pipelineJobs->done()){
+    if(m_jobs->helpBackground(std::chrono::steady_clock::now() + std::chrono::milliseconds(1)) == 0) std::this_thread::yield();
+  }
+  m_jobs->wait(*m_pipelineJobs); // returns at once; waits for the last job to let go of the counter
+}
+
+VkPipeline Renderer::boundPipeline(uint32_t variant) const {
+  const VkPipeline p = variant < PIPELINE_COUNT ? m_pipelines[variant].load(std::memory_order_acquire) : VK_NULL_HANDLE;
+  return p ? p : m_pipelines[0].load(std::memory_order_relaxed);
+}
+
+StartupStats Renderer::startupStats() const {
+  StartupStats s = m_startup;
+  s.pipelinesMs = m_pipelinesReadyMs.load();
+  return s;
+}
+
+std::string Renderer::deviceName() const {
+  VkPhysicalDeviceProperties props{}; vkGetPhysicalDeviceProperties(m_physicalDevice, &props);
+  return std::string(props.deviceName) + " (driver " + std::to_string(props.driverVersion) + ")";
+}
+
+std::string Renderer::pipelineCachePath(const Config& config){
+  return config.pipelineCachePath.empty() ? Platform::cacheDirectory() + "/pipeline_cache.bin" : config.pipelineCachePath;
+}
+
+// The cache file is keyed by device and driver build; anything that does not
+// match (or fails its checks) is discarded and the cache starts empty.
+void Renderer::createPipelineCache(){
+  VkPhysicalDeviceProperties props{}; vkGetPhysicalDeviceProperties(m_physicalDevice, &props);
+  m_pipelineCacheKey.vendorID = props.vendorID;
+  m_pipelineCacheKey.deviceID = props.deviceID;
+  m_pipelineCacheKey.driverVersion = props.driverVersion;
+  std::copy(std::begin(props.pipelineCacheUUID), std::end(props.pipelineCacheUUID), m_pipelineCacheKey.pipelineCacheUUID.begin());
+  if(props.apiVersion >= VK_API_VERSION_1_1){
+    VkPhysicalDeviceIDProperties id{}; id.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    VkPhysicalDeviceProperties2 p2{}; p2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2; p2.pNext = &id;
+    vkGetPhysicalDeviceProperties2(m_physicalDevice, &p2);
+    std::copy(std::begin(id.deviceUUID), std::end(id.deviceUUID), m_pipelineCacheKey.deviceUUID.begin());
+  }
+  std::vector<uint8_t> data;
+  const auto status = PipelineCacheFile::load(m_pipelineCachePath, m_pipelineCacheKey, data);
+  if(status != PipelineCacheFile::Status::Ok && status != PipelineCacheFile::Status::Missing){
+    Log::warn("Discarding pipeline cache {}: {}", m_pipelineCachePath, PipelineCacheFile::describe(status));
+  }
+  VkPipelineCacheCreateInfo ci{}; ci.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  ci.initialDataSize = data.size(); ci.pInitialData = data.empty() ? nullptr : data.data();
+  if(vkCreatePipelineCache(m_device, &ci, nullptr, &m_pipelineCache) != VK_SUCCESS){
+    // The driver may still refuse data that passed our checks; start empty instead.
+    data.clear(); ci.initialDataSize = 0; ci.pInitialData = nullptr;
+    if(vkCreatePipelineCache(m_device, &ci, nullptr, &m_pipelineCache) != VK_SUCCESS){ throw std::runtime_error("Failed to create pipeline cache"); }
+  }
+  m_startup.warmCache = !data.empty();
+  m_startup.cacheBytes = data.size();
+}
+
+void Renderer::savePipelineCache(){
+  if(!m_pipelineCache) return;
+  size_t size = 0;
+  if(vkGetPipelineCacheData(m_device, m_pipelineCache, &size, nullptr) == VK_SUCCESS && size > 0){
+    std::vector<uint8_t> data(size);
+    if(vkGetPipelineCacheData(m_device, m_pipelineCache, &size, data.data()) == VK_SUCCESS){
+      data.resize(size);
+      if(!PipelineCacheFile::save(m_pipelineCachePath, m_pipelineCacheKey, data)){
+        Log::warn("Failed to write pipeline cache {}", m_pipelineCachePath);
+      }
+    }
+  }
+  vkDestroyPipelineCache(m_device, m_pipelineCache, nullptr);
+  m_pipelineCache = VK_NULL_HANDLE;
+}
+
+// Matches shaders/text_vert.glsl.
+struct TextPush { float pixelToClip[2]; };
+
+// Layouts, sampler and pipeline exist from the start; the atlas image and the
+// set's binding arrive with setFontAtlas().
+void Renderer::createText(){
+  const VkDescriptorSetLayoutBinding binding{0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr};
+  VkDescriptorSetLayoutCreateInfo li{}; li.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  li.bindingCount = 1; li.pBindings = &binding;
+  if(vkCreateDescriptorSetLayout(m_device, &li, nullptr, &m_textSetLayout) != VK_SUCCESS){ throw std::runtime_error("Failed to create text descriptor set layout"); }
+  const VkDescriptorPoolSize size{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1};
+  VkDescriptorPoolCreateInfo pi{}; pi.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pi.maxSets = 1; pi.poolSizeCount = 1; pi.pPoolSizes = &size;
+  if(vkCreateDescriptorPool(m_device, &pi, nullptr, &m_textDescriptorPool) != VK_SUCCESS){ throw std::runtime_error("Failed to create text descriptor pool"); }
+  VkDescriptorSetAllocateInfo ai{}; ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  ai.descriptorPool = m_textDescriptorPool; ai.descriptorSetCount = 1; ai.pSetLayouts = &m_textSetLayout;
+  if(vkAllocateDescriptorSets(m_device, &ai, &m_textSet) != VK_SUCCESS){ throw std::runtime_error("Failed to allocate text descriptor set"); }
+  const VkPushConstantRange push{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(TextPush)};
+  VkPipelineLayoutCreateInfo pl{}; pl.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pl.setLayoutCount = 1; pl.pSetLayouts = &m_textSetLayout;
+  pl.pushConstantRangeCount = 1; pl.pPushConstantRanges = &push;
+  if(vkCreatePipelineLayout(m_device, &pl, nullptr, &m_textPipelineLayout) != VK_SUCCESS){ throw std::runtime_error("Failed to create text pipeline layout"); }
+  // Linear filtering is what lets one distance field scale smoothly.
+  VkSamplerCreateInfo si{}; si.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  si.magFilter = VK_FILTER_LINEAR; si.minFilter = VK_FILTER_LINEAR; si.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  si.addressModeU = si.addressModeV = si.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  if(vkCreateSampler(m_device, &si, nullptr, &m_atlasSampler) != VK_SUCCESS){ throw std::runtime_error("Failed to create font atlas sampler"); }
+  m_textPipeline = createTextPipeline();
+}
+
+// Glyphs are instances of a four-vertex strip, alpha blended over the scene
+// with no depth test.
+VkPipeline Renderer::createTextPipeline() const {
+  const std::string dir = BLOCCO_SHADER_DIR;
+  VkShaderModule vert = vkutils::createShaderModule(m_device, dir + "/text_vert.spv");
+  VkShaderModule frag = VK_NULL_HANDLE;
+  try { frag = vkutils::createShaderModule(m_device, dir + "/text_frag.spv"); }
+  catch(...){ vkDestroyShaderModule(m_device, vert, nullptr); throw; }
+  VkPipelineShaderStageCreateInfo stages[2]{};
+  stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO; stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT; stages[0].module = vert; stages[0].pName = "main";
+  stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO; stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT; stages[1].module = frag; stages[1].pName = "main";
+  const VkVertexInputBindingDescription binding{0, sizeof(GlyphInstance), VK_VERTEX_INPUT_RATE_INSTANCE};
+  const VkVertexInputAttributeDescription attrs[] = {
+    {0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(GlyphInstance, x0)},
+    {1, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(GlyphInstance, u0)},
+    {2, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(GlyphInstance, color)}};
+  VkPipelineVertexInputStateCreateInfo vin{}; vin.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vin.vertexBindingDescriptionCount = 1; vin.pVertexBindingDescriptions = &binding;
+  vin.vertexAttributeDescriptionCount = 3; vin.pVertexAttributeDescriptions = attrs;
+  VkPipelineInputAssemblyStateCreateInfo ia{}; ia.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+  VkPipelineViewportStateCreateInfo vp{}; vp.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  vp.viewportCount = 1; vp.scissorCount = 1;
+  VkPipelineRasterizationStateCreateInfo rs{}; rs.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rs.polygonMode = VK_POLYGON_MODE_FILL; rs.lineWidth = 1.f; rs.cullMode = VK_CULL_MODE_NONE;
+  VkPipelineMultisampleStateCreateInfo ms{}; ms.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  ms.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+  VkPipelineDepthStencilStateCreateInfo ds{}; ds.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  VkPipelineColorBlendAttachmentState blend{};
+  blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  blend.blendEnable = VK_TRUE;
+  blend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA; blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA; blend.colorBlendOp = VK_BLEND_OP_ADD;
+  blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA; blend.alphaBlendOp = VK_BLEND_OP_ADD;
+  VkPipelineColorBlendStateCreateInfo cb{}; cb.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  cb.attachmentCount = 1; cb.pAttachments = &blend;
+  const VkDynamicState dynamics[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+  VkPipelineDynamicStateCreateInfo dyn{}; dyn.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dyn.dynamicStateCount = 2; dyn.pDynamicStates = dynamics;
+  VkGraphicsPipelineCreateInfo ci{}; ci.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  ci.stageCount = 2; ci.pStages = stages;
+  ci.pVertexInputState = &vin; ci.pInputAssemblyState = &ia; ci.pViewportState = &vp;
+  ci.pRasterizationState = &rs; ci.pMultisampleState = &ms; ci.pDepthStencilState = &ds;
+  ci.pColorBlendState = &cb; ci.pDynamicState = &dyn;
+  ci.layout = m_textPipelineLayout; ci.renderPass = m_renderPass; ci.subpass = 0;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  const VkResult r = vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &ci, nullptr, &pipeline);
+  vkDestroyShaderModule(m_device, vert, nullptr);
+  vkDestroyShaderModule(m_device, frag, nullptr);
+  if(r != VK_SUCCESS){ throw std::runtime_error("Failed to create text pipeline"); }
+  return pipeline;
+}
+
+// Uploaded through a staging buffer and a one-off command buffer; the wait is
+// fine for something done once at startup.
+void Renderer::setFontAtlas(const FontAtlas& atlas){
+  if(atlas.width == 0 || atlas.height == 0 || atlas.pixels.size() != size_t{atlas.width}*atlas.height){
+    throw std::runtime_error("Font atlas is empty or inconsistent");
+  }
+  if(m_atlasImage){
+    vkDeviceWaitIdle(m_device); // frames in flight may still sample the old atlas
+    vkDestroyImageView(m_device, m_atlasView, nullptr); m_atlasView = VK_NULL_HANDLE;
+    vkDestroyImage(m_device, m_atlasImage, nullptr); m_atlasImage = VK_NULL_HANDLE;
+    m_allocator->free(m_atlasMemory);
+  }
+  VkImageCreateInfo ii{}; ii.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  ii.imageType = VK_IMAGE_TYPE_2D; ii.format = VK_FORMAT_R8_UNORM;
+  ii.extent = {atlas.width, atlas.height, 1};
+  ii.mipLevels = 1; ii.arrayLayers = 1; ii.samples = VK_SAMPLE_COUNT_1_BIT;
+  ii.tiling = VK_IMAGE_TILING_OPTIMAL;
+  ii.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  ii.sharingMode = VK_SHARING_MODE_EXCLUSIVE; ii.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  if(vkCreateImage(m_device, &ii, nullptr, &m_atlasImage) != VK_SUCCESS){ throw std::runtime_error("Failed to create font atlas image"); }
+  m_atlasMemory = m_allocator->allocateImage(m_atlasImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  VkImageViewCreateInfo vi{}; vi.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  vi.image = m_atlasImage; vi.viewType = VK_IMAGE_VIEW_TYPE_2D; vi.format = VK_FORMAT_R8_UNORM;
+  vi.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  if(vkCreateImageView(m_device, &vi, nullptr, &m_atlasView) != VK_SUCCESS){ throw std::runtime_error("Failed to create font atlas view"); }
+
+  vkutils::AllocatedBuffer staging = m_allocator->createBuffer(atlas.pixels.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  std::memcpy(staging.mapped, atlas.pixels.data(), atlas.pixels.size());
+  VkCommandBufferAllocateInfo ai{}; ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  ai.commandPool = m_commandPool; ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY; ai.commandBufferCount = 1;
+  VkCommandBuffer cmd = VK_NULL_HANDLE;
+  if(vkAllocateCommandBuffers(m_device, &ai, &cmd) != VK_SUCCESS){ m_allocator->destroyBuffer(staging); throw std::runtime_error("Failed to allocate upload command buffer"); }
+  VkCommandBufferBeginInfo bi{}; bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO; bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(cmd, &bi);
+  VkImageMemoryBarrier barrier{}; barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED; barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED; barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = m_atlasImage; barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+  VkBufferImageCopy region{};
+  region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.imageExtent = {atlas.width, atlas.height, 1};
+  vkCmdCopyBufferToImage(cmd, staging.buffer, m_atlasImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT; barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL; barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+  vkEndCommandBuffer(cmd);
+  VkSubmitInfo submit{}; submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit.commandBufferCount = 1; submit.pCommandBuffers = &cmd;
+  const VkResult r = vkQueueSubmit(m_graphicsQueue, 1, &submit, VK_NULL_HANDLE);
+  if(r == VK_SUCCESS) vkQueueWaitIdle(m_graphicsQueue);
+  vkFreeCommandBuffers(m_device, m_commandPool, 1, &cmd);
+  m_allocator->destroyBuffer(staging);
+  if(r != VK_SUCCESS){ throw std::runtime_error("Failed to upload font atlas"); }
+
+  const VkDescriptorImageInfo image{m_atlasSampler, m_atlasView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  VkWriteDescriptorSet write{}; write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = m_textSet; write.dstBinding = 0;
+  write.descriptorCount = 1; write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER; write.pImageInfo = &image;
+  vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+  Log::info("Font atlas {}x{} uploaded", atlas.width, atlas.height);
+}
+
+// Lays the labels out against this frame's camera directly into the ring, so
+// there is no copy between the layout and the vertex buffer.
+void Renderer::drawText(Labels& labels){
+  beginFrame();
+  BLOCCO_ZONE("draw text");
+  const auto t0 = std::chrono::steady_clock::now();
+  const auto width = static_cast<float>(m_swapchainExtent.width), height = static_cast<float>(m_swapchainExtent.height);
+  const size_t capacity = m_atlasView ? labels.glyphCapacity() : 0;
+  if(capacity == 0){ labels.build(m_proj * m_view, width, height, {}); return; }
+  const vkutils::FrameRing::Slice slice = m_frameRing->allocate(VkDeviceSize{capacity}*sizeof(GlyphInstance));
+  const size_t n = labels.build(m_proj * m_view, width, height, {static_cast<GlyphInstance*>(slice.data), capacity});
+  if(n > 0) m_textRuns.push_back({slice.offset, static_cast<uint32_t>(n)});
+  m_textGlyphs += static_cast<uint32_t>(n);
+  m_textMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-t0).count();
+}
+
+// Inside the render pass, after the scene: one instanced draw per drawText() run.
+void Renderer::recordText(VkCommandBuffer cmd){
+  if(m_textRuns.empty()) return;
+  const VkViewport viewport{0.f, 0.f, static_cast<float>(m_swapchainExtent.width), static_cast<float>(m_swapchainExtent.height), 0.f, 1.f};
+  const VkRect2D scissor{{0, 0}, m_swapchainExtent};
+  vkCmdSetViewport(cmd, 0, 1, &viewport);
+  vkCmdSetScissor(cmd, 0, 1, &scissor);
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_textPipeline);
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_textPipelineLayout, 0, 1, &m_textSet, 0, nullptr);
+  const TextPush push{{2.f / viewport.width, 2.f / viewport.height}};
+  vkCmdPushConstants(cmd, m_textPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
+  const VkBuffer ring = m_frameRing->buffer();
+  for(const TextRun& run : m_textRuns){
+    vkCmdBindVertexBuffers(cmd, 0, 1, &ring, &run.offset);
+    vkCmdDraw(cmd, 4, run.count, 0, 0);
+  }
+}
+
+// Matches shaders/cull_comp.glsl (std140).
+struct CullUBO { Mat4 prevViewProj; Vec4 planes[6]; uint32_t depth[4]; uint32_t draws[4]; };
+static_assert(sizeof(CullUBO) == 192);
+static_assert(sizeof(DrawBounds) == 32);
+
+// Compute culling: one set per frame slot whose first three bindings point into
+// the frame ring (cull UBO, CPU-built commands, bounds) and the rest at the
+// slot's own output buffers and the depth pyramid.
+void Renderer::createCulling(){
+  if(!m_gpuCulling) return;
+  auto createLayouts = [&](std::span<const VkDescriptorSetLayoutBinding> bindings, VkDescriptorSetLayout& setLayout, VkPipelineLayout& layout){
+    VkDescriptorSetLayoutCreateInfo li{}; li.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    li.bindingCount = static_cast<uint32_t>(bindings.size()); li.pBindings = bindings.data();
+    if(vkCreateDescriptorSetLayout(m_device, &li, nullptr, &setLayout) != VK_SUCCESS){ throw std::runtime_error("Failed to create culling descriptor set layout"); }
+    VkPipelineLayoutCreateInfo pl{}; pl.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pl.setLayoutCount = 1; pl.pSetLayouts = &setLayout;
+    if(vkCreatePipelineLayout(m_device, &pl, nullptr, &layout) != VK_SUCCESS){ throw std::runtime_error("Failed to create culling pipeline layout"); }
+  };
+  auto createComputePipeline = [&](const std::string& file, VkPipelineLayout layout){
+    VkShaderModule module = vkutils::createShaderModule(m_device, std::string(BLOCCO_SHADER_DIR) + file);
+    VkComputePipelineCreateInfo ci{}; ci.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    ci.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO; ci.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    ci.stage.module = module; ci.stage.pName = "main";
+    ci.layout = layout;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    const VkResult r = vkCreateComputePipelines(m_device, m_pipelineCache, 1, &ci, nullptr, &pipeline);
+    vkDestroyShaderModule(m_device, module, nullptr);
+    if(r != VK_SUCCESS){ throw std::runtime_error("Failed to create compute pipeline " + file); }
+    return pipeline;
+  };
+  constexpr VkShaderStageFlags cs = VK_SHADER_STAGE_COMPUTE_BIT;
+  const VkDescriptorSetLayoutBinding cullBindings[] = {
+    {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, cs, nullptr},
+    {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, cs, nullptr},
+    {2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, cs, nullptr},
+    {3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, cs, nullptr},
+    {4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, cs, nullptr},
+    {5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, cs, nullptr}};
+  const VkDescriptorSetLayoutBinding pyramidBindings[] = {
+    {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, cs, nullptr},
+    {1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, cs, nullptr}};
+  createLayouts(cullBindings, m_cullSetLayout, m_cullPipelineLayout);
+  createLayouts(pyramidBindings, m_pyramidSetLayout, m_pyramidPipelineLayout);
+  m_cullPipeline = createComputePipeline("/cull_comp.spv", m_cullPipelineLayout);
+  m_pyramidPipeline = createComputePipeline("/depth_pyramid_comp.spv", m_pyramidPipelineLayout);
+  // Both shaders only texelFetch; the sampler exists because the bindings are combined.
+  VkSamplerCreateInfo si{}; si.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  si.magFilter = VK_FILTER_NEAREST; si.minFilter = VK_FILTER_NEAREST; si.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  si.addressModeU = si.addressModeV = si.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  si.maxLod = VK_LOD_CLAMP_NONE;
+  if(vkCreateSampler(m_device, &si, nullptr, &m_pyramidSampler) != VK_SUCCESS){ throw std::runtime_error("Failed to create depth pyramid sampler"); }
+  const uint32_t slots = m_framesInFlight;
+  const VkDescriptorPoolSize sizes[] = {{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, slots}, {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4*slots}, {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, slots}};
+  VkDescriptorPoolCreateInfo pi{}; pi.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pi.maxSets = slots; pi.poolSizeCount = 3; pi.pPoolSizes = sizes;
+  if(vkCreateDescriptorPool(m_device, &pi, nullptr, &m_cullDescriptorPool) != VK_SUCCESS){ throw std::runtime_error("Failed to create culling descriptor pool"); }
+  const std::vector<VkDescriptorSetLayout> layouts(slots, m_cullSetLayout);
+  std::vector<VkDescriptorSet> sets(slots);
+  VkDescriptorSetAllocateInfo ai{}; ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  ai.descriptorPool = m_cullDescriptorPool; ai.descriptorSetCount = slots; ai.pSetLayouts = layouts.data();
+  if(vkAllocateDescriptorSets(m_device, &ai, sets.data()) != VK_SUCCESS){ throw std::runtime_error("Failed to allocate culling descriptor sets"); }
+  m_cullSlots.resize(slots);
+  const VkDescriptorBufferInfo ubo{m_frameRing->buffer(), 0, sizeof(CullUBO)};
+  const VkDescriptorBufferInfo ring{m_frameRing->buffer(), 0, VK_WHOLE_SIZE};
+  for(uint32_t i=0;i<slots;++i){
+    m_cullSlots[i].set = sets[i];
+    VkWriteDescriptorSet writes[3]{};
+    const VkDescriptorBufferInfo* infos[3] = {&ubo, &ring, &ring};
+    for(uint32_t b=0;b<3;++b){
+      writes[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[b].dstSet = sets[i]; writes[b].dstBinding = b;
+      writes[b].descriptorCount = 1; writes[b].descriptorType = cullBindings[b].descriptorType;
+      writes[b].pBufferInfo = infos[b];
+    }
+    vkUpdateDescriptorSets(m_device, 3, writes, 0, nullptr);
+  }
+}
+
+// The pyramid always exists with GPU culling so the cull set's sampler binding
+// is valid; it is only built (and tested against) when the depth can be sampled.
+void Renderer::createDepthPyramid(){
+  DepthPyramidTarget& p = m_pyramid;
+  const uint32_t w = m_swapchainExtent.width, h = m_swapchainExtent.height;
+  p.levels = DepthPyramid::levelCount(w, h);
+  p.generation = ++m_pyramidGenerations;
+  p.initialized = false;
+  VkImageCreateInfo ii{}; ii.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  ii.imageType = VK_IMAGE_TYPE_2D; ii.format = VK_FORMAT_R32_SFLOAT;
+  ii.extent = {DepthPyramid::levelSize(w, 0), DepthPyramid::levelSize(h, 0), 1};
+  ii.mipLevels = p.levels; ii.arrayLayers = 1; ii.samples = VK_SAMPLE_COUNT_1_BIT;
+  ii.tiling = VK_IMAGE_TILING_OPTIMAL;
+  ii.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  ii.sharingMode = VK_SHARING_MODE_EXCLUSIVE; ii.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  if(vkCreateImage(m_device, &ii, nullptr, &p.image) != VK_SUCCESS){ throw std::runtime_error("Failed to create depth pyramid"); }
+  p.memory = m_allocator->allocateImage(p.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  VkImageViewCreateInfo vi{}; vi.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  vi.image = p.image; vi.viewType = VK_IMAGE_VIEW_TYPE_2D; vi.format = VK_FORMAT_R32_SFLOAT;
+  vi.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, p.levels, 0, 1};
+  if(vkCreateImageView(m_device, &vi, nullptr, &p.view) != VK_SUCCESS){ throw std::runtime_error("Failed to create depth pyramid view"); }
+  if(!m_hiz) return;
+  p.levelViews.resize(p.levels);
+  for(uint32_t l=0;l<p.levels;++l){
+    vi.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, l, 1, 0, 1};
+    if(vkCreateImageView(m_device, &vi, nullptr, &p.levelViews[l]) != VK_SUCCESS){ throw std::runtime_error("Failed to create depth pyramid level view"); }
+  }
+  const VkDescriptorPoolSize sizes[] = {{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, p.levels}, {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, p.levels}};
+  VkDescriptorPoolCreateInfo pi{}; pi.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pi.maxSets = p.levels; pi.poolSizeCount = 2; pi.pPoolSizes = sizes;
+  if(vkCreateDescriptorPool(m_device, &pi, nullptr, &p.pool) != VK_SUCCESS){ throw std::runtime_error("Failed to create depth pyramid descriptor pool"); }
+  const std::vector<VkDescriptorSetLayout> layouts(p.levels, m_pyramidSetLayout);
+  p.sets.resize(p.levels);
+  VkDescriptorSetAllocateInfo ai{}; ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  ai.descriptorPool = p.pool; ai.descriptorSetCount = p.levels; ai.pSetLayouts = layouts.data();
+  if(vkAllocateDescriptorSets(m_device, &ai, p.sets.data()) != VK_SUCCESS){ throw std::runtime_error("Failed to allocate depth pyramid descriptor sets"); }
+  for(uint32_t l=0;l<p.levels;++l){
+    // Level 0 reduces the depth buffer itself, every other level the one before it.
+    const VkDescriptorImageInfo src = l == 0
+      ? VkDescriptorImageInfo{m_pyramidSampler, m_depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL}
+      : VkDescriptorImageInfo{m_pyramidSampler, p.levelViews[l-1], VK_IMAGE_LAYOUT_GENERAL};
+    const VkDescriptorImageInfo dst{VK_NULL_HANDLE, p.levelViews[l], VK_IMAGE_LAYOUT_GENERAL};
+    VkWriteDescriptorSet writes[2]{};
+    writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET; writes[0].dstSet = p.sets[l]; writes[0].dstBinding = 0;
+    writes[0].descriptorCount = 1; writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER; writes[0].pImageInfo = &src;
+    writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET; writes[1].dstSet = p.sets[l]; writes[1].dstBinding = 1;
+    writes[1].descriptorCount = 1; writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE; writes[1].pImageInfo = &dst;
+    vkUpdateDescriptorSets(m_device, 2, writes, 0, nullptr);
+  }
+}
+
+void Renderer::destroyDepthPyramid(DepthPyramidTarget& p){
+  if(p.pool) vkDestroyDescriptorPool(m_device, p.pool, nullptr);
+  for(auto v : p.levelViews) vkDestroyImageView(m_device, v, nullptr);
+  if(p.view) vkDestroyImageView(m_device, p.view, nullptr);
+  if(p.image) vkDestroyImage(m_device, p.image, nullptr);
+  m_allocator->free(p.memory);
+  p = {};
+}
+
+Renderer::Mesh Renderer::uploadMesh(const MeshBuffers& mesh){
+  if(mesh.format != m_vertexFormat) throw std::runtime_error("Mesh vertex format does not match the renderer");
+  Mesh m;
+  if(mesh.empty()) return m;
+  const bool packed = m_vertexFormat == VertexFormat::Packed;
+  if(packed && mesh.quadCount() > MAX_MESH_QUADS) throw std::runtime_error("Mesh exceeds the quad index buffer");
+  const void* vertices = packed ? static_cast<const void*>(mesh.packed.data()) : static_cast<const void*>(mesh.vertices.data());
+  const auto vertexCount = static_cast<uint32_t>(packed ? mesh.packed.size() : mesh.vertices.size());
+  const VkDeviceSize vertexBytes = VkDeviceSize{vertexCount} * m_meshPool->vertexStride();
+  const auto indexCount = static_cast<uint32_t>(mesh.indices.size());
+  if(m_uploads){
+    m.alloc = m_meshPool->allocate(vertexCount, indexCount);
+    if(m.valid()){
+      // Both copies usually share a batch; the index copy's is never the earlier one.
+      m.upload = m_uploads->write(m_meshPool->vertexBuffer(), m.alloc.vertices.offset, vertices, vertexBytes);
+      if(indexCount > 0) m.upload = m_uploads->write(m_meshPool->indexBuffer(), m.alloc.indices.offset, mesh.indices.data(), VkDeviceSize{indexCount} * sizeof(uint32_t));
+    }
+  } else {
+    m.alloc = m_meshPool->upload(vertices, vertexCount, mesh.indices.data(), indexCount);
+  }
+  if(!m.valid()) throw std::runtime_error("Mesh pool exhausted");
+  if(packed){ // every mesh starts at quad 0 of the shared index buffer
+    m.alloc.indexCount = static_cast<uint32_t>(mesh.quadCount() * 6);
+    m.alloc.firstIndex = 0;
+  }
+  m_pendingUploadBytes += vertexBytes + uint64_t{indexCount} * sizeof(uint32_t);
+  auto grow = [&](float x, float y, float z){
+    m.boundsMin = {std::min(m.boundsMin.x, x), std::min(m.boundsMin.y, y), std::min(m.boundsMin.z, z)};
+    m.boundsMax = {std::max(m.boundsMax.x, x), std::max(m.boundsMax.y, y), std::max(m.boundsMax.z, z)};
+  };
+  if(packed){
+    const PackedVertex& p0 = mesh.packed.front();
+    m.boundsMin = m.boundsMax = {static_cast<float>(p0.x()), static_cast<float>(p0.y()), static_cast<float>(p0.z())};
+    for(const PackedVertex& v : mesh.packed) grow(static_cast<float>(v.x()), static_cast<float>(v.y()), static_cast<float>(v.z()));
+  } else {
+    const float* p0 = mesh.vertices.front().pos;
+    m.boundsMin = m.boundsMax = {p0[0], p0[1], p0[2]};
+    for(const Vertex& v : mesh.vertices) grow(v.pos[0], v.pos[1], v.pos[2]);
+  }
+  return m;
+}
+
+// Fragmentation and largest free are the vertex buffer's.
+MemoryStats Renderer::meshMemory() const {
+  MemoryStats s = m_meshPool->vertexStats();
+  if(m_vertexFormat == VertexFormat::Packed) return s;
+  const MemoryStats i = m_meshPool->indexStats();
+  s.capacity += i.capacity; s.inUse += i.inUse; s.peak += i.peak; s.allocations += i.allocations;
+  return s;
+}
+
+void Renderer::releaseMesh(Mesh& mesh){
+  if(mesh.valid()) m_retiredMeshes.push_back({mesh.alloc, m_frameIndex, mesh.upload});
+  mesh = {};
+}
+
+void Renderer::setCamera(const Mat4& view, const Mat4& proj){
+  m_view = view;
+  m_proj = proj;
+  m_frustum = extractFrustum(proj * view);
+}
+
+void Renderer::submitDraw(const Mesh& mesh, uint32_t material, const Mat4& model, Pipeline pipeline){
+  if(!mesh.valid() || mesh.upload > m_uploadsAcquired) return; // still in flight on the upload queue
+  Vec3 boundsMin, boundsMax;
+  transformBounds(model, mesh.boundsMin, mesh.boundsMax, boundsMin, boundsMax);
+  // Without the compute pass the frustum test runs here; occlusion needs the GPU.
+  if(!m_gpuCulling && m_cullingEnabled && !frustumVisible(m_frustum, boundsMin, boundsMax)){ ++m_cpuCulled; return; }
+  // View-space distance of the model origin: view row 2 dotted with the translation.
+  const float depth = -(m_view.m[2]*model.m[12] + m_view.m[6]*model.m[13] + m_view.m[10]*model.m[14] + m_view.m[14]);
+  m_drawList.add(static_cast<uint32_t>(pipeline), material, {mesh.alloc.indexCount, mesh.alloc.firstIndex, mesh.alloc.vertexOffset}, model, depth, boundsMin, boundsMax);
+}
+
+static_assert(sizeof(DrawIndexedIndirect) == sizeof(VkDrawIndexedIndirectCommand));
+
+// Outside the render pass: sorts this frame's draws, writes the uniforms and
+// carves the transforms, indirect commands and bounds out of the frame ring and,
+// with GPU culling, dispatches the cull pass that fills the frame slot's command
+// buffer for the draws.
+void Renderer::prepareDraws(VkCommandBuffer cmd){
+  BLOCCO_ZONE("prepare draws");
+  const auto t0 = std::chrono::steady_clock::now();
+  const auto n = static_cast<uint32_t>(m_drawList.size());
+  const bool cull = m_gpuCulling && m_cullingEnabled && n > 0;
+  m_lastDraws = n + m_cpuCulled;
+  m_lastCpuCulled = m_cpuCulled;
+  m_lastVisible = cull ? 0 : n; // GPU results arrive with the frame's timings
+  m_cpuCulled = 0;
+  m_lastRecordMs = 0.0;
+  m_frameDraws = {};
+  if(n == 0) return;
+  const vkutils::FrameRing::Slice camera = m_frameRing->allocate(sizeof(CameraUBO));
+  *static_cast<CameraUBO*>(camera.data) = {m_view, m_proj};
+  const vkutils::FrameRing::Slice scene = m_frameRing->allocate(sizeof(SceneUBO));
+  *static_cast<SceneUBO*>(scene.data) = {{-0.4f, -1.f, -0.3f}, 0.f, {0.55f, 0.75f, 0.45f}, 0.f};
+  const vkutils::FrameRing::Slice transforms = m_frameRing->allocate(VkDeviceSize{n}*sizeof(Mat4), sizeof(Mat4));
+  const vkutils::FrameRing::Slice commands = m_frameRing->allocate(VkDeviceSize{n}*sizeof(DrawIndexedIndirect));
+  vkutils::FrameRing::Slice bounds;
+  if(cull) bounds = m_frameRing->allocate(VkDeviceSize{n}*sizeof(DrawBounds), sizeof(DrawBounds));
+  // Only sorted here; the commands, transforms and bounds are written by
+  // recordDrawsParallel() before submission.
+  const auto batches = m_drawList.sort();
+  m_frameDraws = {batches, n, static_cast<DrawIndexedIndirect*>(commands.data), static_cast<Mat4*>(transforms.data),
+                  cull ? static_cast<DrawBounds*>(bounds.data) : nullptr, static_cast<uint32_t>(transforms.offset / sizeof(Mat4)),
+                  commands.offset, {static_cast<uint32_t>(camera.offset), static_cast<uint32_t>(scene.offset)}, cull};
+  if(cull){
+    CullSlot& slot = m_cullSlots[m_currentFrame];
+    if(slot.capacity < n){
+      // beginFrame() waited on this slot's last frame, so its buffers are free to replace.
+      m_allocator->destroyBuffer(slot.commands);
+      slot.capacity = std::bit_ceil(std::max(n, 1024u));
+      slot.commands = m_allocator->createBuffer(VkDeviceSize{slot.capacity}*sizeof(DrawIndexedIndirect),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+      if(!slot.counts.buffer){
+        slot.counts = m_allocator->createBuffer((CULL_COUNTS_HEADER + DrawList::MAX_PIPELINES)*sizeof(uint32_t),
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+      }
+      const VkDescriptorBufferInfo infos[] = {{slot.commands.buffer, 0, VK_WHOLE_SIZE}, {slot.counts.buffer, 0, VK_WHOLE_SIZE}};
+      VkWriteDescriptorSet writes[2]{};
+      for(uint32_t i=0;i<2;++i){
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = slot.set; writes[i].dstBinding = 3 + i;
+        writes[i].descriptorCount = 1; writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &infos[i];
+      }
+      vkUpdateDescriptorSets(m_device, 2, writes, 0, nullptr);
+    }
+    if(slot.pyramidGeneration != m_pyramid.generation){
+      const VkDescriptorImageInfo image{m_pyramidSampler, m_pyramid.view, VK_IMAGE_LAYOUT_GENERAL};
+      VkWriteDescriptorSet write{}; write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      write.dstSet = slot.set; write.dstBinding = 5;
+      write.descriptorCount = 1; write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER; write.pImageInfo = &image;
+      vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+      slot.pyramidGeneration = m_pyramid.generation;
+    }
+    if(!m_pyramid.initialized){
+      VkImageMemoryBarrier init{}; init.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      init.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+      init.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED; init.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+      init.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED; init.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      init.image = m_pyramid.image; init.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, m_pyramid.levels, 0, 1};
+      vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &init);
+      m_pyramid.initialized = true;
+    }
+    std::memset(slot.counts.mapped, 0, (CULL_COUNTS_HEADER + batches.size())*sizeof(uint32_t));
+    const vkutils::FrameRing::Slice uboSlice = m_frameRing->allocate(sizeof(CullUBO));
+    auto& ubo = *static_cast<CullUBO*>(uboSlice.data);
+    ubo.prevViewProj = m_pyramidViewProj;
+    std::copy(std::begin(m_frustum.planes), std::end(m_frustum.planes), ubo.planes);
+    const bool occlusion = m_hiz && m_pyramidValid;
+    ubo.depth[0] = m_swapchainExtent.width; ubo.depth[1] = m_swapchainExtent.height;
+    ubo.depth[2] = m_pyramid.levels; ubo.depth[3] = occlusion ? 1u : 0u;
+    ubo.draws[0] = n;
+    ubo.draws[1] = static_cast<uint32_t>(commands.offset / sizeof(uint32_t));
+    ubo.draws[2] = static_cast<uint32_t>(bounds.offset / sizeof(DrawBounds));
+    ubo.draws[3] = m_drawIndirectCount ? 1u : 0u;
+    const auto uboOffset = static_cast<uint32_t>(uboSlice.offset);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipelineLayout, 0, 1, &slot.set, 1, &uboOffset);
+    vkCmdDispatch(cmd, (n + 63) / 64, 1, 1);
+    VkMemoryBarrier culled{}; culled.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    culled.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    culled.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &culled, 0, nullptr, 0, nullptr);
+    slot.pending = true;
+  }
+  m_lastRecordMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-t0).count();
+}
+
+void Renderer::setJobSystem(JobSystem* jobs){
+  if(jobs != m_jobs) finishPipelines(); // they run on the old system
+  destroyRecordPools();
+  m_jobs = jobs;
+  if(!m_jobs) return;
+  m_recordPools.resize(size_t{m_framesInFlight} * (m_jobs->threadCount() + 1));
+  for(RecordPool& p : m_recordPools){
+    VkCommandPoolCreateInfo ci{}; ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    ci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; ci.queueFamilyIndex = m_graphicsQueueFamily;
+    if(vkCreateCommandPool(m_device, &ci, nullptr, &p.pool) != VK_SUCCESS){ throw std::runtime_error("Failed to create recording command pool"); }
+  }
+}
+
+void Renderer::destroyRecordPools(){
+  for(RecordPool& p : m_recordPools) if(p.pool) vkDestroyCommandPool(m_device, p.pool, nullptr);
+  m_recordPools.clear();
+}
+
+// Writes this frame's sorted draws and, for large frames, records them on the
+// job system: one secondary command buffer per chunk, from the pool of the
+// worker that picked the chunk up. The primary executes them in chunk order, so
+// the frame never depends on scheduling; text follows in one more secondary.
+// Returns false, with everything written
+// on this thread, when the draws are left for recordDraws() to record inline.
+bool Renderer::recordDrawsParallel(VkFramebuffer framebuffer){
+  const FrameDraws& f = m_frameDraws;
+  m_chunkBuffers.clear();
+  if(f.count == 0) return false;
+  const auto t0 = std::chrono::steady_clock::now();
+  const std::span<DrawIndexedIndirect> commands{f.commands, f.count};
+  const std::span<Mat4> transforms{f.transforms, f.count};
+  const std::span<DrawBounds> bounds = f.bounds ? std::span<DrawBounds>{f.bounds, f.count} : std::span<DrawBounds>{};
+  const uint32_t workers = m_jobs ? m_jobs->threadCount() : 1;
+  if(!m_parallelRecording || workers < 2 || f.count < PARALLEL_RECORD_MIN_DRAWS){
+    m_drawList.write(0, f.count, commands, transforms, bounds, f.transformBase);
+    m_lastRecordMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-t0).count();
+    return false;
+  }
+  // A few chunks per worker so stealing evens out the uneven ones.
+  const uint32_t chunkDraws = std::max(RECORD_CHUNK_MIN_DRAWS, (f.count + 4*workers - 1) / (4*workers));
+  m_drawList.split(chunkDraws, m_chunks);
+  m_chunkBuffers.assign(m_chunks.size(), VK_NULL_HANDLE);
+  // beginFrame() waited for this slot's last frame, so its pools are idle.
+  RecordPool* pools = &m_recordPools[size_t{m_currentFrame} * (workers + 1)];
+  for(uint32_t w=0;w<=workers;++w){ vkResetCommandPool(m_device, pools[w].pool, 0); pools[w].used = 0; }
+  VkCommandBufferInheritanceInfo inherit{}; inherit.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inherit.renderPass = m_renderPass; inherit.subpass = 0; inherit.framebuffer = framebuffer;
+  VkCommandBufferBeginInfo bi{}; bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  bi.pInheritanceInfo = &inherit;
+  // Compacted batches are drawn whole, by the chunk that starts them.
+  const bool wholeBatches = f.culled && m_drawIndirectCount;
+  std::atomic<bool> failed{false};
+  m_jobs->parallelFor(0, m_chunks.size(), 1, [&](size_t begin, size_t end){
+    BLOCCO_ZONE("record draws");
+    RecordPool& pool = pools[m_jobs->currentWorker() + 1];
+    for(size_t i=begin;i<end;++i){
+      const DrawChunk& c = m_chunks[i];
+      m_drawList.write(c.first, c.count, commands, transforms, bounds, f.transformBase);
+      if(wholeBatches && c.first != f.batches[c.batch].first) continue;
+      VkCommandBuffer cmd = nextSecondary(pool);
+      if(!cmd || vkBeginCommandBuffer(cmd, &bi) != VK_SUCCESS){ failed = true; return; }
+      recordChunk(cmd, c);
+      if(vkEndCommandBuffer(cmd) != VK_SUCCESS){ failed = true; return; }
+      m_chunkBuffers[i] = cmd;
+    }
+  });
+  if(failed) throw std::runtime_error("Failed to record secondary command buffers");
+  std::erase(m_chunkBuffers, VK_NULL_HANDLE);
+  // Text goes last, over the scene, from this thread's pool now the workers are done.
+  if(!m_textRuns.empty()){
+    VkCommandBuffer cmd = nextSecondary(pools[m_jobs->currentWorker() + 1]);
+    if(!cmd || vkBeginCommandBuffer(cmd, &bi) != VK_SUCCESS) throw std::runtime_error("Failed to record text command buffer");
+    recordText(cmd);
+    if(vkEndCommandBuffer(cmd) != VK_SUCCESS) throw std::runtime_error("Failed to record text command buffer");
+    m_chunkBuffers.push_back(cmd);
+  }
+  m_lastRecordMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-t0).count();
+  return true;
+}
+
+VkCommandBuffer Renderer::nextSecondary(RecordPool& pool){
+  if(pool.used == pool.buffers.size()){
+    VkCommandBufferAllocateInfo ai{}; ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    ai.commandPool = pool.pool; ai.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY; ai.commandBufferCount = 1;
+    VkCommandBuffer buffer = VK_NULL_HANDLE;
+    if(vkAllocateCommandBuffers(m_device, &ai, &buffer) != VK_SUCCESS) return VK_NULL_HANDLE;
+    pool.buffers.push_back(buffer);
+  }
+  return pool.buffers[pool.used++];
+}
+
+// Records every batch into the primary buffer, inside the render pass.
+void Renderer::recordDraws(VkCommandBuffer cmd){
+  if(m_frameDraws.count == 0) return;
+  const auto t0 = std::chrono::steady_clock::now();
+  m_drawList.split(UINT32_MAX, m_chunks);
+  for(const DrawChunk& c : m_chunks) recordChunk(cmd, c);
+  m_lastRecordMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-t0).count();
+}
+
+// Draws one chunk with all the state it needs (secondary buffers inherit none):
+// from the cull pass's output when it ran, bounded by the surviving count with
+// drawIndirectCount, else straight from the ring.
+void Renderer::recordChunk(VkCommandBuffer cmd, const DrawChunk& chunk){
+  const FrameDraws& f = m_frameDraws;
+  const VkViewport viewport{0.f, 0.f, static_cast<float>(m_swapchainExtent.width), static_cast<float>(m_swapchainExtent.height), 0.f, 1.f};
+  const VkRect2D scissor{{0, 0}, m_swapchainExtent};
+  vkCmdSetViewport(cmd, 0, 1, &viewport);
+  vkCmdSetScissor(cmd, 0, 1, &scissor);
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, boundPipeline(f.batches[chunk.batch].pipeline));
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSet, 2, f.dynamicOffsets);
+  if(!m_vertexPulling){
+    const VkBuffer vb = m_meshPool->vertexBuffer();
+    const VkDeviceSize vbOffset = 0;
+    vkCmdBindVertexBuffers(cmd, 0, 1, &vb, &vbOffset);
+  }
+  vkCmdBindIndexBuffer(cmd, m_vertexFormat == VertexFormat::Packed ? m_quadIndices.buffer : m_meshPool->indexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+  const CullSlot* slot = f.culled ? &m_cullSlots[m_currentFrame] : nullptr;
+  const VkBuffer indirect = slot ? slot->commands.buffer : m_frameRing->buffer();
+  const VkDeviceSize base = slot ? 0 : f.commandOffset;
+  if(slot && m_drawIndirectCount){
+    const DrawBatch& b = f.batches[chunk.batch];
+    vkCmdDrawIndexedIndirectCount(cmd, indirect, VkDeviceSize{b.first}*sizeof(DrawIndexedIndirect),
+      slot->counts.buffer, (CULL_COUNTS_HEADER + chunk.batch)*sizeof(uint32_t), b.count, sizeof(DrawIndexedIndirect));
+  } else if(m_indirectDraws){
+    for(uint32_t first = chunk.first; first < chunk.first + chunk.count; first += m_maxDrawIndirectCount){
+      const uint32_t count = std::min(m_maxDrawIndirectCount, chunk.first + chunk.count - first);
+      vkCmdDrawIndexedIndirect(cmd, indirect, base + VkDeviceSize{first}*sizeof(DrawIndexedIndirect), count, sizeof(DrawIndexedIndirect));
+    }
+  } else {
+    for(uint32_t i = chunk.first; i < chunk.first + chunk.count; ++i)
+      vkCmdDrawIndexed(cmd, f.commands[i].indexCount, 1, f.commands[i].firstIndex, f.commands[i].vertexOffset, f.commands[i].firstInstance);
+  }
+}
+
+// After the render pass: reduces this frame's depth into the pyramid the next
+// frame's cull pass tests against, with the viewProj it was rendered with.
+void Renderer::buildDepthPyramid(VkCommandBuffer cmd){
+  if(!m_frameDraws.culled){
+    // Depth of an unculled frame is fine to test against, but culling may stay
+    // off for a while; start from a fresh pyramid when it comes back.
+    m_pyramidValid = false;
+    return;
+  }
+  if(!m_hiz) return;
+  const DepthPyramidTarget& p = m_pyramid;
+  // The cull pass at the start of this frame read the pyramid: finish before overwriting it.
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pyramidPipeline);
+  VkImageMemoryBarrier level{}; level.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  level.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT; level.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  level.oldLayout = VK_IMAGE_LAYOUT_GENERAL; level.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  level.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED; level.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  level.image = p.image;
+  for(uint32_t l=0;l<p.levels;++l){
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pyramidPipelineLayout, 0, 1, &p.sets[l], 0, nullptr);
+    vkCmdDispatch(cmd, (DepthPyramid::levelSize(m_swapchainExtent.width, l) + 7) / 8, (DepthPyramid::levelSize(m_swapchainExtent.height, l) + 7) / 8, 1);
+    // Read by the next level, and the last barrier also covers next frame's cull pass.
+    level.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, l, 1, 0, 1};
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &level);
+  }
+  m_pyramidViewProj = m_proj * m_view;
+  m_pyramidValid = true;
+}
+
+// Must run before collectTimings(), which forgets which frame the slot held.
+void Renderer::collectCullStats(size_t slot){
+  if(slot >= m_cullSlots.size() || !m_cullSlots[slot].pending) return;
+  CullSlot& c = m_cullSlots[slot];
+  c.pending = false;
+  if(m_slotFrame[slot] < 0) return;
+  const auto frame = static_cast<uint32_t>(m_slotFrame[slot]);
+  const auto* counts = static_cast<const uint32_t*>(c.counts.mapped);
+  auto apply = [&](FrameStats& s){ s.frustumCulled += counts[0]; s.occlusionCulled = counts[1]; s.visible = counts[2]; };
+  if(m_lastStats.frame == frame) apply(m_lastStats);
+  if(frame < m_frameStats.size()) apply(m_frameStats[frame]);
+}
+
+void Renderer::createTimestampQueries(){
+  VkPhysicalDeviceProperties props{}; vkGetPhysicalDeviceProperties(m_physicalDevice, &props);
+  uint32_t qCount=0; vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &qCount, nullptr);
+  std::vector<VkQueueFamilyProperties> qprops(qCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &qCount, qprops.data());
+  const uint32_t validBits = qprops[m_graphicsQueueFamily].timestampValidBits;
+  if(validBits == 0){ Log::warn("GPU timestamps unsupported; GPU frame time unavailable"); return; }
+  m_timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+  m_timestampPeriod = props.limits.timestampPeriod;
+  VkQueryPoolCreateInfo ci{}; ci.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  ci.queryType = VK_QUERY_TYPE_TIMESTAMP; ci.queryCount = TIMESTAMPS_PER_FRAME*m_framesInFlight;
+  if(vkCreateQueryPool(m_device, &ci, nullptr, &m_timestampPool) != VK_SUCCESS){ throw std::runtime_error("Failed to create timestamp query pool"); }
+}
+
 void Renderer::recordCommandBuffer(VkCommandBuffer cmd, uint32_t imageIndex){
+  BLOCCO_ZONE("record commands");
   VkCommandBufferBeginInfo bi{}; bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO; bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
   if(vkBeginCommandBuffer(cmd, &bi) != VK_SUCCESS) throw std::runtime_error("Begin cmd buffer failed");
-  VkClearValue clear{}; clear.color = {{0.02f,0.02f,0.05f,1.0f}};
+  const auto query = static_cast<uint32_t>(m_currentFrame*TIMESTAMPS_PER_FRAME);
+  auto timestamp = [&](VkPipelineStageFlagBits stage, uint32_t i){
+    if(m_timestampPool) vkCmdWriteTimestamp(cmd, stage, m_timestampPool, query + i);
+  };
+  if(m_timestampPool) vkCmdResetQueryPool(cmd, m_timestampPool, query, TIMESTAMPS_PER_FRAME);
+  timestamp(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
+  if(m_uploads) m_uploads->recordAcquire(cmd, m_uploadsAcquired, MESH_READ_STAGES, MESH_READ_ACCESS);
+  prepareDraws(cmd);
+  timestamp(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 1);
+  const VkFramebuffer framebuffer = m_framebuffers[imageIndex];
+  const bool secondaries = recordDrawsParallel(framebuffer);
+  VkClearValue clear[2]{}; clear[0].color = {{0.02f,0.02f,0.05f,1.0f}}; clear[1].depthStencil = {1.0f, 0};
   VkRenderPassBeginInfo rp{}; rp.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-  rp.renderPass = m_renderPass; rp.framebuffer = m_framebuffers[imageIndex];
+  rp.renderPass = m_renderPass; rp.framebuffer = framebuffer;
   rp.renderArea.offset = {0,0}; rp.renderArea.extent = m_swapchainExtent;
-  rp.clearValueCount = 1; rp.pClearValues = &clear;
-  vkCmdBeginRenderPass(cmd, &rp, VK_SUBPASS_CONTENTS_INLINE);
-  // (No pipeline yet) just clear
+  rp.clearValueCount = 2; rp.pClearValues = clear;
+  vkCmdBeginRenderPass(cmd, &rp, secondaries ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+  if(secondaries){
+    if(!m_chunkBuffers.empty()) vkCmdExecuteCommands(cmd, static_cast<uint32_t>(m_chunkBuffers.size()), m_chunkBuffers.data());
+  } else {
+    recordDraws(cmd);
+    recordText(cmd);
+  }
   vkCmdEndRenderPass(cmd);
+  timestamp(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 2);
+  m_drawList.clear();
+  m_textRuns.clear();
+  buildDepthPyramid(cmd);
+  timestamp(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 3);
+  if(m_headless && m_slotReadback[m_currentFrame] >= 0){
+    // Render pass left the target in TRANSFER_SRC_OPTIMAL; read it back for the host.
+    const vkutils::AllocatedBuffer& dst = m_readback[static_cast<size_t>(m_slotReadback[m_currentFrame])];
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {m_swapchainExtent.width, m_swapchainExtent.height, 1};
+    vkCmdCopyImageToBuffer(cmd, m_offscreenImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst.buffer, 1, &region);
+    VkBufferMemoryBarrier toHost{}; toHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT; toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED; toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toHost.buffer = dst.buffer; toHost.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &toHost, 0, nullptr);
+  }
+  timestamp(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TIMESTAMPS_PER_FRAME - 1);
   if(vkEndCommandBuffer(cmd) != VK_SUCCESS) throw std::runtime_error("End cmd buffer failed");
 }
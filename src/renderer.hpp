@@ -1,14 +1,153 @@
 #pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
 #include <vector>
 #include <string>
 #include <vulkan/vulkan.h>
+#include "vk_utils.hpp"
+#include "vk_memory.hpp"
+#include "vk_upload.hpp"
+#include "capture.hpp"
+#include "config.hpp"
+#include "culling.hpp"
+#include "draw_list.hpp"
+#include "math.hpp"
+#include "pipeline_cache.hpp"
 struct SDL_Window;
+struct MeshBuffers;
+enum class VertexFormat : uint8_t;
+struct FontAtlas;
+class JobCounter;
+class JobSystem;
+class Labels;
+// CPU time runs from the end of beginFrame's waits to submission (simulation plus
+// recording); gpuMs is measured with timestamp queries and is negative until the
+// frame's fence has signalled. recordMs is the part of cpuMs spent building and
+// recording the frame's draws. draws counts everything submitted; visible and
+// the culled counts come from the GPU cull pass and, like gpuMs, arrive late.
+// glyphs and textMs are the text instances drawn and the CPU time spent laying
+// them out in drawText(). uploadBytes is the mesh data uploaded since the
+// previous frame.
+struct FrameStats {
+  uint32_t frame{0};
+  double cpuMs{0.0};
+  double gpuMs{-1.0};
+  uint32_t draws{0};
+  double recordMs{0.0};
+  uint32_t visible{0};
+  uint32_t frustumCulled{0};
+  uint32_t occlusionCulled{0};
+  uint32_t glyphs{0};
+  double textMs{0.0};
+  uint64_t uploadBytes{0};
+};
+// Milliseconds from the start of the Renderer constructor. pipelinesMs stays
+// negative while pipeline variants are still compiling in the background.
+struct StartupStats {
+  double initMs{0.0};
+  double firstFrameMs{-1.0};
+  double pipelinesMs{-1.0};
+  bool warmCache{false}; // a pipeline cache for this device and driver was loaded
+  size_t cacheBytes{0};
+};
 class Renderer {
 public:
-  Renderer(bool headless);
+  // Pipeline variants compile as background jobs on jobs when it is given (and
+  // has background workers); otherwise before the constructor returns.
+  Renderer(bool headless, const Config& config = {}, JobSystem* jobs = nullptr);
   ~Renderer();
+  // Frame pacing: blocks until a frame slot (and, with present wait, the display)
+  // is ready. Call it before sampling input so the input is as fresh as possible;
+  // drawFrame() calls it itself if the caller did not.
+  void beginFrame();
   void drawFrame();
+  // Window size changed: the swapchain is rebuilt at the next frame.
+  void notifyResized(){ m_resizePending = true; }
+  uint32_t framesInFlight() const { return m_framesInFlight; }
+  // Waits for all submitted work and resolves outstanding GPU timings.
+  void waitIdle();
+  const FrameStats& lastFrameStats() const { return m_lastStats; }
+  // Per-frame history, indexed by frame, recorded in headless mode only: a
+  // window keeps just lastFrameStats().
+  const std::vector<FrameStats>& frameStats() const { return m_frameStats; }
+  // Headless readback: once a frame's fence has signalled its pixels are passed to
+  // the handler, which owns the ring slot until releaseReadback(slot) (any thread).
+  // Frames are skipped rather than stalling when every slot is still owned.
+  using ReadbackHandler = std::function<void(uint32_t frame, const Capture::ImageView& image, size_t slot)>;
+  void setReadbackHandler(ReadbackHandler handler){ m_readbackHandler = std::move(handler); }
+  void releaseReadback(size_t slot){ m_readbackBusy[slot].store(false, std::memory_order_release); }
+  uint64_t readbackDropped() const { return m_readbackDropped; }
+  // Device memory: long-lived resources come from the allocator; per-frame uniform and
+  // storage data from the ring, whose current region is recycled by beginFrame().
+  vkutils::GpuAllocator& allocator(){ return *m_allocator; }
+  vkutils::FrameRing& frameRing(){ return *m_frameRing; }
+  vkutils::GpuMemoryStats memoryStats() const { return m_allocator->stats(); }
+  // Geometry lives in shared vertex/index buffers. Draws submitted during a frame
+  // are sorted, written to the frame ring as indirect commands plus a transform
+  // SSBO, and issued by drawFrame() with one vkCmdDrawIndexedIndirect per pipeline.
+  struct Mesh {
+    vkutils::MeshAllocation alloc;
+    Vec3 boundsMin, boundsMax; // model space
+    uint64_t upload{0}; // upload batch that must land before the mesh is drawn
+    bool valid() const { return alloc.valid(); }
+  };
+  Mesh uploadMesh(const MeshBuffers& mesh); // throws when the mesh pool is full
+  // The mesh is freed once every frame that may still read it has retired.
+  void releaseMesh(Mesh& mesh);
+  // With timeline semaphores the mesh pool is device local and uploads are
+  // copied from a staging ring on a transfer queue (the graphics queue when
+  // the device has no separate transfer family), submitted once per frame. A
+  // mesh is drawn from the first frame that begins after its copy has landed;
+  // draws submitted before then are skipped. Otherwise uploadMesh() writes
+  // host-visible memory directly and the mesh draws immediately.
+  bool asyncUploads() const { return m_uploads != nullptr; }
+  // Whether submitDraw() draws the mesh this frame rather than skipping it:
+  // callers replacing a mesh keep drawing the old one until the new one is ready.
+  bool meshReady(const Mesh& mesh) const { return mesh.valid() && mesh.upload <= m_uploadsAcquired; }
+  vkutils::UploadStats uploadStats() const { return m_uploads ? m_uploads->stats() : vkutils::UploadStats{}; }
+  // The layout uploadMesh() accepts. Packed meshes have no indices of their
+  // own; they are drawn through a shared quad index buffer, and with vertex
+  // pulling the shader reads the pool as a storage buffer.
+  VertexFormat vertexFormat() const { return m_vertexFormat; }
+  bool vertexPulling() const { return m_vertexPulling; }
+  // Mesh pool occupancy, vertex and index ranges combined.
+  MemoryStats meshMemory() const;
+  void setCamera(const Mat4& view, const Mat4& proj);
+  float aspectRatio() const { return static_cast<float>(m_swapchainExtent.width) / static_cast<float>(m_swapchainExtent.height); }
+  // Graphics pipeline variants. Opaque is built before the first frame; the
+  // others compile as background jobs and draw with Opaque until ready.
+  enum class Pipeline : uint32_t { Opaque, DoubleSided, Translucent };
+  static constexpr uint32_t PIPELINE_COUNT = 3;
+  void submitDraw(const Mesh& mesh, uint32_t material, const Mat4& model, Pipeline pipeline = Pipeline::Opaque);
+  bool pipelineReady(Pipeline pipeline) const { return m_pipelines[static_cast<uint32_t>(pipeline)].load(std::memory_order_acquire) != VK_NULL_HANDLE; }
+  // The pipeline cache is loaded at startup and written back at shutdown.
+  static std::string pipelineCachePath(const Config& config);
+  StartupStats startupStats() const;
+  // The physical device and driver in use, for reports.
+  std::string deviceName() const;
+  // Culling: a compute pass tests every draw against the frustum and against a
+  // depth pyramid of the previous frame, then compacts survivors into the
+  // indirect buffer. Without compute indirect support the frustum test runs on
+  // the CPU in submitDraw(). Disabling it draws everything (for comparisons).
+  void setCulling(bool enabled){ m_cullingEnabled = enabled; }
+  bool gpuCulling() const { return m_gpuCulling; }
+  // Large frames write and record their draws on the job system: chunks of
+  // draws go into secondary command buffers from per-worker, per-frame pools
+  // and the primary executes them in draw order. Set before the first frame.
+  void setJobSystem(JobSystem* jobs);
+  void setParallelRecording(bool enabled){ m_parallelRecording = enabled; }
+  // Text: the SDF atlas is uploaded once (replacing any previous one). Each
+  // drawText() builds the labels' glyph instances for the current camera
+  // straight into the frame ring; they are drawn over the scene with one
+  // instanced draw per call, whatever the label count. Without an atlas the
+  // labels' screen text is dropped.
+  void setFontAtlas(const FontAtlas& atlas);
+  void drawText(Labels& labels);
 private:
   void initWindow();
   void initVulkan();
@@ -18,6 +157,10 @@ private:
   void pickPhysicalDevice();
   void createLogicalDevice();
   void createSwapchain();
+  bool recreateSwapchain();
+  void destroyRetired(bool all);
+  void recordLatency(double ms);
+  void frameSubmitted(double gpuMs); // fills m_lastStats (and the headless history)
   void createImageViews();
   void cleanupSwapchain();
   void createRenderPass();
@@ -25,6 +168,37 @@ private:
   void createCommandPool();
   void createCommandBuffers();
   void createSyncObjects();
+  void createAllocators();
+  void createOffscreenTarget();
+  void createDepthTarget();
+  void createDescriptors();
+  void createPipelineCache();
+  void savePipelineCache();
+  VkPipeline createGraphicsPipeline(Pipeline variant) const; // thread-safe
+  void createPipelines();
+  void finishPipelines();
+  VkPipeline boundPipeline(uint32_t variant) const;
+  void createText();
+  VkPipeline createTextPipeline() const;
+  void recordText(VkCommandBuffer cmd);
+  struct RecordPool;
+  VkCommandBuffer nextSecondary(RecordPool& pool); // null when the pool cannot grow
+  void createCulling();
+  void createDepthPyramid();
+  struct DepthPyramidTarget;
+  void destroyDepthPyramid(DepthPyramidTarget& p);
+  void prepareDraws(VkCommandBuffer cmd);
+  bool recordDrawsParallel(VkFramebuffer framebuffer);
+  void recordDraws(VkCommandBuffer cmd);
+  void recordChunk(VkCommandBuffer cmd, const DrawChunk& chunk);
+  void destroyRecordPools();
+  void buildDepthPyramid(VkCommandBuffer cmd);
+  void collectCullStats(size_t slot);
+  void createTimestampQueries();
+  void drawOffscreen();
+  void collectTimings(size_t slot);
+  void acquireReadback();
+  void deliverReadback(size_t slot);
   void recordCommandBuffer(VkCommandBuffer cmd, uint32_t imageIndex);
   bool m_validationEnabled{false};
   bool m_headless{false};
@@ -37,18 +211,206 @@ private:
   VkDevice m_device{VK_NULL_HANDLE};
   uint32_t m_graphicsQueueFamily{UINT32_MAX};
   uint32_t m_presentQueueFamily{UINT32_MAX};
+  uint32_t m_transferQueueFamily{UINT32_MAX}; // the graphics family when there is no separate one
   VkQueue m_graphicsQueue{VK_NULL_HANDLE};
   VkQueue m_presentQueue{VK_NULL_HANDLE};
+  std::unique_ptr<vkutils::GpuAllocator> m_allocator;
+  std::unique_ptr<vkutils::FrameRing> m_frameRing;
+  std::unique_ptr<vkutils::MeshPool> m_meshPool;
+  VertexFormat m_vertexFormat{};
+  bool m_vertexPulling{false};
+  vkutils::AllocatedBuffer m_quadIndices; // 0,1,2 0,2,3 per quad, for packed meshes
+  // A retired mesh whose upload has not been acquired waits for the frame that acquires it.
+  struct RetiredMesh { vkutils::MeshAllocation mesh; uint32_t lastFrame; uint64_t upload; };
+  std::vector<RetiredMesh> m_retiredMeshes;
+  std::unique_ptr<vkutils::UploadQueue> m_uploads;
+  bool m_asyncUploadsRequested{true};
+  bool m_asyncUploads{false};       // timeline semaphores: device-local mesh pool fed by m_uploads
+  bool m_uploadTimestamps{false};   // hostQueryReset and transfer-family timestamps
+  uint64_t m_uploadsAcquired{0};    // batches acquired by the current frame's command buffer
+  uint64_t m_pendingUploadBytes{0}; // uploaded since the last drawFrame()
+  uint64_t m_uploadBytes{0};        // the current frame's share, for FrameStats
+  VkDescriptorSetLayout m_descriptorSetLayout{VK_NULL_HANDLE};
+  VkDescriptorPool m_descriptorPool{VK_NULL_HANDLE};
+  VkDescriptorSet m_descriptorSet{VK_NULL_HANDLE}; // ring buffer: camera/scene UBOs (dynamic) and transforms
+  VkPipelineLayout m_pipelineLayout{VK_NULL_HANDLE};
+  // Indexed by Pipeline (the DrawList pipeline key); null until compiled.
+  std::array<std::atomic<VkPipeline>, PIPELINE_COUNT> m_pipelines{};
+  std::unique_ptr<JobCounter> m_pipelineJobs; // variants still compiling
+  std::atomic<uint32_t> m_pipelinesPending{0};
+  std::atomic<double> m_pipelinesReadyMs{-1.0};
+  VkPipelineCache m_pipelineCache{VK_NULL_HANDLE};
+  PipelineCacheKey m_pipelineCacheKey;
+  std::string m_pipelineCachePath;
+  std::chrono::steady_clock::time_point m_initStart{};
+  StartupStats m_startup;
+  bool m_indirectDraws{false}; // multiDrawIndirect + drawIndirectFirstInstance; else direct draws
+  uint32_t m_maxDrawIndirectCount{1};
+  DrawList m_drawList;
+  Mat4 m_view{identity()};
+  Mat4 m_proj{identity()};
+  Frustum m_frustum{};
+  uint32_t m_lastDraws{0};
+  uint32_t m_lastVisible{0};
+  uint32_t m_lastCpuCulled{0};
+  uint32_t m_cpuCulled{0}; // this frame's draws rejected by the CPU frustum test
+  double m_lastRecordMs{0.0};
+  // What prepareDraws() left for writing and recording the sorted draws.
+  struct FrameDraws {
+    std::span<const DrawBatch> batches;
+    uint32_t count{0};
+    DrawIndexedIndirect* commands{nullptr}; // in the ring; also read back for direct draws
+    Mat4* transforms{nullptr};              // in the ring
+    DrawBounds* bounds{nullptr};            // in the ring, when culled
+    uint32_t transformBase{0};
+    VkDeviceSize commandOffset{0};          // in the ring
+    uint32_t dynamicOffsets[2]{};           // camera and scene UBOs
+    bool culled{false};                     // draw from the slot's culled command buffer
+  } m_frameDraws;
+  // Parallel recording. Pools are indexed [frame slot][worker + 1]; the extra
+  // pool at 0 serves a thread outside the job system helping in wait().
+  JobSystem* m_jobs{nullptr};
+  bool m_parallelRecording{true};
+  struct RecordPool {
+    VkCommandPool pool{VK_NULL_HANDLE};
+    std::vector<VkCommandBuffer> buffers; // secondaries, reused after the pool is reset
+    uint32_t used{0};
+  };
+  std::vector<RecordPool> m_recordPools;
+  std::vector<DrawChunk> m_chunks;
+  std::vector<VkCommandBuffer> m_chunkBuffers; // this frame's secondaries in draw order
+  // GPU culling. Per frame slot: culled commands (device local) and the
+  // per-batch survivor counts plus statistics (host visible), grown on demand.
+  bool m_gpuCulling{false};       // compute-capable queue and indirect draws
+  bool m_drawIndirectCount{false}; // survivors compacted; else culled commands get zero instances
+  bool m_hiz{false};              // depth format can be sampled: occlusion culling
+  bool m_cullingEnabled{true};
+  VkDescriptorSetLayout m_cullSetLayout{VK_NULL_HANDLE};
+  VkPipelineLayout m_cullPipelineLayout{VK_NULL_HANDLE};
+  VkPipeline m_cullPipeline{VK_NULL_HANDLE};
+  VkDescriptorPool m_cullDescriptorPool{VK_NULL_HANDLE};
+  VkDescriptorSetLayout m_pyramidSetLayout{VK_NULL_HANDLE};
+  VkPipelineLayout m_pyramidPipelineLayout{VK_NULL_HANDLE};
+  VkPipeline m_pyramidPipeline{VK_NULL_HANDLE};
+  VkSampler m_pyramidSampler{VK_NULL_HANDLE};
+  struct CullSlot {
+    vkutils::AllocatedBuffer commands;
+    vkutils::AllocatedBuffer counts;
+    VkDescriptorSet set{VK_NULL_HANDLE};
+    uint32_t capacity{0};
+    uint64_t pyramidGeneration{0}; // pyramid the set's sampler binding points at
+    bool pending{false};           // counts hold results of a submitted cull
+  };
+  std::vector<CullSlot> m_cullSlots;
+  // Hi-Z pyramid over the depth target, rebuilt after every culled frame and
+  // recreated (then retired) with the depth target.
+  struct DepthPyramidTarget {
+    VkImage image{VK_NULL_HANDLE};
+    vkutils::Allocation memory;
+    VkImageView view{VK_NULL_HANDLE};        // all levels, sampled by the cull pass
+    std::vector<VkImageView> levelViews;      // one per level: storage target, then source of the next
+    VkDescriptorPool pool{VK_NULL_HANDLE};
+    std::vector<VkDescriptorSet> sets;        // per level: source sampler + destination image
+    uint32_t levels{0};
+    uint64_t generation{0};
+    bool initialized{false};                  // transitioned to GENERAL
+  };
+  DepthPyramidTarget m_pyramid;
+  uint64_t m_pyramidGenerations{0};
+  bool m_pyramidValid{false}; // holds the depth of the last culled frame
+  Mat4 m_pyramidViewProj{identity()};
+  // Text: R8 distance field atlas sampled by one pipeline without depth test.
+  // Glyph instances are per-frame vertex data in the frame ring, one run per
+  // drawText() call.
+  VkImage m_atlasImage{VK_NULL_HANDLE};
+  vkutils::Allocation m_atlasMemory;
+  VkImageView m_atlasView{VK_NULL_HANDLE};
+  VkSampler m_atlasSampler{VK_NULL_HANDLE};
+  VkDescriptorSetLayout m_textSetLayout{VK_NULL_HANDLE};
+  VkDescriptorPool m_textDescriptorPool{VK_NULL_HANDLE};
+  VkDescriptorSet m_textSet{VK_NULL_HANDLE};
+  VkPipelineLayout m_textPipelineLayout{VK_NULL_HANDLE};
+  VkPipeline m_textPipeline{VK_NULL_HANDLE};
+  struct TextRun { VkDeviceSize offset; uint32_t count; };
+  std::vector<TextRun> m_textRuns;
+  uint32_t m_textGlyphs{0};
+  double m_textMs{0.0};
   VkSwapchainKHR m_swapchain{VK_NULL_HANDLE};
   std::vector<VkImage> m_swapchainImages;
   std::vector<VkImageView> m_swapchainImageViews;
   VkFormat m_swapchainFormat{VK_FORMAT_UNDEFINED};
-  VkExtent2D m_swapchainExtent{0,0};
+  VkExtent2D m_swapchainExtent{0,0}; // headless: extent of the offscreen target
   VkRenderPass m_renderPass{VK_NULL_HANDLE};
   std::vector<VkFramebuffer> m_framebuffers;
   VkCommandPool m_commandPool{VK_NULL_HANDLE};
-  std::vector<VkCommandBuffer> m_commandBuffers; // one per swapchain image
-  static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+  std::vector<VkCommandBuffer> m_commandBuffers; // one per frame in flight
+  // Headless offscreen target, copied into a host-visible buffer each frame.
+  VkImage m_offscreenImage{VK_NULL_HANDLE};
+  vkutils::Allocation m_offscreenMemory;
+  VkImageView m_offscreenView{VK_NULL_HANDLE};
+  VkFormat m_depthFormat{VK_FORMAT_UNDEFINED};
+  VkImage m_depthImage{VK_NULL_HANDLE};
+  vkutils::Allocation m_depthMemory;
+  VkImageView m_depthView{VK_NULL_HANDLE};
+  std::vector<vkutils::AllocatedBuffer> m_readback; // ring: frames in flight plus two slots held by encoders
+  std::vector<std::atomic<bool>> m_readbackBusy;
+  std::vector<int> m_slotReadback; // ring slot each frame in flight copies into, -1 if none
+  size_t m_nextReadback{0};
+  uint64_t m_readbackDropped{0};
+  ReadbackHandler m_readbackHandler;
+  VkQueryPool m_timestampPool{VK_NULL_HANDLE};
+  float m_timestampPeriod{1.f};
+  uint64_t m_timestampMask{~0ull};
+  std::vector<int64_t> m_slotFrame; // frame whose timestamps are pending in each slot, -1 if none
+  std::vector<uint64_t> m_slotSubmitTicks; // Profiler::now() at each slot's submit, anchoring its GPU zones
+  FrameStats m_lastStats;
+  std::vector<FrameStats> m_frameStats;
+  static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+  // Frame start, after the cull pass, after the render pass, after the depth pyramid, frame end.
+  static constexpr uint32_t TIMESTAMPS_PER_FRAME = 5;
+  static constexpr VkDeviceSize STAGING_BYTES = VkDeviceSize{32} << 20;
+  // How the graphics queue consumes uploaded meshes, for the acquire barriers and semaphore wait.
+  static constexpr VkPipelineStageFlags MESH_READ_STAGES = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+  static constexpr VkAccessFlags MESH_READ_ACCESS = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+  static constexpr VkDeviceSize FRAME_RING_BYTES = VkDeviceSize{8} << 20; // per frame in flight: ~50k draws plus ~100k glyphs
+  static constexpr VkDeviceSize MESH_VERTEX_BYTES = VkDeviceSize{64} << 20;
+  static constexpr VkDeviceSize MESH_INDEX_BYTES = VkDeviceSize{32} << 20;  // float layout only
+  static constexpr uint32_t MAX_MESH_QUADS = 6 * 16384; // a full 32^3 checkerboard: the quad index buffer's reach
+  static constexpr uint32_t PARALLEL_RECORD_MIN_DRAWS = 4096; // below this one thread records everything
+  static constexpr uint32_t RECORD_CHUNK_MIN_DRAWS = 1024;
+  static constexpr uint32_t CULL_COUNTS_HEADER = 4; // frustum, occlusion, visible, pad; then one count per batch
+  uint32_t m_framesInFlight{2};
+  PresentMode m_presentModePreference{PresentMode::Mailbox};
+  bool m_presentWaitRequested{true};
+  bool m_presentWaitEnabled{false};
+#ifdef VK_KHR_present_wait
+  PFN_vkWaitForPresentKHR m_waitForPresent{nullptr};
+#endif
+  // Present ids increase across swapchains; ids below m_swapchainFirstPresentId
+  // belong to a retired swapchain and are never waited on.
+  uint64_t m_presentId{0};
+  uint64_t m_presentWaited{0};
+  uint64_t m_swapchainFirstPresentId{1};
+  std::array<std::chrono::steady_clock::time_point, 16> m_inputTimes{}; // indexed by present id
+  std::chrono::steady_clock::time_point m_cpuStart{};
+  double m_latencySum{0.0}, m_latencyMax{0.0};
+  uint32_t m_latencyCount{0};
+  bool m_frameBegun{false};
+  bool m_resizePending{false};
+  // Swapchain objects replaced by a resize, destroyed once every frame that used them has retired.
+  struct Retired {
+    VkSwapchainKHR swapchain{VK_NULL_HANDLE};
+    VkRenderPass renderPass{VK_NULL_HANDLE};
+    std::vector<VkImageView> views;
+    std::vector<VkFramebuffer> framebuffers;
+    VkImage depthImage{VK_NULL_HANDLE};
+    VkImageView depthView{VK_NULL_HANDLE};
+    vkutils::Allocation depthMemory;
+    DepthPyramidTarget pyramid;
+    std::vector<VkPipeline> pipelines;
+    uint32_t lastFrame{0}; // frames numbered below this may still reference these objects
+  };
+  std::vector<Retired> m_retired;
   std::vector<VkSemaphore> m_imageAvailable;
   std::vector<VkSemaphore> m_renderFinished;
   std::vector<VkFence> m_inFlightFences;
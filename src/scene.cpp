@@ -1 +1,256 @@
 #include "scene.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+Chunk::Chunk(BlockId fill):m_palette{fill}{}
+
+void Chunk::fill(BlockId b){
+  m_palette.assign(1, b);
+  m_data.clear(); m_data.shrink_to_fit();
+  m_bits = 0; m_bitsLog = 0; m_mask = 0; m_direct = false; m_lastPalette = 0;
+}
+
+uint32_t Chunk::paletteIndexFor(BlockId b){
+  if(m_direct) return b;
+  if(m_palette[m_lastPalette] == b) return m_lastPalette;
+  const size_t n = m_palette.size();
+  for(size_t i=0;i<n;++i){
+    if(m_palette[i]==b){ m_lastPalette = static_cast<uint16_t>(i); return static_cast<uint32_t>(i); }
+  }
+  if(n >= (size_t{1} << m_bits)){
+    std::vector<uint32_t> identity(n);
+    for(size_t i=0;i<n;++i) identity[i] = static_cast<uint32_t>(i);
+    if(m_bits == 8){
+      // Palette is full at 8 bits; store raw ids instead.
+      for(size_t i=0;i<n;++i) identity[i] = m_palette[i];
+      repack(4, true, identity);
+      m_palette.clear();
+      return b;
+    }
+    repack(m_bits == 0 ? 0u : m_bitsLog + 1u, false, identity);
+  }
+  m_palette.push_back(b);
+  m_lastPalette = static_cast<uint16_t>(n);
+  return static_cast<uint32_t>(n);
+}
+
+// Re-encode every entry with a new width; remap maps old index -> new index.
+void Chunk::repack(unsigned bitsLog, bool direct, const std::vector<uint32_t>& remap){
+  std::vector<uint32_t> old(VOLUME);
+  for(int i=0;i<VOLUME;++i) old[static_cast<size_t>(i)] = remap[readIndex(i)];
+  m_bitsLog = static_cast<uint8_t>(bitsLog);
+  m_bits = static_cast<uint8_t>(1u << bitsLog);
+  m_mask = (uint64_t{1} << m_bits) - 1u;
+  m_direct = direct;
+  m_data.assign(static_cast<size_t>(VOLUME) >> (6u - m_bitsLog), 0);
+  for(int i=0;i<VOLUME;++i) writeIndex(i, old[static_cast<size_t>(i)]);
+}
+
+void Chunk::writeRun(int start, int count, uint32_t v){
+  if(m_bits == 0) return;
+  const unsigned perWordLog = 6u - m_bitsLog;
+  const int perWord = 1 << perWordLog;
+  int i = start; const int end = start + count;
+  while(i < end && (i & (perWord - 1))) writeIndex(i++, v);
+  const uint64_t pattern = (~uint64_t{0} / m_mask) * v;
+  for(; end - i >= perWord; i += perWord) m_data[static_cast<size_t>(i) >> perWordLog] = pattern;
+  while(i < end) writeIndex(i++, v);
+}
+
+void Chunk::setRun(int start, int count, BlockId b){
+  if(start == 0 && count == VOLUME){ fill(b); return; }
+  writeRun(start, count, paletteIndexFor(b));
+}
+
+void Chunk::getRun(int start, int count, BlockId* out) const {
+  if(m_bits == 0){ std::fill_n(out, count, m_palette[0]); return; }
+  for(int i=0;i<count;++i) out[i] = at(start + i);
+}
+
+void Chunk::decode(BlockId* out) const { getRun(0, VOLUME, out); }
+
+void Chunk::fillRegion(int x0, int y0, int z0, int x1, int y1, int z1, BlockId b){
+  if(x0>=x1 || y0>=y1 || z0>=z1) return;
+  if(x0==0 && y0==0 && z0==0 && x1==SIZE && y1==SIZE && z1==SIZE){ fill(b); return; }
+  const uint32_t v = paletteIndexFor(b);
+  for(int y=y0;y<y1;++y){
+    if(x0==0 && x1==SIZE){
+      // Full rows: the z-slab is one contiguous run.
+      writeRun(index(0,y,z0), (z1-z0)*SIZE, v);
+      continue;
+    }
+    for(int z=z0;z<z1;++z) writeRun(index(x0,y,z), x1-x0, v);
+  }
+}
+
+void Chunk::compact(){
+  if(m_bits == 0) return;
+  std::vector<BlockId> used;
+  std::vector<uint32_t> remap(m_direct ? 65536u : m_palette.size(), UINT32_MAX);
+  for(int i=0;i<VOLUME;++i){
+    const uint32_t p = readIndex(i);
+    if(remap[p] == UINT32_MAX){
+      remap[p] = static_cast<uint32_t>(used.size());
+      used.push_back(m_direct ? static_cast<BlockId>(p) : m_palette[p]);
+    }
+  }
+  if(used.size() == 1){ fill(used[0]); return; }
+  unsigned bitsLog = 0;
+  while((size_t{1} << (1u << bitsLog)) < used.size()) ++bitsLog;
+  if(bitsLog > 3) return; // still more than 256 distinct ids; stay direct
+  repack(bitsLog, false, remap);
+  m_palette = std::move(used);
+  m_lastPalette = 0;
+}
+
+size_t Chunk::serializedSize() const {
+  return 4 + m_palette.size()*sizeof(BlockId) + m_data.size()*sizeof(uint64_t);
+}
+
+void Chunk::serialize(std::vector<uint8_t>& out) const {
+  const size_t at = out.size();
+  out.resize(at + serializedSize());
+  uint8_t* p = out.data() + at;
+  const auto paletteSize = static_cast<uint16_t>(m_palette.size());
+  p[0] = m_bits; p[1] = m_direct ? 1 : 0;
+  std::memcpy(p + 2, &paletteSize, 2);
+  if(!m_palette.empty()) std::memcpy(p + 4, m_palette.data(), m_palette.size()*sizeof(BlockId));
+  if(!m_data.empty()) std::memcpy(p + 4 + m_palette.size()*sizeof(BlockId), m_data.data(), m_data.size()*sizeof(uint64_t));
+}
+
+bool Chunk::deserialize(std::span<const uint8_t> in){
+  if(in.size() < 4) return false;
+  const unsigned bits = in[0];
+  const bool direct = in[1] == 1;
+  uint16_t paletteSize;
+  std::memcpy(&paletteSize, in.data() + 2, 2);
+  if(in[1] > 1 || (bits != 0 && !std::has_single_bit(bits)) || bits > 16) return false;
+  if(direct ? bits != 16 || paletteSize != 0 : bits == 16 || paletteSize == 0 || paletteSize > (1u << bits)) return false;
+  const size_t words = static_cast<size_t>(VOLUME) * bits / 64;
+  if(in.size() != 4 + paletteSize*sizeof(BlockId) + words*sizeof(uint64_t)) return false;
+  // Every index must name a palette entry: at() reads the palette unchecked.
+  const uint8_t* packed = in.data() + 4 + paletteSize*sizeof(BlockId);
+  if(!direct && bits != 0 && paletteSize < (1u << bits)){
+    const uint64_t mask = (uint64_t{1} << bits) - 1u;
+    for(size_t i=0;i<words;++i){
+      uint64_t w;
+      std::memcpy(&w, packed + i*sizeof(uint64_t), sizeof(w));
+      for(unsigned shift=0; shift<64; shift+=bits) if(((w >> shift) & mask) >= paletteSize) return false;
+    }
+  }
+  m_palette.resize(paletteSize);
+  if(paletteSize) std::memcpy(m_palette.data(), in.data() + 4, paletteSize*sizeof(BlockId));
+  m_data.resize(words);
+  if(words) std::memcpy(m_data.data(), packed, words*sizeof(uint64_t));
+  m_bits = static_cast<uint8_t>(bits);
+  m_bitsLog = static_cast<uint8_t>(bits ? std::countr_zero(bits) : 0);
+  m_mask = bits ? (uint64_t{1} << bits) - 1u : 0;
+  m_direct = direct;
+  m_lastPalette = 0;
+  return true;
+}
+
+size_t Chunk::memoryUsage() const {
+  return sizeof(Chunk) + m_palette.capacity()*sizeof(BlockId) + m_data.capacity()*sizeof(uint64_t);
+}
+
+BlockId Scene::getBlock(int x, int y, int z) const {
+  const Chunk* c = findChunk(chunkOf(x,y,z));
+  return c ? c->get(x & Chunk::MASK, y & Chunk::MASK, z & Chunk::MASK) : BLOCK_AIR;
+}
+
+void Scene::setBlock(int x, int y, int z, BlockId b){
+  const ChunkCoord cc = chunkOf(x,y,z);
+  Chunk* c = findChunk(cc);
+  if(!c){
+    if(b == BLOCK_AIR) return;
+    c = &chunkAt(cc);
+  }
+  c->set(x & Chunk::MASK, y & Chunk::MASK, z & Chunk::MASK, b);
+}
+
+Chunk* Scene::findChunk(const ChunkCoord& c){
+  auto it = m_chunks.find(c);
+  return it == m_chunks.end() ? nullptr : &it->second;
+}
+
+const Chunk* Scene::findChunk(const ChunkCoord& c) const {
+  auto it = m_chunks.find(c);
+  return it == m_chunks.end() ? nullptr : &it->second;
+}
+
+Chunk& Scene::chunkAt(const ChunkCoord& c){ return m_chunks.try_emplace(c).first->second; }
+
+bool Scene::removeChunk(const ChunkCoord& c){ return m_chunks.erase(c) > 0; }
+
+void Scene::compact(){
+  for(auto it = m_chunks.begin(); it != m_chunks.end();){
+    it->second.compact();
+    it = it->second.empty() ? m_chunks.erase(it) : std::next(it);
+  }
+}
+
+void Scene::fill(const BlockPos& min, const BlockPos& max, BlockId b){
+  if(min.x>=max.x || min.y>=max.y || min.z>=max.z) return;
+  const ChunkCoord c0 = chunkOf(min.x, min.y, min.z);
+  const ChunkCoord c1 = chunkOf(max.x-1, max.y-1, max.z-1);
+  for(int cy=c0.y; cy<=c1.y; ++cy)
+  for(int cz=c0.z; cz<=c1.z; ++cz)
+  for(int cx=c0.x; cx<=c1.x; ++cx){
+    const int bx = cx*Chunk::SIZE, by = cy*Chunk::SIZE, bz = cz*Chunk::SIZE;
+    const int x0 = std::max(min.x-bx,0), x1 = std::min(max.x-bx,Chunk::SIZE);
+    const int y0 = std::max(min.y-by,0), y1 = std::min(max.y-by,Chunk::SIZE);
+    const int z0 = std::max(min.z-bz,0), z1 = std::min(max.z-bz,Chunk::SIZE);
+    Chunk* c = findChunk({cx,cy,cz});
+    if(!c){
+      if(b == BLOCK_AIR) continue;
+      c = &chunkAt({cx,cy,cz});
+    }
+    c->fillRegion(x0,y0,z0,x1,y1,z1,b);
+  }
+}
+
+void Scene::copyRegion(const BlockPos& srcMin, const BlockPos& srcMax, const BlockPos& dstMin){
+  const int sx = srcMax.x-srcMin.x, sy = srcMax.y-srcMin.y, sz = srcMax.z-srcMin.z;
+  if(sx<=0 || sy<=0 || sz<=0) return;
+  // Stage through a dense buffer so overlapping source/destination is safe.
+  std::vector<BlockId> buf(static_cast<size_t>(sx)*static_cast<size_t>(sy)*static_cast<size_t>(sz));
+  auto forRuns = [&](const BlockPos& base, auto&& fn){
+    size_t row = 0;
+    for(int y=0;y<sy;++y)
+    for(int z=0;z<sz;++z, row += static_cast<size_t>(sx)){
+      const int wy = base.y+y, wz = base.z+z;
+      for(int x=0;x<sx;){
+        const int wx = base.x+x;
+        const int run = std::min(sx-x, Chunk::SIZE-(wx & Chunk::MASK));
+        fn(chunkOf(wx,wy,wz), Chunk::index(wx & Chunk::MASK, wy & Chunk::MASK, wz & Chunk::MASK), run, buf.data()+row+static_cast<size_t>(x));
+        x += run;
+      }
+    }
+  };
+  forRuns(srcMin, [&](const ChunkCoord& cc, int start, int run, BlockId* out){
+    if(const Chunk* c = findChunk(cc)) c->getRun(start, run, out);
+    else std::fill_n(out, run, BLOCK_AIR);
+  });
+  forRuns(dstMin, [&](const ChunkCoord& cc, int start, int run, BlockId* in){
+    Chunk* c = findChunk(cc);
+    if(!c){
+      if(std::all_of(in, in+run, [](BlockId b){ return b == BLOCK_AIR; })) return;
+      c = &chunkAt(cc);
+    }
+    // Collapse to whole-run writes where the source row is homogeneous.
+    for(int i=0;i<run;){
+      int j = i+1;
+      while(j<run && in[j]==in[i]) ++j;
+      c->setRun(start+i, j-i, in[i]);
+      i = j;
+    }
+  });
+}
+
+size_t Scene::memoryUsage() const {
+  size_t total = m_chunks.bucket_count()*sizeof(void*);
+  for(const auto& [coord, chunk] : m_chunks) total += chunk.memoryUsage() + sizeof(coord) + 2*sizeof(void*);
+  return total;
+}
@@ -1,2 +1,125 @@
 #pragma once
-struct Scene { int dummy{0}; };
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+using BlockId = uint16_t;
+inline constexpr BlockId BLOCK_AIR = 0;
+
+struct BlockPos { int32_t x{}, y{}, z{}; };
+
+struct ChunkCoord {
+  int32_t x{}, y{}, z{};
+  bool operator==(const ChunkCoord&) const = default;
+};
+
+struct ChunkCoordHash {
+  size_t operator()(const ChunkCoord& c) const noexcept {
+    uint64_t h = static_cast<uint32_t>(c.x) * 0x9E3779B97F4A7C15ull;
+    h ^= static_cast<uint32_t>(c.y) * 0xC2B2AE3D27D4EB4Full;
+    h ^= static_cast<uint32_t>(c.z) * 0x165667B19E3779F9ull;
+    return static_cast<size_t>(h ^ (h >> 29));
+  }
+};
+
+// 32^3 block chunk stored as a palette plus bit-packed palette indices.
+// Index width is 0/1/2/4/8 bits so entries never straddle a 64-bit word; a
+// chunk with more than 256 distinct blocks switches to direct 16-bit ids.
+// A homogeneous chunk stores no index data at all.
+class Chunk {
+public:
+  static constexpr int SHIFT = 5;
+  static constexpr int SIZE = 1 << SHIFT;
+  static constexpr int MASK = SIZE - 1;
+  static constexpr int VOLUME = SIZE * SIZE * SIZE;
+
+  explicit Chunk(BlockId fill = BLOCK_AIR);
+
+  // x varies fastest, then z, then y: rows along x are contiguous runs.
+  static constexpr int index(int x, int y, int z) { return (y << (2 * SHIFT)) | (z << SHIFT) | x; }
+
+  BlockId get(int x, int y, int z) const { return at(index(x, y, z)); }
+  void set(int x, int y, int z, BlockId b) { setAt(index(x, y, z), b); }
+  BlockId at(int i) const { return m_direct ? static_cast<BlockId>(readIndex(i)) : m_palette[readIndex(i)]; }
+  void setAt(int i, BlockId b) { writeIndex(i, paletteIndexFor(b)); }
+
+  void fill(BlockId b);
+  // Half-open local box [min, max).
+  void fillRegion(int x0, int y0, int z0, int x1, int y1, int z1, BlockId b);
+  void setRun(int start, int count, BlockId b);
+  void getRun(int start, int count, BlockId* out) const;
+  // Expand into VOLUME entries in index() order.
+  void decode(BlockId* out) const;
+  // Drop unused palette entries and shrink the index width when possible.
+  void compact();
+
+  bool uniform() const { return m_bits == 0; }
+  bool empty() const { return uniform() && m_palette[0] == BLOCK_AIR; }
+  unsigned bitsPerBlock() const { return m_bits; }
+  const std::vector<BlockId>& palette() const { return m_palette; }
+  size_t memoryUsage() const;
+
+  // The in-memory representation as bytes (little-endian): index width, direct
+  // flag, palette size, palette, index words. Appends to out.
+  void serialize(std::vector<uint8_t>& out) const;
+  size_t serializedSize() const;
+  // Replaces the contents; false (chunk unchanged) when the layout is invalid,
+  // including index values past the end of the palette.
+  bool deserialize(std::span<const uint8_t> in);
+
+private:
+  uint32_t readIndex(int i) const {
+    if(m_bits == 0) return 0;
+    const unsigned perWordLog = 6u - m_bitsLog;
+    const uint64_t w = m_data[static_cast<size_t>(i) >> perWordLog];
+    const unsigned shift = (static_cast<unsigned>(i) & ((1u << perWordLog) - 1u)) << m_bitsLog;
+    return static_cast<uint32_t>((w >> shift) & m_mask);
+  }
+  void writeIndex(int i, uint32_t v) {
+    if(m_bits == 0) return;
+    const unsigned perWordLog = 6u - m_bitsLog;
+    uint64_t& w = m_data[static_cast<size_t>(i) >> perWordLog];
+    const unsigned shift = (static_cast<unsigned>(i) & ((1u << perWordLog) - 1u)) << m_bitsLog;
+    w = (w & ~(m_mask << shift)) | (static_cast<uint64_t>(v) << shift);
+  }
+  uint32_t paletteIndexFor(BlockId b);
+  void writeRun(int start, int count, uint32_t v);
+  void repack(unsigned bitsLog, bool direct, const std::vector<uint32_t>& remap);
+
+  std::vector<BlockId> m_palette;
+  std::vector<uint64_t> m_data;
+  uint64_t m_mask{0};
+  uint8_t m_bits{0};
+  uint8_t m_bitsLog{0};
+  bool m_direct{false};
+  uint16_t m_lastPalette{0};
+};
+
+// Sparse voxel world: chunks in a hash map keyed by chunk coordinate.
+// Blocks in unloaded chunks read as air; writing air there is a no-op.
+class Scene {
+public:
+  static ChunkCoord chunkOf(int x, int y, int z) { return {x >> Chunk::SHIFT, y >> Chunk::SHIFT, z >> Chunk::SHIFT}; }
+
+  BlockId getBlock(int x, int y, int z) const;
+  void setBlock(int x, int y, int z, BlockId b);
+  // Half-open world box [min, max), written as whole x-runs per chunk.
+  void fill(const BlockPos& min, const BlockPos& max, BlockId b);
+  // Copy [srcMin, srcMax) so that srcMin lands on dstMin; overlapping ranges are safe.
+  void copyRegion(const BlockPos& srcMin, const BlockPos& srcMax, const BlockPos& dstMin);
+
+  Chunk* findChunk(const ChunkCoord& c);
+  const Chunk* findChunk(const ChunkCoord& c) const;
+  Chunk& chunkAt(const ChunkCoord& c);
+  bool removeChunk(const ChunkCoord& c);
+  void compact();
+
+  size_t chunkCount() const { return m_chunks.size(); }
+  size_t memoryUsage() const;
+  const std::unordered_map<ChunkCoord, Chunk, ChunkCoordHash>& chunks() const { return m_chunks; }
+
+private:
+  std::unordered_map<ChunkCoord, Chunk, ChunkCoordHash> m_chunks;
+};
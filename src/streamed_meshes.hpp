@@ -0,0 +1,150 @@
+#pragma once
+#include "lod.hpp"
+#include "mesher.hpp"
+#include "streaming.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// The GPU side of a ChunkStreamer: the meshes it handed over, by chunk and by
+// LOD tile, in whatever handle type the renderer uses (Renderer::Mesh).
+//
+// A chunk meshed again after edits does not replace its mesh at once: the new
+// mesh waits as a pending replacement while the old one keeps drawing, and
+// swapLanded() swaps the two at a frame boundary once the new one is ready on
+// the GPU, so an edit never leaves a hole for the frames its upload is in
+// flight. A replacement superseded before it lands is released unseen.
+//
+// Everything runs on the thread calling ChunkStreamer::update().
+template<class Mesh>
+class StreamedMeshes {
+public:
+  using Clock = std::chrono::steady_clock;
+  struct Backend {
+    std::function<Mesh(const MeshBuffers&)> upload; // may throw when out of space
+    std::function<void(Mesh&)> release;
+    std::function<bool(const Mesh&)> ready;         // drawable this frame
+  };
+
+  explicit StreamedMeshes(Backend backend) : m_backend(std::move(backend)) {}
+  ~StreamedMeshes(){ clear(); }
+  StreamedMeshes(const StreamedMeshes&) = delete;
+  StreamedMeshes& operator=(const StreamedMeshes&) = delete;
+
+  // Routes the streamer's uploads, releases and landed checks here. The
+  // streamer must be destroyed (or detached) before this is.
+  void attach(ChunkStreamer& streamer){
+    streamer.setUploader([this](const ChunkCoord& c, const MeshBuffers& m){ chunkMeshed(c, m); },
+                         [this](const ChunkCoord& c){ chunkReleased(c); });
+    streamer.setLodUploader([this](const LodTile& t, const MeshBuffers& m){ tileMeshed(t, m); },
+                            [this](const LodTile& t){ tileReleased(t); });
+    streamer.setLanded([this](const LodTile& t){ return landed(t); });
+  }
+
+  // A failed upload leaves the chunk invisible (or drawing its previous mesh).
+  void chunkMeshed(const ChunkCoord& c, const MeshBuffers& buffers){
+    Mesh mesh;
+    if(!upload(buffers, mesh)) return;
+    const auto it = m_chunks.find(c);
+    if(it == m_chunks.end()){ m_chunks.emplace(c, mesh); return; }
+    Replacement& r = m_replacing[c];
+    if(r.pending) m_backend.release(r.mesh); // superseded before it landed
+    r = {mesh, Clock::now(), -1.0, true};
+  }
+  void chunkReleased(const ChunkCoord& c){
+    if(auto it = m_chunks.find(c); it != m_chunks.end()){ m_backend.release(it->second); m_chunks.erase(it); }
+    if(auto it = m_replacing.find(c); it != m_replacing.end()){ m_backend.release(it->second.mesh); m_replacing.erase(it); }
+  }
+  // A failed tile never lands, so the finer meshes keep covering its region.
+  void tileMeshed(const LodTile& t, const MeshBuffers& buffers){
+    Mesh mesh;
+    if(upload(buffers, mesh)) m_tiles[t] = mesh;
+  }
+  void tileReleased(const LodTile& t){
+    if(auto it = m_tiles.find(t); it != m_tiles.end()){ m_backend.release(it->second); m_tiles.erase(it); }
+  }
+  // Whether the mesh drawn for t is on the GPU: what the streamer waits for
+  // before a level change.
+  bool landed(const LodTile& t) const {
+    if(t.level == 0){
+      const Mesh* m = chunk(t.coord);
+      return m && m_backend.ready(*m);
+    }
+    const Mesh* m = tile(t);
+    return m && m_backend.ready(*m);
+  }
+
+  // The frame boundary: every pending replacement that has landed takes its
+  // chunk's place and the old mesh is released. editLatencyMs is the
+  // streamer's edit-to-upload time for the update that just ran; the
+  // edit-to-draw time of each swap adds the frames spent waiting to land.
+  // Returns the number of swaps.
+  size_t swapLanded(double editLatencyMs){
+    const auto now = Clock::now();
+    size_t swapped = 0;
+    for(auto it = m_replacing.begin(); it != m_replacing.end();){
+      Replacement& r = it->second;
+      if(r.editMs < 0.0) r.editMs = editLatencyMs;
+      if(!m_backend.ready(r.mesh)){ ++it; continue; }
+      Mesh& current = m_chunks.at(it->first);
+      m_backend.release(current);
+      current = r.mesh;
+      m_editToDrawMs.push_back(r.editMs + std::chrono::duration<double, std::milli>(now - r.handed).count());
+      it = m_replacing.erase(it);
+      ++swapped;
+    }
+    return swapped;
+  }
+
+  // The mesh to draw: null for chunks and tiles that never got one.
+  const Mesh* chunk(const ChunkCoord& c) const {
+    const auto it = m_chunks.find(c);
+    return it == m_chunks.end() ? nullptr : &it->second;
+  }
+  const Mesh* tile(const LodTile& t) const {
+    if(t.level == 0) return chunk(t.coord);
+    const auto it = m_tiles.find(t);
+    return it == m_tiles.end() ? nullptr : &it->second;
+  }
+
+  size_t chunks() const { return m_chunks.size(); }
+  size_t tiles() const { return m_tiles.size(); }
+  size_t pendingReplacements() const { return m_replacing.size(); }
+  uint64_t uploadFailures() const { return m_uploadFailures; }
+  // One entry per swap, in swap order.
+  const std::vector<double>& editToDrawMs() const { return m_editToDrawMs; }
+
+  // Releases every mesh, pending ones included.
+  void clear(){
+    for(auto& [c, m] : m_chunks) m_backend.release(m);
+    for(auto& [c, r] : m_replacing) m_backend.release(r.mesh);
+    for(auto& [t, m] : m_tiles) m_backend.release(m);
+    m_chunks.clear();
+    m_replacing.clear();
+    m_tiles.clear();
+  }
+
+private:
+  struct Replacement {
+    Mesh mesh{};
+    Clock::time_point handed{};
+    double editMs{-1.0}; // edit-to-upload of the update that handed it over
+    bool pending{false};
+  };
+  bool upload(const MeshBuffers& buffers, Mesh& out){
+    try { out = m_backend.upload(buffers); return true; }
+    catch(const std::exception&){ ++m_uploadFailures; return false; }
+  }
+
+  Backend m_backend;
+  std::unordered_map<ChunkCoord, Mesh, ChunkCoordHash> m_chunks;
+  std::unordered_map<ChunkCoord, Replacement, ChunkCoordHash> m_replacing;
+  std::unordered_map<LodTile, Mesh, LodTileHash> m_tiles;
+  uint64_t m_uploadFailures{0};
+  std::vector<double> m_editToDrawMs;
+};
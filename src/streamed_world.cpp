@@ -0,0 +1,39 @@
+#include "streamed_world.hpp"
+#include "camera.hpp"
+#include "profiler.hpp"
+
+StreamedWorld::StreamedWorld(Renderer& renderer, JobSystem& jobs, ChunkStreamer::Generator generator, StreamingConfig config)
+  : m_renderer(renderer),
+    m_meshes({[&renderer](const MeshBuffers& m){ return renderer.uploadMesh(m); },
+              [&renderer](Renderer::Mesh& m){ renderer.releaseMesh(m); },
+              [&renderer](const Renderer::Mesh& m){ return renderer.meshReady(m); }}) {
+  config.format = renderer.vertexFormat();
+  config.memoryBudget = size_t{80} << 20; // stays inside the renderer's mesh pool
+  m_streamer = std::make_unique<ChunkStreamer>(m_scene, jobs, std::move(generator), config);
+  m_meshes.attach(*m_streamer);
+}
+
+uint64_t StreamedWorld::update(const Vec3& eye, const Vec3& forward){
+  BLOCCO_ZONE("streamed world");
+  m_streamer->update(eye, forward);
+  m_meshes.swapLanded(m_streamer->stats().editLatencyMs);
+  constexpr float N = Chunk::SIZE;
+  uint64_t triangles = 0;
+  for(const LodTile& t : m_streamer->visible()){
+    const Renderer::Mesh* mesh = m_meshes.tile(t);
+    if(!mesh) continue; // its upload failed
+    const ChunkCoord& c = t.coord;
+    m_renderer.submitDraw(*mesh, 0, t.level > 0 ? t.transform() : translate({static_cast<float>(c.x)*N, static_cast<float>(c.y)*N, static_cast<float>(c.z)*N}));
+    triangles += mesh->alloc.indexCount/3;
+  }
+  return triangles;
+}
+
+uint64_t StreamedWorld::update(const Camera& camera){
+  return update(camera.position, camera.forward());
+}
+
+bool StreamedWorld::settled() const {
+  const StreamingStats& st = m_streamer->stats();
+  return st.inFlight == 0 && st.pendingUploads == 0 && st.pendingEdits == 0 && m_meshes.pendingReplacements() == 0;
+}
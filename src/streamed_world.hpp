@@ -0,0 +1,43 @@
+#pragma once
+#include "renderer.hpp"
+#include "scene.hpp"
+#include "streamed_meshes.hpp"
+#include "streaming.hpp"
+#include <cstdint>
+#include <memory>
+
+class JobSystem;
+struct Camera;
+
+// A world streamed around the camera and drawn: a Scene filled by a
+// ChunkStreamer, the meshes it hands over held on the renderer by
+// StreamedMeshes (remeshes swap in once landed), and the visible set
+// submitted every frame, chunks at their position and LOD tiles with their
+// own transform. What blocco_headless --fly-through and blocco_bench draw.
+class StreamedWorld {
+public:
+  // The vertex format and memory budget of config are set to fit the renderer.
+  StreamedWorld(Renderer& renderer, JobSystem& jobs, ChunkStreamer::Generator generator, StreamingConfig config);
+  StreamedWorld(const StreamedWorld&) = delete;
+  StreamedWorld& operator=(const StreamedWorld&) = delete;
+
+  ChunkStreamer& streamer(){ return *m_streamer; }
+  const ChunkStreamer& streamer() const { return *m_streamer; }
+  // Edits go through streamer().setBlock(); read blocks here.
+  const Scene& scene() const { return m_scene; }
+  const StreamedMeshes<Renderer::Mesh>& meshes() const { return m_meshes; }
+
+  // One frame, between the renderer's beginFrame() and drawFrame(): streams
+  // around the eye, swaps in landed remeshes and submits the visible set.
+  // Returns the triangles submitted.
+  uint64_t update(const Vec3& eye, const Vec3& forward);
+  uint64_t update(const Camera& camera);
+  // Nothing left to generate, mesh, upload, edit or swap.
+  bool settled() const;
+
+private:
+  Renderer& m_renderer;
+  Scene m_scene;
+  StreamedMeshes<Renderer::Mesh> m_meshes;
+  std::unique_ptr<ChunkStreamer> m_streamer; // destroyed first: its callbacks point at m_meshes
+};
@@ -0,0 +1,526 @@
+#include "streaming.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+#include <thread>
+#include <utility>
+
+namespace {
+constexpr size_t DEFAULT_CHUNK_BYTES = size_t{16} << 10; // admission estimate before any chunk is resident
+
+template<class F> void forNeighbourhood(const ChunkCoord& c, F&& fn){
+  fn(c);
+  fn(ChunkCoord{c.x-1,c.y,c.z}); fn(ChunkCoord{c.x+1,c.y,c.z});
+  fn(ChunkCoord{c.x,c.y-1,c.z}); fn(ChunkCoord{c.x,c.y+1,c.z});
+  fn(ChunkCoord{c.x,c.y,c.z-1}); fn(ChunkCoord{c.x,c.y,c.z+1});
+}
+}
+
+ChunkStreamer::ChunkStreamer(Scene& scene, JobSystem& jobs, Generator generator, const StreamingConfig& config)
+  : m_scene(scene), m_jobs(jobs), m_generator(std::move(generator)), m_config(config) {
+  m_lodGenerator = [this](const LodTile& t, Chunk& out){ buildLodTile(m_generator, t, out); };
+}
+
+ChunkStreamer::~ChunkStreamer(){ finishJobs(); }
+
+void ChunkStreamer::setUploader(Upload upload, Release release){
+  m_upload = std::move(upload);
+  m_release = std::move(release);
+}
+
+void ChunkStreamer::setLodUploader(LodUpload upload, LodRelease release){
+  m_lodUpload = std::move(upload);
+  m_lodRelease = std::move(release);
+}
+
+void ChunkStreamer::setLodGenerator(LodGenerator generator){ m_lodGenerator = std::move(generator); }
+
+void ChunkStreamer::setLanded(Landed landed){ m_landed = std::move(landed); }
+
+void ChunkStreamer::setBlock(const BlockPos& p, BlockId b){ m_edits.push_back({p, b}); }
+
+void ChunkStreamer::finishJobs(){
+  // Not wait(): background jobs only run on background workers or when helped.
+  while(!m_counter.done()){
+    if(m_jobs.helpBackground(std::chrono::steady_clock::now() + std::chrono::milliseconds(1)) == 0) std::this_thread::yield();
+  }
+  m_jobs.wait(m_counter); // returns at once; waits for the last job to let go of the counter
+}
+
+float ChunkStreamer::priority(const ChunkCoord& c, const Vec3& eye, const Vec3& forward){
+  constexpr float N = static_cast<float>(Chunk::SIZE);
+  const Vec3 center{(static_cast<float>(c.x) + 0.5f)*N, (static_cast<float>(c.y) + 0.5f)*N, (static_cast<float>(c.z) + 0.5f)*N};
+  const Vec3 d = center - eye;
+  const float dist = length(d);
+  if(dist <= 0.f) return 0.f;
+  const float facing = dot(d, forward) / dist; // 1 ahead, -1 behind
+  return dist / N * (1.5f - 0.5f*facing);
+}
+
+float ChunkStreamer::tilePriority(const LodTile& t, const Vec3& eye, const Vec3& forward) const {
+  // Nearest point rather than centre: a tile is as urgent as the chunks next to it.
+  constexpr float N = static_cast<float>(Chunk::SIZE);
+  const ChunkCoord c = t.firstChunk();
+  const float half = static_cast<float>(t.chunks()) * 0.5f;
+  const Vec3 center{(static_cast<float>(c.x) + half)*N, (static_cast<float>(c.y) + half)*N, (static_cast<float>(c.z) + half)*N};
+  const Vec3 d = center - eye;
+  const float dist = length(d);
+  const float facing = dist > 0.f ? dot(d, forward) / dist : 1.f;
+  return m_selection.distance(t) * (1.5f - 0.5f*facing);
+}
+
+bool ChunkStreamer::fullDetail(const ChunkCoord& c, float slack) const {
+  bool any = false;
+  forNeighbourhood(c, [&](const ChunkCoord& n){ any = any || m_selection.selected({n, 0}, slack); });
+  return any;
+}
+
+bool ChunkStreamer::inRadius(const ChunkCoord& c, const ChunkCoord& eyeChunk, int extra) const {
+  const int dx = c.x - eyeChunk.x, dy = c.y - eyeChunk.y, dz = c.z - eyeChunk.z;
+  const int r = m_config.radius + extra;
+  return dx*dx + dz*dz <= r*r && std::abs(dy) <= m_config.verticalRadius + extra;
+}
+
+void ChunkStreamer::update(const Vec3& eye, const Vec3& forward){
+  BLOCCO_ZONE("streaming update");
+  const ChunkCoord eyeChunk = Scene::chunkOf(static_cast<int>(std::floor(eye.x)), static_cast<int>(std::floor(eye.y)), static_cast<int>(std::floor(eye.z)));
+  m_stats.editLatencyMs = 0.0;
+  m_selection = LodSelection(eye, m_config.radius, m_config.verticalRadius, m_config.lodLevels);
+  drainResults();
+  applyEdits();
+  for(auto& [c, e] : m_entries) e.priority = priority(c, eye, forward);
+  for(auto& [t, e] : m_tiles) e.priority = tilePriority(t, eye, forward);
+  evict(eyeChunk);
+  schedule(eyeChunk, eye, forward);
+  if(m_jobs.threadCount() == 1 && m_config.inlineMs > 0.0){
+    m_jobs.helpBackground(std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(m_config.inlineMs)));
+  }
+  upload();
+  updateVisible();
+  m_stats.resident = 0; m_stats.meshes = 0; m_stats.pendingUploads = 0;
+  for(const auto& [c, e] : m_entries){
+    m_stats.resident += e.state != State::Generating;
+    m_stats.meshes += e.uploaded;
+    m_stats.pendingUploads += e.state == State::Meshed;
+  }
+  for(const auto& [t, e] : m_tiles) m_stats.pendingUploads += e.state == State::Meshed;
+  m_stats.tiles = static_cast<uint32_t>(m_tiles.size());
+  m_stats.inFlight = m_inFlight;
+  m_stats.memoryBytes = m_memory;
+  m_stats.pendingEdits = static_cast<uint32_t>(m_edits.size());
+}
+
+void ChunkStreamer::drainResults(){
+  {
+    std::lock_guard lk(m_resultLock);
+    m_drained.swap(m_results);
+  }
+  for(Result& r : m_drained){
+    --m_inFlight;
+    if(r.level > 0){
+      ++m_stats.tilesBuilt;
+      TileEntry& t = m_tiles.at(LodTile{r.coord, r.level}); // building tiles are never evicted
+      if(r.mesh.empty()){ t.state = State::Done; continue; }
+      t.meshBytes = r.mesh.bytes();
+      m_memory += t.meshBytes;
+      t.mesh = std::move(r.mesh);
+      t.state = State::Meshed;
+      continue;
+    }
+    Entry& e = m_entries.at(r.coord); // entries with jobs in flight are never evicted
+    if(!r.meshed){
+      ++m_stats.generated;
+      e.state = State::Generated;
+      if(r.chunk.empty()){ e.empty = true; e.state = State::Done; } // nothing to mesh, nothing to store
+      else {
+        Chunk& chunk = m_scene.chunkAt(r.coord);
+        chunk = std::move(r.chunk);
+        e.chunkBytes = chunk.memoryUsage();
+        m_memory += e.chunkBytes;
+      }
+      continue;
+    }
+    ++m_stats.meshed;
+    forNeighbourhood(r.coord, [&](const ChunkCoord& n){ --m_entries.at(n).pins; });
+    // A remesh replaces the uploaded mesh, or drops it when no faces are left.
+    m_memory -= e.meshBytes;
+    e.meshBytes = 0;
+    if(e.slices){
+      m_memory -= e.sliceBytes;
+      e.sliceBytes = e.slices->bytes();
+      m_memory += e.sliceBytes;
+    }
+    if(r.mesh.empty()){
+      if(e.uploaded && m_release) m_release(r.coord);
+      e.uploaded = false;
+      e.quads = 0;
+      e.state = State::Done;
+      editVisible(e);
+      continue;
+    }
+    e.meshBytes = r.mesh.bytes();
+    m_memory += e.meshBytes;
+    e.mesh = std::move(r.mesh);
+    e.state = State::Meshed;
+  }
+  m_drained.clear();
+}
+
+void ChunkStreamer::applyEdits(){
+  if(m_edits.empty()) return;
+  BLOCCO_ZONE("apply edits");
+  const Clock::time_point now = Clock::now();
+  size_t kept = 0;
+  for(const Edit& ed : m_edits){
+    const ChunkCoord c = Scene::chunkOf(ed.pos.x, ed.pos.y, ed.pos.z);
+    const auto it = m_entries.find(c);
+    if(it == m_entries.end() || it->second.state == State::Generating){ ++m_stats.editsDropped; continue; }
+    Entry& e = it->second;
+    // A job reads the chunk: its own mesh or a neighbour's. Pins only drop in
+    // drainResults(), so later edits to the chunk wait too and keep their order.
+    if(e.pins > 0){ m_edits[kept++] = ed; continue; }
+    ++m_stats.edits;
+    Chunk* chunk = m_scene.findChunk(c);
+    if(!chunk){
+      if(ed.block == BLOCK_AIR) continue;
+      chunk = &m_scene.chunkAt(c);
+      e.empty = false;
+    }
+    const int x = ed.pos.x & Chunk::MASK, y = ed.pos.y & Chunk::MASK, z = ed.pos.z & Chunk::MASK;
+    if(chunk->get(x, y, z) == ed.block) continue;
+    chunk->set(x, y, z, ed.block);
+    m_memory -= e.chunkBytes;
+    e.chunkBytes = chunk->memoryUsage();
+    m_memory += e.chunkBytes;
+    forMeshesReading(ed.pos, [&](const ChunkCoord& n, int lx, int ly, int lz){ markDirty(n, lx, ly, lz, now); });
+  }
+  m_edits.resize(kept);
+}
+
+void ChunkStreamer::markDirty(const ChunkCoord& c, int x, int y, int z, Clock::time_point now){
+  const auto it = m_entries.find(c);
+  if(it == m_entries.end()) return;
+  Entry& e = it->second;
+  // Chunks not meshed yet will see the edit when they are; all-air ones have no faces.
+  if(e.empty || e.state == State::Generating || e.state == State::Generated) return;
+  if(!e.dirty.any()) e.dirtySince = now;
+  e.dirty.touch(x, y, z);
+  if(!e.slices){
+    e.slices = std::make_unique<SlicedMesh>();
+    e.slices->format = m_config.format;
+  }
+}
+
+void ChunkStreamer::editVisible(Entry& e){
+  if(e.meshEdited == Clock::time_point{}) return;
+  m_stats.editLatencyMs = std::max(m_stats.editLatencyMs, std::chrono::duration<double, std::milli>(Clock::now() - e.meshEdited).count());
+  e.meshEdited = {};
+}
+
+void ChunkStreamer::evictEntry(std::unordered_map<ChunkCoord, Entry, ChunkCoordHash>::iterator it){
+  Entry& e = it->second;
+  if(e.uploaded && m_release) m_release(it->first);
+  if(!e.empty) m_scene.removeChunk(it->first);
+  m_memory -= e.chunkBytes + e.meshBytes + e.sliceBytes;
+  ++m_stats.evicted;
+  m_entries.erase(it);
+}
+
+void ChunkStreamer::evictTile(Tiles::iterator it){
+  if(it->second.uploaded && m_lodRelease) m_lodRelease(it->first);
+  m_memory -= it->second.meshBytes;
+  m_tiles.erase(it);
+}
+
+void ChunkStreamer::evict(const ChunkCoord& eyeChunk){
+  // What visible() covers the view with stays until it no longer does.
+  auto idle = [](const Entry& e){ return e.pins == 0 && e.state != State::Generating && e.state != State::Meshing && !e.visible; };
+  auto idleTile = [](const TileEntry& e){ return e.state != State::Generating && !e.visible; };
+  // Hysteresis (a chunk, or a quarter of the LOD distances) so moving back and
+  // forth across a boundary does not reload.
+  constexpr float SLACK = 1.25f;
+  for(auto it = m_entries.begin(); it != m_entries.end();){
+    auto next = std::next(it);
+    if(idle(it->second) && !(lod() ? fullDetail(it->first, SLACK) : inRadius(it->first, eyeChunk, 1))) evictEntry(it);
+    it = next;
+  }
+  for(auto it = m_tiles.begin(); it != m_tiles.end();){
+    auto next = std::next(it);
+    if(idleTile(it->second) && !m_selection.selected(it->first, SLACK)) evictTile(it);
+    it = next;
+  }
+  if(m_memory < m_config.memoryBudget - m_config.memoryBudget/10) m_admitLimit = std::numeric_limits<float>::infinity();
+  while(m_memory > m_config.memoryBudget){
+    auto worst = m_entries.end();
+    auto worstTile = m_tiles.end();
+    float worstPriority = -1.f;
+    for(auto it = m_entries.begin(); it != m_entries.end(); ++it){
+      if(idle(it->second) && it->second.priority > worstPriority){ worst = it; worstPriority = it->second.priority; }
+    }
+    for(auto it = m_tiles.begin(); it != m_tiles.end(); ++it){
+      if(idleTile(it->second) && it->second.priority > worstPriority){ worstTile = it; worstPriority = it->second.priority; }
+    }
+    if(worstTile != m_tiles.end()) evictTile(worstTile);
+    else if(worst != m_entries.end()) evictEntry(worst);
+    else break;
+    m_admitLimit = worstPriority;
+  }
+}
+
+bool ChunkStreamer::neighboursGenerated(const ChunkCoord& c) const {
+  bool ready = true;
+  forNeighbourhood(c, [&](const ChunkCoord& n){
+    const auto it = m_entries.find(n);
+    ready = ready && it != m_entries.end() && it->second.state != State::Generating;
+  });
+  return ready;
+}
+
+void ChunkStreamer::schedule(const ChunkCoord& eyeChunk, const Vec3& eye, const Vec3& forward){
+  // Remeshes go first and ignore the job limit, so edits show within a frame or
+  // two; at most one per chunk is in flight, which bounds them.
+  for(auto& [c, e] : m_entries){
+    if(e.state == State::Done && e.dirty.any() && neighboursGenerated(c)) startMeshing(c, e);
+  }
+  const uint32_t maxJobs = m_config.maxJobs ? m_config.maxJobs : 2*m_jobs.threadCount();
+  if(m_inFlight >= maxJobs) return;
+  m_work.clear();
+  for(const auto& [c, e] : m_entries){
+    if(e.state == State::Generated && neighboursGenerated(c)) m_work.push_back({e.priority, c, true});
+  }
+  if(!lod()){
+    const int r = m_config.radius, vr = m_config.verticalRadius;
+    for(int dy=-vr;dy<=vr;++dy) for(int dz=-r;dz<=r;++dz) for(int dx=-r;dx<=r;++dx){
+      if(dx*dx + dz*dz > r*r) continue;
+      const ChunkCoord c{eyeChunk.x + dx, eyeChunk.y + dy, eyeChunk.z + dz};
+      if(m_entries.contains(c)) continue;
+      const float p = priority(c, eye, forward);
+      if(p < m_admitLimit) m_work.push_back({p, c, false});
+    }
+  } else {
+    // Level 0 reaches at most two chunks past the radius (its tiles are two
+    // chunks wide), plus the ring its meshes read.
+    const int r = m_config.radius + 3, vr = m_config.verticalRadius + 1;
+    for(int dy=-vr;dy<=vr;++dy) for(int dz=-r;dz<=r;++dz) for(int dx=-r;dx<=r;++dx){
+      const ChunkCoord c{eyeChunk.x + dx, eyeChunk.y + dy, eyeChunk.z + dz};
+      if(m_entries.contains(c) || !fullDetail(c, 1.f)) continue;
+      const float p = priority(c, eye, forward);
+      if(p < m_admitLimit) m_work.push_back({p, c, false});
+    }
+    m_cut.clear();
+    m_selection.select(m_cut);
+    for(const LodTile& t : m_cut){
+      if(t.level == 0 || m_tiles.contains(t)) continue;
+      const float p = tilePriority(t, eye, forward);
+      if(p < m_admitLimit) m_work.push_back({p, t.coord, false, t.level});
+    }
+  }
+  const size_t slots = std::min<size_t>(m_work.size(), maxJobs - m_inFlight);
+  // Meshing can finish without a job, so look further than the free slots.
+  const auto sorted = m_work.begin() + static_cast<std::ptrdiff_t>(std::min(m_work.size(), slots*4));
+  std::partial_sort(m_work.begin(), sorted, m_work.end(), [](const Work& a, const Work& b){ return a.priority < b.priority; });
+  const size_t resident = m_entries.size();
+  const size_t estimate = resident ? std::max<size_t>(m_memory / resident, 1) : DEFAULT_CHUNK_BYTES;
+  for(auto it = m_work.begin(); it != sorted && m_inFlight < maxJobs; ++it){
+    if(it->mesh){ startMeshing(it->coord, m_entries.at(it->coord)); continue; }
+    if(m_memory + (m_inFlight + 1)*estimate > m_config.memoryBudget) continue;
+    if(it->level > 0) startTile({it->coord, it->level}, it->priority);
+    else startGeneration(it->coord, it->priority);
+  }
+}
+
+void ChunkStreamer::startGeneration(const ChunkCoord& c, float priority){
+  Entry& e = m_entries[c];
+  e.priority = priority;
+  ++m_inFlight;
+  m_jobs.runBackground([this, c]{
+    BLOCCO_ZONE("generate chunk");
+    Result r;
+    r.coord = c;
+    m_generator(c, r.chunk);
+    std::lock_guard lk(m_resultLock);
+    m_results.push_back(std::move(r));
+  }, &m_counter);
+}
+
+void ChunkStreamer::startMeshing(const ChunkCoord& c, Entry& e){
+  const ChunkNeighbourhood n = ChunkNeighbourhood::of(m_scene, c);
+  const DirtySlices dirty = std::exchange(e.dirty, DirtySlices{});
+  e.meshEdited = std::exchange(e.dirtySince, Clock::time_point{});
+  // A solid chunk boxed in by solid chunks has no visible faces.
+  auto solid = [](const Chunk* k){ return k && k->uniform() && !k->empty(); };
+  if(solid(n.center) && std::all_of(n.faces.begin(), n.faces.end(), solid)){
+    if(e.uploaded && m_release) m_release(c);
+    e.uploaded = false;
+    e.quads = 0;
+    m_memory -= e.meshBytes;
+    e.meshBytes = 0;
+    e.state = State::Done;
+    editVisible(e);
+    return;
+  }
+  forNeighbourhood(c, [&](const ChunkCoord& k){ ++m_entries.at(k).pins; });
+  e.state = State::Meshing;
+  ++m_inFlight;
+  // The pins keep every block this mesh reads unchanged until the result is
+  // drained, so the slice cache stays consistent with the dirty masks.
+  SlicedMesh* slices = e.slices.get();
+  if(slices) ++m_stats.remeshes;
+  m_jobs.runBackground([this, c, n, dirty, slices]{
+    BLOCCO_ZONE("mesh chunk");
+    thread_local ChunkMesher mesher;
+    Result r;
+    r.coord = c;
+    r.meshed = true;
+    r.mesh.format = m_config.format;
+    if(slices){
+      mesher.remesh(n, dirty, *slices);
+      slices->flatten(r.mesh);
+    } else {
+      mesher.mesh(n, r.mesh);
+    }
+    std::lock_guard lk(m_resultLock);
+    m_results.push_back(std::move(r));
+  }, &m_counter);
+}
+
+void ChunkStreamer::startTile(const LodTile& t, float priority){
+  TileEntry& e = m_tiles[t];
+  e.priority = priority;
+  ++m_inFlight;
+  m_jobs.runBackground([this, t]{
+    BLOCCO_ZONE("build lod tile");
+    thread_local ChunkMesher mesher;
+    thread_local Chunk chunk;
+    m_lodGenerator(t, chunk);
+    Result r;
+    r.coord = t.coord;
+    r.level = t.level;
+    r.meshed = true;
+    r.mesh.format = m_config.format;
+    // Meshed alone: with air all around, the tile keeps its side faces as skirts.
+    // No occlusion: corners 2^level blocks wide would darken what full detail
+    // does not, and splitting quads on them doubles the tile's triangles.
+    mesher.setOcclusion(false);
+    if(!chunk.empty()) mesher.mesh(ChunkNeighbourhood{&chunk, {}}, r.mesh);
+    std::lock_guard lk(m_resultLock);
+    m_results.push_back(std::move(r));
+  }, &m_counter);
+}
+
+void ChunkStreamer::upload(){
+  m_uploadOrder.clear();
+  for(const auto& [c, e] : m_entries){
+    if(e.state == State::Meshed) m_uploadOrder.push_back({c, 0});
+  }
+  for(const auto& [t, e] : m_tiles){
+    if(e.state == State::Meshed) m_uploadOrder.push_back(t);
+  }
+  // Meshes carrying edits first, then by priority.
+  auto edited = [&](const LodTile& t){ return t.level == 0 && m_entries.at(t.coord).meshEdited != Clock::time_point{}; };
+  auto urgency = [&](const LodTile& t){ return t.level == 0 ? m_entries.at(t.coord).priority : m_tiles.at(t).priority; };
+  std::sort(m_uploadOrder.begin(), m_uploadOrder.end(), [&](const LodTile& a, const LodTile& b){
+    const bool editedA = edited(a), editedB = edited(b);
+    if(editedA != editedB) return editedA;
+    return urgency(a) < urgency(b);
+  });
+  size_t bytes = 0;
+  for(const LodTile& t : m_uploadOrder){
+    if(t.level > 0){
+      TileEntry& e = m_tiles.at(t);
+      if(bytes > 0 && bytes + e.meshBytes > m_config.uploadBudget) break;
+      if(m_lodUpload) m_lodUpload(t, e.mesh);
+      bytes += e.meshBytes;
+      e.quads = e.mesh.quadCount();
+      e.mesh = MeshBuffers{};
+      e.state = State::Done;
+      e.uploaded = static_cast<bool>(m_lodUpload);
+      ++m_stats.uploaded;
+      continue;
+    }
+    Entry& e = m_entries.at(t.coord);
+    // At least one mesh per update, however large.
+    if(bytes > 0 && bytes + e.meshBytes > m_config.uploadBudget) break;
+    if(m_upload) m_upload(t.coord, e.mesh);
+    bytes += e.meshBytes;
+    e.quads = e.mesh.quadCount();
+    e.mesh = MeshBuffers{};
+    e.state = State::Done;
+    e.uploaded = static_cast<bool>(m_upload);
+    ++m_stats.uploaded;
+    editVisible(e);
+  }
+  m_stats.uploadedBytes = bytes;
+}
+
+bool ChunkStreamer::ready(const LodTile& t) const {
+  // Done without an upload: nothing to draw there.
+  auto landed = [&]{ return !m_landed || m_landed(t); };
+  if(t.level == 0){
+    const auto it = m_entries.find(t.coord);
+    return it != m_entries.end() && (it->second.uploaded ? landed() : it->second.state == State::Done);
+  }
+  const auto it = m_tiles.find(t);
+  return it != m_tiles.end() && (it->second.uploaded ? landed() : it->second.state == State::Done);
+}
+
+// Appends the ready nodes covering t's part of the view; false where some of it
+// has none. A selected node draws itself once ready, else the finest ready
+// meshes below it (those it replaces: below a selected node nothing splits,
+// so this recursion walks down to whatever is ready). A split node draws its
+// children once all are covered, else itself while it is still ready (the
+// coarse mesh they replace).
+bool ChunkStreamer::cover(const LodTile& t, std::vector<LodTile>& out) const {
+  const bool split = m_selection.split(t);
+  if(!split && ready(t)){ out.push_back(t); return true; }
+  if(t.level == 0) return false;
+  const size_t mark = out.size();
+  bool full = true;
+  for(int i=0;i<8;++i){
+    const LodTile c = t.child(i);
+    if(m_selection.inView(c)) full = cover(c, out) && full;
+  }
+  if(!full && split && ready(t)){
+    out.resize(mark);
+    out.push_back(t);
+    return true;
+  }
+  return full;
+}
+
+void ChunkStreamer::updateVisible(){
+  for(auto& [c, e] : m_entries) e.visible = false;
+  for(auto& [t, e] : m_tiles) e.visible = false;
+  m_visible.clear();
+  m_stats.visibleQuads = 0;
+  if(!lod()){
+    for(const auto& [c, e] : m_entries){
+      if(!e.uploaded) continue;
+      m_visible.push_back({c, 0});
+      m_stats.visibleQuads += e.quads;
+    }
+    m_stats.visible = static_cast<uint32_t>(m_visible.size());
+    return;
+  }
+  m_covered.clear();
+  m_selection.forEachRoot([&](const LodTile& t){ if(m_selection.inView(t)) cover(t, m_covered); });
+  for(const LodTile& t : m_covered){
+    bool uploaded;
+    size_t quads;
+    if(t.level == 0){
+      Entry& e = m_entries.at(t.coord);
+      e.visible = true;
+      uploaded = e.uploaded; quads = e.quads;
+    } else {
+      TileEntry& e = m_tiles.at(t);
+      e.visible = true;
+      uploaded = e.uploaded; quads = e.quads;
+    }
+    if(!uploaded) continue;
+    m_visible.push_back(t);
+    m_stats.visibleQuads += quads;
+  }
+  m_stats.visible = static_cast<uint32_t>(m_visible.size());
+}
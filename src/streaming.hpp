@@ -0,0 +1,220 @@
+#pragma once
+#include "camera.hpp"
+#include "jobs.hpp"
+#include "lod.hpp"
+#include "math.hpp"
+#include "mesher.hpp"
+#include "scene.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct StreamingConfig {
+  int radius{8};         // chunks kept resident around the camera, horizontally
+  int verticalRadius{3}; // and vertically
+  size_t memoryBudget{size_t{192} << 20}; // voxel data plus meshes (CPU until uploaded, then GPU)
+  size_t uploadBudget{size_t{2} << 20};   // mesh bytes handed to the uploader per update
+  uint32_t maxJobs{0};   // generation and meshing jobs in flight; 0 = two per thread
+  double inlineMs{2.0};  // without background workers: time per update spent running jobs
+  VertexFormat format{VertexFormat::Float}; // what the uploader expects
+  int lodLevels{0};      // coarser levels past radius, each doubling the view distance (LodSelection)
+};
+
+struct StreamingStats {
+  uint32_t resident{0};       // generated chunks held, all-air ones included
+  uint32_t meshes{0};         // chunks whose mesh has been uploaded
+  uint32_t inFlight{0};       // generation and meshing jobs
+  uint32_t pendingUploads{0};
+  size_t memoryBytes{0};
+  size_t uploadedBytes{0};    // by the last update
+  uint64_t generated{0}, meshed{0}, uploaded{0}, evicted{0};
+  uint64_t edits{0};          // applied to the Scene
+  uint64_t editsDropped{0};   // aimed at chunks not resident yet
+  uint32_t pendingEdits{0};   // waiting for jobs reading their chunk
+  uint64_t remeshes{0};       // incremental mesh rebuilds after edits
+  double editLatencyMs{0.0};  // worst edit-to-upload time of the last update's remeshes
+  uint32_t tiles{0};          // LOD tiles held
+  uint64_t tilesBuilt{0};
+  uint32_t visible{0};        // meshes in visible()
+  size_t visibleQuads{0};
+};
+
+// Keeps the chunks around the camera resident in a Scene. Generation and
+// meshing run as background jobs, most urgent first (near, then in view);
+// finished meshes are handed to the uploader under a per-update byte budget,
+// and chunks beyond the radius, or the least urgent ones when over the memory
+// budget, are evicted. A chunk is meshed once its six neighbours are
+// generated, so meshes end one chunk inside the generated radius.
+//
+// Everything but the generator runs on the thread calling update(), which owns
+// the Scene: jobs only read chunks pinned for them and hand results back.
+//
+// Block edits go through setBlock() and are applied in a batch by the next
+// update(), or a later one while a job still reads the chunk. Each chunk keeps
+// a DirtySlices mask fed by every edit its mesh reads (its own blocks, and a
+// face neighbour's facing plane). A dirty chunk is remeshed by one background
+// job at a time from a per-slice cache, so edits arriving meanwhile coalesce
+// into the next rebuild, and the result goes through upload() like any mesh.
+//
+// With lodLevels > 0 the chunks resident at full detail are those the
+// LodSelection around the eye keeps at level 0 (plus the ring their meshes
+// read), and the rest of the view is covered by LodTiles: each built by one job
+// from the LodGenerator and meshed on its own, so the faces on its sides stay
+// as skirts hiding the seams against finer neighbours, and without occlusion.
+// Tiles are not edited.
+// visible() is the set to draw: when the cut moves, a coarse mesh stays in it
+// until every finer mesh replacing it is ready, and finer ones stay until the
+// coarse one is, so level changes swap in one update without holes.
+class ChunkStreamer {
+public:
+  using Generator = std::function<void(const ChunkCoord&, Chunk&)>; // any thread
+  using Upload = std::function<void(const ChunkCoord&, const MeshBuffers&)>;
+  using Release = std::function<void(const ChunkCoord&)>;
+  using LodGenerator = std::function<void(const LodTile&, Chunk&)>; // any thread
+  using LodUpload = std::function<void(const LodTile&, const MeshBuffers&)>;
+  using LodRelease = std::function<void(const LodTile&)>;
+  using Landed = std::function<bool(const LodTile&)>;
+
+  ChunkStreamer(Scene& scene, JobSystem& jobs, Generator generator, const StreamingConfig& config = {});
+  // Waits for jobs in flight. Uploaded meshes are not released: their owner
+  // tracks them through the callbacks.
+  ~ChunkStreamer();
+  ChunkStreamer(const ChunkStreamer&) = delete;
+  ChunkStreamer& operator=(const ChunkStreamer&) = delete;
+
+  // upload receives each non-empty mesh; after edits it is called again for the
+  // same chunk with a mesh that replaces the previous one. release is called
+  // before a chunk whose mesh was uploaded is evicted, or when edits leave it
+  // with no faces.
+  void setUploader(Upload upload, Release release);
+  // Tiles past level 0 go through these instead; each is uploaded once.
+  void setLodUploader(LodUpload upload, LodRelease release);
+  // Defaults to buildLodTile() over the chunk generator, which generates every
+  // chunk a tile covers.
+  void setLodGenerator(LodGenerator generator);
+  // Whether a mesh handed over can be drawn yet (uploads may land frames
+  // later); without it, uploaded meshes count as drawable at once.
+  void setLanded(Landed landed);
+  // Queued for the next update(). Edits to chunks not yet generated are dropped.
+  void setBlock(const BlockPos& p, BlockId b);
+  void update(const Vec3& eye, const Vec3& forward);
+  void update(const Camera& camera){ update(camera.position, camera.forward()); }
+  // Blocks until every job in flight has finished; results apply at the next update().
+  void finishJobs();
+
+  const StreamingStats& stats() const { return m_stats; }
+  const StreamingConfig& config() const { return m_config; }
+  const LodSelection& selection() const { return m_selection; }
+  // Uploaded meshes to draw after the last update, each region once: every
+  // uploaded chunk without LOD, else the ready part of the cut (level 0 entries
+  // went through upload, the others through the LOD uploader).
+  const std::vector<LodTile>& visible() const { return m_visible; }
+  // Lower is more urgent: distance in chunks, doubled directly behind the camera.
+  static float priority(const ChunkCoord& c, const Vec3& eye, const Vec3& forward);
+
+private:
+  enum class State : uint8_t { Generating, Generated, Meshing, Meshed, Done };
+  using Clock = std::chrono::steady_clock;
+  struct Entry {
+    State state{State::Generating};
+    bool empty{false};    // all air: not stored in the Scene
+    bool uploaded{false};
+    bool visible{false};  // covered part of the view: not evicted
+    uint16_t pins{0};     // mesh jobs reading this chunk
+    float priority{0.f};
+    size_t chunkBytes{0};
+    size_t meshBytes{0};  // CPU while Meshed, GPU once uploaded
+    size_t sliceBytes{0}; // the remesh cache
+    size_t quads{0};      // of the uploaded mesh
+    MeshBuffers mesh;     // Meshed: waiting for upload
+    DirtySlices dirty;    // edits since the last mesh job started
+    Clock::time_point dirtySince{};   // oldest of those edits
+    Clock::time_point meshEdited{};   // oldest edit the pending mesh includes
+    std::unique_ptr<SlicedMesh> slices; // created by the first edit; only the mesh job touches it while Meshing
+  };
+  // Generating while its job runs, then Meshed until uploaded, then Done.
+  struct TileEntry {
+    State state{State::Generating};
+    bool uploaded{false};
+    bool visible{false};
+    float priority{0.f};
+    size_t meshBytes{0};
+    size_t quads{0};
+    MeshBuffers mesh;
+  };
+  using Tiles = std::unordered_map<LodTile, TileEntry, LodTileHash>;
+  struct Result {
+    ChunkCoord coord;
+    uint8_t level{0};     // > 0: a LOD tile, always meshed
+    bool meshed{false};
+    Chunk chunk;
+    MeshBuffers mesh;
+  };
+  struct Work {
+    float priority;
+    ChunkCoord coord;
+    bool mesh;
+    uint8_t level{0};
+  };
+  struct Edit {
+    BlockPos pos;
+    BlockId block;
+  };
+  void drainResults();
+  void applyEdits();
+  void markDirty(const ChunkCoord& c, int x, int y, int z, Clock::time_point now);
+  void editVisible(Entry& e);
+  void evict(const ChunkCoord& eyeChunk);
+  void evictEntry(std::unordered_map<ChunkCoord, Entry, ChunkCoordHash>::iterator it);
+  void evictTile(Tiles::iterator it);
+  void schedule(const ChunkCoord& eyeChunk, const Vec3& eye, const Vec3& forward);
+  bool neighboursGenerated(const ChunkCoord& c) const;
+  void startGeneration(const ChunkCoord& c, float priority);
+  void startMeshing(const ChunkCoord& c, Entry& e);
+  void startTile(const LodTile& t, float priority);
+  void upload();
+  void updateVisible();
+  bool cover(const LodTile& t, std::vector<LodTile>& out) const;
+  bool ready(const LodTile& t) const;
+  bool inRadius(const ChunkCoord& c, const ChunkCoord& eyeChunk, int extra) const;
+  // Level 0 of the cut, or read by a mesh that is; slack as in LodSelection.
+  bool fullDetail(const ChunkCoord& c, float slack) const;
+  float tilePriority(const LodTile& t, const Vec3& eye, const Vec3& forward) const;
+  bool lod() const { return m_config.lodLevels > 0; }
+
+  Scene& m_scene;
+  JobSystem& m_jobs;
+  Generator m_generator;
+  StreamingConfig m_config;
+  Upload m_upload;
+  Release m_release;
+  LodGenerator m_lodGenerator;
+  LodUpload m_lodUpload;
+  LodRelease m_lodRelease;
+  Landed m_landed;
+  std::unordered_map<ChunkCoord, Entry, ChunkCoordHash> m_entries;
+  Tiles m_tiles;
+  LodSelection m_selection;
+  size_t m_memory{0};
+  uint32_t m_inFlight{0};
+  // After evicting for the memory budget, loads must be more urgent than the
+  // chunk evicted last, so a full budget does not cycle the same chunks.
+  float m_admitLimit{std::numeric_limits<float>::infinity()};
+  JobCounter m_counter;
+  std::mutex m_resultLock;
+  std::vector<Result> m_results;  // filled by jobs
+  std::vector<Result> m_drained;  // main thread
+  std::vector<Work> m_work;
+  std::vector<LodTile> m_uploadOrder;
+  std::vector<LodTile> m_cut;     // scratch: selected tiles
+  std::vector<LodTile> m_covered; // ready nodes covering the view, drawable or not
+  std::vector<LodTile> m_visible;
+  std::vector<Edit> m_edits;
+  StreamingStats m_stats;
+};
@@ -0,0 +1,106 @@
+#include "terrain.hpp"
+#include <algorithm>
+
+namespace {
+float lattice(uint32_t seed, int32_t x, int32_t z){
+  uint32_t h = seed ^ (static_cast<uint32_t>(x) * 0x27d4eb2du) ^ (static_cast<uint32_t>(z) * 0x165667b1u);
+  h ^= h >> 15; h *= 0x85ebca6bu; h ^= h >> 13; h *= 0xc2b2ae35u; h ^= h >> 16;
+  return static_cast<float>(h >> 8) * (1.f / 16777216.f);
+}
+
+int floorDiv(int a, int b){ return a / b - ((a % b != 0) && ((a < 0) != (b < 0))); }
+
+// Smoothly interpolated lattice noise in [0, 1).
+float valueNoise(uint32_t seed, int x, int z, int cell){
+  const int cx = floorDiv(x, cell), cz = floorDiv(z, cell);
+  auto fade = [](float t){ return t*t*(3.f - 2.f*t); };
+  const float fx = fade(static_cast<float>(x - cx*cell) / static_cast<float>(cell));
+  const float fz = fade(static_cast<float>(z - cz*cell) / static_cast<float>(cell));
+  const float a = lattice(seed, cx, cz), b = lattice(seed, cx+1, cz);
+  const float c = lattice(seed, cx, cz+1), d = lattice(seed, cx+1, cz+1);
+  const float top = a + (b - a)*fx, bottom = c + (d - c)*fx;
+  return top + (bottom - top)*fz;
+}
+}
+
+int terrainHeight(const TerrainParams& p, int x, int z){
+  const int cell = std::max(p.wavelength, 2);
+  const float n = valueNoise(p.seed, x, z, cell) * (2.f/3.f) + valueNoise(p.seed * 0x9e3779b9u + 1u, x, z, std::max(cell/2, 1)) * (1.f/3.f);
+  return p.baseHeight + static_cast<int>(n * static_cast<float>(p.amplitude));
+}
+
+void generateTerrain(const TerrainParams& p, const ChunkCoord& c, Chunk& out){
+  constexpr int N = Chunk::SIZE;
+  const int x0 = c.x * N, y0 = c.y * N, z0 = c.z * N;
+  int heights[N*N];
+  int maxTop = y0, minTop = y0 + N;
+  for(int z=0;z<N;++z) for(int x=0;x<N;++x){
+    const int h = terrainHeight(p, x0 + x, z0 + z);
+    heights[z*N + x] = h;
+    maxTop = std::max(maxTop, h); minTop = std::min(minTop, h);
+  }
+  if(maxTop <= y0){ out.fill(BLOCK_AIR); return; }
+  if(minTop > y0 + N){ out.fill(BLOCK_STONE); return; }
+  out.fill(BLOCK_AIR);
+  // Stone layers under every column's grass, then runs along x where heights vary.
+  const int solidTop = std::clamp(minTop - 1 - y0, 0, N), mixedTop = std::clamp(maxTop - y0, 0, N);
+  out.fillRegion(0, 0, 0, N, solidTop, N, BLOCK_STONE);
+  for(int y=solidTop;y<mixedTop;++y){
+    const int wy = y0 + y;
+    for(int z=0;z<N;++z){
+      auto blockAt = [&](int x){
+        const int h = heights[z*N + x];
+        return wy >= h ? BLOCK_AIR : wy == h - 1 ? BLOCK_GRASS : BLOCK_STONE;
+      };
+      for(int x=0;x<N;){
+        const BlockId b = blockAt(x);
+        int run = 1;
+        while(x + run < N && blockAt(x + run) == b) ++run;
+        if(b != BLOCK_AIR) out.setRun(Chunk::index(x, y, z), run, b);
+        x += run;
+      }
+    }
+  }
+}
+
+void generateTerrainLod(const TerrainParams& p, const LodTile& t, Chunk& out){
+  if(t.level == 0){ generateTerrain(p, t.coord, out); return; }
+  constexpr int N = Chunk::SIZE;
+  const int s = 1 << t.level;
+  const ChunkCoord first = t.firstChunk();
+  const int x0 = first.x * N, y0 = first.y * N, z0 = first.z * N;
+  // Solid cells per column counted from the tile's bottom (may fall outside
+  // 0..N): cell y is solid when 2*(y0 + y*s)*s^2 + s^3 <= 2*(sum of heights).
+  int tops[N*N];
+  int maxTop = 0, minTop = N + 1;
+  for(int z=0;z<N;++z) for(int x=0;x<N;++x){
+    int64_t sum = 0;
+    for(int bz=0;bz<s;++bz) for(int bx=0;bx<s;++bx) sum += terrainHeight(p, x0 + x*s + bx, z0 + z*s + bz);
+    const int64_t area = int64_t{s} * s;
+    // Largest y with 2*(y0 + y*s)*area + s*area <= 2*sum, plus one.
+    const int64_t num = 2*sum - int64_t{s}*area - 2*int64_t{y0}*area, den = 2*int64_t{s}*area;
+    const int64_t top = (num >= 0 ? num / den : -((-num + den - 1) / den)) + 1;
+    tops[z*N + x] = static_cast<int>(std::clamp<int64_t>(top, -1, N + 1));
+    maxTop = std::max(maxTop, tops[z*N + x]); minTop = std::min(minTop, tops[z*N + x]);
+  }
+  if(maxTop <= 0){ out.fill(BLOCK_AIR); return; }
+  if(minTop > N){ out.fill(BLOCK_STONE); return; }
+  out.fill(BLOCK_AIR);
+  const int solidTop = std::clamp(minTop - 1, 0, N), mixedTop = std::clamp(maxTop, 0, N);
+  out.fillRegion(0, 0, 0, N, solidTop, N, BLOCK_STONE);
+  for(int y=solidTop;y<mixedTop;++y){
+    for(int z=0;z<N;++z){
+      auto blockAt = [&](int x){
+        const int top = tops[z*N + x];
+        return y >= top ? BLOCK_AIR : y == top - 1 ? BLOCK_GRASS : BLOCK_STONE;
+      };
+      for(int x=0;x<N;){
+        const BlockId b = blockAt(x);
+        int run = 1;
+        while(x + run < N && blockAt(x + run) == b) ++run;
+        if(b != BLOCK_AIR) out.setRun(Chunk::index(x, y, z), run, b);
+        x += run;
+      }
+    }
+  }
+}
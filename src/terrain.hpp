@@ -0,0 +1,29 @@
+#pragma once
+#include "lod.hpp"
+#include "scene.hpp"
+#include <cstdint>
+
+inline constexpr BlockId BLOCK_STONE = 1;
+inline constexpr BlockId BLOCK_GRASS = 2;
+inline constexpr BlockId BLOCK_DIRT = 3;
+inline constexpr BlockId BLOCK_SAND = 4;
+inline constexpr BlockId BLOCK_SNOW = 5;
+
+// Height-field terrain: two octaves of value noise on a hashed integer lattice,
+// grass over stone. A pure function of the parameters and the coordinate, so
+// any thread may generate any chunk.
+struct TerrainParams {
+  uint32_t seed{1};
+  int baseHeight{16}; // blocks
+  int amplitude{48};  // blocks above baseHeight at the noise maximum
+  int wavelength{96}; // blocks per lattice cell of the first octave
+};
+
+int terrainHeight(const TerrainParams& p, int x, int z);
+// Overwrites out with chunk c of the terrain.
+void generateTerrain(const TerrainParams& p, const ChunkCoord& c, Chunk& out);
+// Overwrites out with tile t at one cell per 2^level blocks, straight from the
+// height field: each cell column stands at the mean height of the columns it
+// covers, solid where at least half of the cell lies below it, with grass on
+// top. Costs one height per block column of the tile, not a chunk per chunk.
+void generateTerrainLod(const TerrainParams& p, const LodTile& t, Chunk& out);
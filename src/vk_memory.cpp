@@ -0,0 +1,242 @@
+#include "vk_memory.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+namespace vkutils {
+GpuAllocator::GpuAllocator(VkPhysicalDevice physical, VkDevice device, VkDeviceSize blockSize)
+  :m_device(device), m_blockSize(blockSize){
+  vkGetPhysicalDeviceMemoryProperties(physical, &m_props);
+  VkPhysicalDeviceProperties props{}; vkGetPhysicalDeviceProperties(physical, &props);
+  m_granularity = std::max<VkDeviceSize>(props.limits.bufferImageGranularity, 1);
+  m_pools.resize(m_props.memoryTypeCount);
+}
+
+GpuAllocator::~GpuAllocator(){
+  for(auto& pool : m_pools)
+    for(auto& b : pool) if(b.memory) vkFreeMemory(m_device, b.memory, nullptr);
+}
+
+uint32_t GpuAllocator::chooseType(uint32_t typeBits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred) const {
+  auto search = [&](VkMemoryPropertyFlags flags){
+    for(uint32_t i=0;i<m_props.memoryTypeCount;++i)
+      if((typeBits & (1u << i)) && (m_props.memoryTypes[i].propertyFlags & flags) == flags) return i;
+    return UINT32_MAX;
+  };
+  uint32_t type = preferred ? search(required | preferred) : UINT32_MAX;
+  if(type == UINT32_MAX) type = search(required);
+  if(type == UINT32_MAX) throw std::runtime_error("No suitable Vulkan memory type");
+  return type;
+}
+
+VkDeviceMemory GpuAllocator::allocateMemory(uint32_t type, VkDeviceSize size, std::byte** mapped){
+  VkMemoryAllocateInfo ai{}; ai.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  ai.allocationSize = size; ai.memoryTypeIndex = type;
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  if(vkAllocateMemory(m_device, &ai, nullptr, &memory) != VK_SUCCESS) throw std::runtime_error("Failed to allocate device memory");
+  *mapped = nullptr;
+  if(m_props.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT){
+    void* p = nullptr;
+    if(vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, &p) != VK_SUCCESS){
+      vkFreeMemory(m_device, memory, nullptr);
+      throw std::runtime_error("Failed to map device memory");
+    }
+    *mapped = static_cast<std::byte*>(p);
+  }
+  return memory;
+}
+
+Allocation GpuAllocator::allocate(const VkMemoryRequirements& reqs, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred){
+  Allocation a;
+  a.memoryType = chooseType(reqs.memoryTypeBits, required, preferred);
+  a.size = reqs.size;
+  std::lock_guard lk(m_lock);
+  std::byte* base = nullptr;
+  if(reqs.size > m_blockSize/2){
+    a.memory = allocateMemory(a.memoryType, reqs.size, &base);
+    a.mapped = base;
+    ++m_dedicated;
+    m_dedicatedBytes += reqs.size;
+    m_dedicatedPeak = std::max(m_dedicatedPeak, m_dedicatedBytes);
+    return a;
+  }
+  const VkDeviceSize align = std::max(reqs.alignment, m_granularity);
+  auto& pool = m_pools[a.memoryType];
+  for(uint32_t i=0;i<=pool.size();++i){
+    if(i == pool.size()) pool.emplace_back();
+    Block& b = pool[i];
+    if(!b.memory){
+      b.memory = allocateMemory(a.memoryType, m_blockSize, &b.mapped);
+      b.tlsf = std::make_unique<TlsfAllocator>(m_blockSize);
+    }
+    a.sub = b.tlsf->allocate(reqs.size, align);
+    if(!a.sub.valid()) continue;
+    a.memory = b.memory;
+    a.offset = a.sub.offset;
+    a.block = i;
+    a.mapped = b.mapped ? b.mapped + a.offset : nullptr;
+    return a;
+  }
+  throw std::runtime_error("GPU allocator exhausted"); // unreachable: a fresh block always fits
+}
+
+void GpuAllocator::free(Allocation& a){
+  if(!a.memory) return;
+  std::lock_guard lk(m_lock);
+  if(a.block == UINT32_MAX){
+    vkFreeMemory(m_device, a.memory, nullptr);
+    --m_dedicated;
+    m_dedicatedBytes -= a.size;
+    a = {};
+    return;
+  }
+  auto& pool = m_pools[a.memoryType];
+  Block& b = pool[a.block];
+  b.tlsf->free(a.sub);
+  // Keep one empty block per type as hysteresis against allocate/free churn.
+  if(b.tlsf->empty() && std::any_of(pool.begin(), pool.end(), [&](const Block& o){ return &o != &b && o.memory && o.tlsf->empty(); })){
+    vkFreeMemory(m_device, b.memory, nullptr);
+    b = {};
+  }
+  a = {};
+}
+
+AllocatedBuffer GpuAllocator::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred){
+  AllocatedBuffer b;
+  b.size = size;
+  VkBufferCreateInfo ci{}; ci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  ci.size = size; ci.usage = usage; ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if(vkCreateBuffer(m_device, &ci, nullptr, &b.buffer) != VK_SUCCESS) throw std::runtime_error("Failed to create buffer");
+  VkMemoryRequirements req{}; vkGetBufferMemoryRequirements(m_device, b.buffer, &req);
+  try { b.alloc = allocate(req, required, preferred); }
+  catch(...){ vkDestroyBuffer(m_device, b.buffer, nullptr); throw; }
+  vkBindBufferMemory(m_device, b.buffer, b.alloc.memory, b.alloc.offset);
+  b.mapped = b.alloc.mapped;
+  return b;
+}
+
+void GpuAllocator::destroyBuffer(AllocatedBuffer& b){
+  if(b.buffer) vkDestroyBuffer(m_device, b.buffer, nullptr);
+  free(b.alloc);
+  b = {};
+}
+
+Allocation GpuAllocator::allocateImage(VkImage image, VkMemoryPropertyFlags required){
+  VkMemoryRequirements req{}; vkGetImageMemoryRequirements(m_device, image, &req);
+  Allocation a = allocate(req, required);
+  vkBindImageMemory(m_device, image, a.memory, a.offset);
+  return a;
+}
+
+GpuMemoryStats GpuAllocator::stats() const {
+  std::lock_guard lk(m_lock);
+  GpuMemoryStats s;
+  for(const auto& pool : m_pools){
+    for(const auto& b : pool){
+      if(!b.memory) continue;
+      const MemoryStats bs = b.tlsf->stats();
+      ++s.blocks;
+      s.total.capacity += bs.capacity;
+      s.total.inUse += bs.inUse;
+      s.total.peak += bs.peak;
+      s.total.allocations += bs.allocations;
+      s.total.largestFree = std::max(s.total.largestFree, bs.largestFree);
+      s.total.fragmentation = std::max(s.total.fragmentation, bs.fragmentation);
+    }
+  }
+  s.dedicated = m_dedicated;
+  s.total.capacity += m_dedicatedBytes;
+  s.total.inUse += m_dedicatedBytes;
+  s.total.peak += m_dedicatedPeak;
+  s.total.allocations += m_dedicated;
+  s.deviceMemoryAllocations = s.blocks + s.dedicated;
+  return s;
+}
+
+FrameRing::FrameRing(GpuAllocator& allocator, VkPhysicalDevice physical, VkDeviceSize bytesPerFrame, uint32_t framesInFlight)
+  :m_allocator(allocator){
+  VkPhysicalDeviceProperties props{}; vkGetPhysicalDeviceProperties(physical, &props);
+  m_alignment = std::max({props.limits.minUniformBufferOffsetAlignment, props.limits.minStorageBufferOffsetAlignment, VkDeviceSize{16}});
+  m_regionSize = (bytesPerFrame + 255) / 256 * 256;
+  m_regionSize = (m_regionSize + m_alignment - 1) / m_alignment * m_alignment;
+  m_buffer = m_allocator.createBuffer(m_regionSize * framesInFlight,
+    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+FrameRing::~FrameRing(){ m_allocator.destroyBuffer(m_buffer); }
+
+void FrameRing::beginFrame(size_t slot){
+  m_slot = slot;
+  m_head = 0;
+  m_allocations = 0;
+}
+
+FrameRing::Slice FrameRing::allocate(VkDeviceSize size, VkDeviceSize align){
+  // m_alignment need not be a power of two; regions are multiples of 256 and of m_alignment.
+  VkDeviceSize begin = (m_head + m_alignment - 1) / m_alignment * m_alignment;
+  if(align > m_alignment) begin = (begin + align - 1) & ~(align - 1);
+  if(begin + size > m_regionSize) throw std::runtime_error("Per-frame ring buffer exhausted");
+  m_head = begin + size;
+  ++m_allocations;
+  m_peak = std::max<uint64_t>(m_peak, m_head);
+  const VkDeviceSize offset = m_slot * m_regionSize + begin;
+  return {offset, static_cast<std::byte*>(m_buffer.mapped) + offset};
+}
+
+MemoryStats FrameRing::stats() const {
+  return {m_regionSize, m_head, m_peak, m_allocations, m_regionSize - m_head, 0.f};
+}
+MeshPool::MeshPool(GpuAllocator& allocator, VkDeviceSize vertexBytes, VkDeviceSize indexBytes, uint32_t vertexStride, bool deviceLocal)
+  :m_allocator(allocator), m_vertexRanges(vertexBytes), m_indexRanges(indexBytes), m_vertexStride(vertexStride){
+  if(!std::has_single_bit(vertexStride)) throw std::runtime_error("MeshPool vertex stride must be a power of two");
+  // Storage usage lets vertex shaders pull from the pool instead of an input binding.
+  constexpr VkBufferUsageFlags vertexUsage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  if(deviceLocal){
+    m_vertices = m_allocator.createBuffer(vertexBytes, vertexUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if(indexBytes > 0)
+      m_indices = m_allocator.createBuffer(indexBytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    return;
+  }
+  constexpr VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  m_vertices = m_allocator.createBuffer(vertexBytes, vertexUsage, hostVisible, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  if(indexBytes > 0)
+    m_indices = m_allocator.createBuffer(indexBytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, hostVisible, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+MeshPool::~MeshPool(){
+  m_allocator.destroyBuffer(m_vertices);
+  m_allocator.destroyBuffer(m_indices);
+}
+
+MeshAllocation MeshPool::allocate(uint32_t vertexCount, uint32_t indexCount){
+  MeshAllocation mesh;
+  if(vertexCount == 0 || (indexCount == 0) != (m_indices.buffer == VK_NULL_HANDLE)) return mesh;
+  mesh.vertices = m_vertexRanges.allocate(uint64_t{vertexCount} * m_vertexStride, m_vertexStride);
+  if(!mesh.vertices.valid()) return {};
+  mesh.vertexOffset = static_cast<int32_t>(mesh.vertices.offset / m_vertexStride);
+  if(indexCount == 0) return mesh;
+  mesh.indices = m_indexRanges.allocate(uint64_t{indexCount} * sizeof(uint32_t));
+  if(!mesh.indices.valid()){ m_vertexRanges.free(mesh.vertices); return {}; }
+  mesh.indexCount = indexCount;
+  mesh.firstIndex = static_cast<uint32_t>(mesh.indices.offset / sizeof(uint32_t));
+  return mesh;
+}
+
+MeshAllocation MeshPool::upload(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount){
+  if(!m_vertices.mapped) throw std::runtime_error("MeshPool::upload on a device-local pool");
+  MeshAllocation mesh = allocate(vertexCount, indexCount);
+  if(!mesh.valid()) return mesh;
+  std::memcpy(static_cast<std::byte*>(m_vertices.mapped) + mesh.vertices.offset, vertices, uint64_t{vertexCount} * m_vertexStride);
+  if(indexCount > 0) std::memcpy(static_cast<std::byte*>(m_indices.mapped) + mesh.indices.offset, indices, uint64_t{indexCount} * sizeof(uint32_t));
+  return mesh;
+}
+
+void MeshPool::free(MeshAllocation& mesh){
+  if(!mesh.valid()) return;
+  m_vertexRanges.free(mesh.vertices);
+  if(mesh.indices.valid()) m_indexRanges.free(mesh.indices);
+  mesh = {};
+}
+} // namespace vkutils
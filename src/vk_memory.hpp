@@ -0,0 +1,144 @@
+// Device memory suballocation: a few large VkDeviceMemory blocks per memory type,
+// carved up with TLSF, plus a per-frame ring for transient uniform/storage data.
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "memory.hpp"
+
+namespace vkutils {
+struct Allocation {
+  VkDeviceMemory memory{VK_NULL_HANDLE};
+  VkDeviceSize offset{0};
+  VkDeviceSize size{0};
+  void* mapped{nullptr}; // already offset; null unless the memory type is host visible
+  uint32_t memoryType{UINT32_MAX};
+  uint32_t block{UINT32_MAX}; // UINT32_MAX for dedicated allocations
+  TlsfAllocation sub;
+};
+
+struct AllocatedBuffer {
+  VkBuffer buffer{VK_NULL_HANDLE};
+  Allocation alloc;
+  VkDeviceSize size{0};
+  void* mapped{nullptr};
+};
+
+struct GpuMemoryStats {
+  MemoryStats total;       // summed over blocks; fragmentation is the worst block's
+  uint32_t blocks{0};
+  uint32_t dedicated{0};
+  uint64_t deviceMemoryAllocations{0}; // live vkAllocateMemory objects
+};
+
+// Host-visible types are mapped once per block and stay mapped. Requests larger
+// than half a block get their own VkDeviceMemory. Thread-safe.
+class GpuAllocator {
+public:
+  GpuAllocator(VkPhysicalDevice physical, VkDevice device, VkDeviceSize blockSize = VkDeviceSize{64} << 20);
+  ~GpuAllocator();
+  GpuAllocator(const GpuAllocator&) = delete;
+  GpuAllocator& operator=(const GpuAllocator&) = delete;
+
+  // preferred flags are added to required when some allowed type supports both.
+  Allocation allocate(const VkMemoryRequirements& reqs, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0);
+  void free(Allocation& a);
+  AllocatedBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0);
+  void destroyBuffer(AllocatedBuffer& b);
+  Allocation allocateImage(VkImage image, VkMemoryPropertyFlags required);
+  GpuMemoryStats stats() const;
+private:
+  struct Block {
+    VkDeviceMemory memory{VK_NULL_HANDLE};
+    std::byte* mapped{nullptr};
+    std::unique_ptr<TlsfAllocator> tlsf;
+  };
+  uint32_t chooseType(uint32_t typeBits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred) const;
+  VkDeviceMemory allocateMemory(uint32_t type, VkDeviceSize size, std::byte** mapped);
+
+  VkDevice m_device;
+  VkPhysicalDeviceMemoryProperties m_props{};
+  VkDeviceSize m_blockSize;
+  VkDeviceSize m_granularity; // bufferImageGranularity: linear and optimal resources share blocks
+  mutable std::mutex m_lock;
+  std::vector<std::vector<Block>> m_pools; // per memory type; freed blocks keep their slot
+  uint32_t m_dedicated{0};
+  uint64_t m_dedicatedBytes{0};
+  uint64_t m_dedicatedPeak{0};
+};
+
+// Transient per-frame data (uniforms, instance SSBOs, indirect commands, glyph instances)
+// sub-allocated from one mapped buffer split into one region per frame in flight.
+// beginFrame(slot) recycles the region whose fence the renderer has just waited
+// on; data is written once and bound with a dynamic offset, so nothing needs a
+// per-frame vkAllocateMemory.
+class FrameRing {
+public:
+  struct Slice { VkDeviceSize offset{0}; void* data{nullptr}; };
+  FrameRing(GpuAllocator& allocator, VkPhysicalDevice physical, VkDeviceSize bytesPerFrame, uint32_t framesInFlight);
+  ~FrameRing();
+  FrameRing(const FrameRing&) = delete;
+  FrameRing& operator=(const FrameRing&) = delete;
+  void beginFrame(size_t slot);
+  // Throws std::runtime_error when the frame's region is exhausted. align (a power
+  // of two) raises the default descriptor offset alignment, e.g. to an element size.
+  Slice allocate(VkDeviceSize size, VkDeviceSize align = 0);
+  VkBuffer buffer() const { return m_buffer.buffer; }
+  // inUse is the current frame; peak the largest frame since creation.
+  MemoryStats stats() const;
+private:
+  GpuAllocator& m_allocator;
+  AllocatedBuffer m_buffer;
+  VkDeviceSize m_regionSize;
+  VkDeviceSize m_alignment;
+  size_t m_slot{0};
+  VkDeviceSize m_head{0};
+  uint64_t m_allocations{0};
+  uint64_t m_peak{0};
+};
+
+struct MeshAllocation {
+  TlsfAllocation vertices;
+  TlsfAllocation indices;
+  uint32_t indexCount{0};
+  uint32_t firstIndex{0};  // in indices
+  int32_t vertexOffset{0}; // in vertices
+  bool valid() const { return vertices.valid(); }
+};
+
+// Shared vertex and index buffers for all meshes, so every draw can come from
+// one vkCmdBindVertexBuffers/vkCmdBindIndexBuffer pair. Ranges are TLSF
+// suballocations. By default the buffers prefer host-visible device-local
+// memory and upload() writes them directly; a deviceLocal pool is filled by
+// transfers into the ranges allocate() hands out. Freeing is immediate: the
+// caller defers it until no frame in flight (or pending copy) can still touch
+// the mesh. Not thread-safe. With indexBytes == 0 the pool holds vertices
+// only: meshes are allocated with indexCount == 0 and drawn through an index
+// buffer the caller binds (and sets indexCount/firstIndex for).
+class MeshPool {
+public:
+  MeshPool(GpuAllocator& allocator, VkDeviceSize vertexBytes, VkDeviceSize indexBytes, uint32_t vertexStride, bool deviceLocal = false);
+  ~MeshPool();
+  MeshPool(const MeshPool&) = delete;
+  MeshPool& operator=(const MeshPool&) = delete;
+  // Both return an invalid allocation when either buffer is full, or when
+  // indexCount does not match the pool's mode. upload() needs a host-visible pool.
+  MeshAllocation allocate(uint32_t vertexCount, uint32_t indexCount);
+  MeshAllocation upload(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+  void free(MeshAllocation& mesh);
+  VkBuffer vertexBuffer() const { return m_vertices.buffer; }
+  VkBuffer indexBuffer() const { return m_indices.buffer; }
+  uint32_t vertexStride() const { return m_vertexStride; }
+  MemoryStats vertexStats() const { return m_vertexRanges.stats(); }
+  MemoryStats indexStats() const { return m_indexRanges.stats(); }
+private:
+  GpuAllocator& m_allocator;
+  AllocatedBuffer m_vertices;
+  AllocatedBuffer m_indices;
+  TlsfAllocator m_vertexRanges;
+  TlsfAllocator m_indexRanges;
+  uint32_t m_vertexStride;
+};
+} // namespace vkutils
@@ -0,0 +1,185 @@
+#include "vk_upload.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace vkutils {
+UploadQueue::UploadQueue(GpuAllocator& allocator, VkPhysicalDevice physical, VkDevice device, uint32_t transferFamily, uint32_t graphicsFamily,
+                         VkDeviceSize stagingBytes, bool timestamps)
+  :m_allocator(allocator), m_device(device), m_transferFamily(transferFamily), m_graphicsFamily(graphicsFamily), m_ring(stagingBytes){
+  vkGetDeviceQueue(m_device, m_transferFamily, 0, &m_queue);
+  m_staging = m_allocator.createBuffer(stagingBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  m_stats.dedicatedQueue = dedicated();
+  try {
+    VkCommandPoolCreateInfo pi{}; pi.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pi.queueFamilyIndex = m_transferFamily; pi.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    if(vkCreateCommandPool(m_device, &pi, nullptr, &m_pool) != VK_SUCCESS) throw std::runtime_error("Failed to create upload command pool");
+    m_commandBuffers.resize(MAX_BATCHES);
+    VkCommandBufferAllocateInfo ai{}; ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    ai.commandPool = m_pool; ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY; ai.commandBufferCount = MAX_BATCHES;
+    if(vkAllocateCommandBuffers(m_device, &ai, m_commandBuffers.data()) != VK_SUCCESS) throw std::runtime_error("Failed to allocate upload command buffers");
+    for(uint32_t i=MAX_BATCHES; i>0; --i) m_freeSlots.push_back(i - 1);
+    VkSemaphoreTypeCreateInfo type{}; type.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE; type.initialValue = 0;
+    VkSemaphoreCreateInfo si{}; si.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO; si.pNext = &type;
+    if(vkCreateSemaphore(m_device, &si, nullptr, &m_semaphore) != VK_SUCCESS) throw std::runtime_error("Failed to create upload timeline semaphore");
+    uint32_t qCount=0; vkGetPhysicalDeviceQueueFamilyProperties(physical, &qCount, nullptr);
+    std::vector<VkQueueFamilyProperties> qprops(qCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical, &qCount, qprops.data());
+    const uint32_t validBits = qprops[m_transferFamily].timestampValidBits;
+    if(timestamps && validBits){
+      VkQueryPoolCreateInfo qi{}; qi.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+      qi.queryType = VK_QUERY_TYPE_TIMESTAMP; qi.queryCount = 2*MAX_BATCHES;
+      if(vkCreateQueryPool(m_device, &qi, nullptr, &m_queryPool) != VK_SUCCESS) m_queryPool = VK_NULL_HANDLE;
+      VkPhysicalDeviceProperties props{}; vkGetPhysicalDeviceProperties(physical, &props);
+      m_timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+      m_timestampPeriod = props.limits.timestampPeriod;
+      m_stats.gpuTimed = m_queryPool != VK_NULL_HANDLE;
+    }
+  } catch(...){
+    destroy();
+    throw;
+  }
+}
+
+UploadQueue::~UploadQueue(){ destroy(); }
+
+void UploadQueue::destroy(){
+  if(m_semaphore && m_submitted > m_completed){
+    VkSemaphoreWaitInfo wi{}; wi.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wi.semaphoreCount = 1; wi.pSemaphores = &m_semaphore; wi.pValues = &m_submitted;
+    vkWaitSemaphores(m_device, &wi, UINT64_MAX);
+  }
+  if(m_queryPool){ vkDestroyQueryPool(m_device, m_queryPool, nullptr); m_queryPool = VK_NULL_HANDLE; }
+  if(m_semaphore){ vkDestroySemaphore(m_device, m_semaphore, nullptr); m_semaphore = VK_NULL_HANDLE; }
+  if(m_pool){ vkDestroyCommandPool(m_device, m_pool, nullptr); m_pool = VK_NULL_HANDLE; }
+  m_allocator.destroyBuffer(m_staging);
+}
+
+uint64_t UploadQueue::write(VkBuffer dst, VkDeviceSize offset, const void* data, VkDeviceSize size){
+  if(size == 0) return m_submitted;
+  if(size > m_ring.capacity()) throw std::runtime_error("Upload larger than the staging ring");
+  uint64_t src;
+  while((src = m_ring.allocate(size, COPY_ALIGN, m_submitted + 1)) == StagingRing::NONE){
+    // Full: if only queued copies hold space they go out first, then the oldest batch is waited on.
+    BLOCCO_ZONE("upload stall");
+    ++m_stats.stalls;
+    if(m_ring.oldestBatch() > m_submitted) flush();
+    wait(m_ring.oldestBatch());
+  }
+  std::memcpy(static_cast<std::byte*>(m_staging.mapped) + src, data, size);
+  m_copies.push_back({dst, {src, offset, size}});
+  m_pendingBytes += size;
+  return m_submitted + 1;
+}
+
+uint64_t UploadQueue::flush(){
+  if(m_copies.empty()) return m_submitted;
+  BLOCCO_ZONE("upload flush");
+  if(m_freeSlots.empty()) wait(m_inFlight.front().value);
+  const uint32_t slot = m_freeSlots.back();
+  m_freeSlots.pop_back();
+  VkCommandBuffer cmd = m_commandBuffers[slot];
+  vkResetCommandBuffer(cmd, 0);
+  VkCommandBufferBeginInfo bi{}; bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO; bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if(vkBeginCommandBuffer(cmd, &bi) != VK_SUCCESS) throw std::runtime_error("Begin upload cmd buffer failed");
+  if(m_queryPool){
+    // The slot's previous batch has completed and been read, so its queries can be reset from the host.
+    vkResetQueryPool(m_device, m_queryPool, 2*slot, 2);
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, 2*slot);
+  }
+  // Copies keep their queue order within a destination; one vkCmdCopyBuffer per destination.
+  std::stable_sort(m_copies.begin(), m_copies.end(), [](const Copy& a, const Copy& b){ return a.dst < b.dst; });
+  const uint64_t value = m_submitted + 1;
+  for(size_t i=0; i<m_copies.size();){
+    const VkBuffer dst = m_copies[i].dst;
+    m_regions.clear();
+    for(; i<m_copies.size() && m_copies[i].dst == dst; ++i) m_regions.push_back(m_copies[i].region);
+    vkCmdCopyBuffer(cmd, m_staging.buffer, dst, static_cast<uint32_t>(m_regions.size()), m_regions.data());
+  }
+  if(dedicated()){
+    // Release each written range to the graphics family; the matching acquire is recorded there.
+    m_barriers.clear();
+    for(const Copy& c : m_copies){
+      VkBufferMemoryBarrier b{}; b.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+      b.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT; b.dstAccessMask = 0;
+      b.srcQueueFamilyIndex = m_transferFamily; b.dstQueueFamilyIndex = m_graphicsFamily;
+      b.buffer = c.dst; b.offset = c.region.dstOffset; b.size = c.region.size;
+      m_barriers.push_back(b);
+      m_acquires.push_back({value, b});
+    }
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                         static_cast<uint32_t>(m_barriers.size()), m_barriers.data(), 0, nullptr);
+  }
+  if(m_queryPool) vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, 2*slot + 1);
+  if(vkEndCommandBuffer(cmd) != VK_SUCCESS) throw std::runtime_error("End upload cmd buffer failed");
+  VkTimelineSemaphoreSubmitInfo timeline{}; timeline.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timeline.signalSemaphoreValueCount = 1; timeline.pSignalSemaphoreValues = &value;
+  VkSubmitInfo submit{}; submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO; submit.pNext = &timeline;
+  submit.commandBufferCount = 1; submit.pCommandBuffers = &cmd;
+  submit.signalSemaphoreCount = 1; submit.pSignalSemaphores = &m_semaphore;
+  if(vkQueueSubmit(m_queue, 1, &submit, VK_NULL_HANDLE) != VK_SUCCESS) throw std::runtime_error("Failed to submit uploads");
+  m_inFlight.push_back({value, slot, m_pendingBytes, static_cast<uint32_t>(m_copies.size()), std::chrono::steady_clock::now()});
+  m_submitted = value;
+  m_copies.clear();
+  m_pendingBytes = 0;
+  return value;
+}
+
+uint64_t UploadQueue::completed(){
+  uint64_t value = m_completed;
+  if(m_submitted > m_completed && vkGetSemaphoreCounterValue(m_device, m_semaphore, &value) != VK_SUCCESS) throw std::runtime_error("Failed to read upload timeline");
+  retire(value);
+  return m_completed;
+}
+
+void UploadQueue::recordAcquire(VkCommandBuffer cmd, uint64_t value, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess){
+  m_barriers.clear();
+  std::erase_if(m_acquires, [&](Acquire& a){
+    if(a.value > value) return false;
+    a.barrier.srcAccessMask = 0;
+    a.barrier.dstAccessMask = dstAccess;
+    m_barriers.push_back(a.barrier);
+    return true;
+  });
+  if(m_barriers.empty()) return;
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStages, 0, 0, nullptr,
+                       static_cast<uint32_t>(m_barriers.size()), m_barriers.data(), 0, nullptr);
+}
+
+UploadStats UploadQueue::stats() const {
+  UploadStats s = m_stats;
+  s.staging = m_ring.stats();
+  return s;
+}
+
+void UploadQueue::wait(uint64_t value){
+  if(value <= m_completed) return;
+  VkSemaphoreWaitInfo wi{}; wi.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  wi.semaphoreCount = 1; wi.pSemaphores = &m_semaphore; wi.pValues = &value;
+  if(vkWaitSemaphores(m_device, &wi, UINT64_MAX) != VK_SUCCESS) throw std::runtime_error("Failed to wait for uploads");
+  retire(value);
+}
+
+void UploadQueue::retire(uint64_t value){
+  const auto now = std::chrono::steady_clock::now();
+  while(!m_inFlight.empty() && m_inFlight.front().value <= value){
+    const Batch& b = m_inFlight.front();
+    double ms = std::chrono::duration<double, std::milli>(now - b.submitted).count();
+    uint64_t ts[2]{};
+    if(m_queryPool && vkGetQueryPoolResults(m_device, m_queryPool, 2*b.slot, 2, sizeof(ts), ts, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS){
+      const uint64_t ticks = ((ts[1] & m_timestampMask) - (ts[0] & m_timestampMask)) & m_timestampMask;
+      ms = static_cast<double>(ticks) * static_cast<double>(m_timestampPeriod) * 1.0e-6;
+    }
+    m_stats.bytes += b.bytes;
+    m_stats.copies += b.copies;
+    m_stats.busyMs += ms;
+    ++m_stats.batches;
+    m_freeSlots.push_back(b.slot);
+    m_inFlight.pop_front();
+  }
+  m_completed = std::max(m_completed, value);
+  m_ring.reclaim(m_completed);
+}
+} // namespace vkutils
@@ -0,0 +1,100 @@
+// Asynchronous buffer uploads: a persistently mapped staging ring feeding
+// batched copies on a transfer queue, ordered against the graphics queue with a
+// timeline semaphore.
+#pragma once
+#include <vulkan/vulkan.h>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "memory.hpp"
+#include "vk_memory.hpp"
+
+namespace vkutils {
+// busyMs is the transfer queue's time on completed batches: GPU timestamps when
+// the family supports them, else submit-to-completion as seen from the host
+// (which includes queueing, so throughput reads low).
+struct UploadStats {
+  uint64_t bytes{0};
+  uint64_t batches{0};
+  uint64_t copies{0};
+  uint64_t stalls{0}; // write() waited for staging space
+  double busyMs{0.0};
+  bool gpuTimed{false};
+  bool dedicatedQueue{false};
+  MemoryStats staging;
+  double mbPerSecond() const { return busyMs > 0.0 ? static_cast<double>(bytes) / (busyMs * 1.0e3) : 0.0; }
+};
+
+// write() copies data into the staging ring and queues a copy; flush() records
+// every queued copy into one command buffer (one vkCmdCopyBuffer per
+// destination) and submits it, signalling the next timeline value. The
+// consumer waits on that value in its own submission. With a dedicated
+// transfer family the destination ranges are released to the graphics family
+// here and acquired by recordAcquire() in a graphics command buffer; on the
+// graphics family the semaphore alone orders them. Destination buffers must be
+// VK_SHARING_MODE_EXCLUSIVE. Single-threaded, like the renderer that owns it.
+class UploadQueue {
+public:
+  // timestamps needs hostQueryReset enabled on the device.
+  UploadQueue(GpuAllocator& allocator, VkPhysicalDevice physical, VkDevice device, uint32_t transferFamily, uint32_t graphicsFamily,
+              VkDeviceSize stagingBytes, bool timestamps);
+  ~UploadQueue();
+  UploadQueue(const UploadQueue&) = delete;
+  UploadQueue& operator=(const UploadQueue&) = delete;
+  // Returns the timeline value that signals once the copy has landed. Blocks on
+  // older batches while the ring is full; throws if size exceeds the ring.
+  uint64_t write(VkBuffer dst, VkDeviceSize offset, const void* data, VkDeviceSize size);
+  // Submits the queued copies; returns the value of the last submitted batch.
+  uint64_t flush();
+  // Polls the semaphore, recycling staging space and command buffers of
+  // completed batches. Returns the completed value.
+  uint64_t completed();
+  // Records the acquire half of the ownership transfer for every batch up to
+  // value not yet acquired. The submission must wait on semaphore() >= value.
+  void recordAcquire(VkCommandBuffer cmd, uint64_t value, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess);
+  VkSemaphore semaphore() const { return m_semaphore; }
+  VkDeviceSize pendingBytes() const { return m_pendingBytes; }
+  bool dedicated() const { return m_transferFamily != m_graphicsFamily; }
+  UploadStats stats() const;
+private:
+  static constexpr uint32_t MAX_BATCHES = 8;
+  static constexpr VkDeviceSize COPY_ALIGN = 16;
+  struct Copy { VkBuffer dst; VkBufferCopy region; };
+  struct Batch {
+    uint64_t value;
+    uint32_t slot; // command buffer and timestamp pair
+    uint64_t bytes;
+    uint32_t copies;
+    std::chrono::steady_clock::time_point submitted;
+  };
+  struct Acquire { uint64_t value; VkBufferMemoryBarrier barrier; };
+  void destroy();
+  void wait(uint64_t value);
+  void retire(uint64_t value);
+
+  GpuAllocator& m_allocator;
+  VkDevice m_device;
+  VkQueue m_queue{VK_NULL_HANDLE};
+  uint32_t m_transferFamily;
+  uint32_t m_graphicsFamily;
+  AllocatedBuffer m_staging;
+  StagingRing m_ring;
+  VkCommandPool m_pool{VK_NULL_HANDLE};
+  std::vector<VkCommandBuffer> m_commandBuffers; // one per slot
+  std::vector<uint32_t> m_freeSlots;
+  VkQueryPool m_queryPool{VK_NULL_HANDLE};       // two timestamps per slot, when supported
+  float m_timestampPeriod{1.f};
+  uint64_t m_timestampMask{~0ull};
+  VkSemaphore m_semaphore{VK_NULL_HANDLE};
+  uint64_t m_submitted{0};
+  uint64_t m_completed{0};
+  std::vector<Copy> m_copies; // queued for the next flush
+  VkDeviceSize m_pendingBytes{0};
+  std::vector<VkBufferCopy> m_regions;
+  std::vector<VkBufferMemoryBarrier> m_barriers;
+  std::deque<Batch> m_inFlight;
+  std::vector<Acquire> m_acquires;
+  UploadStats m_stats;
+};
+} // namespace vkutils
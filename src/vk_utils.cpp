@@ -1,7 +1,8 @@
 #include "vk_utils.hpp"
+#include "logging.hpp"
 #include <stdexcept>
 #include <cstring>
-#include <iostream>
+#include <fstream>
 
 namespace vkutils {
 
@@ -10,8 +11,20 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
     VkDebugUtilsMessageTypeFlagsEXT types,
     const VkDebugUtilsMessengerCallbackDataEXT* callbackData,
     void* userData) {
-  (void)severity; (void)types; (void)userData; // silence unused warnings
-  std::cerr << "[vk] " << callbackData->pMessage << "\n";
+  (void)types; (void)userData; // silence unused warnings
+  // Validation tends to repeat one message every frame: past a small burst per
+  // second, repeats of a message id are only counted.
+  static Log::RateLimiter limiter;
+  uint64_t key = static_cast<uint32_t>(callbackData->messageIdNumber);
+  for(const char* c = callbackData->pMessageIdName; c && *c; ++c) key = (key ^ static_cast<unsigned char>(*c)) * 0x100000001b3ull;
+  const std::optional<uint64_t> suppressed = limiter.admit(key);
+  if(!suppressed) return VK_FALSE;
+  const Log::Level level = (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) ? Log::Level::Error
+                         : (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) ? Log::Level::Warn
+                         : (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) ? Log::Level::Info : Log::Level::Debug;
+  const char* message = callbackData->pMessage ? callbackData->pMessage : "";
+  if(*suppressed) Log::log(level, "[vk] {} ({} repeats suppressed)", message, *suppressed);
+  else Log::log(level, "[vk] {}", message);
   return VK_FALSE;
 }
 
@@ -32,7 +45,7 @@ bool checkValidationLayerSupport() {
 
 VkInstance createInstance(const InstanceConfig& cfg) {
   if (cfg.enableValidation && !checkValidationLayerSupport()) {
-    std::cerr << "Validation layers requested but not available; continuing without." << std::endl;
+    Log::warn("Validation layers requested but not available; continuing without.");
   }
   VkApplicationInfo app{};
   app.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -74,7 +87,7 @@ VkDebugUtilsMessengerEXT createDebugMessenger(VkInstance instance) {
   ci.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
   ci.pfnUserCallback = debugCallback;
   if (createFn(instance, &ci, nullptr, &messenger) != VK_SUCCESS) {
-    std::cerr << "Failed to create debug messenger" << std::endl;
+    Log::warn("Failed to create debug messenger");
     return VK_NULL_HANDLE;
   }
   return messenger;
@@ -86,4 +99,22 @@ void destroyDebugMessenger(VkInstance instance, VkDebugUtilsMessengerEXT messeng
   if (destroyFn) destroyFn(instance, messenger, nullptr);
 }
 
+VkShaderModule createShaderModule(VkDevice device, const std::string& path) {
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  if (!in) throw std::runtime_error("Failed to open shader " + path);
+  const auto bytes = static_cast<size_t>(in.tellg());
+  if (bytes == 0 || bytes % 4 != 0) throw std::runtime_error("Invalid SPIR-V in " + path);
+  std::vector<uint32_t> code(bytes / 4);
+  in.seekg(0);
+  in.read(reinterpret_cast<char*>(code.data()), static_cast<std::streamsize>(bytes));
+  VkShaderModuleCreateInfo ci{};
+  ci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  ci.codeSize = bytes;
+  ci.pCode = code.data();
+  VkShaderModule module = VK_NULL_HANDLE;
+  if (vkCreateShaderModule(device, &ci, nullptr, &module) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create shader module from " + path);
+  }
+  return module;
+}
 } // namespace vkutils
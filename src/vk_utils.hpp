@@ -24,6 +24,9 @@ VkInstance createInstance(const InstanceConfig& cfg);
 VkDebugUtilsMessengerEXT createDebugMessenger(VkInstance instance);
 void destroyDebugMessenger(VkInstance instance, VkDebugUtilsMessengerEXT messenger);
 
+// Loads a SPIR-V binary; throws if the file is missing or malformed.
+VkShaderModule createShaderModule(VkDevice device, const std::string& path);
+
 // Required device extensions (currently just swapchain)
 inline const std::vector<const char*>& deviceExtensions() {
   static const std::vector<const char*> exts = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
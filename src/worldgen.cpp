@@ -0,0 +1,145 @@
+#include "worldgen.hpp"
+#include "noise.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+namespace {
+constexpr int N = Chunk::SIZE, AREA = WorldColumn::AREA;
+
+uint32_t subSeed(uint32_t seed, uint32_t salt){ return seed*0x9e3779b9u ^ salt; }
+
+// 0 below lo, 1 above hi, smooth in between.
+float smooth(float v, float lo, float hi){
+  const float t = std::clamp((v - lo) / (hi - lo), 0.f, 1.f);
+  return t*t*(3.f - 2.f*t);
+}
+} // namespace
+
+void generateWorldColumn(const WorldParams& p, int cx, int cz, WorldColumn& out){
+  float xs[AREA], zs[AREA], detail[AREA], warmth[AREA], rugged[AREA];
+  for(int z=0;z<N;++z) for(int x=0;x<N;++x){
+    xs[z*N + x] = static_cast<float>(cx*N + x);
+    zs[z*N + x] = static_cast<float>(cz*N + z);
+  }
+  fractalNoise2({p.seed, 1.f/128.f, 5}, xs, zs, detail, AREA);
+  fractalNoise2({subSeed(p.seed, 0x68e31da4u), 1.f/512.f, 2}, xs, zs, warmth, AREA);
+  fractalNoise2({subSeed(p.seed, 0xb5297a4du), 1.f/384.f, 2}, xs, zs, rugged, AREA);
+  out.minHeight = INT16_MAX; out.maxHeight = INT16_MIN;
+  for(int i=0;i<AREA;++i){
+    // Biome weights sum to one; heights blend across their borders while the
+    // surface takes the strongest biome's layers.
+    const float d = detail[i];
+    const float mountains = smooth(rugged[i], 0.56f, 0.66f);
+    const float desert = (1.f - mountains) * smooth(warmth[i], 0.54f, 0.62f);
+    const float plains = 1.f - mountains - desert;
+    const float h = plains*(34.f + 26.f*d) + desert*(36.f + 14.f*d) + mountains*(40.f + 150.f*d*d);
+    const int height = static_cast<int>(h);
+    out.height[i] = static_cast<int16_t>(height);
+    out.minHeight = std::min(out.minHeight, height);
+    out.maxHeight = std::max(out.maxHeight, height);
+    if(mountains >= plains && mountains >= desert){
+      out.top[i] = height > p.snowLine ? BLOCK_SNOW : BLOCK_STONE;
+      out.filler[i] = BLOCK_STONE; out.depth[i] = 0;
+    } else if(desert >= plains || height <= p.seaLevel + 2){
+      out.top[i] = BLOCK_SAND; out.filler[i] = BLOCK_SAND; out.depth[i] = 4;
+    } else {
+      out.top[i] = BLOCK_GRASS; out.filler[i] = BLOCK_DIRT; out.depth[i] = 3;
+    }
+  }
+}
+
+void generateWorld(const WorldParams& p, const WorldColumn& column, int cx, int cy, int cz, Chunk& out){
+  const int y0 = cy*N;
+  if(column.maxHeight <= y0){ out.fill(BLOCK_AIR); return; }
+  thread_local std::vector<BlockId> blocks(Chunk::VOLUME);
+  for(int y=0;y<N;++y){
+    const int wy = y0 + y;
+    BlockId* plane = &blocks[static_cast<size_t>(Chunk::index(0, y, 0))];
+    for(int i=0;i<AREA;++i){
+      const int h = column.height[i];
+      plane[i] = wy >= h ? BLOCK_AIR : wy == h - 1 ? column.top[i] : wy >= h - 1 - column.depth[i] ? column.filler[i] : BLOCK_STONE;
+    }
+  }
+  // Caves: per plane, the first noise over its solid blocks as one batch, then
+  // the second over those inside the first band. Vertical coordinates are
+  // stretched so tunnels run flatter than they climb.
+  if(p.caveWidth > 0.f){
+    float xs[AREA], ys[AREA], zs[AREA], a[AREA], b[AREA];
+    int index[AREA];
+    const Fractal first{subSeed(p.seed, 0x1b56c4e9u), 1.f/48.f, 2}, second{subSeed(p.seed, 0x7feb352du), 1.f/48.f, 2};
+    const int top = std::min(N, column.maxHeight - y0);
+    for(int y=0;y<top;++y){
+      BlockId* plane = &blocks[static_cast<size_t>(Chunk::index(0, y, 0))];
+      size_t n = 0;
+      for(int i=0;i<AREA;++i){
+        if(plane[i] == BLOCK_AIR) continue;
+        index[n] = i;
+        xs[n] = static_cast<float>(cx*N + (i & (N - 1)));
+        zs[n] = static_cast<float>(cz*N + i / N);
+        ++n;
+      }
+      std::fill_n(ys, n, static_cast<float>(y0 + y) * 2.f);
+      fractalNoise3(first, xs, ys, zs, a, n);
+      size_t m = 0;
+      for(size_t j=0;j<n;++j){
+        if(std::fabs(a[j] - 0.5f) >= p.caveWidth) continue;
+        index[m] = index[j]; xs[m] = xs[j]; zs[m] = zs[j];
+        ++m;
+      }
+      fractalNoise3(second, xs, ys, zs, b, m);
+      for(size_t j=0;j<m;++j){
+        if(std::fabs(b[j] - 0.5f) < p.caveWidth) plane[index[j]] = BLOCK_AIR;
+      }
+    }
+  }
+  if(std::all_of(blocks.begin(), blocks.end(), [&](BlockId v){ return v == blocks[0]; })){ out.fill(blocks[0]); return; }
+  out.fill(BLOCK_AIR);
+  for(int row=0;row<N*N;++row){
+    const int start = row*N;
+    for(int x=0;x<N;){
+      const BlockId v = blocks[static_cast<size_t>(start + x)];
+      int run = 1;
+      while(x + run < N && blocks[static_cast<size_t>(start + x + run)] == v) ++run;
+      if(v != BLOCK_AIR) out.setRun(start + x, run, v);
+      x += run;
+    }
+  }
+}
+
+void generateWorld(const WorldParams& p, const ChunkCoord& c, Chunk& out){
+  thread_local WorldColumn column;
+  generateWorldColumn(p, c.x, c.z, column);
+  generateWorld(p, column, c.x, c.y, c.z, out);
+}
+
+WorldStats generateWorldRegion(JobSystem& jobs, Scene& scene, const WorldParams& p, const ChunkCoord& min, const ChunkCoord& max){
+  BLOCCO_ZONE("generate world region");
+  const auto t0 = std::chrono::steady_clock::now();
+  WorldStats stats;
+  const int sx = max.x - min.x + 1, sy = max.y - min.y + 1, sz = max.z - min.z + 1;
+  if(sx <= 0 || sy <= 0 || sz <= 0) return stats;
+  // Jobs write their own slots; the scene is filled afterwards on this thread.
+  std::vector<Chunk> chunks(static_cast<size_t>(sx*sy*sz));
+  auto slot = [&](int x, int y, int z){ return static_cast<size_t>((y*sz + z)*sx + x); };
+  jobs.parallelFor(0, static_cast<size_t>(sx*sz), 1, [&](size_t begin, size_t end){
+    thread_local WorldColumn column;
+    for(size_t i=begin;i<end;++i){
+      BLOCCO_ZONE("generate world column");
+      const int x = static_cast<int>(i) % sx, z = static_cast<int>(i) / sx;
+      generateWorldColumn(p, min.x + x, min.z + z, column);
+      for(int y=0;y<sy;++y) generateWorld(p, column, min.x + x, min.y + y, min.z + z, chunks[slot(x, y, z)]);
+    }
+  });
+  for(int y=0;y<sy;++y) for(int z=0;z<sz;++z) for(int x=0;x<sx;++x){
+    Chunk& c = chunks[slot(x, y, z)];
+    ++stats.chunks;
+    if(c.empty()) continue;
+    scene.chunkAt({min.x + x, min.y + y, min.z + z}) = std::move(c);
+    ++stats.stored;
+  }
+  stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+  return stats;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "jobs.hpp"
+#include "scene.hpp"
+#include "terrain.hpp"
+#include <cstdint>
+
+// Seeded world terrain. A height field of five octaves of value noise is
+// blended between three biomes (plains, desert, mountains) by two
+// low-frequency climate noises; each column gets its biome's surface layers
+// and caves are carved where two 3D noises both lie near their midpoint.
+// Noise runs in batches (noise.hpp): over a chunk column's 32x32 plane for the
+// surface, then over each horizontal plane of a chunk for the caves. Like
+// generateTerrain() it is a pure function of the parameters and the chunk,
+// and its output is bit-identical on every ISA path.
+struct WorldParams {
+  uint32_t seed{1};
+  int seaLevel{40};         // plains up to two blocks above it are beaches
+  int snowLine{120};        // mountain surfaces above it are snow
+  float caveWidth{0.04f};   // half-width of the noise bands carved where they cross; 0 = no caves
+};
+
+// The surface of one chunk column (32x32 block columns), shared by every chunk
+// stacked in it.
+struct WorldColumn {
+  static constexpr int AREA = Chunk::SIZE * Chunk::SIZE; // x fastest, then z
+  int16_t height[AREA];     // the first air block above the surface
+  BlockId top[AREA];
+  BlockId filler[AREA];     // under the top block, over stone
+  uint8_t depth[AREA];      // filler blocks
+  int minHeight, maxHeight;
+};
+
+void generateWorldColumn(const WorldParams& p, int cx, int cz, WorldColumn& out);
+// Overwrites out with chunk (column's x, cy, column's z).
+void generateWorld(const WorldParams& p, const WorldColumn& column, int cx, int cy, int cz, Chunk& out);
+// Both steps for one chunk: what ChunkStreamer's generator takes.
+void generateWorld(const WorldParams& p, const ChunkCoord& c, Chunk& out);
+
+struct WorldStats {
+  uint32_t chunks{0};  // generated
+  uint32_t stored{0};  // not all air
+  double ms{0.0};
+};
+// Fills the chunks from min to max (inclusive) into the scene, one job per
+// chunk column so its surface is computed once; all-air chunks are not stored.
+// The result does not depend on the number of threads.
+WorldStats generateWorldRegion(JobSystem& jobs, Scene& scene, const WorldParams& p, const ChunkCoord& min, const ChunkCoord& max);
@@ -0,0 +1,71 @@
+#include "broadphase.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Broadphase cost at 1k/10k/100k bodies: build, incremental moves, pair
+// enumeration and range/ray queries; brute force shown where it is tractable.
+namespace {
+double msSince(std::chrono::steady_clock::time_point t0){
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-t0).count();
+}
+}
+
+int main(){
+  for(size_t count : {size_t{1000}, size_t{10000}, size_t{100000}}){
+    // Keep density constant: world extent grows with the cube root of the count.
+    const float extent = 10.f*std::cbrt(static_cast<float>(count));
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> pos(0.f, extent), ext(0.5f, 2.f), jitter(-0.05f, 0.05f);
+    std::vector<AABB> boxes(count);
+    for(auto& b : boxes){ const Vec3 p{pos(rng),pos(rng),pos(rng)}; b = {p, p + Vec3{ext(rng),ext(rng),ext(rng)}}; }
+
+    AabbTree tree(0.1f);
+    std::vector<int32_t> proxies(count);
+    auto t0 = std::chrono::steady_clock::now();
+    for(size_t i=0;i<count;++i) proxies[i] = tree.insert(boxes[i], static_cast<uint32_t>(i));
+    const double buildMs = msSince(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    size_t reinserts = 0;
+    for(size_t i=0;i<count;++i){
+      const Vec3 d{jitter(rng), jitter(rng), jitter(rng)};
+      boxes[i] = {boxes[i].min + d, boxes[i].max + d};
+      reinserts += tree.move(proxies[i], boxes[i]);
+    }
+    const double moveMs = msSince(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    tree.rebuild();
+    const double rebuildMs = msSince(t0);
+
+    std::vector<BroadphasePair> pairs(count*8);
+    t0 = std::chrono::steady_clock::now();
+    const size_t np = tree.queryPairs(pairs);
+    const double pairMs = msSince(t0);
+
+    std::vector<uint32_t> hits(count);
+    size_t rangeHits = 0;
+    t0 = std::chrono::steady_clock::now();
+    for(int q=0;q<1000;++q){ const Vec3 p{pos(rng),pos(rng),pos(rng)}; rangeHits += tree.query({p, p + Vec3{8,8,8}}, hits); }
+    const double rangeMs = msSince(t0);
+
+    std::vector<RayHit> rayHits(count);
+    size_t rays = 0;
+    t0 = std::chrono::steady_clock::now();
+    for(int q=0;q<1000;++q) rays += tree.raycast({{0,pos(rng),pos(rng)}, normalize(Vec3{1,jitter(rng),jitter(rng)})}, extent, rayHits);
+    const double rayMs = msSince(t0);
+
+    std::printf("%6zu bodies: build %.2f ms, move %.2f ms (%zu reinserts), rebuild %.2f ms, pairs %.2f ms (%zu), 1k ranges %.2f ms (%zu), 1k rays %.2f ms (%zu), height %d\n",
+                count, buildMs, moveMs, reinserts, rebuildMs, pairMs, np, rangeMs, rangeHits, rayMs, rays, tree.height());
+    if(count <= 10000){
+      t0 = std::chrono::steady_clock::now();
+      size_t brute = 0;
+      for(size_t i=0;i<count;++i) for(size_t j=i+1;j<count;++j) brute += intersect(boxes[i], boxes[j]);
+      std::printf("        brute-force pairs %.2f ms (%zu)\n", msSince(t0), brute);
+    }
+  }
+  return 0;
+}
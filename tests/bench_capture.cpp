@@ -0,0 +1,70 @@
+#include "capture.hpp"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+double msSince(Clock::time_point t0){ return std::chrono::duration<double, std::milli>(Clock::now()-t0).count(); }
+
+// Rendered-looking 1080p frame: sky gradient over blocky, lightly noisy terrain.
+Capture::Image makeFrame(){
+  constexpr uint32_t W = 1920, H = 1080;
+  Capture::Image img{W, H, std::vector<uint8_t>(size_t{W}*H*4)};
+  std::mt19937 rng(42);
+  for(uint32_t y=0;y<H;++y){
+    for(uint32_t x=0;x<W;++x){
+      uint8_t* p = &img.rgba[(size_t{y}*W+x)*4];
+      const uint32_t ground = 600 + ((x/48)*37 % 160);
+      if(y < ground){ p[0] = static_cast<uint8_t>(90 + y/12); p[1] = static_cast<uint8_t>(140 + y/16); p[2] = 230; }
+      else {
+        const auto shade = static_cast<uint8_t>(((x/24 + y/24) & 1) * 12 + (rng() & 7));
+        p[0] = static_cast<uint8_t>(70 + shade); p[1] = static_cast<uint8_t>(120 + shade); p[2] = static_cast<uint8_t>(50 + shade);
+      }
+      p[3] = 255;
+    }
+  }
+  return img;
+}
+}
+
+int main(){
+  const Capture::Image frame = makeFrame();
+  const double rawMb = static_cast<double>(frame.rgba.size()) / 1.0e6;
+  constexpr int REPS = 8;
+
+  auto bench = [&](const char* name, auto&& fn){
+    size_t bytes = 0;
+    const auto t0 = Clock::now();
+    for(int i=0;i<REPS;++i) bytes = fn();
+    const double ms = msSince(t0) / REPS;
+    std::printf("%-10s %8.2f ms/frame  %7.1f MB/s  %9zu bytes (%.1fx)\n", name, ms, rawMb / (ms/1000.0), bytes,
+                static_cast<double>(frame.rgba.size()) / static_cast<double>(bytes));
+  };
+  bench("png", [&]{ return Capture::encodePNG(frame.view()).size(); });
+  bench("qoi", [&]{ return Capture::encodeQOI(frame.view()).size(); });
+  bench("thumb/4", [&]{ return Capture::downsample(frame.view(), 4).rgba.size(); });
+
+  // Main-thread cost of handing a frame to the recorder; encoding happens on workers.
+  const auto dir = std::filesystem::temp_directory_path() / "blocco_bench_capture";
+  std::filesystem::create_directories(dir);
+  JobSystem jobs;
+  for(auto format : {Capture::Format::PNG, Capture::Format::QOI}){
+    Capture::Recorder rec(jobs, {dir.string(), format, 4});
+    double submitMs = 0.0;
+    const auto t0 = Clock::now();
+    for(uint32_t f=0;f<REPS;++f){
+      const auto s0 = Clock::now();
+      rec.submit(f, frame.view(), {});
+      submitMs += msSince(s0);
+    }
+    rec.flush();
+    const double wall = msSince(t0);
+    std::printf("recorder %s: submit %.4f ms/frame on the main thread, %.1f frames/s end to end (%u threads)\n",
+                format == Capture::Format::QOI ? "qoi" : "png", submitMs / REPS, REPS / (wall/1000.0), jobs.threadCount());
+  }
+  std::filesystem::remove_all(dir);
+  return 0;
+}
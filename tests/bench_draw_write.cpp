@@ -0,0 +1,51 @@
+#include "draw_list.hpp"
+#include "jobs.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Scaling of the per-frame draw work the renderer spreads over the job system:
+// after the sort, chunks of commands, transforms and culling bounds are written
+// by whichever worker picks them up (as Renderer::recordDrawsParallel does
+// before recording each chunk's secondary command buffer). Chunking matches the
+// renderer: at least 1024 draws, about four chunks per worker. The recording
+// itself needs a device and is not timed here: blocco_bench --scenario
+// record-scaling times it.
+int main(){
+  using Clock = std::chrono::steady_clock;
+  constexpr int REPS = 100;
+  constexpr uint32_t DRAWS = 100000;
+  std::mt19937 rng(4);
+  DrawList list;
+  list.reserve(DRAWS);
+  for(uint32_t i=0;i<DRAWS;++i){
+    const Vec3 origin{static_cast<float>(i % 64) * 32.f, static_cast<float>((i / 64) % 8) * 32.f, static_cast<float>(i / 512) * 32.f};
+    list.add(static_cast<uint32_t>(rng() % 2), static_cast<uint32_t>(rng() % 8), {36, i * 36, 0}, translate(origin),
+             static_cast<float>(rng() % 4000), origin, origin + Vec3{32.f, 32.f, 32.f});
+  }
+  list.sort();
+  std::vector<DrawIndexedIndirect> cmds(DRAWS);
+  std::vector<Mat4> xforms(DRAWS);
+  std::vector<DrawBounds> bounds(DRAWS);
+  std::vector<DrawChunk> chunks;
+  const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  double single = 0.0;
+  for(unsigned threads = 1; threads <= cores; threads = threads < cores ? std::min(threads * 2, cores) : threads + 1){
+    JobSystem jobs(threads);
+    const uint32_t chunkDraws = std::max(1024u, (DRAWS + 4*threads - 1) / (4*threads));
+    list.split(chunkDraws, chunks);
+    const auto t0 = Clock::now();
+    for(int rep=0;rep<REPS;++rep){
+      jobs.parallelFor(0, chunks.size(), 1, [&](size_t b, size_t e){
+        for(size_t i=b;i<e;++i) list.write(chunks[i].first, chunks[i].count, cmds, xforms, bounds);
+      });
+    }
+    const double ms = std::chrono::duration<double, std::milli>(Clock::now()-t0).count() / REPS;
+    if(threads == 1) single = ms;
+    std::printf("%2u threads: %6u draws in %zu chunks, %.3f ms/frame, %.2fx\n", threads, DRAWS, chunks.size(), ms, single / ms);
+  }
+  return 0;
+}
@@ -0,0 +1,39 @@
+#include "jobs.hpp"
+#include "mesher.hpp"
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Scaling benchmark: a fixed, deterministic meshing workload on 1..N threads.
+int main(){
+  constexpr int CHUNKS = 8; // CHUNKS x 1 x CHUNKS
+  Scene s;
+  for(int x=0;x<CHUNKS*Chunk::SIZE;++x) for(int z=0;z<CHUNKS*Chunk::SIZE;++z){
+    const int h = 6 + ((x*7 + z*13) % 11) + ((x/5 + z/3) % 9);
+    s.fill({x,0,z},{x+1,h,z+1}, static_cast<BlockId>(1 + (h&3)));
+  }
+  const unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  double base = 0.0;
+  for(unsigned threads=1; threads<=maxThreads; threads = threads<4 ? threads+1 : threads*2){
+    JobSystem js(threads);
+    std::vector<ChunkMesher> meshers(threads);
+    std::vector<MeshBuffers> buffers(threads);
+    std::vector<size_t> quads(threads, 0);
+    const auto t0 = std::chrono::steady_clock::now();
+    for(int rep=0;rep<4;++rep){
+      js.parallelFor(0, CHUNKS*CHUNKS, 1, [&](size_t b, size_t e){
+        const auto w = static_cast<size_t>(js.currentWorker());
+        for(size_t i=b;i<e;++i){
+          const ChunkCoord c{static_cast<int32_t>(i % CHUNKS), 0, static_cast<int32_t>(i / CHUNKS)};
+          quads[w] += meshers[w].mesh(s, c, buffers[w]).quads;
+        }
+      });
+    }
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-t0).count();
+    if(threads == 1) base = ms;
+    size_t total = 0; for(size_t q : quads) total += q;
+    std::printf("threads=%2u  %8.2f ms  speedup %.2fx  (%zu quads)\n", threads, ms, base/ms, total);
+  }
+  return 0;
+}
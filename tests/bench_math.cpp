@@ -0,0 +1,54 @@
+#include "math.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Throughput of the dispatched (SIMD when compiled in) math vs the scalar reference.
+namespace {
+template<class F>
+double nsPerItem(size_t items, int reps, F&& f){
+  const auto t0 = std::chrono::steady_clock::now();
+  for(int r=0;r<reps;++r) f();
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now()-t0).count() / (static_cast<double>(items)*reps);
+}
+}
+
+int main(){
+#if defined(BLOCCO_MATH_AVX2)
+  std::printf("math path: AVX2\n");
+#elif defined(BLOCCO_MATH_SSE)
+  std::printf("math path: SSE2\n");
+#else
+  std::printf("math path: scalar\n");
+#endif
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> val(-50.f, 50.f);
+  const size_t N = 1 << 16;
+  std::vector<float> x(N), y(N), z(N), ox(N), oy(N), oz(N), maxX(N), maxY(N), maxZ(N);
+  for(size_t i=0;i<N;++i){ x[i]=val(rng); y[i]=val(rng); z[i]=val(rng); maxX[i]=x[i]+1.f; maxY[i]=y[i]+1.f; maxZ[i]=z[i]+1.f; }
+  const Mat4 vp = perspective(1.2f, 1.5f, 0.1f, 200.f) * lookAt({0,10,0}, {20,0,20}, {0,1,0});
+  const Frustum f = extractFrustum(vp);
+  std::vector<uint8_t> vis(N);
+  size_t sink = 0;
+
+  std::printf("transformPoints: %.3f ns/point (scalar %.3f)\n",
+    nsPerItem(N, 200, [&]{ transformPoints(vp, x.data(), y.data(), z.data(), ox.data(), oy.data(), oz.data(), N); }),
+    nsPerItem(N, 200, [&]{ math_scalar::transformPoints(vp, x.data(), y.data(), z.data(), ox.data(), oy.data(), oz.data(), N); }));
+  std::printf("cullAabbs:       %.3f ns/box (scalar %.3f)\n",
+    nsPerItem(N, 200, [&]{ sink += cullAabbs(f, x.data(), y.data(), z.data(), maxX.data(), maxY.data(), maxZ.data(), vis.data(), N); }),
+    nsPerItem(N, 200, [&]{ sink += math_scalar::cullAabbs(f, x.data(), y.data(), z.data(), maxX.data(), maxY.data(), maxZ.data(), vis.data(), N); }));
+
+  std::vector<Mat4> mats(1024);
+  for(auto& m : mats){ for(float& v : m.m) v = val(rng); for(int k=0;k<4;++k) m.m[k*5] += 100.f; }
+  std::vector<Mat4> out(mats.size());
+  const size_t M = mats.size();
+  std::printf("Mat4 multiply:   %.3f ns (scalar %.3f)\n",
+    nsPerItem(M, 1000, [&]{ for(size_t i=0;i<M;++i) out[i] = mats[i] * mats[(i+1)%M]; }),
+    nsPerItem(M, 1000, [&]{ for(size_t i=0;i<M;++i) out[i] = math_scalar::mul(mats[i], mats[(i+1)%M]); }));
+  std::printf("Mat4 inverse:    %.3f ns (scalar %.3f)\n",
+    nsPerItem(M, 1000, [&]{ for(size_t i=0;i<M;++i) out[i] = inverse(mats[i]); }),
+    nsPerItem(M, 1000, [&]{ for(size_t i=0;i<M;++i) out[i] = math_scalar::inverse(mats[i]); }));
+  std::printf("(checksum %zu %f)\n", sink, static_cast<double>(out[7].m[3]));
+  return 0;
+}
@@ -0,0 +1,68 @@
+#include "mesher.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// Greedy vs per-cube meshing throughput on terrain-like chunks, mesh bytes
+// per chunk for the float and packed vertex layouts, and the cost of remeshing
+// a chunk after a single block edit against meshing it from scratch.
+int main(){
+  constexpr int CHUNKS = 4; // CHUNKS x 1 x CHUNKS columns
+  Scene s;
+  std::mt19937 rng(7);
+  for(int x=0;x<CHUNKS*Chunk::SIZE;++x) for(int z=0;z<CHUNKS*Chunk::SIZE;++z){
+    const int h = 8 + static_cast<int>(rng()%4) + (x/16 + z/16)%8;
+    s.fill({x,0,z},{x+1,h,z+1}, static_cast<BlockId>(h < 12 ? 1 : 2));
+  }
+  ChunkMesher mesher;
+  MeshBuffers buf, packed;
+  packed.format = VertexFormat::Packed;
+  buf.reserve(32*1024);
+  packed.reserve(32*1024);
+  MesherStats greedy, naive, pack;
+  size_t floatBytes = 0, packedBytes = 0;
+  for(int rep=0;rep<10;++rep)
+  for(int cx=0;cx<CHUNKS;++cx) for(int cz=0;cz<CHUNKS;++cz){
+    const MesherStats g = mesher.mesh(s, {cx,0,cz}, buf);
+    greedy.quads += g.quads; greedy.ms += g.ms;
+    floatBytes += buf.bytes();
+    const MesherStats p = mesher.mesh(s, {cx,0,cz}, packed);
+    pack.quads += p.quads; pack.ms += p.ms;
+    packedBytes += packed.bytes();
+    const MesherStats n = mesher.meshNaive(s, {cx,0,cz}, buf);
+    naive.quads += n.quads; naive.ms += n.ms;
+  }
+  std::printf("greedy: %zu quads, %.3f ms, %.0f quads/ms\n", greedy.quads, greedy.ms, greedy.quadsPerMs());
+  std::printf("naive:  %zu quads, %.3f ms, %.0f quads/ms\n", naive.quads, naive.ms, naive.quadsPerMs());
+  std::printf("packed: %zu quads, %.3f ms, %.0f quads/ms\n", pack.quads, pack.ms, pack.quadsPerMs());
+  std::printf("triangle reduction: %.1fx\n", static_cast<double>(naive.quads)/static_cast<double>(greedy.quads));
+  const double chunks = 10.0*CHUNKS*CHUNKS;
+  std::printf("mesh bytes per chunk: float %.1f KB, packed %.1f KB (%.2fx smaller)\n",
+              static_cast<double>(floatBytes)/chunks/1024.0, static_cast<double>(packedBytes)/chunks/1024.0,
+              static_cast<double>(floatBytes)/static_cast<double>(packedBytes));
+
+  using Clock = std::chrono::steady_clock;
+  constexpr int EDITS = 500;
+  const ChunkCoord c{1, 0, 1};
+  SlicedMesh sliced;
+  sliced.format = VertexFormat::Packed;
+  mesher.remesh(ChunkNeighbourhood::of(s, c), DirtySlices::all(), sliced);
+  double fullMs = 0.0, remeshMs = 0.0;
+  for(int i=0;i<EDITS;++i){
+    const int x = static_cast<int>(rng()%Chunk::SIZE), y = 6 + static_cast<int>(rng()%10), z = static_cast<int>(rng()%Chunk::SIZE);
+    const int wx = c.x*Chunk::SIZE + x, wz = c.z*Chunk::SIZE + z;
+    s.setBlock(wx, y, wz, s.getBlock(wx, y, wz) == BLOCK_AIR ? BlockId{1} : BLOCK_AIR);
+    DirtySlices dirty;
+    dirty.touch(x, y, z);
+    auto t0 = Clock::now();
+    mesher.remesh(ChunkNeighbourhood::of(s, c), dirty, sliced);
+    sliced.flatten(packed);
+    remeshMs += std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    t0 = Clock::now();
+    mesher.mesh(s, c, packed);
+    fullMs += std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+  }
+  std::printf("single-block edit: remesh %.3f ms, full mesh %.3f ms per edit (%.1fx)\n",
+              remeshMs/EDITS, fullMs/EDITS, fullMs/remeshMs);
+  return 0;
+}
@@ -0,0 +1,48 @@
+#include "profiler.hpp"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+// Cost of one BLOCCO_ZONE: an empty scope timed 10M times while recording
+// (drained every 16k zones, as a frame's collect() would), while stopped, and
+// against the bare loop. The budget is 50 ns per recorded zone; the cost of
+// one timestamp read is printed too, since a zone takes two and virtual
+// machines that trap rdtsc make those dominate.
+namespace {
+volatile int sink = 0;
+
+template<class F>
+double nsPer(int n, F&& body){
+  const auto t0 = std::chrono::steady_clock::now();
+  for(int i=0;i<n;++i) body(i);
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / n;
+}
+}
+
+int main(){
+  constexpr int N = 10'000'000;
+  const double bare = nsPer(N, [](int i){ sink = i; });
+#if defined(BLOCCO_PROFILER)
+  const double stamp = nsPer(N, [](int){ sink = static_cast<int>(Profiler::now()); }) - bare;
+  Profiler::start();
+  const double recording = nsPer(N, [](int i){
+    { BLOCCO_ZONE("bench"); sink = i; }
+    if((i & 16383) == 16383) Profiler::collect();
+  });
+  const Profiler::Stats s = Profiler::stats();
+  const auto trace = std::filesystem::temp_directory_path() / "blocco_bench_trace.json";
+  const auto t0 = std::chrono::steady_clock::now();
+  Profiler::writeChromeTrace(trace.string());
+  const double exportS = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  std::filesystem::remove(trace);
+  Profiler::stop();
+  Profiler::reset();
+  const double stopped = nsPer(N, [](int i){ BLOCCO_ZONE("bench"); sink = i; });
+  std::printf("zone: %.1f ns recording (%.1f ns over the bare loop, of which 2 x %.1f ns timestamps), %.1f ns stopped; %llu zones kept, %llu dropped, export %.2f s\n",
+              recording, recording - bare, stamp, stopped - bare, static_cast<unsigned long long>(s.zones), static_cast<unsigned long long>(s.dropped), exportS);
+#else
+  const double out = nsPer(N, [](int i){ BLOCCO_ZONE("bench"); sink = i; });
+  std::printf("profiler compiled out: %.2f ns per zone over the bare loop\n", out - bare);
+#endif
+  return 0;
+}
@@ -0,0 +1,74 @@
+#include "jobs.hpp"
+#include "region.hpp"
+#include "terrain.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+// Saves and reloads a 16x4x16-chunk terrain through RegionStore, with and
+// without LZ4. MB/s counts serialized chunk bytes, so the two modes compare
+// like for like; the ratio is serialized bytes over bytes on disk. Loads run
+// on a fresh store (files reopened and remapped) on one thread, then on every
+// worker of a JobSystem.
+int main(){
+  using Clock = std::chrono::steady_clock;
+  namespace fs = std::filesystem;
+  const TerrainParams terrain{};
+  std::vector<ChunkCoord> coords;
+  std::vector<Chunk> chunks;
+  size_t rawBytes = 0;
+  for(int y=-1;y<3;++y)
+    for(int z=0;z<16;++z)
+      for(int x=0;x<16;++x){
+        coords.push_back({x, y, z});
+        chunks.emplace_back();
+        generateTerrain(terrain, coords.back(), chunks.back());
+        rawBytes += chunks.back().serializedSize();
+      }
+  const double mb = static_cast<double>(rawBytes) / 1.0e6;
+  const double n = static_cast<double>(chunks.size());
+  const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  const fs::path root = fs::temp_directory_path() / "blocco_bench_region";
+  for(bool compress : {false, true}){
+    const fs::path dir = root / (compress ? "lz4" : "raw");
+    fs::remove_all(dir);
+    double saveS = 0;
+    size_t disk = 0;
+    {
+      RegionStore store(dir.string(), RegionOptions{.compress = compress});
+      const auto t0 = Clock::now();
+      for(size_t i=0;i<chunks.size();++i) store.save(coords[i], chunks[i]);
+      saveS = std::chrono::duration<double>(Clock::now()-t0).count();
+      disk = store.fileBytes();
+    }
+    double loadS = 0;
+    {
+      RegionStore store(dir.string(), RegionOptions{.compress = compress});
+      Chunk c;
+      const auto t0 = Clock::now();
+      for(const ChunkCoord& cc : coords) if(!store.load(cc, c)) std::printf("missing chunk\n");
+      loadS = std::chrono::duration<double>(Clock::now()-t0).count();
+    }
+    double parallelS = 0;
+    {
+      RegionStore store(dir.string(), RegionOptions{.compress = compress});
+      JobSystem jobs(threads);
+      std::atomic<size_t> loaded{0};
+      const auto t0 = Clock::now();
+      jobs.parallelFor(0, coords.size(), 16, [&](size_t begin, size_t end){
+        Chunk c;
+        for(size_t i=begin;i<end;++i) if(store.load(coords[i], c)) loaded.fetch_add(1, std::memory_order_relaxed);
+      });
+      parallelS = std::chrono::duration<double>(Clock::now()-t0).count();
+      if(loaded != coords.size()) std::printf("missing chunks\n");
+    }
+    std::printf("%-4s %zu chunks, %.1f MB -> %.1f MB on disk (ratio %.2f): save %.0f chunks/s %.0f MB/s, load %.0f chunks/s %.0f MB/s, load on %u threads %.0f chunks/s\n",
+                compress ? "lz4" : "raw", chunks.size(), mb, static_cast<double>(disk)/1.0e6, static_cast<double>(rawBytes)/static_cast<double>(disk),
+                n/saveS, mb/saveS, n/loadS, mb/loadS, threads, n/parallelS);
+  }
+  fs::remove_all(root);
+  return 0;
+}
@@ -0,0 +1,52 @@
+#include "scene.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Micro-benchmark for the chunked block store: sequential vs random get/set
+// and bytes per loaded chunk for a few representative chunk contents.
+namespace {
+using clock_type = std::chrono::steady_clock;
+double nsPer(clock_type::time_point t0, size_t ops){
+  return std::chrono::duration<double, std::nano>(clock_type::now()-t0).count() / static_cast<double>(ops);
+}
+}
+
+int main(){
+  constexpr int EXTENT = 128; // 4x4x4 chunks
+  constexpr size_t OPS = size_t{EXTENT}*EXTENT*EXTENT;
+  Scene s;
+  s.fill({0,0,0},{EXTENT,EXTENT/2,EXTENT},1);
+
+  auto t0 = clock_type::now();
+  for(int y=0;y<EXTENT;++y) for(int z=0;z<EXTENT;++z) for(int x=0;x<EXTENT;++x)
+    s.setBlock(x,y,z,static_cast<BlockId>(1 + ((x^y^z)&3)));
+  std::printf("sequential set: %.2f ns/op\n", nsPer(t0, OPS));
+
+  unsigned sink = 0;
+  t0 = clock_type::now();
+  for(int y=0;y<EXTENT;++y) for(int z=0;z<EXTENT;++z) for(int x=0;x<EXTENT;++x) sink += s.getBlock(x,y,z);
+  std::printf("sequential get: %.2f ns/op\n", nsPer(t0, OPS));
+
+  std::mt19937 rng(1234);
+  std::vector<BlockPos> pos(OPS);
+  for(auto& p : pos) p = {static_cast<int32_t>(rng()%EXTENT), static_cast<int32_t>(rng()%EXTENT), static_cast<int32_t>(rng()%EXTENT)};
+  t0 = clock_type::now();
+  for(const auto& p : pos) s.setBlock(p.x,p.y,p.z,static_cast<BlockId>(p.x&7));
+  std::printf("random set:     %.2f ns/op\n", nsPer(t0, OPS));
+  t0 = clock_type::now();
+  for(const auto& p : pos) sink += s.getBlock(p.x,p.y,p.z);
+  std::printf("random get:     %.2f ns/op\n", nsPer(t0, OPS));
+
+  t0 = clock_type::now();
+  for(int i=0;i<64;++i) s.fill({0,i,0},{EXTENT,i+1,EXTENT},static_cast<BlockId>(i&15));
+  std::printf("slab fill:      %.2f ns/block\n", nsPer(t0, 64*size_t{EXTENT}*EXTENT));
+
+  s.compact();
+  std::printf("mixed world:    %zu chunks, %.0f bytes/chunk\n", s.chunkCount(), static_cast<double>(s.memoryUsage())/static_cast<double>(s.chunkCount()));
+  Scene solid; solid.fill({0,0,0},{EXTENT,EXTENT,EXTENT},1);
+  std::printf("solid world:    %zu chunks, %.0f bytes/chunk\n", solid.chunkCount(), static_cast<double>(solid.memoryUsage())/static_cast<double>(solid.chunkCount()));
+  std::printf("(checksum %u)\n", sink);
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include "streaming.hpp"
+#include "terrain.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Fly-through over streamed terrain at 60 Hz: the camera crosses one chunk
+// every 8 frames while ChunkStreamer::update() runs once per frame. Reports the
+// update's share of each frame (p50/p99, including inline jobs without
+// background workers) and chunks generated per second. Uploads are counted,
+// not performed.
+//
+// Then the view each configuration settles to from one spot, full detail
+// against LOD tiles past a smaller radius: view distance, quads drawn and
+// memory held; and the quads drawn once settled at every chunk the camera
+// flies on from there.
+int main(){
+  using Clock = std::chrono::steady_clock;
+  constexpr int FRAMES = 600;
+  constexpr float SPEED = Chunk::SIZE / 8.f; // blocks per frame
+  const auto frame = std::chrono::microseconds(16667);
+  const TerrainParams terrain{};
+  for(unsigned threads : {1u, std::max(1u, std::thread::hardware_concurrency())}){
+    JobSystem jobs(threads);
+    Scene scene;
+    StreamingConfig cfg;
+    ChunkStreamer streamer(scene, jobs, [&](const ChunkCoord& c, Chunk& out){ generateTerrain(terrain, c, out); }, cfg);
+    size_t uploaded = 0;
+    streamer.setUploader([&](const ChunkCoord&, const MeshBuffers& m){ uploaded += m.bytes(); },
+                         [](const ChunkCoord&){});
+    std::vector<double> ms;
+    ms.reserve(FRAMES);
+    const auto t0 = Clock::now();
+    auto deadline = t0;
+    for(int f=0;f<FRAMES;++f){
+      const Vec3 eye{static_cast<float>(f)*SPEED, 60.f, 0.f};
+      const auto start = Clock::now();
+      streamer.update(eye, {1.f, 0.f, 0.f});
+      ms.push_back(std::chrono::duration<double, std::milli>(Clock::now()-start).count());
+      deadline += frame;
+      std::this_thread::sleep_until(deadline);
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now()-t0).count();
+    std::sort(ms.begin(), ms.end());
+    const StreamingStats& s = streamer.stats();
+    std::printf("%2u threads: update p50 %.3f ms, p99 %.3f ms, max %.3f ms; %.0f chunks/s generated, %.0f meshes/s, %.1f MB uploaded, %u resident, %.1f MB\n",
+                threads, ms[ms.size()/2], ms[ms.size()*99/100], ms.back(), static_cast<double>(s.generated)/seconds,
+                static_cast<double>(s.meshed)/seconds, static_cast<double>(uploaded)/1.0e6, s.resident, static_cast<double>(s.memoryBytes)/1.0e6);
+    if(threads == std::thread::hardware_concurrency()) break;
+  }
+  constexpr int FLY_CHUNKS = 64;
+  JobSystem jobs(std::max(1u, std::thread::hardware_concurrency()));
+  for(const auto& [radius, levels] : {std::pair{8, 0}, std::pair{4, 3}}){
+    Scene scene;
+    StreamingConfig cfg;
+    cfg.radius = radius;
+    cfg.lodLevels = levels;
+    ChunkStreamer streamer(scene, jobs, [&](const ChunkCoord& c, Chunk& out){ generateTerrain(terrain, c, out); }, cfg);
+    streamer.setLodGenerator([&](const LodTile& t, Chunk& out){ generateTerrainLod(terrain, t, out); });
+    streamer.setUploader([](const ChunkCoord&, const MeshBuffers&){}, [](const ChunkCoord&){});
+    streamer.setLodUploader([](const LodTile&, const MeshBuffers&){}, [](const LodTile&){});
+    auto settle = [&](float x){
+      for(;;){
+        streamer.update({x, 60.f, 0.f}, {1.f, 0.f, 0.f});
+        const StreamingStats& s = streamer.stats();
+        if(s.inFlight == 0 && s.pendingUploads == 0 && s.uploadedBytes == 0) return s.visibleQuads;
+        streamer.finishJobs();
+      }
+    };
+    const auto t0 = Clock::now();
+    settle(0.f);
+    const double seconds = std::chrono::duration<double>(Clock::now()-t0).count();
+    const StreamingStats& s = streamer.stats();
+    std::printf("radius %d, %d LOD levels: view %.0f chunks, %zu quads in %u meshes (%u tiles), %u chunks resident, %.1f MB, settled in %.2f s\n",
+                radius, levels, static_cast<double>(streamer.selection().viewRadius()), s.visibleQuads, s.visible, s.tiles, s.resident,
+                static_cast<double>(s.memoryBytes)/1.0e6, seconds);
+    std::vector<size_t> quads;
+    for(int c=1;c<=FLY_CHUNKS;++c) quads.push_back(settle(static_cast<float>(c)*Chunk::SIZE));
+    std::sort(quads.begin(), quads.end());
+    std::printf("  settled at each of %d chunks flown: %zu quads p50, %zu max\n", FLY_CHUNKS, quads[quads.size()/2], quads.back());
+  }
+  return 0;
+}
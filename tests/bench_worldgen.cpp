@@ -0,0 +1,70 @@
+#include "noise.hpp"
+#include "worldgen.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Noise kernel throughput against the scalar reference, then world generation
+// in chunks per second per core: a region on one thread and on all of them
+// (one job per chunk column), chunk by chunk as ChunkStreamer runs it, and the
+// plain height-field generateTerrain() for scale.
+namespace {
+using Clock = std::chrono::steady_clock;
+
+template<class F>
+double nsPerItem(size_t items, int reps, F&& f){
+  const auto t0 = Clock::now();
+  for(int r=0;r<reps;++r) f();
+  return std::chrono::duration<double, std::nano>(Clock::now()-t0).count() / (static_cast<double>(items)*reps);
+}
+
+double seconds(Clock::time_point t0){ return std::chrono::duration<double>(Clock::now()-t0).count(); }
+}
+
+int main(){
+#if defined(BLOCCO_MATH_AVX2)
+  std::printf("noise path: AVX2\n");
+#elif defined(BLOCCO_MATH_SSE)
+  std::printf("noise path: SSE2\n");
+#else
+  std::printf("noise path: scalar\n");
+#endif
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> val(-4096.f, 4096.f);
+  const size_t N = 1 << 14;
+  std::vector<float> x(N), y(N), z(N), out(N);
+  for(size_t i=0;i<N;++i){ x[i] = val(rng); y[i] = val(rng); z[i] = val(rng); }
+  std::printf("valueNoise2: %.2f ns/point (scalar %.2f)\n",
+    nsPerItem(N, 200, [&]{ valueNoise2(1u, 1.f/64.f, x.data(), z.data(), out.data(), N); }),
+    nsPerItem(N, 200, [&]{ noise_scalar::valueNoise2(1u, 1.f/64.f, x.data(), z.data(), out.data(), N); }));
+  std::printf("valueNoise3: %.2f ns/point (scalar %.2f)\n",
+    nsPerItem(N, 100, [&]{ valueNoise3(1u, 1.f/64.f, x.data(), y.data(), z.data(), out.data(), N); }),
+    nsPerItem(N, 100, [&]{ noise_scalar::valueNoise3(1u, 1.f/64.f, x.data(), y.data(), z.data(), out.data(), N); }));
+
+  const WorldParams params{};
+  const ChunkCoord min{-6, -2, -6}, max{5, 4, 5}; // 12 x 7 x 12 chunks, caves to the mountain tops
+  const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  for(unsigned threads : {1u, cores}){
+    JobSystem jobs(threads);
+    Scene scene;
+    const WorldStats st = generateWorldRegion(jobs, scene, params, min, max);
+    const double rate = st.chunks / (st.ms / 1000.0);
+    std::printf("region, %2u threads: %u chunks (%u stored) in %.1f ms, %.0f chunks/s, %.0f chunks/s per core\n",
+                threads, st.chunks, st.stored, st.ms, rate, rate / threads);
+    if(threads == cores) break;
+  }
+  Chunk chunk;
+  size_t chunks = 0;
+  auto t0 = Clock::now();
+  for(int cy=min.y;cy<=max.y;++cy) for(int cz=min.z;cz<min.z+4;++cz) for(int cx=min.x;cx<min.x+4;++cx){ generateWorld(params, {cx, cy, cz}, chunk); ++chunks; }
+  std::printf("per chunk, 1 thread: %.0f chunks/s\n", static_cast<double>(chunks) / seconds(t0));
+  const TerrainParams terrain{};
+  chunks = 0;
+  t0 = Clock::now();
+  for(int cy=min.y;cy<=max.y;++cy) for(int cz=min.z;cz<=max.z;++cz) for(int cx=min.x;cx<=max.x;++cx){ generateTerrain(terrain, {cx, cy, cz}, chunk); ++chunks; }
+  std::printf("generateTerrain, 1 thread: %.0f chunks/s (height field only)\n", static_cast<double>(chunks) / seconds(t0));
+  return 0;
+}
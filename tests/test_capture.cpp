@@ -0,0 +1,160 @@
+#include "capture.hpp"
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <vector>
+
+namespace {
+// Reference inflate for the subset the encoder emits (stored and fixed-Huffman blocks).
+struct BitReader {
+  const uint8_t* p; size_t n; size_t bit{0};
+  uint32_t get(int count){
+    uint32_t v = 0;
+    for(int i=0;i<count;++i,++bit){ assert(bit/8 < n); v |= uint32_t{(p[bit/8] >> (bit%8)) & 1u} << i; }
+    return v;
+  }
+  uint32_t huff(int count){ uint32_t v = 0; for(int i=0;i<count;++i) v = (v << 1) | get(1); return v; }
+};
+
+uint32_t fixedLitLen(BitReader& br){
+  uint32_t c = br.huff(7);
+  if(c <= 0x17) return 256 + c;
+  c = (c << 1) | br.get(1);
+  if(c >= 0x30 && c <= 0xBF) return c - 0x30;
+  if(c >= 0xC0 && c <= 0xC7) return 280 + c - 0xC0;
+  c = (c << 1) | br.get(1);
+  return 144 + c - 0x190;
+}
+
+std::vector<uint8_t> inflate(const uint8_t* p, size_t n){
+  static const uint16_t LB[] = {3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258};
+  static const uint8_t LE[] = {0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0};
+  static const uint16_t DB[] = {1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577};
+  static const uint8_t DE[] = {0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
+  std::vector<uint8_t> out;
+  BitReader br{p, n};
+  bool last = false;
+  while(!last){
+    last = br.get(1) != 0;
+    const uint32_t type = br.get(2);
+    assert(type == 1);
+    for(;;){
+      const uint32_t s = fixedLitLen(br);
+      if(s < 256){ out.push_back(static_cast<uint8_t>(s)); continue; }
+      if(s == 256) break;
+      const uint32_t len = LB[s-257] + br.get(LE[s-257]);
+      const uint32_t dc = br.huff(5);
+      const uint32_t dist = DB[dc] + br.get(DE[dc]);
+      assert(dist <= out.size());
+      for(uint32_t k=0;k<len;++k) out.push_back(out[out.size()-dist]);
+    }
+  }
+  return out;
+}
+
+uint32_t be32(const uint8_t* p){ return uint32_t{p[0]} << 24 | uint32_t{p[1]} << 16 | uint32_t{p[2]} << 8 | p[3]; }
+
+// Parses our own PNG output (single IDAT, Up filter) back into RGBA.
+Capture::Image decodePNG(const std::vector<uint8_t>& png){
+  assert(png.size() > 8 && png[1] == 'P' && png[2] == 'N' && png[3] == 'G');
+  Capture::Image img;
+  std::vector<uint8_t> z;
+  for(size_t o=8; o<png.size();){
+    const uint32_t len = be32(&png[o]);
+    const char* type = reinterpret_cast<const char*>(&png[o+4]);
+    if(std::memcmp(type, "IHDR", 4) == 0){ img.width = be32(&png[o+8]); img.height = be32(&png[o+12]); }
+    if(std::memcmp(type, "IDAT", 4) == 0) z.insert(z.end(), &png[o+8], &png[o+8]+len);
+    o += 12 + len;
+  }
+  assert(z.size() > 6 && z[0] == 0x78);
+  const std::vector<uint8_t> raw = inflate(z.data()+2, z.size()-6);
+  uint32_t a = 1, b = 0;
+  for(uint8_t v : raw){ a = (a + v) % 65521; b = (b + a) % 65521; }
+  assert(be32(&z[z.size()-4]) == ((b << 16) | a));
+  const size_t row = size_t{img.width}*4;
+  assert(raw.size() == (row+1)*img.height);
+  img.rgba.resize(row*img.height);
+  for(uint32_t y=0;y<img.height;++y){
+    assert(raw[y*(row+1)] == 2);
+    for(size_t x=0;x<row;++x){
+      const uint8_t up = y ? img.rgba[(y-1)*row+x] : 0;
+      img.rgba[y*row+x] = static_cast<uint8_t>(raw[y*(row+1)+1+x] + up);
+    }
+  }
+  return img;
+}
+
+Capture::Image makeImage(uint32_t w, uint32_t h, unsigned seed){
+  Capture::Image img{w, h, std::vector<uint8_t>(size_t{w}*h*4)};
+  std::mt19937 rng(seed);
+  for(uint32_t y=0;y<h;++y){
+    for(uint32_t x=0;x<w;++x){
+      uint8_t* p = &img.rgba[(size_t{y}*w+x)*4];
+      // Mix flat areas, gradients and noise so every encoder path is exercised.
+      if(x < w/3){ p[0] = 20; p[1] = 40; p[2] = 60; p[3] = 255; }
+      else if(x < 2*w/3){ p[0] = static_cast<uint8_t>(x); p[1] = static_cast<uint8_t>(y); p[2] = static_cast<uint8_t>(x+y); p[3] = 255; }
+      else for(int c=0;c<4;++c) p[c] = static_cast<uint8_t>(rng());
+    }
+  }
+  return img;
+}
+}
+
+int main(){
+  for(auto [w, h] : {std::pair{1u, 1u}, std::pair{7u, 3u}, std::pair{64u, 64u}, std::pair{301u, 157u}}){
+    const Capture::Image img = makeImage(w, h, w*h);
+    const Capture::Image png = decodePNG(Capture::encodePNG(img.view()));
+    assert(png.width == w && png.height == h && png.rgba == img.rgba);
+    const Capture::Image qoi = Capture::decodeQOI(Capture::encodeQOI(img.view()));
+    assert(qoi.width == w && qoi.height == h && qoi.rgba == img.rgba);
+  }
+
+  // Strided views only read the described sub-rectangle.
+  const Capture::Image big = makeImage(40, 20, 1);
+  const Capture::ImageView sub{big.rgba.data() + 10*4, 20, 20, size_t{40}*4};
+  const Capture::Image subPng = decodePNG(Capture::encodePNG(sub));
+  for(uint32_t y=0;y<20;++y) assert(std::memcmp(&subPng.rgba[y*80], &big.rgba[(y*40+10)*4], 80) == 0);
+
+  // Flat frames compress to almost nothing.
+  Capture::Image flat{1920, 1080, std::vector<uint8_t>(size_t{1920}*1080*4, 128)};
+  assert(Capture::encodePNG(flat.view()).size() < 128*1024); // deflate caps matches at 258 bytes
+  assert(Capture::encodeQOI(flat.view()).size() < 64*1024);
+
+  // Box filter: averages whole blocks and clips partial edge blocks.
+  Capture::Image grid{5, 3, std::vector<uint8_t>(60)};
+  for(size_t i=0;i<15;++i) for(int c=0;c<4;++c) grid.rgba[i*4+c] = static_cast<uint8_t>(i*10);
+  const Capture::Image thumb = Capture::downsample(grid.view(), 2);
+  assert(thumb.width == 3 && thumb.height == 2);
+  assert(thumb.rgba[0] == 30);  // (0+10+50+60)/4
+  assert(thumb.rgba[8] == 65);  // (40+90)/2
+  assert(thumb.rgba[12] == 105); // (100+110)/2
+  assert(thumb.rgba[20] == 140); // 140 alone
+
+  assert(Capture::decodeQOI({}).rgba.empty());
+
+  // Recorder writes every frame and releases each buffer exactly once.
+  const auto dir = std::filesystem::temp_directory_path() / "blocco_test_capture";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  for(auto format : {Capture::Format::PNG, Capture::Format::QOI}){
+    JobSystem jobs(2);
+    std::atomic<int> released{0};
+    {
+      Capture::Recorder rec(jobs, {dir.string(), format, 4});
+      const Capture::Image frame = makeImage(64, 48, 7);
+      for(uint32_t f=0;f<8;++f) rec.submit(f, frame.view(), [&]{ released.fetch_add(1); });
+      rec.flush();
+      const Capture::RecorderStats s = rec.stats();
+      assert(s.submitted == 8 && s.written == 8 && s.bytes > 0);
+    }
+    assert(released.load() == 8);
+    const char* ext = format == Capture::Format::QOI ? ".qoi" : ".png";
+    assert(std::filesystem::exists(dir / (std::string("frame_000007") + ext)));
+    assert(std::filesystem::exists(dir / "frame_000007_thumb.png"));
+  }
+  std::filesystem::remove_all(dir);
+  return 0;
+}
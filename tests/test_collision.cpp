@@ -1,10 +1,99 @@
 #include "collision.hpp"
+#include "broadphase.hpp"
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+static AABB randomBox(std::mt19937& rng){
+  std::uniform_real_distribution<float> pos(0.f, 100.f), ext(0.2f, 4.f);
+  const Vec3 p{pos(rng),pos(rng),pos(rng)};
+  return {p, p + Vec3{ext(rng),ext(rng),ext(rng)}};
+}
+
 int main(){
   AABB a{{0,0,0},{1,1,1}};
   AABB b{{0.5f,0.5f,0.5f},{2,2,2}};
   AABB c{{2,2,2},{3,3,3}};
   assert(intersect(a,b));
   assert(!intersect(a,c));
+  float t = 0.f;
+  assert(intersectRay(c, Ray{{0,2.5f,2.5f},{1,0,0}}, 10.f, t) && std::fabs(t-2.f) < 1e-6f);
+  assert(!intersectRay(c, Ray{{0,2.5f,2.5f},{-1,0,0}}, 10.f, t));
+
+  // Broadphase tree vs brute force, through inserts, moves, removals and a rebuild.
+  std::mt19937 rng(99);
+  std::vector<AABB> boxes(600);
+  std::vector<int32_t> proxies(boxes.size());
+  AabbTree tree(0.25f);
+  for(size_t i=0;i<boxes.size();++i){ boxes[i] = randomBox(rng); proxies[i] = tree.insert(boxes[i], static_cast<uint32_t>(i)); }
+  std::vector<bool> alive(boxes.size(), true);
+  for(int round=0; round<3; ++round){
+    for(size_t i=0;i<boxes.size();i+=3){
+      if(!alive[i]) continue;
+      const Vec3 d{static_cast<float>(rng()%5)*0.1f, 0.f, -0.2f};
+      boxes[i] = {boxes[i].min + d, boxes[i].max + d};
+      tree.move(proxies[i], boxes[i]);
+    }
+    for(size_t i=round;i<boxes.size();i+=17){
+      if(alive[i]){ tree.remove(proxies[i]); alive[i] = false; }
+    }
+    if(round==1) tree.rebuild();
+    assert(tree.height() < 40);
+
+    std::set<std::pair<uint32_t,uint32_t>> expected, got;
+    for(size_t i=0;i<boxes.size();++i) for(size_t j=i+1;j<boxes.size();++j)
+      if(alive[i] && alive[j] && intersect(boxes[i], boxes[j])) expected.insert({static_cast<uint32_t>(i), static_cast<uint32_t>(j)});
+    std::vector<BroadphasePair> pairs(expected.size() + 16);
+    const size_t np = tree.queryPairs(pairs);
+    assert(np == expected.size());
+    for(size_t k=0;k<np;++k) got.insert(std::minmax(pairs[k].a, pairs[k].b));
+    assert(got == expected);
+
+    const AABB range{{20,20,20},{60,45,70}};
+    std::vector<uint32_t> hits(boxes.size());
+    const size_t nh = tree.query(range, hits);
+    std::set<uint32_t> gotRange(hits.begin(), hits.begin()+static_cast<std::ptrdiff_t>(nh)), wantRange;
+    for(size_t i=0;i<boxes.size();++i) if(alive[i] && intersect(boxes[i], range)) wantRange.insert(static_cast<uint32_t>(i));
+    assert(gotRange == wantRange);
+    // Truncated output still reports the full count.
+    std::vector<uint32_t> small(2);
+    assert(tree.query(range, small) == nh);
+
+    const Ray ray{{0,50,50}, normalize(Vec3{1,0.1f,-0.2f})};
+    std::vector<RayHit> rayHits(boxes.size());
+    const size_t nr = tree.raycast(ray, 200.f, rayHits);
+    size_t want = 0;
+    for(size_t i=0;i<boxes.size();++i) if(alive[i] && intersectRay(boxes[i], ray, 200.f, t)) ++want;
+    assert(nr == want);
+  }
+
+  // Voxel DDA vs fine-grained ray marching.
+  Scene s;
+  for(int i=0;i<200;++i) s.setBlock(static_cast<int>(rng()%40)-20, static_cast<int>(rng()%40)-20, static_cast<int>(rng()%40)-20, 1);
+  std::uniform_real_distribution<float> across(-19.f, 19.f), slope(-0.25f, 0.25f);
+  for(int i=0;i<200;++i){
+    const Vec3 o{-25.f, across(rng), across(rng)};
+    const Vec3 d = normalize(Vec3{1.f, slope(rng), slope(rng)});
+    VoxelHit hit;
+    const bool found = raycastVoxels(s, Ray{o,d}, 80.f, hit);
+    bool marched = false;
+    for(float m=0.f; m<=80.f && !marched; m+=0.001f){
+      const Vec3 p = o + d*m;
+      const int x = static_cast<int>(std::floor(p.x)), y = static_cast<int>(std::floor(p.y)), z = static_cast<int>(std::floor(p.z));
+      if(s.getBlock(x,y,z)!=BLOCK_AIR){
+        marched = true;
+        assert(found && hit.x==x && hit.y==y && hit.z==z && std::fabs(hit.t-m) < 0.01f);
+      }
+    }
+    assert(marched == found);
+  }
+  s.fill({0,0,0},{4,4,4},2);
+  std::vector<BlockPos> cells(128);
+  assert(overlapVoxels(s, AABB{{0.5f,0.5f,0.5f},{2.5f,1.f,1.5f}}, cells) == 6);
+  assert(overlapVoxels(s, AABB{{4.f,0.f,0.f},{5.f,1.f,1.f}}, cells) == 0);
   return 0;
 }
@@ -0,0 +1,153 @@
+#include "camera.hpp"
+#include "culling.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+bool near(const Vec3& a, const Vec3& b, float tol = 1e-4f){
+  return std::fabs(a.x-b.x) < tol && std::fabs(a.y-b.y) < tol && std::fabs(a.z-b.z) < tol;
+}
+
+void testCamera(){
+  Camera cam;
+  cam.position = {1.f, 2.f, 3.f};
+  assert(near(transformPoint(cam.view(), cam.position), {0.f, 0.f, 0.f}));
+  assert(near(transformPoint(cam.view(), cam.position + Vec3{0.f, 0.f, -5.f}), {0.f, 0.f, -5.f}));
+  // Matches lookAt for the same direction, and stays finite looking straight down.
+  cam.yaw = 0.7f; cam.pitch = -0.3f;
+  const Mat4 ref = lookAt(cam.position, cam.position + cam.forward(), {0.f, 1.f, 0.f});
+  for(int i=0;i<16;++i) assert(std::fabs(ref.m[i] - cam.view().m[i]) < 1e-5f);
+  cam.pitch = -1.5707964f;
+  for(float v : cam.view().m) assert(std::isfinite(v));
+  // yaw pi looks down +Z: points ahead are inside the frustum, points behind are not.
+  cam.position = {0.f, 0.f, 0.f}; cam.yaw = 3.14159265f; cam.pitch = 0.f;
+  const Frustum f = cam.frustum(16.f/9.f);
+  assert(frustumVisible(f, {-1.f, -1.f, 9.f}, {1.f, 1.f, 11.f}));
+  assert(!frustumVisible(f, {-1.f, -1.f, -11.f}, {1.f, 1.f, -9.f}));
+  assert(!frustumVisible(f, {-1.f, -1.f, cam.zFar + 10.f}, {1.f, 1.f, cam.zFar + 20.f}));
+  assert(!frustumVisible(f, {500.f, -1.f, 9.f}, {501.f, 1.f, 11.f}));
+}
+
+void testFrustumMatchesBatchKernel(){
+  Camera cam; cam.yaw = 0.4f; cam.pitch = 0.2f;
+  const Frustum f = cam.frustum(1.5f);
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<float> pos(-200.f, 200.f), ext(0.5f, 20.f);
+  constexpr size_t N = 4000;
+  std::vector<float> mnx(N), mny(N), mnz(N), mxx(N), mxy(N), mxz(N);
+  for(size_t i=0;i<N;++i){
+    mnx[i] = pos(rng); mny[i] = pos(rng); mnz[i] = pos(rng);
+    mxx[i] = mnx[i] + ext(rng); mxy[i] = mny[i] + ext(rng); mxz[i] = mnz[i] + ext(rng);
+  }
+  std::vector<uint8_t> visible(N);
+  const size_t count = cullAabbs(f, mnx.data(), mny.data(), mnz.data(), mxx.data(), mxy.data(), mxz.data(), visible.data(), N);
+  size_t mine = 0;
+  for(size_t i=0;i<N;++i){
+    const bool v = frustumVisible(f, {mnx[i], mny[i], mnz[i]}, {mxx[i], mxy[i], mxz[i]});
+    assert(v == (visible[i] != 0));
+    mine += v;
+  }
+  assert(mine == count && count > 0 && count < N);
+}
+
+void testTransformBounds(){
+  const Mat4 m = translate({10.f, 0.f, -4.f}) * lookAt({0.f, 0.f, 0.f}, {1.f, 0.5f, -1.f}, {0.f, 1.f, 0.f});
+  const Vec3 lo{-1.f, 0.f, -2.f}, hi{3.f, 1.f, 2.f};
+  Vec3 mn, mx;
+  transformBounds(m, lo, hi, mn, mx);
+  for(int i=0;i<8;++i){
+    const Vec3 p = transformPoint(m, {i & 1 ? hi.x : lo.x, i & 2 ? hi.y : lo.y, i & 4 ? hi.z : lo.z});
+    assert(p.x >= mn.x - 1e-4f && p.x <= mx.x + 1e-4f);
+    assert(p.y >= mn.y - 1e-4f && p.y <= mx.y + 1e-4f);
+    assert(p.z >= mn.z - 1e-4f && p.z <= mx.z + 1e-4f);
+  }
+  transformBounds(translate({1.f, 2.f, 3.f}), lo, hi, mn, mx);
+  assert(near(mn, {0.f, 2.f, 1.f}) && near(mx, {4.f, 3.f, 5.f}));
+}
+
+void testPyramidBoundsEveryTexel(){
+  constexpr uint32_t W = 37, H = 23; // odd sizes exercise the folded edge texels
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<float> d(0.f, 1.f);
+  std::vector<float> depth(W*H);
+  for(float& v : depth) v = d(rng);
+  DepthPyramid pyramid;
+  pyramid.build(depth, W, H);
+  assert(pyramid.levels() == DepthPyramid::levelCount(W, H));
+  assert(pyramid.width(0) == 18 && pyramid.height(0) == 11);
+  assert(pyramid.width(pyramid.levels()-1) == 1 && pyramid.height(pyramid.levels()-1) == 1);
+  for(uint32_t l=0;l<pyramid.levels();++l)
+    for(uint32_t y=0;y<H;++y)
+      for(uint32_t x=0;x<W;++x){
+        const uint32_t px = std::min(x >> (l+1), pyramid.width(l)-1), py = std::min(y >> (l+1), pyramid.height(l)-1);
+        assert(pyramid.at(l, px, py) >= depth[y*W + x]);
+      }
+}
+
+void testOcclusion(){
+  constexpr uint32_t W = 160, H = 90;
+  Camera cam; // looks down -Z from (0, 1.6, 0)
+  const Mat4 viewProj = cam.projection(static_cast<float>(W)/H) * cam.view();
+  // A wall filling the screen 10 units ahead.
+  const Vec4 wall = viewProj * Vec4{0.f, 1.6f, -10.f, 1.f};
+  std::vector<float> depth(W*H, wall.z/wall.w);
+  DepthPyramid pyramid;
+  assert(!pyramid.occluded(viewProj, {-1.f, 0.f, -30.f}, {1.f, 2.f, -20.f})); // nothing built yet
+  pyramid.build(depth, W, H);
+  assert(pyramid.occluded(viewProj, {-1.f, 0.f, -30.f}, {1.f, 2.f, -20.f}));
+  assert(pyramid.occluded(viewProj, {-200.f, -50.f, -60.f}, {200.f, 50.f, -50.f})); // wider than the screen
+  assert(!pyramid.occluded(viewProj, {-1.f, 0.f, -6.f}, {1.f, 2.f, -4.f}));
+  assert(!pyramid.occluded(viewProj, {-1.f, 0.f, -12.f}, {1.f, 2.f, -8.f})); // pokes through the wall
+  assert(!pyramid.occluded(viewProj, {-1.f, 0.f, -30.f}, {1.f, 2.f, 5.f})); // crosses the near plane
+  // Punch a hole: boxes seen through it are visible, boxes beside it stay hidden.
+  for(uint32_t y=40;y<50;++y) for(uint32_t x=75;x<85;++x) depth[y*W + x] = 1.f;
+  pyramid.build(depth, W, H);
+  assert(!pyramid.occluded(viewProj, {-0.2f, 1.4f, -30.f}, {0.2f, 1.8f, -29.f}));
+  assert(pyramid.occluded(viewProj, {-9.f, 1.4f, -30.f}, {-8.f, 1.8f, -29.f}));
+}
+
+// Whenever a box is reported occluded, every depth sample its projection covers is nearer.
+void testOcclusionIsConservative(){
+  constexpr uint32_t W = 97, H = 61;
+  Camera cam; cam.yaw = 0.3f;
+  const Mat4 viewProj = cam.projection(static_cast<float>(W)/H) * cam.view();
+  std::mt19937 rng(9);
+  std::uniform_real_distribution<float> d(0.9f, 1.f), pos(-40.f, 40.f), ext(0.1f, 8.f);
+  std::vector<float> depth(W*H);
+  for(uint32_t y=0;y<H;++y)
+    for(uint32_t x=0;x<W;++x) depth[y*W + x] = (x / 8 + y / 8) % 3 == 0 ? 1.f : d(rng);
+  DepthPyramid pyramid;
+  pyramid.build(depth, W, H);
+  size_t hidden = 0;
+  for(int i=0;i<3000;++i){
+    const Vec3 mn{pos(rng), pos(rng) * 0.25f, -pos(rng) * 2.f - 82.f};
+    const Vec3 mx = mn + Vec3{ext(rng), ext(rng), ext(rng)};
+    if(!pyramid.occluded(viewProj, mn, mx)) continue;
+    ++hidden;
+    float u0 = 1.f, v0 = 1.f, u1 = 0.f, v1 = 0.f, nearest = 1.f;
+    for(int c=0;c<8;++c){
+      const Vec4 p = viewProj * Vec4{c & 1 ? mx.x : mn.x, c & 2 ? mx.y : mn.y, c & 4 ? mx.z : mn.z, 1.f};
+      u0 = std::min(u0, p.x/p.w*0.5f + 0.5f); u1 = std::max(u1, p.x/p.w*0.5f + 0.5f);
+      v0 = std::min(v0, p.y/p.w*0.5f + 0.5f); v1 = std::max(v1, p.y/p.w*0.5f + 0.5f);
+      nearest = std::min(nearest, p.z/p.w);
+    }
+    const auto texel = [](float t, uint32_t size){ return std::min(static_cast<uint32_t>(std::clamp(t, 0.f, 1.f)*static_cast<float>(size)), size-1); };
+    for(uint32_t y=texel(v0, H); y<=texel(v1, H); ++y)
+      for(uint32_t x=texel(u0, W); x<=texel(u1, W); ++x) assert(depth[y*W + x] < nearest);
+  }
+  assert(hidden > 0);
+}
+}
+
+int main(){
+  testCamera();
+  testFrustumMatchesBatchKernel();
+  testTransformBounds();
+  testPyramidBoundsEveryTexel();
+  testOcclusion();
+  testOcclusionIsConservative();
+  return 0;
+}
@@ -0,0 +1,160 @@
+#include "draw_list.hpp"
+#include "jobs.hpp"
+#include <cassert>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+void testOrdering(){
+  DrawList list;
+  std::mt19937 rng(3);
+  struct Src { uint32_t pipeline, material; float depth; };
+  std::vector<Src> src;
+  for(uint32_t i=0;i<5000;++i){
+    const Src s{static_cast<uint32_t>(rng() % 3), static_cast<uint32_t>(rng() % 40), static_cast<float>(rng() % 100000) * 0.01f - 5.f};
+    src.push_back(s);
+    // Encode the source index in the mesh and the transform so the output can be traced back.
+    const auto x = static_cast<float>(i);
+    list.add(s.pipeline, s.material, {i, i*3, static_cast<int32_t>(i)}, translate({x, 0.f, 0.f}), s.depth, {x, 0.f, 0.f}, {x + 1.f, 1.f, 1.f});
+  }
+  std::vector<DrawIndexedIndirect> cmds(list.size());
+  std::vector<Mat4> xforms(list.size());
+  std::vector<DrawBounds> bounds(list.size());
+  const auto batches = list.build(cmds, xforms, bounds, 100);
+  uint32_t covered = 0;
+  for(const DrawBatch& b : batches){
+    assert(b.first == covered && b.count > 0);
+    covered += b.count;
+  }
+  assert(covered == src.size());
+  for(size_t i=0;i<cmds.size();++i){
+    const uint32_t s = cmds[i].indexCount;
+    assert(cmds[i].instanceCount == 1 && cmds[i].firstIndex == s*3 && cmds[i].vertexOffset == static_cast<int32_t>(s));
+    assert(cmds[i].firstInstance == 100 + i && xforms[i].m[12] == static_cast<float>(s));
+    // Bounds follow the sorted order and name the batch their survivors compact into.
+    assert(bounds[i].min[0] == static_cast<float>(s) && bounds[i].max[0] == static_cast<float>(s) + 1.f);
+    assert(!(bounds[i].batch & DrawBounds::IN_ORDER));
+    const DrawBatch& batch = batches[bounds[i].batch];
+    assert(bounds[i].batchFirst == batch.first && i >= batch.first && i < batch.first + batch.count);
+    if(i == 0) continue;
+    const Src& a = src[cmds[i-1].indexCount];
+    const Src& b = src[s];
+    const float da = a.depth > 0.f ? a.depth : 0.f, db = b.depth > 0.f ? b.depth : 0.f;
+    assert(a.pipeline < b.pipeline || (a.pipeline == b.pipeline && (a.material < b.material || (a.material == b.material && da <= db))));
+    // Equal keys keep submission order.
+    if(a.pipeline == b.pipeline && a.material == b.material && da == db) assert(cmds[i-1].indexCount < s);
+  }
+  for(const DrawBatch& b : batches) assert(src[cmds[b.first].indexCount].pipeline == b.pipeline);
+  assert(batches.size() == 3);
+}
+
+void testReuse(){
+  DrawList list;
+  std::vector<DrawIndexedIndirect> cmds(4);
+  std::vector<Mat4> xforms(4);
+  assert(list.build(cmds, xforms).empty());
+  list.add(0, 0, {6, 0, 0}, identity(), 2.f);
+  list.add(0, 0, {6, 6, 4}, identity(), 1.f);
+  auto batches = list.build(cmds, xforms);
+  assert(batches.size() == 1 && batches[0].count == 2 && cmds[0].firstIndex == 6 && cmds[1].firstIndex == 0);
+  list.clear();
+  assert(list.empty());
+  list.add(1, 0, {3, 0, 0}, identity(), 0.f);
+  batches = list.build(cmds, xforms);
+  assert(batches.size() == 1 && batches[0].pipeline == 1 && cmds[0].indexCount == 3 && cmds[0].firstInstance == 0);
+}
+
+// A back-to-front pipeline sorts far to near ahead of material; the others keep
+// material first and near to far, and batches stay one per pipeline.
+void testBackToFront(){
+  DrawList list;
+  list.setBackToFront(2, true);
+  std::mt19937 rng(5);
+  struct Src { uint32_t pipeline, material; float depth; };
+  std::vector<Src> src;
+  for(uint32_t i=0;i<3000;++i){
+    const Src s{static_cast<uint32_t>(rng() % 3), static_cast<uint32_t>(rng() % 8), static_cast<float>(rng() % 5000) * 0.1f - 2.f};
+    src.push_back(s);
+    list.add(s.pipeline, s.material, {i, 0, 0}, identity(), s.depth);
+  }
+  list.clear(); // the setting outlives clear()
+  for(uint32_t i=0;i<src.size();++i) list.add(src[i].pipeline, src[i].material, {i, 0, 0}, identity(), src[i].depth);
+  std::vector<DrawIndexedIndirect> cmds(list.size());
+  std::vector<Mat4> xforms(list.size());
+  const auto batches = list.build(cmds, xforms);
+  assert(batches.size() == 3 && batches[2].pipeline == 2);
+  for(size_t i=1;i<cmds.size();++i){
+    const Src& a = src[cmds[i-1].indexCount];
+    const Src& b = src[cmds[i].indexCount];
+    const float da = a.depth > 0.f ? a.depth : 0.f, db = b.depth > 0.f ? b.depth : 0.f;
+    if(a.pipeline != b.pipeline){ assert(a.pipeline < b.pipeline); continue; }
+    if(a.pipeline == 2) assert(da > db || (da == db && a.material <= b.material));
+    else assert(a.material < b.material || (a.material == b.material && da <= db));
+  }
+  // Switching it off restores material-first order.
+  list.setBackToFront(2, false);
+  list.clear();
+  list.add(2, 1, {0, 0, 0}, identity(), 10.f);
+  list.add(2, 0, {1, 0, 0}, identity(), 1.f);
+  list.add(2, 1, {2, 0, 0}, identity(), 20.f);
+  list.build(cmds, xforms);
+  assert(cmds[0].indexCount == 1 && cmds[1].indexCount == 0 && cmds[2].indexCount == 2);
+  list.setBackToFront(2, true);
+  list.clear();
+  list.add(2, 1, {0, 0, 0}, identity(), 10.f);
+  list.add(2, 0, {1, 0, 0}, identity(), 1.f);
+  list.add(2, 1, {2, 0, 0}, identity(), 20.f);
+  list.add(0, 0, {3, 0, 0}, identity(), 5.f);
+  std::vector<DrawBounds> bounds(list.size());
+  list.build(cmds, xforms, bounds);
+  assert(cmds[0].indexCount == 3 && cmds[1].indexCount == 2 && cmds[2].indexCount == 0 && cmds[3].indexCount == 1);
+  // The cull pass keeps back-to-front batches in place rather than compacting them.
+  assert(bounds[0].batch == 0 && bounds[0].batchFirst == 0);
+  for(size_t i=1;i<4;++i) assert(bounds[i].batch == (1 | DrawBounds::IN_ORDER) && bounds[i].batchFirst == 1);
+}
+
+// Chunks written concurrently, in whatever order the workers pick them up,
+// produce exactly what build() writes in one pass.
+void testChunkedWrite(){
+  DrawList list;
+  std::mt19937 rng(8);
+  for(uint32_t i=0;i<20000;++i){
+    const auto x = static_cast<float>(i);
+    list.add(static_cast<uint32_t>(rng() % 4), static_cast<uint32_t>(rng() % 16), {i, i, 0}, translate({x, 0.f, 0.f}),
+             static_cast<float>(rng() % 1000), {x, 0.f, 0.f}, {x + 1.f, 1.f, 1.f});
+  }
+  const size_t n = list.size();
+  std::vector<DrawIndexedIndirect> refCmds(n), cmds(n);
+  std::vector<Mat4> refXforms(n), xforms(n);
+  std::vector<DrawBounds> refBounds(n), bounds(n);
+  const auto built = list.build(refCmds, refXforms, refBounds, 7);
+  const std::vector<DrawBatch> batches(built.begin(), built.end());
+  std::vector<DrawChunk> chunks;
+  list.split(700, chunks);
+  uint32_t next = 0;
+  for(const DrawChunk& c : chunks){
+    // In draw order, never past maxDraws and never across a batch boundary.
+    const DrawBatch& b = batches[c.batch];
+    assert(c.first == next && c.count > 0 && c.count <= 700);
+    assert(c.first >= b.first && c.first + c.count <= b.first + b.count);
+    next += c.count;
+  }
+  assert(next == n);
+  JobSystem jobs(4);
+  jobs.parallelFor(0, chunks.size(), 1, [&](size_t b, size_t e){
+    for(size_t i=b;i<e;++i) list.write(chunks[i].first, chunks[i].count, cmds, xforms, bounds, 7);
+  });
+  assert(std::memcmp(cmds.data(), refCmds.data(), n*sizeof(DrawIndexedIndirect)) == 0);
+  assert(std::memcmp(xforms.data(), refXforms.data(), n*sizeof(Mat4)) == 0);
+  assert(std::memcmp(bounds.data(), refBounds.data(), n*sizeof(DrawBounds)) == 0);
+}
+}
+
+int main(){
+  testOrdering();
+  testReuse();
+  testBackToFront();
+  testChunkedWrite();
+  return 0;
+}
@@ -0,0 +1,203 @@
+#include "font.hpp"
+#include "jobs.hpp"
+#include <cassert>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+// A minimal TrueType font built in memory: 1000 units per em, 'H' a square
+// (on-curve points), 'O' a rounded shape from four off-curve points, 'I' a
+// composite of the square scaled by half and shifted, ' ' blank.
+namespace {
+struct Bytes {
+  std::vector<uint8_t> v;
+  void u16(int x){ v.push_back(static_cast<uint8_t>((x >> 8) & 0xff)); v.push_back(static_cast<uint8_t>(x & 0xff)); }
+  void u32(uint32_t x){ u16(static_cast<int>(x >> 16)); u16(static_cast<int>(x & 0xffff)); }
+  void pad(){ while(v.size() % 4) v.push_back(0); }
+};
+
+Bytes simpleGlyph(const std::vector<std::pair<int, int>>& pts, bool on){
+  Bytes g;
+  int x0 = pts[0].first, x1 = x0, y0 = pts[0].second, y1 = y0;
+  for(const auto& [x, y] : pts){ x0 = std::min(x0, x); x1 = std::max(x1, x); y0 = std::min(y0, y); y1 = std::max(y1, y); }
+  g.u16(1); g.u16(x0); g.u16(y0); g.u16(x1); g.u16(y1);
+  g.u16(static_cast<int>(pts.size()) - 1); // end point of the only contour
+  g.u16(0);                                // no instructions
+  for(size_t i=0;i<pts.size();++i) g.v.push_back(on ? 1 : 0); // long coordinates
+  int px = 0, py = 0;
+  for(const auto& p : pts){ g.u16(p.first - px); px = p.first; }
+  for(const auto& p : pts){ g.u16(p.second - py); py = p.second; }
+  return g;
+}
+
+std::vector<uint8_t> syntheticFont(){
+  std::vector<Bytes> glyphs(4);
+  glyphs[1] = simpleGlyph({{100, 0}, {100, 600}, {500, 600}, {500, 0}}, true);
+  glyphs[2] = simpleGlyph({{200, 600}, {800, 600}, {800, 0}, {200, 0}}, false);
+  Bytes& composite = glyphs[3];
+  composite.u16(-1); composite.u16(150); composite.u16(0); composite.u16(350); composite.u16(300);
+  composite.u16(0x0b); composite.u16(1);    // words, xy offsets, uniform scale; glyph 1
+  composite.u16(100); composite.u16(0);     // offset
+  composite.u16(8192);                      // 0.5 in F2Dot14
+  Bytes glyf, loca;
+  for(Bytes& g : glyphs){
+    loca.u16(static_cast<int>(glyf.v.size() / 2));
+    glyf.v.insert(glyf.v.end(), g.v.begin(), g.v.end());
+    if(glyf.v.size() % 2) glyf.v.push_back(0);
+  }
+  loca.u16(static_cast<int>(glyf.v.size() / 2));
+
+  Bytes head;
+  head.v.resize(54);
+  head.v[18] = 1000 >> 8; head.v[19] = 1000 & 0xff; // units per em; short loca
+  Bytes maxp;
+  maxp.u32(0x00005000); maxp.u16(4);
+  Bytes hhea;
+  hhea.v.resize(36);
+  hhea.v[4] = 800 >> 8; hhea.v[5] = 800 & 0xff;                               // ascender
+  hhea.v[6] = static_cast<uint8_t>((-200 >> 8) & 0xff); hhea.v[7] = static_cast<uint8_t>(-200 & 0xff); // descender
+  hhea.v[35] = 4;                                                              // metrics
+  Bytes hmtx;
+  for(const int advance : {500, 600, 1000, 400}){ hmtx.u16(advance); hmtx.u16(0); }
+  // Format 4: 'H'..'I' through the glyph id array, 'O' by delta, then the end marker.
+  Bytes cmap;
+  cmap.u16(0); cmap.u16(1);
+  cmap.u16(3); cmap.u16(1); cmap.u32(12);
+  cmap.u16(4); cmap.u16(0); cmap.u16(0); // format, length (unchecked), language
+  cmap.u16(6); cmap.u16(4); cmap.u16(1); cmap.u16(2);
+  for(const int end : {int{'I'}, int{'O'}, 0xffff}) cmap.u16(end);
+  cmap.u16(0);
+  for(const int start : {int{'H'}, int{'O'}, 0xffff}) cmap.u16(start);
+  for(const int delta : {0, 2 - 'O', 1}) cmap.u16(delta);
+  for(const int range : {6, 0, 0}) cmap.u16(range);
+  cmap.u16(1); cmap.u16(3); // glyph ids of 'H', 'I'
+
+  const std::pair<uint32_t, Bytes*> tables[] = {
+    {0x636d6170, &cmap}, {0x676c7966, &glyf}, {0x68656164, &head}, {0x68686561, &hhea},
+    {0x686d7478, &hmtx}, {0x6c6f6361, &loca}, {0x6d617870, &maxp}};
+  Bytes font;
+  font.u32(0x00010000); font.u16(7); font.u16(0); font.u16(0); font.u16(0);
+  uint32_t offset = 12 + 7*16;
+  for(const auto& [tag, t] : tables){
+    font.u32(tag); font.u32(0); font.u32(offset); font.u32(static_cast<uint32_t>(t->v.size()));
+    offset += static_cast<uint32_t>((t->v.size() + 3) & ~size_t{3});
+  }
+  for(const auto& [tag, t] : tables){ font.v.insert(font.v.end(), t->v.begin(), t->v.end()); font.pad(); }
+  return font.v;
+}
+
+uint8_t texel(const FontAtlas& a, const FontAtlas::Glyph& g, float u, float v){
+  const auto x = g.x + static_cast<uint32_t>(u * static_cast<float>(g.w - 1));
+  const auto y = g.y + static_cast<uint32_t>(v * static_cast<float>(g.h - 1));
+  return a.pixels[size_t{y}*a.width + x];
+}
+
+bool near(float a, float b){ return std::abs(a - b) < 1e-5f; }
+
+void testAtlas(const std::vector<uint8_t>& ttf){
+  const FontAtlasParams params{32.f, 4.f, 128};
+  const FontAtlas atlas = buildFontAtlas(ttf, params);
+  assert(atlas.width == 128 && atlas.height >= 16 && atlas.height % 4 == 0);
+  assert(atlas.pixels.size() == size_t{atlas.width} * atlas.height);
+  assert(near(atlas.ascender, 0.8f) && near(atlas.descender, -0.2f) && near(atlas.lineHeight(), 1.f));
+
+  // 'H': x 3.2..16 px and y 0..19.2 px, rounded out and padded by 5 px; solid
+  // inside, empty in the padding.
+  const FontAtlas::Glyph& h = atlas.glyph('H');
+  assert(near(h.advance, 0.6f));
+  assert(h.w == 23 && h.h == 30);
+  assert(near(h.left, -2.f / 32.f) && near(h.top, 25.f / 32.f));
+  assert(texel(atlas, h, 0.5f, 0.5f) == 255 && texel(atlas, h, 0.f, 0.f) == 0);
+  // Across the middle row the field rises through 128 at the outline.
+  const size_t row = size_t{h.y} + h.h/2u;
+  const uint8_t* line = &atlas.pixels[row*atlas.width + h.x];
+  bool rising = false;
+  for(uint32_t x=1; x<h.w/2u; ++x){ assert(line[x] >= line[x - 1]); rising |= line[x - 1] < 128 && line[x] >= 128; }
+  assert(rising);
+
+  // 'O': inside at the centre, outside in the corners of its bounding box.
+  const FontAtlas::Glyph& o = atlas.glyph('O');
+  assert(near(o.advance, 1.f));
+  assert(texel(atlas, o, 0.5f, 0.5f) == 255);
+  assert(texel(atlas, o, 0.25f, 0.22f) < 128 && texel(atlas, o, 0.76f, 0.8f) < 128);
+  assert(texel(atlas, o, 0.5f, 0.22f) > 128);
+
+  // 'I': the square at half size, 100 units right: x 150..350, y 0..300.
+  const FontAtlas::Glyph& i = atlas.glyph('I');
+  assert(near(i.advance, 0.4f));
+  assert(near(i.left, (4.f - 5.f) / 32.f) && near(i.top, (10.f + 5.f) / 32.f));
+  assert(texel(atlas, i, 0.5f, 0.5f) > 128 && texel(atlas, i, 0.f, 0.f) == 0);
+
+  // Blank and unmapped characters take no space; out-of-range ones read as '?'.
+  assert(atlas.glyph(' ').w == 0 && near(atlas.glyph(' ').advance, 0.5f));
+  assert(atlas.glyph('A').w == 0 && &atlas.glyph(0x263a) == &atlas.glyph('?'));
+
+  // Rectangles stay inside the atlas and apart.
+  for(const FontAtlas::Glyph& a : atlas.glyphs){
+    if(a.w == 0) continue;
+    assert(a.x + a.w <= atlas.width && a.y + a.h <= atlas.height);
+    for(const FontAtlas::Glyph& b : atlas.glyphs){
+      if(&a == &b || b.w == 0) continue;
+      assert(a.x + a.w < b.x + 1u || b.x + b.w < a.x + 1u || a.y + a.h < b.y + 1u || b.y + b.h < a.y + 1u);
+    }
+  }
+
+  // Rendering on the job system gives the same atlas.
+  JobSystem jobs(4);
+  assert(buildFontAtlas(ttf, params, &jobs).pixels == atlas.pixels);
+}
+
+void testCache(const std::vector<uint8_t>& ttf){
+  const FontAtlasParams params{24.f, 3.f, 64};
+  const FontAtlas atlas = buildFontAtlas(ttf, params);
+  const uint64_t key = FontAtlasFile::key(ttf, params);
+  assert(key != FontAtlasFile::key(ttf, FontAtlasParams{24.f, 4.f, 64}));
+  std::vector<uint8_t> file = FontAtlasFile::encode(key, atlas);
+  FontAtlas read;
+  assert(FontAtlasFile::decode(file, key, read));
+  assert(read.pixels == atlas.pixels && read.width == atlas.width && read.height == atlas.height);
+  assert(read.glyph('O').x == atlas.glyph('O').x && read.glyph('I').top == atlas.glyph('I').top);
+  assert(!FontAtlasFile::decode(file, key + 1, read));
+  assert(!FontAtlasFile::decode(std::span(file).first(file.size() - 1), key, read));
+  file.back() ^= 1;
+  assert(!FontAtlasFile::decode(file, key, read));
+
+  // Built on the first call, read back on the second.
+  const auto dir = std::filesystem::temp_directory_path() / "blocco_test_font";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  const auto path = (dir / "synthetic.ttf").string();
+  {
+    std::ofstream f(path, std::ios::binary);
+    f.write(reinterpret_cast<const char*>(ttf.data()), static_cast<std::streamsize>(ttf.size()));
+  }
+  bool cached = true;
+  const FontAtlas first = loadOrBuildFontAtlas(path, (dir / "cache").string(), params, nullptr, &cached);
+  assert(!cached && first.pixels == atlas.pixels);
+  const FontAtlas second = loadOrBuildFontAtlas(path, (dir / "cache").string(), params, nullptr, &cached);
+  assert(cached && second.pixels == atlas.pixels && near(second.glyph('H').advance, 0.6f));
+  std::filesystem::remove_all(dir);
+}
+
+void testMalformed(const std::vector<uint8_t>& ttf){
+  auto rejects = [](std::span<const uint8_t> data){
+    try { buildFontAtlas(data); } catch(const std::runtime_error&){ return true; }
+    return false;
+  };
+  assert(rejects(std::span(ttf).first(100)));
+  std::vector<uint8_t> cff = ttf;
+  cff[0] = 'O'; cff[1] = 'T'; cff[2] = 'T'; cff[3] = 'O';
+  assert(rejects(cff));
+  assert(rejects({}));
+}
+}
+
+int main(){
+  const std::vector<uint8_t> ttf = syntheticFont();
+  testAtlas(ttf);
+  testCache(ttf);
+  testMalformed(ttf);
+  return 0;
+}
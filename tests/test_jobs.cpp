@@ -0,0 +1,70 @@
+#include "jobs.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iterator>
+#include <new>
+#include <numeric>
+#include <vector>
+int main(){
+  for(unsigned threads : {1u, 2u, 4u}){
+    JobSystem js(threads);
+    assert(js.threadCount()==threads && js.currentWorker()==0);
+
+    // parallelFor covers every index exactly once.
+    std::vector<int> hits(10000, 0);
+    js.parallelFor(0, hits.size(), 97, [&](size_t b, size_t e){ for(size_t i=b;i<e;++i) ++hits[i]; });
+    for(int h : hits) assert(h==1);
+
+    // Dependencies: stage B only starts after every stage A job has finished.
+    std::atomic<int> stageA{0};
+    std::atomic<bool> orderOk{true};
+    JobCounter a, b;
+    for(int i=0;i<64;++i) js.run([&]{ stageA.fetch_add(1); }, &a);
+    for(int i=0;i<16;++i) js.run([&]{ if(stageA.load()!=64) orderOk = false; }, &b, &a);
+    js.wait(b);
+    assert(a.done() && b.done() && orderOk.load());
+
+    // Nested submission from inside jobs (exercises local push + stealing).
+    std::atomic<long> sum{0};
+    JobCounter outer;
+    for(int i=0;i<32;++i){
+      js.run([&js, &sum, i]{
+        JobCounter inner;
+        for(int k=0;k<32;++k) js.run([&sum, i, k]{ sum.fetch_add(i*32+k); }, &inner);
+        js.wait(inner);
+      }, &outer);
+    }
+    js.wait(outer);
+    assert(sum.load() == 1024L*1023L/2L);
+
+    // A counter may be destroyed as soon as wait() returns: the storage is
+    // scribbled over and reused straight away while the last finish() could
+    // still be inside it (caught under -fsanitize=thread or address).
+    alignas(JobCounter) unsigned char storage[sizeof(JobCounter)];
+    for(int round=0; round<2000; ++round){
+      auto* c = new(storage) JobCounter;
+      std::atomic<int> ran{0};
+      for(int i=0;i<4;++i) js.run([&ran]{ ran.fetch_add(1); }, c);
+      js.wait(*c);
+      assert(ran.load() == 4);
+      c->~JobCounter();
+      std::fill(std::begin(storage), std::end(storage), static_cast<unsigned char>(0xAB));
+    }
+
+    // Background jobs never run inside wait(); background workers (or
+    // helpBackground on a single thread) drain them.
+    std::atomic<int> background{0};
+    JobCounter bg, fg;
+    for(int i=0;i<16;++i) js.runBackground([&]{ background.fetch_add(1); }, &bg);
+    if(threads == 1){
+      js.run([]{}, &fg);
+      js.wait(fg);
+      assert(background.load() == 0 && bg.pending() == 16);
+    }
+    while(!bg.done()) js.helpBackground(std::chrono::steady_clock::now() + std::chrono::milliseconds(1));
+    assert(background.load() == 16);
+  }
+  return 0;
+}
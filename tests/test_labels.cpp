@@ -0,0 +1,116 @@
+#include "hud.hpp"
+#include "labels.hpp"
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+namespace {
+bool near(float a, float b){ return std::abs(a - b) < 1e-3f; }
+
+// 32 px per em; every glyph a 16x24 texel rectangle, 'A' and 'B' at their own
+// places and the rest sharing one; ' ' is blank.
+FontAtlas testAtlas(){
+  FontAtlas a;
+  a.width = 256;
+  a.height = 128;
+  a.pixels.assign(size_t{a.width}*a.height, 0);
+  a.params.pixelSize = 32.f;
+  a.ascender = 0.75f;
+  a.descender = -0.25f;
+  auto set = [&](char c, uint16_t x){ a.glyphs[static_cast<size_t>(c - ' ')] = {x, 20, 16, 24, -0.125f, 0.625f, 0.5f}; };
+  for(char c='!'; c<='~'; ++c) set(c, 70);
+  set('A', 10);
+  set('B', 40);
+  a.glyphs[0].advance = 0.25f;
+  return a;
+}
+
+void testLayout(){
+  Labels labels(testAtlas());
+  assert(near(labels.measure("AB A", 20.f), 35.f));
+  assert(near(labels.measure("A\nAB", 20.f), 20.f));
+  assert(near(labels.lineHeight(10.f), 10.f));
+
+  // Screen text: the first line's top at y, glyph rectangles scaled from texels.
+  labels.text(10.f, 4.f, "A\nB", 32.f, 0xff0000ffu);
+  assert(labels.glyphCapacity() == 2);
+  std::vector<GlyphInstance> out(8);
+  assert(labels.build(identity(), 800.f, 600.f, out) == 2);
+  const GlyphInstance& a = out[0];
+  assert(near(a.x0, 10.f - 4.f) && near(a.y0, 4.f + 24.f - 20.f) && near(a.x1, 6.f + 16.f) && near(a.y1, 8.f + 24.f));
+  assert(a.u0 == 2560 && a.u1 == 6656 && a.v0 == 10240 && a.v1 == 22528 && a.color == 0xff0000ffu);
+  assert(near(out[1].y0, a.y0 + 32.f) && out[1].u0 == 10240);
+  // Screen text lasts one build.
+  assert(labels.glyphCapacity() == 0 && labels.build(identity(), 800.f, 600.f, out) == 0);
+}
+
+void testWorldLabels(){
+  Labels labels(testAtlas());
+  std::vector<GlyphInstance> out(16);
+  // With an identity view-projection the anchor is already in clip space.
+  const Labels::Id centre = labels.add({0.f, 0.f, 0.5f}, "A B", 16.f);
+  assert(labels.size() == 1 && labels.glyphCapacity() == 2);
+  assert(labels.build(identity(), 800.f, 600.f, out) == 2);
+  // "A B" is 1.25 em wide, centred: the pen starts at -0.625 em = -10 px.
+  assert(near(out[0].x0, 400.f - 10.f - 2.f) && near(out[0].y0, 300.f - 10.f) && near(out[0].y1, 300.f + 2.f));
+  assert(near(out[1].x0, 400.f - 10.f + 12.f - 2.f));
+
+  labels.add({0.f, 0.f, -0.5f}, "A");   // behind the camera
+  labels.add({3.f, 0.f, 0.5f}, "A");    // right of the viewport
+  labels.add({1.f, 0.f, 0.5f}, "AB");   // on the right edge, half visible
+  assert(labels.glyphCapacity() == 6 && labels.build(identity(), 800.f, 600.f, out) == 4);
+  // A label that no longer fits is left out whole.
+  assert(labels.build(identity(), 800.f, 600.f, std::span(out).first(3)) == 2);
+
+  labels.setPosition(centre, {0.f, 5.f, 0.5f});
+  assert(labels.build(identity(), 800.f, 600.f, out) == 2);
+}
+
+void testRemove(){
+  Labels labels(testAtlas());
+  std::vector<Labels::Id> ids;
+  for(int i=0;i<5000;++i) ids.push_back(labels.add({0.f, 0.f, 0.5f}, i % 2 ? "AB" : "A"));
+  assert(labels.glyphCapacity() == 7500);
+  // Removing most labels compacts their glyph runs away; the rest still draw.
+  for(int i=0;i<4000;++i) labels.remove(ids[static_cast<size_t>(i)]);
+  labels.remove(ids[0]); // twice: ignored
+  assert(labels.size() == 1000 && labels.glyphCapacity() == 1500);
+  std::vector<GlyphInstance> out(labels.glyphCapacity());
+  assert(labels.build(identity(), 800.f, 600.f, out) == 1500);
+  // Ids are reused and a moved label keeps its own position.
+  const Labels::Id reused = labels.add({0.f, 0.f, -1.f}, "B");
+  assert(reused < 4000);
+  labels.setPosition(ids[4999], {0.f, 0.f, -1.f});
+  assert(labels.build(identity(), 800.f, 600.f, out) == 1498);
+  labels.clear();
+  assert(labels.size() == 0 && labels.glyphCapacity() == 0);
+}
+
+void testHud(){
+  Hud hud;
+  assert(hud.summary().frames == 0);
+  for(int i=0;i<200;++i){
+    const double cpu = i % 100 == 99 ? 10.0 : 2.0; // spikes at 99 and 199, both in the window
+    hud.addFrame(16.0, cpu, i < 190 ? -1.0 : 1.5, 42, 900);
+  }
+  const Hud::Summary s = hud.summary();
+  assert(s.frames == Hud::FRAMES && s.draws == 42 && s.glyphs == 900);
+  assert(std::abs(s.fps - 62.5) < 1e-9);
+  assert(std::abs(s.cpuAvg - (2.0*118 + 2*10.0)/120.0) < 1e-9 && s.cpuP99 == 10.0);
+  assert(s.gpuAvg == 1.5 && s.gpuP99 == 1.5);
+
+  Labels labels(testAtlas());
+  hud.draw(labels, 8.f, 8.f, 16.f);
+  std::vector<GlyphInstance> out(labels.glyphCapacity());
+  assert(labels.build(identity(), 800.f, 600.f, out) == out.size() && !out.empty());
+  assert(near(out.front().y0, 8.f + 2.f) && out.back().y0 > 8.f + 3.f*16.f); // four lines
+}
+}
+
+int main(){
+  testLayout();
+  testWorldLabels();
+  testRemove();
+  testHud();
+  return 0;
+}
@@ -0,0 +1,176 @@
+#include "lod.hpp"
+#include "mesher.hpp"
+#include "terrain.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+const TerrainParams TERRAIN{7, 8, 40, 64};
+
+// Highest solid cell + 1 of a column, or 0.
+int columnTop(const Chunk& c, int x, int z){
+  for(int y=Chunk::SIZE-1;y>=0;--y) if(c.get(x, y, z) != BLOCK_AIR) return y + 1;
+  return 0;
+}
+
+void testTiles(){
+  const LodTile t = LodTile::of({-3, 5, 9}, 2);
+  assert((t.coord == ChunkCoord{-1, 1, 2}) && t.chunks() == 4);
+  assert((t.firstChunk() == ChunkCoord{-4, 4, 8}));
+  assert(t.contains({-3, 5, 9}) && t.contains({-1, 7, 11}) && !t.contains({0, 5, 9}));
+  assert((t.parent() == LodTile{{-1, 0, 1}, 3}));
+  for(int i=0;i<8;++i){
+    const LodTile c = t.child(i);
+    assert(c.level == 1 && c.parent() == t);
+  }
+  assert((t.child(5) == LodTile{{-1, 2, 5}, 1}));
+  // The transform scales cells to blocks and puts cell 0 at the first chunk.
+  const Mat4 m = t.transform();
+  assert(m.m[0] == 4.f && m.m[5] == 4.f && m.m[10] == 4.f && m.m[15] == 1.f);
+  assert(m.m[12] == -128.f && m.m[13] == 128.f && m.m[14] == 256.f);
+}
+
+void testDownsample(){
+  std::array<Chunk, 8> children;
+  std::array<const Chunk*, 8> in{};
+  for(int i=0;i<8;++i) in[static_cast<size_t>(i)] = &children[static_cast<size_t>(i)];
+  Chunk out(BLOCK_STONE);
+  downsample(in, out);
+  assert(out.empty());
+  // Majority: three of a cell's eight blocks are not enough, four are.
+  Chunk& c0 = children[0];
+  c0.set(0, 0, 0, 1); c0.set(1, 0, 0, 1); c0.set(0, 0, 1, 1);
+  c0.fillRegion(2, 0, 0, 4, 1, 2, 3);
+  // A grass layer on stone keeps its grass on top whichever layer holds it.
+  c0.fillRegion(4, 0, 0, 6, 1, 2, BLOCK_STONE); c0.fillRegion(4, 1, 0, 6, 2, 2, BLOCK_GRASS);
+  c0.fillRegion(6, 0, 0, 8, 1, 2, BLOCK_GRASS);
+  // Inside a chunk: halves of 2x2x2 blocks land on the matching cell.
+  Chunk& c7 = children[7];
+  c7.fillRegion(30, 30, 30, 32, 32, 32, 5);
+  downsample(in, out);
+  assert(out.get(0, 0, 0) == BLOCK_AIR);
+  assert(out.get(1, 0, 0) == 3);
+  assert(out.get(2, 0, 0) == BLOCK_GRASS && out.get(3, 0, 0) == BLOCK_GRASS);
+  assert(out.get(31, 31, 31) == 5);
+  int solid = 0;
+  for(int y=0;y<Chunk::SIZE;++y) for(int z=0;z<Chunk::SIZE;++z) for(int x=0;x<Chunk::SIZE;++x) solid += out.get(x, y, z) != BLOCK_AIR;
+  assert(solid == 4);
+  // Uniform and missing children halve to themselves.
+  in = {&children[0], nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr};
+  Chunk stone(BLOCK_STONE);
+  for(size_t i=1;i<8;++i) in[i] = i % 2 ? &stone : nullptr;
+  downsample(in, out);
+  assert(out.get(16, 0, 0) == BLOCK_STONE && out.get(0, 16, 0) == BLOCK_AIR && out.get(16, 16, 16) == BLOCK_STONE);
+  for(size_t i=0;i<8;++i) in[i] = &stone;
+  downsample(in, out);
+  assert(out.uniform() && out.get(0, 0, 0) == BLOCK_STONE);
+}
+
+// Column-sampled terrain tiles match the tiles built by generating and halving
+// every chunk at level 1 and stay within a cell of them further up (where
+// repeated halving rounds half-full cells up more than once), with grass on
+// top in both.
+void testTerrain(){
+  auto generator = [](const ChunkCoord& c, Chunk& out){ generateTerrain(TERRAIN, c, out); };
+  Chunk direct, built;
+  generateTerrainLod(TERRAIN, {{1, 0, -2}, 0}, direct);
+  generateTerrain(TERRAIN, {1, 0, -2}, built);
+  for(int i=0;i<Chunk::VOLUME;++i) assert(direct.at(i) == built.at(i));
+  for(int level=1;level<=3;++level){
+    for(const ChunkCoord c : {ChunkCoord{0, 0, 0}, ChunkCoord{-1, 0, 1}, ChunkCoord{0, -1, 0}}){
+      const LodTile t{c, static_cast<uint8_t>(level)};
+      generateTerrainLod(TERRAIN, t, direct);
+      buildLodTile(generator, t, built);
+      assert(direct.empty() == built.empty());
+      if(c.y < 0){ assert(direct.uniform() && direct.get(0, 0, 0) == BLOCK_STONE); continue; }
+      for(int z=0;z<Chunk::SIZE;++z) for(int x=0;x<Chunk::SIZE;++x){
+        const int a = columnTop(direct, x, z), b = columnTop(built, x, z);
+        assert(level == 1 ? a == b : a == b || a + 1 == b);
+        if(a > 0) assert(direct.get(x, a - 1, z) == BLOCK_GRASS);
+        if(b > 0) assert(built.get(x, b - 1, z) == BLOCK_GRASS);
+      }
+      if(level == 1) for(int i=0;i<Chunk::VOLUME;++i) assert(direct.at(i) == built.at(i));
+    }
+  }
+}
+
+// The cut covers every chunk in view exactly once, at levels that grow with
+// distance and agree with level().
+void testSelection(){
+  for(int levels : {0, 1, 3}){
+    const Vec3 eye{40.f, 50.f, -70.f};
+    const LodSelection sel(eye, 4, 2, levels);
+    assert(sel.viewRadius() == static_cast<float>(4 << levels));
+    std::vector<LodTile> cut;
+    sel.select(cut);
+    std::unordered_map<ChunkCoord, int, ChunkCoordHash> covered;
+    for(const LodTile& t : cut){
+      assert(sel.selected(t) && !sel.split(t));
+      assert(t.level == 0 || sel.distance(t) >= 4.f * static_cast<float>(1 << t.level) * 0.5f);
+      const ChunkCoord f = t.firstChunk();
+      for(int y=0;y<t.chunks();++y) for(int z=0;z<t.chunks();++z) for(int x=0;x<t.chunks();++x){
+        const ChunkCoord c{f.x + x, f.y + y, f.z + z};
+        assert(++covered[c] == 1);
+        assert(sel.level(c) == t.level);
+      }
+    }
+    // Everything near enough (vertically: within the band) is covered.
+    const ChunkCoord e = Scene::chunkOf(40, 50, -70);
+    const int reach = static_cast<int>(sel.viewRadius()) - 2;
+    for(int dy=-2;dy<=2;++dy) for(int dz=-reach;dz<=reach;++dz) for(int dx=-reach;dx<=reach;++dx){
+      if(dx*dx + dz*dz > reach*reach) continue;
+      const ChunkCoord c{e.x + dx, e.y + dy, e.z + dz};
+      assert(covered.contains(c));
+    }
+    if(levels == 0) assert(cut.size() == covered.size());
+    assert(sel.level({e.x + 4*(8 << levels), e.y, e.z}) == -1);
+  }
+  // Slack keeps tiles on both sides of the cut.
+  const LodSelection sel({-32.f, 0.f, 0.f}, 4, 2, 2);
+  const LodTile near{{1, 0, 0}, 1}; // 3 chunks away: split under 4
+  assert(sel.split(near) && !sel.selected(near) && sel.selected(near, 1.5f));
+}
+
+// A tile meshed on its own keeps its side faces: solid ground ends in a wall.
+void testSkirts(){
+  Chunk ground;
+  ground.fillRegion(0, 0, 0, Chunk::SIZE, 10, Chunk::SIZE, BLOCK_STONE);
+  ChunkMesher mesher;
+  MeshBuffers m;
+  m.format = VertexFormat::Packed;
+  mesher.mesh(ChunkNeighbourhood{&ground, {}}, m);
+  int faces[6] = {};
+  for(size_t q=0;q<m.quadCount();++q) ++faces[m.packed[q*4].face()];
+  for(int f : faces) assert(f == 1);
+}
+
+// Tiles mesh without occlusion: a bump on the ground no longer splits the
+// ground's top into AO bands, and every corner reads as open.
+void testTileOcclusion(){
+  Chunk ground;
+  ground.fillRegion(0, 0, 0, Chunk::SIZE, 10, Chunk::SIZE, BLOCK_STONE);
+  ground.fillRegion(12, 10, 12, 20, 12, 20, BLOCK_STONE);
+  ChunkMesher mesher;
+  MeshBuffers lit, flat;
+  lit.format = flat.format = VertexFormat::Packed;
+  const size_t litQuads = mesher.mesh(ChunkNeighbourhood{&ground, {}}, lit).quads;
+  mesher.setOcclusion(false);
+  const size_t flatQuads = mesher.mesh(ChunkNeighbourhood{&ground, {}}, flat).quads;
+  assert(flatQuads < litQuads && flatQuads == flat.quadCount());
+  for(const PackedVertex& v : flat.packed) assert(v.ao() == 3);
+}
+}
+
+int main(){
+  testTiles();
+  testDownsample();
+  testTerrain();
+  testSelection();
+  testSkirts();
+  testTileOcclusion();
+  return 0;
+}
@@ -0,0 +1,156 @@
+#include "logging.hpp"
+#include <cassert>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+struct Captured {
+  std::mutex lock;
+  std::vector<Log::Message> messages;
+  std::atomic<bool> blocked{false}; // writer is waiting in write()
+  std::atomic<bool> gate{false};    // write() waits while set
+};
+
+class CaptureSink final : public Log::Sink {
+public:
+  explicit CaptureSink(Captured& out) : m_out(out) {}
+  void write(const Log::Entry& e) override {
+    while(m_out.gate.load()){ m_out.blocked = true; std::this_thread::yield(); }
+    m_out.blocked = false;
+    std::lock_guard lk(m_out.lock);
+    m_out.messages.push_back({e.level, e.thread, e.timeNs, std::string(e.text)});
+  }
+private:
+  Captured& m_out;
+};
+
+std::vector<std::string> texts(Captured& c){
+  Log::flush();
+  std::lock_guard lk(c.lock);
+  std::vector<std::string> out;
+  for(const Log::Message& m : c.messages) out.push_back(m.text);
+  c.messages.clear();
+  return out;
+}
+
+static_assert(Log::detail::placeholders("{} {:.3f} {{}} {:08x}") == 3);
+static_assert(Log::detail::placeholders("{") == -1 && Log::detail::placeholders("}") == -1 && Log::detail::placeholders("{:.}") == -1);
+
+void testFormatting(Captured& c){
+  Log::info("plain");
+  Log::info("{} {} {}", 42, -7, 3u);
+  Log::info("{:.3f} {:08.2f} {} {}", 1.23456, -3.14159, 0.1, 2.5f);
+  Log::info("{:x} {:X} {:04x}", 255, 255u, 10);
+  Log::info("{} {} {} {}", true, 'c', std::string("str"), std::string_view("view"));
+  const char* none = nullptr;
+  Log::info("{{{}}} [{:6}] {}", "x", "ab", none);
+  const std::string longText(1000, 'z');
+  Log::warn("long {} end", longText);
+  Log::log(Log::Level::Error, "runtime level {}", 7);
+  const std::vector<std::string> t = texts(c);
+  assert(t.size() == 8);
+  assert(t[0] == "plain");
+  assert(t[1] == "42 -7 3");
+  assert(t[2] == "1.235 -0003.14 0.1 2.5");
+  assert(t[3] == "ff FF 000a");
+  assert(t[4] == "true c str view");
+  assert(t[5] == "{x} [ab    ] (null)");
+  assert(t[6] == "long " + longText + " end");
+  assert(t[7] == "runtime level 7");
+
+  // Below BLOCCO_LOG_LEVEL: compiled out, or filtered for a run-time level.
+  Log::trace("trace {}", 1);
+  Log::debug("debug {}", 2);
+  Log::log(Log::Level::Trace, "run-time trace");
+  const size_t below = (Log::MIN_LEVEL <= Log::Level::Trace ? 2 : 0) + (Log::MIN_LEVEL <= Log::Level::Debug ? 1 : 0);
+  assert(texts(c).size() == below);
+}
+
+// Each thread's messages arrive complete and in order.
+void testThreads(Captured& c){
+  const uint64_t dropped = Log::stats().dropped;
+  constexpr int THREADS = 4, EACH = 1500;
+  std::vector<std::thread> threads;
+  for(int t=0;t<THREADS;++t){
+    threads.emplace_back([t]{ for(int i=0;i<EACH;++i) Log::info("{} {}", t, i); });
+  }
+  for(std::thread& th : threads) th.join();
+  const std::vector<std::string> t = texts(c);
+  assert(t.size() == size_t{THREADS} * EACH && Log::stats().dropped == dropped);
+  int next[THREADS]{};
+  for(const std::string& s : t){
+    const int thread = s[0] - '0';
+    assert(std::stoi(s.substr(2)) == next[thread]);
+    ++next[thread];
+  }
+}
+
+// With the writer stuck in a sink, the queue fills and drops instead of blocking.
+void testDrops(Captured& c){
+  const uint64_t dropped = Log::stats().dropped;
+  c.gate = true;
+  Log::info("first");
+  while(!c.blocked) std::this_thread::yield();
+  for(int i=0;i<20000;++i) Log::info("flood {}", i);
+  const uint64_t lost = Log::stats().dropped - dropped;
+  assert(lost > 0);
+  c.gate = false;
+  const std::vector<std::string> t = texts(c);
+  assert(t.size() == 20000 - lost + 2);
+  assert(t.back() == "log queue full, " + std::to_string(lost) + " messages dropped");
+}
+
+void testBinary(Captured& c){
+  const auto path = std::filesystem::temp_directory_path() / "blocco_test_log.bin";
+  Log::addSink(std::make_unique<Log::BinaryFileSink>(path.string()));
+  for(int i=0;i<3;++i) Log::info("step {} of {:.1f}", i, 2.5);
+  Log::error("failed: {}", "disk full");
+  Log::clearSinks(); // closes the file
+  Log::addSink(std::make_unique<CaptureSink>(c));
+  std::vector<Log::Message> read;
+  assert(Log::readBinary(path.string(), [&](const Log::Message& m){ read.push_back(m); }));
+  assert(read.size() == 4);
+  assert(read[0].text == "step 0 of 2.5" && read[2].text == "step 2 of 2.5" && read[0].level == Log::Level::Info);
+  assert(read[3].text == "failed: disk full" && read[3].level == Log::Level::Error);
+  assert(read[1].timeNs >= read[0].timeNs && read[0].thread == read[3].thread);
+  // The format string is stored once, so the repeats are small.
+  const auto size = std::filesystem::file_size(path);
+  assert(size < 4 + (1 + 4 + 4 + 16) + 2*(1 + 4 + 4 + 12) + 4*(1 + 4 + 1 + 4 + 8 + 4 + 18));
+  std::filesystem::resize_file(path, size - 3);
+  size_t partial = 0;
+  assert(!Log::readBinary(path.string(), [&](const Log::Message&){ ++partial; }) && partial == 3);
+  std::filesystem::remove(path);
+}
+
+void testRateLimiter(){
+  using namespace std::chrono;
+  Log::RateLimiter limiter(3, seconds(1));
+  const steady_clock::time_point t0{seconds(100)};
+  for(int i=0;i<3;++i) assert(limiter.admit(7, t0) == 0u);
+  assert(!limiter.admit(7, t0) && !limiter.admit(7, t0 + milliseconds(500)));
+  assert(limiter.admit(8, t0) == 0u);
+  // A new window lets the key through again and reports what was held back.
+  assert(limiter.admit(7, t0 + seconds(1)) == 2u);
+  assert(limiter.admit(7, t0 + seconds(1)) == 0u);
+  assert(limiter.suppressed() == 2);
+}
+}
+
+int main(){
+  testRateLimiter();
+  // The rest logs at info and above.
+  if constexpr(Log::MIN_LEVEL > Log::Level::Info) return 0;
+  Captured captured;
+  Log::clearSinks();
+  Log::addSink(std::make_unique<CaptureSink>(captured));
+  testFormatting(captured);
+  testThreads(captured);
+  testDrops(captured);
+  testBinary(captured);
+  Log::clearSinks(); // the capture sink goes out of scope
+  return 0;
+}
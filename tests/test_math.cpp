@@ -1,9 +1,83 @@
 #include "math.hpp"
 #include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static int64_t ulpDiff(float a, float b){
+  int32_t ia, ib;
+  std::memcpy(&ia, &a, 4); std::memcpy(&ib, &b, 4);
+  if(ia < 0) ia = INT32_MIN - ia;
+  if(ib < 0) ib = INT32_MIN - ib;
+  return std::llabs(static_cast<int64_t>(ia) - static_cast<int64_t>(ib));
+}
+static bool near(const Mat4& a, const Mat4& b, int64_t ulps, float absTol){
+  for(int i=0;i<16;++i)
+    if(ulpDiff(a.m[i], b.m[i]) > ulps && std::fabs(a.m[i]-b.m[i]) > absTol) return false;
+  return true;
+}
+
+// Evaluated entirely at compile time through the scalar path.
+constexpr Mat4 kTwoTranslations = translate({1,2,3}) * translate({4,5,6});
+static_assert(kTwoTranslations.m[12]==5 && kTwoTranslations.m[13]==7 && kTwoTranslations.m[14]==9);
+static_assert(inverse(translate({1,2,3})).m[12]==-1);
+
 int main(){
   Vec3 a{1,2,3}, b{4,5,6};
   auto c = a + b;
   assert(c.x==5 && c.y==7 && c.z==9);
   assert(static_cast<int>(length(Vec3{3,4,0}))==5);
+  assert(dot(cross(a,b), a)==0.f);
+
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<float> val(-2.f, 2.f);
+  for(int iter=0; iter<1000; ++iter){
+    Mat4 m, n;
+    for(int i=0;i<16;++i){ m.m[i] = val(rng); n.m[i] = val(rng); }
+    // Dispatched (SIMD where compiled in) vs scalar reference.
+    assert(near(m*n, math_scalar::mul(m,n), 4, 1e-5f));
+    const Vec4 v{val(rng), val(rng), val(rng), 1.f};
+    const Vec4 r = m*v, rs = math_scalar::mul(m,v);
+    assert(ulpDiff(r.x,rs.x)<=4 || std::fabs(r.x-rs.x)<1e-5f);
+    assert(ulpDiff(r.w,rs.w)<=4 || std::fabs(r.w-rs.w)<1e-5f);
+    // Well-conditioned matrix: diagonally dominant.
+    for(int k=0;k<4;++k) m.m[k*5] += 8.f;
+    const Mat4 inv = inverse(m), invRef = math_scalar::inverse(m);
+    assert(near(inv, invRef, 64, 1e-6f));
+    assert(near(m*inv, identity(), 64, 1e-5f));
+  }
+  assert(near(inverse(Mat4{}), Mat4{}, 0, 0.f));
+
+  // Camera helpers: a point in front of the camera lands inside the Vulkan clip volume.
+  const Mat4 view = lookAt({0,0,5}, {0,0,0}, {0,1,0});
+  const Mat4 proj = perspective(1.0f, 16.f/9.f, 0.1f, 100.f);
+  const Vec4 clip = (proj*view) * Vec4{0,1,0,1};
+  const float ndcY = clip.y/clip.w, ndcZ = clip.z/clip.w;
+  assert(clip.w > 0.f && ndcY < 0.f && ndcZ > 0.f && ndcZ < 1.f);
+
+  // Batch kernels: odd counts exercise the vector body and the scalar tail.
+  const size_t N = 1027;
+  std::vector<float> x(N), y(N), z(N), ox(N), oy(N), oz(N), sx(N), sy(N), sz(N);
+  for(size_t i=0;i<N;++i){ x[i]=val(rng)*50.f; y[i]=val(rng)*50.f; z[i]=val(rng)*50.f; }
+  const Mat4 vp = proj*view;
+  transformPoints(vp, x.data(), y.data(), z.data(), ox.data(), oy.data(), oz.data(), N);
+  math_scalar::transformPoints(vp, x.data(), y.data(), z.data(), sx.data(), sy.data(), sz.data(), N);
+  for(size_t i=0;i<N;++i) assert(ox[i]==sx[i] && oy[i]==sy[i] && oz[i]==sz[i]);
+
+  const Frustum f = extractFrustum(vp);
+  std::vector<float> maxX(N), maxY(N), maxZ(N);
+  for(size_t i=0;i<N;++i){ maxX[i]=x[i]+1.f; maxY[i]=y[i]+2.f; maxZ[i]=z[i]+1.f; }
+  std::vector<uint8_t> vis(N), visRef(N);
+  const size_t nv = cullAabbs(f, x.data(), y.data(), z.data(), maxX.data(), maxY.data(), maxZ.data(), vis.data(), N);
+  const size_t nvRef = math_scalar::cullAabbs(f, x.data(), y.data(), z.data(), maxX.data(), maxY.data(), maxZ.data(), visRef.data(), N);
+  assert(nv == nvRef && vis == visRef && nv > 0 && nv < N);
+  // A box around the look target is visible, one behind the camera is not.
+  const float bx0[] = {-0.5f, -0.5f}, by0[] = {-0.5f, -0.5f}, bz0[] = {-0.5f, 8.f};
+  const float bx1[] = {0.5f, 0.5f}, by1[] = {0.5f, 0.5f}, bz1[] = {0.5f, 9.f};
+  uint8_t two[2];
+  cullAabbs(f, bx0, by0, bz0, bx1, by1, bz1, two, 2);
+  assert(two[0]==1 && two[1]==0);
   return 0;
 }
@@ -0,0 +1,176 @@
+#include "memory.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+void testTlsfBasics(){
+  TlsfAllocator tlsf(1 << 20);
+  auto a = tlsf.allocate(100);
+  assert(a.valid() && a.offset == 0 && a.size == 112);
+  auto b = tlsf.allocate(4096, 4096);
+  assert(b.valid() && b.offset % 4096 == 0);
+  assert(tlsf.allocate(uint64_t{2} << 20).valid() == false);
+  tlsf.free(a);
+  tlsf.free(b);
+  assert(tlsf.empty());
+  const MemoryStats s = tlsf.stats();
+  assert(s.inUse == 0 && s.largestFree == (1u << 20) && s.fragmentation == 0.f);
+  assert(s.peak >= 112 + 4096);
+  // Whole range is one block again after coalescing.
+  auto all = tlsf.allocate(1 << 20);
+  assert(all.valid() && all.offset == 0);
+  tlsf.free(all);
+}
+
+void testTlsfRandom(){
+  constexpr uint64_t CAP = uint64_t{16} << 20;
+  TlsfAllocator tlsf(CAP);
+  std::mt19937 rng(7);
+  std::vector<TlsfAllocation> live;
+  for(int i=0;i<20000;++i){
+    if(live.empty() || rng() % 3 != 0){
+      const uint64_t size = 1 + rng() % 65536;
+      const uint64_t align = uint64_t{1} << (rng() % 9);
+      auto a = tlsf.allocate(size, align);
+      if(!a.valid()) continue;
+      assert(a.size >= size && a.offset % std::max<uint64_t>(align, TlsfAllocator::GRANULARITY) == 0);
+      assert(a.offset + a.size <= CAP);
+      live.push_back(a);
+    } else {
+      const size_t k = rng() % live.size();
+      tlsf.free(live[k]);
+      live[k] = live.back();
+      live.pop_back();
+    }
+    if(i % 1000 == 0){
+      auto sorted = live;
+      std::sort(sorted.begin(), sorted.end(), [](auto& x, auto& y){ return x.offset < y.offset; });
+      uint64_t used = 0;
+      for(size_t k=0;k<sorted.size();++k){
+        if(k) assert(sorted[k-1].offset + sorted[k-1].size <= sorted[k].offset);
+        used += sorted[k].size;
+      }
+      const MemoryStats s = tlsf.stats();
+      assert(s.inUse == used && s.allocations == live.size());
+      assert(s.largestFree <= CAP - used && s.fragmentation >= 0.f && s.fragmentation <= 1.f);
+    }
+  }
+  for(auto& a : live) tlsf.free(a);
+  assert(tlsf.empty() && tlsf.stats().largestFree == CAP);
+}
+
+void testArena(){
+  FrameArena arena(1024);
+  auto* a = static_cast<std::byte*>(arena.allocate(10, 1));
+  auto* b = static_cast<std::byte*>(arena.allocate(8, 64));
+  assert(reinterpret_cast<uintptr_t>(b) % 64 == 0 && b >= a + 10);
+  auto ints = arena.allocate<uint32_t>(16);
+  assert(ints.size() == 16 && reinterpret_cast<uintptr_t>(ints.data()) % alignof(uint32_t) == 0);
+  // Overflow spills to the heap, then the arena grows at reset.
+  auto big = arena.allocate<uint8_t>(4000);
+  std::memset(big.data(), 0xAB, big.size());
+  MemoryStats s = arena.stats();
+  assert(s.inUse >= 4000 + 10 + 8 && s.allocations == 4);
+  arena.reset();
+  s = arena.stats();
+  assert(s.inUse == 0 && s.allocations == 0 && s.peak >= 4018 && s.capacity >= s.peak);
+  auto again = arena.allocate<uint8_t>(4000);
+  assert(arena.stats().capacity == s.capacity && again.data() != nullptr);
+}
+
+void testArenaThreads(){
+  FrameArena arena(1 << 16);
+  constexpr int THREADS = 4, PER = 2000;
+  std::vector<std::vector<uint64_t*>> ptrs(THREADS);
+  std::vector<std::thread> workers;
+  for(int t=0;t<THREADS;++t){
+    workers.emplace_back([&, t]{
+      for(int i=0;i<PER;++i){
+        auto* p = arena.allocate<uint64_t>(2).data();
+        p[0] = static_cast<uint64_t>(t); p[1] = static_cast<uint64_t>(i);
+        ptrs[static_cast<size_t>(t)].push_back(p);
+      }
+    });
+  }
+  for(auto& w : workers) w.join();
+  for(int t=0;t<THREADS;++t)
+    for(int i=0;i<PER;++i){
+      const uint64_t* p = ptrs[static_cast<size_t>(t)][static_cast<size_t>(i)];
+      assert(p[0] == static_cast<uint64_t>(t) && p[1] == static_cast<uint64_t>(i));
+    }
+  assert(arena.stats().allocations == THREADS*PER);
+  arena.reset();
+}
+
+void testStagingRing(){
+  StagingRing ring(1024);
+  assert(ring.allocate(2048, 16, 1) == StagingRing::NONE);
+  assert(ring.allocate(400, 16, 1) == 0);
+  assert(ring.allocate(100, 256, 2) == 512);
+  assert(ring.allocate(300, 16, 2) == 624);
+  // 100 bytes left at the end and nothing reclaimed at the front.
+  assert(ring.allocate(200, 16, 3) == StagingRing::NONE);
+  ring.reclaim(1);
+  assert(ring.oldestBatch() == 2);
+  // Skips the tail and wraps to 0, ending at most at the oldest live span.
+  assert(ring.allocate(300, 16, 3) == 0);
+  assert(ring.allocate(200, 16, 3) == StagingRing::NONE);
+  assert(ring.allocate(96, 16, 3) == 304);
+  MemoryStats s = ring.stats();
+  assert(s.inUse == 1024 && s.largestFree == 0);
+  ring.reclaim(2);
+  s = ring.stats();
+  assert(s.inUse == 500 && s.largestFree == 524); // the skipped tail stays charged to batch 3
+  ring.reclaim(3);
+  assert(ring.empty() && ring.stats().inUse == 0 && ring.stats().peak == 1024);
+  assert(ring.allocate(1024, 16, 4) == 0);
+}
+
+void testStagingRingRandom(){
+  // Live ranges never overlap; reclaiming frees exactly the batches at or below the value.
+  constexpr uint64_t CAP = 1 << 16;
+  StagingRing ring(CAP);
+  std::mt19937 rng(11);
+  struct Live { uint64_t offset, size, batch; };
+  std::vector<Live> live;
+  uint64_t batch = 1, reclaimed = 0;
+  for(int i=0;i<20000;++i){
+    if(rng() % 8 == 0) ++batch;
+    const uint64_t size = 1 + rng() % 8192;
+    const uint64_t align = uint64_t{1} << (rng() % 8);
+    const uint64_t off = ring.allocate(size, align, batch);
+    if(off == StagingRing::NONE){
+      assert(!ring.empty());
+      const uint64_t completed = ring.oldestBatch();
+      ring.reclaim(completed);
+      std::erase_if(live, [&](const Live& l){ return l.batch <= completed; });
+      ++reclaimed;
+      continue;
+    }
+    assert(off % align == 0 && off + size <= CAP);
+    for(const Live& l : live) assert(off + size <= l.offset || l.offset + l.size <= off);
+    live.push_back({off, size, batch});
+    uint64_t used = 0;
+    for(const Live& l : live) used += l.size;
+    assert(ring.stats().inUse >= used && ring.stats().inUse <= CAP);
+  }
+  assert(reclaimed > 0);
+  ring.reclaim(batch);
+  assert(ring.empty());
+}
+}
+
+int main(){
+  testTlsfBasics();
+  testTlsfRandom();
+  testArena();
+  testArenaThreads();
+  testStagingRing();
+  testStagingRingRandom();
+  return 0;
+}
@@ -0,0 +1,172 @@
+#include "mesher.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <random>
+#include <unordered_map>
+#include <utility>
+
+// Brute-force reference: count every exposed unit face per (block, normal).
+static std::map<std::pair<BlockId,int>, long> referenceFaces(const Scene& s, const ChunkCoord& c){
+  std::map<std::pair<BlockId,int>, long> faces;
+  const int dirs[6][3] = {{-1,0,0},{1,0,0},{0,-1,0},{0,1,0},{0,0,-1},{0,0,1}};
+  for(int y=0;y<Chunk::SIZE;++y) for(int z=0;z<Chunk::SIZE;++z) for(int x=0;x<Chunk::SIZE;++x){
+    const int wx = c.x*Chunk::SIZE+x, wy = c.y*Chunk::SIZE+y, wz = c.z*Chunk::SIZE+z;
+    const BlockId b = s.getBlock(wx,wy,wz);
+    if(b == BLOCK_AIR) continue;
+    for(int f=0;f<6;++f)
+      if(s.getBlock(wx+dirs[f][0], wy+dirs[f][1], wz+dirs[f][2]) == BLOCK_AIR) ++faces[{b,f}];
+  }
+  return faces;
+}
+
+// Area covered by the greedy mesh, bucketed the same way. The block id is
+// recovered by sampling the block just behind the quad centre.
+static std::map<std::pair<BlockId,int>, long> meshFaces(const Scene& s, const ChunkCoord& c, const MeshBuffers& m){
+  std::map<std::pair<BlockId,int>, long> faces;
+  for(size_t q=0;q<m.quadCount();++q){
+    const Vertex* v = &m.vertices[q*4];
+    int d = 0; while(v[0].normal[d] == 0.f) ++d;
+    const int sign = v[0].normal[d] > 0.f ? 1 : -1;
+    const int u = (d+1)%3, w = (d+2)%3;
+    float umin=1e9f, umax=-1e9f, vmin=1e9f, vmax=-1e9f;
+    for(int k=0;k<4;++k){
+      umin = std::fmin(umin, v[k].pos[u]); umax = std::fmax(umax, v[k].pos[u]);
+      vmin = std::fmin(vmin, v[k].pos[w]); vmax = std::fmax(vmax, v[k].pos[w]);
+    }
+    float centre[3];
+    centre[d] = v[0].pos[d] - 0.5f*static_cast<float>(sign);
+    centre[u] = 0.5f*(umin+umax); centre[w] = 0.5f*(vmin+vmax);
+    const int local[3] = {static_cast<int>(std::floor(centre[0])), static_cast<int>(std::floor(centre[1])), static_cast<int>(std::floor(centre[2]))};
+    const BlockId b = s.getBlock(c.x*Chunk::SIZE+local[0], c.y*Chunk::SIZE+local[1], c.z*Chunk::SIZE+local[2]);
+    faces[{b, d*2 + (sign>0)}] += static_cast<long>((umax-umin)*(vmax-vmin));
+  }
+  return faces;
+}
+
+static long total(const std::map<std::pair<BlockId,int>, long>& m){ long t=0; for(const auto& [k,v] : m) t+=v; return t; }
+
+int main(){
+  Scene s;
+  std::mt19937 rng(42);
+  // Terrain-like content with a few block types, spilling into neighbours.
+  for(int x=-8;x<40;++x) for(int z=-8;z<40;++z){
+    const int h = 6 + static_cast<int>(rng()%10);
+    s.fill({x,-4,z},{x+1,h,z+1}, static_cast<BlockId>(1 + (x/8+z/8)%3));
+  }
+  for(int i=0;i<500;++i) s.setBlock(static_cast<int>(rng()%32), static_cast<int>(rng()%32), static_cast<int>(rng()%32), static_cast<BlockId>(rng()%4));
+
+  ChunkMesher mesher;
+  MeshBuffers greedy, naive;
+  for(const ChunkCoord c : {ChunkCoord{0,0,0}, ChunkCoord{-1,0,0}, ChunkCoord{0,-1,0}}){
+    const auto ref = referenceFaces(s, c);
+    const MesherStats st = mesher.mesh(s, c, greedy);
+    assert(st.quads == greedy.quadCount());
+    assert(greedy.indices.size() == st.quads*6);
+    assert(meshFaces(s, c, greedy) == ref);
+    assert(st.quads <= static_cast<size_t>(total(ref)));
+    mesher.meshNaive(s, c, naive);
+    assert(greedy.quadCount() < naive.quadCount());
+  }
+
+  // A solid chunk surrounded by air collapses to six quads.
+  Scene cube; cube.fill({0,0,0},{32,32,32},1);
+  mesher.mesh(cube, {0,0,0}, greedy);
+  assert(greedy.quadCount() == 6);
+  // Fully enclosed by solid neighbours: nothing visible.
+  cube.fill({-32,-32,-32},{64,64,64},1);
+  mesher.mesh(cube, {0,0,0}, greedy);
+  assert(greedy.quadCount() == 0);
+
+  // The packed layout describes exactly the float mesh: same quads, positions,
+  // normals and UVs once decoded, and no indices.
+  MeshBuffers packed; packed.format = VertexFormat::Packed;
+  for(const ChunkCoord c : {ChunkCoord{0,0,0}, ChunkCoord{-1,0,0}}){
+    mesher.mesh(s, c, greedy);
+    mesher.mesh(s, c, packed);
+    assert(packed.quadCount() == greedy.quadCount() && packed.indices.empty() && packed.vertices.empty());
+    assert(packed.bytes() == packed.quadCount()*4*sizeof(PackedVertex) && greedy.bytes() == greedy.quadCount()*(4*sizeof(Vertex) + 6*sizeof(uint32_t)));
+    for(size_t i=0;i<packed.packed.size();++i){
+      const PackedVertex& p = packed.packed[i];
+      const Vertex& f = greedy.vertices[i];
+      assert(static_cast<float>(p.x()) == f.pos[0] && static_cast<float>(p.y()) == f.pos[1] && static_cast<float>(p.z()) == f.pos[2]);
+      const uint32_t d = p.face()/2;
+      assert(f.normal[d] == ((p.face() & 1u) ? 1.f : -1.f));
+      const uint32_t c0 = p.corner();
+      assert(f.uv[0] == static_cast<float>((c0 == 1 || c0 == 2) ? p.width() : 0));
+      assert(f.uv[1] == static_cast<float>(c0 >= 2 ? p.height() : 0));
+      assert(p.layer() != BLOCK_AIR);
+    }
+  }
+
+  // Occlusion: an isolated cube is open everywhere; a block on a floor darkens
+  // the floor corners around it.
+  Scene floor; floor.fill({0,0,0},{32,1,32},2);
+  mesher.mesh(floor, {0,0,0}, packed);
+  for(const PackedVertex& p : packed.packed) assert(p.ao() == 3);
+  floor.setBlock(16,1,16,3);
+  mesher.mesh(floor, {0,0,0}, packed);
+  int floorOccluded = 0;
+  for(const PackedVertex& p : packed.packed){
+    if(p.ao() == 3) continue;
+    if(p.layer() == 2){ assert(p.face() == 3 && p.y() == 1); ++floorOccluded; }
+    else assert(p.face() != 3 && p.y() == 1); // the block's sides, where they meet the floor
+  }
+  assert(floorOccluded > 0);
+  // Floor top splits around the block into quads of uniform corner occlusion,
+  // so it needs more than the unoccluded mesh but far fewer than per block.
+  assert(packed.quadCount() > 6 + 5 && packed.quadCount() < 64);
+
+  // Incremental remeshing: after random edits, rebuilding only the slices they
+  // dirtied (in every chunk that reads the block) matches a full mesh.
+  for(VertexFormat format : {VertexFormat::Float, VertexFormat::Packed}){
+    Scene w = s;
+    const ChunkCoord chunks[] = {{0,0,0}, {-1,0,0}, {0,-1,0}, {0,0,1}};
+    std::unordered_map<ChunkCoord, SlicedMesh, ChunkCoordHash> cache;
+    for(const ChunkCoord& c : chunks){
+      SlicedMesh& m = cache[c];
+      m.format = format;
+      mesher.remesh(ChunkNeighbourhood::of(w, c), DirtySlices{}, m); // empty cache: full build
+    }
+    MeshBuffers full, flat;
+    full.format = format;
+    for(int round=0;round<20;++round){
+      std::unordered_map<ChunkCoord, DirtySlices, ChunkCoordHash> dirty;
+      for(int e=0;e<1 + round%5;++e){
+        // Bias towards chunk faces so neighbour propagation is exercised.
+        const int pick[4] = {0, 31, 32, -1};
+        const BlockPos p{rng()%3 ? static_cast<int>(rng()%64) - 32 : pick[rng()%4], static_cast<int>(rng()%40) - 4, static_cast<int>(rng()%64) - 32 + (rng()%2 ? 0 : 16)};
+        w.setBlock(p.x, p.y, p.z, static_cast<BlockId>(rng()%3));
+        forMeshesReading(p, [&](const ChunkCoord& c, int x, int y, int z){ dirty[c].touch(x, y, z); });
+      }
+      for(const ChunkCoord& c : chunks){
+        const auto it = dirty.find(c);
+        SlicedMesh& m = cache[c];
+        const MesherStats st = mesher.remesh(ChunkNeighbourhood::of(w, c), it == dirty.end() ? DirtySlices{} : it->second, m);
+        if(it == dirty.end()) assert(st.quads == 0);
+        m.flatten(flat);
+        mesher.mesh(w, c, full);
+        assert(flat.quadCount() == full.quadCount() && flat.bytes() == full.bytes());
+        assert(std::equal(flat.indices.begin(), flat.indices.end(), full.indices.begin()));
+        // Element-wise: an empty mesh has null data(), which memcmp must not see.
+        const auto sameBytes = [](const auto& a, const auto& b){ return std::memcmp(&a, &b, sizeof(a)) == 0; };
+        assert(std::equal(flat.vertices.begin(), flat.vertices.end(), full.vertices.begin(), sameBytes));
+        assert(std::equal(flat.packed.begin(), flat.packed.end(), full.packed.begin(), sameBytes));
+      }
+    }
+  }
+  // Only face neighbours whose facing plane holds the block are affected.
+  int reads = 0;
+  forMeshesReading({31, 5, 0}, [&](const ChunkCoord& c, int x, int y, int z){
+    ++reads;
+    if(c == ChunkCoord{0,0,0}) assert(x == 31 && y == 5 && z == 0);
+    else if(c == ChunkCoord{1,0,0}) assert(x == -1 && y == 5 && z == 0);
+    else { assert((c == ChunkCoord{0,0,-1})); assert(x == 31 && y == 5 && z == 32); }
+  });
+  assert(reads == 3);
+  DirtySlices d; d.touch(-1, 5, 32);
+  assert(d.axis[0] == 1u && d.axis[1] == 0x70u && d.axis[2] == 1u << 31);
+  return 0;
+}
@@ -0,0 +1,148 @@
+#include "camera.hpp"
+#include "perf_report.hpp"
+#include <cassert>
+#include <cmath>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace {
+bool near(float a, float b){ return std::fabs(a - b) < 1e-5f; }
+
+// Nearest rank: p50 of 1..100 is 50, p99 is 99; one sample is every percentile.
+void testPercentiles(){
+  std::vector<double> v;
+  for(int i=100;i>=1;--i) v.push_back(i);
+  const Percentiles p = percentiles(v);
+  assert(p.p50 == 50.0 && p.p95 == 95.0 && p.p99 == 99.0 && p.max == 100.0 && p.mean == 50.5 && p.count == 100);
+  const Percentiles one = percentiles({3.0});
+  assert(one.p50 == 3.0 && one.p99 == 3.0 && one.max == 3.0);
+  const Percentiles none = percentiles({});
+  assert(none.count == 0 && none.p99 == 0.0);
+}
+
+PerfReport sampleReport(){
+  PerfReport r;
+  r.device = "llvmpipe \"test\"\n";
+  r.build = "gcc, avx2";
+  PerfScenario& s = r.scenarios.emplace_back();
+  s.name = "fly-through";
+  s.frames = 600;
+  s.add("frame_ms", percentiles({1.0, 2.0, 3.0, 40.0}));
+  s.add("chunks_per_s", 1234.5678, true);
+  s.add("allocations", 0.1 + 0.2);
+  r.scenarios.emplace_back().name = "empty";
+  return r;
+}
+
+// Everything written reads back unchanged, doubles to the bit.
+void testJson(){
+  const PerfReport r = sampleReport();
+  PerfReport back;
+  std::string error;
+  assert(PerfReport::fromJson(r.toJson(), back, error) && error.empty());
+  assert(back.device == r.device && back.build == r.build && back.scenarios.size() == 2);
+  const PerfScenario& s = back.scenarios[0];
+  assert(s.name == "fly-through" && s.frames == 600 && s.metrics.size() == 5);
+  for(size_t i=0;i<s.metrics.size();++i){
+    assert(s.metrics[i].name == r.scenarios[0].metrics[i].name);
+    assert(s.metrics[i].value == r.scenarios[0].metrics[i].value);
+    assert(s.metrics[i].higherIsBetter == r.scenarios[0].metrics[i].higherIsBetter);
+  }
+  assert(back.find("empty") && back.find("empty")->metrics.empty() && !back.find("static"));
+  const std::string path = (std::filesystem::temp_directory_path() / "blocco_test_perf.json").string();
+  assert(r.save(path) && PerfReport::load(path, back, error) && back.toJson() == r.toJson());
+  std::filesystem::remove(path);
+  assert(!PerfReport::load(path, back, error) && !error.empty());
+  // Keys it does not know are skipped, whatever they hold.
+  const std::string extra = R"({"version": [1, {"a": null}], "device": "xA", "scenarios": [
+    {"name": "s", "notes": "\"quoted\"", "metrics": {"m": {"value": -2.5e-3, "better": "higher", "unit": "ms"}}}], "ok": true})";
+  assert(PerfReport::fromJson(extra, back, error));
+  assert(back.device == "xA" && back.scenarios[0].metrics[0].value == -2.5e-3 && back.scenarios[0].metrics[0].higherIsBetter);
+  // Malformed input fails with a message and leaves an empty report.
+  for(const char* bad : {"", "{", "{\"device\": }", "{\"scenarios\": [{\"name\": \"s\"]}", "{} x",
+                         "{\"scenarios\": [{\"metrics\": {\"m\": {\"better\": \"faster\"}}}]}", "{\"device\": \"open}"}){
+    assert(!PerfReport::fromJson(bad, back, error) && !error.empty() && back.scenarios.empty());
+  }
+}
+
+// Worse by more than the threshold and the noise floor regresses; better never does.
+void testCompare(){
+  PerfReport base, cur;
+  PerfScenario& b = base.scenarios.emplace_back();
+  b.name = "s";
+  b.add("ms", 10.0);
+  b.add("tiny_ms", 0.1);
+  b.add("rate", 100.0, true);
+  b.add("allocs", 0.0);
+  b.add("gone", 1.0);
+  base.scenarios.emplace_back().name = "only_in_base";
+  PerfScenario& c = cur.scenarios.emplace_back();
+  c.name = "s";
+  c.add("ms", 10.9);      // +9%: within threshold
+  c.add("tiny_ms", 0.14); // +40% but 0.04 ms: noise
+  c.add("rate", 95.0, true);
+  c.add("allocs", 0.0);
+  c.add("new", 5.0);
+  auto find = [](const std::vector<PerfChange>& v, const std::string& m) -> const PerfChange& {
+    for(const PerfChange& x : v) if(x.metric == m) return x;
+    assert(false);
+    return v.front();
+  };
+  std::vector<PerfChange> changes = compareReports(base, cur);
+  // "gone" went missing from a scenario that ran; "new" has nothing to compare
+  // against, and a baseline scenario that did not run is skipped.
+  assert(changes.size() == 5);
+  for(const PerfChange& x : changes) assert(!x.regression && x.missing == (x.metric == "gone") && x.scenario == "s");
+  assert(find(changes, "gone").baseline == 1.0);
+  assert(std::fabs(find(changes, "ms").change - 0.09) < 1e-9 && find(changes, "rate").change == -0.05);
+  cur.scenarios[0].metrics[0].value = 11.5;  // +15%
+  cur.scenarios[0].metrics[2].value = 80.0;  // -20% throughput
+  cur.scenarios[0].metrics[3].value = 12.0;  // from none
+  changes = compareReports(base, cur);
+  assert(find(changes, "ms").regression && find(changes, "rate").regression && find(changes, "allocs").regression);
+  assert(find(changes, "allocs").change == 0.0 && !find(changes, "tiny_ms").regression);
+  cur.scenarios[0].metrics[0].value = 5.0;
+  cur.scenarios[0].metrics[2].value = 500.0;
+  changes = compareReports(base, cur, {0.5, 0.0});
+  assert(!find(changes, "ms").regression && !find(changes, "rate").regression && find(changes, "allocs").regression);
+}
+
+// Keys interpolate linearly, hold past both ends, and must move forward in time.
+void testCameraPath(){
+  CameraPath path{{0.f, {0.f, 10.f, 0.f}, 0.f, 0.f}, {2.f, {20.f, 10.f, -4.f}, 1.f, -0.5f}, {3.f, {20.f, 30.f, -4.f}, 1.f, 0.f}};
+  assert(path.duration() == 3.f);
+  Camera cam;
+  path.apply(0.5f, cam);
+  assert(near(cam.position.x, 5.f) && near(cam.position.z, -1.f) && near(cam.yaw, 0.25f) && near(cam.pitch, -0.125f));
+  path.apply(2.5f, cam);
+  assert(near(cam.position.y, 20.f) && near(cam.yaw, 1.f) && near(cam.pitch, -0.25f));
+  path.apply(2.f, cam);
+  assert(near(cam.position.x, 20.f) && near(cam.pitch, -0.5f));
+  path.apply(-1.f, cam);
+  assert(near(cam.position.x, 0.f) && near(cam.position.y, 10.f));
+  path.apply(10.f, cam);
+  assert(near(cam.position.y, 30.f) && near(cam.pitch, 0.f));
+  // Fixed steps replay the same frames.
+  Camera a, b;
+  for(int f=0;f<200;++f){
+    path.apply(static_cast<float>(f)/60.f, a);
+    path.apply(static_cast<float>(f)/60.f, b);
+    assert(a.position.x == b.position.x && a.yaw == b.yaw);
+  }
+  bool threw = false;
+  try { path.add({3.f, {}, 0.f, 0.f}); } catch(const std::exception&){ threw = true; }
+  assert(threw);
+  CameraPath empty;
+  empty.apply(1.f, cam); // leaves the camera alone
+  assert(near(cam.position.y, 30.f) && empty.duration() == 0.f);
+}
+}
+
+int main(){
+  testPercentiles();
+  testJson();
+  testCompare();
+  testCameraPath();
+  return 0;
+}
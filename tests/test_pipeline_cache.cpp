@@ -0,0 +1,100 @@
+#include "pipeline_cache.hpp"
+#include "bytes.hpp"
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace {
+using PipelineCacheFile::Status;
+
+PipelineCacheKey makeKey(){
+  PipelineCacheKey key;
+  key.vendorID = 0x10de; key.deviceID = 0x2684; key.driverVersion = 0x8a3c4000;
+  for(uint8_t i=0;i<16;++i){ key.deviceUUID[i] = i; key.pipelineCacheUUID[i] = static_cast<uint8_t>(0xa0 + i); }
+  return key;
+}
+
+// Payload shaped like vkGetPipelineCacheData() output for key.
+std::vector<uint8_t> makePayload(const PipelineCacheKey& key, size_t extra){
+  std::vector<uint8_t> p(32 + extra);
+  size_t at = 0;
+  for(const uint32_t v : {32u, 1u, key.vendorID, key.deviceID}) Bytes::put(p, at, v);
+  Bytes::put(p, at, key.pipelineCacheUUID);
+  for(size_t i=32;i<p.size();++i) p[i] = static_cast<uint8_t>(i * 7);
+  return p;
+}
+
+Status decode(const std::vector<uint8_t>& file, const PipelineCacheKey& key){
+  std::span<const uint8_t> data;
+  return PipelineCacheFile::decode(file, key, data);
+}
+
+void testRoundTrip(){
+  const PipelineCacheKey key = makeKey();
+  const std::vector<uint8_t> payload = makePayload(key, 1000);
+  const std::vector<uint8_t> file = PipelineCacheFile::encode(key, payload);
+  std::span<const uint8_t> data;
+  assert(PipelineCacheFile::decode(file, key, data) == Status::Ok);
+  assert(data.size() == payload.size() && std::memcmp(data.data(), payload.data(), payload.size()) == 0);
+  // An empty cache round-trips too.
+  assert(decode(PipelineCacheFile::encode(key, {}), key) == Status::Ok);
+}
+
+void testRejects(){
+  const PipelineCacheKey key = makeKey();
+  const std::vector<uint8_t> file = PipelineCacheFile::encode(key, makePayload(key, 200));
+  // Any change of device or driver invalidates the cache.
+  PipelineCacheKey other = key; other.driverVersion += 1;
+  assert(decode(file, other) == Status::KeyMismatch);
+  other = key; other.deviceUUID[15] ^= 1;
+  assert(decode(file, other) == Status::KeyMismatch);
+  other = key; other.pipelineCacheUUID[0] ^= 1;
+  assert(decode(file, other) == Status::KeyMismatch);
+  // Damage anywhere is caught: truncation, a flipped payload byte, a wrong magic.
+  for(size_t cut : {size_t{0}, size_t{10}, file.size() - 1}){
+    const std::vector<uint8_t> truncated(file.begin(), file.begin() + static_cast<std::ptrdiff_t>(cut));
+    assert(decode(truncated, key) == Status::Truncated);
+  }
+  std::vector<uint8_t> flipped = file;
+  flipped[flipped.size() - 5] ^= 0x40;
+  assert(decode(flipped, key) == Status::Corrupt);
+  std::vector<uint8_t> magic = file;
+  magic[0] = 'X';
+  assert(decode(magic, key) == Status::BadMagic);
+  // A payload whose driver header disagrees with the key (hash intact) is refused.
+  std::vector<uint8_t> foreign = makePayload(key, 64);
+  foreign[8] ^= 1; // vendor ID
+  assert(decode(PipelineCacheFile::encode(key, foreign), key) == Status::KeyMismatch);
+  std::vector<uint8_t> shortHeader(16, 0);
+  assert(decode(PipelineCacheFile::encode(key, shortHeader), key) == Status::Corrupt);
+}
+
+void testFiles(){
+  const PipelineCacheKey key = makeKey();
+  const auto dir = std::filesystem::temp_directory_path() / "blocco_test_pipeline_cache";
+  std::filesystem::remove_all(dir);
+  const std::string path = (dir / "nested" / "cache.bin").string();
+  std::vector<uint8_t> data;
+  assert(PipelineCacheFile::load(path, key, data) == Status::Missing);
+  const std::vector<uint8_t> payload = makePayload(key, 4096);
+  assert(PipelineCacheFile::save(path, key, payload));
+  assert(!std::filesystem::exists(path + ".tmp"));
+  assert(PipelineCacheFile::load(path, key, data) == Status::Ok && data == payload);
+  // Saving again replaces the file whole.
+  const std::vector<uint8_t> smaller = makePayload(key, 8);
+  assert(PipelineCacheFile::save(path, key, smaller));
+  assert(PipelineCacheFile::load(path, key, data) == Status::Ok && data == smaller);
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << "garbage";
+  assert(PipelineCacheFile::load(path, key, data) == Status::Truncated);
+  std::filesystem::remove_all(dir);
+}
+}
+
+int main(){
+  testRoundTrip();
+  testRejects();
+  testFiles();
+  return 0;
+}
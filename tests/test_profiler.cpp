@@ -0,0 +1,85 @@
+#include "profiler.hpp"
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+size_t countOf(const std::string& text, const std::string& what){
+  size_t n = 0;
+  for(size_t at = text.find(what); at != std::string::npos; at = text.find(what, at + what.size())) ++n;
+  return n;
+}
+
+void nested(int depth){
+  BLOCCO_ZONE("nested");
+  if(depth > 0) nested(depth - 1);
+}
+}
+
+int main(){
+  const auto path = std::filesystem::temp_directory_path() / "blocco_test_trace.json";
+#if defined(BLOCCO_PROFILER)
+  // Nothing is kept before start().
+  { BLOCCO_ZONE("ignored"); }
+  Profiler::start();
+  Profiler::setThreadName("main \"test\"");
+  {
+    BLOCCO_ZONE("outer");
+    nested(3);
+  }
+  std::vector<std::thread> threads;
+  for(int t=0;t<4;++t){
+    threads.emplace_back([]{
+      Profiler::setThreadName("worker");
+      for(int i=0;i<1000;++i){ BLOCCO_ZONE("work"); }
+    });
+  }
+  for(std::thread& t : threads) t.join();
+  Profiler::gpuZone("render pass", Profiler::now(), 100.0, 2100.0);
+  Profiler::Stats s = Profiler::stats();
+  assert(s.zones == 1 + 4 + 4000 + 1 && s.dropped == 0 && s.threads >= 5);
+
+  // A ring that is never drained drops what does not fit instead of blocking.
+  std::thread([]{
+    for(int i=0;i<40000;++i){ BLOCCO_ZONE("flood"); }
+  }).join();
+  s = Profiler::stats();
+  assert(s.dropped > 0 && s.zones < 1 + 4 + 4000 + 1 + 40000);
+  Profiler::reset();
+  assert(Profiler::stats().zones == 0 && Profiler::stats().dropped == 0);
+
+  {
+    BLOCCO_ZONE("outer");
+    nested(2);
+  }
+  Profiler::gpuZone("render pass", Profiler::now(), 0.0, 1000.0);
+  Profiler::stop();
+  { BLOCCO_ZONE("after stop"); }
+  assert(Profiler::writeChromeTrace(path.string()));
+  std::ifstream f(path);
+  std::stringstream ss;
+  ss << f.rdbuf();
+  const std::string trace = ss.str();
+  assert(trace.starts_with("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[") && trace.ends_with("]}\n"));
+  assert(countOf(trace, "\"ph\":\"X\"") == 5);
+  assert(countOf(trace, "\"name\":\"nested\"") == 3 && countOf(trace, "after stop") == 0);
+  // Thread names are escaped and the GPU has its own track.
+  assert(countOf(trace, "main \\\"test\\\"") == 1 && countOf(trace, "\"tid\":0,\"ts\"") == 1);
+  // Zones are written in start order, so the outer zone precedes its children.
+  assert(trace.find("\"name\":\"outer\"") < trace.find("\"name\":\"nested\""));
+  std::filesystem::remove(path);
+#else
+  // Compiled out: zones vanish and there is nothing to export.
+  Profiler::start();
+  { BLOCCO_ZONE("outer"); }
+  assert(!Profiler::active() && Profiler::stats().zones == 0);
+  assert(!Profiler::writeChromeTrace(path.string()) && !std::filesystem::exists(path));
+  (void)countOf;
+  (void)nested;
+#endif
+  return 0;
+}
@@ -0,0 +1,280 @@
+#include "lz4.hpp"
+#include "region.hpp"
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+namespace fs = std::filesystem;
+
+void lz4RoundTrip(const std::vector<uint8_t>& src){
+  std::vector<uint8_t> packed(Lz4::compressBound(src.size()));
+  const size_t n = Lz4::compress(src, packed);
+  assert(n > 0 && n <= packed.size());
+  std::vector<uint8_t> out(src.size());
+  assert(Lz4::decompress(std::span<const uint8_t>(packed.data(), n), out));
+  assert(out == src);
+}
+
+void testLz4(){
+  std::mt19937 rng(7);
+  for(size_t size : {size_t{0}, size_t{1}, size_t{5}, size_t{12}, size_t{13}, size_t{300}, size_t{70000}}){
+    std::vector<uint8_t> random(size), runs(size), text(size);
+    for(size_t i=0;i<size;++i){
+      random[i] = static_cast<uint8_t>(rng());
+      runs[i] = static_cast<uint8_t>(i / 1000);
+      text[i] = static_cast<uint8_t>("blocco "[i % 7]);
+    }
+    lz4RoundTrip(random);
+    lz4RoundTrip(runs);
+    lz4RoundTrip(text);
+  }
+  // Repetitive data shrinks; matches longer than 64 KiB of input still round-trip.
+  std::vector<uint8_t> zeros(100000, 0);
+  std::vector<uint8_t> packed(Lz4::compressBound(zeros.size()));
+  const size_t n = Lz4::compress(zeros, packed);
+  assert(n < 1000);
+  // Truncated, wrong-size and garbage inputs are rejected rather than overrun.
+  std::vector<uint8_t> out(zeros.size());
+  assert(!Lz4::decompress(std::span<const uint8_t>(packed.data(), n - 1), out));
+  std::vector<uint8_t> shorter(zeros.size() - 1);
+  assert(!Lz4::decompress(std::span<const uint8_t>(packed.data(), n), shorter));
+  const std::vector<uint8_t> garbage = {0x1f, 0x00, 0xff, 0xff};
+  assert(!Lz4::decompress(garbage, out));
+  // Too small a destination makes compress() fail instead of writing past it.
+  std::vector<uint8_t> tiny(4);
+  assert(Lz4::compress(zeros, tiny) == 0);
+}
+
+bool sameBlocks(const Chunk& a, const Chunk& b){
+  std::vector<BlockId> x(Chunk::VOLUME), y(Chunk::VOLUME);
+  a.decode(x.data());
+  b.decode(y.data());
+  return x == y;
+}
+
+// Chunks at every index width: uniform, 1..8 bits and direct ids.
+std::vector<Chunk> sampleChunks(){
+  std::vector<Chunk> chunks;
+  chunks.emplace_back(Chunk{});
+  chunks.emplace_back(Chunk{3});
+  for(int distinct : {2, 4, 16, 200, 400}){
+    Chunk c;
+    for(int i=0;i<Chunk::VOLUME;++i) c.setAt(i, static_cast<BlockId>((i * 31) % distinct));
+    chunks.push_back(c);
+  }
+  return chunks;
+}
+
+void testSerialize(){
+  std::vector<unsigned> widths;
+  for(const Chunk& c : sampleChunks()){
+    widths.push_back(c.bitsPerBlock());
+    std::vector<uint8_t> bytes = {0xaa};
+    c.serialize(bytes);
+    assert(bytes.size() == 1 + c.serializedSize() && bytes[0] == 0xaa);
+    Chunk back(9);
+    assert(back.deserialize(std::span<const uint8_t>(bytes).subspan(1)));
+    assert(sameBlocks(c, back) && back.bitsPerBlock() == c.bitsPerBlock());
+    // The restored chunk is fully usable: edits still grow the palette.
+    back.set(0, 0, 0, 999);
+    assert(back.get(0, 0, 0) == 999);
+    // Truncated input leaves the chunk as it was.
+    Chunk kept(9);
+    assert(!kept.deserialize(std::span<const uint8_t>(bytes).subspan(1, bytes.size() - 2)));
+    assert(kept.uniform() && kept.get(0, 0, 0) == 9);
+  }
+  assert((widths == std::vector<unsigned>{0, 0, 1, 2, 4, 8, 16}));
+}
+
+void testStore(const fs::path& dir){
+  const std::vector<Chunk> samples = sampleChunks();
+  const std::vector<ChunkCoord> coords = {{0,0,0}, {-1,-1,-1}, {7,0,7}, {8,0,0}, {-9,3,-17}, {100,-2,5}, {1,1,1}};
+  {
+    RegionStore store(dir.string());
+    Chunk missing;
+    assert(!store.load({0,0,0}, missing));
+    for(size_t i=0;i<coords.size();++i) store.save(coords[i], samples[i]);
+  }
+  // Reopened from disk, every chunk comes back.
+  {
+    RegionStore store(dir.string());
+    for(size_t i=0;i<coords.size();++i){
+      Chunk c;
+      assert(store.load(coords[i], c) && sameBlocks(c, samples[i]));
+    }
+    Chunk c;
+    assert(!store.load({2,0,0}, c) && !store.load({50,50,50}, c));
+  }
+  // Uncompressed records read back the same way.
+  {
+    RegionStore store((dir / "raw").string(), RegionOptions{.compress = false});
+    for(size_t i=0;i<coords.size();++i) store.save(coords[i], samples[i]);
+    for(size_t i=0;i<coords.size();++i){
+      Chunk c;
+      assert(store.load(coords[i], c) && sameBlocks(c, samples[i]));
+    }
+  }
+}
+
+void testRewriteAndCompact(const fs::path& dir){
+  const fs::path path = dir / "rewrite.bcr";
+  const Chunk dense = sampleChunks().back();
+  {
+    RegionFile file(path.string());
+    for(int round=0;round<4;++round)
+      for(int slot=0;slot<8;++slot){
+        Chunk c = dense;
+        c.set(0, 0, 0, static_cast<BlockId>(round * 8 + slot));
+        file.write(slot, c, false);
+      }
+    // Each rewrite leaves the previous record behind.
+    assert(file.deadBytes() == 3 * 8 * dense.serializedSize());
+    Chunk c;
+    assert(file.read(5, c) && c.get(0, 0, 0) == 3 * 8 + 5);
+    file.erase(6);
+    assert(!file.contains(6) && !file.read(6, c));
+    const size_t before = file.fileBytes();
+    file.compact();
+    assert(file.deadBytes() == 0 && file.fileBytes() < before / 3);
+    for(int slot=0;slot<8;++slot){
+      if(slot == 6) continue;
+      assert(file.read(slot, c) && c.get(0, 0, 0) == 3 * 8 + slot && c.get(1, 0, 0) == dense.get(1, 0, 0));
+    }
+    // Writes after compaction append to the new file.
+    file.write(6, dense, true);
+    assert(file.read(6, c) && sameBlocks(c, dense));
+  }
+  // The store compacts on its own once dead space crosses the threshold.
+  {
+    RegionStore store((dir / "auto").string(), RegionOptions{.compress = false, .compactRatio = 0.5, .compactMinBytes = 0});
+    for(int round=0;round<10;++round) store.save({0,0,0}, dense);
+    assert(store.fileBytes() < 3 * dense.serializedSize());
+  }
+  // A file that cannot be replaced fails loudly and leaves no temporary behind.
+  {
+    const fs::path stuck = dir / "stuck.bcr";
+    RegionFile file(stuck.string());
+    file.write(0, dense, false);
+    file.write(0, dense, false);
+    std::error_code ec;
+    if(fs::remove(stuck, ec)){ // Windows keeps an open file in place
+      fs::create_directories(stuck / "occupied");
+      bool threw = false;
+      try { file.compact(); }
+      catch(const std::runtime_error& e){ threw = std::string(e.what()).starts_with("Failed to replace"); }
+      assert(threw && !fs::exists(stuck.string() + ".tmp"));
+    }
+  }
+}
+
+void testCorruption(const fs::path& dir){
+  const fs::path path = dir / "corrupt.bcr";
+  const Chunk dense = sampleChunks().back();
+  uint64_t offset = 0;
+  {
+    RegionFile file(path.string());
+    file.write(0, dense, false);
+    file.write(1, dense, true);
+    offset = file.fileBytes() - 1;
+  }
+  {
+    // Flip a byte in the last (compressed) record.
+    std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekg(static_cast<std::streamoff>(offset));
+    const char b = static_cast<char>(f.get() ^ 0x5a);
+    f.seekp(static_cast<std::streamoff>(offset));
+    f.put(b);
+  }
+  RegionFile file(path.string());
+  Chunk c;
+  assert(file.read(0, c) && sameBlocks(c, dense));
+  assert(!file.read(1, c));
+  // A file cut short drops the entries that point past its end.
+  fs::resize_file(path, offset);
+  RegionFile truncated(path.string());
+  assert(truncated.contains(0) && !truncated.contains(1));
+  {
+    // An offset so large that offset + size wraps around to inside the file.
+    const uint64_t garbage = UINT64_MAX - 7;
+    std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(16); // slot 0's entry starts with its offset
+    f.write(reinterpret_cast<const char*>(&garbage), sizeof(garbage));
+  }
+  RegionFile wrapped(path.string());
+  assert(!wrapped.contains(0) && !wrapped.read(0, c));
+  // Anything that is not a region file is refused.
+  { std::ofstream(dir / "junk.bcr") << "not a region file, just some text that is long enough to matter"; }
+  bool threw = false;
+  try { RegionFile junk((dir / "junk.bcr").string()); } catch(const std::runtime_error&){ threw = true; }
+  assert(threw);
+}
+
+// Same hash as region.cpp, to forge records that pass it.
+uint64_t recordHash(std::span<const uint8_t> data){
+  uint64_t h = 0xcbf29ce484222325ull ^ data.size();
+  size_t i = 0;
+  for(; i + 8 <= data.size(); i += 8){
+    uint64_t w;
+    std::memcpy(&w, data.data() + i, 8);
+    h = (h ^ w) * 0x9e3779b97f4a7c15ull;
+    h ^= h >> 32;
+  }
+  for(; i < data.size(); ++i) h = (h ^ data[i]) * 0x100000001b3ull;
+  return h;
+}
+
+// A record whose hash checks out but whose indices point past the palette is
+// refused instead of reading beyond it.
+void testBadPaletteIndex(const fs::path& dir){
+  Chunk c;
+  for(int i=0;i<Chunk::VOLUME;++i) c.setAt(i, static_cast<BlockId>(i % 3));
+  std::vector<uint8_t> bytes;
+  c.serialize(bytes);
+  assert(bytes[0] == 2 && bytes[1] == 0); // 2-bit indices, three palette entries
+  bytes.back() = 0xff; // the last blocks now use index 3
+  Chunk kept(9);
+  assert(!kept.deserialize(bytes));
+  assert(kept.uniform() && kept.get(0, 0, 0) == 9);
+
+  const fs::path path = dir / "palette.bcr";
+  uint64_t offset = 0;
+  {
+    RegionFile file(path.string());
+    file.write(0, c, false);
+    offset = file.fileBytes() - bytes.size();
+  }
+  {
+    const uint64_t hash = recordHash(bytes);
+    std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(static_cast<std::streamoff>(offset));
+    f.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    f.seekp(16 + 16); // slot 0's entry: offset, size, raw size, then the hash
+    f.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+  }
+  RegionFile file(path.string());
+  Chunk out;
+  assert(file.contains(0) && !file.read(0, out));
+}
+}
+
+int main(){
+  const fs::path dir = fs::temp_directory_path() / "blocco_test_region";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  testLz4();
+  testSerialize();
+  testStore(dir);
+  testRewriteAndCompact(dir);
+  testCorruption(dir);
+  testBadPaletteIndex(dir);
+  fs::remove_all(dir);
+  return 0;
+}
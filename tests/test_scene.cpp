@@ -0,0 +1,39 @@
+#include "scene.hpp"
+#include <cassert>
+int main(){
+  // Homogeneous chunks carry no index data.
+  Chunk c;
+  assert(c.uniform() && c.empty());
+  c.set(1,2,3,7);
+  assert(c.get(1,2,3)==7 && c.get(0,0,0)==BLOCK_AIR && c.bitsPerBlock()==1);
+  // Palette growth keeps earlier values intact, including the switch to direct ids.
+  for(int i=0;i<300;++i) c.setAt(i, static_cast<BlockId>(i+1));
+  for(int i=0;i<300;++i) assert(c.at(i)==static_cast<BlockId>(i+1));
+  assert(c.bitsPerBlock()==16);
+  c.fill(5);
+  assert(c.uniform() && c.get(31,31,31)==5);
+  c.fillRegion(0,0,0,32,1,32,9);
+  assert(c.get(4,0,4)==9 && c.get(4,1,4)==5);
+  c.fillRegion(0,1,0,32,32,32,9);
+  c.compact();
+  assert(c.uniform() && c.get(0,31,0)==9);
+
+  Scene s;
+  assert(s.getBlock(-1,-1,-1)==BLOCK_AIR);
+  s.setBlock(-1,-1,-1,3);
+  assert(s.getBlock(-1,-1,-1)==3 && s.chunkCount()==1);
+  assert(s.findChunk({-1,-1,-1})->get(31,31,31)==3);
+  s.setBlock(100,0,0,BLOCK_AIR);
+  assert(s.chunkCount()==1);
+  s.fill({-10,0,-10},{40,4,40},2);
+  assert(s.getBlock(-10,0,-10)==2 && s.getBlock(39,3,39)==2 && s.getBlock(40,3,39)==BLOCK_AIR);
+  // Overlapping copy shifts the slab up by two.
+  s.copyRegion({-10,0,-10},{40,4,40},{-10,2,-10});
+  assert(s.getBlock(0,5,0)==2 && s.getBlock(0,6,0)==BLOCK_AIR);
+  s.fill({-64,-64,-64},{64,64,64},BLOCK_AIR);
+  s.compact();
+  assert(s.chunkCount()==0);
+  s.fill({0,0,0},{64,64,64},1);
+  assert(s.chunkCount()==8 && s.memoryUsage() < 8*1024);
+  return 0;
+}
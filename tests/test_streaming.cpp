@@ -0,0 +1,401 @@
+#include "streamed_meshes.hpp"
+#include "streaming.hpp"
+#include "terrain.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+constexpr float N = static_cast<float>(Chunk::SIZE);
+
+// Tracks what the streamer uploaded, as the renderer would.
+struct Uploads {
+  std::unordered_map<ChunkCoord, size_t, ChunkCoordHash> meshes; // coord -> quads
+  size_t maxBytes{0}, perUpdate{0};
+  uint64_t released{0}, replaced{0};
+  void attach(ChunkStreamer& s){
+    s.setUploader([this](const ChunkCoord& c, const MeshBuffers& m){
+      replaced += meshes.contains(c); // only after edits
+      meshes[c] = m.quadCount();
+      perUpdate += m.bytes();
+    }, [this](const ChunkCoord& c){
+      assert(meshes.erase(c) == 1);
+      ++released;
+    });
+  }
+};
+
+const TerrainParams TERRAIN{7, 8, 40, 64};
+ChunkStreamer::Generator terrain(){
+  return [](const ChunkCoord& c, Chunk& out){ generateTerrain(TERRAIN, c, out); };
+}
+
+void settle(ChunkStreamer& s, Uploads& u, const Vec3& eye, const Vec3& forward){
+  for(int i=0;i<2000;++i){
+    u.perUpdate = 0;
+    s.update(eye, forward);
+    u.maxBytes = std::max(u.maxBytes, u.perUpdate);
+    const StreamingStats& st = s.stats();
+    if(i > 0 && st.inFlight == 0 && st.pendingUploads == 0 && st.uploadedBytes == 0 && st.pendingEdits == 0) return;
+    s.finishJobs();
+  }
+  assert(false && "streaming did not settle");
+}
+
+void testPriority(){
+  const Vec3 eye{16.f, 16.f, 16.f}, forward{0.f, 0.f, -1.f};
+  // Same distance: ahead before the side before behind; nearer before farther.
+  const float ahead = ChunkStreamer::priority({0, 0, -3}, eye, forward);
+  const float side = ChunkStreamer::priority({3, 0, 0}, eye, forward);
+  const float behind = ChunkStreamer::priority({0, 0, 3}, eye, forward);
+  assert(ahead < side && side < behind);
+  assert(std::abs(behind - 2.f*ahead) < 1e-4f);
+  assert(ChunkStreamer::priority({0, 0, -2}, eye, forward) < ahead);
+}
+
+// Everything within the radius is generated, chunks with all neighbours are
+// meshed exactly like a directly meshed scene, and nothing else is kept.
+void testResidency(unsigned threads){
+  JobSystem jobs(threads);
+  Scene scene;
+  StreamingConfig cfg;
+  cfg.radius = 3; cfg.verticalRadius = 1;
+  ChunkStreamer streamer(scene, jobs, terrain(), cfg);
+  Uploads uploads;
+  uploads.attach(streamer);
+  const Vec3 eye{10.f, 20.f, 10.f}; // chunk (0, 0, 0)
+  settle(streamer, uploads, eye, {1.f, 0.f, 0.f});
+
+  Scene reference;
+  uint32_t inRadius = 0;
+  for(int y=-1;y<=1;++y) for(int z=-3;z<=3;++z) for(int x=-3;x<=3;++x){
+    if(x*x + z*z > 9) continue;
+    ++inRadius;
+    generateTerrain(TERRAIN, {x, y, z}, reference.chunkAt({x, y, z}));
+  }
+  assert(streamer.stats().resident == inRadius);
+  for(const auto& [c, chunk] : scene.chunks()) assert(!chunk.empty() && reference.findChunk(c));
+  ChunkMesher mesher;
+  MeshBuffers expected;
+  size_t interior = 0;
+  for(int y=0;y<=0;++y) for(int z=-2;z<=2;++z) for(int x=-2;x<=2;++x){
+    if(x*x + z*z > 4) continue; // every face neighbour inside the radius too
+    const ChunkCoord c{x, y, z};
+    mesher.mesh(reference, c, expected);
+    const auto it = uploads.meshes.find(c);
+    assert(expected.quadCount() == (it == uploads.meshes.end() ? 0 : it->second));
+    interior += expected.quadCount() > 0;
+  }
+  assert(interior > 0);
+  assert(uploads.meshes.size() == streamer.stats().meshes);
+  assert(uploads.replaced == 0);
+}
+
+// Edits, including ones landing while remeshes are in flight, end with every
+// mesh matching a full mesh of the edited scene, and only the chunks whose
+// meshes read an edited block are rebuilt.
+void testEdits(unsigned threads){
+  JobSystem jobs(threads);
+  Scene scene;
+  StreamingConfig cfg;
+  cfg.radius = 3; cfg.verticalRadius = 1;
+  cfg.format = VertexFormat::Packed;
+  ChunkStreamer streamer(scene, jobs, terrain(), cfg);
+  Uploads uploads;
+  uploads.attach(streamer);
+  const Vec3 eye{10.f, 20.f, 10.f};
+  const Vec3 forward{1.f, 0.f, 0.f};
+  settle(streamer, uploads, eye, forward);
+
+  // One interior block: only its own chunk is remeshed.
+  const BlockId before = scene.getBlock(16, 8, 16);
+  streamer.setBlock({16, 8, 16}, before == BLOCK_AIR ? BlockId{1} : BLOCK_AIR);
+  settle(streamer, uploads, eye, forward);
+  assert(streamer.stats().edits == 1 && streamer.stats().remeshes == 1);
+  // A block on the +x face: the chunk and its +x neighbour.
+  streamer.setBlock({31, 8, 16}, scene.getBlock(31, 8, 16) == BLOCK_AIR ? BlockId{2} : BLOCK_AIR);
+  settle(streamer, uploads, eye, forward);
+  assert(streamer.stats().remeshes == 3);
+
+  uint32_t seed = 12345;
+  auto next = [&seed](int range){ seed = seed*1664525u + 1013904223u; return static_cast<int>((seed >> 8) % static_cast<uint32_t>(range)); };
+  for(int round=0;round<30;++round){
+    for(int e=0;e<20;++e){
+      const BlockPos p{next(128) - 64, next(96) - 32, next(128) - 64};
+      streamer.setBlock(p, static_cast<BlockId>(next(3)));
+    }
+    streamer.update(eye, forward); // jobs from the last round may still be running
+  }
+  streamer.setBlock({100*Chunk::SIZE, 0, 0}, 1); // not resident: dropped
+  settle(streamer, uploads, eye, forward);
+  const StreamingStats& st = streamer.stats();
+  assert(st.editsDropped == 1 && st.pendingEdits == 0);
+  assert(st.edits == 2 + 600 - st.editsDropped + 1);
+  assert(uploads.replaced > 0);
+
+  ChunkMesher mesher;
+  MeshBuffers expected;
+  expected.format = VertexFormat::Packed;
+  for(int y=0;y<=0;++y) for(int z=-2;z<=2;++z) for(int x=-2;x<=2;++x){
+    if(x*x + z*z > 4) continue;
+    const ChunkCoord c{x, y, z};
+    mesher.mesh(scene, c, expected);
+    const auto it = uploads.meshes.find(c);
+    assert(expected.quadCount() == (it == uploads.meshes.end() ? 0 : it->second));
+  }
+}
+
+void testUploadBudget(){
+  JobSystem jobs(2);
+  Scene scene;
+  StreamingConfig cfg;
+  cfg.radius = 4; cfg.verticalRadius = 1;
+  cfg.uploadBudget = 64 << 10;
+  ChunkStreamer streamer(scene, jobs, terrain(), cfg);
+  Uploads uploads;
+  uploads.attach(streamer);
+  settle(streamer, uploads, {0.f, 20.f, 0.f}, {0.f, 0.f, -1.f});
+  assert(!uploads.meshes.empty());
+  // Over budget only when a single mesh is larger than the whole budget.
+  size_t largest = 0;
+  for(const auto& [c, quads] : uploads.meshes) largest = std::max(largest, quads*(4*sizeof(Vertex) + 6*sizeof(uint32_t)));
+  assert(uploads.maxBytes <= std::max(cfg.uploadBudget, largest));
+}
+
+// Moving away releases every mesh left behind; the scene only holds chunks near the camera.
+void testEviction(){
+  JobSystem jobs(2);
+  Scene scene;
+  StreamingConfig cfg;
+  cfg.radius = 2; cfg.verticalRadius = 1;
+  ChunkStreamer streamer(scene, jobs, terrain(), cfg);
+  Uploads uploads;
+  uploads.attach(streamer);
+  settle(streamer, uploads, {0.f, 20.f, 0.f}, {1.f, 0.f, 0.f});
+  const size_t before = uploads.meshes.size();
+  assert(before > 0);
+  const Vec3 far{20.f*N, 20.f, 0.f};
+  settle(streamer, uploads, far, {1.f, 0.f, 0.f});
+  assert(uploads.released >= before);
+  for(const auto& [c, quads] : uploads.meshes) assert(std::abs(c.x - 20) <= 3);
+  for(const auto& [c, chunk] : scene.chunks()) assert(std::abs(c.x - 20) <= 3 && std::abs(c.z) <= 3);
+  assert(streamer.stats().evicted > 0);
+}
+
+// Under a tight memory budget the nearest chunks stay and memory stays bounded.
+void testMemoryBudget(){
+  JobSystem jobs(2);
+  Scene scene;
+  StreamingConfig cfg;
+  cfg.radius = 6; cfg.verticalRadius = 1;
+  cfg.memoryBudget = 1 << 20;
+  ChunkStreamer streamer(scene, jobs, terrain(), cfg);
+  Uploads uploads;
+  uploads.attach(streamer);
+  const Vec3 eye{0.f, 20.f, 0.f};
+  for(int i=0;i<300;++i){ streamer.update(eye, {0.f, 0.f, -1.f}); streamer.finishJobs(); }
+  const StreamingStats& st = streamer.stats();
+  assert(st.memoryBytes <= cfg.memoryBudget);
+  assert(st.resident > 0 && st.resident < 169*3);
+  // The chunk under the camera is kept over far ones.
+  assert(scene.findChunk({0, 0, 0}) || scene.findChunk({0, 1, 0}));
+  const uint64_t evicted = st.evicted;
+  for(int i=0;i<50;++i){ streamer.update(eye, {0.f, 0.f, -1.f}); streamer.finishJobs(); }
+  // No churn once settled.
+  assert(streamer.stats().evicted - evicted < 5);
+}
+}
+
+// With LOD levels, once settled visible() is the part of the cut that has
+// faces. While the camera moves it never covers a chunk twice and never drops
+// a column it covered, even with tile uploads landing an update late.
+void testLod(unsigned threads){
+  JobSystem jobs(threads);
+  Scene scene;
+  StreamingConfig cfg;
+  cfg.radius = 2; cfg.verticalRadius = 1; cfg.lodLevels = 2;
+  ChunkStreamer streamer(scene, jobs, terrain(), cfg);
+  streamer.setLodGenerator([](const LodTile& t, Chunk& out){ generateTerrainLod(TERRAIN, t, out); });
+  Uploads uploads;
+  uploads.attach(streamer);
+  uint64_t update = 0;
+  std::unordered_map<LodTile, uint64_t, LodTileHash> tiles; // update of the upload
+  streamer.setLodUploader([&](const LodTile& t, const MeshBuffers& m){
+    assert(t.level > 0 && !tiles.contains(t) && !m.empty());
+    tiles[t] = update;
+  }, [&](const LodTile& t){ assert(tiles.erase(t) == 1); });
+  streamer.setLanded([&](const LodTile& t){
+    if(t.level == 0) return uploads.meshes.contains(t.coord);
+    const auto it = tiles.find(t);
+    return it != tiles.end() && it->second < update;
+  });
+  using Columns = std::unordered_set<uint64_t>;
+  auto column = [](int x, int z){ return static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32 | static_cast<uint32_t>(z); };
+  auto drawn = [&](Columns& columns){
+    std::unordered_set<ChunkCoord, ChunkCoordHash> chunks;
+    columns.clear();
+    for(const LodTile& t : streamer.visible()){
+      assert(t.level == 0 ? uploads.meshes.contains(t.coord) : tiles.contains(t));
+      const ChunkCoord f = t.firstChunk();
+      for(int y=0;y<t.chunks();++y) for(int z=0;z<t.chunks();++z) for(int x=0;x<t.chunks();++x){
+        assert(chunks.insert({f.x + x, f.y + y, f.z + z}).second);
+        columns.insert(column(f.x + x, f.z + z));
+      }
+    }
+  };
+  Vec3 eye{10.f, 40.f, 10.f};
+  const Vec3 forward{1.f, 0.f, 0.f};
+  for(int i=0;;++i){
+    assert(i < 2000 && "streaming did not settle");
+    ++update;
+    streamer.update(eye, forward);
+    streamer.finishJobs();
+    const StreamingStats& st = streamer.stats();
+    if(st.inFlight == 0 && st.pendingUploads == 0 && st.uploadedBytes == 0) break;
+  }
+  ++update; // the last tiles land
+  streamer.update(eye, forward);
+  std::vector<LodTile> cut;
+  streamer.selection().select(cut);
+  const std::unordered_set<LodTile, LodTileHash> visible(streamer.visible().begin(), streamer.visible().end());
+  size_t withFaces = 0;
+  for(const LodTile& t : cut){
+    const bool faces = t.level == 0 ? uploads.meshes.contains(t.coord) : tiles.contains(t);
+    withFaces += faces;
+    assert(visible.contains(t) == faces);
+  }
+  assert(visible.size() == withFaces && streamer.stats().visible == withFaces);
+  assert(std::any_of(cut.begin(), cut.end(), [](const LodTile& t){ return t.level == 2; }));
+  Columns before, after;
+  drawn(before);
+  // Every column within the inner view is drawn.
+  const float inner = streamer.selection().viewRadius() - 2.f;
+  auto near = [&](uint64_t c){
+    const float x = static_cast<float>(static_cast<int32_t>(c >> 32)) + 0.5f - eye.x/N;
+    const float z = static_cast<float>(static_cast<int32_t>(c & 0xFFFFFFFFu)) + 0.5f - eye.z/N;
+    return x*x + z*z < inner*inner;
+  };
+  const int reach = static_cast<int>(inner);
+  for(int z=-reach;z<=reach;++z) for(int x=-reach;x<=reach;++x){
+    if(near(column(x, z))) assert(before.contains(column(x, z)));
+  }
+  for(int i=0;i<200;++i){
+    eye.x += 4.f;
+    ++update;
+    streamer.update(eye, forward);
+    streamer.finishJobs();
+    drawn(after);
+    for(uint64_t c : before) if(near(c)) assert(after.contains(c));
+    before.swap(after);
+  }
+  assert(streamer.stats().tilesBuilt > 0 && streamer.stats().evicted > 0);
+}
+
+// A fake renderer for StreamedMeshes: meshes are ids, landed once marked, and
+// every release must match a live upload.
+struct FakeGpu {
+  struct Mesh { uint32_t id{0}; };
+  uint32_t next{1};
+  bool full{false};
+  std::unordered_set<uint32_t> live, landed;
+  StreamedMeshes<Mesh>::Backend backend(){
+    return {[this](const MeshBuffers&){
+              if(full) throw std::runtime_error("mesh pool full");
+              live.insert(next);
+              return Mesh{next++};
+            },
+            [this](Mesh& m){ assert(live.erase(m.id) == 1); m = {}; },
+            [this](const Mesh& m){ return landed.contains(m.id); }};
+  }
+};
+
+uint32_t idOf(const FakeGpu::Mesh* m){ return m ? m->id : 0; }
+
+// Replacements wait for their upload to land and swap at the frame boundary;
+// superseded and evicted meshes are released exactly once.
+void testStreamedMeshes(){
+  FakeGpu gpu;
+  MeshBuffers buffers;
+  {
+    StreamedMeshes<FakeGpu::Mesh> meshes(gpu.backend());
+    const ChunkCoord a{1, 0, 0}, b{2, 0, 0};
+    meshes.chunkMeshed(a, buffers);
+    assert(idOf(meshes.chunk(a)) == 1 && !meshes.landed({a, 0}));
+    gpu.landed.insert(1);
+    assert(meshes.landed({a, 0}) && !meshes.landed({b, 0}));
+    // Two remeshes before either lands: the first is dropped unseen.
+    meshes.chunkMeshed(a, buffers);
+    meshes.chunkMeshed(a, buffers);
+    assert(meshes.pendingReplacements() == 1 && !gpu.live.contains(2) && idOf(meshes.chunk(a)) == 1);
+    assert(meshes.swapLanded(5.0) == 0 && idOf(meshes.chunk(a)) == 1);
+    gpu.landed.insert(3);
+    // The edit latency is the one of the update that handed the mesh over.
+    assert(meshes.swapLanded(100.0) == 1 && idOf(meshes.chunk(a)) == 3 && !gpu.live.contains(1));
+    assert(meshes.editToDrawMs().size() == 1 && meshes.editToDrawMs()[0] >= 5.0 && meshes.editToDrawMs()[0] < 100.0);
+    // Evicting a chunk drops its pending replacement too.
+    meshes.chunkMeshed(a, buffers);
+    meshes.chunkReleased(a);
+    assert(!meshes.chunk(a) && meshes.pendingReplacements() == 0 && gpu.live.empty());
+    // A failed upload leaves the chunk without a mesh, or with its old one.
+    meshes.chunkMeshed(b, buffers);
+    gpu.full = true;
+    meshes.chunkMeshed(b, buffers);
+    meshes.chunkMeshed(a, buffers);
+    assert(meshes.uploadFailures() == 2 && meshes.pendingReplacements() == 0 && idOf(meshes.chunk(b)) == 5 && !meshes.chunk(a));
+    gpu.full = false;
+    const LodTile t{{0, 0, 0}, 1};
+    meshes.tileMeshed(t, buffers);
+    assert(idOf(meshes.tile(t)) == 6 && meshes.tile({b, 0}) == meshes.chunk(b) && !meshes.landed(t));
+    gpu.landed.insert(6);
+    assert(meshes.landed(t) && meshes.tiles() == 1);
+    meshes.tileReleased(t);
+    assert(!meshes.tile(t) && gpu.live.size() == 1);
+    meshes.chunkMeshed(b, buffers); // still pending when destroyed
+  }
+  assert(gpu.live.empty());
+
+  // Attached to a streamer: every visible chunk draws a mesh and edits end
+  // with every replacement swapped in.
+  JobSystem jobs(3);
+  Scene scene;
+  StreamingConfig cfg;
+  cfg.radius = 3; cfg.verticalRadius = 1;
+  {
+    StreamedMeshes<FakeGpu::Mesh> meshes(gpu.backend());
+    ChunkStreamer streamer(scene, jobs, terrain(), cfg);
+    meshes.attach(streamer);
+    const Vec3 eye{10.f, 20.f, 10.f}, forward{1.f, 0.f, 0.f};
+    auto frame = [&]{
+      streamer.update(eye, forward);
+      meshes.swapLanded(streamer.stats().editLatencyMs);
+      for(const LodTile& t : streamer.visible()) assert(meshes.tile(t));
+      for(uint32_t id=1; id<gpu.next; ++id) gpu.landed.insert(id); // everything lands a frame later
+    };
+    for(int i=0;i<2000 && (i == 0 || streamer.stats().inFlight || streamer.stats().pendingUploads);++i){ frame(); streamer.finishJobs(); }
+    assert(meshes.chunks() == streamer.stats().meshes && meshes.chunks() > 0);
+    for(int x=0;x<32;x+=4) streamer.setBlock({x, 8, 16}, scene.getBlock(x, 8, 16) == BLOCK_AIR ? BlockId{1} : BLOCK_AIR);
+    for(int i=0;i<2000 && (i < 2 || streamer.stats().inFlight || streamer.stats().pendingUploads || meshes.pendingReplacements());++i){
+      frame();
+      streamer.finishJobs();
+    }
+    assert(meshes.pendingReplacements() == 0 && !meshes.editToDrawMs().empty());
+    assert(gpu.live.size() == meshes.chunks());
+  }
+  assert(gpu.live.empty());
+}
+
+int main(){
+  testPriority();
+  for(unsigned threads : {1u, 3u}) testResidency(threads);
+  for(unsigned threads : {1u, 3u}) testEdits(threads);
+  testUploadBudget();
+  testEviction();
+  testMemoryBudget();
+  for(unsigned threads : {1u, 3u}) testLod(threads);
+  testStreamedMeshes();
+  return 0;
+}
@@ -0,0 +1,134 @@
+#include "noise.hpp"
+#include "worldgen.hpp"
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+// FNV-1a over the decoded blocks.
+uint64_t hashChunk(const Chunk& c, uint64_t h = 0xcbf29ce484222325ull){
+  std::vector<BlockId> blocks(Chunk::VOLUME);
+  c.decode(blocks.data());
+  for(BlockId b : blocks){
+    h = (h ^ (b & 0xFFu)) * 0x100000001b3ull;
+    h = (h ^ (b >> 8u)) * 0x100000001b3ull;
+  }
+  return h;
+}
+
+bool sameBits(const std::vector<float>& a, const std::vector<float>& b){
+  return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size()*sizeof(float)) == 0;
+}
+
+// The dispatched kernels return the scalar reference's bits, including at
+// negative and exact lattice coordinates and in the tail after the last vector.
+void testNoise(){
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<float> val(-5000.f, 5000.f);
+  const size_t N = 1027;
+  std::vector<float> x(N), y(N), z(N), out(N), ref(N);
+  for(size_t i=0;i<N;++i){ x[i] = val(rng); y[i] = val(rng); z[i] = val(rng); }
+  for(size_t i=0;i<64;++i){ x[i] = std::floor(x[i]); z[i] = -static_cast<float>(i); }
+  for(const float frequency : {1.f, 1.f/48.f, 0.37f}){
+    valueNoise2(7u, frequency, x.data(), z.data(), out.data(), N);
+    noise_scalar::valueNoise2(7u, frequency, x.data(), z.data(), ref.data(), N);
+    assert(sameBits(out, ref));
+    for(float v : out) assert(v >= 0.f && v < 1.f);
+    valueNoise3(7u, frequency, x.data(), y.data(), z.data(), out.data(), N);
+    noise_scalar::valueNoise3(7u, frequency, x.data(), y.data(), z.data(), ref.data(), N);
+    assert(sameBits(out, ref));
+    for(float v : out) assert(v >= 0.f && v < 1.f);
+  }
+  // Continuous across cells: a step of 1/64 of a cell moves the value little.
+  for(size_t i=0;i<N;++i){ y[i] = x[i] + 1.f/64.f; }
+  valueNoise2(7u, 1.f, x.data(), z.data(), out.data(), N);
+  valueNoise2(7u, 1.f, y.data(), z.data(), ref.data(), N);
+  for(size_t i=0;i<N;++i) assert(std::fabs(out[i] - ref[i]) < 0.05f);
+  // Octaves stay in range and a different seed gives different noise.
+  fractalNoise3({1u, 1.f/32.f, 4}, x.data(), y.data(), z.data(), out.data(), N);
+  fractalNoise3({2u, 1.f/32.f, 4}, x.data(), y.data(), z.data(), ref.data(), N);
+  for(float v : out) assert(v >= 0.f && v < 1.f);
+  assert(!sameBits(out, ref));
+}
+
+// Columns get their biome's layers over stone, and caves open up below.
+void testWorld(){
+  const WorldParams p{};
+  WorldColumn column;
+  Chunk chunk;
+  size_t tops[6] = {}, carved = 0;
+  for(int cz=-24;cz<24;cz+=3) for(int cx=-24;cx<24;cx+=3){
+    generateWorldColumn(p, cx*4, cz*4, column);
+    for(int i=0;i<WorldColumn::AREA;++i){
+      assert(column.height[i] >= column.minHeight && column.height[i] <= column.maxHeight);
+      ++tops[column.top[i]];
+      if(column.top[i] == BLOCK_GRASS) assert(column.filler[i] == BLOCK_DIRT && column.depth[i] == 3);
+      if(column.top[i] == BLOCK_SNOW) assert(column.height[i] > p.snowLine);
+    }
+  }
+  assert(tops[BLOCK_GRASS] && tops[BLOCK_SAND] && tops[BLOCK_STONE] && tops[BLOCK_SNOW] && !tops[BLOCK_DIRT]);
+  WorldParams solid = p;
+  solid.caveWidth = 0.f;
+  generateWorldColumn(p, 3, -2, column);
+  for(int cy=0;cy*Chunk::SIZE<column.maxHeight;++cy){
+    generateWorld(solid, {3, cy, -2}, chunk);
+    Chunk caves;
+    generateWorld(p, {3, cy, -2}, caves);
+    for(int y=0;y<Chunk::SIZE;++y) for(int z=0;z<Chunk::SIZE;++z) for(int x=0;x<Chunk::SIZE;++x){
+      const int i = z*Chunk::SIZE + x, wy = cy*Chunk::SIZE + y, h = column.height[i];
+      const BlockId b = chunk.get(x, y, z);
+      assert(b == (wy >= h ? BLOCK_AIR : wy == h - 1 ? column.top[i] : wy >= h - 1 - column.depth[i] ? column.filler[i] : BLOCK_STONE));
+      // Caves only remove blocks.
+      const BlockId c = caves.get(x, y, z);
+      assert(c == b || c == BLOCK_AIR);
+      carved += c != b;
+    }
+  }
+  assert(carved > 0);
+  generateWorld(p, {3, column.maxHeight/Chunk::SIZE + 1, -2}, chunk);
+  assert(chunk.empty());
+  generateWorld(p, {3, -4, -2}, chunk);
+  assert(!chunk.uniform()); // caves reach down
+}
+
+// A region filled on any number of threads matches chunk-by-chunk generation,
+// and seed 1 hashes to the same value on every build (scalar, SSE2, AVX2).
+void testRegion(){
+  const WorldParams p{};
+  const ChunkCoord min{-3, -1, -2}, max{2, 4, 2};
+  uint64_t hashes[2] = {};
+  for(unsigned threads : {1u, 4u}){
+    JobSystem jobs(threads);
+    Scene scene;
+    const WorldStats st = generateWorldRegion(jobs, scene, p, min, max);
+    assert(st.chunks == 6*6*5 && st.stored == scene.chunkCount() && st.stored < st.chunks);
+    uint64_t h = 0xcbf29ce484222325ull;
+    Chunk expected;
+    for(int y=min.y;y<=max.y;++y) for(int z=min.z;z<=max.z;++z) for(int x=min.x;x<=max.x;++x){
+      generateWorld(p, {x, y, z}, expected);
+      const Chunk* c = scene.findChunk({x, y, z});
+      assert(c ? hashChunk(*c) == hashChunk(expected) : expected.empty());
+      h = hashChunk(c ? *c : Chunk{}, h);
+    }
+    hashes[threads == 1 ? 0 : 1] = h;
+  }
+  assert(hashes[0] == hashes[1]);
+  // Changes to the generator change this on purpose: take the new value from the message.
+  constexpr uint64_t WORLD_HASH = 0xd57611fcbd3de80aull;
+  if(hashes[0] != WORLD_HASH){
+    std::fprintf(stderr, "world hash %016llx, expected %016llx\n", static_cast<unsigned long long>(hashes[0]), static_cast<unsigned long long>(WORLD_HASH));
+    std::abort();
+  }
+}
+}
+
+int main(){
+  testNoise();
+  testWorld();
+  testRegion();
+  return 0;
+}